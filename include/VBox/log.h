@@ -177,6 +177,8 @@ typedef enum LOGGROUP
     LOG_GROUP_DRV_AUDIO,
     /** Block driver group. */
     LOG_GROUP_DRV_BLOCK,
+    /** Capture file writer group. */
+    LOG_GROUP_DRV_CAPTURE,
     /** Char driver group. */
     LOG_GROUP_DRV_CHAR,
     /** Disk integrity driver group. */
@@ -871,6 +873,7 @@ typedef enum LOGGROUP
     "DRV_ACPI",     \
     "DRV_AUDIO",    \
     "DRV_BLOCK",    \
+    "DRV_CAPTURE",  \
     "DRV_CHAR",     \
     "DRV_DISK_INTEGRITY", \
     "DRV_DISPLAY",  \
@@ -153,6 +153,7 @@ VMM_INT_DECL(int)               HMFlushTLBOnAllVCpus(PVM pVM);
 VMM_INT_DECL(int)               HMInvalidatePageOnAllVCpus(PVM pVM, RTGCPTR GCVirt);
 VMM_INT_DECL(int)               HMInvalidatePhysPage(PVM pVM, RTGCPHYS GCPhys);
 VMM_INT_DECL(bool)              HMIsNestedPagingActive(PVM pVM);
+VMM_INT_DECL(uint32_t)          HMGetNestedPagingWorldSwitchExits(PVMCPU pVCpu);
 VMM_INT_DECL(bool)              HMAreNestedPagingAndFullGuestExecEnabled(PVM pVM);
 VMM_INT_DECL(bool)              HMIsLongModeAllowed(PVM pVM);
 VMM_INT_DECL(bool)              HMAreMsrBitmapsAvailable(PVM pVM);
@@ -160,6 +161,7 @@ VMM_INT_DECL(PGMMODE)           HMGetShwPagingMode(PVM pVM);
 #else /* Nops in RC: */
 # define HMFlushTLB(pVCpu)                              do { } while (0)
 # define HMIsNestedPagingActive(pVM)                    false
+# define HMGetNestedPagingWorldSwitchExits(pVCpu)       0
 # define HMAreNestedPagingAndFullGuestExecEnabled(pVM)  false
 # define HMIsLongModeAllowed(pVM)                       false
 # define HMAreMsrBitmapsAvailable(pVM)                  false
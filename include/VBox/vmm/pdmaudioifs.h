@@ -197,21 +197,6 @@ typedef struct PDMAUDIOBACKENDCFG
     uint32_t cMaxStreamsIn;
 } PDMAUDIOBACKENDCFG, *PPDMAUDIOBACKENDCFG;
 
-/**
- * A single audio sample, representing left and right channels (stereo).
- */
-typedef struct PDMAUDIOSAMPLE
-{
-    /** Left channel. */
-    int64_t i64LSample;
-    /** Right channel. */
-    int64_t i64RSample;
-} PDMAUDIOSAMPLE;
-/** Pointer to a single (stereo) audio sample.   */
-typedef PDMAUDIOSAMPLE *PPDMAUDIOSAMPLE;
-/** Pointer to a const single (stereo) audio sample.   */
-typedef PDMAUDIOSAMPLE const *PCPDMAUDIOSAMPLE;
-
 typedef enum PDMAUDIOENDIANNESS
 {
     /** The usual invalid endian. */
@@ -472,22 +457,36 @@ typedef struct PDMAUDIOVOLUME
  * of a source + destination audio stream. This is needed
  * because both streams can differ regarding their rates
  * and therefore need to be treated accordingly.
+ *
+ * The rate conversion is done by a windowed sinc (polyphase) filter
+ * operating on the channels of the source stream.
  */
 typedef struct PDMAUDIOSTRMRATE
 {
-    /** Current (absolute) offset in the output
-     *  (destination) stream. */
+    /** Current offset in the output (destination) stream,
+     *  expressed in source frames (32.32 fixed point). */
     uint64_t       dstOffset;
     /** Increment for moving dstOffset for the
      *  destination stream. This is needed because the
      *  source <-> destination rate might be different. */
     uint64_t       dstInc;
-    /** Current (absolute) offset in the input
-     *  stream. */
+    /** Number of source frames fed into the filter history
+     *  (relative to the integer part of dstOffset). */
     uint32_t       srcOffset;
-    /** Last processed sample of the input stream.
-     *  Needed for interpolation. */
-    PDMAUDIOSAMPLE srcSampleLast;
+    /** Current write index into the filter history rings. */
+    uint32_t       offHistory;
+    /** Number of filter taps (multiple of four), 0 if no
+     *  rate conversion is needed. */
+    uint16_t       cTaps;
+    /** Number of channels the filter history is kept for. */
+    uint16_t       cChannels;
+    /** Filter coefficients, one row of cTaps entries for each
+     *  phase plus one trailing row for interpolating the last phase. */
+    float         *pafCoefs;
+    /** Filter history, one ring of 2 * cTaps entries per channel.
+     *  Each frame is stored twice so the last cTaps frames are always
+     *  contiguous in memory. */
+    float         *pafHistory;
 } PDMAUDIOSTRMRATE, *PPDMAUDIOSTRMRATE;
 
 /**
@@ -511,12 +510,16 @@ typedef struct PDMAUDMIXBUFVOL
 
 /**
  * Structure for holding sample conversion parameters for
- * the audioMixBufConvFromXXX / audioMixBufConvToXXX macros.
+ * the audioMixBufConvFromXXX / audioMixBufConvToXXX functions.
  */
 typedef struct PDMAUDMIXBUFCONVOPTS
 {
-    /** Number of audio samples to convert. */
+    /** Number of audio frames to convert. */
     uint32_t        cSamples;
+    /** Number of interleaved channels of the source. */
+    uint8_t         cSrcChannels;
+    /** Number of interleaved channels of the destination. */
+    uint8_t         cDstChannels;
     union
     {
         struct
@@ -541,13 +544,13 @@ typedef PDMAUDIOMIXBUFFMT *PPDMAUDIOMIXBUFFMT;
 /**
  * Convertion-from function used by the PDM audio buffer mixer.
  *
- * @returns Number of samples returned.
- * @param   paDst           Where to return the converted samples.
+ * @returns Number of frames returned.
+ * @param   pai32Dst        Where to return the converted (interleaved) samples.
  * @param   pvSrc           The source samples bytes.
  * @param   cbSrc           Number of bytes to convert.
  * @param   pOpts           Conversion options.
  */
-typedef DECLCALLBACK(uint32_t) FNPDMAUDIOMIXBUFCONVFROM(PPDMAUDIOSAMPLE paDst, const void *pvSrc, uint32_t cbSrc,
+typedef DECLCALLBACK(uint32_t) FNPDMAUDIOMIXBUFCONVFROM(int32_t *pai32Dst, const void *pvSrc, uint32_t cbSrc,
                                                         PCPDMAUDMIXBUFCONVOPTS pOpts);
 /** Pointer to a convertion-from function used by the PDM audio buffer mixer. */
 typedef FNPDMAUDIOMIXBUFCONVFROM *PFNPDMAUDIOMIXBUFCONVFROM;
@@ -556,10 +559,10 @@ typedef FNPDMAUDIOMIXBUFCONVFROM *PFNPDMAUDIOMIXBUFCONVFROM;
  * Convertion-to function used by the PDM audio buffer mixer.
  *
  * @param   pvDst           Output buffer.
- * @param   paSrc           The input samples.
+ * @param   pai32Src        The input (interleaved) samples.
  * @param   pOpts           Conversion options.
  */
-typedef DECLCALLBACK(void) FNPDMAUDIOMIXBUFCONVTO(void *pvDst, PCPDMAUDIOSAMPLE paSrc, PCPDMAUDMIXBUFCONVOPTS pOpts);
+typedef DECLCALLBACK(void) FNPDMAUDIOMIXBUFCONVTO(void *pvDst, int32_t const *pai32Src, PCPDMAUDMIXBUFCONVOPTS pOpts);
 /** Pointer to a convertion-to function used by the PDM audio buffer mixer. */
 typedef FNPDMAUDIOMIXBUFCONVTO *PFNPDMAUDIOMIXBUFCONVTO;
 
@@ -569,9 +572,10 @@ typedef struct PDMAUDIOMIXBUF
     RTLISTNODE                Node;
     /** Name of the buffer. */
     char                     *pszName;
-    /** Sample buffer. */
-    PPDMAUDIOSAMPLE           pSamples;
-    /** Size of the sample buffer (in samples). */
+    /** Sample buffer, cChannels interleaved 32-bit samples per frame.
+     *  The full scale of the 32-bit range is used regardless of the audio format. */
+    int32_t                  *pai32Samples;
+    /** Size of the sample buffer (in frames). */
     uint32_t                  cSamples;
     /** The current read position (in samples). */
     uint32_t                  offRead;
@@ -614,8 +618,10 @@ typedef struct PDMAUDIOMIXBUF
      * Currently this does not get changed once assigned.
      */
     int64_t                   iFreqRatio;
-    /** For quickly converting samples <-> bytes and vice versa. */
-    uint8_t                   cShift;
+    /** Number of channels per frame. */
+    uint8_t                   cChannels;
+    /** Size (in bytes) of a frame in AudioFmt, for converting samples <-> bytes. */
+    uint32_t                  cbFrame;
 } PDMAUDIOMIXBUF;
 
 typedef uint32_t PDMAUDIOFILEFLAGS;
@@ -1026,9 +1026,23 @@ typedef struct PDMIDISPLAYCONNECTOR
      * @thread  The emulation thread.
      */
     DECLR3CALLBACKMEMBER(void, pfnVBVAInputMappingUpdate,(PPDMIDISPLAYCONNECTOR pInterface, int32_t xOrigin, int32_t yOrigin, uint32_t cx, uint32_t cy));
+
+    /**
+     * Update a number of rectangles of the display in one go.
+     * PDMIDISPLAYPORT::pfnUpdateDisplay is the caller.
+     *
+     * Same as calling pfnUpdateRect for each of the rectangles.  Optional, the
+     * caller uses pfnUpdateRect if this is NULL.
+     *
+     * @param   pInterface          Pointer to this interface.
+     * @param   paRects             The rectangles (xRight and yBottom exclusive).
+     * @param   cRects              Number of rectangles.
+     * @thread  The emulation thread.
+     */
+    DECLR3CALLBACKMEMBER(void, pfnUpdateRects,(PPDMIDISPLAYCONNECTOR pInterface, PCRTRECT paRects, uint32_t cRects));
 } PDMIDISPLAYCONNECTOR;
 /** PDMIDISPLAYCONNECTOR interface ID. */
-#define PDMIDISPLAYCONNECTOR_IID                "e883a720-85fb-11e4-a307-0b06689c9661"
+#define PDMIDISPLAYCONNECTOR_IID                "4d8d4b28-2a0f-4ec4-9c52-7a6d1b3f0e95"
 
 
 /** Pointer to a secret key interface. */
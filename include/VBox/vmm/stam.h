@@ -27,6 +27,7 @@
 #define ___VBox_vmm_stam_h
 
 #include <VBox/types.h>
+#include <iprt/asm.h>
 #include <iprt/stdarg.h>
 #ifdef _MSC_VER
 # if _MSC_VER >= 1400
@@ -161,6 +162,8 @@ typedef enum STAMTYPE
     STAMTYPE_BOOL,
     /** Generic boolean value. Reset to false. */
     STAMTYPE_BOOL_RESET,
+    /** Log-linear histogram of sample values, see STAMHISTOGRAM. */
+    STAMTYPE_HISTOGRAM,
     /** The end (exclusive). */
     STAMTYPE_END
 } STAMTYPE;
@@ -1100,6 +1103,134 @@ typedef STAMRATIOU32 *PSTAMRATIOU32;
 typedef const STAMRATIOU32 *PCSTAMRATIOU32;
 
 
+/** @name Histogram bucket layout.
+ *
+ * The buckets are log-linear: values below STAMHISTOGRAM_SUB_BUCKETS get a
+ * bucket each, and every power of two above that is split into
+ * STAMHISTOGRAM_SUB_BUCKETS equally sized buckets.  This bounds the relative
+ * error of a bucket to 1/STAMHISTOGRAM_SUB_BUCKETS while keeping the index
+ * calculation down to a bit scan and a shift.  Values beyond the range of the
+ * last bucket are counted in it, the exact maximum is kept in the core.
+ * @{ */
+/** The log2 of the number of buckets each power of two is split into. */
+#define STAMHISTOGRAM_SUB_BUCKET_SHIFT  2
+/** The number of buckets each power of two is split into. */
+#define STAMHISTOGRAM_SUB_BUCKETS       (1U << STAMHISTOGRAM_SUB_BUCKET_SHIFT)
+/** The number of buckets, covering values up to 2^33 (about 8.6 seconds
+ * when sampling nanoseconds). */
+#define STAMHISTOGRAM_BUCKETS           128
+/** @} */
+
+/**
+ * Histogram sample - STAMTYPE_HISTOGRAM.
+ *
+ * The STAMPROFILE core is maintained like for a profile sample so that
+ * consumers that do not know about histograms can treat it as one.
+ *
+ * @remarks Use STAM_REL_HISTOGRAM_ADD_SAMPLE / STAM_HISTOGRAM_ADD_SAMPLE for
+ *          recording values, this is safe to do concurrently from any context.
+ */
+typedef struct STAMHISTOGRAM
+{
+    /** The profile core (count, sum, min and max). */
+    STAMPROFILE         Core;
+    /** The bucket counters. */
+    volatile uint64_t   acBuckets[STAMHISTOGRAM_BUCKETS];
+} STAMHISTOGRAM;
+/** Pointer to a histogram sample. */
+typedef STAMHISTOGRAM *PSTAMHISTOGRAM;
+/** Pointer to a const histogram sample. */
+typedef const STAMHISTOGRAM *PCSTAMHISTOGRAM;
+
+
+/**
+ * Gets the histogram bucket a value belongs to.
+ *
+ * @returns Bucket index.
+ * @param   uValue      The sample value.
+ */
+DECLINLINE(uint32_t) STAMHistogramBucketFromValue(uint64_t uValue)
+{
+    if (uValue < STAMHISTOGRAM_SUB_BUCKETS)
+        return (uint32_t)uValue;
+    unsigned const iBit    = ASMBitLastSetU64(uValue) - 1;
+    uint32_t const iBucket = ((iBit - STAMHISTOGRAM_SUB_BUCKET_SHIFT + 1) << STAMHISTOGRAM_SUB_BUCKET_SHIFT)
+                           | ((uint32_t)(uValue >> (iBit - STAMHISTOGRAM_SUB_BUCKET_SHIFT)) & (STAMHISTOGRAM_SUB_BUCKETS - 1));
+    return iBucket < STAMHISTOGRAM_BUCKETS ? iBucket : STAMHISTOGRAM_BUCKETS - 1;
+}
+
+
+/**
+ * Gets the smallest value that goes into the given histogram bucket.
+ *
+ * @returns The lower bound (inclusive) of the bucket.
+ * @param   iBucket     The bucket index.  Passing STAMHISTOGRAM_BUCKETS gets
+ *                      the upper bound of the last bucket.
+ */
+DECLINLINE(uint64_t) STAMHistogramBucketToValue(uint32_t iBucket)
+{
+    if (iBucket < STAMHISTOGRAM_SUB_BUCKETS)
+        return iBucket;
+    unsigned const iBit = (iBucket >> STAMHISTOGRAM_SUB_BUCKET_SHIFT) - 1 + STAMHISTOGRAM_SUB_BUCKET_SHIFT;
+    return (uint64_t)(STAMHISTOGRAM_SUB_BUCKETS | (iBucket & (STAMHISTOGRAM_SUB_BUCKETS - 1)))
+        << (iBit - STAMHISTOGRAM_SUB_BUCKET_SHIFT);
+}
+
+
+/**
+ * Records a value in a histogram sample.
+ *
+ * This is lock-free and may be called concurrently from all contexts.  The
+ * min and max updates only involve a compare-and-exchange when the value
+ * actually extends the range.
+ *
+ * @param   pHistogram  The histogram sample.
+ * @param   uValue      The value to record.
+ */
+DECLINLINE(void) STAMHistogramAddSample(PSTAMHISTOGRAM pHistogram, uint64_t uValue)
+{
+    ASMAtomicIncU64(&pHistogram->acBuckets[STAMHistogramBucketFromValue(uValue)]);
+    ASMAtomicIncU64(&pHistogram->Core.cPeriods);
+    ASMAtomicAddU64(&pHistogram->Core.cTicks, uValue);
+
+    uint64_t uOld = pHistogram->Core.cTicksMax;
+    while (   uOld < uValue
+           && !ASMAtomicCmpXchgExU64(&pHistogram->Core.cTicksMax, uValue, uOld, &uOld))
+    { /* retry */ }
+    uOld = pHistogram->Core.cTicksMin;
+    while (   uOld > uValue
+           && !ASMAtomicCmpXchgExU64(&pHistogram->Core.cTicksMin, uValue, uOld, &uOld))
+    { /* retry */ }
+}
+
+
+/** @def STAM_REL_HISTOGRAM_ADD_SAMPLE
+ * Records a value in a histogram sample.
+ *
+ * @param   pHistogram  Pointer to the STAMHISTOGRAM structure to operate on.
+ * @param   uValue      The value to record (usually a latency).  This is only
+ *                      referenced once.
+ */
+#ifndef VBOX_WITHOUT_RELEASE_STATISTICS
+# define STAM_REL_HISTOGRAM_ADD_SAMPLE(pHistogram, uValue) \
+    do { STAMHistogramAddSample((pHistogram), (uValue)); } while (0)
+#else
+# define STAM_REL_HISTOGRAM_ADD_SAMPLE(pHistogram, uValue) do { } while (0)
+#endif
+/** @def STAM_HISTOGRAM_ADD_SAMPLE
+ * Records a value in a histogram sample.
+ *
+ * @param   pHistogram  Pointer to the STAMHISTOGRAM structure to operate on.
+ * @param   uValue      The value to record (usually a latency).  This is only
+ *                      referenced once.
+ */
+#ifdef VBOX_WITH_STATISTICS
+# define STAM_HISTOGRAM_ADD_SAMPLE(pHistogram, uValue) STAM_REL_HISTOGRAM_ADD_SAMPLE(pHistogram, uValue)
+#else
+# define STAM_HISTOGRAM_ADD_SAMPLE(pHistogram, uValue) do { } while (0)
+#endif
+
+
 
 
 /** @defgroup grp_stam_r3   The STAM Host Context Ring 3 API
@@ -1108,6 +1239,8 @@ typedef const STAMRATIOU32 *PCSTAMRATIOU32;
 
 VMMR3DECL(int)  STAMR3InitUVM(PUVM pUVM);
 VMMR3DECL(void) STAMR3TermUVM(PUVM pUVM);
+VMMR3_INT_DECL(int)  STAMR3ExportStart(PUVM pUVM);
+VMMR3_INT_DECL(void) STAMR3ExportStop(PUVM pUVM);
 VMMR3DECL(int)  STAMR3RegisterU(PUVM pUVM, void *pvSample, STAMTYPE enmType, STAMVISIBILITY enmVisibility,
                                 const char *pszName, STAMUNIT enmUnit, const char *pszDesc);
 VMMR3DECL(int)  STAMR3Register(PVM pVM, void *pvSample, STAMTYPE enmType, STAMVISIBILITY enmVisibility,
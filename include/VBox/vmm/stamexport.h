@@ -0,0 +1,362 @@
+/** @file
+ * STAM - Statistics Manager, shared memory export region layout.
+ */
+
+/*
+ * Copyright (C) 2006-2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+#ifndef ___VBox_vmm_stamexport_h
+#define ___VBox_vmm_stamexport_h
+
+#include <iprt/types.h>
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/err.h>
+#include <iprt/string.h>
+
+
+/** @defgroup grp_stam_export   The STAM Shared Memory Export Region
+ * @ingroup grp_stam
+ *
+ * When the VM is configured with /STAM/ExportPath, the statistics manager
+ * maintains a file backed shared memory region containing a descriptor table
+ * and a periodically refreshed copy of every sample value.  This allows local
+ * monitoring agents to scrape the statistics of many VMs without going thru
+ * the API and without anyone formatting strings.
+ *
+ * The region is laid out as follows:
+ *      - STAMEXPORTHDR at offset 0.
+ *      - STAMEXPORTHDR::cDescs STAMEXPORTDESC entries at
+ *        STAMEXPORTHDR::offDescs, sorted by name.
+ *      - The string table at STAMEXPORTHDR::offStrings holding the zero
+ *        terminated sample names and descriptions.
+ *      - STAMEXPORTHDR::cValues 64-bit value slots at
+ *        STAMEXPORTHDR::offValues.
+ *
+ * The values of a sample occupies STAMEXPORTDESC::cValues consecutive slots
+ * starting at STAMEXPORTDESC::iValue:
+ *      - STAMTYPE_COUNTER, STAMTYPE_U8 thru STAMTYPE_X64 and STAMTYPE_BOOL
+ *        (incl. the _RESET variants): one slot with the value.
+ *      - STAMTYPE_PROFILE and STAMTYPE_PROFILE_ADV: cPeriods, cTicks,
+ *        cTicksMin and cTicksMax.
+ *      - STAMTYPE_HISTOGRAM: the four profile slots followed by the
+ *        STAMHISTOGRAM_BUCKETS bucket counts.
+ *      - STAMTYPE_RATIO_U32 and STAMTYPE_RATIO_U32_RESET: u32A and u32B.
+ *      - STAMTYPE_CALLBACK samples are not exported.
+ *
+ * Consistency is provided by a sequence lock: STAMEXPORTHDR::uSeq is odd
+ * while the writer is updating the region.  A reader samples uSeq, bails
+ * if it is odd, copies what it needs, and retries if uSeq changed meanwhile.
+ * The descriptor table and string table only change when
+ * STAMEXPORTHDR::uGeneration changes, so readers can cache their parsing of
+ * those.  The region may grow when samples are registered, readers must
+ * remap it when STAMEXPORTHDR::cbRegion exceeds what they have mapped.
+ *
+ * STAMExportCopyRegion implements the reader side of this protocol, taking a
+ * consistent and validated copy which STAMExportLookup and friends can then
+ * be used on.
+ *
+ * @{
+ */
+
+/** The magic value of STAMEXPORTHDR::u32Magic ('STAM'). */
+#define STAMEXPORTHDR_MAGIC         UINT32_C(0x4d415453)
+/** The STAMEXPORTHDR::u32Magic value after the VM has terminated. */
+#define STAMEXPORTHDR_MAGIC_DEAD    UINT32_C(0x44414544)
+/** The current layout version. */
+#define STAMEXPORTHDR_VERSION       UINT32_C(0x00010000)
+
+/**
+ * The header of the export region.
+ */
+typedef struct STAMEXPORTHDR
+{
+    /** Magic value (STAMEXPORTHDR_MAGIC). */
+    uint32_t volatile   u32Magic;
+    /** The layout version (STAMEXPORTHDR_VERSION). */
+    uint32_t            u32Version;
+    /** The size of this header. */
+    uint32_t            cbHdr;
+    /** The size of a descriptor (STAMEXPORTDESC). */
+    uint32_t            cbDesc;
+    /** The sequence lock, odd while being updated. */
+    uint32_t volatile   uSeq;
+    /** The layout generation, incremented when the descriptors change. */
+    uint32_t volatile   uGeneration;
+    /** The current size of the region. */
+    uint64_t volatile   cbRegion;
+
+    /** The number of descriptors. */
+    uint32_t            cDescs;
+    /** The offset of the descriptor table. */
+    uint32_t            offDescs;
+    /** The offset of the string table. */
+    uint32_t            offStrings;
+    /** The size of the string table. */
+    uint32_t            cbStrings;
+    /** The offset of the value slots (8 byte aligned). */
+    uint32_t            offValues;
+    /** The number of value slots. */
+    uint32_t            cValues;
+
+    /** RTTimeNanoTS() of the last value update. */
+    uint64_t            nsUpdate;
+    /** The UTC time of the last value update (nanoseconds since the epoch). */
+    int64_t             nsUpdateUtc;
+    /** The number of value updates so far. */
+    uint64_t            cUpdates;
+    /** The update interval in milliseconds. */
+    uint32_t            cMsInterval;
+    /** The ID of the process owning the VM. */
+    uint32_t            uPid;
+} STAMEXPORTHDR;
+AssertCompileSize(STAMEXPORTHDR, 88);
+/** Pointer to the export region header. */
+typedef STAMEXPORTHDR *PSTAMEXPORTHDR;
+/** Pointer to a const export region header. */
+typedef STAMEXPORTHDR const *PCSTAMEXPORTHDR;
+
+/**
+ * A sample descriptor in the export region.
+ */
+typedef struct STAMEXPORTDESC
+{
+    /** Offset of the sample name into the string table. */
+    uint32_t            offName;
+    /** Offset of the description into the string table, UINT32_MAX if none. */
+    uint32_t            offDesc;
+    /** Index of the first value slot. */
+    uint32_t            iValue;
+    /** The number of value slots. */
+    uint16_t            cValues;
+    /** The sample type (STAMTYPE). */
+    uint8_t             enmType;
+    /** The sample unit (STAMUNIT). */
+    uint8_t             enmUnit;
+    /** The sample visibility (STAMVISIBILITY). */
+    uint8_t             enmVisibility;
+    /** Reserved, zero. */
+    uint8_t             abReserved[3];
+} STAMEXPORTDESC;
+AssertCompileSize(STAMEXPORTDESC, 20);
+/** Pointer to an export region sample descriptor. */
+typedef STAMEXPORTDESC *PSTAMEXPORTDESC;
+/** Pointer to a const export region sample descriptor. */
+typedef STAMEXPORTDESC const *PCSTAMEXPORTDESC;
+
+
+
+/**
+ * Checks the layout of a copy of the export region.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_INVALID_MAGIC if the region isn't (or no longer) live.
+ * @retval  VERR_VERSION_MISMATCH if the layout isn't understood.
+ * @retval  VERR_INVALID_STATE if the tables are inconsistent.
+ * @param   pHdr        The copy.
+ * @param   cb          The size of the copy.
+ */
+DECLINLINE(int) STAMExportValidate(PCSTAMEXPORTHDR pHdr, size_t cb)
+{
+    if (cb < sizeof(*pHdr) || pHdr->u32Magic != STAMEXPORTHDR_MAGIC)
+        return VERR_INVALID_MAGIC;
+    if (   pHdr->u32Version != STAMEXPORTHDR_VERSION
+        || pHdr->cbHdr      != sizeof(STAMEXPORTHDR)
+        || pHdr->cbDesc     != sizeof(STAMEXPORTDESC))
+        return VERR_VERSION_MISMATCH;
+
+    uint64_t const offStringsEnd = (uint64_t)pHdr->offStrings + pHdr->cbStrings;
+    if (   pHdr->offDescs < sizeof(*pHdr)
+        || (uint64_t)pHdr->offDescs + (uint64_t)pHdr->cDescs * sizeof(STAMEXPORTDESC) > pHdr->offStrings
+        || offStringsEnd > pHdr->offValues
+        || (pHdr->offValues & 7)
+        || (uint64_t)pHdr->offValues + (uint64_t)pHdr->cValues * sizeof(uint64_t) > cb
+        || (pHdr->cbStrings && *((const char *)pHdr + offStringsEnd - 1) != '\0'))
+        return VERR_INVALID_STATE;
+
+    PCSTAMEXPORTDESC paDescs = (PCSTAMEXPORTDESC)((uint8_t const *)pHdr + pHdr->offDescs);
+    for (uint32_t iDesc = 0; iDesc < pHdr->cDescs; iDesc++)
+        if (   paDescs[iDesc].offName >= pHdr->cbStrings
+            || (paDescs[iDesc].offDesc != UINT32_MAX && paDescs[iDesc].offDesc >= pHdr->cbStrings)
+            || (uint64_t)paDescs[iDesc].iValue + paDescs[iDesc].cValues > pHdr->cValues)
+            return VERR_INVALID_STATE;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Takes a consistent copy of the export region.
+ *
+ * This follows the sequence lock protocol, retrying a bounded number of times
+ * while the writer is busy, and validates the copy.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_OUT_OF_RANGE if the region has grown beyond @a cbMapped, the
+ *          caller must remap (at least *pcbNeeded bytes) and retry.
+ * @retval  VERR_BUFFER_OVERFLOW if @a cbDst is too small, *pcbNeeded is set.
+ * @retval  VERR_TRY_AGAIN if the writer kept updating the region.
+ * @retval  Any of the STAMExportValidate statuses.
+ *
+ * @param   pHdr        The mapping of the region.
+ * @param   cbMapped    The size of the mapping.
+ * @param   pvDst       Where to copy the region to.  8 byte aligned.
+ * @param   cbDst       The size of the buffer @a pvDst points to.
+ * @param   pcbNeeded   Where to return the size of the copy (on success) or
+ *                      the size needed (VERR_OUT_OF_RANGE and
+ *                      VERR_BUFFER_OVERFLOW).  Optional.
+ */
+DECLINLINE(int) STAMExportCopyRegion(PCSTAMEXPORTHDR pHdr, size_t cbMapped, void *pvDst, size_t cbDst, size_t *pcbNeeded)
+{
+    if (cbMapped < sizeof(*pHdr))
+        return VERR_OUT_OF_RANGE;
+    PSTAMEXPORTHDR const pHdrRw = (PSTAMEXPORTHDR)pHdr; /* ASMAtomicRead* doesn't take const pointers. */
+    for (uint32_t cTries = 0; cTries < _64K; cTries++)
+    {
+        uint32_t const uSeq = ASMAtomicReadU32(&pHdrRw->uSeq);
+        if (uSeq & 1)
+        {
+            ASMNopPause();
+            continue;
+        }
+        if (ASMAtomicReadU32(&pHdrRw->u32Magic) != STAMEXPORTHDR_MAGIC)
+            return VERR_INVALID_MAGIC;
+
+        uint64_t const cbRegion = ASMAtomicReadU64(&pHdrRw->cbRegion);
+        uint64_t const cbUsed   = (uint64_t)pHdr->offValues + (uint64_t)pHdr->cValues * sizeof(uint64_t);
+        if (cbRegion > cbMapped)
+        {
+            if (pcbNeeded)
+                *pcbNeeded = (size_t)cbRegion;
+            return VERR_OUT_OF_RANGE;
+        }
+        if (cbUsed > cbRegion || cbUsed < sizeof(*pHdr))
+        {
+            /* Torn read of the header or a broken one. */
+            if (ASMAtomicReadU32(&pHdrRw->uSeq) != uSeq)
+                continue;
+            return VERR_INVALID_STATE;
+        }
+        if (cbUsed > cbDst)
+        {
+            if (ASMAtomicReadU32(&pHdrRw->uSeq) != uSeq)
+                continue;
+            if (pcbNeeded)
+                *pcbNeeded = (size_t)cbUsed;
+            return VERR_BUFFER_OVERFLOW;
+        }
+
+        memcpy(pvDst, pHdr, (size_t)cbUsed);
+        if (ASMAtomicReadU32(&pHdrRw->uSeq) != uSeq)
+            continue;
+
+        if (pcbNeeded)
+            *pcbNeeded = (size_t)cbUsed;
+        return STAMExportValidate((PCSTAMEXPORTHDR)pvDst, (size_t)cbUsed);
+    }
+    return VERR_TRY_AGAIN;
+}
+
+
+/**
+ * Gets a sample descriptor from a validated copy.
+ *
+ * @returns Pointer to the descriptor.
+ * @param   pHdr        The validated copy.
+ * @param   iDesc       The descriptor index, less than STAMEXPORTHDR::cDescs.
+ */
+DECLINLINE(PCSTAMEXPORTDESC) STAMExportGetDesc(PCSTAMEXPORTHDR pHdr, uint32_t iDesc)
+{
+    Assert(iDesc < pHdr->cDescs);
+    return &((PCSTAMEXPORTDESC)((uint8_t const *)pHdr + pHdr->offDescs))[iDesc];
+}
+
+
+/**
+ * Gets the name of a sample in a validated copy.
+ *
+ * @returns The sample name.
+ * @param   pHdr        The validated copy.
+ * @param   pDesc       The sample descriptor.
+ */
+DECLINLINE(const char *) STAMExportGetName(PCSTAMEXPORTHDR pHdr, PCSTAMEXPORTDESC pDesc)
+{
+    return (const char *)pHdr + pHdr->offStrings + pDesc->offName;
+}
+
+
+/**
+ * Gets the description of a sample in a validated copy.
+ *
+ * @returns The sample description, NULL if none.
+ * @param   pHdr        The validated copy.
+ * @param   pDesc       The sample descriptor.
+ */
+DECLINLINE(const char *) STAMExportGetDescription(PCSTAMEXPORTHDR pHdr, PCSTAMEXPORTDESC pDesc)
+{
+    if (pDesc->offDesc == UINT32_MAX)
+        return NULL;
+    return (const char *)pHdr + pHdr->offStrings + pDesc->offDesc;
+}
+
+
+/**
+ * Gets the values of a sample in a validated copy.
+ *
+ * @returns Pointer to the STAMEXPORTDESC::cValues values of the sample.
+ * @param   pHdr        The validated copy.
+ * @param   pDesc       The sample descriptor.
+ */
+DECLINLINE(uint64_t const *) STAMExportGetValues(PCSTAMEXPORTHDR pHdr, PCSTAMEXPORTDESC pDesc)
+{
+    return (uint64_t const *)((uint8_t const *)pHdr + pHdr->offValues) + pDesc->iValue;
+}
+
+
+/**
+ * Looks up a sample by name in a validated copy.
+ *
+ * @returns Pointer to the descriptor, NULL if not found.
+ * @param   pHdr        The validated copy.
+ * @param   pszName     The sample name.
+ */
+DECLINLINE(PCSTAMEXPORTDESC) STAMExportLookup(PCSTAMEXPORTHDR pHdr, const char *pszName)
+{
+    uint32_t iStart = 0;
+    uint32_t iEnd   = pHdr->cDescs;
+    while (iStart < iEnd)
+    {
+        uint32_t const   i     = iStart + (iEnd - iStart) / 2;
+        PCSTAMEXPORTDESC pDesc = STAMExportGetDesc(pHdr, i);
+        int const        iDiff = strcmp(pszName, STAMExportGetName(pHdr, pDesc));
+        if (!iDiff)
+            return pDesc;
+        if (iDiff < 0)
+            iEnd = i;
+        else
+            iStart = i + 1;
+    }
+    return NULL;
+}
+
+/** @} */
+
+#endif
+
@@ -375,6 +375,9 @@ RTDECL(int)  RTFileRead(RTFILE File, void *pvBuf, size_t cbToRead, size_t *pcbRe
  * Read bytes from a file at a given offset.
  * This function may modify the file position.
  *
+ * Except on OS/2, this does not depend on the file position and can be used
+ * by several threads on the same handle at the same time.
+ *
  * @returns iprt status code.
  * @param   File        Handle to the file.
  * @param   off         Where to read.
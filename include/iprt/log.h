@@ -357,6 +357,11 @@ typedef enum RTLOGFLAGS
     RTLOGFLAGS_FLUSH                = 0x00000200,
     /** Restrict the number of log entries per group. */
     RTLOGFLAGS_RESTRICT_GROUPS      = 0x00000400,
+    /** Write the log file asynchronously on a dedicated thread (ring-3 only). */
+    RTLOGFLAGS_ASYNC                = 0x00000800,
+    /** Record the messages going to the log file in binary form and leave the
+     * formatting to RTLogBinDecodeFile() (ring-3 only). */
+    RTLOGFLAGS_BINARY               = 0x00001000,
     /** New lines should be prefixed with the write and read lock counts. */
     RTLOGFLAGS_PREFIX_LOCK_COUNTS   = 0x00008000,
     /** New lines should be prefixed with the CPU id (ApicID on intel/amd). */
@@ -2372,6 +2377,63 @@ typedef FNRTSTROUTPUT *PFNRTSTROUTPUT;
  */
 RTDECL(size_t) RTLogFormatV(PFNRTSTROUTPUT pfnOutput, void *pvArg, const char *pszFormat, va_list args) RT_IPRT_FORMAT_ATTR(3, 0);
 
+#ifdef IN_RING3
+/** @name RTLogBinDecodeFile flags.
+ * @{ */
+/** Don't prefix the decoded messages with time, thread and group. */
+# define RTLOGBINDECODE_F_NO_PREFIX     RT_BIT_32(0)
+/** Mask of valid flags. */
+# define RTLOGBINDECODE_F_VALID_MASK    UINT32_C(0x00000001)
+/** @} */
+
+/**
+ * Decodes a log file written with RTLOGFLAGS_BINARY.
+ *
+ * Text in the file (messages which couldn't be recorded in binary form and
+ * output from before binary logging was enabled) is passed thru as-is.
+ *
+ * @returns IPRT status code.
+ * @retval  VERR_NOT_SUPPORTED if the file was written by a process with a
+ *          different ABI (pointer size, long size or byte order).
+ * @param   pszFilename         The log file.
+ * @param   fFlags              RTLOGBINDECODE_F_XXX.
+ * @param   pfnOutput           The output callback.
+ * @param   pvArgOutput         The output callback argument.
+ */
+RTDECL(int) RTLogBinDecodeFile(const char *pszFilename, uint32_t fFlags, PFNRTSTROUTPUT pfnOutput, void *pvArgOutput);
+
+/**
+ * Asynchronous file writing statistics (RTLOGFLAGS_ASYNC).
+ *
+ * The counters are cumulative for the lifetime of the logger instance.
+ */
+typedef struct RTLOGASYNCSTATS
+{
+    /** Number of times a logging thread had to wait for buffer space. */
+    uint64_t    cWaits;
+    /** Number of flushes dropped because the buffer stayed full. */
+    uint64_t    cDropped;
+    /** Number of bytes dropped because the buffer stayed full. */
+    uint64_t    cbDropped;
+    /** Number of bytes currently queued for the writer thread. */
+    uint64_t    cbQueued;
+    /** Whether asynchronous writing is currently active. */
+    bool        fActive;
+} RTLOGASYNCSTATS;
+/** Pointer to asynchronous file writing statistics. */
+typedef RTLOGASYNCSTATS *PRTLOGASYNCSTATS;
+
+/**
+ * Queries the asynchronous file writing statistics of a logger.
+ *
+ * @returns VINF_SUCCESS, VERR_INVALID_PARAMETER or VERR_INVALID_MAGIC.
+ * @param   pLogger             Logger instance (NULL for default logger).
+ * @param   pStats              Where to return the statistics.  All zero if
+ *                              there is no default logger.
+ */
+RTDECL(int) RTLogQueryAsyncStats(PRTLOGGER pLogger, PRTLOGASYNCSTATS pStats);
+#endif /* IN_RING3 */
+
 /**
  * Write log buffer to COM port.
  *
@@ -1149,6 +1149,7 @@
 # define RTLogGetDefaultInstanceEx                      RT_MANGLER(RTLogGetDefaultInstanceEx)
 # define RTLogGetDestinations                           RT_MANGLER(RTLogGetDestinations)
 # define RTLogGetFlags                                  RT_MANGLER(RTLogGetFlags)
+# define RTLogQueryAsyncStats                           RT_MANGLER(RTLogQueryAsyncStats)
 # define RTLogGetGroupSettings                          RT_MANGLER(RTLogGetGroupSettings)
 # define RTLogGroupSettings                             RT_MANGLER(RTLogGroupSettings)
 # define RTLogLogger                                    RT_MANGLER(RTLogLogger)
@@ -1695,6 +1696,7 @@
 # define RTSha1Final                                    RT_MANGLER(RTSha1Final)
 # define RTSha1FromString                               RT_MANGLER(RTSha1FromString)
 # define RTSha1Init                                     RT_MANGLER(RTSha1Init)
+# define RTSha1Multi                                    RT_MANGLER(RTSha1Multi)
 # define RTSha1ToString                                 RT_MANGLER(RTSha1ToString)
 # define RTSha1Update                                   RT_MANGLER(RTSha1Update)
 # define RTSha224                                       RT_MANGLER(RTSha224)
@@ -1711,6 +1713,7 @@
 # define RTSha256Final                                  RT_MANGLER(RTSha256Final)
 # define RTSha256FromString                             RT_MANGLER(RTSha256FromString)
 # define RTSha256Init                                   RT_MANGLER(RTSha256Init)
+# define RTSha256Multi                                  RT_MANGLER(RTSha256Multi)
 # define RTSha256ToString                               RT_MANGLER(RTSha256ToString)
 # define RTSha256Update                                 RT_MANGLER(RTSha256Update)
 # define RTSha256Digest                                 RT_MANGLER(RTSha256Digest)
@@ -1769,9 +1772,15 @@
 # define RTSocketWriteNB                                RT_MANGLER(RTSocketWriteNB)
 # define RTSocketWriteTo                                RT_MANGLER(RTSocketWriteTo)
 # define RTSocketWriteToNB                              RT_MANGLER(RTSocketWriteToNB)
+# define RTSortApvIntro                                 RT_MANGLER(RTSortApvIntro)
 # define RTSortApvIsSorted                              RT_MANGLER(RTSortApvIsSorted)
+# define RTSortApvMerge                                 RT_MANGLER(RTSortApvMerge)
+# define RTSortApvParallel                              RT_MANGLER(RTSortApvParallel)
 # define RTSortApvShell                                 RT_MANGLER(RTSortApvShell)
+# define RTSortIntro                                    RT_MANGLER(RTSortIntro)
 # define RTSortIsSorted                                 RT_MANGLER(RTSortIsSorted)
+# define RTSortMerge                                    RT_MANGLER(RTSortMerge)
+# define RTSortParallel                                 RT_MANGLER(RTSortParallel)
 # define RTSortShell                                    RT_MANGLER(RTSortShell)
 # define RTSpinlockAcquire                              RT_MANGLER(RTSpinlockAcquire)
 # define RTSpinlockAcquireNoInts                        RT_MANGLER(RTSpinlockAcquireNoInts)
@@ -2359,6 +2368,7 @@
 # define RTVfsParsePathA                                RT_MANGLER(RTVfsParsePathA)
 # define RTVfsParsePathAppend                           RT_MANGLER(RTVfsParsePathAppend)
 # define RTVfsParsePathFree                             RT_MANGLER(RTVfsParsePathFree)
+# define RTVfsReadAheadQueryStats                       RT_MANGLER(RTVfsReadAheadQueryStats)
 # define RTVfsRelease                                   RT_MANGLER(RTVfsRelease)
 # define RTVfsRetain                                    RT_MANGLER(RTVfsRetain)
 # define RTVfsSymlinkQueryInfo                          RT_MANGLER(RTVfsSymlinkQueryInfo)
@@ -92,6 +92,26 @@ typedef DECLCALLBACK(void) FNMEMCACHEDTOR(RTMEMCACHE hMemCache, void *pvObj, voi
 typedef FNMEMCACHEDTOR *PFNMEMCACHEDTOR;
 
 
+/** @name RTMEMCACHE_F_XXX - RTMemCacheCreate flags.
+ * @{ */
+/** Put a per-thread magazine layer on top of the cache.
+ *
+ * Each thread allocates from and frees to a couple of private magazines
+ * (object stacks) without touching any shared cache lines, only exchanging
+ * full and empty magazines with a common depot under a lock every so often.
+ * This is for caches that several threads are beating on concurrently.  The
+ * price is that objects sitting in the magazines of other threads are not
+ * available to the calling thread, so the cache may hit @a cMaxObjects
+ * somewhat before all objects have actually been allocated.
+ *
+ * All caches share one TLS entry.  The magazines of a terminating thread are
+ * returned to the cache by a TLS destructor, so on hosts without TLS
+ * destructors (Windows) this flag is ignored. */
+#define RTMEMCACHE_F_MAGAZINES      RT_BIT_32(0)
+/** Valid flags. */
+#define RTMEMCACHE_F_VALID_MASK     UINT32_C(0x00000001)
+/** @} */
+
 /**
  * Create an allocation cache for fixed size memory objects.
  *
@@ -106,7 +126,7 @@ typedef FNMEMCACHEDTOR *PFNMEMCACHEDTOR;
  * @param   pfnCtor             Object constructor callback.  Optional.
  * @param   pfnDtor             Object destructor callback.  Optional.
  * @param   pvUser              User argument for the two callbacks.
- * @param   fFlags              Flags reserved for future use.  Must be zero.
+ * @param   fFlags              RTMEMCACHE_F_XXX.
  */
 RTDECL(int)     RTMemCacheCreate(PRTMEMCACHE phMemCache, size_t cbObject, size_t cbAlignment, uint32_t cMaxObjects,
                                  PFNMEMCACHECTOR pfnCtor, PFNMEMCACHEDTOR pfnDtor, void *pvUser, uint32_t fFlags);
@@ -103,6 +103,20 @@ RTDECL(void) RTSha1Update(PRTSHA1CONTEXT pCtx, const void *pvBuf, size_t cbBuf);
  */
 RTDECL(void) RTSha1Final(PRTSHA1CONTEXT pCtx, uint8_t pabHash[RTSHA1_HASH_SIZE]);
 
+/**
+ * Computes the SHA-1 hashes of a number of equally sized buffers.
+ *
+ * This is meant for hashing many pages or similar small buffers in one go.
+ * Depending on the CPU, the buffers are hashed several at a time using SIMD
+ * instructions.
+ *
+ * @param   cBufs       The number of buffers.
+ * @param   papvBufs    Array of @a cBufs buffer pointers.
+ * @param   cbBuf       The size of each buffer (in bytes).
+ * @param   paHashes    Where to store the hashes, @a cBufs entries.
+ */
+RTDECL(void) RTSha1Multi(size_t cBufs, const void * const *papvBufs, size_t cbBuf, uint8_t (*paHashes)[RTSHA1_HASH_SIZE]);
+
 /**
  * Converts a SHA-1 hash to a digest string.
  *
@@ -222,6 +236,20 @@ RTDECL(void) RTSha256Update(PRTSHA256CONTEXT pCtx, const void *pvBuf, size_t cbB
  */
 RTDECL(void) RTSha256Final(PRTSHA256CONTEXT pCtx, uint8_t pabHash[RTSHA256_HASH_SIZE]);
 
+/**
+ * Computes the SHA-256 hashes of a number of equally sized buffers.
+ *
+ * This is meant for hashing many pages or similar small buffers in one go.
+ * Depending on the CPU, the buffers are hashed several at a time using SIMD
+ * instructions.
+ *
+ * @param   cBufs       The number of buffers.
+ * @param   papvBufs    Array of @a cBufs buffer pointers.
+ * @param   cbBuf       The size of each buffer (in bytes).
+ * @param   paHashes    Where to store the hashes, @a cBufs entries.
+ */
+RTDECL(void) RTSha256Multi(size_t cBufs, const void * const *papvBufs, size_t cbBuf, uint8_t (*paHashes)[RTSHA256_HASH_SIZE]);
+
 /**
  * Converts a SHA-256 hash to a digest string.
  *
@@ -96,6 +96,88 @@ RTDECL(void) RTSortShell(void *pvArray, size_t cElements, size_t cbElement, PFNR
  */
 RTDECL(void) RTSortApvShell(void **papvArray, size_t cElements, PFNRTSORTCMP pfnCmp, void *pvUser);
 
+/**
+ * Introsort an array of variable sized elementes.
+ *
+ * This is quicksort with a median-of-three pivot that falls back on heap sort
+ * when partitioning goes badly, so it's O(n log n) in the worst case, and it
+ * detects (nearly) sorted input.  It is not stable.
+ *
+ * @param   pvArray         The array to sort.
+ * @param   cElements       The number of elements in the array.
+ * @param   cbElement       The size of an array element.
+ * @param   pfnCmp          Callback function comparing two elements.
+ * @param   pvUser          User argument for the callback.
+ */
+RTDECL(void) RTSortIntro(void *pvArray, size_t cElements, size_t cbElement, PFNRTSORTCMP pfnCmp, void *pvUser);
+
+/**
+ * Same as RTSortIntro but speciallized for an array containing element
+ * pointers.
+ *
+ * @param   papvArray       The array to sort.
+ * @param   cElements       The number of elements in the array.
+ * @param   pfnCmp          Callback function comparing two elements.
+ * @param   pvUser          User argument for the callback.
+ */
+RTDECL(void) RTSortApvIntro(void **papvArray, size_t cElements, PFNRTSORTCMP pfnCmp, void *pvUser);
+
+/**
+ * Stable merge sort of an array of variable sized elementes.
+ *
+ * Elements comparing equal keep their relative order.  This uses a temporary
+ * buffer of half the array size, and falls back on a slower in-place merge
+ * if it cannot be allocated.
+ *
+ * @param   pvArray         The array to sort.
+ * @param   cElements       The number of elements in the array.
+ * @param   cbElement       The size of an array element.
+ * @param   pfnCmp          Callback function comparing two elements.
+ * @param   pvUser          User argument for the callback.
+ */
+RTDECL(void) RTSortMerge(void *pvArray, size_t cElements, size_t cbElement, PFNRTSORTCMP pfnCmp, void *pvUser);
+
+/**
+ * Same as RTSortMerge but speciallized for an array containing element
+ * pointers.
+ *
+ * @param   papvArray       The array to sort.
+ * @param   cElements       The number of elements in the array.
+ * @param   pfnCmp          Callback function comparing two elements.
+ * @param   pvUser          User argument for the callback.
+ */
+RTDECL(void) RTSortApvMerge(void **papvArray, size_t cElements, PFNRTSORTCMP pfnCmp, void *pvUser);
+
+#ifdef IN_RING3
+/**
+ * Sorts a large array of variable sized elementes using multiple threads.
+ *
+ * The array is split into one chunk per CPU (up to 16), the chunks are sorted
+ * by RTSortIntro on a request pool, and then merged pairwise in parallel.
+ * Small arrays are simply passed to RTSortIntro.  It is not stable.
+ *
+ * @param   pvArray         The array to sort.
+ * @param   cElements       The number of elements in the array.
+ * @param   cbElement       The size of an array element.
+ * @param   pfnCmp          Callback function comparing two elements.  This
+ *                          will be called concurrently on several threads.
+ * @param   pvUser          User argument for the callback.
+ */
+RTDECL(void) RTSortParallel(void *pvArray, size_t cElements, size_t cbElement, PFNRTSORTCMP pfnCmp, void *pvUser);
+
+/**
+ * Same as RTSortParallel but speciallized for an array containing element
+ * pointers.
+ *
+ * @param   papvArray       The array to sort.
+ * @param   cElements       The number of elements in the array.
+ * @param   pfnCmp          Callback function comparing two elements.  This
+ *                          will be called concurrently on several threads.
+ * @param   pvUser          User argument for the callback.
+ */
+RTDECL(void) RTSortApvParallel(void **papvArray, size_t cElements, PFNRTSORTCMP pfnCmp, void *pvUser);
+#endif
+
 /**
  * Checks if an array of variable sized elementes is sorted.
  *
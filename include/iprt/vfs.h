@@ -1009,6 +1009,29 @@ RTDECL(int) RTVfsMemFileCreate(RTVFSIOSTREAM hVfsIos, size_t cbEstimate, PRTVFSF
  */
 RTDECL(int) RTVfsUtilPumpIoStreams(RTVFSIOSTREAM hVfsIosSrc, RTVFSIOSTREAM hVfsIosDst, size_t cbBufHint);
 
+/** @name RTVFSREADAHEAD_F_XXX - Flags for RTVfsCreateReadAheadForIoStream and
+ *        RTVfsCreateReadAheadForFile.
+ * @{ */
+/** Keep several reads in flight using a number of worker threads doing
+ * positional reads, with the read ahead window adapting to the consumption
+ * rate.  Only applicable when the source is a file, otherwise ignored.
+ * @remarks The workers read from the source file concurrently without any
+ *          serialization, so its positional reads must be safe for that.
+ *          This is the case for memory files and, as RTFileReadAt doesn't
+ *          depend on the file position, for files opened by
+ *          RTVfsFileOpenNormal and friends on all hosts but OS/2. */
+#define RTVFSREADAHEAD_F_PARALLEL       RT_BIT_32(0)
+/** Mask for the max number of concurrent requests in parallel mode, zero
+ * meaning the default (4).  Use RTVFSREADAHEAD_F_REQS to specify it. */
+#define RTVFSREADAHEAD_F_REQS_MASK      UINT32_C(0x00001f00)
+/** Shift count for RTVFSREADAHEAD_F_REQS_MASK. */
+#define RTVFSREADAHEAD_F_REQS_SHIFT     8
+/** Makes the flags value for @a a_cReqs concurrent requests (max 16). */
+#define RTVFSREADAHEAD_F_REQS(a_cReqs)  (((uint32_t)(a_cReqs) << RTVFSREADAHEAD_F_REQS_SHIFT) & RTVFSREADAHEAD_F_REQS_MASK)
+/** Valid flags. */
+#define RTVFSREADAHEAD_F_VALID_MASK     UINT32_C(0x00001f01)
+/** @} */
+
 /**
  * Create an I/O stream instance performing simple sequential read-ahead.
  *
@@ -1016,7 +1039,7 @@ RTDECL(int) RTVfsUtilPumpIoStreams(RTVFSIOSTREAM hVfsIosSrc, RTVFSIOSTREAM hVfsI
  * @param   hVfsIos     The input stream to perform read ahead on.  If this is
  *                      actually for a file object, the returned I/O stream
  *                      handle can also be cast to a file handle.
- * @param   fFlags      Flags reserved for future use, MBZ.
+ * @param   fFlags      RTVFSREADAHEAD_F_XXX.
  * @param   cBuffers    How many read ahead buffers to use. Specify 0 for
  *                      default value.
  * @param   cbBuffer    The size of each read ahead buffer. Specify 0 for
@@ -1038,7 +1061,7 @@ RTDECL(int) RTVfsCreateReadAheadForIoStream(RTVFSIOSTREAM hVfsIos, uint32_t fFla
  *
  * @returns IPRT status code.
  * @param   hVfsFile    The input file to perform read ahead on.
- * @param   fFlags      Flags reserved for future use, MBZ.
+ * @param   fFlags      RTVFSREADAHEAD_F_XXX.
  * @param   cBuffers    How many read ahead buffers to use. Specify 0 for
  *                      default value.
  * @param   cbBuffer    The size of each read ahead buffer. Specify 0 for
@@ -1049,6 +1072,45 @@ RTDECL(int) RTVfsCreateReadAheadForIoStream(RTVFSIOSTREAM hVfsIos, uint32_t fFla
 RTDECL(int) RTVfsCreateReadAheadForFile(RTVFSFILE hVfsFile, uint32_t fFlags, uint32_t cBuffers, uint32_t cbBuffer,
                                         PRTVFSFILE phVfsFile);
 
+/**
+ * Read ahead statistics, see RTVfsReadAheadQueryStats.
+ */
+typedef struct RTVFSREADAHEADSTATS
+{
+    /** Bytes returned from the read ahead buffers. */
+    uint64_t    cbHits;
+    /** Bytes the consumer had to read directly from the source. */
+    uint64_t    cbDirect;
+    /** Number of times the consumer waited for a read in progress. */
+    uint32_t    cStalls;
+    /** Number of buffers read but thrown away without being consumed. */
+    uint32_t    cWasted;
+    /** The current read ahead window (in buffers, parallel mode). */
+    uint32_t    cWindow;
+    /** The largest read ahead window reached (parallel mode). */
+    uint32_t    cMaxWindow;
+    /** The number of buffers. */
+    uint32_t    cBuffers;
+    /** The number of reader threads. */
+    uint32_t    cWorkers;
+    /** Set if RTVFSREADAHEAD_F_PARALLEL is in effect, i.e. it was requested
+     * and the source is a file. */
+    bool        fParallel;
+} RTVFSREADAHEADSTATS;
+/** Pointer to read ahead statistics. */
+typedef RTVFSREADAHEADSTATS *PRTVFSREADAHEADSTATS;
+
+/**
+ * Queries the statistics of a read ahead I/O stream or file.
+ *
+ * @returns IPRT status code.
+ * @retval  VERR_INVALID_HANDLE if @a hVfsIos isn't a read ahead instance.
+ * @param   hVfsIos     The read ahead I/O stream.  Use RTVfsFileToIoStream on
+ *                      read ahead file handles.
+ * @param   pStats      Where to return the statistics.
+ */
+RTDECL(int) RTVfsReadAheadQueryStats(RTVFSIOSTREAM hVfsIos, PRTVFSREADAHEADSTATS pStats);
+
 /** @}  */
 
 
@@ -235,6 +235,14 @@ RTDECL(int) RTZipGzipDecompressIoStream(RTVFSIOSTREAM hVfsIosIn, uint32_t fFlags
  * @{ */
 /** Allow the smaller ZLIB header as well as the regular GZIP header. */
 #define RTZIPGZIPDECOMP_F_ALLOW_ZLIB_HDR    RT_BIT(0)
+/** Inflate the members of block-wise compressed input (BGZF style, i.e. a
+ * sequence of gzip members each carrying its compressed size in a 'BC' extra
+ * subfield) in parallel on a request pool.  Other input is decompressed the
+ * usual way.
+ * @remarks Only block-wise input produced by third party tools (bgzip and
+ *          the like) benefits.  RTZipGzipCompressIoStream writes a single
+ *          member, so gzip files written by IPRT itself are not sped up. */
+#define RTZIPGZIPDECOMP_F_PARALLEL          RT_BIT(1)
 /** @} */
 
 
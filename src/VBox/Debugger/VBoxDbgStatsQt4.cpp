@@ -1056,6 +1056,7 @@ VBoxDbgStatsModel::initNode(PDBGGUISTATSNODE pNode, STAMTYPE enmType, void *pvSa
 
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             pNode->Data.Profile = *(PSTAMPROFILE)pvSample;
             break;
 
@@ -1154,6 +1155,7 @@ VBoxDbgStatsModel::updateNode(PDBGGUISTATSNODE pNode, STAMTYPE enmType, void *pv
 
             case STAMTYPE_PROFILE:
             case STAMTYPE_PROFILE_ADV:
+            case STAMTYPE_HISTOGRAM:
             {
                 uint64_t cPrevPeriods = pNode->Data.Profile.cPeriods;
                 pNode->Data.Profile = *(PSTAMPROFILE)pvSample;
@@ -2166,6 +2168,7 @@ VBoxDbgStatsModel::strValueTimes(PCDBGGUISTATSNODE pNode)
 
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             if (!pNode->Data.Profile.cPeriods)
                 return "0";
             return formatNumber(sz, pNode->Data.Profile.cPeriods);
@@ -2238,6 +2241,7 @@ VBoxDbgStatsModel::strMinValue(PCDBGGUISTATSNODE pNode)
     {
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             if (!pNode->Data.Profile.cPeriods)
                 return "0";
             return formatNumber(sz, pNode->Data.Profile.cTicksMin);
@@ -2256,6 +2260,7 @@ VBoxDbgStatsModel::strAvgValue(PCDBGGUISTATSNODE pNode)
     {
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             if (!pNode->Data.Profile.cPeriods)
                 return "0";
             return formatNumber(sz, pNode->Data.Profile.cTicks / pNode->Data.Profile.cPeriods);
@@ -2274,6 +2279,7 @@ VBoxDbgStatsModel::strMaxValue(PCDBGGUISTATSNODE pNode)
     {
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             if (!pNode->Data.Profile.cPeriods)
                 return "0";
             return formatNumber(sz, pNode->Data.Profile.cTicksMax);
@@ -2292,6 +2298,7 @@ VBoxDbgStatsModel::strTotalValue(PCDBGGUISTATSNODE pNode)
     {
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             if (!pNode->Data.Profile.cPeriods)
                 return "0";
             return formatNumber(sz, pNode->Data.Profile.cTicks);
@@ -2310,6 +2317,7 @@ VBoxDbgStatsModel::strDeltaValue(PCDBGGUISTATSNODE pNode)
     {
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             if (!pNode->Data.Profile.cPeriods)
                 return "0";
             /* fall thru */
@@ -2434,6 +2442,7 @@ VBoxDbgStatsModel::stringifyNodeNoRecursion(PDBGGUISTATSNODE a_pNode, QString &a
 
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
         {
             uint64_t u64 = a_pNode->Data.Profile.cPeriods ? a_pNode->Data.Profile.cPeriods : 1;
             RTStrPrintf(szBuf, sizeof(szBuf),
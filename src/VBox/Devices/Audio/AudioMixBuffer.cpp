@@ -42,6 +42,11 @@
 #include <iprt/mem.h>
 #include <iprt/string.h> /* For RT_BZERO. */
 
+#ifdef RT_ARCH_AMD64
+# include <emmintrin.h>
+#endif
+#include <math.h>
+
 #ifdef VBOX_AUDIO_TESTCASE
 # define LOG_ENABLED
 # include <iprt/stream.h>
@@ -63,6 +68,7 @@
 #ifdef DEBUG
 DECLINLINE(void) audioMixBufDbgPrintInternal(PPDMAUDIOMIXBUF pMixBuf);
 #endif
+static void audioMixBufRateTerm(PPDMAUDIOSTRMRATE pRate);
 
 /*
  *   Soft Volume Control
@@ -147,16 +153,16 @@ static uint64_t s_cSamplesMixedTotal = 0;
  * @return  IPRT status code. VINF_TRY_AGAIN for getting next pointer at beginning (circular).
  * @param   pMixBuf                 Mixing buffer to acquire audio samples from.
  * @param   cSamplesToRead          Number of audio samples to read.
- * @param   ppvSamples              Returns a mutable pointer to the buffer's audio sample data.
+ * @param   ppai32Samples           Returns a mutable pointer to the buffer's (interleaved) audio sample data.
  * @param   pcSamplesRead           Number of audio samples read (acquired).
  *
  * @remark  This function is not thread safe!
  */
 int AudioMixBufAcquire(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamplesToRead,
-                       PPDMAUDIOSAMPLE *ppvSamples, uint32_t *pcSamplesRead)
+                       int32_t **ppai32Samples, uint32_t *pcSamplesRead)
 {
     AssertPtrReturn(pMixBuf, VERR_INVALID_POINTER);
-    AssertPtrReturn(ppvSamples, VERR_INVALID_POINTER);
+    AssertPtrReturn(ppai32Samples, VERR_INVALID_POINTER);
     AssertPtrReturn(pcSamplesRead, VERR_INVALID_POINTER);
 
     int rc;
@@ -179,8 +185,8 @@ int AudioMixBufAcquire(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamplesToRead,
         rc = VINF_SUCCESS;
     }
 
-    *ppvSamples = &pMixBuf->pSamples[pMixBuf->offRead];
-    AssertPtr(ppvSamples);
+    *ppai32Samples = &pMixBuf->pai32Samples[(size_t)pMixBuf->offRead * pMixBuf->cChannels];
+    AssertPtr(*ppai32Samples);
 
     pMixBuf->offRead = (pMixBuf->offRead + cSamplesRead) % pMixBuf->cSamples;
     Assert(pMixBuf->offRead <= pMixBuf->cSamples);
@@ -202,7 +208,7 @@ void AudioMixBufClear(PPDMAUDIOMIXBUF pMixBuf)
     AssertPtrReturnVoid(pMixBuf);
 
     if (pMixBuf->cSamples)
-        RT_BZERO(pMixBuf->pSamples, pMixBuf->cSamples * sizeof(PDMAUDIOSAMPLE));
+        RT_BZERO(pMixBuf->pai32Samples, (size_t)pMixBuf->cSamples * pMixBuf->cChannels * sizeof(int32_t));
 }
 
 /**
@@ -241,7 +247,8 @@ void AudioMixBufFinish(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamplesToClear)
 
         AUDMIXBUF_LOG(("Clearing1: %RU32 - %RU32\n", cClearOff, cClearOff + cClearLen));
 
-        RT_BZERO(pMixBuf->pSamples + cClearOff, cClearLen * sizeof(PDMAUDIOSAMPLE));
+        RT_BZERO(pMixBuf->pai32Samples + (size_t)cClearOff * pMixBuf->cChannels,
+                 (size_t)cClearLen * pMixBuf->cChannels * sizeof(int32_t));
 
         Assert(cSamplesToClear >= cClearLen);
         cSamplesToClear -= cClearLen;
@@ -260,7 +267,8 @@ void AudioMixBufFinish(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamplesToClear)
 
         AUDMIXBUF_LOG(("Clearing2: %RU32 - %RU32\n", cClearOff, cClearOff + cClearLen));
 
-        RT_BZERO(pMixBuf->pSamples + cClearOff, cClearLen * sizeof(PDMAUDIOSAMPLE));
+        RT_BZERO(pMixBuf->pai32Samples + (size_t)cClearOff * pMixBuf->cChannels,
+                 (size_t)cClearLen * pMixBuf->cChannels * sizeof(int32_t));
     }
 }
 
@@ -286,16 +294,17 @@ void AudioMixBufDestroy(PPDMAUDIOMIXBUF pMixBuf)
 
     if (pMixBuf->pRate)
     {
+        audioMixBufRateTerm(pMixBuf->pRate);
         RTMemFree(pMixBuf->pRate);
         pMixBuf->pRate = NULL;
     }
 
-    if (pMixBuf->pSamples)
+    if (pMixBuf->pai32Samples)
     {
         Assert(pMixBuf->cSamples);
 
-        RTMemFree(pMixBuf->pSamples);
-        pMixBuf->pSamples = NULL;
+        RTMemFree(pMixBuf->pai32Samples);
+        pMixBuf->pai32Samples = NULL;
     }
 
     pMixBuf->cSamples = 0;
@@ -359,9 +368,9 @@ static int audioMixBufAlloc(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamples)
 
     AUDMIXBUF_LOG(("%s: cSamples=%RU32\n", pMixBuf->pszName, cSamples));
 
-    size_t cbSamples = cSamples * sizeof(PDMAUDIOSAMPLE);
-    pMixBuf->pSamples = (PPDMAUDIOSAMPLE)RTMemAllocZ(cbSamples);
-    if (pMixBuf->pSamples)
+    size_t cbSamples = (size_t)cSamples * pMixBuf->cChannels * sizeof(int32_t);
+    pMixBuf->pai32Samples = (int32_t *)RTMemAllocZ(cbSamples);
+    if (pMixBuf->pai32Samples)
     {
         pMixBuf->cSamples = cSamples;
         return VINF_SUCCESS;
@@ -377,343 +386,832 @@ static int audioMixBufAlloc(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamples)
 # define AUDMIXBUF_MACRO_LOG(x) do {} while (0)
 #endif
 
+/*
+ *   Internal Sample Format
+ *
+ * The mixing buffer keeps its samples as interleaved signed 32-bit integers,
+ * one per channel of the buffer's own audio format. Every format is scaled to
+ * the full 32-bit range (e.g. S16 samples are shifted left by 16 bits), which
+ * makes the conversions plain shifts and sign flips and leaves enough
+ * headroom for the volume calculation and the resampling filter.
+ */
+
+/** Number of frames processed at once when going through a temporary buffer
+ *  on the stack (channel mapping with conversion or resampling). */
+#define AUDIOMIXBUF_TMP_FRAMES      128
+
+/**
+ * Decodes (or encodes) a run of samples of one particular sample size.
+ *
+ * @param   pi32            The internal samples.
+ * @param   pvExt           The external samples.
+ * @param   cSamples        Number of samples (not frames) to process.
+ * @param   uFlip           Sign bit to flip for unsigned formats, 0 for signed ones.
+ */
+typedef void FNAUDMIXBUFDECODE(int32_t *pi32, void const *pvExt, size_t cSamples, uint32_t uFlip);
+/** Pointer to a sample decoder. */
+typedef FNAUDMIXBUFDECODE *PFNAUDMIXBUFDECODE;
+/** @copydoc FNAUDMIXBUFDECODE */
+typedef void FNAUDMIXBUFENCODE(void *pvExt, int32_t const *pi32, size_t cSamples, uint32_t uFlip);
+/** Pointer to a sample encoder. */
+typedef FNAUDMIXBUFENCODE *PFNAUDMIXBUFENCODE;
+
+/** Decodes 8-bit samples. */
+static void audioMixBufDecode8(int32_t *pi32Dst, void const *pvSrc, size_t cSamples, uint32_t uFlip)
+{
+    uint8_t const *pbSrc = (uint8_t const *)pvSrc;
+    size_t i = 0;
+#ifdef RT_ARCH_AMD64
+    __m128i const uZero  = _mm_setzero_si128();
+    __m128i const uFlipV = _mm_set1_epi8((char)uFlip);
+    for (; i + 16 <= cSamples; i += 16)
+    {
+        __m128i const uSrc = _mm_xor_si128(_mm_loadu_si128((__m128i const *)&pbSrc[i]), uFlipV);
+        __m128i const uLo  = _mm_unpacklo_epi8(uZero, uSrc);
+        __m128i const uHi  = _mm_unpackhi_epi8(uZero, uSrc);
+        _mm_storeu_si128((__m128i *)&pi32Dst[i],      _mm_unpacklo_epi16(uZero, uLo));
+        _mm_storeu_si128((__m128i *)&pi32Dst[i + 4],  _mm_unpackhi_epi16(uZero, uLo));
+        _mm_storeu_si128((__m128i *)&pi32Dst[i + 8],  _mm_unpacklo_epi16(uZero, uHi));
+        _mm_storeu_si128((__m128i *)&pi32Dst[i + 12], _mm_unpackhi_epi16(uZero, uHi));
+    }
+#endif
+    for (; i < cSamples; i++)
+        pi32Dst[i] = (int32_t)((uint32_t)(uint8_t)(pbSrc[i] ^ uFlip) << 24);
+}
+
+/** Decodes 16-bit samples. */
+static void audioMixBufDecode16(int32_t *pi32Dst, void const *pvSrc, size_t cSamples, uint32_t uFlip)
+{
+    uint16_t const *pu16Src = (uint16_t const *)pvSrc;
+    size_t i = 0;
+#ifdef RT_ARCH_AMD64
+    __m128i const uZero  = _mm_setzero_si128();
+    __m128i const uFlipV = _mm_set1_epi16((short)uFlip);
+    for (; i + 8 <= cSamples; i += 8)
+    {
+        __m128i const uSrc = _mm_xor_si128(_mm_loadu_si128((__m128i const *)&pu16Src[i]), uFlipV);
+        _mm_storeu_si128((__m128i *)&pi32Dst[i],     _mm_unpacklo_epi16(uZero, uSrc));
+        _mm_storeu_si128((__m128i *)&pi32Dst[i + 4], _mm_unpackhi_epi16(uZero, uSrc));
+    }
+#endif
+    for (; i < cSamples; i++)
+        pi32Dst[i] = (int32_t)((uint32_t)(uint16_t)(pu16Src[i] ^ uFlip) << 16);
+}
+
+/** Decodes 32-bit samples. */
+static void audioMixBufDecode32(int32_t *pi32Dst, void const *pvSrc, size_t cSamples, uint32_t uFlip)
+{
+    if (!uFlip)
+    {
+        memcpy(pi32Dst, pvSrc, cSamples * sizeof(int32_t));
+        return;
+    }
+    uint32_t const *pu32Src = (uint32_t const *)pvSrc;
+    size_t i = 0;
+#ifdef RT_ARCH_AMD64
+    __m128i const uFlipV = _mm_set1_epi32((int)uFlip);
+    for (; i + 4 <= cSamples; i += 4)
+        _mm_storeu_si128((__m128i *)&pi32Dst[i], _mm_xor_si128(_mm_loadu_si128((__m128i const *)&pu32Src[i]), uFlipV));
+#endif
+    for (; i < cSamples; i++)
+        pi32Dst[i] = (int32_t)(pu32Src[i] ^ uFlip);
+}
+
+/** Encodes 8-bit samples. */
+static void audioMixBufEncode8(void *pvDst, int32_t const *pi32Src, size_t cSamples, uint32_t uFlip)
+{
+    uint8_t *pbDst = (uint8_t *)pvDst;
+    size_t i = 0;
+#ifdef RT_ARCH_AMD64
+    __m128i const uFlipV = _mm_set1_epi8((char)uFlip);
+    for (; i + 16 <= cSamples; i += 16)
+    {
+        /* The shifted values are always in range, so the saturation of the packing never kicks in. */
+        __m128i const uLo = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i]), 24),
+                                            _mm_srai_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i + 4]), 24));
+        __m128i const uHi = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i + 8]), 24),
+                                            _mm_srai_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i + 12]), 24));
+        _mm_storeu_si128((__m128i *)&pbDst[i], _mm_xor_si128(_mm_packs_epi16(uLo, uHi), uFlipV));
+    }
+#endif
+    for (; i < cSamples; i++)
+        pbDst[i] = (uint8_t)(((uint32_t)pi32Src[i] >> 24) ^ uFlip);
+}
+
+/** Encodes 16-bit samples. */
+static void audioMixBufEncode16(void *pvDst, int32_t const *pi32Src, size_t cSamples, uint32_t uFlip)
+{
+    uint16_t *pu16Dst = (uint16_t *)pvDst;
+    size_t i = 0;
+#ifdef RT_ARCH_AMD64
+    __m128i const uFlipV = _mm_set1_epi16((short)uFlip);
+    for (; i + 8 <= cSamples; i += 8)
+    {
+        __m128i const uRes = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i]), 16),
+                                             _mm_srai_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i + 4]), 16));
+        _mm_storeu_si128((__m128i *)&pu16Dst[i], _mm_xor_si128(uRes, uFlipV));
+    }
+#endif
+    for (; i < cSamples; i++)
+        pu16Dst[i] = (uint16_t)(((uint32_t)pi32Src[i] >> 16) ^ uFlip);
+}
+
+/** Encodes 32-bit samples. */
+static void audioMixBufEncode32(void *pvDst, int32_t const *pi32Src, size_t cSamples, uint32_t uFlip)
+{
+    if (!uFlip)
+    {
+        memcpy(pvDst, pi32Src, cSamples * sizeof(int32_t));
+        return;
+    }
+    uint32_t *pu32Dst = (uint32_t *)pvDst;
+    size_t i = 0;
+#ifdef RT_ARCH_AMD64
+    __m128i const uFlipV = _mm_set1_epi32((int)uFlip);
+    for (; i + 4 <= cSamples; i += 4)
+        _mm_storeu_si128((__m128i *)&pu32Dst[i], _mm_xor_si128(_mm_loadu_si128((__m128i const *)&pi32Src[i]), uFlipV));
+#endif
+    for (; i < cSamples; i++)
+        pu32Dst[i] = (uint32_t)pi32Src[i] ^ uFlip;
+}
+
+/**
+ * Maps interleaved frames from one channel count to another.
+ *
+ * Mono is duplicated to all channels and everything is averaged when going
+ * to mono. Otherwise the common channels are copied and any additional
+ * destination channels are silenced.
+ *
+ * @param   pi32Dst         Where to store the mapped frames.
+ * @param   cDstChannels    Number of destination channels.
+ * @param   pi32Src         The source frames.
+ * @param   cSrcChannels    Number of source channels.
+ * @param   cFrames         Number of frames to map.
+ */
+static void audioMixBufMapChannels(int32_t *pi32Dst, uint8_t cDstChannels, int32_t const *pi32Src, uint8_t cSrcChannels,
+                                   uint32_t cFrames)
+{
+    if (cDstChannels == cSrcChannels)
+    {
+        memcpy(pi32Dst, pi32Src, (size_t)cFrames * cSrcChannels * sizeof(int32_t));
+        return;
+    }
+
+    uint32_t i = 0;
+    if (cSrcChannels == 1)
+    {
+#ifdef RT_ARCH_AMD64
+        if (cDstChannels == 2)
+            for (; i + 4 <= cFrames; i += 4)
+            {
+                __m128i const uSrc = _mm_loadu_si128((__m128i const *)&pi32Src[i]);
+                _mm_storeu_si128((__m128i *)&pi32Dst[i * 2],     _mm_unpacklo_epi32(uSrc, uSrc));
+                _mm_storeu_si128((__m128i *)&pi32Dst[i * 2 + 4], _mm_unpackhi_epi32(uSrc, uSrc));
+            }
+#endif
+        for (; i < cFrames; i++)
+            for (uint8_t iCh = 0; iCh < cDstChannels; iCh++)
+                pi32Dst[i * cDstChannels + iCh] = pi32Src[i];
+    }
+    else if (cDstChannels == 1)
+    {
+#ifdef RT_ARCH_AMD64
+        if (cSrcChannels == 2)
+        {
+            __m128i const uOne = _mm_set1_epi32(1);
+            for (; i + 4 <= cFrames; i += 4)
+            {
+                __m128i const uA = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i * 2]),     0xd8);
+                __m128i const uB = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const *)&pi32Src[i * 2 + 4]), 0xd8);
+                __m128i const uL = _mm_unpacklo_epi64(uA, uB);
+                __m128i const uR = _mm_unpackhi_epi64(uA, uB);
+                /* floor((L + R) / 2) without overflowing, then round towards zero like the scalar division. */
+                __m128i uAvg = _mm_add_epi32(_mm_add_epi32(_mm_srai_epi32(uL, 1), _mm_srai_epi32(uR, 1)),
+                                             _mm_and_si128(_mm_and_si128(uL, uR), uOne));
+                uAvg = _mm_add_epi32(uAvg, _mm_and_si128(_mm_srli_epi32(uAvg, 31), _mm_xor_si128(uL, uR)));
+                _mm_storeu_si128((__m128i *)&pi32Dst[i], uAvg);
+            }
+        }
+#endif
+        for (; i < cFrames; i++)
+        {
+            int64_t iSum = 0;
+            for (uint8_t iCh = 0; iCh < cSrcChannels; iCh++)
+                iSum += pi32Src[i * cSrcChannels + iCh];
+            pi32Dst[i] = (int32_t)(iSum / cSrcChannels);
+        }
+    }
+    else
+    {
+        uint8_t const cCopy = RT_MIN(cSrcChannels, cDstChannels);
+        for (; i < cFrames; i++)
+        {
+            uint8_t iCh = 0;
+            for (; iCh < cCopy; iCh++)
+                pi32Dst[i * cDstChannels + iCh] = pi32Src[i * cSrcChannels + iCh];
+            for (; iCh < cDstChannels; iCh++)
+                pi32Dst[i * cDstChannels + iCh] = 0;
+        }
+    }
+}
+
+/**
+ * Applies a mixing buffer volume to interleaved frames.
+ *
+ * Even channels get the left volume, odd channels the right one. Mono frames
+ * get the average of the individually attenuated values, which is what a
+ * stereo stream down mixed to mono would end up with.
+ *
+ * @param   pi32            The frames to modify.
+ * @param   cFrames         Number of frames.
+ * @param   cChannels       Number of channels per frame.
+ * @param   pVol            The volume to apply.
+ */
+static void audioMixBufApplyVolume(int32_t *pi32, uint32_t cFrames, uint8_t cChannels, PDMAUDMIXBUFVOL const *pVol)
+{
+    /* 16.16 fixed point multipliers, 0x10000 being 0dB. */
+    uint32_t const uLeft  = pVol->uLeft  >> (AUDIOMIXBUF_VOL_SHIFT - 16);
+    uint32_t const uRight = pVol->uRight >> (AUDIOMIXBUF_VOL_SHIFT - 16);
+    if (   uLeft  == RT_BIT_32(16)
+        && uRight == RT_BIT_32(16))
+        return;
+
+    size_t const cSamples = (size_t)cFrames * cChannels;
+    size_t       i        = 0;
+    if (cChannels == 1 && uLeft != uRight)
+    {
+        for (; i < cSamples; i++)
+            pi32[i] = (int32_t)((((int64_t)pi32[i] * uLeft >> 16) + ((int64_t)pi32[i] * uRight >> 16)) / 2);
+        return;
+    }
+
+#ifdef RT_ARCH_AMD64
+    if (cChannels == 1 || !(cChannels & 1))
+    {
+        /* Unsigned 32x32->64 multiplications, fixing up the result for negative samples by subtracting
+           the multiplier shifted into place. Bits 16..47 of the product are the result. */
+        __m128i const uVol    = _mm_set_epi32((int)uRight, (int)uLeft, (int)uRight, (int)uLeft);
+        __m128i const uVolOdd = _mm_srli_epi64(uVol, 32);
+        __m128i const uFixup  = _mm_slli_epi32(uVol, 16);
+        __m128i const uMaskLo = _mm_set_epi32(0, -1, 0, -1);
+        for (; i + 4 <= cSamples; i += 4)
+        {
+            __m128i const uSrc  = _mm_loadu_si128((__m128i const *)&pi32[i]);
+            __m128i const uEven = _mm_srli_epi64(_mm_mul_epu32(uSrc, uVol), 16);
+            __m128i const uOdd  = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(uSrc, 32), uVolOdd), 16);
+            __m128i       uRes  = _mm_or_si128(_mm_and_si128(uEven, uMaskLo), _mm_slli_epi64(uOdd, 32));
+            uRes = _mm_sub_epi32(uRes, _mm_and_si128(_mm_srai_epi32(uSrc, 31), uFixup));
+            _mm_storeu_si128((__m128i *)&pi32[i], uRes);
+        }
+    }
+#endif
+    for (; i < cSamples; i++)
+        pi32[i] = (int32_t)((int64_t)pi32[i] * ((i % cChannels) & 1 ? uRight : uLeft) >> 16);
+}
+
+/**
+ * Worker for the conversion-from functions.
+ */
+DECL_FORCE_INLINE(uint32_t) audioMixBufConvFromWorker(int32_t *pai32Dst, const void *pvSrc, uint32_t cbSrc,
+                                                      PCPDMAUDMIXBUFCONVOPTS pOpts, PFNAUDMIXBUFDECODE pfnDecode,
+                                                      uint32_t cbSample, uint32_t uFlip)
+{
+    uint8_t const  cSrcChannels = pOpts->cSrcChannels;
+    uint8_t const  cDstChannels = pOpts->cDstChannels;
+    uint32_t const cFrames      = RT_MIN(pOpts->cSamples, cbSrc / (cbSample * cSrcChannels));
+    AUDMIXBUF_MACRO_LOG(("cFrames=%RU32, BpS=%RU32, cCh=%RU8->%RU8, lVol=%RU32, rVol=%RU32\n", cFrames, cbSample,
+                         cSrcChannels, cDstChannels, pOpts->From.Volume.uLeft, pOpts->From.Volume.uRight));
+
+    if (cSrcChannels == cDstChannels)
+    {
+        pfnDecode(pai32Dst, pvSrc, (size_t)cFrames * cSrcChannels, uFlip);
+        audioMixBufApplyVolume(pai32Dst, cFrames, cDstChannels, &pOpts->From.Volume);
+        return cFrames;
+    }
+
+    /* The volume is applied on the side with more channels so that e.g. stereo
+       streams are attenuated per channel before getting down mixed. */
+    int32_t        ai32Tmp[AUDIOMIXBUF_TMP_FRAMES * AUDIOMIXBUF_MAX_CHANNELS];
+    uint8_t const *pbSrc = (uint8_t const *)pvSrc;
+    for (uint32_t offFrame = 0; offFrame < cFrames; offFrame += AUDIOMIXBUF_TMP_FRAMES)
+    {
+        uint32_t const cChunk = RT_MIN(cFrames - offFrame, AUDIOMIXBUF_TMP_FRAMES);
+        int32_t       *pi32   = &pai32Dst[(size_t)offFrame * cDstChannels];
+        pfnDecode(ai32Tmp, &pbSrc[(size_t)offFrame * cbSample * cSrcChannels], (size_t)cChunk * cSrcChannels, uFlip);
+        if (cSrcChannels > cDstChannels)
+        {
+            audioMixBufApplyVolume(ai32Tmp, cChunk, cSrcChannels, &pOpts->From.Volume);
+            audioMixBufMapChannels(pi32, cDstChannels, ai32Tmp, cSrcChannels, cChunk);
+        }
+        else
+        {
+            audioMixBufMapChannels(pi32, cDstChannels, ai32Tmp, cSrcChannels, cChunk);
+            audioMixBufApplyVolume(pi32, cChunk, cDstChannels, &pOpts->From.Volume);
+        }
+    }
+    return cFrames;
+}
+
+/**
+ * Worker for the conversion-to functions.
+ */
+DECL_FORCE_INLINE(void) audioMixBufConvToWorker(void *pvDst, int32_t const *pai32Src, PCPDMAUDMIXBUFCONVOPTS pOpts,
+                                                PFNAUDMIXBUFENCODE pfnEncode, uint32_t cbSample, uint32_t uFlip)
+{
+    uint8_t const  cSrcChannels = pOpts->cSrcChannels;
+    uint8_t const  cDstChannels = pOpts->cDstChannels;
+    uint32_t const cFrames      = pOpts->cSamples;
+    AUDMIXBUF_MACRO_LOG(("cFrames=%RU32, BpS=%RU32, cCh=%RU8->%RU8\n", cFrames, cbSample, cSrcChannels, cDstChannels));
+
+    if (cSrcChannels == cDstChannels)
+    {
+        pfnEncode(pvDst, pai32Src, (size_t)cFrames * cDstChannels, uFlip);
+        return;
+    }
+
+    int32_t  ai32Tmp[AUDIOMIXBUF_TMP_FRAMES * AUDIOMIXBUF_MAX_CHANNELS];
+    uint8_t *pbDst = (uint8_t *)pvDst;
+    for (uint32_t offFrame = 0; offFrame < cFrames; offFrame += AUDIOMIXBUF_TMP_FRAMES)
+    {
+        uint32_t const cChunk = RT_MIN(cFrames - offFrame, AUDIOMIXBUF_TMP_FRAMES);
+        audioMixBufMapChannels(ai32Tmp, cDstChannels, &pai32Src[(size_t)offFrame * cSrcChannels], cSrcChannels, cChunk);
+        pfnEncode(&pbDst[(size_t)offFrame * cbSample * cDstChannels], ai32Tmp, (size_t)cChunk * cDstChannels, uFlip);
+    }
+}
+
 /**
  * Macro for generating the conversion routines from/to different formats.
- * Be careful what to pass in/out, as most of the macros are optimized for speed and
- * thus don't do any bounds checking!
  *
  * Note: Currently does not handle any endianness conversion yet!
  */
-#define AUDMIXBUF_CONVERT(_aName, _aType, _aMin, _aMax, _aSigned, _aShift) \
-    /* Clips a specific output value to a single sample value. */ \
-    DECLCALLBACK(int64_t) audioMixBufClipFrom##_aName(_aType aVal) \
-    { \
-        if (_aSigned) \
-            return ((int64_t) aVal) << (32 - _aShift); \
-        return ((int64_t) aVal - ((_aMax >> 1) + 1)) << (32 - _aShift); \
-    } \
-    \
-    /* Clips a single sample value to a specific output value. */ \
-    DECLCALLBACK(_aType) audioMixBufClipTo##_aName(int64_t iVal) \
-    { \
-        if (iVal >= 0x7fffffff) \
-            return _aMax; \
-        if (iVal < -INT64_C(0x80000000)) \
-            return _aMin; \
-        \
-        if (_aSigned) \
-            return (_aType) (iVal >> (32 - _aShift)); \
-        return ((_aType) ((iVal >> (32 - _aShift)) + ((_aMax >> 1) + 1))); \
-    } \
-    \
-    DECLCALLBACK(uint32_t) audioMixBufConvFrom##_aName##Stereo(PPDMAUDIOSAMPLE paDst, const void *pvSrc, uint32_t cbSrc, \
-                                                               PCPDMAUDMIXBUFCONVOPTS pOpts) \
+#define AUDMIXBUF_CONVERT(_aName, _aBits, _aFlip) \
+    static DECLCALLBACK(uint32_t) audioMixBufConvFrom##_aName(int32_t *pai32Dst, const void *pvSrc, uint32_t cbSrc, \
+                                                              PCPDMAUDMIXBUFCONVOPTS pOpts) \
     { \
-        _aType const *pSrc = (_aType const *)pvSrc; \
-        uint32_t cSamples = RT_MIN(pOpts->cSamples, cbSrc / sizeof(_aType)); \
-        AUDMIXBUF_MACRO_LOG(("cSamples=%RU32, BpS=%zu, lVol=%RU32, rVol=%RU32\n", \
-                             pOpts->cSamples, sizeof(_aType), pOpts->From.Volume.uLeft, pOpts->From.Volume.uRight)); \
-        for (uint32_t i = 0; i < cSamples; i++) \
-        { \
-            paDst->i64LSample = ASMMult2xS32RetS64((int32_t)audioMixBufClipFrom##_aName(*pSrc++), pOpts->From.Volume.uLeft ) >> AUDIOMIXBUF_VOL_SHIFT; \
-            paDst->i64RSample = ASMMult2xS32RetS64((int32_t)audioMixBufClipFrom##_aName(*pSrc++), pOpts->From.Volume.uRight) >> AUDIOMIXBUF_VOL_SHIFT; \
-            paDst++; \
-        } \
-        \
-        return cSamples; \
+        return audioMixBufConvFromWorker(pai32Dst, pvSrc, cbSrc, pOpts, audioMixBufDecode##_aBits, _aBits / 8, _aFlip); \
     } \
     \
-    DECLCALLBACK(uint32_t) audioMixBufConvFrom##_aName##Mono(PPDMAUDIOSAMPLE paDst, const void *pvSrc, uint32_t cbSrc, \
-                                                             PCPDMAUDMIXBUFCONVOPTS pOpts) \
+    static DECLCALLBACK(void) audioMixBufConvTo##_aName(void *pvDst, int32_t const *pai32Src, PCPDMAUDMIXBUFCONVOPTS pOpts) \
     { \
-        _aType const *pSrc = (_aType const *)pvSrc; \
-        const uint32_t cSamples = RT_MIN(pOpts->cSamples, cbSrc / sizeof(_aType)); \
-        AUDMIXBUF_MACRO_LOG(("cSamples=%RU32, BpS=%zu, lVol=%RU32, rVol=%RU32\n", \
-                             cSamples, sizeof(_aType), pOpts->From.Volume.uLeft, pOpts->From.Volume.uRight)); \
-        for (uint32_t i = 0; i < cSamples; i++) \
-        { \
-            paDst->i64LSample = ASMMult2xS32RetS64((int32_t)audioMixBufClipFrom##_aName(*pSrc), pOpts->From.Volume.uLeft)  >> AUDIOMIXBUF_VOL_SHIFT; \
-            paDst->i64RSample = ASMMult2xS32RetS64((int32_t)audioMixBufClipFrom##_aName(*pSrc), pOpts->From.Volume.uRight) >> AUDIOMIXBUF_VOL_SHIFT; \
-            pSrc++; \
-            paDst++; \
-        } \
-        \
-        return cSamples; \
-    } \
-    \
-    DECLCALLBACK(void) audioMixBufConvTo##_aName##Stereo(void *pvDst, PCPDMAUDIOSAMPLE paSrc, PCPDMAUDMIXBUFCONVOPTS pOpts) \
-    { \
-        PCPDMAUDIOSAMPLE pSrc = paSrc; \
-        _aType *pDst = (_aType *)pvDst; \
-        _aType l, r; \
-        uint32_t cSamples = pOpts->cSamples; \
-        while (cSamples--) \
-        { \
-            AUDMIXBUF_MACRO_LOG(("%p: l=%RI64, r=%RI64\n", pSrc, pSrc->i64LSample, pSrc->i64RSample)); \
-            l = audioMixBufClipTo##_aName(pSrc->i64LSample); \
-            r = audioMixBufClipTo##_aName(pSrc->i64RSample); \
-            AUDMIXBUF_MACRO_LOG(("\t-> l=%RI16, r=%RI16\n", l, r)); \
-            *pDst++ = l; \
-            *pDst++ = r; \
-            pSrc++; \
-        } \
-    } \
-    \
-    DECLCALLBACK(void) audioMixBufConvTo##_aName##Mono(void *pvDst, PCPDMAUDIOSAMPLE paSrc, PCPDMAUDMIXBUFCONVOPTS pOpts) \
-    { \
-        PCPDMAUDIOSAMPLE pSrc = paSrc; \
-        _aType *pDst = (_aType *)pvDst; \
-        uint32_t cSamples = pOpts->cSamples; \
-        while (cSamples--) \
-        { \
-            *pDst++ = audioMixBufClipTo##_aName((pSrc->i64LSample + pSrc->i64RSample) / 2); \
-            pSrc++; \
-        } \
+        audioMixBufConvToWorker(pvDst, pai32Src, pOpts, audioMixBufEncode##_aBits, _aBits / 8, _aFlip); \
     }
 
 /* audioMixBufConvXXXS8: 8 bit, signed. */
-AUDMIXBUF_CONVERT(S8 /* Name */,  int8_t,   INT8_MIN  /* Min */, INT8_MAX   /* Max */, true  /* fSigned */, 8  /* cShift */)
+AUDMIXBUF_CONVERT(S8  /* Name */, 8  /* cBits */, 0          /* uFlip */)
 /* audioMixBufConvXXXU8: 8 bit, unsigned. */
-AUDMIXBUF_CONVERT(U8 /* Name */,  uint8_t,  0         /* Min */, UINT8_MAX  /* Max */, false /* fSigned */, 8  /* cShift */)
+AUDMIXBUF_CONVERT(U8  /* Name */, 8  /* cBits */, 0x80       /* uFlip */)
 /* audioMixBufConvXXXS16: 16 bit, signed. */
-AUDMIXBUF_CONVERT(S16 /* Name */, int16_t,  INT16_MIN /* Min */, INT16_MAX  /* Max */, true  /* fSigned */, 16 /* cShift */)
+AUDMIXBUF_CONVERT(S16 /* Name */, 16 /* cBits */, 0          /* uFlip */)
 /* audioMixBufConvXXXU16: 16 bit, unsigned. */
-AUDMIXBUF_CONVERT(U16 /* Name */, uint16_t, 0         /* Min */, UINT16_MAX /* Max */, false /* fSigned */, 16 /* cShift */)
+AUDMIXBUF_CONVERT(U16 /* Name */, 16 /* cBits */, 0x8000     /* uFlip */)
 /* audioMixBufConvXXXS32: 32 bit, signed. */
-AUDMIXBUF_CONVERT(S32 /* Name */, int32_t,  INT32_MIN /* Min */, INT32_MAX  /* Max */, true  /* fSigned */, 32 /* cShift */)
+AUDMIXBUF_CONVERT(S32 /* Name */, 32 /* cBits */, 0          /* uFlip */)
 /* audioMixBufConvXXXU32: 32 bit, unsigned. */
-AUDMIXBUF_CONVERT(U32 /* Name */, uint32_t, 0         /* Min */, UINT32_MAX /* Max */, false /* fSigned */, 32 /* cShift */)
+AUDMIXBUF_CONVERT(U32 /* Name */, 32 /* cBits */, 0x80000000 /* uFlip */)
 
 #undef AUDMIXBUF_CONVERT
 
-#define AUDMIXBUF_MIXOP(_aName, _aOp) \
-    static void audioMixBufOp##_aName(PPDMAUDIOSAMPLE paDst, uint32_t cDstSamples, \
-                                      PPDMAUDIOSAMPLE paSrc, uint32_t cSrcSamples, \
-                                      PPDMAUDIOSTRMRATE pRate, \
-                                      uint32_t *pcDstWritten, uint32_t *pcSrcRead) \
-    { \
-        AUDMIXBUF_MACRO_LOG(("cSrcSamples=%RU32, cDstSamples=%RU32\n", cSrcSamples, cDstSamples)); \
-        AUDMIXBUF_MACRO_LOG(("Rate: srcOffset=%RU32, dstOffset=%RU32, dstInc=%RU32\n", \
-                             pRate->srcOffset, \
-                             (uint32_t)(pRate->dstOffset >> 32), (uint32_t)(pRate->dstInc >> 32))); \
-        \
-        if (pRate->dstInc == (UINT64_C(1) + UINT32_MAX)) /* No conversion needed? */ \
-        { \
-            uint32_t cSamples = RT_MIN(cSrcSamples, cDstSamples); \
-            AUDMIXBUF_MACRO_LOG(("cSamples=%RU32\n", cSamples)); \
-            for (uint32_t i = 0; i < cSamples; i++) \
-            { \
-                paDst[i].i64LSample _aOp paSrc[i].i64LSample; \
-                paDst[i].i64RSample _aOp paSrc[i].i64RSample; \
-            } \
-            \
-            if (pcDstWritten) \
-                *pcDstWritten = cSamples; \
-            if (pcSrcRead) \
-                *pcSrcRead = cSamples; \
-            return; \
-        } \
-        \
-        PPDMAUDIOSAMPLE paSrcStart = paSrc; \
-        PPDMAUDIOSAMPLE paSrcEnd   = paSrc + cSrcSamples; \
-        PPDMAUDIOSAMPLE paDstStart = paDst; \
-        PPDMAUDIOSAMPLE paDstEnd   = paDst + cDstSamples; \
-        PDMAUDIOSAMPLE  samCur     = { 0 }; \
-        PDMAUDIOSAMPLE  samOut; \
-        PDMAUDIOSAMPLE  samLast    = pRate->srcSampleLast; \
-        \
-        while (paDst < paDstEnd) \
-        { \
-            Assert(paSrc <= paSrcEnd); \
-            Assert(paDst <= paDstEnd); \
-            if (paSrc >= paSrcEnd) \
-                break; \
-            \
-            while (pRate->srcOffset <= (pRate->dstOffset >> 32)) \
-            { \
-                Assert(paSrc <= paSrcEnd); \
-                samLast = *paSrc++; \
-                pRate->srcOffset++; \
-                if (paSrc == paSrcEnd) \
-                    break; \
-            } \
-            \
-            Assert(paSrc <= paSrcEnd); \
-            if (paSrc == paSrcEnd) \
-                break; \
-            \
-            samCur = *paSrc; \
-            \
-            /* Interpolate. */ \
-            int64_t iDstOffInt = pRate->dstOffset & UINT32_MAX; \
-            \
-            samOut.i64LSample = (samLast.i64LSample * ((int64_t) (INT64_C(1) << 32) - iDstOffInt) + samCur.i64LSample * iDstOffInt) >> 32; \
-            samOut.i64RSample = (samLast.i64RSample * ((int64_t) (INT64_C(1) << 32) - iDstOffInt) + samCur.i64RSample * iDstOffInt) >> 32; \
-            \
-            paDst->i64LSample _aOp samOut.i64LSample; \
-            paDst->i64RSample _aOp samOut.i64RSample; \
-            \
-            AUDMIXBUF_MACRO_LOG(("\tiDstOffInt=%RI64, l=%RI64, r=%RI64 (cur l=%RI64, r=%RI64)\n", \
-                                 iDstOffInt, \
-                                 paDst->i64LSample >> 32, paDst->i64RSample >> 32, \
-                                 samCur.i64LSample >> 32, samCur.i64RSample >> 32)); \
-            \
-            paDst++; \
-            pRate->dstOffset += pRate->dstInc; \
-            \
-            AUDMIXBUF_MACRO_LOG(("\t\tpRate->dstOffset=%RU32\n", pRate->dstOffset >> 32)); \
-            \
-        } \
-        \
-        AUDMIXBUF_MACRO_LOG(("%zu source samples -> %zu dest samples\n", paSrc - paSrcStart, paDst - paDstStart)); \
-        \
-        pRate->srcSampleLast = samLast; \
-        \
-        AUDMIXBUF_MACRO_LOG(("pRate->srcSampleLast l=%RI64, r=%RI64\n", \
-                              pRate->srcSampleLast.i64LSample, pRate->srcSampleLast.i64RSample)); \
-        \
-        if (pcDstWritten) \
-            *pcDstWritten = paDst - paDstStart; \
-        if (pcSrcRead) \
-            *pcSrcRead = paSrc - paSrcStart; \
-    }
-
-/* audioMixBufOpAssign: Assigns values from source buffer to destination bufffer, overwriting the destination. */
-AUDMIXBUF_MIXOP(Assign /* Name */,  = /* Operation */)
-#if 0 /* unused */
-/* audioMixBufOpBlend: Blends together the values from both, the source and the destination buffer. */
-AUDMIXBUF_MIXOP(Blend  /* Name */, += /* Operation */)
+/*
+ *   Rate Conversion
+ *
+ * The rate conversion uses a windowed sinc filter (Blackman window) with a
+ * table of AUDIOMIXBUF_RESAMPLE_PHASES precomputed phases; the coefficients
+ * for the exact output position are linearly interpolated between the two
+ * nearest phases. When upsampling the cutoff is the source's Nyquist
+ * frequency, so output frames at source frame positions are exact copies of
+ * the source. When downsampling the cutoff is moved below the destination's
+ * Nyquist frequency and the filter is widened accordingly.
+ *
+ * Each output frame needs the source frames up to AUDIOMIXBUF_RESAMPLE_HALF_TAPS
+ * (or the widened equivalent) frames after its position, so that many source
+ * frames are held back in the filter history until more input arrives.
+ */
+
+/** Number of precomputed filter phases, as a power of two. */
+#define AUDIOMIXBUF_RESAMPLE_PHASES_SHIFT   6
+/** Number of precomputed filter phases. */
+#define AUDIOMIXBUF_RESAMPLE_PHASES         RT_BIT_32(AUDIOMIXBUF_RESAMPLE_PHASES_SHIFT)
+/** Maximum half length of the filter, limiting the width when downsampling by large ratios. */
+#define AUDIOMIXBUF_RESAMPLE_HALF_TAPS_MAX  32
+/** Pi, math.h doesn't define M_PI everywhere. */
+#define AUDIOMIXBUF_PI                      3.14159265358979323846
+
+AssertCompile(!(AUDIOMIXBUF_RESAMPLE_HALF_TAPS & 1) && !(AUDIOMIXBUF_RESAMPLE_HALF_TAPS_MAX & 1));
+
+/**
+ * Calculates a windowed sinc filter coefficient.
+ *
+ * @returns The coefficient (not normalized).
+ * @param   dCutoff         Cutoff frequency relative to the source's Nyquist frequency.
+ * @param   dT              Distance from the filter center (in source frames).
+ * @param   cHalfTaps       Half length of the filter.
+ */
+static double audioMixBufRateCoef(double dCutoff, double dT, uint32_t cHalfTaps)
+{
+    double dSinc;
+    if (dT == 0.0)
+        dSinc = dCutoff;
+    else if (dCutoff == 1.0 && dT == floor(dT))
+        dSinc = 0.0; /* Exact zero crossings, so integer positions pass through unmodified. */
+    else
+        dSinc = sin(AUDIOMIXBUF_PI * dCutoff * dT) / (AUDIOMIXBUF_PI * dT);
+
+    double const dX = AUDIOMIXBUF_PI * dT / cHalfTaps;
+    return dSinc * (0.42 + 0.5 * cos(dX) + 0.08 * cos(2.0 * dX));
+}
+
+/**
+ * Resets the rate conversion state, keeping the filter.
+ *
+ * @param   pRate           The rate conversion state.
+ */
+static void audioMixBufRateReset(PPDMAUDIOSTRMRATE pRate)
+{
+    pRate->dstOffset  = 0;
+    pRate->srcOffset  = 0;
+    pRate->offHistory = 0;
+    if (pRate->pafHistory)
+        RT_BZERO(pRate->pafHistory, (size_t)pRate->cChannels * 2 * pRate->cTaps * sizeof(float));
+}
+
+/**
+ * Frees the filter tables of a rate conversion state.
+ *
+ * @param   pRate           The rate conversion state.
+ */
+static void audioMixBufRateTerm(PPDMAUDIOSTRMRATE pRate)
+{
+    RTMemFree(pRate->pafCoefs);
+    pRate->pafCoefs = NULL;
+    RTMemFree(pRate->pafHistory);
+    pRate->pafHistory = NULL;
+    pRate->cTaps = 0;
+}
+
+/**
+ * (Re-)initializes a rate conversion state.
+ *
+ * @returns IPRT status code.
+ * @param   pRate           The rate conversion state.
+ * @param   uSrcHz          Source sample frequency.
+ * @param   uDstHz          Destination sample frequency.
+ * @param   cChannels       Number of channels of the source.
+ */
+static int audioMixBufRateInit(PPDMAUDIOSTRMRATE pRate, uint32_t uSrcHz, uint32_t uDstHz, uint8_t cChannels)
+{
+    audioMixBufRateTerm(pRate);
+    pRate->dstInc    = ((uint64_t)uSrcHz << 32) / uDstHz;
+    pRate->cChannels = cChannels;
+    audioMixBufRateReset(pRate);
+    if (pRate->dstInc == RT_BIT_64(32)) /* No conversion needed. */
+        return VINF_SUCCESS;
+
+    double   dCutoff;
+    uint32_t cHalfTaps;
+    if (uDstHz >= uSrcHz)
+    {
+        dCutoff   = 1.0;
+        cHalfTaps = AUDIOMIXBUF_RESAMPLE_HALF_TAPS;
+    }
+    else
+    {
+        double const dRatio = (double)uDstHz / uSrcHz;
+        dCutoff   = 0.95 * dRatio;
+        cHalfTaps = (uint32_t)ceil(AUDIOMIXBUF_RESAMPLE_HALF_TAPS / dRatio);
+        cHalfTaps = RT_MIN(RT_ALIGN_32(cHalfTaps, 2), AUDIOMIXBUF_RESAMPLE_HALF_TAPS_MAX);
+    }
+    uint32_t const cTaps = cHalfTaps * 2;
+
+    pRate->pafCoefs   = (float *)RTMemAlloc((AUDIOMIXBUF_RESAMPLE_PHASES + 1) * cTaps * sizeof(float));
+    pRate->pafHistory = (float *)RTMemAllocZ((size_t)cChannels * 2 * cTaps * sizeof(float));
+    if (   !pRate->pafCoefs
+        || !pRate->pafHistory)
+    {
+        audioMixBufRateTerm(pRate);
+        return VERR_NO_MEMORY;
+    }
+    pRate->cTaps = (uint16_t)cTaps;
+
+    /* Row iPhase holds the coefficients for an output position iPhase / PHASES frames after
+       source frame N, tap 0 being applied to frame N - cHalfTaps + 1. Each row is normalized
+       to unity gain. */
+    for (uint32_t iPhase = 0; iPhase <= AUDIOMIXBUF_RESAMPLE_PHASES; iPhase++)
+    {
+        double adCoefs[AUDIOMIXBUF_RESAMPLE_HALF_TAPS_MAX * 2];
+        double dSum = 0.0;
+        for (uint32_t iTap = 0; iTap < cTaps; iTap++)
+        {
+            double const dT = (double)iTap - (cHalfTaps - 1) - (double)iPhase / AUDIOMIXBUF_RESAMPLE_PHASES;
+            adCoefs[iTap] = audioMixBufRateCoef(dCutoff, dT, cHalfTaps);
+            dSum += adCoefs[iTap];
+        }
+        for (uint32_t iTap = 0; iTap < cTaps; iTap++)
+            pRate->pafCoefs[iPhase * cTaps + iTap] = (float)(adCoefs[iTap] / dSum);
+    }
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * Calculates the dot product of two float vectors.
+ *
+ * @returns The dot product.
+ * @param   paf1            The first vector.
+ * @param   paf2            The second vector.
+ * @param   c               Number of elements, multiple of four.
+ */
+DECL_FORCE_INLINE(float) audioMixBufDotF32(float const *paf1, float const *paf2, uint32_t c)
+{
+#ifdef RT_ARCH_AMD64
+    __m128 uSum = _mm_setzero_ps();
+    for (uint32_t i = 0; i < c; i += 4)
+        uSum = _mm_add_ps(uSum, _mm_mul_ps(_mm_loadu_ps(&paf1[i]), _mm_loadu_ps(&paf2[i])));
+    uSum = _mm_add_ps(uSum, _mm_movehl_ps(uSum, uSum));
+    uSum = _mm_add_ss(uSum, _mm_shuffle_ps(uSum, uSum, 1));
+    return _mm_cvtss_f32(uSum);
+#else
+    float fSum = 0.0f;
+    for (uint32_t i = 0; i < c; i++)
+        fSum += paf1[i] * paf2[i];
+    return fSum;
+#endif
+}
+
+/**
+ * Converts a filter output to a saturated internal sample.
+ */
+DECL_FORCE_INLINE(int32_t) audioMixBufRateToS32(float fValue)
+{
+    double const dValue = fValue;
+    if (dValue >= (double)INT32_MAX)
+        return INT32_MAX;
+    if (dValue <= (double)INT32_MIN)
+        return INT32_MIN;
+    return (int32_t)(dValue < 0.0 ? dValue - 0.5 : dValue + 0.5);
+}
+
+/**
+ * Converts the rate of interleaved frames, the channel count staying the same.
+ *
+ * Consumes source frames until either all of them are in the filter history
+ * or the destination is full.
+ *
+ * @param   pRate           The rate conversion state.
+ * @param   pai32Dst        Where to store the output frames.
+ * @param   cDstFrames      Maximum number of output frames.
+ * @param   pai32Src        The source frames.
+ * @param   cSrcFrames      Number of source frames.
+ * @param   pcDstWritten    Where to return the number of frames written.
+ * @param   pcSrcRead       Where to return the number of source frames consumed.
+ */
+static void audioMixBufRateConvert(PPDMAUDIOSTRMRATE pRate, int32_t *pai32Dst, uint32_t cDstFrames,
+                                   int32_t const *pai32Src, uint32_t cSrcFrames,
+                                   uint32_t *pcDstWritten, uint32_t *pcSrcRead)
+{
+    uint32_t const cTaps     = pRate->cTaps;
+    uint32_t const cHalfTaps = cTaps / 2;
+    uint8_t  const cChannels = (uint8_t)pRate->cChannels;
+    float          afCoefs[AUDIOMIXBUF_RESAMPLE_HALF_TAPS_MAX * 2];
+    uint32_t       iSrc      = 0;
+    uint32_t       iDst      = 0;
+
+    AUDMIXBUF_MACRO_LOG(("cSrcFrames=%RU32, cDstFrames=%RU32, srcOffset=%RU32, dstOffset=%RU32, dstInc=%RU32\n",
+                         cSrcFrames, cDstFrames, pRate->srcOffset,
+                         (uint32_t)(pRate->dstOffset >> 32), (uint32_t)(pRate->dstInc >> 32)));
+    Assert(cTaps && cTaps <= RT_ELEMENTS(afCoefs));
+
+    while (iDst < cDstFrames)
+    {
+        /* Feed the history until it reaches cHalfTaps frames past the output position. */
+        while (   pRate->srcOffset <= (uint32_t)(pRate->dstOffset >> 32) + cHalfTaps
+               && iSrc < cSrcFrames)
+        {
+            uint32_t const offHistory = pRate->offHistory;
+            for (uint8_t iCh = 0; iCh < cChannels; iCh++)
+            {
+                float *pafHistory = &pRate->pafHistory[iCh * 2 * cTaps];
+                pafHistory[offHistory] = pafHistory[offHistory + cTaps] = (float)pai32Src[iSrc * cChannels + iCh];
+            }
+            pRate->offHistory = offHistory + 1 < cTaps ? offHistory + 1 : 0;
+            pRate->srcOffset++;
+            iSrc++;
+        }
+        if (pRate->srcOffset <= (uint32_t)(pRate->dstOffset >> 32) + cHalfTaps)
+            break; /* Ran out of source frames. */
+        Assert(pRate->srcOffset == (uint32_t)(pRate->dstOffset >> 32) + cHalfTaps + 1);
+
+        /* Interpolate the coefficients for the fractional position between the two nearest phases. */
+        uint32_t const uFrac   = (uint32_t)pRate->dstOffset;
+        uint32_t const iPhase  = uFrac >> (32 - AUDIOMIXBUF_RESAMPLE_PHASES_SHIFT);
+        float const    fWeight = (float)(uFrac & (RT_BIT_32(32 - AUDIOMIXBUF_RESAMPLE_PHASES_SHIFT) - 1))
+                               * (1.0f / RT_BIT_32(32 - AUDIOMIXBUF_RESAMPLE_PHASES_SHIFT));
+        float const   *pafRow  = &pRate->pafCoefs[iPhase * cTaps];
+        uint32_t       iTap    = 0;
+#ifdef RT_ARCH_AMD64
+        __m128 const   uWeight = _mm_set1_ps(fWeight);
+        for (; iTap < cTaps; iTap += 4)
+        {
+            __m128 const uCur  = _mm_loadu_ps(&pafRow[iTap]);
+            __m128 const uNext = _mm_loadu_ps(&pafRow[iTap + cTaps]);
+            _mm_storeu_ps(&afCoefs[iTap], _mm_add_ps(uCur, _mm_mul_ps(_mm_sub_ps(uNext, uCur), uWeight)));
+        }
 #endif
+        for (; iTap < cTaps; iTap++)
+            afCoefs[iTap] = pafRow[iTap] + (pafRow[iTap + cTaps] - pafRow[iTap]) * fWeight;
+
+        /* The history ring holds the last cTaps frames, oldest first, starting at offHistory. */
+        for (uint8_t iCh = 0; iCh < cChannels; iCh++)
+            pai32Dst[iDst * cChannels + iCh] = audioMixBufRateToS32(audioMixBufDotF32(&pRate->pafHistory[iCh * 2 * cTaps
+                                                                                                         + pRate->offHistory],
+                                                                                      afCoefs, cTaps));
+        iDst++;
+        pRate->dstOffset += pRate->dstInc;
+    }
+
+    /* Keep the offsets small. */
+    uint32_t const cWhole = RT_MIN((uint32_t)(pRate->dstOffset >> 32), pRate->srcOffset);
+    pRate->dstOffset -= (uint64_t)cWhole << 32;
+    pRate->srcOffset -= cWhole;
+
+    AUDMIXBUF_MACRO_LOG(("%RU32 source frames -> %RU32 dest frames\n", iSrc, iDst));
+
+    *pcDstWritten = iDst;
+    *pcSrcRead    = iSrc;
+}
+
+/**
+ * Returns the number of output frames still held back by the filter, i.e.
+ * the ones positioned before the end of the input fed so far.
+ *
+ * @returns Number of frames.
+ * @param   pRate           The rate conversion state.
+ */
+static uint32_t audioMixBufRatePending(PPDMAUDIOSTRMRATE pRate)
+{
+    if (   pRate->dstInc == RT_BIT_64(32)
+        || !pRate->dstInc
+        || !pRate->cTaps)
+        return 0;
+    uint64_t const offEnd = (uint64_t)pRate->srcOffset << 32;
+    if (offEnd <= pRate->dstOffset)
+        return 0;
+    return (uint32_t)((offEnd - pRate->dstOffset + pRate->dstInc - 1) / pRate->dstInc);
+}
+
+/**
+ * Produces output frames held back by the filter at the end of a stream, by
+ * feeding it silence.
+ *
+ * @param   pRate           The rate conversion state.
+ * @param   pai32Dst        Where to store the output frames.
+ * @param   cDstFrames      Number of frames to produce, at most what
+ *                          audioMixBufRatePending returned before the first call.
+ */
+static void audioMixBufRateDrain(PPDMAUDIOSTRMRATE pRate, int32_t *pai32Dst, uint32_t cDstFrames)
+{
+    static int32_t const s_ai32Silence[AUDIOMIXBUF_TMP_FRAMES * AUDIOMIXBUF_MAX_CHANNELS] = { 0 };
+    uint32_t const       cChannels = pRate->cChannels;
+    uint32_t             cWritten  = 0;
+    while (cWritten < cDstFrames)
+    {
+        uint32_t cChunkWritten, cChunkRead;
+        audioMixBufRateConvert(pRate, &pai32Dst[(size_t)cWritten * cChannels], cDstFrames - cWritten,
+                               s_ai32Silence, AUDIOMIXBUF_TMP_FRAMES, &cChunkWritten, &cChunkRead);
+        cWritten += cChunkWritten;
+    }
+}
+
+/**
+ * Assigns frames from a source buffer to a destination buffer, overwriting the
+ * destination and doing the rate and channel conversion.
+ *
+ * @param   pai32Dst        Where to store the frames.
+ * @param   cDstChannels    Number of destination channels.
+ * @param   cDstFrames      Maximum number of frames to store.
+ * @param   pai32Src        The source frames.
+ * @param   cSrcChannels    Number of source channels.
+ * @param   cSrcFrames      Number of source frames.
+ * @param   pRate           The rate conversion state of the source.
+ * @param   pcDstWritten    Where to return the number of frames written.
+ * @param   pcSrcRead       Where to return the number of source frames consumed.
+ */
+static void audioMixBufOpAssign(int32_t *pai32Dst, uint8_t cDstChannels, uint32_t cDstFrames,
+                                int32_t const *pai32Src, uint8_t cSrcChannels, uint32_t cSrcFrames,
+                                PPDMAUDIOSTRMRATE pRate, uint32_t *pcDstWritten, uint32_t *pcSrcRead)
+{
+    if (pRate->dstInc == RT_BIT_64(32)) /* No rate conversion needed? */
+    {
+        uint32_t const cFrames = RT_MIN(cSrcFrames, cDstFrames);
+        audioMixBufMapChannels(pai32Dst, cDstChannels, pai32Src, cSrcChannels, cFrames);
+        *pcDstWritten = cFrames;
+        *pcSrcRead    = cFrames;
+        return;
+    }
+
+    if (cSrcChannels == cDstChannels)
+    {
+        audioMixBufRateConvert(pRate, pai32Dst, cDstFrames, pai32Src, cSrcFrames, pcDstWritten, pcSrcRead);
+        return;
+    }
+
+    /* Resample in the source layout, then map the channels. */
+    int32_t  ai32Tmp[AUDIOMIXBUF_TMP_FRAMES * AUDIOMIXBUF_MAX_CHANNELS];
+    uint32_t cWritten = 0;
+    uint32_t cRead    = 0;
+    while (   cWritten < cDstFrames
+           && cRead    < cSrcFrames)
+    {
+        uint32_t cChunkWritten, cChunkRead;
+        audioMixBufRateConvert(pRate, ai32Tmp, RT_MIN(cDstFrames - cWritten, AUDIOMIXBUF_TMP_FRAMES),
+                               &pai32Src[(size_t)cRead * cSrcChannels], cSrcFrames - cRead, &cChunkWritten, &cChunkRead);
+        audioMixBufMapChannels(&pai32Dst[(size_t)cWritten * cDstChannels], cDstChannels, ai32Tmp, cSrcChannels, cChunkWritten);
+        cWritten += cChunkWritten;
+        cRead    += cChunkRead;
+    }
+    *pcDstWritten = cWritten;
+    *pcSrcRead    = cRead;
+}
 
-#undef AUDMIXBUF_MIXOP
 #undef AUDMIXBUF_MACRO_LOG
 
 /** Dummy conversion used when the source is muted. */
 static DECLCALLBACK(uint32_t)
-audioMixBufConvFromSilence(PPDMAUDIOSAMPLE paDst, const void *pvSrc, uint32_t cbSrc, PCPDMAUDMIXBUFCONVOPTS pOpts)
+audioMixBufConvFromSilence(int32_t *pai32Dst, const void *pvSrc, uint32_t cbSrc, PCPDMAUDMIXBUFCONVOPTS pOpts)
 {
     RT_NOREF(cbSrc, pvSrc);
 
     /* Internally zero always corresponds to silence. */
-    RT_BZERO(paDst, pOpts->cSamples * sizeof(paDst[0]));
+    RT_BZERO(pai32Dst, (size_t)pOpts->cSamples * pOpts->cDstChannels * sizeof(pai32Dst[0]));
     return pOpts->cSamples;
 }
 
 /**
- * Looks up the matching conversion (macro) routine for converting
+ * Looks up the matching conversion routine for converting
  * audio samples from a source format.
  *
- ** @todo Speed up the lookup by binding it to the actual stream state.
- *
- * @return  PAUDMIXBUF_FN_CONVFROM  Function pointer to conversion macro if found, NULL if not supported.
- * @param   enmFmt                  Audio format to lookup conversion macro for.
+ * @return  PFNPDMAUDIOMIXBUFCONVFROM   Function pointer to conversion routine if found, NULL if not supported.
+ * @param   enmFmt                      Audio format to lookup conversion routine for.
  */
 static PFNPDMAUDIOMIXBUFCONVFROM audioMixBufConvFromLookup(PDMAUDIOMIXBUFFMT enmFmt)
 {
+    if (   !AUDMIXBUF_FMT_CHANNELS(enmFmt)
+        || AUDMIXBUF_FMT_CHANNELS(enmFmt) > AUDIOMIXBUF_MAX_CHANNELS)
+        return NULL;
+
     if (AUDMIXBUF_FMT_SIGNED(enmFmt))
     {
-        if (AUDMIXBUF_FMT_CHANNELS(enmFmt) == 2)
-        {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvFromS8Stereo;
-                case 16: return audioMixBufConvFromS16Stereo;
-                case 32: return audioMixBufConvFromS32Stereo;
-                default: return NULL;
-            }
-        }
-        else
+        switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
         {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvFromS8Mono;
-                case 16: return audioMixBufConvFromS16Mono;
-                case 32: return audioMixBufConvFromS32Mono;
-                default: return NULL;
-            }
+            case 8:  return audioMixBufConvFromS8;
+            case 16: return audioMixBufConvFromS16;
+            case 32: return audioMixBufConvFromS32;
+            default: return NULL;
         }
     }
     else /* Unsigned */
     {
-        if (AUDMIXBUF_FMT_CHANNELS(enmFmt) == 2)
-        {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvFromU8Stereo;
-                case 16: return audioMixBufConvFromU16Stereo;
-                case 32: return audioMixBufConvFromU32Stereo;
-                default: return NULL;
-            }
-        }
-        else
+        switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
         {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvFromU8Mono;
-                case 16: return audioMixBufConvFromU16Mono;
-                case 32: return audioMixBufConvFromU32Mono;
-                default: return NULL;
-            }
+            case 8:  return audioMixBufConvFromU8;
+            case 16: return audioMixBufConvFromU16;
+            case 32: return audioMixBufConvFromU32;
+            default: return NULL;
         }
     }
     /* not reached */
 }
 
 /**
- * Looks up the matching conversion (macro) routine for converting
+ * Looks up the matching conversion routine for converting
  * audio samples to a destination format.
  *
- ** @todo Speed up the lookup by binding it to the actual stream state.
- *
- * @return  PAUDMIXBUF_FN_CONVTO    Function pointer to conversion macro if found, NULL if not supported.
- * @param   enmFmt                  Audio format to lookup conversion macro for.
+ * @return  PFNPDMAUDIOMIXBUFCONVTO     Function pointer to conversion routine if found, NULL if not supported.
+ * @param   enmFmt                      Audio format to lookup conversion routine for.
  */
 static PFNPDMAUDIOMIXBUFCONVTO audioMixBufConvToLookup(PDMAUDIOMIXBUFFMT enmFmt)
 {
+    if (   !AUDMIXBUF_FMT_CHANNELS(enmFmt)
+        || AUDMIXBUF_FMT_CHANNELS(enmFmt) > AUDIOMIXBUF_MAX_CHANNELS)
+        return NULL;
+
     if (AUDMIXBUF_FMT_SIGNED(enmFmt))
     {
-        if (AUDMIXBUF_FMT_CHANNELS(enmFmt) == 2)
-        {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvToS8Stereo;
-                case 16: return audioMixBufConvToS16Stereo;
-                case 32: return audioMixBufConvToS32Stereo;
-                default: return NULL;
-            }
-        }
-        else
+        switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
         {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvToS8Mono;
-                case 16: return audioMixBufConvToS16Mono;
-                case 32: return audioMixBufConvToS32Mono;
-                default: return NULL;
-            }
+            case 8:  return audioMixBufConvToS8;
+            case 16: return audioMixBufConvToS16;
+            case 32: return audioMixBufConvToS32;
+            default: return NULL;
         }
     }
     else /* Unsigned */
     {
-        if (AUDMIXBUF_FMT_CHANNELS(enmFmt) == 2)
+        switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
         {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvToU8Stereo;
-                case 16: return audioMixBufConvToU16Stereo;
-                case 32: return audioMixBufConvToU32Stereo;
-                default: return NULL;
-            }
-        }
-        else
-        {
-            switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
-            {
-                case 8:  return audioMixBufConvToU8Mono;
-                case 16: return audioMixBufConvToU16Mono;
-                case 32: return audioMixBufConvToU32Mono;
-                default: return NULL;
-            }
+            case 8:  return audioMixBufConvToU8;
+            case 16: return audioMixBufConvToU16;
+            case 32: return audioMixBufConvToU32;
+            default: return NULL;
         }
     }
     /* not reached */
@@ -761,8 +1259,8 @@ int AudioMixBufInit(PPDMAUDIOMIXBUF pMixBuf, const char *pszName, PPDMAUDIOPCMPR
     pMixBuf->pParent = NULL;
     RTListInit(&pMixBuf->lstChildren);
 
-    pMixBuf->pSamples = NULL;
-    pMixBuf->cSamples = 0;
+    pMixBuf->pai32Samples = NULL;
+    pMixBuf->cSamples     = 0;
 
     pMixBuf->offRead  = 0;
     pMixBuf->offWrite = 0;
@@ -788,7 +1286,15 @@ int AudioMixBufInit(PPDMAUDIOMIXBUF pMixBuf, const char *pszName, PPDMAUDIOPCMPR
     pMixBuf->pfnConvFrom = audioMixBufConvFromLookup(pMixBuf->AudioFmt);
     pMixBuf->pfnConvTo   = audioMixBufConvToLookup(pMixBuf->AudioFmt);
 
-    pMixBuf->cShift = pProps->cShift;
+    pMixBuf->cChannels = pProps->cChannels;
+    pMixBuf->cbFrame   = AUDMIXBUF_FMT_BYTES_PER_SAMPLE(pMixBuf->AudioFmt) * pProps->cChannels;
+    if (   !pMixBuf->cChannels
+        || pMixBuf->cChannels > AUDIOMIXBUF_MAX_CHANNELS)
+    {
+        LogRel(("Audio: Mixing buffer '%s' does not support %RU8 channels\n", pszName, pMixBuf->cChannels));
+        return VERR_NOT_SUPPORTED;
+    }
+
     pMixBuf->pszName = RTStrDup(pszName);
     if (!pMixBuf->pszName)
         return VERR_NO_MEMORY;
@@ -882,10 +1388,10 @@ int AudioMixBufLinkTo(PPDMAUDIOMIXBUF pMixBuf, PPDMAUDIOMIXBUF pParent)
         AUDMIXBUF_LOG(("%s: Reallocating samples %RU32 -> %RU32\n",
                        pMixBuf->pszName, pMixBuf->cSamples, cSamples));
 
-        uint32_t cbSamples = cSamples * sizeof(PDMAUDIOSAMPLE);
+        uint32_t cbSamples = cSamples * pMixBuf->cChannels * sizeof(int32_t);
         Assert(cbSamples);
-        pMixBuf->pSamples = (PPDMAUDIOSAMPLE)RTMemRealloc(pMixBuf->pSamples, cbSamples);
-        if (!pMixBuf->pSamples)
+        pMixBuf->pai32Samples = (int32_t *)RTMemRealloc(pMixBuf->pai32Samples, cbSamples);
+        if (!pMixBuf->pai32Samples)
             rc = VERR_NO_MEMORY;
 
         if (RT_SUCCESS(rc))
@@ -894,7 +1400,7 @@ int AudioMixBufLinkTo(PPDMAUDIOMIXBUF pMixBuf, PPDMAUDIOMIXBUF pParent)
 
             /* Make sure to zero the reallocated buffer so that it can be
              * used properly when blending with another buffer later. */
-            RT_BZERO(pMixBuf->pSamples, cbSamples);
+            RT_BZERO(pMixBuf->pai32Samples, cbSamples);
         }
     }
 #endif
@@ -908,17 +1414,18 @@ int AudioMixBufLinkTo(PPDMAUDIOMIXBUF pMixBuf, PPDMAUDIOMIXBUF pParent)
             if (!pMixBuf->pRate)
                 return VERR_NO_MEMORY;
         }
-        else
-            RT_BZERO(pMixBuf->pRate, sizeof(PDMAUDIOSTRMRATE));
 
-        pMixBuf->pRate->dstInc = ((uint64_t)AUDMIXBUF_FMT_SAMPLE_FREQ(pMixBuf->AudioFmt) << 32)
-                               /            AUDMIXBUF_FMT_SAMPLE_FREQ(pParent->AudioFmt);
+        rc = audioMixBufRateInit(pMixBuf->pRate, AUDMIXBUF_FMT_SAMPLE_FREQ(pMixBuf->AudioFmt),
+                                 AUDMIXBUF_FMT_SAMPLE_FREQ(pParent->AudioFmt), pMixBuf->cChannels);
+        if (RT_FAILURE(rc))
+            return rc;
 
-        AUDMIXBUF_LOG(("uThisHz=%RU32, uParentHz=%RU32, iFreqRatio=0x%RX64 (%RI64), uRateInc=0x%RX64 (%RU64), cSamples=%RU32 (%RU32 parent)\n",
+        AUDMIXBUF_LOG(("uThisHz=%RU32, uParentHz=%RU32, iFreqRatio=0x%RX64 (%RI64), uRateInc=0x%RX64 (%RU64), cTaps=%RU16, cSamples=%RU32 (%RU32 parent)\n",
                        AUDMIXBUF_FMT_SAMPLE_FREQ(pMixBuf->AudioFmt),
                        AUDMIXBUF_FMT_SAMPLE_FREQ(pParent->AudioFmt),
                        pMixBuf->iFreqRatio, pMixBuf->iFreqRatio,
                        pMixBuf->pRate->dstInc, pMixBuf->pRate->dstInc,
+                       pMixBuf->pRate->cTaps,
                        pMixBuf->cSamples,
                        pParent->cSamples));
         AUDMIXBUF_LOG(("%s (%RU32Hz) -> %s (%RU32Hz)\n",
@@ -1056,8 +1563,8 @@ static int audioMixBufMixTo(PPDMAUDIOMIXBUF pDst, PPDMAUDIOMIXBUF pSrc, uint32_t
             Assert(offDstWrite < pDst->cSamples);
             Assert(offDstWrite + cDstToWrite <= pDst->cSamples);
 
-            audioMixBufOpAssign(pDst->pSamples + offDstWrite, cDstToWrite,
-                                pSrc->pSamples + offSrcRead,  cSrcToRead,
+            audioMixBufOpAssign(pDst->pai32Samples + (size_t)offDstWrite * pDst->cChannels, pDst->cChannels, cDstToWrite,
+                                pSrc->pai32Samples + (size_t)offSrcRead  * pSrc->cChannels, pSrc->cChannels, cSrcToRead,
                                 pSrc->pRate, &cDstWritten, &cSrcRead);
         }
 
@@ -1145,6 +1652,72 @@ int AudioMixBufMixToParent(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamples,
     return audioMixBufMixTo(pMixBuf->pParent, pMixBuf, cSamples, pcProcessed);
 }
 
+/**
+ * Flushes the audio samples held back by the rate conversion to the parent
+ * mixing buffer.
+ *
+ * The resampling filter needs a few samples past each output sample, so the
+ * end of the data mixed by AudioMixBufMixToParent stays in the filter until
+ * more data arrives. At the end of a stream this completes the data with
+ * silence and mixes the rest down. The rate conversion starts from scratch
+ * afterwards.
+ *
+ * @return  IPRT status code.
+ * @retval  VERR_BUFFER_OVERFLOW if the parent does not have room for all of
+ *          the samples; nothing is flushed then.
+ * @param   pMixBuf                 Mixing buffer to flush.
+ * @param   pcWritten               Where to return the number of samples written
+ *                                  to the parent. Optional.
+ */
+int AudioMixBufDrainToParent(PPDMAUDIOMIXBUF pMixBuf, uint32_t *pcWritten)
+{
+    AssertPtrReturn(pMixBuf, VERR_INVALID_POINTER);
+    AssertMsgReturn(VALID_PTR(pMixBuf->pParent),
+                    ("Buffer is not linked to a parent buffer\n"),
+                    VERR_INVALID_PARAMETER);
+    /* pcWritten is optional. */
+
+    PPDMAUDIOMIXBUF pDst   = pMixBuf->pParent;
+    uint32_t const  cDrain = pMixBuf->pRate ? audioMixBufRatePending(pMixBuf->pRate) : 0;
+    if (pcWritten)
+        *pcWritten = 0;
+    if (!cDrain)
+    {
+        if (pMixBuf->pRate)
+            audioMixBufRateReset(pMixBuf->pRate);
+        return VINF_SUCCESS;
+    }
+
+    Assert(pDst->cUsed <= pDst->cSamples);
+    if (pDst->cSamples - pDst->cUsed < cDrain)
+    {
+        AUDMIXBUF_LOG(("%s: No room for the %RU32 samples held back by the rate conversion\n", pMixBuf->pszName, cDrain));
+        return VERR_BUFFER_OVERFLOW;
+    }
+
+    /* The filter produces the source layout, so go via a temporary buffer. */
+    int32_t  ai32Tmp[AUDIOMIXBUF_TMP_FRAMES * AUDIOMIXBUF_MAX_CHANNELS];
+    uint32_t cWritten = 0;
+    while (cWritten < cDrain)
+    {
+        uint32_t const cChunk = RT_MIN(RT_MIN(cDrain - cWritten, AUDIOMIXBUF_TMP_FRAMES), pDst->cSamples - pDst->offWrite);
+        audioMixBufRateDrain(pMixBuf->pRate, ai32Tmp, cChunk);
+        audioMixBufMapChannels(pDst->pai32Samples + (size_t)pDst->offWrite * pDst->cChannels, pDst->cChannels,
+                               ai32Tmp, pMixBuf->cChannels, cChunk);
+        pDst->offWrite = (pDst->offWrite + cChunk) % pDst->cSamples;
+        cWritten += cChunk;
+    }
+    audioMixBufRateReset(pMixBuf->pRate);
+
+    pDst->cUsed     += cWritten;
+    pMixBuf->cMixed  = RT_MIN(pMixBuf->cMixed + cWritten, pDst->cSamples);
+
+    AUDMIXBUF_LOG(("%s: Flushed %RU32 samples to '%s'\n", pMixBuf->pszName, cWritten, pDst->pszName));
+    if (pcWritten)
+        *pcWritten = cWritten;
+    return VINF_SUCCESS;
+}
+
 #ifdef DEBUG
 
 /**
@@ -1332,11 +1905,13 @@ int AudioMixBufReadAtEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt,
         {
             PDMAUDMIXBUFCONVOPTS convOpts;
             RT_ZERO(convOpts);
-            /* Note: No volume handling/conversion done in the conversion-to macros (yet). */
+            /* Note: No volume handling/conversion done in the conversion-to functions (yet). */
 
-            convOpts.cSamples = cToProcess;
+            convOpts.cSamples     = cToProcess;
+            convOpts.cSrcChannels = pMixBuf->cChannels;
+            convOpts.cDstChannels = AUDMIXBUF_FMT_CHANNELS(enmFmt);
 
-            pfnConvTo(pvBuf, pMixBuf->pSamples + offSamples, &convOpts);
+            pfnConvTo(pvBuf, pMixBuf->pai32Samples + (size_t)offSamples * pMixBuf->cChannels, &convOpts);
 
 #ifdef DEBUG
             AudioMixBufDbgPrint(pMixBuf);
@@ -1428,10 +2003,10 @@ int AudioMixBufReadCircEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt, voi
         return VERR_NOT_SUPPORTED;
     }
 
-    PPDMAUDIOSAMPLE pSamplesSrc1 = pMixBuf->pSamples + pMixBuf->offRead;
+    int32_t *pai32Src1 = pMixBuf->pai32Samples + (size_t)pMixBuf->offRead * pMixBuf->cChannels;
     uint32_t cLenSrc1 = cToRead;
 
-    PPDMAUDIOSAMPLE pSamplesSrc2 = NULL;
+    int32_t *pai32Src2 = NULL;
     uint32_t cLenSrc2 = 0;
 
     /*
@@ -1444,38 +2019,40 @@ int AudioMixBufReadCircEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt, voi
         Assert(pMixBuf->offRead <= pMixBuf->cSamples);
         cLenSrc1 = pMixBuf->cSamples - pMixBuf->offRead;
 
-        pSamplesSrc2 = pMixBuf->pSamples;
+        pai32Src2 = pMixBuf->pai32Samples;
         Assert(cToRead >= cLenSrc1);
         cLenSrc2 = RT_MIN(cToRead - cLenSrc1, pMixBuf->cSamples);
     }
 
     PDMAUDMIXBUFCONVOPTS convOpts;
     RT_ZERO(convOpts);
-    /* Note: No volume handling/conversion done in the conversion-to macros (yet). */
+    /* Note: No volume handling/conversion done in the conversion-to functions (yet). */
+    convOpts.cSrcChannels = pMixBuf->cChannels;
+    convOpts.cDstChannels = AUDMIXBUF_FMT_CHANNELS(enmFmt);
 
     /* Anything to do at all? */
     int rc = VINF_SUCCESS;
     if (cLenSrc1)
     {
-        AssertPtr(pSamplesSrc1);
+        AssertPtr(pai32Src1);
 
         convOpts.cSamples = cLenSrc1;
 
         AUDMIXBUF_LOG(("P1: offRead=%RU32, cToRead=%RU32\n", pMixBuf->offRead, cLenSrc1));
-        pfnConvTo(pvBuf, pSamplesSrc1, &convOpts);
+        pfnConvTo(pvBuf, pai32Src1, &convOpts);
     }
 
     /* Second part present? */
     if (   RT_LIKELY(RT_SUCCESS(rc))
         && cLenSrc2)
     {
-        AssertPtr(pSamplesSrc2);
+        AssertPtr(pai32Src2);
 
         convOpts.cSamples = cLenSrc2;
 
         AUDMIXBUF_LOG(("P2: cToRead=%RU32, offWrite=%RU32 (%zu bytes)\n", cLenSrc2, cLenSrc1,
                        AUDIOMIXBUF_S2B(pMixBuf, cLenSrc1)));
-        pfnConvTo((uint8_t *)pvBuf + AUDIOMIXBUF_S2B(pMixBuf, cLenSrc1), pSamplesSrc2, &convOpts);
+        pfnConvTo((uint8_t *)pvBuf + AUDIOMIXBUF_S2B(pMixBuf, cLenSrc1), pai32Src2, &convOpts);
     }
 
     if (RT_SUCCESS(rc))
@@ -1611,7 +2188,7 @@ void AudioMixBufUnlink(PPDMAUDIOMIXBUF pMixBuf)
 
     if (pMixBuf->pRate)
     {
-        pMixBuf->pRate->dstOffset = pMixBuf->pRate->srcOffset = 0;
+        audioMixBufRateReset(pMixBuf->pRate);
         pMixBuf->pRate->dstInc = 0;
     }
 
@@ -1713,11 +2290,14 @@ int AudioMixBufWriteAtEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt,
         PDMAUDMIXBUFCONVOPTS convOpts;
 
         convOpts.cSamples           = cToWrite;
+        convOpts.cSrcChannels       = AUDMIXBUF_FMT_CHANNELS(enmFmt);
+        convOpts.cDstChannels       = pMixBuf->cChannels;
         convOpts.From.Volume.fMuted = pMixBuf->Volume.fMuted;
         convOpts.From.Volume.uLeft  = pMixBuf->Volume.uLeft;
         convOpts.From.Volume.uRight = pMixBuf->Volume.uRight;
 
-        cWritten = pfnConvFrom(pMixBuf->pSamples + offSamples, pvBuf, AUDIOMIXBUF_S2B(pMixBuf, cToWrite), &convOpts);
+        cWritten = pfnConvFrom(pMixBuf->pai32Samples + (size_t)offSamples * pMixBuf->cChannels, pvBuf,
+                               AUDIOMIXBUF_S2B(pMixBuf, cToWrite), &convOpts);
     }
     else
     {
@@ -1825,10 +2405,10 @@ int AudioMixBufWriteCircEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt,
     uint32_t cToWrite = AUDIOMIXBUF_B2S(pMixBuf, cbBuf);
     AssertMsg(cToWrite, ("cToWrite is 0 (cbBuf=%zu)\n", cbBuf));
 
-    PPDMAUDIOSAMPLE pSamplesDst1 = pMixBuf->pSamples + pMixBuf->offWrite;
+    int32_t *pai32Dst1 = pMixBuf->pai32Samples + (size_t)pMixBuf->offWrite * pMixBuf->cChannels;
     uint32_t cLenDst1 = cToWrite;
 
-    PPDMAUDIOSAMPLE pSamplesDst2 = NULL;
+    int32_t *pai32Dst2 = NULL;
     uint32_t cLenDst2 = 0;
 
     uint32_t cOffWrite = pMixBuf->offWrite + cToWrite;
@@ -1843,7 +2423,7 @@ int AudioMixBufWriteCircEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt,
         Assert(pMixBuf->offWrite <= pMixBuf->cSamples);
         cLenDst1 = pMixBuf->cSamples - pMixBuf->offWrite;
 
-        pSamplesDst2 = pMixBuf->pSamples;
+        pai32Dst2 = pMixBuf->pai32Samples;
         Assert(cToWrite >= cLenDst1);
         cLenDst2 = RT_MIN(cToWrite - cLenDst1, pMixBuf->cSamples);
 
@@ -1860,6 +2440,8 @@ int AudioMixBufWriteCircEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt,
     uint32_t cWrittenTotal = 0;
 
     PDMAUDMIXBUFCONVOPTS convOpts;
+    convOpts.cSrcChannels       = AUDMIXBUF_FMT_CHANNELS(enmFmt);
+    convOpts.cDstChannels       = pMixBuf->cChannels;
     convOpts.From.Volume.fMuted = pMixBuf->Volume.fMuted;
     convOpts.From.Volume.uLeft  = pMixBuf->Volume.uLeft;
     convOpts.From.Volume.uRight = pMixBuf->Volume.uRight;
@@ -1868,7 +2450,7 @@ int AudioMixBufWriteCircEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt,
     if (cLenDst1)
     {
         convOpts.cSamples = cLenDst1;
-        cWrittenTotal = pfnConvFrom(pSamplesDst1, pvBuf, AUDIOMIXBUF_S2B(pMixBuf, cLenDst1), &convOpts);
+        cWrittenTotal = pfnConvFrom(pai32Dst1, pvBuf, AUDIOMIXBUF_S2B(pMixBuf, cLenDst1), &convOpts);
         Assert(cWrittenTotal == cLenDst1);
 
 #ifdef AUDIOMIXBUF_DEBUG_DUMP_PCM_DATA
@@ -1879,10 +2461,10 @@ int AudioMixBufWriteCircEx(PPDMAUDIOMIXBUF pMixBuf, PDMAUDIOMIXBUFFMT enmFmt,
     /* Second part present? */
     if (cLenDst2)
     {
-        AssertPtr(pSamplesDst2);
+        AssertPtr(pai32Dst2);
 
         convOpts.cSamples = cLenDst2;
-        cWrittenTotal += pfnConvFrom(pSamplesDst2,
+        cWrittenTotal += pfnConvFrom(pai32Dst2,
                                      (uint8_t *)pvBuf + AUDIOMIXBUF_S2B(pMixBuf, cLenDst1),
                                      cbBuf - AUDIOMIXBUF_S2B(pMixBuf, cLenDst1),
                                      &convOpts);
@@ -34,24 +34,31 @@
 /** Decodes number of bits per sample. */
 #define AUDMIXBUF_FMT_BITS_PER_SAMPLE(a) (((a) >> 20) & 0xFF)
 /** Decodes number of bytes per sample. */
-#define AUDMIXBUF_FMT_BYTES_PER_SAMPLE(a) ((AUDMIXBUF_AUDIO_FMT_BITS_PER_SAMPLE(a) + 7) / 8)
+#define AUDMIXBUF_FMT_BYTES_PER_SAMPLE(a) ((AUDMIXBUF_FMT_BITS_PER_SAMPLE(a) + 7) / 8)
+
+/** Maximum number of channels a mixing buffer can handle. */
+#define AUDIOMIXBUF_MAX_CHANNELS        8
+/** Half the length (in frames) of the resampling filter when upsampling.
+ *  This also is the number of source frames the resampler holds back. */
+#define AUDIOMIXBUF_RESAMPLE_HALF_TAPS  8
 
 /** Converts samples to bytes. */
-#define AUDIOMIXBUF_S2B(pBuf, samples) ((samples) << (pBuf)->cShift)
+#define AUDIOMIXBUF_S2B(pBuf, samples) ((samples) * (pBuf)->cbFrame)
 /** Converts samples to bytes, respecting the conversion ratio to
  *  a linked buffer. */
-#define AUDIOMIXBUF_S2B_RATIO(pBuf, samples) ((((int64_t) samples << 32) / (pBuf)->iFreqRatio) << (pBuf)->cShift)
+#define AUDIOMIXBUF_S2B_RATIO(pBuf, samples) ((((int64_t) samples << 32) / (pBuf)->iFreqRatio) * (pBuf)->cbFrame)
 /** Converts bytes to samples, *not* taking the conversion ratio
  *  into account. */
-#define AUDIOMIXBUF_B2S(pBuf, cb)  (cb >> (pBuf)->cShift)
+#define AUDIOMIXBUF_B2S(pBuf, cb)  ((cb) / (pBuf)->cbFrame)
 /** Converts number of samples according to the buffer's ratio. */
 #define AUDIOMIXBUF_S2S_RATIO(pBuf, samples)  (((int64_t) samples << 32) / (pBuf)->iFreqRatio)
 
 
-int AudioMixBufAcquire(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamplesToRead, PPDMAUDIOSAMPLE *ppvSamples, uint32_t *pcSamplesRead);
+int AudioMixBufAcquire(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamplesToRead, int32_t **ppai32Samples, uint32_t *pcSamplesRead);
 inline uint32_t AudioMixBufBytesToSamples(PPDMAUDIOMIXBUF pMixBuf);
 void AudioMixBufClear(PPDMAUDIOMIXBUF pMixBuf);
 void AudioMixBufDestroy(PPDMAUDIOMIXBUF pMixBuf);
+int AudioMixBufDrainToParent(PPDMAUDIOMIXBUF pMixBuf, uint32_t *pcWritten);
 void AudioMixBufFinish(PPDMAUDIOMIXBUF pMixBuf, uint32_t cSamplesToClear);
 uint32_t AudioMixBufFree(PPDMAUDIOMIXBUF pMixBuf);
 uint32_t AudioMixBufFreeBytes(PPDMAUDIOMIXBUF pMixBuf);
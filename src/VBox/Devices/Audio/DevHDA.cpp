@@ -34,6 +34,7 @@
 #include <iprt/asm-math.h>
 #include <iprt/file.h>
 #include <iprt/list.h>
+#include <iprt/param.h>
 #ifdef IN_RING3
 # include <iprt/mem.h>
 # include <iprt/semaphore.h>
@@ -99,8 +100,13 @@
 # define VBOX_WITH_HDA_AUDIO_INTERLEAVING_STREAMS_SUPPORT
 #endif
 
-/** Default timer frequency (in Hz). */
+/** Default timer frequency (in Hz).
+ *  This is the lowest rate a running stream gets serviced at; the actual DMA
+ *  timer interval of a stream is derived from its position and period size. */
 #define HDA_TIMER_HZ            100
+/** Highest rate (in Hz) a stream's DMA timer may fire at. Limits the number of
+ *  wakeups for guests using tiny periods. */
+#define HDA_TIMER_HZ_MAX        1000
 
 /**
  * At the moment we support 4 input + 4 output streams max, which is 8 in total.
@@ -672,8 +678,49 @@ typedef struct HDASTREAMSTATE
     HDABDLE                 BDLE;
     /** Circular buffer (FIFO) for holding DMA'ed data. */
     R3PTRTYPE(PRTCIRCBUF)   pCircBuf;
+    /** Copy of the stream's BDL (entries 0 thru LVI), read in one go when the
+     *  first BDLE is needed after the stream got started. */
+    R3PTRTYPE(PHDABDLEDESC) paBDLCache;
+    /** Number of valid entries in paBDLCache, 0 if not cached (yet). */
+    uint16_t                cBDLCache;
+    uint16_t                Padding1[3];
+#ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
+    /** The DMA timer of this stream. */
+    PTMTIMERR3              pTimer;
+    /** Data rate (in bytes per second) according to SDnFMT, 0 if unknown. */
+    uint32_t                cbPerSec;
+    /** Size of a PCM frame (in bytes) according to SDnFMT. */
+    uint32_t                cbFrame;
+    /** Virtual time (in timer ticks) up to which the stream's data has been
+     *  transferred. Runs ahead of the clock by at most one timer interval. */
+    uint64_t                tsTransfer;
+    /** Whether the stream is running (SDnCTL.RUN set) as far as the timer
+     *  is concerned. */
+    volatile bool           fRunning;
+    uint8_t                 Padding2[7];
+#endif
 } HDASTREAMSTATE, *PHDASTREAMSTATE;
 
+#ifdef IN_RING3
+/**
+ * Guest page mapping used by the DMA engine.
+ *
+ * Kept for one transfer round (hdaStreamUpdate), so that consecutive DMA
+ * accesses to the same page don't need to look it up again.
+ */
+typedef struct HDADMAMAP
+{
+    /** Guest physical address of the mapped page, NIL_RTGCPHYS if none. */
+    RTGCPHYS                GCPhysPage;
+    /** The mapping of the page. */
+    void                   *pvPage;
+    /** Whether the page is mapped writable. */
+    bool                    fWritable;
+    /** The page mapping lock. */
+    PGMPAGEMAPLOCK          Lock;
+} HDADMAMAP, *PHDADMAMAP;
+#endif
+
 /**
  * Structure defining an HDA mixer sink.
  * Its purpose is to know which audio mixer sink is bound to
@@ -875,17 +922,11 @@ typedef struct HDASTATE
     /** Number of active (running) SDn streams. */
     uint8_t                            cStreamsActive;
 #ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
-    /** The timer for pumping data thru the attached LUN drivers. */
-    PTMTIMERR3                         pTimer;
-    /** Flag indicating whether the timer is active or not. */
-    bool                               fTimerActive;
-    uint8_t                            u8Padding1[7];
-    /** Timer ticks per Hz. */
+    /** Longest interval (in timer ticks) between two DMA transfers of a running
+     *  stream, derived from the TimerHz setting. */
     uint64_t                           cTimerTicks;
-    /** Timestamp of the last timer callback (hdaTimer).
-     * Used to calculate the time actually elapsed between two timer callbacks. */
-    uint64_t                           uTimerTS;
-    uint64_t                           uTimerMS;
+    /** Shortest interval (in timer ticks) between two DMA transfers of a stream. */
+    uint64_t                           cTimerTicksMin;
 #endif
 #ifdef VBOX_WITH_STATISTICS
 # ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
@@ -1002,9 +1043,10 @@ static int hdaRegWriteU8(PHDASTATE pThis, uint32_t iReg, uint32_t u32Value);
  */
 #ifdef IN_RING3
 static void          hdaStreamDestroy(PHDASTATE pThis, PHDASTREAM pStream);
-static int           hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, void *pvBuf, uint32_t cbBuf, uint32_t cbToProcess, uint32_t *pcbProcessed);
+static int           hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, PHDADMAMAP pMap, void *pvBuf, uint32_t cbBuf,
+                                    uint32_t cbToProcess, uint32_t *pcbProcessed, bool *pfStop);
 static int           hdaStreamEnable(PHDASTATE pThis, PHDASTREAM pStream, bool fEnable);
-static int           hdaStreamUpdate(PHDASTATE pThis, PHDASTREAM pStream);
+static int           hdaStreamUpdate(PHDASTATE pThis, PHDASTREAM pStream, uint32_t cbToProcess, uint32_t *pcbProcessed);
 DECLINLINE(uint32_t) hdaStreamUpdateLPIB(PHDASTATE pThis, PHDASTREAM pStream, uint32_t u32LPIB);
 static void          hdaStreamLock(PHDASTREAM pStream);
 static void          hdaStreamUnlock(PHDASTREAM pStream);
@@ -1040,9 +1082,6 @@ static void          hdaStreamMapReset(PHDASTREAMMAPPING pMapping);
 /** @name HDA device functions.
  * @{
  */
-#ifdef IN_RING3
-static void          hdaDoTransfers(PHDASTATE pThis);
-#endif /* IN_RING3 */
 static int           hdaProcessInterrupt(PHDASTATE pThis);
 /** @} */
 
@@ -1051,6 +1090,8 @@ static int           hdaProcessInterrupt(PHDASTATE pThis);
  */
 #ifdef IN_RING3
 static int           hdaBDLEFetch(PHDASTATE pThis, PHDABDLE pBDLE, uint64_t u64BaseDMA, uint16_t u16Entry);
+static int           hdaStreamFetchBDLE(PHDASTATE pThis, PHDASTREAM pStream, uint16_t u16Entry);
+DECLINLINE(void)     hdaStreamInvalidateBDLCache(PHDASTREAM pStream);
 # ifdef LOG_ENABLED
 static void          hdaBDLEDumpAll(PHDASTATE pThis, uint64_t u64BaseDMA, uint16_t cBDLE);
 # endif
@@ -1061,9 +1102,9 @@ static void          hdaBDLEDumpAll(PHDASTATE pThis, uint64_t u64BaseDMA, uint16
  * @{
  */
 #if !defined(VBOX_WITH_AUDIO_HDA_CALLBACKS) && defined(IN_RING3)
-static void          hdaTimerMaybeStart(PHDASTATE pThis);
-static void          hdaTimerMaybeStop(PHDASTATE pThis);
-static void          hdaTimerMain(PHDASTATE pThis);
+static void          hdaStreamTimerStart(PHDASTATE pThis, PHDASTREAM pStream);
+static void          hdaStreamTimerStop(PHDASTATE pThis, PHDASTREAM pStream);
+static void          hdaStreamTimerMain(PHDASTATE pThis, PHDASTREAM pStream);
 #endif
 /** @} */
 
@@ -1376,7 +1417,7 @@ DECLINLINE(int) hdaStreamGetNextBDLE(PHDASTATE pThis, PHDASTREAM pStream, bool *
     Assert(pStream->State.uCurBDLE < pStream->u16LVI + 1);
 
     /* Fetch the next BDLE entry. */
-    int rc = hdaBDLEFetch(pThis, pBDLE, pStream->u64BDLBase, pStream->State.uCurBDLE);
+    int rc = hdaStreamFetchBDLE(pThis, pStream, pStream->State.uCurBDLE);
     if (RT_SUCCESS(rc))
     {
         LogFlowFunc(("[SD%RU8]: uOldBDLE=%RU16, uCurBDLE=%RU16, LVI=%RU32, rc=%Rrc, %R[bdle]\n",
@@ -1790,6 +1831,13 @@ static void hdaStreamDestroy(PHDASTATE pThis, PHDASTREAM pStream)
         pStream->State.pCircBuf = NULL;
     }
 
+    if (pStream->State.paBDLCache)
+    {
+        RTMemFree(pStream->State.paBDLCache);
+        pStream->State.paBDLCache = NULL;
+    }
+    pStream->State.cBDLCache = 0;
+
     LogFlowFuncLeave();
 }
 
@@ -1808,6 +1856,8 @@ static int hdaStreamInit(PHDASTATE pThis, PHDASTREAM pStream, uint8_t u8SD)
     RT_ZERO(pStream->State.BDLE);
     pStream->State.uCurBDLE = 0;
 
+    hdaStreamInvalidateBDLCache(pStream);
+
     hdaStreamMapReset(&pStream->State.Mapping);
 
     LogFlowFunc(("[SD%RU8]: DMA @ 0x%x (%RU32 bytes), LVI=%RU16, FIFOS=%RU16\n",
@@ -1927,11 +1977,11 @@ static int hdaStreamEnable(PHDASTATE pThis, PHDASTREAM pStream, bool fEnable)
     hdaStreamUnlock(pStream);
 
 #ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
-    /* Second, see if we need to start or stop the timer. */
+    /* Second, start or stop the stream's DMA timer. */
     if (!fEnable)
-        hdaTimerMaybeStop(pThis);
+        hdaStreamTimerStop(pThis, pStream);
     else
-        hdaTimerMaybeStart(pThis);
+        hdaStreamTimerStart(pThis, pStream);
 #endif
 
     LogFunc(("[SD%RU8]: cStreamsActive=%RU8, rc=%Rrc\n", pStream->u8SD, pThis->cStreamsActive, rc));
@@ -2426,8 +2476,11 @@ static int hdaRegWriteSDCTL(PHDASTATE pThis, uint32_t iReg, uint32_t u32Value)
 
             if (fRun)
             {
+                /* The guest might have rewritten the BDL while the stream was stopped. */
+                hdaStreamInvalidateBDLCache(pStream);
+
                 /* Make sure to first fetch the current BDLE before enabling the stream below. */
-                int rc2 = hdaBDLEFetch(pThis, &pStream->State.BDLE, pStream->u64BDLBase, pStream->State.uCurBDLE);
+                int rc2 = hdaStreamFetchBDLE(pThis, pStream, pStream->State.uCurBDLE);
                 AssertRC(rc2);
             }
 
@@ -2484,6 +2537,8 @@ static int hdaRegWriteSDLVI(PHDASTATE pThis, uint32_t iReg, uint32_t u32Value)
     RT_ZERO(pStream->State.BDLE);
     pStream->State.uCurBDLE = 0;
 
+    hdaStreamInvalidateBDLCache(pStream);
+
     int rc2 = hdaRegWriteU16(pThis, iReg, u32Value);
     AssertRC(rc2);
 
@@ -2979,6 +3034,8 @@ DECLINLINE(int) hdaRegWriteSDBDPX(PHDASTATE pThis, uint32_t iReg, uint32_t u32Va
     RT_ZERO(pStream->State.BDLE);
     pStream->State.uCurBDLE = 0;
 
+    hdaStreamInvalidateBDLCache(pStream);
+
     LogFlowFunc(("[SD%RU8]: BDLBase=0x%x\n", pStream->u8SD, pStream->u64BDLBase));
 
     return VINF_SUCCESS; /* Always return success to the MMIO handler. */
@@ -3200,6 +3257,65 @@ static int hdaBDLEFetch(PHDASTATE pThis, PHDABDLE pBDLE, uint64_t u64BaseDMA, ui
     return VINF_SUCCESS;
 }
 
+/**
+ * Invalidates the cached copy of a stream's Buffer Descriptor List (BDL).
+ *
+ * @param   pStream                 HDA stream to invalidate BDL cache for.
+ */
+DECLINLINE(void) hdaStreamInvalidateBDLCache(PHDASTREAM pStream)
+{
+    pStream->State.cBDLCache = 0;
+}
+
+/**
+ * Fetches a Bundle Descriptor List Entry (BDLE) of a stream into the stream's
+ * current BDLE.
+ *
+ * The stream's whole BDL (entries 0 thru LVI) is read with a single physical
+ * memory access and cached, so that advancing to the next entry doesn't require
+ * another one. Falls back to hdaBDLEFetch() if the BDL can't be cached.
+ *
+ * @returns IPRT status code.
+ * @param   pThis                   Pointer to HDA state.
+ * @param   pStream                 HDA stream to fetch the BDLE for.
+ * @param   u16Entry                BDLE entry to fetch.
+ */
+static int hdaStreamFetchBDLE(PHDASTATE pThis, PHDASTREAM pStream, uint16_t u16Entry)
+{
+    AssertPtrReturn(pThis,   VERR_INVALID_POINTER);
+    AssertPtrReturn(pStream, VERR_INVALID_POINTER);
+
+    PHDASTREAMSTATE pState = &pStream->State;
+
+    if (   !pState->cBDLCache
+        && pStream->u64BDLBase)
+    {
+        /* The LVI register is 8 bits wide, so 256 entries is the most a BDL can have. */
+        uint16_t const cEntries = RT_MIN(pStream->u16LVI, UINT8_MAX) + 1;
+
+        if (!pState->paBDLCache)
+            pState->paBDLCache = (PHDABDLEDESC)RTMemAlloc(sizeof(HDABDLEDESC) * (UINT8_MAX + 1));
+        if (pState->paBDLCache)
+        {
+            int rc2 = PDMDevHlpPhysRead(pThis->CTX_SUFF(pDevIns), pStream->u64BDLBase,
+                                        pState->paBDLCache, sizeof(HDABDLEDESC) * cEntries);
+            if (RT_SUCCESS(rc2))
+                pState->cBDLCache = cEntries;
+        }
+    }
+
+    if (u16Entry >= pState->cBDLCache)
+        return hdaBDLEFetch(pThis, &pState->BDLE, pStream->u64BDLBase, u16Entry);
+
+    PHDABDLE pBDLE = &pState->BDLE;
+
+    pBDLE->Desc              = pState->paBDLCache[u16Entry];
+    pBDLE->State.u32BufOff   = 0;
+    pBDLE->State.u32BDLIndex = u16Entry;
+
+    return VINF_SUCCESS;
+}
+
 /**
  * Returns the number of outstanding stream data bytes which need to be processed
  * by the DMA engine assigned to this stream.
@@ -3840,141 +3956,250 @@ static DECLCALLBACK(int) hdaMixerSetVolume(PHDASTATE pThis,
 
 #ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
 /**
- * Starts the internal audio device timer (if not started yet).
+ * Converts a time span (in timer ticks) into the number of bytes a stream
+ * transfers in it, rounded down to whole frames.
  *
- * @param   pThis               HDA state.
+ * @returns Number of bytes.
+ * @param   pStream             HDA stream to do the conversion for.
+ * @param   cTicks              Time span (in timer ticks) to convert.
  */
-static void hdaTimerMaybeStart(PHDASTATE pThis)
+DECLINLINE(uint32_t) hdaStreamTicksToBytes(PHDASTREAM pStream, uint64_t cTicks)
 {
-    LogFlowFuncEnter();
-
-    if (!pThis->pTimer)
-        return;
+    PHDASTREAMSTATE pState = &pStream->State;
+    Assert(pState->cbPerSec);
+    Assert(pState->cbFrame);
 
-    pThis->cStreamsActive++;
+    /* Callers limit cTicks to a few timer intervals, so this can't overflow. */
+    uint32_t cb = (uint32_t)ASMMultU64ByU32DivByU32(cTicks, pState->cbPerSec, (uint32_t)TMTimerGetFreq(pState->pTimer));
 
-    /* Only start the timer at the first active stream. */
-    if (pThis->cStreamsActive == 1)
-    {
-        LogRel2(("HDA: Starting transfers\n"));
-
-        /* Set timer flag. */
-        ASMAtomicXchgBool(&pThis->fTimerActive, true);
+    return cb - cb % pState->cbFrame;
+}
 
-        /* Update current time timestamp. */
-        pThis->uTimerTS = TMTimerGet(pThis->pTimer);
+/**
+ * Converts a number of bytes of a stream into the time span (in timer ticks)
+ * needed to transfer them.
+ *
+ * @returns Time span (in timer ticks).
+ * @param   pStream             HDA stream to do the conversion for.
+ * @param   cb                  Number of bytes to convert.
+ */
+DECLINLINE(uint64_t) hdaStreamBytesToTicks(PHDASTREAM pStream, uint32_t cb)
+{
+    PHDASTREAMSTATE pState = &pStream->State;
+    Assert(pState->cbPerSec);
 
-        /* Start transfers. */
-        hdaTimerMain(pThis);
-    }
+    return ASMMultU64ByU32DivByU32(TMTimerGetFreq(pState->pTimer), cb, pState->cbPerSec);
 }
 
 /**
- * Stops the internal audio device timer.
+ * Starts the DMA timer of a stream.
+ *
+ * The DMA position of the stream starts at the current time, with the stream
+ * being allowed to run up to one timer interval (or the first BDLE) ahead of it.
  *
  * @param   pThis               HDA state.
+ * @param   pStream             HDA stream to start the timer for.
  */
-static void hdaTimerStop(PHDASTATE pThis)
+static void hdaStreamTimerStart(PHDASTATE pThis, PHDASTREAM pStream)
 {
     LogFlowFuncEnter();
 
-    /* Set timer flag. */
-    ASMAtomicXchgBool(&pThis->fTimerActive, false);
+    PHDASTREAMSTATE pState = &pStream->State;
+
+    PTMTIMERR3 pTimer = pState->pTimer;
+    if (!pTimer)
+        return;
+
+    if (!ASMAtomicXchgBool(&pState->fRunning, true))
+    {
+        pThis->cStreamsActive++;
+
+        if (pThis->cStreamsActive == 1)
+            LogRel2(("HDA: Starting transfers\n"));
+    }
+
+    /* Determine the stream's data rate. Without one the transfers aren't paced at all. */
+    pState->cbPerSec = 0;
+    pState->cbFrame  = 0;
+
+    PDMAUDIOSTREAMCFG strmCfg;
+    RT_ZERO(strmCfg);
+    int rc = hdaSDFMTToStrmCfg(HDA_STREAM_REG(pThis, FMT, pStream->u8SD), &strmCfg);
+    if (RT_SUCCESS(rc))
+    {
+        PDMAUDIOPCMPROPS Props;
+        rc = DrvAudioHlpStreamCfgToProps(&strmCfg, &Props);
+        if (RT_SUCCESS(rc))
+        {
+            pState->cbFrame  = (Props.cBits / 8) * Props.cChannels;
+            pState->cbPerSec = Props.uHz * pState->cbFrame;
+        }
+    }
+
+    uint64_t const tsNow = TMTimerGet(pTimer);
+
+    if (pState->cbPerSec)
+    {
+        uint32_t cbLead = hdaStreamTicksToBytes(pStream, pThis->cTimerTicks);
+        if (pState->BDLE.Desc.u32BufSize > pState->BDLE.State.u32BufOff)
+            cbLead = RT_MIN(cbLead, pState->BDLE.Desc.u32BufSize - pState->BDLE.State.u32BufOff);
+
+        pState->tsTransfer = tsNow - hdaStreamBytesToTicks(pStream, cbLead);
+    }
+    else
+        pState->tsTransfer = tsNow;
+
+    LogFunc(("[SD%RU8]: cbPerSec=%RU32, cbFrame=%RU32\n", pStream->u8SD, pState->cbPerSec, pState->cbFrame));
+
+    /* The RUN bit gets latched only after we return, so do the first transfer a bit later. */
+    TMTimerSet(pTimer, tsNow + pThis->cTimerTicksMin);
 }
 
 /**
- * Decreases the active HDA streams count by one and
- * then checks if the internal audio device timer can be
- * stopped.
+ * Stops the DMA timer of a stream.
+ *
+ * The timer keeps running until the stream's sink has been drained,
+ * see hdaStreamTimerMain().
  *
  * @param   pThis               HDA state.
+ * @param   pStream             HDA stream to stop the timer for.
  */
-static void hdaTimerMaybeStop(PHDASTATE pThis)
+static void hdaStreamTimerStop(PHDASTATE pThis, PHDASTREAM pStream)
 {
     LogFlowFuncEnter();
 
-    if (!pThis->pTimer)
+    if (!pStream->State.pTimer)
         return;
 
-    if (pThis->cStreamsActive) /* Disable can be called mupltiple times. */
+    if (ASMAtomicXchgBool(&pStream->State.fRunning, false)) /* Disable can be called mupltiple times. */
     {
+        Assert(pThis->cStreamsActive);
         pThis->cStreamsActive--;
-
-        if (pThis->cStreamsActive == 0)
-            hdaTimerStop(pThis);
     }
 }
 
 /**
- * Main routine for the device timer.
+ * Main routine for a stream's DMA timer.
+ *
+ * Transfers as much data as the stream's position allows by now and
+ * re-arms the timer for when the current BDLE is due to complete, limited
+ * by the minimum and maximum timer interval.
  *
- * @returns IPRT status code.
  * @param   pThis               HDA state.
+ * @param   pStream             HDA stream to handle.
  */
-static void hdaTimerMain(PHDASTATE pThis)
+static void hdaStreamTimerMain(PHDASTATE pThis, PHDASTREAM pStream)
 {
     AssertPtrReturnVoid(pThis);
+    AssertPtrReturnVoid(pStream);
 
     STAM_PROFILE_START(&pThis->StatTimer, a);
 
-    uint64_t cTicksNow = TMTimerGet(pThis->pTimer);
+    PHDASTREAMSTATE pState = &pStream->State;
+    PTMTIMERR3      pTimer = pState->pTimer;
+
+    uint64_t const  tsNow    = TMTimerGet(pTimer);
+    bool const      fRunning = ASMAtomicReadBool(&pState->fRunning);
+    bool const      fPaced   = fRunning && pState->cbPerSec;
 
-    /* Update current time timestamp. */
-    pThis->uTimerTS = cTicksNow;
+    /* Only handle the stream if it is the one its sink currently is assigned to. */
+    PHDAMIXERSINK   pSink    = pStream->pMixSink;
+    if (   pSink
+        && hdaSinkGetStream(pThis, pSink) != pStream)
+        pSink = NULL;
 
     /* Flag indicating whether to kick the timer again for a
      * new data processing round. */
-    bool fKickTimer = false;
+    bool fKickTimer = fRunning;
+
+    if (pSink)
+    {
+        /* Work out how much data the stream's position allows to transfer by now. */
+        uint32_t cbToProcess = UINT32_MAX;
+        if (fPaced)
+        {
+            /* Don't try to catch up after the VM (or the host) stalled for a while. */
+            uint64_t const cTicksMaxLag = pThis->cTimerTicks * 4;
+            if (pState->tsTransfer + cTicksMaxLag < tsNow)
+                pState->tsTransfer = tsNow - cTicksMaxLag;
+
+            cbToProcess = pState->tsTransfer < tsNow
+                        ? hdaStreamTicksToBytes(pStream, tsNow - pState->tsTransfer) : 0;
+        }
+
+        uint32_t cbProcessed = 0;
+        int rc2 = hdaStreamUpdate(pThis, pStream, cbToProcess, &cbProcessed);
+        AssertRC(rc2);
 
-    hdaDoTransfers(pThis);
+        if (fPaced)
+            pState->tsTransfer += hdaStreamBytesToTicks(pStream, cbProcessed);
 
-    /* Do we need to kick the timer again? */
-    if (   AudioMixerSinkIsActive(pThis->SinkFront.pMixSink)
 #ifdef VBOX_WITH_AUDIO_HDA_51_SURROUND
-        || AudioMixerSinkIsActive(pThis->SinkCenterLFE.pMixSink)
-        || AudioMixerSinkIsActive(pThis->SinkRear.pMixSink)
-#endif
-        || AudioMixerSinkIsActive(pThis->SinkLineIn.pMixSink)
-#ifdef VBOX_WITH_AUDIO_HDA_MIC_IN
-        || AudioMixerSinkIsActive(pThis->SinkMicIn.pMixSink)
+        if (pSink == &pThis->SinkFront)
+        {
+            rc2 = AudioMixerSinkUpdate(pThis->SinkCenterLFE.pMixSink);
+            AssertRC(rc2);
+
+            rc2 = AudioMixerSinkUpdate(pThis->SinkRear.pMixSink);
+            AssertRC(rc2);
+            /** @todo Check for stream interleaving and only call hdaStreamDoDMA() if required! */
+
+            /*
+             * Only call hdaTransfer if CenterLFE and/or Rear are on different SDs,
+             * otherwise we have to use the interleaved streams support for getting the data
+             * out of the Front sink (depending on the mapping layout).
+             */
+        }
 #endif
-        )
-    {
-        fKickTimer = true;
+        /* Keep going until the sink has been drained. */
+        if (AudioMixerSinkIsActive(pSink->pMixSink))
+            fKickTimer = true;
     }
 
-    pThis->uTimerMS = RTTimeMilliTS();
-
-    if (   ASMAtomicReadBool(&pThis->fTimerActive)
-        || fKickTimer)
+    if (fKickTimer)
     {
-        /* Kick the timer again. */
-        uint64_t cTicks = pThis->cTimerTicks;
-        /** @todo adjust cTicks down by now much cbOutMin represents. */
-        TMTimerSet(pThis->pTimer, cTicksNow + cTicks);
+        uint64_t tsNext = tsNow + pThis->cTimerTicks;
+
+        if (   pSink
+            && fPaced)
+        {
+            /* Wake up when the current BDLE is due to complete, so that the guest gets its interrupt in time. */
+            hdaStreamLock(pStream);
+            uint32_t const cbBDLELeft = pState->BDLE.Desc.u32BufSize > pState->BDLE.State.u32BufOff
+                                      ? pState->BDLE.Desc.u32BufSize - pState->BDLE.State.u32BufOff : 0;
+            hdaStreamUnlock(pStream);
+
+            uint64_t const tsDue = RT_MAX(pState->tsTransfer + hdaStreamBytesToTicks(pStream, cbBDLELeft),
+                                          tsNow + pThis->cTimerTicksMin);
+            tsNext = RT_MIN(tsNext, tsDue);
+        }
+
+        TMTimerSet(pTimer, tsNext);
     }
     else
-        LogRel2(("HDA: Stopping transfers\n"));
+        LogRel2(("HDA: [SD%RU8] Stopping transfers\n", pStream->u8SD));
 
     STAM_PROFILE_STOP(&pThis->StatTimer, a);
 }
 
 /**
- * Timer callback which handles the audio data transfers on a periodic basis.
+ * Timer callback which handles the audio data transfers of a stream.
  *
  * @param   pDevIns             Device instance.
  * @param   pTimer              Timer which was used when calling this.
- * @param   pvUser              User argument as PHDASTATE.
+ * @param   pvUser              User argument as PHDASTREAM.
  */
-static DECLCALLBACK(void) hdaTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pvUser)
+static DECLCALLBACK(void) hdaStreamTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pvUser)
 {
-    RT_NOREF(pDevIns, pTimer);
+    RT_NOREF(pTimer);
 
-    PHDASTATE pThis = (PHDASTATE)pvUser;
-    Assert(pThis == PDMINS_2_DATA(pDevIns, PHDASTATE));
+    PHDASTATE pThis = PDMINS_2_DATA(pDevIns, PHDASTATE);
     AssertPtr(pThis);
 
-    hdaTimerMain(pThis);
+    PHDASTREAM pStream = (PHDASTREAM)pvUser;
+    AssertPtr(pStream);
+
+    hdaStreamTimerMain(pThis, pStream);
 }
 
 #else /* VBOX_WITH_AUDIO_HDA_CALLBACKS */
@@ -4027,70 +4252,128 @@ static DECLCALLBACK(int) hdaCallbackOutput(PDMAUDIOCBTYPE enmType, void *pvCtx,
 }
 #endif /* VBOX_WITH_AUDIO_HDA_CALLBACKS */
 
+#ifdef DEBUG_andy
+# define HDA_DEBUG_DMA
+#endif
+
 /**
- * Main routine to perform the actual audio data transfers from the HDA streams
- * to the backend(s) and vice versa.
+ * Releases the guest page mapping of a DMA transfer round, if any.
  *
  * @param   pThis               HDA state.
+ * @param   pMap                DMA mapping to release.
  */
-static void hdaDoTransfers(PHDASTATE pThis)
+static void hdaDMAMapRelease(PHDASTATE pThis, PHDADMAMAP pMap)
 {
-    PHDASTREAM pStreamLineIn  = hdaSinkGetStream(pThis, &pThis->SinkLineIn);
-#ifdef VBOX_WITH_AUDIO_HDA_MIC_IN
-    PHDASTREAM pStreamMicIn   = hdaSinkGetStream(pThis, &pThis->SinkMicIn);
-#endif
-    PHDASTREAM pStreamFront   = hdaSinkGetStream(pThis, &pThis->SinkFront);
-#ifdef VBOX_WITH_AUDIO_HDA_51_SURROUND
-    /** @todo See note below. */
-#endif
+    if (pMap->GCPhysPage != NIL_RTGCPHYS)
+    {
+        PDMDevHlpPhysReleasePageMappingLock(pThis->CTX_SUFF(pDevIns), &pMap->Lock);
 
-    hdaStreamUpdate(pThis, pStreamLineIn);
-#ifdef VBOX_WITH_AUDIO_HDA_MIC_IN
-    hdaStreamUpdate(pThis, pStreamMicIn);
-#endif
-    hdaStreamUpdate(pThis, pStreamFront);
+        pMap->GCPhysPage = NIL_RTGCPHYS;
+        pMap->pvPage     = NULL;
+    }
+}
 
+/**
+ * Copies data from or to guest memory for a DMA transfer.
+ *
+ * Accesses the guest pages through a mapping which is kept until the next
+ * page is needed, falling back to PDMDevHlpPhysRead / PDMDevHlpPhysWrite for
+ * memory which can't be mapped (MMIO, pages with access handlers).
+ *
+ * @returns IPRT status code.
+ * @param   pThis               HDA state.
+ * @param   pMap                DMA mapping to use.
+ * @param   GCPhys              Guest physical address to access.
+ * @param   pvBuf               Buffer to read data into / write data from.
+ * @param   cbBuf               Number of bytes to copy.
+ * @param   fWrite              Whether to write to (\c true) or read from (\c false) guest memory.
+ */
+static int hdaDMAMapCopy(PHDASTATE pThis, PHDADMAMAP pMap, RTGCPHYS GCPhys, void *pvBuf, uint32_t cbBuf, bool fWrite)
+{
+    PPDMDEVINS pDevIns = pThis->CTX_SUFF(pDevIns);
+    uint8_t   *pbBuf   = (uint8_t *)pvBuf;
 
-#ifdef VBOX_WITH_AUDIO_HDA_51_SURROUND
-    int rc2 = AudioMixerSinkUpdate(pThis->SinkCenterLFE.pMixSink);
-    AssertRC(rc2);
+    while (cbBuf)
+    {
+        RTGCPHYS const GCPhysPage = GCPhys & ~(RTGCPHYS)PAGE_OFFSET_MASK;
+        uint32_t const offPage    = (uint32_t)(GCPhys & PAGE_OFFSET_MASK);
+        uint32_t const cbChunk    = RT_MIN(cbBuf, PAGE_SIZE - offPage);
 
-    rc2 = AudioMixerSinkUpdate(pThis->SinkRear.pMixSink);
-    AssertRC(rc2);
-    /** @todo Check for stream interleaving and only call hdaStreamDoDMA() if required! */
+        if (   pMap->GCPhysPage != GCPhysPage
+            || (fWrite && !pMap->fWritable))
+        {
+            hdaDMAMapRelease(pThis, pMap);
 
-    /*
-     * Only call hdaTransfer if CenterLFE and/or Rear are on different SDs,
-     * otherwise we have to use the interleaved streams support for getting the data
-     * out of the Front sink (depending on the mapping layout).
-     */
-#endif
-}
+            int rc2;
+            if (fWrite)
+                rc2 = PDMDevHlpPhysGCPhys2CCPtr(pDevIns, GCPhysPage, 0 /* fFlags */, &pMap->pvPage, &pMap->Lock);
+            else
+                rc2 = PDMDevHlpPhysGCPhys2CCPtrReadOnly(pDevIns, GCPhysPage, 0 /* fFlags */,
+                                                        (void const **)&pMap->pvPage, &pMap->Lock);
+            if (RT_SUCCESS(rc2))
+            {
+                pMap->GCPhysPage = GCPhysPage;
+                pMap->fWritable  = fWrite;
+            }
+        }
 
-#ifdef DEBUG_andy
-# define HDA_DEBUG_DMA
-#endif
+        if (pMap->GCPhysPage == GCPhysPage)
+        {
+            if (fWrite)
+                memcpy((uint8_t *)pMap->pvPage + offPage, pbBuf, cbChunk);
+            else
+                memcpy(pbBuf, (uint8_t *)pMap->pvPage + offPage, cbChunk);
+        }
+        else
+        {
+            int rc = fWrite
+                   ? PDMDevHlpPhysWrite(pDevIns, GCPhys, pbBuf, cbChunk)
+                   : PDMDevHlpPhysRead(pDevIns, GCPhys, pbBuf, cbChunk);
+            if (RT_FAILURE(rc))
+                return rc;
+        }
+
+        GCPhys += cbChunk;
+        pbBuf  += cbChunk;
+        cbBuf  -= cbChunk;
+    }
+
+    return VINF_SUCCESS;
+}
 
 /**
  * Does a single DMA transfer for a specific HDA stream (SDI/SDO).
  * This either can be a read or write operation, depending on the HDA stream.
  *
+ * Stops after a BDLE which requested an interrupt on completion, so that the
+ * guest gets to handle the interrupt before the next BDLE is processed.
+ *
  * @returns IPRT status code.
  * @param   pThis               HDA state.
  * @param   pStream             HDA stream to do the DMA transfer for.
+ * @param   pMap                DMA mapping to use for accessing guest memory.
  * @param   pvBuf               Pointer to buffer data to write data to / read data from.
  * @param   cbBuf               Size of buffer (in bytes).
  * @param   cbToProcess         Size (in bytes) to transfer (read/write).
- * @param   pcbProcessed        Size (in bytes) transferred (read/written). Optional.
+ * @param   pcbProcessed        Size (in bytes) transferred (read/written), also
+ *                              on failure. Optional.
+ * @param   pfStop              Where to return whether the caller must not do any
+ *                              further transfers for now, either because the guest
+ *                              has to handle a completion interrupt first or because
+ *                              guest memory could not be accessed. Optional.
  */
-static int hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, void *pvBuf, uint32_t cbBuf,
-                          uint32_t cbToProcess, uint32_t *pcbProcessed)
+static int hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, PHDADMAMAP pMap, void *pvBuf, uint32_t cbBuf,
+                          uint32_t cbToProcess, uint32_t *pcbProcessed, bool *pfStop)
 {
     AssertPtrReturn(pThis,             VERR_INVALID_POINTER);
     AssertPtrReturn(pStream,           VERR_INVALID_POINTER);
+    AssertPtrReturn(pMap,              VERR_INVALID_POINTER);
     AssertPtrReturn(pvBuf,             VERR_INVALID_POINTER);
     AssertReturn(cbBuf >= cbToProcess, VERR_INVALID_PARAMETER);
-    /* pcbProcessed is optional. */
+    /* pcbProcessed and pfStop are optional. */
+
+    if (pfStop)
+        *pfStop = false;
 
     if (ASMAtomicReadBool(&pThis->fInReset)) /* HDA controller in reset mode? Bail out. */
     {
@@ -4137,9 +4420,9 @@ static int hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, void *pvBuf, uint
     Assert(HDA_STREAM_REG(pThis, LPIB, pStream->u8SD) <= pStream->u32CBL);
 
     bool fSendInterrupt = false;
+    bool fStop          = false;
 
-    /* Only do one FIFO size at a time. */
-    uint32_t cbLeft           = RT_MIN(pStream->u16FIFOS, RT_MIN(cbToProcess, cbBuf));
+    uint32_t cbLeft           = RT_MIN(cbToProcess, cbBuf);
     uint32_t cbTotal          = 0;
     uint32_t cbChunk          = 0;
     uint32_t cbChunkProcessed = 0;
@@ -4161,17 +4444,15 @@ static int hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, void *pvBuf, uint
 
         if (cbChunk)
         {
-            if (hdaGetDirFromSD(pStream->u8SD) == PDMAUDIODIR_OUT) /* Output (SDO). */
-            {
-                PDMDevHlpPhysRead(pThis->CTX_SUFF(pDevIns),
-                                  pBDLE->Desc.u64BufAdr + pBDLE->State.u32BufOff,
-                                  (uint8_t *)pvBuf + cbTotal, cbChunk);
-            }
-            else /* Input (SDI). */
+            rc = hdaDMAMapCopy(pThis, pMap, pBDLE->Desc.u64BufAdr + pBDLE->State.u32BufOff, (uint8_t *)pvBuf + cbTotal, cbChunk,
+                               hdaGetDirFromSD(pStream->u8SD) == PDMAUDIODIR_IN /* fWrite */);
+            if (RT_FAILURE(rc))
             {
-                PDMDevHlpPhysWrite(pThis->CTX_SUFF(pDevIns),
-                                   pBDLE->Desc.u64BufAdr + pBDLE->State.u32BufOff,
-                                   (uint8_t *)pvBuf + cbTotal, cbChunk);
+                /* Leave the BDLE and LPIB as they are, so that nothing gets accounted which wasn't transferred. */
+                LogRel2(("HDA: [SD%RU8] Accessing DMA buffer at 0x%RX64 failed with %Rrc, stopping transfer\n",
+                         pStream->u8SD, pBDLE->Desc.u64BufAdr + pBDLE->State.u32BufOff, rc));
+                fStop = true;
+                break;
             }
 
 #ifdef HDA_DEBUG_DUMP_PCM_DATA
@@ -4222,10 +4503,20 @@ static int hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, void *pvBuf, uint
                     hdaStreamUpdateLPIB(pThis, pStream, 0);
                 }
             }
+
+            /* Let the guest handle the interrupt first. */
+            if (fNeedsInterrupt)
+            {
+                fStop = true;
+                break;
+            }
         }
 
         if (RT_FAILURE(rc))
+        {
+            fStop = true;
             break;
+        }
     }
 
     Log3Func(("[SD%RU8]: cbLeft=%RU32, rc=%Rrc\n", pStream->u8SD, cbLeft, rc));
@@ -4251,11 +4542,11 @@ static int hdaStreamDoDMA(PHDASTATE pThis, PHDASTREAM pStream, void *pvBuf, uint
         hdaProcessInterrupt(pThis);
     }
 
-    if (RT_SUCCESS(rc))
-    {
-        if (pcbProcessed)
-            *pcbProcessed = cbTotal;
-    }
+    /* Report what got transferred before a failure as well, as the BDLE and LPIB account for it already. */
+    if (pcbProcessed)
+        *pcbProcessed = cbTotal;
+    if (pfStop)
+        *pfStop = fStop;
 
 #ifdef HDA_DEBUG_DMA
     Log3Func(("[SD%RU8] DMA: End\n", pStream->u8SD));
@@ -4628,11 +4919,17 @@ static void hdaStreamAsyncIOEnable(PHDASTREAM pStream, bool fEnable)
  * @returns IPRT status code.
  * @param   pThis               HDA state.
  * @param   pStream             HDA stream to update.
+ * @param   cbToProcess         Maximum number of bytes to transfer via DMA.
+ * @param   pcbProcessed        Number of bytes transferred via DMA. Optional.
  */
-static int hdaStreamUpdate(PHDASTATE pThis, PHDASTREAM pStream)
+static int hdaStreamUpdate(PHDASTATE pThis, PHDASTREAM pStream, uint32_t cbToProcess, uint32_t *pcbProcessed)
 {
     AssertPtrReturn(pThis,   VERR_INVALID_POINTER);
     AssertPtrReturn(pStream, VERR_INVALID_POINTER);
+    /* pcbProcessed is optional. */
+
+    if (pcbProcessed)
+        *pcbProcessed = 0;
 
     hdaStreamLock(pStream);
 
@@ -4648,59 +4945,57 @@ static int hdaStreamUpdate(PHDASTATE pThis, PHDASTREAM pStream)
         return VINF_SUCCESS;
     }
 
-    Log2Func(("[SD%RU8]\n", pStream->u8SD));
+    Log2Func(("[SD%RU8] cbToProcess=%RU32\n", pStream->u8SD, cbToProcess));
+
+    /* The guest page mapping is kept for this round only. */
+    HDADMAMAP Map;
+    Map.GCPhysPage = NIL_RTGCPHYS;
+    Map.pvPage     = NULL;
+    Map.fWritable  = false;
+
+    uint32_t cbLeft      = cbToProcess;
+    uint32_t cbProcessed = 0;
 
     bool fDone = false;
     uint8_t cTransfers = 0;
 
     while (!fDone)
     {
+#ifndef VBOX_WITH_AUDIO_HDA_ASYNC_IO
         int rc2;
+#endif
         uint32_t cbDMA = 0;
+        bool fStop = false;
 
         if (hdaGetDirFromSD(pStream->u8SD) == PDMAUDIODIR_OUT) /* Output (SDO). */
         {
             STAM_PROFILE_START(&pThis->StatOut, a);
 
             /*
-             * Read from DMA.
+             * Read from DMA, straight into the stream's circular buffer.
              */
 
-            uint8_t abFIFO[HDA_FIFO_MAX + 1];
-            size_t  offFIFO = 0;
-
-            /* Do one DMA transfer with FIFOS size at a time. */
-            rc2 = hdaStreamDoDMA(pThis, pStream, abFIFO, sizeof(abFIFO), (uint32_t)pStream->u16FIFOS /* cbToProcess */, &cbDMA);
-            AssertRC(rc2);
-
-            uint32_t cbDMALeft = cbDMA;
-
-            while (   cbDMALeft
-                   && RTCircBufFree(pCircBuf))
+            if (cbLeft)
             {
                 void *pvDst;
                 size_t cbDst;
 
-                RTCircBufAcquireWriteBlock(pCircBuf, cbDMALeft, &pvDst, &cbDst);
+                RTCircBufAcquireWriteBlock(pCircBuf, cbLeft, &pvDst, &cbDst);
 
                 if (cbDst)
-                {
-                    memcpy(pvDst, abFIFO + offFIFO, cbDst);
+                    hdaStreamDoDMA(pThis, pStream, &Map, pvDst, (uint32_t)cbDst, (uint32_t)cbDst /* cbToProcess */,
+                                   &cbDMA, &fStop);
 
-                    offFIFO += cbDst;
-                    Assert(offFIFO <= sizeof(abFIFO));
-                }
+                RTCircBufReleaseWriteBlock(pCircBuf, cbDMA);
 
-                RTCircBufReleaseWriteBlock(pCircBuf, cbDst);
+                Assert(cbDMA <= cbLeft);
+                cbLeft      -= cbDMA;
+                cbProcessed += cbDMA;
 
-                Assert(cbDst <= cbDMALeft);
-                cbDMALeft -= (uint32_t)cbDst;
+                /* No more DMA this round, but keep processing what has been read so far. */
+                if (fStop)
+                    cbLeft = 0;
             }
-
-#ifdef DEBUG_andy
-            AssertMsg(cbDMALeft == 0, ("%RU32 bytes of DMA data left, CircBuf=%zu/%zu\n",
-                                       cbDMALeft, RTCircBufUsed(pCircBuf), RTCircBufSize(pCircBuf)));
-#endif
             /*
              * Process backends.
              */
@@ -4750,27 +5045,38 @@ static int hdaStreamUpdate(PHDASTATE pThis, PHDASTREAM pStream)
             rc2 = AudioMixerSinkUpdate(pSink->pMixSink);
             AssertRC(rc2);
 
-            /* Write read data from the backend to the HDA stream. */
-            rc2 = hdaStreamWrite(pThis, pStream, pStream->u16FIFOS, NULL /* pcbWritten */);
-            AssertRC(rc2);
+            /* Write read data from the backend to the HDA stream, as much as the DMA transfer needs. */
+            uint32_t const cbUsed = (uint32_t)RTCircBufUsed(pCircBuf);
+            if (cbLeft > cbUsed)
+            {
+                rc2 = hdaStreamWrite(pThis, pStream, cbLeft - cbUsed, NULL /* pcbWritten */);
+                AssertRC(rc2);
+            }
 #endif
             /*
              * Write to DMA.
              */
 
             void *pvSrc;
-            size_t cbSrc;
+            size_t cbSrc = 0;
 
-            RTCircBufAcquireReadBlock(pCircBuf, pStream->u16FIFOS, &pvSrc, &cbSrc);
+            if (cbLeft)
+                RTCircBufAcquireReadBlock(pCircBuf, cbLeft, &pvSrc, &cbSrc);
 
             if (cbSrc)
             {
-                /* Do one DMA transfer with FIFOS size at a time. */
-                rc2 = hdaStreamDoDMA(pThis, pStream, pvSrc, (uint32_t)cbSrc, (uint32_t)cbSrc /* cbToProcess */, &cbDMA);
-                AssertRC(rc2);
-            }
+                hdaStreamDoDMA(pThis, pStream, &Map, pvSrc, (uint32_t)cbSrc, (uint32_t)cbSrc /* cbToProcess */, &cbDMA, &fStop);
 
-            RTCircBufReleaseReadBlock(pCircBuf, cbDMA);
+                RTCircBufReleaseReadBlock(pCircBuf, cbDMA);
+
+                Assert(cbDMA <= cbLeft);
+                cbLeft      -= cbDMA;
+                cbProcessed += cbDMA;
+
+                /* No more DMA this round. */
+                if (fStop)
+                    cbLeft = 0;
+            }
 
             /* All DMA transfers done for now? */
             if (!cbDMA)
@@ -4786,10 +5092,15 @@ static int hdaStreamUpdate(PHDASTATE pThis, PHDASTREAM pStream)
 
     } /* while !fDone */
 
-    Log2Func(("[SD%RU8] End\n", pStream->u8SD));
+    hdaDMAMapRelease(pThis, &Map);
+
+    Log2Func(("[SD%RU8] End (%RU32 bytes transferred)\n", pStream->u8SD, cbProcessed));
 
     hdaStreamUnlock(pStream);
 
+    if (pcbProcessed)
+        *pcbProcessed = cbProcessed;
+
     return VINF_SUCCESS;
 }
 #endif /* IN_RING3 */
@@ -5803,9 +6114,16 @@ static DECLCALLBACK(void) hdaReset(PPDMDEVINS pDevIns)
 
 # ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
     /*
-     * Stop the timer, if any.
+     * Stop the stream timers, if any.
      */
-    hdaTimerStop(pThis);
+    for (uint8_t i = 0; i < HDA_MAX_STREAMS; i++)
+    {
+        PHDASTREAM pStream = &pThis->aStreams[i];
+
+        ASMAtomicWriteBool(&pStream->State.fRunning, false);
+        if (pStream->State.pTimer)
+            TMTimerStop(pStream->State.pTimer);
+    }
 
     pThis->cStreamsActive = 0;
 # endif
@@ -6586,16 +6904,26 @@ static DECLCALLBACK(int) hdaConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMNO
 # ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
     if (RT_SUCCESS(rc))
     {
-        /* Create the emulation timer. */
-        rc = PDMDevHlpTMTimerCreate(pDevIns, TMCLOCK_VIRTUAL, hdaTimer, pThis,
-                                    TMTIMER_FLAGS_NO_CRIT_SECT, "DevHDA", &pThis->pTimer);
-        AssertRCReturn(rc, rc);
+        /* Create the DMA timers, one per stream. */
+        static const char * const s_apszTimerNames[HDA_MAX_STREAMS] =
+        {
+            "HDA SD0", "HDA SD1", "HDA SD2", "HDA SD3", "HDA SD4", "HDA SD5", "HDA SD6", "HDA SD7"
+        };
+
+        for (uint8_t i = 0; i < HDA_MAX_STREAMS; i++)
+        {
+            rc = PDMDevHlpTMTimerCreate(pDevIns, TMCLOCK_VIRTUAL, hdaStreamTimer, &pThis->aStreams[i],
+                                        TMTIMER_FLAGS_NO_CRIT_SECT, s_apszTimerNames[i], &pThis->aStreams[i].State.pTimer);
+            AssertRCReturn(rc, rc);
+        }
 
         if (RT_SUCCESS(rc))
         {
-            pThis->cTimerTicks = TMTimerGetFreq(pThis->pTimer) / uTimerHz;
-            pThis->uTimerTS    = TMTimerGet(pThis->pTimer);
-            LogFunc(("Timer ticks=%RU64 (%RU16 Hz)\n", pThis->cTimerTicks, uTimerHz));
+            uint64_t const uTimerFreq = TMTimerGetFreq(pThis->aStreams[0].State.pTimer);
+
+            pThis->cTimerTicks    = uTimerFreq / RT_MAX(uTimerHz, 1);
+            pThis->cTimerTicksMin = RT_MIN(uTimerFreq / HDA_TIMER_HZ_MAX, pThis->cTimerTicks);
+            LogFunc(("Timer ticks=%RU64..%RU64 (%RU16 Hz)\n", pThis->cTimerTicksMin, pThis->cTimerTicks, uTimerHz));
         }
     }
 # else
@@ -6637,7 +6965,7 @@ static DECLCALLBACK(int) hdaConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMNO
          * Register statistics.
          */
 #  ifndef VBOX_WITH_AUDIO_HDA_CALLBACKS
-        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatTimer,            STAMTYPE_PROFILE, "/Devices/HDA/Timer",             STAMUNIT_TICKS_PER_CALL, "Profiling hdaTimer.");
+        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatTimer,            STAMTYPE_PROFILE, "/Devices/HDA/Timer",             STAMUNIT_TICKS_PER_CALL, "Profiling hdaStreamTimer.");
 #  endif
         PDMDevHlpSTAMRegister(pDevIns, &pThis->StatIn,               STAMTYPE_PROFILE, "/Devices/HDA/Input",             STAMUNIT_TICKS_PER_CALL, "Profiling input.");
         PDMDevHlpSTAMRegister(pDevIns, &pThis->StatOut,              STAMTYPE_PROFILE, "/Devices/HDA/Output",            STAMUNIT_TICKS_PER_CALL, "Profiling output.");
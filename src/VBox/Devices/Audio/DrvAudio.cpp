@@ -410,6 +410,15 @@ static int drvAudioStreamControlInternal(PDRVAUDIO pThis, PPDMAUDIOSTREAM pStrea
                      */
                     if (pHstStream->enmDir == PDMAUDIODIR_OUT)
                     {
+                        /* Hand the frames still held back by the rate conversion to the host side,
+                         * otherwise the end of the stream would be cut off. */
+                        uint32_t csDrained = 0;
+                        int rc2 = AudioMixBufDrainToParent(&pGstStream->MixBuf, &csDrained);
+                        if (RT_FAILURE(rc2))
+                            LogRel2(("Audio: Unable to drain the end of stream '%s', rc=%Rrc\n", pGstStream->szName, rc2));
+                        else if (csDrained)
+                            LogFunc(("[%s] Drained %RU32 samples\n", pGstStream->szName, csDrained));
+
                         LogFunc(("[%s] Pending disable/pause\n", pHstStream->szName));
                         pHstStream->fStatus |= PDMAUDIOSTRMSTS_FLAG_PENDING_DISABLE;
                     }
@@ -26,15 +26,34 @@
 #include <iprt/stream.h>
 #include <iprt/string.h>
 #include <iprt/test.h>
+#include <iprt/time.h>
 
 
 #include "../AudioMixBuffer.h"
 #include "../DrvAudio.h"
 
+#include <math.h>
+
 
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
+/** A stereo frame of the reference model. */
+typedef struct TSTREFFRAME
+{
+    int64_t     iLeft;
+    int64_t     iRight;
+} TSTREFFRAME;
+
+/** Reference linear resampler state. */
+typedef struct TSTREFRATE
+{
+    uint64_t    dstOffset;
+    uint64_t    dstInc;
+    uint32_t    srcOffset;
+    TSTREFFRAME srcLast;
+} TSTREFRATE;
+
 
 static int tstSingle(RTTEST hTest)
 {
@@ -285,9 +304,9 @@ static int tstConversion8(RTTEST hTest)
     /* Child uses half the sample rate; that ensures the mixing engine can't
      * take shortcuts and performs conversion. Because conversion to double
      * the sample rate effectively inserts one additional sample between every
-     * two source samples, N source samples will be converted to N * 2 - 1
-     * samples. However, the last source sample will be saved for later
-     * interpolation and not immediately output.
+     * two source samples, N source samples will be converted to N * 2
+     * samples. However, the resampling filter holds back the last
+     * AUDIOMIXBUF_RESAMPLE_HALF_TAPS source samples until more input arrives.
      */
     PDMAUDIOSTREAMCFG cfg_c =   /* Upmixing to parent */
     {
@@ -319,7 +338,7 @@ static int tstConversion8(RTTEST hTest)
     uint32_t    cSamplesRead, cSamplesWritten, cSamplesMixed;
 
     uint32_t cSamplesChild  = 16;
-    uint32_t cSamplesParent = cSamplesChild * 2 - 2;
+    uint32_t cSamplesParent = (cSamplesChild - AUDIOMIXBUF_RESAMPLE_HALF_TAPS) * 2;
     uint32_t cSamplesTotalRead   = 0;
 
     /**** 8-bit unsigned samples ****/
@@ -348,7 +367,7 @@ static int tstConversion8(RTTEST hTest)
     uint8_t *pSrc8 = &samples[0];
     uint8_t *pDst8 = (uint8_t *)achBuf;
 
-    for (i = 0; i < cSamplesChild - 1; ++i)
+    for (i = 0; i < cSamplesParent / 2; ++i)
     {
         RTTESTI_CHECK_MSG(*pSrc8 == *pDst8, ("index %u: Dst=%d, Src=%d\n", i, *pDst8, *pSrc8));
         pSrc8 += 1;
@@ -420,7 +439,7 @@ static int tstConversion16(RTTEST hTest)
     uint32_t    cSamplesRead, cSamplesWritten, cSamplesMixed;
 
     uint32_t cSamplesChild  = 16;
-    uint32_t cSamplesParent = cSamplesChild * 2 - 2;
+    uint32_t cSamplesParent = (cSamplesChild - AUDIOMIXBUF_RESAMPLE_HALF_TAPS) * 2;
     uint32_t cSamplesTotalRead   = 0;
 
     /**** 16-bit signed samples ****/
@@ -448,7 +467,7 @@ static int tstConversion16(RTTEST hTest)
     int16_t *pSrc16 = &samples[0];
     int16_t *pDst16 = (int16_t *)achBuf;
 
-    for (i = 0; i < cSamplesChild - 1; ++i)
+    for (i = 0; i < cSamplesParent / 2; ++i)
     {
         RTTESTI_CHECK_MSG(*pSrc16 == *pDst16, ("index %u: Dst=%d, Src=%d\n", i, *pDst16, *pSrc16));
         pSrc16 += 1;
@@ -584,6 +603,587 @@ static int tstVolume(RTTEST hTest)
     return RTTestSubErrorCount(hTest) ? VERR_GENERAL_FAILURE : VINF_SUCCESS;
 }
 
+/*
+ * Reference model of the previous mixing engine (64-bit stereo samples,
+ * volume applied while decoding, linear interpolation). Used to check the
+ * conversion results bit by bit and as the baseline for the resampling
+ * quality and the benchmark.
+ */
+
+static uint32_t tstRefBytesPerSample(PDMAUDIOFMT enmFmt)
+{
+    switch (enmFmt)
+    {
+        case PDMAUDIOFMT_S8:
+        case PDMAUDIOFMT_U8:    return 1;
+        case PDMAUDIOFMT_S16:
+        case PDMAUDIOFMT_U16:   return 2;
+        default:                return 4;
+    }
+}
+
+
+static int64_t tstRefDecode(PDMAUDIOFMT enmFmt, uint8_t const *pb)
+{
+    switch (enmFmt)
+    {
+        case PDMAUDIOFMT_S8:    return (int64_t)*(int8_t const *)pb * _16M;
+        case PDMAUDIOFMT_U8:    return ((int64_t)*pb - 0x80) * _16M;
+        case PDMAUDIOFMT_S16:   return (int64_t)*(int16_t const *)pb * _64K;
+        case PDMAUDIOFMT_U16:   return ((int64_t)*(uint16_t const *)pb - 0x8000) * _64K;
+        case PDMAUDIOFMT_S32:   return *(int32_t const *)pb;
+        default:                return (int64_t)*(uint32_t const *)pb - UINT32_C(0x80000000);
+    }
+}
+
+
+static void tstRefEncode(PDMAUDIOFMT enmFmt, int64_t iVal, uint8_t *pb)
+{
+    if (iVal > INT32_MAX)
+        iVal = INT32_MAX;
+    else if (iVal < INT32_MIN)
+        iVal = INT32_MIN;
+    switch (enmFmt)
+    {
+        case PDMAUDIOFMT_S8:    *(int8_t *)pb   = (int8_t)(iVal >> 24); break;
+        case PDMAUDIOFMT_U8:    *pb             = (uint8_t)((iVal >> 24) + 0x80); break;
+        case PDMAUDIOFMT_S16:   *(int16_t *)pb  = (int16_t)(iVal >> 16); break;
+        case PDMAUDIOFMT_U16:   *(uint16_t *)pb = (uint16_t)((iVal >> 16) + 0x8000); break;
+        case PDMAUDIOFMT_S32:   *(int32_t *)pb  = (int32_t)iVal; break;
+        default:                *(uint32_t *)pb = (uint32_t)(iVal + UINT32_C(0x80000000)); break;
+    }
+}
+
+
+/**
+ * Decodes PCM data into reference frames, applying the volume (in
+ * s_aVolumeConv units, i.e. 65536 is 0dB) like the old engine did.
+ */
+static void tstRefConvFrom(TSTREFFRAME *paDst, PDMAUDIOFMT enmFmt, uint8_t cChannels, void const *pvSrc,
+                           uint32_t cFrames, uint32_t uVolLeft, uint32_t uVolRight)
+{
+    uint32_t const cbSample = tstRefBytesPerSample(enmFmt);
+    uint8_t const *pbSrc    = (uint8_t const *)pvSrc;
+    for (uint32_t i = 0; i < cFrames; i++, pbSrc += cbSample * cChannels)
+    {
+        paDst[i].iLeft  = (tstRefDecode(enmFmt, pbSrc) * (int64_t)(uVolLeft << 14)) >> 30;
+        paDst[i].iRight = (tstRefDecode(enmFmt, pbSrc + (cChannels > 1 ? cbSample : 0)) * (int64_t)(uVolRight << 14)) >> 30;
+    }
+}
+
+
+/** Encodes reference frames, mono output being the average of both channels. */
+static void tstRefConvTo(void *pvDst, PDMAUDIOFMT enmFmt, uint8_t cChannels, TSTREFFRAME const *paSrc, uint32_t cFrames)
+{
+    uint32_t const cbSample = tstRefBytesPerSample(enmFmt);
+    uint8_t       *pbDst    = (uint8_t *)pvDst;
+    for (uint32_t i = 0; i < cFrames; i++)
+    {
+        if (cChannels > 1)
+        {
+            tstRefEncode(enmFmt, paSrc[i].iLeft,  pbDst);
+            tstRefEncode(enmFmt, paSrc[i].iRight, pbDst + cbSample);
+        }
+        else
+            tstRefEncode(enmFmt, (paSrc[i].iLeft + paSrc[i].iRight) / 2, pbDst);
+        pbDst += cbSample * cChannels;
+    }
+}
+
+
+/** The linear interpolation of the old engine, state kept across calls. */
+static uint32_t tstRefResample(TSTREFRATE *pRate, TSTREFFRAME const *paSrc, uint32_t cSrc, TSTREFFRAME *paDst, uint32_t cDst)
+{
+    TSTREFFRAME const *pSrc    = paSrc;
+    TSTREFFRAME const *pSrcEnd = paSrc + cSrc;
+    TSTREFFRAME       *pDst    = paDst;
+    TSTREFFRAME       *pDstEnd = paDst + cDst;
+    TSTREFFRAME        srcLast = pRate->srcLast;
+    TSTREFFRAME        srcCur  = srcLast;
+
+    while (pDst < pDstEnd)
+    {
+        while (pRate->srcOffset <= (pRate->dstOffset >> 32))
+        {
+            if (pSrc >= pSrcEnd)
+                break;
+            srcLast = *pSrc++;
+            pRate->srcOffset++;
+        }
+        if (pSrc >= pSrcEnd)
+            break;
+        srcCur = *pSrc;
+
+        int64_t const iFrac = pRate->dstOffset & UINT32_MAX;
+        pDst->iLeft  = (srcLast.iLeft  * ((int64_t)UINT32_MAX - iFrac) + srcCur.iLeft  * iFrac) >> 32;
+        pDst->iRight = (srcLast.iRight * ((int64_t)UINT32_MAX - iFrac) + srcCur.iRight * iFrac) >> 32;
+        pDst++;
+        pRate->dstOffset += pRate->dstInc;
+    }
+
+    pRate->srcLast = srcLast;
+    return (uint32_t)(pDst - paDst);
+}
+
+
+/**
+ * Pumps a buffer of S16 frames through a child -> parent chain in small
+ * chunks, collecting everything the parent produces.
+ *
+ * @returns Number of frames collected.
+ */
+static uint32_t tstPump(PPDMAUDIOMIXBUF pChild, PPDMAUDIOMIXBUF pParent, uint8_t const *pbSrc, uint32_t cSrcFrames,
+                        uint8_t *pbDst, uint32_t cDstFrames, uint32_t cChunk)
+{
+    uint32_t const cbSrcFrame = AUDIOMIXBUF_S2B(pChild, 1);
+    uint32_t const cbDstFrame = AUDIOMIXBUF_S2B(pParent, 1);
+    uint32_t       cDst       = 0;
+    for (uint32_t offSrc = 0; offSrc < cSrcFrames; )
+    {
+        uint32_t cWritten = 0, cMixed = 0, cRead = 0;
+        uint32_t const cToWrite = RT_MIN(cChunk, cSrcFrames - offSrc);
+        RTTESTI_CHECK_RC_OK_BREAK(AudioMixBufWriteCirc(pChild, &pbSrc[offSrc * cbSrcFrame], cToWrite * cbSrcFrame, &cWritten));
+        RTTESTI_CHECK_RC_OK_BREAK(AudioMixBufMixToParent(pChild, cWritten, &cMixed));
+        RTTESTI_CHECK_BREAK(cMixed == cWritten);
+        offSrc += cWritten;
+
+        for (;;)
+        {
+            RTTESTI_CHECK_RC_OK_BREAK(AudioMixBufReadCirc(pParent, &pbDst[cDst * cbDstFrame],
+                                                          (cDstFrames - cDst) * cbDstFrame, &cRead));
+            if (!cRead)
+                break;
+            cDst += cRead;
+            AudioMixBufFinish(pParent, cRead);
+        }
+    }
+    return cDst;
+}
+
+
+static int tstReference(RTTEST hTest)
+{
+    RTTestSubF(hTest, "Conversion against the reference");
+
+    static PDMAUDIOFMT const s_aenmFmts[] =
+    {
+        PDMAUDIOFMT_S8, PDMAUDIOFMT_U8, PDMAUDIOFMT_S16, PDMAUDIOFMT_U16, PDMAUDIOFMT_S32, PDMAUDIOFMT_U32
+    };
+    /* Volume steps and the matching s_aVolumeConv entries. */
+    static struct { uint8_t uLeft, uRight; uint32_t uConvLeft, uConvRight; } const s_aVols[] =
+    {
+        { 255, 255, 65536, 65536 },
+        { 239, 239, 32768, 32768 },
+        { 247, 200, 46341,  6049 },
+        { 130,   0,   292,     1 },
+    };
+
+    /* Not a multiple of the SIMD width so the tail code gets exercised as well. */
+    uint32_t const  cFrames = 1000;
+    uint8_t        *pbSrc   = (uint8_t *)RTMemAlloc(cFrames * 2 * sizeof(int32_t));
+    uint8_t        *pbDst   = (uint8_t *)RTMemAlloc(cFrames * 2 * sizeof(int32_t));
+    uint8_t        *pbRef   = (uint8_t *)RTMemAlloc(cFrames * 2 * sizeof(int32_t));
+    TSTREFFRAME    *paRef   = (TSTREFFRAME *)RTMemAlloc(cFrames * sizeof(TSTREFFRAME));
+    RTTESTI_CHECK_RET(pbSrc && pbDst && pbRef && paRef, VERR_NO_MEMORY);
+
+    /* Random data with the extremes sprinkled in. */
+    RTRandBytes(pbSrc, cFrames * 2 * sizeof(int32_t));
+    for (uint32_t i = 0; i < 64; i++)
+        pbSrc[RTRandU32Ex(0, cFrames * 2 * sizeof(int32_t) - 1)] = i & 1 ? 0xff : 0x00;
+
+    for (unsigned iFmtChild = 0; iFmtChild < RT_ELEMENTS(s_aenmFmts); iFmtChild++)
+        for (uint8_t cChChild = 1; cChChild <= 2; cChChild++)
+            for (unsigned iFmtParent = 0; iFmtParent < RT_ELEMENTS(s_aenmFmts); iFmtParent++)
+                for (uint8_t cChParent = 1; cChParent <= 2; cChParent++)
+                    for (unsigned iVol = 0; iVol < RT_ELEMENTS(s_aVols); iVol++)
+                    {
+                        /* A mono source ends up in both channels with the average volume now. */
+                        if (   cChChild == 1
+                            && cChParent == 2
+                            && s_aVols[iVol].uLeft != s_aVols[iVol].uRight)
+                            continue;
+
+                        PDMAUDIOSTREAMCFG CfgChild  = { "Child", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, 44100,
+                                                        cChChild, s_aenmFmts[iFmtChild], PDMAUDIOENDIANNESS_LITTLE };
+                        PDMAUDIOSTREAMCFG CfgParent = { "Parent", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, 44100,
+                                                        cChParent, s_aenmFmts[iFmtParent], PDMAUDIOENDIANNESS_LITTLE };
+                        PDMAUDIOPCMPROPS  Props;
+                        PDMAUDIOMIXBUF    Parent, Child;
+
+                        RTTESTI_CHECK_RC_OK_RET(DrvAudioHlpStreamCfgToProps(&CfgParent, &Props), VERR_GENERAL_FAILURE);
+                        RTTESTI_CHECK_RC_OK_RET(AudioMixBufInit(&Parent, "Parent", &Props, cFrames), VERR_GENERAL_FAILURE);
+                        RTTESTI_CHECK_RC_OK_RET(DrvAudioHlpStreamCfgToProps(&CfgChild, &Props), VERR_GENERAL_FAILURE);
+                        RTTESTI_CHECK_RC_OK_RET(AudioMixBufInit(&Child, "Child", &Props, cFrames), VERR_GENERAL_FAILURE);
+                        RTTESTI_CHECK_RC_OK_RET(AudioMixBufLinkTo(&Child, &Parent), VERR_GENERAL_FAILURE);
+
+                        PDMAUDIOVOLUME Vol = { false, s_aVols[iVol].uLeft, s_aVols[iVol].uRight };
+                        AudioMixBufSetVolume(&Child, &Vol);
+
+                        uint32_t const cbChildFrame  = tstRefBytesPerSample(CfgChild.enmFormat)  * cChChild;
+                        uint32_t const cbParentFrame = tstRefBytesPerSample(CfgParent.enmFormat) * cChParent;
+                        uint32_t const cRead = tstPump(&Child, &Parent, pbSrc, cFrames, pbDst, cFrames, cFrames);
+                        RTTESTI_CHECK(cRead == cFrames);
+
+                        tstRefConvFrom(paRef, CfgChild.enmFormat, cChChild, pbSrc, cFrames,
+                                       s_aVols[iVol].uConvLeft, s_aVols[iVol].uConvRight);
+                        tstRefConvTo(pbRef, CfgParent.enmFormat, cChParent, paRef, cFrames);
+
+                        for (uint32_t off = 0; off < cRead * cbParentFrame; off++)
+                            if (pbDst[off] != pbRef[off])
+                            {
+                                RTTestIFailed("fmt %d/%u ch -> fmt %d/%u ch, vol %u/%u: frame %u differs (%#x vs %#x, child frame size %u)\n",
+                                              CfgChild.enmFormat, cChChild, CfgParent.enmFormat, cChParent,
+                                              s_aVols[iVol].uLeft, s_aVols[iVol].uRight, off / cbParentFrame,
+                                              pbDst[off], pbRef[off], cbChildFrame);
+                                break;
+                            }
+
+                        AudioMixBufDestroy(&Child);
+                        AudioMixBufDestroy(&Parent);
+                    }
+
+    RTMemFree(pbSrc);
+    RTMemFree(pbDst);
+    RTMemFree(pbRef);
+    RTMemFree(paRef);
+
+    return RTTestSubErrorCount(hTest) ? VERR_GENERAL_FAILURE : VINF_SUCCESS;
+}
+
+
+static int tstMultiChannel(RTTEST hTest)
+{
+    RTTestSubF(hTest, "Multi-channel");
+
+    uint32_t const cFrames = 200;
+    int16_t        ai16Src[200 * 6];
+    int16_t        ai16Dst[400 * 6];
+    for (uint32_t i = 0; i < RT_ELEMENTS(ai16Src); i++)
+        ai16Src[i] = (int16_t)RTRandU32();
+
+    static struct { uint8_t cChChild, cChParent; uint32_t uHzChild; } const s_aTests[] =
+    {
+        { 6, 6, 44100 },    /* 5.1 pass-thru. */
+        { 6, 2, 44100 },    /* Surplus channels get dropped. */
+        { 2, 6, 44100 },    /* Missing channels are silent. */
+        { 1, 6, 44100 },    /* Mono gets broadcast. */
+        { 1, 2, 22050 },    /* Channel mapping combined with upsampling. */
+        { 6, 6, 22050 },
+    };
+    for (unsigned iTest = 0; iTest < RT_ELEMENTS(s_aTests); iTest++)
+    {
+        uint8_t const cChChild  = s_aTests[iTest].cChChild;
+        uint8_t const cChParent = s_aTests[iTest].cChParent;
+        PDMAUDIOSTREAMCFG CfgChild  = { "Child", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, s_aTests[iTest].uHzChild,
+                                        cChChild, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+        PDMAUDIOSTREAMCFG CfgParent = { "Parent", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, 44100,
+                                        cChParent, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+        PDMAUDIOPCMPROPS  Props;
+        PDMAUDIOMIXBUF    Parent, Child;
+        RTTESTI_CHECK_RC_OK_RET(DrvAudioHlpStreamCfgToProps(&CfgParent, &Props), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(AudioMixBufInit(&Parent, "Parent", &Props, cFrames * 2), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(DrvAudioHlpStreamCfgToProps(&CfgChild, &Props), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(AudioMixBufInit(&Child, "Child", &Props, cFrames), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(AudioMixBufLinkTo(&Child, &Parent), VERR_GENERAL_FAILURE);
+
+        uint32_t const cRead = tstPump(&Child, &Parent, (uint8_t const *)ai16Src, cFrames,
+                                       (uint8_t *)ai16Dst, cFrames * 2, 64);
+
+        /* With double the rate the even frames are the source frames. */
+        uint32_t const uStep     = 44100 / s_aTests[iTest].uHzChild;
+        uint32_t const cExpected = (cFrames - (uStep > 1 ? AUDIOMIXBUF_RESAMPLE_HALF_TAPS : 0)) * uStep;
+        RTTESTI_CHECK_MSG(cRead == cExpected, ("test #%u: got %u frames, expected %u\n", iTest, cRead, cExpected));
+        for (uint32_t iFrame = 0; iFrame < RT_MIN(cRead, cExpected); iFrame += uStep)
+            for (uint8_t iCh = 0; iCh < cChParent; iCh++)
+            {
+                uint32_t const iSrcFrame = iFrame / uStep;
+                int16_t        i16Src    = 0;
+                if (cChChild == 1)
+                    i16Src = ai16Src[iSrcFrame];
+                else if (iCh < cChChild)
+                    i16Src = ai16Src[iSrcFrame * cChChild + iCh];
+                int16_t const i16Dst = ai16Dst[iFrame * cChParent + iCh];
+                if (i16Src != i16Dst)
+                {
+                    RTTestIFailed("test #%u: frame %u channel %u: %d, expected %d\n", iTest, iFrame, iCh, i16Dst, i16Src);
+                    iFrame = cRead;
+                    break;
+                }
+            }
+
+        AudioMixBufDestroy(&Child);
+        AudioMixBufDestroy(&Parent);
+    }
+
+    /* Channel counts the conversion routines can't handle must be refused. */
+    PDMAUDIOSTREAMCFG Cfg = { "Nine", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, 44100,
+                              AUDIOMIXBUF_MAX_CHANNELS + 1, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+    PDMAUDIOPCMPROPS  Props;
+    PDMAUDIOMIXBUF    MixBuf;
+    RTTESTI_CHECK_RC_OK(DrvAudioHlpStreamCfgToProps(&Cfg, &Props));
+    RTTESTI_CHECK_RC(AudioMixBufInit(&MixBuf, "Nine", &Props, cFrames), VERR_NOT_SUPPORTED);
+
+    return RTTestSubErrorCount(hTest) ? VERR_GENERAL_FAILURE : VINF_SUCCESS;
+}
+
+
+/**
+ * Resamples a 1 kHz S16 mono sine with both the mixing buffer and the
+ * reference, returning the signal-to-noise ratios in dB.
+ */
+static void tstResampleSine(uint32_t uSrcHz, uint32_t uDstHz, double *prdSnr, double *prdSnrRef)
+{
+    uint32_t const cSrcFrames = uSrcHz / 4;
+    uint32_t const cDstFrames = (uint32_t)((uint64_t)cSrcFrames * uDstHz / uSrcHz) + 16;
+    uint32_t const cSkip      = 64; /* Skip the filter pre-roll. */
+    double const   rdAmp      = 16000.0;
+    double const   rdOmega    = 2.0 * 3.14159265358979323846 * 1000.0;
+
+    *prdSnr = *prdSnrRef = 0.0;
+
+    int16_t     *pai16Src = (int16_t *)RTMemAlloc(cSrcFrames * sizeof(int16_t));
+    int16_t     *pai16Dst = (int16_t *)RTMemAllocZ(cDstFrames * sizeof(int16_t));
+    int16_t     *pai16Ref = (int16_t *)RTMemAllocZ(cDstFrames * sizeof(int16_t));
+    TSTREFFRAME *paSrc    = (TSTREFFRAME *)RTMemAlloc(cSrcFrames * sizeof(TSTREFFRAME));
+    TSTREFFRAME *paDst    = (TSTREFFRAME *)RTMemAlloc(cDstFrames * sizeof(TSTREFFRAME));
+    RTTESTI_CHECK_RETV(pai16Src && pai16Dst && pai16Ref && paSrc && paDst);
+
+    for (uint32_t i = 0; i < cSrcFrames; i++)
+        pai16Src[i] = (int16_t)floor(rdAmp * sin(rdOmega * i / uSrcHz) + 0.5);
+
+    PDMAUDIOSTREAMCFG CfgChild  = { "Child", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, uSrcHz,
+                                    1, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+    PDMAUDIOSTREAMCFG CfgParent = { "Parent", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, uDstHz,
+                                    1, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+    PDMAUDIOPCMPROPS  Props;
+    PDMAUDIOMIXBUF    Parent, Child;
+    RTTESTI_CHECK_RC_OK_RETV(DrvAudioHlpStreamCfgToProps(&CfgParent, &Props));
+    RTTESTI_CHECK_RC_OK_RETV(AudioMixBufInit(&Parent, "Parent", &Props, _4K));
+    RTTESTI_CHECK_RC_OK_RETV(DrvAudioHlpStreamCfgToProps(&CfgChild, &Props));
+    RTTESTI_CHECK_RC_OK_RETV(AudioMixBufInit(&Child, "Child", &Props, _4K));
+    RTTESTI_CHECK_RC_OK_RETV(AudioMixBufLinkTo(&Child, &Parent));
+
+    /* Odd sized chunks so the filter state has to carry over between calls. */
+    uint32_t const cDst = tstPump(&Child, &Parent, (uint8_t const *)pai16Src, cSrcFrames,
+                                  (uint8_t *)pai16Dst, cDstFrames, 441);
+
+    TSTREFRATE Rate = { 0, ((uint64_t)uSrcHz << 32) / uDstHz, 0, { 0, 0 } };
+    tstRefConvFrom(paSrc, PDMAUDIOFMT_S16, 1, pai16Src, cSrcFrames, 65536, 65536);
+    uint32_t const cRef = tstRefResample(&Rate, paSrc, cSrcFrames, paDst, cDstFrames);
+    tstRefConvTo(pai16Ref, PDMAUDIOFMT_S16, 1, paDst, cRef);
+
+    double rdSignal = 0.0, rdNoise = 0.0, rdNoiseRef = 0.0;
+    uint32_t const cCompare = RT_MIN(cDst, cRef);
+    RTTESTI_CHECK(cCompare > cSkip * 4);
+    for (uint32_t i = cSkip; i < cCompare; i++)
+    {
+        double const rdIdeal = rdAmp * sin(rdOmega * i / uDstHz);
+        rdSignal   += rdIdeal * rdIdeal;
+        rdNoise    += (pai16Dst[i] - rdIdeal) * (pai16Dst[i] - rdIdeal);
+        rdNoiseRef += (pai16Ref[i] - rdIdeal) * (pai16Ref[i] - rdIdeal);
+    }
+    *prdSnr    = 10.0 * log10(rdSignal / RT_MAX(rdNoise, 1.0));
+    *prdSnrRef = 10.0 * log10(rdSignal / RT_MAX(rdNoiseRef, 1.0));
+
+    AudioMixBufDestroy(&Child);
+    AudioMixBufDestroy(&Parent);
+    RTMemFree(pai16Src);
+    RTMemFree(pai16Dst);
+    RTMemFree(pai16Ref);
+    RTMemFree(paSrc);
+    RTMemFree(paDst);
+}
+
+
+static int tstResampling(RTTEST hTest)
+{
+    RTTestSubF(hTest, "Resampling quality");
+
+    static struct { uint32_t uSrcHz, uDstHz; } const s_aRates[] =
+    {
+        { 22050, 44100 },
+        { 48000, 44100 },
+        { 44100, 48000 },
+        { 44100, 16000 },
+    };
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aRates); i++)
+    {
+        double rdSnr, rdSnrRef;
+        tstResampleSine(s_aRates[i].uSrcHz, s_aRates[i].uDstHz, &rdSnr, &rdSnrRef);
+        RTTestIValueF((int64_t)rdSnr, RTTESTUNIT_NONE, "%u -> %u Hz SNR (dB)", s_aRates[i].uSrcHz, s_aRates[i].uDstHz);
+        RTTestIValueF((int64_t)rdSnrRef, RTTESTUNIT_NONE, "%u -> %u Hz SNR, linear (dB)", s_aRates[i].uSrcHz, s_aRates[i].uDstHz);
+        /* S16 quantization alone limits this to about 90 dB. */
+        RTTESTI_CHECK_MSG(rdSnr >= 70.0 && rdSnr > rdSnrRef,
+                          ("%u -> %u Hz: SNR %d dB, linear %d dB\n", s_aRates[i].uSrcHz, s_aRates[i].uDstHz,
+                           (int)rdSnr, (int)rdSnrRef));
+    }
+
+    return RTTestSubErrorCount(hTest) ? VERR_GENERAL_FAILURE : VINF_SUCCESS;
+}
+
+
+/**
+ * Checks that AudioMixBufDrainToParent delivers the end of a resampled
+ * stream and that the next stream starts from scratch.
+ */
+static int tstDrain(RTTEST hTest)
+{
+    RTTestSubF(hTest, "Draining the resampler");
+
+    static struct { uint32_t uSrcHz, uDstHz; uint8_t cDstChannels; } const s_aRates[] =
+    {
+        { 22050, 44100, 1 },
+        { 48000, 44100, 1 },
+        { 44100, 48000, 2 },
+        {  8000, 48000, 2 },
+        { 44100, 16000, 1 },
+    };
+    uint32_t const cSrcFrames = 1000;
+    int16_t        ai16Src[1000];
+    static int16_t s_ai16Dst[2][8000 * 2];
+    for (uint32_t i = 0; i < cSrcFrames; i++)
+        ai16Src[i] = 10000;
+
+    for (unsigned iRate = 0; iRate < RT_ELEMENTS(s_aRates); iRate++)
+    {
+        uint32_t const    uSrcHz = s_aRates[iRate].uSrcHz;
+        uint32_t const    uDstHz = s_aRates[iRate].uDstHz;
+        uint8_t const     cDstCh = s_aRates[iRate].cDstChannels;
+        PDMAUDIOSTREAMCFG CfgChild  = { "Child", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, uSrcHz,
+                                        1, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+        PDMAUDIOSTREAMCFG CfgParent = { "Parent", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, uDstHz,
+                                        cDstCh, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+        PDMAUDIOPCMPROPS  Props;
+        PDMAUDIOMIXBUF    Parent, Child;
+        RTTESTI_CHECK_RC_OK_BREAK(DrvAudioHlpStreamCfgToProps(&CfgParent, &Props));
+        RTTESTI_CHECK_RC_OK_BREAK(AudioMixBufInit(&Parent, "Parent", &Props, _4K));
+        RTTESTI_CHECK_RC_OK_BREAK(DrvAudioHlpStreamCfgToProps(&CfgChild, &Props));
+        RTTESTI_CHECK_RC_OK_BREAK(AudioMixBufInit(&Child, "Child", &Props, _4K));
+        RTTESTI_CHECK_RC_OK_BREAK(AudioMixBufLinkTo(&Child, &Parent));
+
+        /* Output frame i is positioned at source frame i * uSrcHz / uDstHz, so every one before the end is due. */
+        uint64_t const uInc      = ((uint64_t)uSrcHz << 32) / uDstHz;
+        uint32_t const cExpected = (uint32_t)((((uint64_t)cSrcFrames << 32) + uInc - 1) / uInc);
+        uint32_t       acDst[2];
+        for (unsigned iStream = 0; iStream < 2; iStream++)
+        {
+            memset(s_ai16Dst[iStream], 0, sizeof(s_ai16Dst[iStream]));
+            acDst[iStream] = tstPump(&Child, &Parent, (uint8_t const *)ai16Src, cSrcFrames,
+                                     (uint8_t *)s_ai16Dst[iStream], RT_ELEMENTS(s_ai16Dst[iStream]) / cDstCh, 97);
+            RTTESTI_CHECK_MSG(acDst[iStream] < cExpected, ("%u -> %u Hz: nothing held back\n", uSrcHz, uDstHz));
+
+            uint32_t cDrained = 0, cRead = 0;
+            RTTESTI_CHECK_RC_OK(AudioMixBufDrainToParent(&Child, &cDrained));
+            RTTESTI_CHECK_RC_OK(AudioMixBufReadCirc(&Parent, &s_ai16Dst[iStream][acDst[iStream] * cDstCh],
+                                                    (uint32_t)sizeof(s_ai16Dst[iStream])
+                                                    - acDst[iStream] * cDstCh * (uint32_t)sizeof(int16_t), &cRead));
+            AudioMixBufFinish(&Parent, cRead);
+            RTTESTI_CHECK(cRead == cDrained);
+            acDst[iStream] += cRead;
+            RTTESTI_CHECK_MSG(acDst[iStream] == cExpected,
+                              ("%u -> %u Hz: got %u frames, expected %u\n", uSrcHz, uDstHz, acDst[iStream], cExpected));
+
+            /* Draining again finds nothing. */
+            RTTESTI_CHECK_RC_OK(AudioMixBufDrainToParent(&Child, &cDrained));
+            RTTESTI_CHECK(cDrained == 0);
+
+            /* The signal is intact up to the last frames, which see the silence after the end, and
+               the last source frame still comes out at full level. */
+            uint32_t const cTail = (uint32_t)(RT_MAX((uint64_t)uDstHz * 64 / uSrcHz, 64));
+            for (uint32_t i = 64; i + cTail < acDst[iStream]; i++)
+                RTTESTI_CHECK_MSG_BREAK(RT_ABS(s_ai16Dst[iStream][i * cDstCh] - 10000) <= 16,
+                                        ("%u -> %u Hz: frame %u is %d\n", uSrcHz, uDstHz, i, s_ai16Dst[iStream][i * cDstCh]));
+            uint32_t const iLast = (uint32_t)(((uint64_t)(cSrcFrames - 1) << 32) / uInc);
+            RTTESTI_CHECK_MSG(s_ai16Dst[iStream][iLast * cDstCh] > 8000,
+                              ("%u -> %u Hz: frame %u at the last source frame is %d\n",
+                               uSrcHz, uDstHz, iLast, s_ai16Dst[iStream][iLast * cDstCh]));
+        }
+
+        /* The second stream starts with an empty filter, like the first one. */
+        RTTESTI_CHECK(acDst[0] == acDst[1]);
+        RTTESTI_CHECK_MSG(!memcmp(s_ai16Dst[0], s_ai16Dst[1], acDst[0] * cDstCh * sizeof(int16_t)),
+                          ("%u -> %u Hz: second stream differs\n", uSrcHz, uDstHz));
+
+        AudioMixBufDestroy(&Child);
+        AudioMixBufDestroy(&Parent);
+    }
+
+    return RTTestSubErrorCount(hTest) ? VERR_GENERAL_FAILURE : VINF_SUCCESS;
+}
+
+
+static int tstBenchmark(RTTEST hTest)
+{
+    RTTestSubF(hTest, "Benchmark");
+
+    uint32_t const cChunk     = 1024;
+    uint32_t const cChunks    = 512;
+    uint32_t const cDstFrames = cChunk * 2;
+
+    int16_t     *pai16Src = (int16_t *)RTMemAlloc(cChunk * 2 * sizeof(int16_t));
+    int16_t     *pai16Dst = (int16_t *)RTMemAlloc(cDstFrames * 2 * sizeof(int16_t));
+    TSTREFFRAME *paSrc    = (TSTREFFRAME *)RTMemAlloc(cChunk * sizeof(TSTREFFRAME));
+    TSTREFFRAME *paDst    = (TSTREFFRAME *)RTMemAlloc(cDstFrames * sizeof(TSTREFFRAME));
+    RTTESTI_CHECK_RET(pai16Src && pai16Dst && paSrc && paDst, VERR_NO_MEMORY);
+    for (uint32_t i = 0; i < cChunk * 2; i++)
+        pai16Src[i] = (int16_t)RTRandU32();
+
+    static uint32_t const s_auSrcHz[] = { 44100, 48000 };
+    for (unsigned iRate = 0; iRate < RT_ELEMENTS(s_auSrcHz); iRate++)
+    {
+        uint32_t const uSrcHz = s_auSrcHz[iRate];
+
+        /* Stereo S16 with -6dB so the volume code is part of the measurement. */
+        PDMAUDIOSTREAMCFG CfgChild  = { "Child", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, uSrcHz,
+                                        2, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+        PDMAUDIOSTREAMCFG CfgParent = { "Parent", PDMAUDIODIR_OUT, { PDMAUDIOPLAYBACKDEST_UNKNOWN }, 44100,
+                                        2, PDMAUDIOFMT_S16, PDMAUDIOENDIANNESS_LITTLE };
+        PDMAUDIOPCMPROPS  Props;
+        PDMAUDIOMIXBUF    Parent, Child;
+        RTTESTI_CHECK_RC_OK_RET(DrvAudioHlpStreamCfgToProps(&CfgParent, &Props), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(AudioMixBufInit(&Parent, "Parent", &Props, cDstFrames), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(DrvAudioHlpStreamCfgToProps(&CfgChild, &Props), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(AudioMixBufInit(&Child, "Child", &Props, cChunk), VERR_GENERAL_FAILURE);
+        RTTESTI_CHECK_RC_OK_RET(AudioMixBufLinkTo(&Child, &Parent), VERR_GENERAL_FAILURE);
+        PDMAUDIOVOLUME Vol = { false, 239, 239 };
+        AudioMixBufSetVolume(&Child, &Vol);
+
+        uint64_t nsStart = RTTimeNanoTS();
+        for (uint32_t i = 0; i < cChunks; i++)
+            tstPump(&Child, &Parent, (uint8_t const *)pai16Src, cChunk, (uint8_t *)pai16Dst, cDstFrames, cChunk);
+        uint64_t const cNsMixBuf = RTTimeNanoTS() - nsStart;
+
+        TSTREFRATE Rate = { 0, ((uint64_t)uSrcHz << 32) / 44100, 0, { 0, 0 } };
+        nsStart = RTTimeNanoTS();
+        for (uint32_t i = 0; i < cChunks; i++)
+        {
+            tstRefConvFrom(paSrc, PDMAUDIOFMT_S16, 2, pai16Src, cChunk, 32768, 32768);
+            uint32_t cDst = cChunk;
+            if (uSrcHz == 44100)
+                memcpy(paDst, paSrc, cChunk * sizeof(TSTREFFRAME));
+            else
+                cDst = tstRefResample(&Rate, paSrc, cChunk, paDst, cDstFrames);
+            tstRefConvTo(pai16Dst, PDMAUDIOFMT_S16, 2, paDst, cDst);
+        }
+        uint64_t const cNsRef = RTTimeNanoTS() - nsStart;
+
+        uint64_t const cFrames = (uint64_t)cChunk * cChunks;
+        RTTestIValueF(cFrames * RT_NS_1SEC / RT_MAX(cNsMixBuf, 1), RTTESTUNIT_FRAMES_PER_SEC, "%u -> 44100 Hz", uSrcHz);
+        RTTestIValueF(cFrames * RT_NS_1SEC / RT_MAX(cNsRef, 1), RTTESTUNIT_FRAMES_PER_SEC, "%u -> 44100 Hz, reference", uSrcHz);
+
+        AudioMixBufDestroy(&Child);
+        AudioMixBufDestroy(&Parent);
+    }
+
+    RTMemFree(pai16Src);
+    RTMemFree(pai16Dst);
+    RTMemFree(paSrc);
+    RTMemFree(paDst);
+
+    return RTTestSubErrorCount(hTest) ? VERR_GENERAL_FAILURE : VINF_SUCCESS;
+}
+
+
 int main(int argc, char **argv)
 {
     RTR3InitExe(argc, &argv, 0);
@@ -606,6 +1206,16 @@ int main(int argc, char **argv)
         rc = tstConversion16(hTest);
     if (RT_SUCCESS(rc))
         rc = tstVolume(hTest);
+    if (RT_SUCCESS(rc))
+        rc = tstReference(hTest);
+    if (RT_SUCCESS(rc))
+        rc = tstMultiChannel(hTest);
+    if (RT_SUCCESS(rc))
+        rc = tstResampling(hTest);
+    if (RT_SUCCESS(rc))
+        rc = tstDrain(hTest);
+    if (RT_SUCCESS(rc))
+        rc = tstBenchmark(hTest);
 
     /*
      * Summary
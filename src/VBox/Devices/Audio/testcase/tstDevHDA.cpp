@@ -0,0 +1,489 @@
+/* $Id$ */
+/** @file
+ * HDA - Testcase for the DMA pacing, BDL caching and DMA transfer code.
+ *
+ * This includes the device code and fakes the few device helpers and VMM
+ * APIs the tested code paths use.
+ */
+
+/*
+ * Copyright (C) 2017 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "../DevHDA.cpp"
+
+#include <iprt/rand.h>
+#include <iprt/test.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** TMCLOCK_VIRTUAL, which the stream timers use, runs at 1 GHz. */
+#define TST_TIMER_HZ            UINT64_C(1000000000)
+/** Size of the fake guest memory, starting at guest physical address 0. */
+#define TST_GUEST_MEM_SIZE      _64K
+/** The output stream the tests use (the first SDO). */
+#define TST_SD                  HDA_MAX_SDI
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The fake guest memory. */
+static uint8_t      g_abGuestMem[TST_GUEST_MEM_SIZE];
+/** Whether guest pages can be mapped, otherwise the device has to fall back to
+ *  PDMDevHlpPhysRead / PDMDevHlpPhysWrite. */
+static bool         g_fMapPages;
+/** Number of PDMDevHlpPhysRead calls. */
+static uint32_t     g_cPhysReads;
+/** Number of bytes read by PDMDevHlpPhysRead. */
+static size_t       g_cbPhysRead;
+/** The fake device helpers. */
+static PDMDEVHLPR3  g_DevHlp;
+/** The fake device instance. */
+static PDMDEVINS    g_DevIns;
+
+
+/*
+ * The VMM APIs referenced by the device.  Only the timer ones get called by
+ * the code under test.
+ */
+VMMDECL(uint64_t) TMTimerGet(PTMTIMER pTimer)                      { RT_NOREF(pTimer); return 0; }
+VMMDECL(uint64_t) TMTimerGetFreq(PTMTIMER pTimer)                  { RT_NOREF(pTimer); return TST_TIMER_HZ; }
+VMMDECL(int) TMTimerSet(PTMTIMER pTimer, uint64_t u64Expire)       { RT_NOREF(pTimer, u64Expire); return VINF_SUCCESS; }
+VMMDECL(int) TMTimerStop(PTMTIMER pTimer)                          { RT_NOREF(pTimer); return VINF_SUCCESS; }
+
+VMMR3DECL(bool) CFGMR3AreValuesValid(PCFGMNODE pNode, const char *pszzValid)      { RT_NOREF(pNode, pszzValid); return true; }
+VMMR3DECL(PCFGMNODE) CFGMR3GetChild(PCFGMNODE pNode, const char *pszPath)         { RT_NOREF(pNode, pszPath); return NULL; }
+VMMR3DECL(PCFGMNODE) CFGMR3GetChildF(PCFGMNODE pNode, const char *pszPathFormat, ...) { RT_NOREF(pNode, pszPathFormat); return NULL; }
+VMMR3DECL(PCFGMNODE) CFGMR3GetRoot(PVM pVM)                                       { RT_NOREF(pVM); return NULL; }
+VMMR3DECL(int) CFGMR3InsertNode(PCFGMNODE pNode, const char *pszName, PCFGMNODE *ppChild)
+{ RT_NOREF(pNode, pszName, ppChild); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) CFGMR3InsertNodeF(PCFGMNODE pNode, PCFGMNODE *ppChild, const char *pszNameFormat, ...)
+{ RT_NOREF(pNode, ppChild, pszNameFormat); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) CFGMR3InsertString(PCFGMNODE pNode, const char *pszName, const char *pszString)
+{ RT_NOREF(pNode, pszName, pszString); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) CFGMR3QueryBoolDef(PCFGMNODE pNode, const char *pszName, bool *pf, bool fDef)
+{ RT_NOREF(pNode, pszName); *pf = fDef; return VINF_SUCCESS; }
+VMMR3DECL(int) CFGMR3QueryU16Def(PCFGMNODE pNode, const char *pszName, uint16_t *pu16, uint16_t u16Def)
+{ RT_NOREF(pNode, pszName); *pu16 = u16Def; return VINF_SUCCESS; }
+VMMR3DECL(void) CFGMR3RemoveNode(PCFGMNODE pNode)                                 { RT_NOREF(pNode); }
+
+VMMR3DECL(int) SSMR3GetBool(PSSMHANDLE pSSM, bool *pfBool)                        { RT_NOREF(pSSM, pfBool); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3GetU8(PSSMHANDLE pSSM, uint8_t *pu8)                          { RT_NOREF(pSSM, pu8); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3GetU16(PSSMHANDLE pSSM, uint16_t *pu16)                       { RT_NOREF(pSSM, pu16); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3GetU32(PSSMHANDLE pSSM, uint32_t *pu32)                       { RT_NOREF(pSSM, pu32); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3GetU64(PSSMHANDLE pSSM, uint64_t *pu64)                       { RT_NOREF(pSSM, pu64); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3GetMem(PSSMHANDLE pSSM, void *pv, size_t cb)                  { RT_NOREF(pSSM, pv, cb); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3GetStructEx(PSSMHANDLE pSSM, void *pvStruct, size_t cbStruct, uint32_t fFlags, PCSSMFIELD paFields, void *pvUser)
+{ RT_NOREF(pSSM, pvStruct, cbStruct, fFlags, paFields, pvUser); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3PutU8(PSSMHANDLE pSSM, uint8_t u8)                            { RT_NOREF(pSSM, u8); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3PutU32(PSSMHANDLE pSSM, uint32_t u32)                         { RT_NOREF(pSSM, u32); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3PutMem(PSSMHANDLE pSSM, const void *pv, size_t cb)            { RT_NOREF(pSSM, pv, cb); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3PutStructEx(PSSMHANDLE pSSM, const void *pvStruct, size_t cbStruct, uint32_t fFlags, PCSSMFIELD paFields, void *pvUser)
+{ RT_NOREF(pSSM, pvStruct, cbStruct, fFlags, paFields, pvUser); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(int) SSMR3Skip(PSSMHANDLE pSSM, size_t cb)                              { RT_NOREF(pSSM, cb); return VERR_NOT_IMPLEMENTED; }
+VMMR3DECL(uint32_t) SSMR3HandleRevision(PSSMHANDLE pSSM)                          { RT_NOREF(pSSM); return 0; }
+VMMR3DECL(uint32_t) SSMR3HandleVersion(PSSMHANDLE pSSM)                           { RT_NOREF(pSSM); return 0; }
+
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnPhysRead} */
+static DECLCALLBACK(int) tstDevHlpPhysRead(PPDMDEVINS pDevIns, RTGCPHYS GCPhys, void *pvBuf, size_t cbRead)
+{
+    RT_NOREF(pDevIns);
+    g_cPhysReads++;
+    if (   GCPhys >= TST_GUEST_MEM_SIZE
+        || cbRead > TST_GUEST_MEM_SIZE - GCPhys)
+        return VERR_PGM_INVALID_GC_PHYSICAL_ADDRESS;
+    memcpy(pvBuf, &g_abGuestMem[GCPhys], cbRead);
+    g_cbPhysRead += cbRead;
+    return VINF_SUCCESS;
+}
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnPhysWrite} */
+static DECLCALLBACK(int) tstDevHlpPhysWrite(PPDMDEVINS pDevIns, RTGCPHYS GCPhys, const void *pvBuf, size_t cbWrite)
+{
+    RT_NOREF(pDevIns);
+    if (   GCPhys >= TST_GUEST_MEM_SIZE
+        || cbWrite > TST_GUEST_MEM_SIZE - GCPhys)
+        return VERR_PGM_INVALID_GC_PHYSICAL_ADDRESS;
+    memcpy(&g_abGuestMem[GCPhys], pvBuf, cbWrite);
+    return VINF_SUCCESS;
+}
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnPhysGCPhys2CCPtr} */
+static DECLCALLBACK(int) tstDevHlpPhysGCPhys2CCPtr(PPDMDEVINS pDevIns, RTGCPHYS GCPhys, uint32_t fFlags, void **ppv,
+                                                   PPGMPAGEMAPLOCK pLock)
+{
+    RT_NOREF(pDevIns, fFlags, pLock);
+    if (   !g_fMapPages
+        || GCPhys >= TST_GUEST_MEM_SIZE)
+        return VERR_PGM_PHYS_PAGE_RESERVED;
+    *ppv = &g_abGuestMem[GCPhys];
+    return VINF_SUCCESS;
+}
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnPhysGCPhys2CCPtrReadOnly} */
+static DECLCALLBACK(int) tstDevHlpPhysGCPhys2CCPtrReadOnly(PPDMDEVINS pDevIns, RTGCPHYS GCPhys, uint32_t fFlags, void const **ppv,
+                                                           PPGMPAGEMAPLOCK pLock)
+{
+    return tstDevHlpPhysGCPhys2CCPtr(pDevIns, GCPhys, fFlags, (void **)ppv, pLock);
+}
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnPhysReleasePageMappingLock} */
+static DECLCALLBACK(void) tstDevHlpPhysReleasePageMappingLock(PPDMDEVINS pDevIns, PPGMPAGEMAPLOCK pLock)
+{
+    RT_NOREF(pDevIns, pLock);
+}
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnPCIPhysWrite} */
+static DECLCALLBACK(int) tstDevHlpPCIPhysWrite(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, RTGCPHYS GCPhys, const void *pvBuf,
+                                               size_t cbWrite)
+{
+    RT_NOREF(pPciDev);
+    return tstDevHlpPhysWrite(pDevIns, GCPhys, pvBuf, cbWrite);
+}
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnPCISetIrq} */
+static DECLCALLBACK(void) tstDevHlpPCISetIrq(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, int iIrq, int iLevel)
+{
+    RT_NOREF(pDevIns, pPciDev, iIrq, iLevel);
+}
+
+
+/**
+ * Creates a zeroed HDA state hooked up to the fake device instance.
+ */
+static PHDASTATE tstCreateState(void)
+{
+    PHDASTATE pThis = (PHDASTATE)RTMemAllocZ(sizeof(HDASTATE));
+    if (pThis)
+    {
+        pThis->pDevInsR3 = &g_DevIns;
+        for (uint8_t i = 0; i < HDA_MAX_STREAMS; i++)
+            pThis->aStreams[i].u8SD = i;
+    }
+    return pThis;
+}
+
+/**
+ * Frees a state created by tstCreateState.
+ */
+static void tstDestroyState(PHDASTATE pThis)
+{
+    for (uint8_t i = 0; i < HDA_MAX_STREAMS; i++)
+        RTMemFree(pThis->aStreams[i].State.paBDLCache);
+    RTMemFree(pThis);
+}
+
+/**
+ * Stores a BDL entry in the fake guest memory.
+ */
+static void tstSetBDLE(uint64_t GCPhysBDL, uint16_t iEntry, uint64_t GCPhysBuf, uint32_t cbBuf, uint32_t fFlags)
+{
+    HDABDLEDESC Desc;
+    RT_ZERO(Desc);
+    Desc.u64BufAdr  = GCPhysBuf;
+    Desc.u32BufSize = cbBuf;
+    Desc.fFlags     = fFlags;
+    memcpy(&g_abGuestMem[GCPhysBDL + iEntry * sizeof(Desc)], &Desc, sizeof(Desc));
+}
+
+
+/**
+ * Checks the conversions between timer ticks and stream bytes and that the
+ * stream position doesn't drift when the timer paces a stream with them.
+ */
+static void tstPacing(void)
+{
+    RTTestISub("Pacing");
+
+    static struct { uint32_t uHz; uint8_t cbFrame; } const s_aFmts[] =
+    {
+        {  44100,  4 },
+        {  48000,  4 },
+        {  48000, 12 },     /* 5.1 */
+        {  22050,  2 },
+        {   8000,  1 },
+        { 192000,  8 },
+    };
+
+    static HDASTREAM s_Stream;
+    for (unsigned iFmt = 0; iFmt < RT_ELEMENTS(s_aFmts); iFmt++)
+    {
+        RT_ZERO(s_Stream);
+        PHDASTREAMSTATE pState = &s_Stream.State;
+        pState->cbFrame  = s_aFmts[iFmt].cbFrame;
+        pState->cbPerSec = s_aFmts[iFmt].uHz * pState->cbFrame;
+
+        /* A second is a second, and a whole number of frames. */
+        RTTESTI_CHECK(hdaStreamTicksToBytes(&s_Stream, TST_TIMER_HZ) == pState->cbPerSec);
+        RTTESTI_CHECK(hdaStreamBytesToTicks(&s_Stream, pState->cbPerSec) == TST_TIMER_HZ);
+        RTTESTI_CHECK(hdaStreamTicksToBytes(&s_Stream, 0) == 0);
+
+        /* Never more than the time span covers, never a partial frame and never a frame short. */
+        uint64_t const cTicksFrame = hdaStreamBytesToTicks(&s_Stream, pState->cbFrame);
+        for (unsigned i = 0; i < 10000; i++)
+        {
+            uint64_t const cTicks = RTRandU64Ex(0, TST_TIMER_HZ / 10);
+            uint32_t const cb     = hdaStreamTicksToBytes(&s_Stream, cTicks);
+            RTTESTI_CHECK_MSG_BREAK(cb % pState->cbFrame == 0, ("%u Hz: %RU64 ticks -> %RU32 bytes\n", s_aFmts[iFmt].uHz, cTicks, cb));
+            uint64_t const cTicksBack = hdaStreamBytesToTicks(&s_Stream, cb);
+            RTTESTI_CHECK_MSG_BREAK(cTicksBack <= cTicks && cTicks - cTicksBack <= cTicksFrame + 1,
+                                    ("%u Hz: %RU64 ticks -> %RU32 bytes -> %RU64 ticks\n",
+                                     s_aFmts[iFmt].uHz, cTicks, cb, cTicksBack));
+        }
+
+        /*
+         * Run the stream for a minute like hdaStreamTimerMain does, with the timer firing at
+         * random intervals and the DMA taking only part of what is due now and then (when
+         * stopping for an IOC).  In the end the stream must be where the clock says.
+         */
+        uint64_t const cSecs      = 60;
+        uint64_t       tsNow      = 0;
+        uint64_t       cbTotal    = 0;
+        pState->tsTransfer = 0;
+        while (tsNow < cSecs * TST_TIMER_HZ)
+        {
+            uint64_t const cTicksElapsed = RTRandU64Ex(TST_TIMER_HZ / 1000, TST_TIMER_HZ / 50);
+            tsNow = RT_MIN(tsNow + cTicksElapsed, cSecs * TST_TIMER_HZ);
+            uint32_t cbToProcess = pState->tsTransfer < tsNow ? hdaStreamTicksToBytes(&s_Stream, tsNow - pState->tsTransfer) : 0;
+            if (RTRandU32Ex(0, 3) == 0)
+                cbToProcess = (cbToProcess / 2) - (cbToProcess / 2) % pState->cbFrame;
+            pState->tsTransfer += hdaStreamBytesToTicks(&s_Stream, cbToProcess);
+            cbTotal            += cbToProcess;
+        }
+        cbTotal += hdaStreamTicksToBytes(&s_Stream, tsNow - pState->tsTransfer);
+
+        uint64_t const cbExpected = cSecs * pState->cbPerSec;
+        RTTESTI_CHECK_MSG(cbTotal <= cbExpected && cbExpected - cbTotal < pState->cbFrame,
+                          ("%u Hz, %u bytes/frame: %RU64 bytes after %RU64 s, expected %RU64\n",
+                           s_aFmts[iFmt].uHz, pState->cbFrame, cbTotal, cSecs, cbExpected));
+    }
+}
+
+
+/**
+ * Checks that the BDL gets cached with a single read and that the cache is
+ * dropped when the guest changes the BDL base or the last valid index.
+ */
+static void tstBDLCache(void)
+{
+    RTTestISub("BDL cache");
+
+    PHDASTATE pThis = tstCreateState();
+    RTTESTI_CHECK_RETV(pThis);
+    PHDASTREAM pStream = &pThis->aStreams[TST_SD];
+
+    RT_ZERO(g_abGuestMem);
+    uint64_t const GCPhysBDL1 = 0x1000;
+    uint64_t const GCPhysBDL2 = 0x2000;
+    for (uint16_t i = 0; i < 4; i++)
+    {
+        tstSetBDLE(GCPhysBDL1, i, 0x8000 + i * 0x100, 0x100, i & 1 ? HDA_BDLE_FLAG_IOC : 0);
+        tstSetBDLE(GCPhysBDL2, i, 0xC000 + i * 0x80,  0x80,  0);
+    }
+
+    hdaRegWriteSDBDPL(pThis, HDA_REG_SD4BDPL, (uint32_t)GCPhysBDL1);
+    hdaRegWriteSDLVI(pThis, HDA_REG_SD4LVI, 3);
+    RTTESTI_CHECK(pStream->u64BDLBase == GCPhysBDL1);
+    RTTESTI_CHECK(pStream->u16LVI == 3);
+
+    /* The first fetch reads entries 0 thru LVI in one go, the following ones are served from the cache. */
+    g_cPhysReads = 0;
+    g_cbPhysRead = 0;
+    for (uint16_t i = 0; i < 4; i++)
+    {
+        RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, i), VINF_SUCCESS);
+        RTTESTI_CHECK(pStream->State.BDLE.Desc.u64BufAdr == 0x8000 + i * 0x100u);
+        RTTESTI_CHECK(pStream->State.BDLE.Desc.u32BufSize == 0x100);
+        RTTESTI_CHECK(pStream->State.BDLE.Desc.fFlags == (i & 1 ? HDA_BDLE_FLAG_IOC : 0u));
+        RTTESTI_CHECK(pStream->State.BDLE.State.u32BDLIndex == i);
+        RTTESTI_CHECK(pStream->State.BDLE.State.u32BufOff == 0);
+    }
+    RTTESTI_CHECK_MSG(g_cPhysReads == 1, ("%u reads\n", g_cPhysReads));
+    RTTESTI_CHECK_MSG(g_cbPhysRead == 4 * sizeof(HDABDLEDESC), ("%zu bytes read\n", g_cbPhysRead));
+
+    /* Changes in guest memory alone are not noticed. */
+    tstSetBDLE(GCPhysBDL1, 2, 0x9000, 0x40, HDA_BDLE_FLAG_IOC);
+    RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, 2), VINF_SUCCESS);
+    RTTESTI_CHECK(pStream->State.BDLE.Desc.u64BufAdr == 0x8200);
+    RTTESTI_CHECK(g_cPhysReads == 1);
+
+    /* Writing the same LVI again keeps the cache. */
+    hdaRegWriteSDLVI(pThis, HDA_REG_SD4LVI, 3);
+    RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, 2), VINF_SUCCESS);
+    RTTESTI_CHECK(g_cPhysReads == 1);
+
+    /* A new LVI drops it, and only the entries up to the new LVI get read. */
+    hdaRegWriteSDLVI(pThis, HDA_REG_SD4LVI, 2);
+    RTTESTI_CHECK(pStream->State.uCurBDLE == 0);
+    g_cbPhysRead = 0;
+    RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, 2), VINF_SUCCESS);
+    RTTESTI_CHECK(pStream->State.BDLE.Desc.u64BufAdr == 0x9000);
+    RTTESTI_CHECK(pStream->State.BDLE.Desc.u32BufSize == 0x40);
+    RTTESTI_CHECK(g_cPhysReads == 2);
+    RTTESTI_CHECK(g_cbPhysRead == 3 * sizeof(HDABDLEDESC));
+
+    /* Entries beyond the LVI are read directly. */
+    RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, 3), VINF_SUCCESS);
+    RTTESTI_CHECK(pStream->State.BDLE.Desc.u64BufAdr == 0x8300);
+    RTTESTI_CHECK(g_cPhysReads == 3);
+
+    /* A new BDL base drops it too. */
+    hdaRegWriteSDBDPL(pThis, HDA_REG_SD4BDPL, (uint32_t)GCPhysBDL2);
+    RTTESTI_CHECK(pStream->u64BDLBase == GCPhysBDL2);
+    for (uint16_t i = 0; i < 3; i++)
+    {
+        RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, i), VINF_SUCCESS);
+        RTTESTI_CHECK(pStream->State.BDLE.Desc.u64BufAdr == 0xC000 + i * 0x80u);
+        RTTESTI_CHECK(pStream->State.BDLE.Desc.u32BufSize == 0x80);
+    }
+    RTTESTI_CHECK(g_cPhysReads == 4);
+
+    /* As does starting the stream (which is what SDCTL.RUN does before fetching). */
+    tstSetBDLE(GCPhysBDL2, 1, 0xD000, 0x20, 0);
+    hdaStreamInvalidateBDLCache(pStream);
+    RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, 1), VINF_SUCCESS);
+    RTTESTI_CHECK(pStream->State.BDLE.Desc.u64BufAdr == 0xD000);
+    RTTESTI_CHECK(g_cPhysReads == 5);
+
+    /* A BDL which can't be read as a whole is fetched entry by entry. */
+    hdaRegWriteSDLVI(pThis, HDA_REG_SD4LVI, 15);
+    hdaRegWriteSDBDPL(pThis, HDA_REG_SD4BDPL, TST_GUEST_MEM_SIZE - 0x80);
+    RTTESTI_CHECK(pStream->u64BDLBase == TST_GUEST_MEM_SIZE - 0x80);
+    tstSetBDLE(pStream->u64BDLBase, 1, 0xE000, 0x10, 0);
+    RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, 1), VINF_SUCCESS);
+    RTTESTI_CHECK(pStream->State.BDLE.Desc.u64BufAdr == 0xE000);
+    RTTESTI_CHECK(pStream->State.cBDLCache == 0);
+
+    tstDestroyState(pThis);
+}
+
+
+/**
+ * Checks that hdaStreamDoDMA stops after a BDLE with the IOC bit set and when
+ * guest memory can't be accessed, telling the caller so.
+ */
+static void tstDoDMA(void)
+{
+    RTTestISub("DMA transfers");
+
+    for (unsigned iMap = 0; iMap < 2; iMap++)
+    {
+        g_fMapPages = iMap == 1;
+
+        PHDASTATE pThis = tstCreateState();
+        RTTESTI_CHECK_RETV(pThis);
+        PHDASTREAM pStream = &pThis->aStreams[TST_SD];
+
+        /* Two BDLEs of 256 bytes each, the first one with IOC. */
+        RT_ZERO(g_abGuestMem);
+        uint64_t const GCPhysBDL = 0x1000;
+        tstSetBDLE(GCPhysBDL, 0, 0x2000, 256, HDA_BDLE_FLAG_IOC);
+        tstSetBDLE(GCPhysBDL, 1, 0x3000, 256, 0);
+        for (unsigned i = 0; i < 256; i++)
+        {
+            g_abGuestMem[0x2000 + i] = (uint8_t)i;
+            g_abGuestMem[0x3000 + i] = (uint8_t)~i;
+        }
+
+        hdaRegWriteSDBDPL(pThis, HDA_REG_SD4BDPL, (uint32_t)GCPhysBDL);
+        hdaRegWriteSDLVI(pThis, HDA_REG_SD4LVI, 1);
+        pStream->u32CBL = 512;
+        HDA_STREAM_REG(pThis, CBL, TST_SD) = 512;
+        RTTESTI_CHECK_RC(hdaStreamFetchBDLE(pThis, pStream, 0), VINF_SUCCESS);
+        HDA_STREAM_REG(pThis, CTL, TST_SD) |= HDA_REG_FIELD_FLAG_MASK(SDCTL, RUN);
+
+        HDADMAMAP Map;
+        Map.GCPhysPage = NIL_RTGCPHYS;
+        Map.pvPage     = NULL;
+        Map.fWritable  = false;
+
+        /* The transfer stops after the first BDLE and flags the interrupt. */
+        uint8_t  abBuf[512];
+        uint32_t cbProcessed = UINT32_MAX;
+        bool     fStop       = false;
+        RT_ZERO(abBuf);
+        RTTESTI_CHECK_RC(hdaStreamDoDMA(pThis, pStream, &Map, abBuf, sizeof(abBuf), sizeof(abBuf), &cbProcessed, &fStop),
+                         VINF_SUCCESS);
+        RTTESTI_CHECK_MSG(cbProcessed == 256, ("cbProcessed=%RU32\n", cbProcessed));
+        RTTESTI_CHECK(fStop);
+        RTTESTI_CHECK(!memcmp(abBuf, &g_abGuestMem[0x2000], 256));
+        RTTESTI_CHECK(ASMMemIsZero(&abBuf[256], 256));
+        RTTESTI_CHECK(HDA_STREAM_REG(pThis, STS, TST_SD) & HDA_REG_FIELD_FLAG_MASK(SDSTS, BCIS));
+        RTTESTI_CHECK(HDA_STREAM_REG(pThis, LPIB, TST_SD) == 256);
+        RTTESTI_CHECK(pStream->State.uCurBDLE == 1);
+
+        /* Nothing more until the guest acknowledged the interrupt. */
+        RTTESTI_CHECK_RC(hdaStreamDoDMA(pThis, pStream, &Map, abBuf, sizeof(abBuf), sizeof(abBuf), &cbProcessed, &fStop),
+                         VINF_SUCCESS);
+        RTTESTI_CHECK(cbProcessed == 0);
+        RTTESTI_CHECK(HDA_STREAM_REG(pThis, LPIB, TST_SD) == 256);
+
+        /* Then the second BDLE, which has no IOC, and the wrap around. */
+        HDA_STREAM_REG(pThis, STS, TST_SD) &= ~HDA_REG_FIELD_FLAG_MASK(SDSTS, BCIS);
+        RTTESTI_CHECK_RC(hdaStreamDoDMA(pThis, pStream, &Map, abBuf, 256, 256, &cbProcessed, &fStop), VINF_SUCCESS);
+        RTTESTI_CHECK(cbProcessed == 256);
+        RTTESTI_CHECK(!fStop);
+        RTTESTI_CHECK(!memcmp(abBuf, &g_abGuestMem[0x3000], 256));
+        RTTESTI_CHECK(HDA_STREAM_REG(pThis, LPIB, TST_SD) == 0);
+        RTTESTI_CHECK(pStream->State.uCurBDLE == 0);
+
+        /* A buffer outside guest memory fails the transfer without accounting anything. */
+        pStream->State.BDLE.Desc.u64BufAdr = TST_GUEST_MEM_SIZE + 0x1000;
+        RTTestDisableAssertions(NIL_RTTEST);
+        int rc = hdaStreamDoDMA(pThis, pStream, &Map, abBuf, sizeof(abBuf), sizeof(abBuf), &cbProcessed, &fStop);
+        RTTestRestoreAssertions(NIL_RTTEST);
+        RTTESTI_CHECK_RC(rc, VERR_PGM_INVALID_GC_PHYSICAL_ADDRESS);
+        RTTESTI_CHECK(cbProcessed == 0);
+        RTTESTI_CHECK(fStop);
+        RTTESTI_CHECK(HDA_STREAM_REG(pThis, LPIB, TST_SD) == 0);
+        RTTESTI_CHECK(pStream->State.BDLE.State.u32BufOff == 0);
+        RTTESTI_CHECK(!(HDA_STREAM_REG(pThis, STS, TST_SD) & HDA_REG_FIELD_FLAG_MASK(SDSTS, BCIS)));
+
+        hdaDMAMapRelease(pThis, &Map);
+        tstDestroyState(pThis);
+    }
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstDevHDA", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    g_DevHlp.u32Version                     = PDM_DEVHLPR3_VERSION;
+    g_DevHlp.pfnPhysRead                    = tstDevHlpPhysRead;
+    g_DevHlp.pfnPhysWrite                   = tstDevHlpPhysWrite;
+    g_DevHlp.pfnPhysGCPhys2CCPtr            = tstDevHlpPhysGCPhys2CCPtr;
+    g_DevHlp.pfnPhysGCPhys2CCPtrReadOnly    = tstDevHlpPhysGCPhys2CCPtrReadOnly;
+    g_DevHlp.pfnPhysReleasePageMappingLock  = tstDevHlpPhysReleasePageMappingLock;
+    g_DevHlp.pfnPCIPhysWrite                = tstDevHlpPCIPhysWrite;
+    g_DevHlp.pfnPCISetIrq                   = tstDevHlpPCISetIrq;
+    g_DevHlp.u32TheEnd                      = PDM_DEVHLPR3_VERSION;
+    g_DevIns.pHlpR3                         = &g_DevHlp;
+
+    tstPacing();
+    tstBDLCache();
+    tstDoDMA();
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
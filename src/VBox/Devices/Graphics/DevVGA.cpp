@@ -58,6 +58,14 @@
  */
 #define VGA_MAPPING_SIZE    _512K
 
+/** Number of consecutive display updates without changes after which the
+ * refresh timer interval gets stretched. */
+#define VGA_REFRESH_IDLE_THRESHOLD      16
+/** Factor the refresh timer interval gets stretched by while idle. */
+#define VGA_REFRESH_IDLE_FACTOR         4
+/** Upper limit (in milliseconds) for the stretched refresh timer interval. */
+#define VGA_REFRESH_IDLE_MAX_MS         100
+
 #ifdef VBOX_WITH_HGSMI
 #define PCIDEV_2_VGASTATE(pPciDev)    ((PVGASTATE)((uintptr_t)pPciDev - RT_OFFSETOF(VGASTATE, Dev)))
 #endif /* VBOX_WITH_HGSMI */
@@ -129,6 +137,7 @@
 
 /* should go BEFORE any other DevVGA include to make all DevVGA.h config defines be visible */
 #include "DevVGA.h"
+#include "DevVGAUpdateRects.h"
 
 #if defined(VBE_NEW_DYN_LIST) && defined(IN_RING3) && !defined(VBOX_DEVICE_STRUCT_TESTCASE)
 # include "DevVGAModes.h"
@@ -348,6 +357,42 @@ DECLINLINE(void) vga_reset_dirty(PVGASTATE pThis, RTGCPHYS offVRAMStart, RTGCPHY
     Assert(offVRAMStart < offVRAMEnd);
     ASMBitClearRange(&pThis->au32DirtyBitmap[0], offVRAMStart >> PAGE_SHIFT, offVRAMEnd >> PAGE_SHIFT);
 }
+
+/**
+ * Tests if any VRAM page in a given range is dirty.
+ *
+ * Scans the dirty bitmap a word at a time rather than testing page by page.
+ *
+ * @returns true if dirty.
+ * @returns false if clean.
+ * @param   pThis           VGA instance data.
+ * @param   offVRAMStart    Offset into the VRAM buffer of the first page.
+ * @param   offVRAMEnd      Offset into the VRAM buffer of the last page - exclusive.
+ */
+DECLINLINE(bool) vga_is_range_dirty(PVGASTATE pThis, RTGCPHYS offVRAMStart, RTGCPHYS offVRAMEnd)
+{
+    Assert(offVRAMEnd <= pThis->vram_size);
+    if (offVRAMStart >= offVRAMEnd)
+        return false;
+
+    /* The VRAM size is a multiple of 256KB, so the aligned bit count never exceeds the bitmap. */
+    return vgaIsPageRangeDirty(&pThis->au32DirtyBitmap[0], (uint32_t)(offVRAMStart >> PAGE_SHIFT),
+                               (uint32_t)((offVRAMEnd + PAGE_OFFSET_MASK) >> PAGE_SHIFT));
+}
+
+/**
+ * Tests if any of the given scanlines has been invalidated explicitly.
+ *
+ * @returns true if so, false if not.
+ * @param   pThis           VGA instance data.
+ * @param   cLines          Number of scanlines to check.
+ */
+DECLINLINE(bool) vga_is_any_line_invalidated(PVGASTATE pThis, uint32_t cLines)
+{
+    uint32_t const cBits = RT_MIN(RT_ALIGN_32(cLines, 32), RT_ELEMENTS(pThis->invalidated_y_table) * 32);
+    return cBits
+        && ASMBitFirstSet(&pThis->invalidated_y_table[0], cBits) >= 0;
+}
 #endif /* IN_RING3 */
 
 #ifdef _MSC_VER
@@ -2172,6 +2217,22 @@ static int vga_resize_graphic(PVGASTATE pThis, int cx, int cy,
     return VINF_SUCCESS;
 }
 
+/**
+ * Passes the remaining rectangles of a display update on to the display
+ * connector and accounts for all of them.
+ *
+ * @param   pThis   Pointer to the vga state.
+ * @param   pRects  The collected rectangles.
+ */
+static void vgaUpdateRectsDone(PVGASTATE pThis, PVGAUPDATERECTS pRects)
+{
+    vgaUpdateRectsFlush(pRects);
+
+    STAM_COUNTER_ADD(&pThis->StatUpdateRectsFlush, pRects->cFlushes);
+    STAM_COUNTER_ADD(&pThis->StatUpdateRects, pRects->cReported);
+    pThis->cRefreshRects += pRects->cReported;
+}
+
 # ifdef VBOX_WITH_VMSVGA
 
 int vgaR3UpdateDisplay(VGAState *s, unsigned xStart, unsigned yStart, unsigned cx, unsigned cy)
@@ -2301,6 +2362,19 @@ static int vmsvga_draw_graphic(PVGASTATE pThis, bool fFullUpdate, bool fFailOnRe
     uint32_t    cbDstScanline  = pDrv->cbScanline;
     uint32_t    offSrcStart    = 0;  /* always start at the beginning of the framebuffer */
     uint32_t    cbScanline     = (cx * cBits + 7) / 8;   /* The visible width of a scanline. */
+
+    /* Nothing to do if no page of the framebuffer has been written to since the last update. */
+    if (   !fFullUpdate
+        && !vga_is_range_dirty(pThis, offSrcStart, RT_MIN((uint64_t)offSrcStart + (uint64_t)cy * cbScanline, pThis->vram_size))
+        && !vga_is_any_line_invalidated(pThis, cy))
+    {
+        STAM_COUNTER_INC(&pThis->StatUpdateDispClean);
+        return VINF_SUCCESS;
+    }
+
+    VGAUPDATERECTS Rects;
+    vgaUpdateRectsInit(&Rects, pDrv);
+
     uint32_t    yUpdateRectTop = UINT32_MAX;
     uint32_t    offPageMin     = UINT32_MAX;
     int32_t     offPageMax     = -1;
@@ -2332,8 +2406,7 @@ static int vmsvga_draw_graphic(PVGASTATE pThis, bool fFullUpdate, bool fFailOnRe
         else if (yUpdateRectTop != UINT32_MAX)
         {
             /* flush to display */
-            Log(("Flush to display (%d,%d)(%d,%d)\n", 0, yUpdateRectTop, cxDisplay, y - yUpdateRectTop));
-            pDrv->pfnUpdateRect(pDrv, 0, yUpdateRectTop, cxDisplay, y - yUpdateRectTop);
+            vgaUpdateRectsAdd(&Rects, 0, yUpdateRectTop, cxDisplay, y - yUpdateRectTop);
             yUpdateRectTop = UINT32_MAX;
         }
         pbDst += cbDstScanline;
@@ -2341,9 +2414,9 @@ static int vmsvga_draw_graphic(PVGASTATE pThis, bool fFullUpdate, bool fFailOnRe
     if (yUpdateRectTop != UINT32_MAX)
     {
         /* flush to display */
-        Log(("Flush to display (%d,%d)(%d,%d)\n", 0, yUpdateRectTop, cxDisplay, y - yUpdateRectTop));
-        pDrv->pfnUpdateRect(pDrv, 0, yUpdateRectTop, cxDisplay, y - yUpdateRectTop);
+        vgaUpdateRectsAdd(&Rects, 0, yUpdateRectTop, cxDisplay, y - yUpdateRectTop);
     }
+    vgaUpdateRectsDone(pThis, &Rects);
 
     /* reset modified pages */
     if (offPageMax != -1 && reset_dirty)
@@ -2478,6 +2551,33 @@ static int vga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnResiz
 #endif
     addr1 = (pThis->start_addr * 4);
     bwidth = (width * bits + 7) / 8;    /* The visible width of a scanline. */
+
+    /* Nothing to do if no page the display is made of has been written to since the last update. */
+    if (   !full_update
+        && !pThis->cursor_draw_line
+        && !vga_is_any_line_invalidated(pThis, height))
+    {
+        /* With CGA/MDA compatibility addressing or a split screen the lines can come from anywhere. */
+        uint64_t offStart = addr1;
+        uint64_t offEnd   = (uint64_t)addr1 + (uint64_t)height * (uint32_t)line_offset + bwidth;
+        if (   (pThis->cr[0x17] & 3) != 3
+            || pThis->line_compare < (uint32_t)height)
+        {
+            offStart = 0;
+            offEnd   = pThis->vram_size;
+        }
+        offEnd = RT_MIN(offEnd, pThis->vram_size);
+
+        if (!vga_is_range_dirty(pThis, offStart, offEnd))
+        {
+            STAM_COUNTER_INC(&pThis->StatUpdateDispClean);
+            return VINF_SUCCESS;
+        }
+    }
+
+    VGAUPDATERECTS Rects;
+    vgaUpdateRectsInit(&Rects, pDrv);
+
     y_start = -1;
     page_min = 0x7fffffff;
     page_max = -1;
@@ -2520,7 +2620,7 @@ static int vga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnResiz
         } else {
             if (y_start >= 0) {
                 /* flush to display */
-                pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+                vgaUpdateRectsAdd(&Rects, 0, y_start, disp_width, y - y_start);
                 y_start = -1;
             }
         }
@@ -2544,8 +2644,9 @@ static int vga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnResiz
     }
     if (y_start >= 0) {
         /* flush to display */
-        pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+        vgaUpdateRectsAdd(&Rects, 0, y_start, disp_width, y - y_start);
     }
+    vgaUpdateRectsDone(pThis, &Rects);
     /* reset modified pages */
     if (page_max != -1 && reset_dirty) {
         vga_reset_dirty(pThis, page_min, page_max + PAGE_SIZE);
@@ -2632,6 +2733,7 @@ static int vga_update_display(PVGASTATE pThis, bool fUpdateAll, bool fFailOnResi
             typedef FNUPDATERECT *PFNUPDATERECT;
 
             PFNUPDATERECT pfnUpdateRect = NULL;
+            DECLR3CALLBACKMEMBER(void, pfnUpdateRects,(PPDMIDISPLAYCONNECTOR pInterface, PCRTRECT paRects, uint32_t cRects)) = NULL;
 
             /* Detect the "screen blank" conditions. */
             int fBlank = 0;
@@ -2644,6 +2746,8 @@ static int vga_update_display(PVGASTATE pThis, bool fUpdateAll, bool fFailOnResi
                 if (pDrv) {
                     pfnUpdateRect = pDrv->pfnUpdateRect;
                     pDrv->pfnUpdateRect = voidUpdateRect;
+                    pfnUpdateRects = pDrv->pfnUpdateRects;
+                    pDrv->pfnUpdateRects = NULL;
                 }
             }
 
@@ -2668,6 +2772,7 @@ static int vga_update_display(PVGASTATE pThis, bool fUpdateAll, bool fFailOnResi
                 *pcur_graphic_mode = GMODE_BLANK;
                 if (pDrv) {
                     pDrv->pfnUpdateRect = pfnUpdateRect;
+                    pDrv->pfnUpdateRects = pfnUpdateRects;
                 }
             }
             return rc;
@@ -4701,6 +4806,7 @@ static DECLCALLBACK(int) vgaPortUpdateDisplay(PPDMIDISPLAYPORT pInterface)
         &&  !pThis->svga.fTraces)
     {
         /* Nothing to do as the guest will explicitely update us about frame buffer changes. */
+        pThis->cRefreshIdle = 0;
         PDMCritSectLeave(&pThis->CritSect);
         return VINF_SUCCESS;
     }
@@ -4711,12 +4817,14 @@ static DECLCALLBACK(int) vgaPortUpdateDisplay(PPDMIDISPLAYPORT pInterface)
 #else
     if (VBVAUpdateDisplay (pThis) == VINF_SUCCESS)
     {
+        pThis->cRefreshIdle = 0;
         PDMCritSectLeave(&pThis->CritSect);
         return VINF_SUCCESS;
     }
 #endif /* VBOX_WITH_HGSMI */
 
     STAM_COUNTER_INC(&pThis->StatUpdateDisp);
+    STAM_PROFILE_START(&pThis->StatUpdateDispProf, a);
     if (pThis->fHasDirtyBits && pThis->GCPhysVRAM && pThis->GCPhysVRAM != NIL_RTGCPHYS)
     {
         PGMHandlerPhysicalReset(PDMDevHlpGetVM(pDevIns), pThis->GCPhysVRAM);
@@ -4728,8 +4836,26 @@ static DECLCALLBACK(int) vgaPortUpdateDisplay(PPDMIDISPLAYPORT pInterface)
         pThis->fRemappedVGA = false;
     }
 
+    pThis->cRefreshRects = 0;
     rc = vga_update_display(pThis, false, false, true,
             pThis->pDrv, &pThis->graphic_mode);
+
+    /* Count the graphics mode updates which found nothing to do, the refresh
+       timer backs off after a while.  Text mode updates always draw the cursor. */
+    if (   pThis->cRefreshRects == 0
+        && (   pThis->graphic_mode == GMODE_GRAPH
+#ifdef VBOX_WITH_VMSVGA
+            || pThis->graphic_mode == GMODE_SVGA
+#endif
+           ))
+    {
+        if (pThis->cRefreshIdle < UINT32_MAX)
+            pThis->cRefreshIdle++;
+    }
+    else
+        pThis->cRefreshIdle = 0;
+
+    STAM_PROFILE_STOP(&pThis->StatUpdateDispProf, a);
     PDMCritSectLeave(&pThis->CritSect);
     return rc;
 }
@@ -5384,7 +5510,17 @@ static DECLCALLBACK(void) vgaTimerRefresh(PPDMDEVINS pDevIns, PTMTIMER pTimer, v
         pThis->pDrv->pfnRefresh(pThis->pDrv);
 
     if (pThis->cMilliesRefreshInterval)
-        TMTimerSetMillies(pTimer, pThis->cMilliesRefreshInterval);
+    {
+        /* Refresh less often while the guest leaves the framebuffer alone, unless it wants vsync interrupts. */
+        uint32_t cMillies = pThis->cMilliesRefreshInterval;
+        if (   pThis->cRefreshIdle >= VGA_REFRESH_IDLE_THRESHOLD
+            && !(pThis->fScanLineCfg & VBVASCANLINECFG_ENABLE_VSYNC_IRQ))
+        {
+            cMillies = RT_MIN(cMillies * VGA_REFRESH_IDLE_FACTOR, RT_MAX(cMillies, VGA_REFRESH_IDLE_MAX_MS));
+            STAM_COUNTER_INC(&pThis->StatRefreshIdle);
+        }
+        TMTimerSetMillies(pTimer, cMillies);
+    }
 
 #ifdef VBOX_WITH_VIDEOHWACCEL
     vbvaTimerCb(pThis);
@@ -7113,6 +7249,11 @@ static DECLCALLBACK(int)   vgaR3Construct(PPDMDEVINS pDevIns, int iInstance, PCF
     STAM_REG(pVM, &pThis->StatR3MemoryWrite,    STAMTYPE_PROFILE, "/Devices/VGA/R3/MMIO-Write", STAMUNIT_TICKS_PER_CALL, "Profiling of the VGAGCMemoryWrite() body.");
     STAM_REG(pVM, &pThis->StatMapPage,          STAMTYPE_COUNTER, "/Devices/VGA/MapPageCalls",  STAMUNIT_OCCURENCES,     "Calls to IOMMMIOMapMMIO2Page.");
     STAM_REG(pVM, &pThis->StatUpdateDisp,       STAMTYPE_COUNTER, "/Devices/VGA/UpdateDisplay", STAMUNIT_OCCURENCES,     "Calls to vgaPortUpdateDisplay().");
+    STAM_REG(pVM, &pThis->StatUpdateDispProf,   STAMTYPE_PROFILE, "/Devices/VGA/R3/UpdateDisplay", STAMUNIT_TICKS_PER_CALL, "Profiling of the vgaPortUpdateDisplay() body.");
+    STAM_REG(pVM, &pThis->StatUpdateDispClean,  STAMTYPE_COUNTER, "/Devices/VGA/UpdateDisplayClean", STAMUNIT_OCCURENCES, "Graphics mode updates skipped because nothing was dirty.");
+    STAM_REG(pVM, &pThis->StatUpdateRects,      STAMTYPE_COUNTER, "/Devices/VGA/UpdateRects",   STAMUNIT_OCCURENCES,     "Rectangles reported to the display connector.");
+    STAM_REG(pVM, &pThis->StatUpdateRectsFlush, STAMTYPE_COUNTER, "/Devices/VGA/UpdateRectsBatches", STAMUNIT_OCCURENCES, "Batches of rectangles reported to the display connector.");
+    STAM_REG(pVM, &pThis->StatRefreshIdle,      STAMTYPE_COUNTER, "/Devices/VGA/RefreshIdle",   STAMUNIT_OCCURENCES,     "Refresh timer intervals stretched because the display was idle.");
 
     /* Init latched access mask. */
     pThis->uMaskLatchAccess = 0x3ff;
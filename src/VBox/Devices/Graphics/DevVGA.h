@@ -329,6 +329,11 @@ typedef struct VGAState {
     uint32_t                    cMonitors;
     /** Current refresh timer interval. */
     uint32_t                    cMilliesRefreshInterval;
+    /** Number of consecutive display updates which found nothing to update.
+     * The refresh timer interval is stretched while this is high. */
+    uint32_t                    cRefreshIdle;
+    /** Number of rectangles reported by the display update in progress. */
+    uint32_t                    cRefreshRects;
     /** Bitmap tracking dirty pages. */
     uint32_t                    au32DirtyBitmap[VGA_VRAM_MAX / PAGE_SIZE / 32];
 
@@ -368,6 +373,11 @@ typedef struct VGAState {
     STAMPROFILE                 StatR3MemoryWrite;
     STAMCOUNTER                 StatMapPage;            /**< Counts IOMMMIOMapMMIO2Page calls.  */
     STAMCOUNTER                 StatUpdateDisp;         /**< Counts vgaPortUpdateDisplay calls.  */
+    STAMPROFILE                 StatUpdateDispProf;     /**< Profiling of the vga_update_display() part of vgaPortUpdateDisplay. */
+    STAMCOUNTER                 StatUpdateDispClean;    /**< Counts graphics mode updates skipped as no page was dirty. */
+    STAMCOUNTER                 StatUpdateRects;        /**< Counts rectangles reported to the display connector. */
+    STAMCOUNTER                 StatUpdateRectsFlush;   /**< Counts batches of rectangles passed to the display connector. */
+    STAMCOUNTER                 StatRefreshIdle;        /**< Counts refresh timer periods stretched because the display was idle. */
 
     /* Keep track of ring 0 latched accesses to the VGA MMIO memory. */
     uint64_t                    u64LastLatchedAccess;
@@ -0,0 +1,166 @@
+/* $Id$ */
+/** @file
+ * DevVGA - Collecting the rectangles of a display update.
+ *
+ * @remarks Kept apart from DevVGA.cpp so the testcase can get at it without
+ *          dragging in the whole device.
+ */
+
+/*
+ * Copyright (C) 2006-2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+#ifndef ___Graphics_DevVGAUpdateRects_h
+#define ___Graphics_DevVGAUpdateRects_h
+
+#include <VBox/vmm/pdmifs.h>
+#include <VBox/log.h>
+#include <iprt/asm.h>
+#include <iprt/types.h>
+
+
+/** Maximum number of rectangles a display update collects before passing
+ * them on to the display connector. */
+#define VGA_UPDATE_RECTS_MAX            32
+/** Dirty scanline spans separated by no more than this number of clean
+ * scanlines are reported as a single rectangle. */
+#define VGA_UPDATE_RECTS_MERGE_GAP      8
+
+
+/**
+ * Rectangles collected by a graphics mode display update.
+ */
+typedef struct VGAUPDATERECTS
+{
+    /** The display connector to report the rectangles to. */
+    PDMIDISPLAYCONNECTOR   *pDrv;
+    /** Number of rectangles in aRects. */
+    uint32_t                cRects;
+    /** Number of times rectangles were passed on to the connector. */
+    uint32_t                cFlushes;
+    /** Number of rectangles passed on to the connector. */
+    uint32_t                cReported;
+    /** The rectangles. */
+    RTRECT                  aRects[VGA_UPDATE_RECTS_MAX];
+} VGAUPDATERECTS;
+/** Pointer to rectangles collected by a display update. */
+typedef VGAUPDATERECTS *PVGAUPDATERECTS;
+
+
+/**
+ * Starts collecting rectangles for a display update.
+ *
+ * @param   pRects  The rectangles to initialize.
+ * @param   pDrv    The display connector to report them to.
+ */
+DECLINLINE(void) vgaUpdateRectsInit(PVGAUPDATERECTS pRects, PDMIDISPLAYCONNECTOR *pDrv)
+{
+    pRects->pDrv      = pDrv;
+    pRects->cRects    = 0;
+    pRects->cFlushes  = 0;
+    pRects->cReported = 0;
+}
+
+/**
+ * Passes the collected rectangles on to the display connector.
+ *
+ * @param   pRects  The collected rectangles.
+ */
+DECLINLINE(void) vgaUpdateRectsFlush(PVGAUPDATERECTS pRects)
+{
+    if (!pRects->cRects)
+        return;
+
+    PDMIDISPLAYCONNECTOR *pDrv = pRects->pDrv;
+    if (pDrv->pfnUpdateRects)
+        pDrv->pfnUpdateRects(pDrv, &pRects->aRects[0], pRects->cRects);
+    else
+    {
+        for (uint32_t i = 0; i < pRects->cRects; i++)
+        {
+            PCRTRECT pRect = &pRects->aRects[i];
+            pDrv->pfnUpdateRect(pDrv, pRect->xLeft, pRect->yTop,
+                                pRect->xRight - pRect->xLeft, pRect->yBottom - pRect->yTop);
+        }
+    }
+
+    pRects->cFlushes++;
+    pRects->cReported += pRects->cRects;
+    pRects->cRects = 0;
+}
+
+/**
+ * Adds a rectangle to be reported to the display connector.
+ *
+ * Merges the rectangle with the previous one if they are of the same width and
+ * only a few scanlines apart.  The scanlines in between are clean, so their
+ * framebuffer content is still valid and reporting them is harmless.
+ *
+ * @param   pRects  The collected rectangles.
+ * @param   x       The upper left corner x coordinate of the rectangle.
+ * @param   y       The upper left corner y coordinate of the rectangle.
+ * @param   cx      The width of the rectangle.
+ * @param   cy      The height of the rectangle.
+ */
+DECLINLINE(void) vgaUpdateRectsAdd(PVGAUPDATERECTS pRects, uint32_t x, uint32_t y, uint32_t cx, uint32_t cy)
+{
+    Log(("Flush to display (%d,%d)(%d,%d)\n", x, y, cx, cy));
+
+    if (pRects->cRects)
+    {
+        PRTRECT pLast = &pRects->aRects[pRects->cRects - 1];
+        if (   pLast->xLeft   == (int32_t)x
+            && pLast->xRight  == (int32_t)(x + cx)
+            && pLast->yBottom <= (int32_t)y
+            && (int32_t)y - pLast->yBottom <= VGA_UPDATE_RECTS_MERGE_GAP)
+        {
+            pLast->yBottom = y + cy;
+            return;
+        }
+
+        if (pRects->cRects >= RT_ELEMENTS(pRects->aRects))
+            vgaUpdateRectsFlush(pRects);
+    }
+
+    PRTRECT pRect = &pRects->aRects[pRects->cRects++];
+    pRect->xLeft   = x;
+    pRect->yTop    = y;
+    pRect->xRight  = x + cx;
+    pRect->yBottom = y + cy;
+}
+
+/**
+ * Tests if any page in a range of the dirty page bitmap is set.
+ *
+ * Scans the bitmap a word at a time rather than testing page by page.
+ *
+ * @returns true if dirty.
+ * @returns false if clean.
+ * @param   pau32Bitmap     The dirty page bitmap.  Must extend to iPageEnd
+ *                          rounded up to a multiple of 32 bits.
+ * @param   iPageFirst      The first page to test.
+ * @param   iPageEnd        The page after the last one to test.
+ */
+DECLINLINE(bool) vgaIsPageRangeDirty(uint32_t const *pau32Bitmap, uint32_t iPageFirst, uint32_t iPageEnd)
+{
+    if (iPageFirst >= iPageEnd)
+        return false;
+    if (ASMBitTest(pau32Bitmap, iPageFirst))
+        return true;
+
+    int const iPageDirty = ASMBitNextSet(pau32Bitmap, RT_ALIGN_32(iPageEnd, 32), iPageFirst);
+    return iPageDirty >= 0
+        && (uint32_t)iPageDirty < iPageEnd;
+}
+
+#endif
+
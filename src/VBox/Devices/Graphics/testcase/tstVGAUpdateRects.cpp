@@ -0,0 +1,294 @@
+/* $Id$ */
+/** @file
+ * VGA display update rectangle collection testcase.
+ */
+
+/*
+ * Copyright (C) 2017 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+#include "../DevVGAUpdateRects.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Number of pages covered by the test bitmap. */
+#define TST_PAGES           256
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** Number of pfnUpdateRects calls seen. */
+static uint32_t g_cUpdateRectsCalls;
+/** Number of pfnUpdateRect calls seen. */
+static uint32_t g_cUpdateRectCalls;
+/** The rectangles reported to the connector, by either method. */
+static RTRECT   g_aReported[256];
+/** Number of valid entries in g_aReported. */
+static uint32_t g_cReported;
+
+
+static DECLCALLBACK(void) tstUpdateRect(PPDMIDISPLAYCONNECTOR pInterface, uint32_t x, uint32_t y, uint32_t cx, uint32_t cy)
+{
+    RT_NOREF(pInterface);
+    g_cUpdateRectCalls++;
+    if (g_cReported < RT_ELEMENTS(g_aReported))
+    {
+        g_aReported[g_cReported].xLeft   = x;
+        g_aReported[g_cReported].yTop    = y;
+        g_aReported[g_cReported].xRight  = x + cx;
+        g_aReported[g_cReported].yBottom = y + cy;
+        g_cReported++;
+    }
+}
+
+
+static DECLCALLBACK(void) tstUpdateRects(PPDMIDISPLAYCONNECTOR pInterface, PCRTRECT paRects, uint32_t cRects)
+{
+    RT_NOREF(pInterface);
+    g_cUpdateRectsCalls++;
+    for (uint32_t i = 0; i < cRects && g_cReported < RT_ELEMENTS(g_aReported); i++)
+        g_aReported[g_cReported++] = paRects[i];
+}
+
+
+static void tstResetConnector(void)
+{
+    g_cUpdateRectsCalls = 0;
+    g_cUpdateRectCalls  = 0;
+    g_cReported         = 0;
+    RT_ZERO(g_aReported);
+}
+
+
+/**
+ * Checks a reported rectangle.
+ */
+static bool tstCheckRect(uint32_t i, int32_t xLeft, int32_t yTop, int32_t xRight, int32_t yBottom)
+{
+    if (   i < g_cReported
+        && g_aReported[i].xLeft   == xLeft
+        && g_aReported[i].yTop    == yTop
+        && g_aReported[i].xRight  == xRight
+        && g_aReported[i].yBottom == yBottom)
+        return true;
+    RTTestIFailed("rectangle #%u: got (%d,%d)-(%d,%d), expected (%d,%d)-(%d,%d)\n", i,
+                  g_aReported[i].xLeft, g_aReported[i].yTop, g_aReported[i].xRight, g_aReported[i].yBottom,
+                  xLeft, yTop, xRight, yBottom);
+    return false;
+}
+
+
+/**
+ * The page by page reference for vgaIsPageRangeDirty.
+ */
+static bool tstIsPageRangeDirtyRef(uint32_t const *pau32Bitmap, uint32_t iPageFirst, uint32_t iPageEnd)
+{
+    for (uint32_t iPage = iPageFirst; iPage < iPageEnd; iPage++)
+        if (pau32Bitmap[iPage / 32] & RT_BIT_32(iPage % 32))
+            return true;
+    return false;
+}
+
+
+/**
+ * Compares the word scanning dirty range check with the page by page one.
+ */
+static void tstPageRangeDirty(void)
+{
+    RTTestISub("Dirty page range");
+
+    uint32_t au32Bitmap[TST_PAGES / 32];
+
+    /* Clean bitmap. */
+    RT_ZERO(au32Bitmap);
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 0, TST_PAGES));
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 5, 5));
+
+    /* A dirty first page is found before scanning. */
+    ASMBitSet(au32Bitmap, 40);
+    RTTESTI_CHECK(vgaIsPageRangeDirty(au32Bitmap, 40, 41));
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 41, TST_PAGES));
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 0, 40));
+
+    /* A dirty page in the same word right behind the range must not count. */
+    RT_ZERO(au32Bitmap);
+    ASMBitSet(au32Bitmap, 45);
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 33, 45));
+    RTTESTI_CHECK(vgaIsPageRangeDirty(au32Bitmap, 33, 46));
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 46, 64));
+
+    /* Ranges crossing words. */
+    RT_ZERO(au32Bitmap);
+    ASMBitSet(au32Bitmap, 100);
+    RTTESTI_CHECK(vgaIsPageRangeDirty(au32Bitmap, 31, 101));
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 31, 100));
+    RTTESTI_CHECK(!vgaIsPageRangeDirty(au32Bitmap, 101, TST_PAGES));
+
+    /* Random sparse bitmaps against the reference. */
+    for (unsigned iRound = 0; iRound < 20000; iRound++)
+    {
+        RT_ZERO(au32Bitmap);
+        uint32_t const cDirty = RTRandU32Ex(0, 3);
+        for (uint32_t i = 0; i < cDirty; i++)
+            ASMBitSet(au32Bitmap, RTRandU32Ex(0, TST_PAGES - 1));
+
+        uint32_t const iPageFirst = RTRandU32Ex(0, TST_PAGES - 1);
+        uint32_t const iPageEnd   = RTRandU32Ex(iPageFirst, TST_PAGES);
+        RTTESTI_CHECK_MSG_RETV(   vgaIsPageRangeDirty(au32Bitmap, iPageFirst, iPageEnd)
+                               == tstIsPageRangeDirtyRef(au32Bitmap, iPageFirst, iPageEnd),
+                               ("iPageFirst=%u iPageEnd=%u\n", iPageFirst, iPageEnd));
+    }
+}
+
+
+/**
+ * Checks the merging of dirty scanline spans.
+ */
+static void tstMerge(void)
+{
+    RTTestISub("Merging spans");
+
+    PDMIDISPLAYCONNECTOR Drv;
+    RT_ZERO(Drv);
+    Drv.pfnUpdateRect  = tstUpdateRect;
+    Drv.pfnUpdateRects = tstUpdateRects;
+
+    VGAUPDATERECTS Rects;
+    tstResetConnector();
+    vgaUpdateRectsInit(&Rects, &Drv);
+
+    /* Adjacent and up to VGA_UPDATE_RECTS_MERGE_GAP scanlines apart merges. */
+    vgaUpdateRectsAdd(&Rects, 0, 0, 640, 10);
+    vgaUpdateRectsAdd(&Rects, 0, 10, 640, 5);
+    vgaUpdateRectsAdd(&Rects, 0, 15 + VGA_UPDATE_RECTS_MERGE_GAP, 640, 1);
+    RTTESTI_CHECK(Rects.cRects == 1);
+
+    /* One more clean scanline does not. */
+    vgaUpdateRectsAdd(&Rects, 0, 16 + 2 * VGA_UPDATE_RECTS_MERGE_GAP + 1, 640, 2);
+    RTTESTI_CHECK(Rects.cRects == 2);
+
+    /* Neither does a different width or left edge. */
+    vgaUpdateRectsAdd(&Rects, 0, 40, 320, 1);
+    vgaUpdateRectsAdd(&Rects, 8, 41, 312, 1);
+    RTTESTI_CHECK(Rects.cRects == 4);
+
+    /* Nor a span above the previous one. */
+    vgaUpdateRectsAdd(&Rects, 8, 0, 312, 1);
+    RTTESTI_CHECK(Rects.cRects == 5);
+
+    RTTESTI_CHECK(g_cReported == 0);
+    vgaUpdateRectsFlush(&Rects);
+    RTTESTI_CHECK(Rects.cRects == 0);
+    RTTESTI_CHECK(Rects.cFlushes == 1);
+    RTTESTI_CHECK(Rects.cReported == 5);
+    RTTESTI_CHECK(g_cUpdateRectsCalls == 1);
+    RTTESTI_CHECK(g_cUpdateRectCalls == 0);
+    RTTESTI_CHECK_RETV(g_cReported == 5);
+    tstCheckRect(0, 0, 0, 640, 16 + VGA_UPDATE_RECTS_MERGE_GAP);
+    tstCheckRect(1, 0, 16 + 2 * VGA_UPDATE_RECTS_MERGE_GAP + 1, 640, 16 + 2 * VGA_UPDATE_RECTS_MERGE_GAP + 3);
+    tstCheckRect(2, 0, 40, 320, 41);
+    tstCheckRect(3, 8, 41, 320, 42);
+    tstCheckRect(4, 8, 0, 320, 1);
+
+    /* Flushing nothing does not bother the connector. */
+    vgaUpdateRectsFlush(&Rects);
+    RTTESTI_CHECK(Rects.cFlushes == 1);
+    RTTESTI_CHECK(g_cUpdateRectsCalls == 1);
+}
+
+
+/**
+ * Checks that the rectangles are passed on in batches of
+ * VGA_UPDATE_RECTS_MAX, and one by one to connectors without pfnUpdateRects.
+ */
+static void tstFlush(void)
+{
+    RTTestISub("Flushing");
+
+    PDMIDISPLAYCONNECTOR Drv;
+    RT_ZERO(Drv);
+    Drv.pfnUpdateRect  = tstUpdateRect;
+    Drv.pfnUpdateRects = tstUpdateRects;
+
+    for (unsigned iPass = 0; iPass < 2; iPass++)
+    {
+        if (iPass == 1)
+            Drv.pfnUpdateRects = NULL;
+
+        VGAUPDATERECTS Rects;
+        tstResetConnector();
+        vgaUpdateRectsInit(&Rects, &Drv);
+
+        /* Every other scanline of alternating widths, so nothing merges. */
+        uint32_t const cAdd = 2 * VGA_UPDATE_RECTS_MAX + 3;
+        for (uint32_t i = 0; i < cAdd; i++)
+        {
+            vgaUpdateRectsAdd(&Rects, 0, i * 2, 100 + (i & 1), 1);
+            if (i < VGA_UPDATE_RECTS_MAX)
+            {
+                RTTESTI_CHECK_MSG_BREAK(g_cReported == 0, ("i=%u\n", i));
+            }
+        }
+
+        /* The 33rd and 65th rectangles each pushed out a full batch. */
+        RTTESTI_CHECK(Rects.cFlushes == 2);
+        RTTESTI_CHECK(Rects.cRects == 3);
+        RTTESTI_CHECK(g_cReported == 2 * VGA_UPDATE_RECTS_MAX);
+
+        vgaUpdateRectsFlush(&Rects);
+        RTTESTI_CHECK(Rects.cFlushes == 3);
+        RTTESTI_CHECK(Rects.cReported == cAdd);
+        RTTESTI_CHECK_RETV(g_cReported == cAdd);
+        if (iPass == 0)
+        {
+            RTTESTI_CHECK(g_cUpdateRectsCalls == 3);
+            RTTESTI_CHECK(g_cUpdateRectCalls == 0);
+        }
+        else
+        {
+            RTTESTI_CHECK(g_cUpdateRectsCalls == 0);
+            RTTESTI_CHECK(g_cUpdateRectCalls == cAdd);
+        }
+
+        /* Reported in order, with nothing lost at the batch boundaries. */
+        for (uint32_t i = 0; i < cAdd; i++)
+            if (!tstCheckRect(i, 0, i * 2, 100 + (i & 1), i * 2 + 1))
+                break;
+    }
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstVGAUpdateRects", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    tstPageRangeDirty();
+    tstMerge();
+    tstFlush();
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
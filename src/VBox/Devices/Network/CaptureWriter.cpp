@@ -0,0 +1,725 @@
+/* $Id$ */
+/** @file
+ * Asynchronous capture file writer shared by the network and USB sniffers.
+ *
+ * Producers (EMTs, network and USB I/O threads) copy their records into one of
+ * several single producer/single consumer byte rings without taking any lock
+ * and without touching the file.  A ring is claimed with a single compare and
+ * exchange for the duration of the copy only, so concurrent producers end up on
+ * different rings.  A producer finding all rings claimed drops its record
+ * instead of waiting for one to become free.  A dedicated
+ * writer thread merges the rings by record timestamp into a large output
+ * buffer and writes it out in big chunks, optionally starting a new file when
+ * the current one grows too big or gets too old.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define LOG_GROUP LOG_GROUP_DRV_CAPTURE
+#include "CaptureWriter.h"
+
+#include <VBox/log.h>
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/critsect.h>
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/mem.h>
+#include <iprt/path.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Default size of a producer ring. */
+#define CAPTUREWRITER_RING_SIZE_DEF         _256K
+/** Minimum size of a producer ring. */
+#define CAPTUREWRITER_RING_SIZE_MIN         _4K
+/** Maximum size of a producer ring. */
+#define CAPTUREWRITER_RING_SIZE_MAX         _64M
+/** Default number of producer rings. */
+#define CAPTUREWRITER_RINGS_DEF             8
+/** Maximum number of producer rings. */
+#define CAPTUREWRITER_RINGS_MAX             64
+/** Default size of the output buffer. */
+#define CAPTUREWRITER_WRITE_BUF_DEF         _1M
+/** Default flush interval in milliseconds. */
+#define CAPTUREWRITER_FLUSH_INTERVAL_DEF    100
+
+/** Record alignment inside the rings. */
+#define CAPTUREWRITER_REC_ALIGN             8
+/** Record header flag: padding up to the end of the ring, no data. */
+#define CAPTUREWRITER_REC_F_PAD             RT_BIT_32(0)
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+
+/**
+ * Record header inside a producer ring.
+ */
+typedef struct CAPTUREWRITERREC
+{
+    /** Total size of the record including this header, aligned. */
+    uint32_t            cbRec;
+    /** Record flags, CAPTUREWRITER_REC_F_XXX. */
+    uint32_t            fFlags;
+    /** Size of the payload following the header. */
+    uint32_t            cbData;
+    /** Reserved. */
+    uint32_t            u32Reserved;
+    /** The record timestamp. */
+    uint64_t            uTimestamp;
+} CAPTUREWRITERREC;
+AssertCompileSize(CAPTUREWRITERREC, 24);
+AssertCompile(!(sizeof(CAPTUREWRITERREC) % CAPTUREWRITER_REC_ALIGN));
+/** Pointer to a record header. */
+typedef CAPTUREWRITERREC *PCAPTUREWRITERREC;
+
+/**
+ * Single producer, single consumer byte ring.
+ */
+typedef struct CAPTUREWRITERRING
+{
+    /** Set while a producer copies a record into the ring. */
+    bool volatile       fBusy;
+    /** Alignment padding. */
+    bool                afPadding[7];
+    /** Free running write offset, only modified by the owning producer. */
+    uint32_t volatile   offWrite;
+    /** Free running read offset, only modified by the writer thread. */
+    uint32_t volatile   offRead;
+    /** The ring buffer. */
+    uint8_t            *pbBuf;
+} CAPTUREWRITERRING;
+/** Pointer to a producer ring. */
+typedef CAPTUREWRITERRING *PCAPTUREWRITERRING;
+
+/**
+ * The internal capture writer state.
+ */
+typedef struct CAPTUREWRITERINT
+{
+    /** The writer thread. */
+    RTTHREAD            hThread;
+    /** Event the writer thread waits on. */
+    RTSEMEVENT          hEvtWrite;
+    /** Set when the writer thread should terminate. */
+    bool volatile       fShutdown;
+    /** Set while the writer thread is sleeping on hEvtWrite. */
+    bool volatile       fWaiting;
+    /** Set when the file header changed and needs to be picked up. */
+    bool volatile       fHdrChanged;
+    /** Creation flags. */
+    uint32_t            fFlags;
+    /** The effective configuration. */
+    CAPTUREWRITERCFG    Cfg;
+    /** Ring index mask, the rings are accessed modulo cbRing. */
+    uint32_t            fRingMask;
+    /** Fill level of a ring at which the producer wakes up the writer. */
+    uint32_t            cbRingHighWater;
+
+    /** The current capture file. */
+    RTFILE              hFile;
+    /** Sequence number of the current file. */
+    uint32_t            iFile;
+    /** Number of bytes written to the current file. */
+    uint64_t            cbFile;
+    /** Millisecond timestamp the current file was created at. */
+    uint64_t            msFileCreated;
+    /** The base file name. */
+    char               *pszFilename;
+
+    /** Critical section protecting the pending file header. */
+    RTCRITSECT          CritSectHdr;
+    /** The pending file header, owned by CritSectHdr. */
+    uint8_t            *pbHdrPending;
+    /** Size of the pending file header. */
+    size_t              cbHdrPending;
+    /** The file header used by the writer thread. */
+    uint8_t            *pbHdr;
+    /** Size of the file header. */
+    size_t              cbHdr;
+
+    /** The output buffer used by the writer thread. */
+    uint8_t            *pbWriteBuf;
+    /** Number of bytes used in the output buffer. */
+    size_t              cbWriteBufUsed;
+
+    /** Statistics. */
+    CAPTUREWRITERSTATS  Stats;
+    /** Number of producer rings. */
+    uint32_t            cRings;
+    /** The producer rings - variable in size. */
+    CAPTUREWRITERRING   aRings[1];
+} CAPTUREWRITERINT;
+/** Pointer to the internal capture writer state. */
+typedef CAPTUREWRITERINT *PCAPTUREWRITERINT;
+
+
+/*********************************************************************************************************************************
+*   Internal Functions                                                                                                           *
+*********************************************************************************************************************************/
+
+/**
+ * Builds the name of the capture file with the given sequence number.
+ *
+ * @returns Pointer to the file name, free with RTStrFree(). NULL on failure.
+ * @param   pThis       The capture writer.
+ * @param   iFile       The sequence number, 0 is the base name.
+ */
+static char *captureWriterFileName(PCAPTUREWRITERINT pThis, uint32_t iFile)
+{
+    if (!iFile)
+        return RTStrDup(pThis->pszFilename);
+
+    char *pszName = NULL;
+    const char *pszSuffix = RTPathSuffix(pThis->pszFilename);
+    if (pszSuffix)
+        RTStrAPrintf(&pszName, "%.*s-%u%s", (int)(pszSuffix - pThis->pszFilename), pThis->pszFilename, iFile, pszSuffix);
+    else
+        RTStrAPrintf(&pszName, "%s-%u", pThis->pszFilename, iFile);
+    return pszName;
+}
+
+
+/**
+ * Opens the capture file with the current sequence number and writes the header.
+ *
+ * @returns VBox status code.
+ * @param   pThis       The capture writer.
+ */
+static int captureWriterFileOpen(PCAPTUREWRITERINT pThis)
+{
+    char *pszName = captureWriterFileName(pThis, pThis->iFile);
+    if (!pszName)
+        return VERR_NO_STR_MEMORY;
+
+    uint64_t fOpen = RTFILE_O_WRITE | RTFILE_O_DENY_WRITE;
+    if (pThis->fFlags & CAPTUREWRITER_F_NO_REPLACE)
+        fOpen |= RTFILE_O_CREATE;
+    else
+        fOpen |= RTFILE_O_CREATE_REPLACE;
+
+    int rc = RTFileOpen(&pThis->hFile, pszName, fOpen);
+    if (RT_SUCCESS(rc))
+    {
+        pThis->cbFile        = 0;
+        pThis->msFileCreated = RTTimeMilliTS();
+        if (pThis->cbHdr)
+        {
+            rc = RTFileWrite(pThis->hFile, pThis->pbHdr, pThis->cbHdr, NULL);
+            if (RT_SUCCESS(rc))
+                pThis->cbFile = pThis->cbHdr;
+            else
+            {
+                RTFileClose(pThis->hFile);
+                pThis->hFile = NIL_RTFILE;
+            }
+        }
+    }
+    else
+        LogRel(("CaptureWriter: Failed to create '%s': %Rrc\n", pszName, rc));
+
+    RTStrFree(pszName);
+    return rc;
+}
+
+
+/**
+ * Picks up a file header changed by CaptureWriterSetFileHeader().
+ *
+ * @returns nothing.
+ * @param   pThis       The capture writer.
+ */
+static void captureWriterHdrUpdate(PCAPTUREWRITERINT pThis)
+{
+    if (ASMAtomicXchgBool(&pThis->fHdrChanged, false))
+    {
+        RTCritSectEnter(&pThis->CritSectHdr);
+        RTMemFree(pThis->pbHdr);
+        pThis->pbHdr        = pThis->pbHdrPending;
+        pThis->cbHdr        = pThis->cbHdrPending;
+        pThis->pbHdrPending = NULL;
+        pThis->cbHdrPending = 0;
+        RTCritSectLeave(&pThis->CritSectHdr);
+    }
+}
+
+
+/**
+ * Writes out the output buffer, starting a new file first if required.
+ *
+ * @returns nothing.
+ * @param   pThis       The capture writer.
+ */
+static void captureWriterFlushBuf(PCAPTUREWRITERINT pThis)
+{
+    size_t const cbBuf = pThis->cbWriteBufUsed;
+    if (!cbBuf)
+        return;
+    pThis->cbWriteBufUsed = 0;
+
+    /*
+     * Rotate?  Never rotate a file which contains nothing but the header, a single
+     * output buffer exceeding the size limit would otherwise create files forever.
+     */
+    if (   pThis->hFile != NIL_RTFILE
+        && pThis->cbFile > pThis->cbHdr
+        && (   (   pThis->Cfg.cbRotateSize
+                && pThis->cbFile + cbBuf > pThis->Cfg.cbRotateSize)
+            || (   pThis->Cfg.cSecsRotate
+                && RTTimeMilliTS() - pThis->msFileCreated >= pThis->Cfg.cSecsRotate * UINT64_C(1000))))
+    {
+        RTFileClose(pThis->hFile);
+        pThis->hFile = NIL_RTFILE;
+        pThis->iFile++;
+        captureWriterHdrUpdate(pThis);
+        int rc = captureWriterFileOpen(pThis);
+        if (RT_SUCCESS(rc))
+            ASMAtomicIncU64(&pThis->Stats.cRotations);
+    }
+
+    /* Retry creating the file if a previous rotation failed. */
+    if (   pThis->hFile == NIL_RTFILE
+        && RT_FAILURE(captureWriterFileOpen(pThis)))
+    {
+        ASMAtomicIncU64(&pThis->Stats.cWriteErrors);
+        return;
+    }
+
+    int rc = RTFileWrite(pThis->hFile, pThis->pbWriteBuf, cbBuf, NULL);
+    if (RT_SUCCESS(rc))
+    {
+        pThis->cbFile += cbBuf;
+        ASMAtomicAddU64(&pThis->Stats.cbWritten, cbBuf);
+        ASMAtomicIncU64(&pThis->Stats.cWrites);
+    }
+    else
+    {
+        if (ASMAtomicIncU64(&pThis->Stats.cWriteErrors) == 1)
+            LogRel(("CaptureWriter: Writing %zu bytes to the capture file failed: %Rrc\n", cbBuf, rc));
+    }
+}
+
+
+/**
+ * Returns the header of the next record in the given ring, skipping padding.
+ *
+ * @returns Pointer to the record header, NULL if the ring is empty.
+ * @param   pThis       The capture writer.
+ * @param   pRing       The ring to peek at.
+ */
+static PCAPTUREWRITERREC captureWriterRingPeek(PCAPTUREWRITERINT pThis, PCAPTUREWRITERRING pRing)
+{
+    for (;;)
+    {
+        uint32_t const offRead  = pRing->offRead;
+        uint32_t const offWrite = ASMAtomicReadU32(&pRing->offWrite);
+        if (offRead == offWrite)
+            return NULL;
+
+        PCAPTUREWRITERREC pRec = (PCAPTUREWRITERREC)&pRing->pbBuf[offRead & pThis->fRingMask];
+        if (!(pRec->fFlags & CAPTUREWRITER_REC_F_PAD))
+            return pRec;
+        ASMAtomicWriteU32(&pRing->offRead, offRead + pRec->cbRec);
+    }
+}
+
+
+/**
+ * Moves all records currently queued in the rings into the output buffer,
+ * merging them by timestamp, and writes them out.
+ *
+ * @returns nothing.
+ * @param   pThis       The capture writer.
+ */
+static void captureWriterDrain(PCAPTUREWRITERINT pThis)
+{
+    for (;;)
+    {
+        /* Find the oldest record at the head of the rings. */
+        PCAPTUREWRITERRING pRingMin = NULL;
+        PCAPTUREWRITERREC  pRecMin  = NULL;
+        for (uint32_t i = 0; i < pThis->cRings; i++)
+        {
+            PCAPTUREWRITERREC pRec = captureWriterRingPeek(pThis, &pThis->aRings[i]);
+            if (   pRec
+                && (   !pRecMin
+                    || pRec->uTimestamp < pRecMin->uTimestamp))
+            {
+                pRecMin  = pRec;
+                pRingMin = &pThis->aRings[i];
+            }
+        }
+        if (!pRecMin)
+            break;
+
+        /* Records larger than the output buffer are written directly. */
+        size_t const cbData = pRecMin->cbData;
+        if (pThis->cbWriteBufUsed + cbData > pThis->Cfg.cbWriteBuf)
+            captureWriterFlushBuf(pThis);
+        if (cbData <= pThis->Cfg.cbWriteBuf)
+        {
+            memcpy(&pThis->pbWriteBuf[pThis->cbWriteBufUsed], pRecMin + 1, cbData);
+            pThis->cbWriteBufUsed += cbData;
+        }
+        else
+        {
+            int rc = VERR_INVALID_HANDLE;
+            if (pThis->hFile != NIL_RTFILE)
+                rc = RTFileWrite(pThis->hFile, pRecMin + 1, cbData, NULL);
+            if (RT_SUCCESS(rc))
+            {
+                pThis->cbFile += cbData;
+                ASMAtomicAddU64(&pThis->Stats.cbWritten, cbData);
+                ASMAtomicIncU64(&pThis->Stats.cWrites);
+            }
+            else
+            {
+                ASMAtomicIncU64(&pThis->Stats.cWriteErrors);
+                ASMAtomicIncU64(&pThis->Stats.cRecordsDropped);
+                ASMAtomicAddU64(&pThis->Stats.cbDropped, cbData);
+            }
+        }
+
+        ASMAtomicWriteU32(&pRingMin->offRead, pRingMin->offRead + pRecMin->cbRec);
+    }
+
+    captureWriterFlushBuf(pThis);
+}
+
+
+/**
+ * The writer thread.
+ *
+ * @returns VINF_SUCCESS.
+ * @param   hThread     The thread handle, unused.
+ * @param   pvUser      The capture writer.
+ */
+static DECLCALLBACK(int) captureWriterThread(RTTHREAD hThread, void *pvUser)
+{
+    RT_NOREF(hThread);
+    PCAPTUREWRITERINT pThis = (PCAPTUREWRITERINT)pvUser;
+
+    while (!ASMAtomicReadBool(&pThis->fShutdown))
+    {
+        ASMAtomicWriteBool(&pThis->fWaiting, true);
+        RTSemEventWait(pThis->hEvtWrite, pThis->Cfg.cMsFlushInterval);
+        ASMAtomicWriteBool(&pThis->fWaiting, false);
+
+        captureWriterDrain(pThis);
+    }
+
+    /* Get everything queued before the shutdown request out. */
+    captureWriterDrain(pThis);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Claims a producer ring for the calling thread.
+ *
+ * Tries every ring once and gives up if all of them are claimed by other
+ * producers, so a producer never waits for another one.
+ *
+ * @returns Pointer to the claimed ring, NULL if all rings are busy.
+ * @param   pThis       The capture writer.
+ */
+static PCAPTUREWRITERRING captureWriterRingClaim(PCAPTUREWRITERINT pThis)
+{
+    /* Start at a ring derived from the thread so a producer usually sticks to its ring. */
+    uint32_t i = (uint32_t)(((uintptr_t)RTThreadNativeSelf() >> 4) % pThis->cRings);
+    for (uint32_t cTries = 0; cTries < pThis->cRings; cTries++)
+    {
+        PCAPTUREWRITERRING pRing = &pThis->aRings[i];
+        if (ASMAtomicCmpXchgBool(&pRing->fBusy, true, false))
+            return pRing;
+        i = (i + 1) % pThis->cRings;
+    }
+    return NULL;
+}
+
+
+/**
+ * Accounts for a dropped record.
+ *
+ * @returns nothing.
+ * @param   pThis       The capture writer.
+ * @param   cbData      Size of the record payload.
+ */
+DECLINLINE(void) captureWriterRecordDropped(PCAPTUREWRITERINT pThis, size_t cbData)
+{
+    ASMAtomicIncU64(&pThis->Stats.cRecordsDropped);
+    ASMAtomicAddU64(&pThis->Stats.cbDropped, cbData);
+}
+
+
+DECLHIDDEN(int) CaptureWriterCreate(PCAPTUREWRITER phWriter, const char *pszFilename, uint32_t fFlags,
+                                    PCCAPTUREWRITERCFG pCfg, const void *pvHdr, size_t cbHdr)
+{
+    AssertPtrReturn(phWriter, VERR_INVALID_POINTER);
+    AssertPtrReturn(pszFilename, VERR_INVALID_POINTER);
+    AssertReturn(!(fFlags & ~CAPTUREWRITER_F_VALID_MASK), VERR_INVALID_PARAMETER);
+    AssertReturn(!cbHdr || VALID_PTR(pvHdr), VERR_INVALID_POINTER);
+
+    /*
+     * Sanitize the configuration.
+     */
+    CAPTUREWRITERCFG Cfg;
+    if (pCfg)
+        Cfg = *pCfg;
+    else
+        RT_ZERO(Cfg);
+    if (!Cfg.cbRing)
+        Cfg.cbRing = CAPTUREWRITER_RING_SIZE_DEF;
+    Cfg.cbRing = RT_MIN(RT_MAX(Cfg.cbRing, CAPTUREWRITER_RING_SIZE_MIN), CAPTUREWRITER_RING_SIZE_MAX);
+    if (!RT_IS_POWER_OF_TWO(Cfg.cbRing))
+        Cfg.cbRing = RT_BIT_32(ASMBitLastSetU32(Cfg.cbRing));
+    if (!Cfg.cRings)
+        Cfg.cRings = CAPTUREWRITER_RINGS_DEF;
+    Cfg.cRings = RT_MIN(Cfg.cRings, CAPTUREWRITER_RINGS_MAX);
+    if (!Cfg.cbWriteBuf)
+        Cfg.cbWriteBuf = CAPTUREWRITER_WRITE_BUF_DEF;
+    if (!Cfg.cMsFlushInterval)
+        Cfg.cMsFlushInterval = CAPTUREWRITER_FLUSH_INTERVAL_DEF;
+
+    PCAPTUREWRITERINT pThis = (PCAPTUREWRITERINT)RTMemAllocZ(RT_OFFSETOF(CAPTUREWRITERINT, aRings[Cfg.cRings]));
+    if (!pThis)
+        return VERR_NO_MEMORY;
+
+    pThis->hThread         = NIL_RTTHREAD;
+    pThis->hEvtWrite       = NIL_RTSEMEVENT;
+    pThis->hFile           = NIL_RTFILE;
+    pThis->fFlags          = fFlags;
+    pThis->Cfg             = Cfg;
+    pThis->fRingMask       = Cfg.cbRing - 1;
+    pThis->cbRingHighWater = Cfg.cbRing / 2;
+    pThis->cRings          = Cfg.cRings;
+
+    int rc = VINF_SUCCESS;
+    pThis->pszFilename = RTStrDup(pszFilename);
+    pThis->pbWriteBuf  = (uint8_t *)RTMemAlloc(Cfg.cbWriteBuf);
+    if (cbHdr)
+    {
+        pThis->pbHdr = (uint8_t *)RTMemDup(pvHdr, cbHdr);
+        pThis->cbHdr = cbHdr;
+    }
+    if (   !pThis->pszFilename
+        || !pThis->pbWriteBuf
+        || (cbHdr && !pThis->pbHdr))
+        rc = VERR_NO_MEMORY;
+    for (uint32_t i = 0; i < pThis->cRings && RT_SUCCESS(rc); i++)
+    {
+        pThis->aRings[i].pbBuf = (uint8_t *)RTMemAlloc(Cfg.cbRing);
+        if (!pThis->aRings[i].pbBuf)
+            rc = VERR_NO_MEMORY;
+    }
+
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTCritSectInit(&pThis->CritSectHdr);
+        if (RT_SUCCESS(rc))
+        {
+            rc = RTSemEventCreate(&pThis->hEvtWrite);
+            if (RT_SUCCESS(rc))
+            {
+                rc = captureWriterFileOpen(pThis);
+                if (RT_SUCCESS(rc))
+                {
+                    rc = RTThreadCreate(&pThis->hThread, captureWriterThread, pThis, 0, RTTHREADTYPE_IO,
+                                        RTTHREADFLAGS_WAITABLE, "CaptureWr");
+                    if (RT_SUCCESS(rc))
+                    {
+                        *phWriter = pThis;
+                        return VINF_SUCCESS;
+                    }
+
+                    RTFileClose(pThis->hFile);
+                    RTFileDelete(pThis->pszFilename);
+                }
+                RTSemEventDestroy(pThis->hEvtWrite);
+            }
+            RTCritSectDelete(&pThis->CritSectHdr);
+        }
+    }
+
+    for (uint32_t i = 0; i < pThis->cRings; i++)
+        RTMemFree(pThis->aRings[i].pbBuf);
+    RTMemFree(pThis->pbHdr);
+    RTMemFree(pThis->pbWriteBuf);
+    RTStrFree(pThis->pszFilename);
+    RTMemFree(pThis);
+    return rc;
+}
+
+
+DECLHIDDEN(void) CaptureWriterDestroy(CAPTUREWRITER hWriter)
+{
+    PCAPTUREWRITERINT pThis = hWriter;
+    AssertPtrReturnVoid(pThis);
+
+    ASMAtomicWriteBool(&pThis->fShutdown, true);
+    RTSemEventSignal(pThis->hEvtWrite);
+    int rc = RTThreadWait(pThis->hThread, RT_INDEFINITE_WAIT, NULL);
+    AssertRC(rc);
+
+    if (pThis->Stats.cRecordsDropped || pThis->Stats.cWriteErrors)
+        LogRel(("CaptureWriter: '%s': %RU64 records (%RU64 bytes) dropped (%RU64 too big, %RU64 rings busy), %RU64 write errors\n",
+                pThis->pszFilename, pThis->Stats.cRecordsDropped, pThis->Stats.cbDropped, pThis->Stats.cRecordsTooBig,
+                pThis->Stats.cRingsBusy, pThis->Stats.cWriteErrors));
+
+    if (pThis->hFile != NIL_RTFILE)
+        RTFileClose(pThis->hFile);
+    RTSemEventDestroy(pThis->hEvtWrite);
+    RTCritSectDelete(&pThis->CritSectHdr);
+
+    for (uint32_t i = 0; i < pThis->cRings; i++)
+        RTMemFree(pThis->aRings[i].pbBuf);
+    RTMemFree(pThis->pbHdrPending);
+    RTMemFree(pThis->pbHdr);
+    RTMemFree(pThis->pbWriteBuf);
+    RTStrFree(pThis->pszFilename);
+    RTMemFree(pThis);
+}
+
+
+DECLHIDDEN(int) CaptureWriterSetFileHeader(CAPTUREWRITER hWriter, const void *pvHdr, size_t cbHdr)
+{
+    PCAPTUREWRITERINT pThis = hWriter;
+    AssertPtrReturn(pThis, VERR_INVALID_HANDLE);
+    AssertReturn(!cbHdr || VALID_PTR(pvHdr), VERR_INVALID_POINTER);
+
+    uint8_t *pbHdr = NULL;
+    if (cbHdr)
+    {
+        pbHdr = (uint8_t *)RTMemDup(pvHdr, cbHdr);
+        if (!pbHdr)
+            return VERR_NO_MEMORY;
+    }
+
+    RTCritSectEnter(&pThis->CritSectHdr);
+    RTMemFree(pThis->pbHdrPending);
+    pThis->pbHdrPending = pbHdr;
+    pThis->cbHdrPending = cbHdr;
+    ASMAtomicWriteBool(&pThis->fHdrChanged, true);
+    RTCritSectLeave(&pThis->CritSectHdr);
+    return VINF_SUCCESS;
+}
+
+
+DECLHIDDEN(int) CaptureWriterSubmitSg(CAPTUREWRITER hWriter, uint64_t uTimestamp, PCRTSGSEG paSegs, unsigned cSegs)
+{
+    PCAPTUREWRITERINT pThis = hWriter;
+    AssertPtrReturn(pThis, VERR_INVALID_HANDLE);
+
+    size_t cbData = 0;
+    for (unsigned i = 0; i < cSegs; i++)
+        cbData += paSegs[i].cbSeg;
+
+    /* A record must leave room for others in the ring, anything bigger can never be queued. */
+    if (RT_UNLIKELY(cbData + sizeof(CAPTUREWRITERREC) > pThis->Cfg.cbRing / 2))
+    {
+        ASMAtomicIncU64(&pThis->Stats.cRecordsTooBig);
+        captureWriterRecordDropped(pThis, cbData);
+        return VERR_BUFFER_OVERFLOW;
+    }
+    uint32_t const cbRec = RT_ALIGN_32((uint32_t)(sizeof(CAPTUREWRITERREC) + cbData), CAPTUREWRITER_REC_ALIGN);
+
+    PCAPTUREWRITERRING pRing = captureWriterRingClaim(pThis);
+    if (RT_UNLIKELY(!pRing))
+    {
+        ASMAtomicIncU64(&pThis->Stats.cRingsBusy);
+        captureWriterRecordDropped(pThis, cbData);
+        return VERR_TRY_AGAIN;
+    }
+
+    /*
+     * Check for space, accounting for the padding record required when the
+     * record doesn't fit in before the end of the ring.
+     */
+    uint32_t const offWrite = pRing->offWrite;
+    uint32_t const cbUsed   = offWrite - ASMAtomicReadU32(&pRing->offRead);
+    uint32_t const offBuf   = offWrite & pThis->fRingMask;
+    uint32_t const cbToEnd  = pThis->Cfg.cbRing - offBuf;
+    uint32_t const cbPad    = cbToEnd < cbRec ? cbToEnd : 0;
+    if (RT_UNLIKELY(cbUsed + cbPad + cbRec > pThis->Cfg.cbRing))
+    {
+        ASMAtomicWriteBool(&pRing->fBusy, false);
+        captureWriterRecordDropped(pThis, cbData);
+        if (ASMAtomicXchgBool(&pThis->fWaiting, false))
+            RTSemEventSignal(pThis->hEvtWrite);
+        return VERR_BUFFER_OVERFLOW;
+    }
+
+    uint32_t offRec = offWrite;
+    if (cbPad)
+    {
+        PCAPTUREWRITERREC pPad = (PCAPTUREWRITERREC)&pRing->pbBuf[offBuf];
+        pPad->cbRec  = cbPad; /* Only the first two members fit in at the very end of the ring. */
+        pPad->fFlags = CAPTUREWRITER_REC_F_PAD;
+        offRec += cbPad;
+    }
+
+    PCAPTUREWRITERREC pRec = (PCAPTUREWRITERREC)&pRing->pbBuf[offRec & pThis->fRingMask];
+    pRec->cbRec       = cbRec;
+    pRec->fFlags      = 0;
+    pRec->cbData      = (uint32_t)cbData;
+    pRec->u32Reserved = 0;
+    pRec->uTimestamp  = uTimestamp;
+    uint8_t *pbDst = (uint8_t *)(pRec + 1);
+    for (unsigned i = 0; i < cSegs; i++)
+    {
+        memcpy(pbDst, paSegs[i].pvSeg, paSegs[i].cbSeg);
+        pbDst += paSegs[i].cbSeg;
+    }
+
+    /* Publish the record (the atomic write orders the stores above) and release the ring. */
+    ASMAtomicWriteU32(&pRing->offWrite, offRec + cbRec);
+    ASMAtomicWriteBool(&pRing->fBusy, false);
+    ASMAtomicIncU64(&pThis->Stats.cRecords);
+
+    /* Only kick the writer when the ring fills up, the flush interval takes care of the rest. */
+    if (   cbUsed + cbPad + cbRec >= pThis->cbRingHighWater
+        && ASMAtomicXchgBool(&pThis->fWaiting, false))
+        RTSemEventSignal(pThis->hEvtWrite);
+
+    return VINF_SUCCESS;
+}
+
+
+DECLHIDDEN(int) CaptureWriterSubmit(CAPTUREWRITER hWriter, uint64_t uTimestamp, const void *pvRecord, size_t cbRecord)
+{
+    RTSGSEG Seg;
+    Seg.pvSeg = (void *)pvRecord;
+    Seg.cbSeg = cbRecord;
+    return CaptureWriterSubmitSg(hWriter, uTimestamp, &Seg, 1);
+}
+
+
+DECLHIDDEN(PCCAPTUREWRITERSTATS) CaptureWriterGetStats(CAPTUREWRITER hWriter)
+{
+    PCAPTUREWRITERINT pThis = hWriter;
+    AssertPtrReturn(pThis, NULL);
+    return &pThis->Stats;
+}
+
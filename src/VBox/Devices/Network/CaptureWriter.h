@@ -0,0 +1,185 @@
+/* $Id$ */
+/** @file
+ * Asynchronous capture file writer shared by the network and USB sniffers.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#ifndef ___CaptureWriter_h
+#define ___CaptureWriter_h
+
+#include <VBox/cdefs.h>
+#include <VBox/types.h>
+#include <iprt/sg.h>
+
+RT_C_DECLS_BEGIN
+
+/**
+ * Opaque capture writer handle.
+ */
+typedef struct CAPTUREWRITERINT *CAPTUREWRITER;
+/** Pointer to a capture writer handle. */
+typedef CAPTUREWRITER *PCAPTUREWRITER;
+
+/** NIL capture writer handle. */
+#define NIL_CAPTUREWRITER ((CAPTUREWRITER)0)
+
+/** Capture writer creation flags.
+ * @{ */
+/** Default flags. */
+#define CAPTUREWRITER_F_DEFAULT    0
+/** Don't overwrite any existing capture file. */
+#define CAPTUREWRITER_F_NO_REPLACE RT_BIT_32(0)
+/** Mask of valid flags. */
+#define CAPTUREWRITER_F_VALID_MASK UINT32_C(0x00000001)
+/** @} */
+
+/**
+ * Capture writer configuration.
+ *
+ * Zero members select the defaults.
+ */
+typedef struct CAPTUREWRITERCFG
+{
+    /** Size of each producer ring in bytes, rounded up to a power of two. */
+    uint32_t        cbRing;
+    /** Number of producer rings. */
+    uint32_t        cRings;
+    /** Size of the buffer the writer thread batches file writes in. */
+    uint32_t        cbWriteBuf;
+    /** Interval in milliseconds the writer thread flushes pending records at. */
+    uint32_t        cMsFlushInterval;
+    /** Start a new file when the current one would grow beyond this size, 0 for no size rotation. */
+    uint64_t        cbRotateSize;
+    /** Start a new file after this many seconds, 0 for no time based rotation. */
+    uint32_t        cSecsRotate;
+    /** Padding. */
+    uint32_t        u32Padding;
+} CAPTUREWRITERCFG;
+/** Pointer to a capture writer configuration. */
+typedef CAPTUREWRITERCFG *PCAPTUREWRITERCFG;
+/** Pointer to a const capture writer configuration. */
+typedef const CAPTUREWRITERCFG *PCCAPTUREWRITERCFG;
+
+/**
+ * Capture writer statistics.
+ *
+ * The members are updated live and may be registered directly as
+ * STAMTYPE_U64 samples.
+ */
+typedef struct CAPTUREWRITERSTATS
+{
+    /** Number of records submitted successfully. */
+    uint64_t        cRecords;
+    /** Number of records dropped for any reason. */
+    uint64_t        cRecordsDropped;
+    /** Number of bytes dropped for any reason. */
+    uint64_t        cbDropped;
+    /** Number of records dropped because they don't fit into a producer ring. */
+    uint64_t        cRecordsTooBig;
+    /** Number of records dropped because all producer rings were in use. */
+    uint64_t        cRingsBusy;
+    /** Number of bytes written to the capture files. */
+    uint64_t        cbWritten;
+    /** Number of file writes done by the writer thread. */
+    uint64_t        cWrites;
+    /** Number of failed file writes. */
+    uint64_t        cWriteErrors;
+    /** Number of times a new capture file was started. */
+    uint64_t        cRotations;
+} CAPTUREWRITERSTATS;
+/** Pointer to capture writer statistics. */
+typedef CAPTUREWRITERSTATS *PCAPTUREWRITERSTATS;
+/** Pointer to const capture writer statistics. */
+typedef const CAPTUREWRITERSTATS *PCCAPTUREWRITERSTATS;
+
+/**
+ * Creates a new capture writer dumping to the given file.
+ *
+ * @returns VBox status code.
+ * @param   phWriter        Where to store the handle to the writer on success.
+ * @param   pszFilename     The capture file name.  When rotating, the following
+ *                          files get a sequence number appended to the name
+ *                          before the suffix.
+ * @param   fFlags          Combination of CAPTUREWRITER_F_*.
+ * @param   pCfg            The configuration to use, NULL for the defaults.
+ * @param   pvHdr           The file header to write at the start of every
+ *                          capture file, optional.
+ * @param   cbHdr           Size of the file header in bytes.
+ */
+DECLHIDDEN(int) CaptureWriterCreate(PCAPTUREWRITER phWriter, const char *pszFilename, uint32_t fFlags,
+                                    PCCAPTUREWRITERCFG pCfg, const void *pvHdr, size_t cbHdr);
+
+/**
+ * Flushes all pending records, stops the writer thread and destroys the writer.
+ *
+ * @returns nothing.
+ * @param   hWriter         The writer to destroy.
+ */
+DECLHIDDEN(void) CaptureWriterDestroy(CAPTUREWRITER hWriter);
+
+/**
+ * Replaces the file header written at the start of every capture file.
+ *
+ * The current file is not touched, the header applies to the files created
+ * by subsequent rotations.
+ *
+ * @returns VBox status code.
+ * @param   hWriter         The writer handle.
+ * @param   pvHdr           The new file header.
+ * @param   cbHdr           Size of the file header in bytes.
+ */
+DECLHIDDEN(int) CaptureWriterSetFileHeader(CAPTUREWRITER hWriter, const void *pvHdr, size_t cbHdr);
+
+/**
+ * Queues one record for writing, gathering it from the given segments.
+ *
+ * This never blocks and never waits for other producers.  The record is dropped
+ * and accounted for in the statistics if it is larger than half a producer
+ * ring, if all producer rings are in use by other threads, or if the claimed
+ * ring has no room for it.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_BUFFER_OVERFLOW if the record was dropped because it is too big
+ *          or the ring is full.
+ * @retval  VERR_TRY_AGAIN if the record was dropped because all rings were busy.
+ * @param   hWriter         The writer handle.
+ * @param   uTimestamp      Timestamp of the record, used to merge the records
+ *                          of different producers in order.
+ * @param   paSegs          The segments making up the record.
+ * @param   cSegs           Number of segments.
+ */
+DECLHIDDEN(int) CaptureWriterSubmitSg(CAPTUREWRITER hWriter, uint64_t uTimestamp, PCRTSGSEG paSegs, unsigned cSegs);
+
+/**
+ * Queues one record for writing.
+ *
+ * @returns VBox status code.
+ * @param   hWriter         The writer handle.
+ * @param   uTimestamp      Timestamp of the record.
+ * @param   pvRecord        The record data.
+ * @param   cbRecord        Size of the record in bytes.
+ */
+DECLHIDDEN(int) CaptureWriterSubmit(CAPTUREWRITER hWriter, uint64_t uTimestamp, const void *pvRecord, size_t cbRecord);
+
+/**
+ * Returns the live statistics of the given writer.
+ *
+ * @returns Pointer to the statistics, valid until the writer is destroyed.
+ * @param   hWriter         The writer handle.
+ */
+DECLHIDDEN(PCCAPTUREWRITERSTATS) CaptureWriterGetStats(CAPTUREWRITER hWriter);
+
+RT_C_DECLS_END
+
+#endif /* !___CaptureWriter_h */
@@ -65,10 +65,10 @@ typedef struct DRVNETSNIFFER
     PPDMINETWORKUP          pIBelowNet;
     /** The filename. */
     char                    szFilename[RTPATH_MAX];
-    /** The filehandle. */
-    RTFILE                  hFile;
-    /** The lock serializing the file access. */
-    RTCRITSECT              Lock;
+    /** The asynchronous writer the captured frames are queued on. */
+    CAPTUREWRITER           hWriter;
+    /** Max number of bytes captured per frame (or GSO segment). */
+    uint32_t                cbSnapLen;
     /** The NanoTS delta we pass to the pcap writers. */
     uint64_t                StartNanoTS;
     /** Pointer to the driver instance. */
@@ -131,19 +131,17 @@ static DECLCALLBACK(int) drvNetSnifferUp_SendBuf(PPDMINETWORKUP pInterface, PPDM
     if (RT_UNLIKELY(!pThis->pIBelowNet))
         return VERR_NET_DOWN;
 
-    /* output to sniffer */
-    RTCritSectEnter(&pThis->Lock);
+    /* output to sniffer (queued, the writer thread does the file I/O) */
     if (!pSgBuf->pvUser)
-        PcapFileFrame(pThis->hFile, pThis->StartNanoTS,
-                      pSgBuf->aSegs[0].pvSeg,
-                      pSgBuf->cbUsed,
-                      RT_MIN(pSgBuf->cbUsed, pSgBuf->aSegs[0].cbSeg));
+        PcapWriterFrame(pThis->hWriter, pThis->StartNanoTS,
+                        pSgBuf->aSegs[0].pvSeg,
+                        pSgBuf->cbUsed,
+                        RT_MIN(RT_MIN(pSgBuf->cbUsed, pSgBuf->aSegs[0].cbSeg), pThis->cbSnapLen));
     else
-        PcapFileGsoFrame(pThis->hFile, pThis->StartNanoTS, (PCPDMNETWORKGSO)pSgBuf->pvUser,
-                         pSgBuf->aSegs[0].pvSeg,
-                         pSgBuf->cbUsed,
-                         RT_MIN(pSgBuf->cbUsed, pSgBuf->aSegs[0].cbSeg));
-    RTCritSectLeave(&pThis->Lock);
+        PcapWriterGsoFrame(pThis->hWriter, pThis->StartNanoTS, (PCPDMNETWORKGSO)pSgBuf->pvUser,
+                           pSgBuf->aSegs[0].pvSeg,
+                           pSgBuf->cbUsed,
+                           RT_MIN(RT_MIN(pSgBuf->cbUsed, pSgBuf->aSegs[0].cbSeg), pThis->cbSnapLen));
 
     return pThis->pIBelowNet->pfnSendBuf(pThis->pIBelowNet, pSgBuf, fOnWorkerThread);
 }
@@ -204,10 +202,8 @@ static DECLCALLBACK(int) drvNetSnifferDown_Receive(PPDMINETWORKDOWN pInterface,
 {
     PDRVNETSNIFFER pThis = RT_FROM_MEMBER(pInterface, DRVNETSNIFFER, INetworkDown);
 
-    /* output to sniffer */
-    RTCritSectEnter(&pThis->Lock);
-    PcapFileFrame(pThis->hFile, pThis->StartNanoTS, pvBuf, cb, cb);
-    RTCritSectLeave(&pThis->Lock);
+    /* output to sniffer (queued, the writer thread does the file I/O) */
+    PcapWriterFrame(pThis->hWriter, pThis->StartNanoTS, pvBuf, cb, RT_MIN(cb, pThis->cbSnapLen));
 
     /* pass up */
     int rc = pThis->pIAboveNet->pfnReceive(pThis->pIAboveNet, pvBuf, cb);
@@ -353,16 +349,24 @@ static DECLCALLBACK(void) drvNetSnifferDestruct(PPDMDRVINS pDrvIns)
     PDRVNETSNIFFER pThis = PDMINS_2_DATA(pDrvIns, PDRVNETSNIFFER);
     PDMDRV_CHECK_VERSIONS_RETURN_VOID(pDrvIns);
 
-    if (RTCritSectIsInitialized(&pThis->Lock))
-        RTCritSectDelete(&pThis->Lock);
-
     if (RTCritSectIsInitialized(&pThis->XmitLock))
         RTCritSectDelete(&pThis->XmitLock);
 
-    if (pThis->hFile != NIL_RTFILE)
+    if (pThis->hWriter != NIL_CAPTUREWRITER)
     {
-        RTFileClose(pThis->hFile);
-        pThis->hFile = NIL_RTFILE;
+        PCCAPTUREWRITERSTATS pStats = CaptureWriterGetStats(pThis->hWriter);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cRecords);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cRecordsDropped);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cbDropped);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cRecordsTooBig);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cRingsBusy);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cbWritten);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cWrites);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cWriteErrors);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cRotations);
+
+        CaptureWriterDestroy(pThis->hWriter);
+        pThis->hWriter = NIL_CAPTUREWRITER;
     }
 }
 
@@ -381,7 +385,7 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
      * Init the static parts.
      */
     pThis->pDrvIns                                  = pDrvIns;
-    pThis->hFile                                    = NIL_RTFILE;
+    pThis->hWriter                                  = NIL_CAPTUREWRITER;
     /* The pcap file *must* start at time offset 0,0. */
     pThis->StartNanoTS                              = RTTimeNanoTS() - RTTimeProgramNanoTS();
     /* IBase */
@@ -404,17 +408,19 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
     pThis->INetworkConfig.pfnSetLinkState           = drvNetSnifferDownCfg_SetLinkState;
 
     /*
-     * Create the locks.
+     * Create the lock.
      */
-    int rc = RTCritSectInit(&pThis->Lock);
-    AssertRCReturn(rc, rc);
-    rc = RTCritSectInit(&pThis->XmitLock);
+    int rc = RTCritSectInit(&pThis->XmitLock);
     AssertRCReturn(rc, rc);
 
     /*
      * Validate the config.
      */
-    if (!CFGMR3AreValuesValid(pCfg, "File\0"))
+    if (!CFGMR3AreValuesValid(pCfg, "File\0"
+                                    "SnapLen\0"
+                                    "RotateSize\0"
+                                    "RotateTime\0"
+                                    "RingSize\0"))
         return VERR_PDM_DRVINS_UNKNOWN_CFG_VALUES;
 
     if (CFGMR3GetFirstChild(pCfg))
@@ -438,6 +444,39 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
         return rc;
     }
 
+    /** @cfgm{SnapLen, uint32_t, 65535}
+     * The max number of bytes captured per frame, the rest is truncated. */
+    rc = CFGMR3QueryU32Def(pCfg, "SnapLen", &pThis->cbSnapLen, 0xffff);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc, N_("Configuration error: Failed to get the \"SnapLen\" value"));
+    if (!pThis->cbSnapLen)
+        pThis->cbSnapLen = 0xffff;
+
+    CAPTUREWRITERCFG WriterCfg;
+    RT_ZERO(WriterCfg);
+
+    /** @cfgm{RotateSize, uint64_t, 0}
+     * Start a new capture file when the current one exceeds the given size in
+     * bytes, 0 disables size based rotation. */
+    rc = CFGMR3QueryU64Def(pCfg, "RotateSize", &WriterCfg.cbRotateSize, 0);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc, N_("Configuration error: Failed to get the \"RotateSize\" value"));
+
+    /** @cfgm{RotateTime, uint32_t, 0}
+     * Start a new capture file every given number of seconds, 0 disables time
+     * based rotation. */
+    rc = CFGMR3QueryU32Def(pCfg, "RotateTime", &WriterCfg.cSecsRotate, 0);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc, N_("Configuration error: Failed to get the \"RotateTime\" value"));
+
+    /** @cfgm{RingSize, uint32_t, 256K}
+     * Size of each buffer ring the captured frames are queued in before the
+     * writer thread gets them to disk.  Frames are dropped (and counted) when
+     * the writer can't keep up. */
+    rc = CFGMR3QueryU32Def(pCfg, "RingSize", &WriterCfg.cbRing, 0);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc, N_("Configuration error: Failed to get the \"RingSize\" value"));
+
     /*
      * Query the network port interface.
      */
@@ -482,10 +521,10 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
     }
 
     /*
-     * Open output file / pipe.
+     * Open output file / pipe and start the writer thread.  This also writes
+     * the pcap header.
      */
-    rc = RTFileOpen(&pThis->hFile, pThis->szFilename,
-                    RTFILE_O_WRITE | RTFILE_O_CREATE_REPLACE | RTFILE_O_DENY_WRITE);
+    rc = PcapWriterCreate(&pThis->hWriter, pThis->szFilename, CAPTUREWRITER_F_DEFAULT, &WriterCfg, pThis->cbSnapLen);
     if (RT_FAILURE(rc))
         return PDMDrvHlpVMSetError(pDrvIns, rc, RT_SRC_POS,
                                    N_("Netsniffer cannot open '%s' for writing. The directory must exist and it must be writable for the current user"), pThis->szFilename);
@@ -499,12 +538,25 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
     else
         LogRel(("NetSniffer: Sniffing to '%s'\n", pThis->szFilename));
 
-    /*
-     * Write pcap header.
-     * Some time has gone by since capturing pThis->StartNanoTS so get the
-     * current time again.
-     */
-    PcapFileHdr(pThis->hFile, RTTimeNanoTS());
+    PCCAPTUREWRITERSTATS pStats = CaptureWriterGetStats(pThis->hWriter);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cRecords,        STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                           "Number of frames queued for capturing.", "/Drivers/NetSniffer%u/Frames", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cRecordsDropped, STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                           "Number of frames dropped.", "/Drivers/NetSniffer%u/FramesDropped", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cbDropped,       STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,
+                           "Number of bytes dropped.", "/Drivers/NetSniffer%u/BytesDropped", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cRecordsTooBig,  STAMTYPE_U64, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,
+                           "Number of frames dropped because they are larger than half a ring.", "/Drivers/NetSniffer%u/FramesTooBig", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cRingsBusy,      STAMTYPE_U64, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,
+                           "Number of frames dropped because all rings were in use.", "/Drivers/NetSniffer%u/RingsBusy", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cbWritten,       STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,
+                           "Number of bytes written to the capture files.", "/Drivers/NetSniffer%u/BytesWritten", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cWrites,         STAMTYPE_U64, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,
+                           "Number of file writes.", "/Drivers/NetSniffer%u/Writes", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cWriteErrors,    STAMTYPE_U64, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,
+                           "Number of failed file writes.", "/Drivers/NetSniffer%u/WriteErrors", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cRotations,      STAMTYPE_U64, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,
+                           "Number of times a new capture file was started.", "/Drivers/NetSniffer%u/Rotations", pDrvIns->iInstance);
 
     return VINF_SUCCESS;
 }
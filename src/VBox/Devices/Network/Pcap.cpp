@@ -25,6 +25,7 @@
 #include <iprt/stream.h>
 #include <iprt/time.h>
 #include <iprt/err.h>
+#include <iprt/string.h>
 #include <VBox/vmm/pdmnetinline.h>
 
 
@@ -76,9 +77,9 @@ static const char s_szDummyData[] = { 0, 0, 0, 0 };
 /**
  * Internal helper.
  */
-static void pcapCalcHeader(struct pcaprec_hdr *pHdr, uint64_t StartNanoTS, size_t cbFrame, size_t cbMax)
+static void pcapCalcHeaderEx(struct pcaprec_hdr *pHdr, uint64_t NowNanoTS, uint64_t StartNanoTS, size_t cbFrame, size_t cbMax)
 {
-    uint64_t u64TS = RTTimeNanoTS() - StartNanoTS;
+    uint64_t u64TS = NowNanoTS - StartNanoTS;
     pHdr->ts_sec   = (uint32_t)(u64TS / 1000000000);
     pHdr->ts_usec  = (uint32_t)((u64TS / 1000) % 1000000);
     pHdr->incl_len = (uint32_t)RT_MIN(cbFrame, cbMax);
@@ -86,6 +87,15 @@ static void pcapCalcHeader(struct pcaprec_hdr *pHdr, uint64_t StartNanoTS, size_
 }
 
 
+/**
+ * Internal helper.
+ */
+static void pcapCalcHeader(struct pcaprec_hdr *pHdr, uint64_t StartNanoTS, size_t cbFrame, size_t cbMax)
+{
+    pcapCalcHeaderEx(pHdr, RTTimeNanoTS(), StartNanoTS, cbFrame, cbMax);
+}
+
+
 /**
  * Internal helper.
  */
@@ -255,3 +265,115 @@ int PcapFileGsoFrame(RTFILE File, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
     return VINF_SUCCESS;
 }
 
+
+
+/**
+ * Creates an asynchronous capture writer for a pcap file and sets up the
+ * file header.
+ *
+ * @returns VBox status code, @see CaptureWriterCreate.
+ *
+ * @param   phWriter        Where to store the writer handle on success.
+ * @param   pszFilename     The capture file name.
+ * @param   fFlags          CAPTUREWRITER_F_XXX.
+ * @param   pCfg            The writer configuration, NULL for the defaults.
+ * @param   cbSnapLen       The max number of bytes captured per frame, used
+ *                          for the file header.  0 means 0xffff.
+ */
+int PcapWriterCreate(PCAPTUREWRITER phWriter, const char *pszFilename, uint32_t fFlags,
+                     PCCAPTUREWRITERCFG pCfg, uint32_t cbSnapLen)
+{
+    /* The file header followed by the dummy frame PcapFileHdr writes, at time offset 0. */
+    struct
+    {
+        pcaprec_hdr_init    Init;
+        struct pcaprec_hdr  Rec;
+        char                abData[sizeof(s_szDummyData)];
+    } Hdr;
+    Hdr.Init = s_Hdr;
+    if (cbSnapLen)
+        Hdr.Init.pcap.snaplen = cbSnapLen;
+    pcapCalcHeaderEx(&Hdr.Rec, 0, 0, 60, sizeof(s_szDummyData));
+    memcpy(Hdr.abData, s_szDummyData, sizeof(s_szDummyData));
+    AssertCompile(sizeof(Hdr) == sizeof(s_Hdr) + sizeof(struct pcaprec_hdr) + sizeof(s_szDummyData));
+
+    return CaptureWriterCreate(phWriter, pszFilename, fFlags, pCfg, &Hdr, sizeof(Hdr));
+}
+
+
+/**
+ * Queues a frame on a capture writer.
+ *
+ * @returns VBox status code, @see CaptureWriterSubmitSg.
+ *
+ * @param   hWriter         The capture writer.
+ * @param   StartNanoTS     What to subtract from the RTTimeNanoTS output.
+ * @param   pvFrame         The start of the frame.
+ * @param   cbFrame         The size of the frame.
+ * @param   cbMax           The max number of bytes to include in the file.
+ */
+int PcapWriterFrame(CAPTUREWRITER hWriter, uint64_t StartNanoTS, const void *pvFrame, size_t cbFrame, size_t cbMax)
+{
+    uint64_t const      NowNanoTS = RTTimeNanoTS();
+    struct pcaprec_hdr  Hdr;
+    pcapCalcHeaderEx(&Hdr, NowNanoTS, StartNanoTS, cbFrame, cbMax);
+
+    RTSGSEG aSegs[2];
+    aSegs[0].pvSeg = &Hdr;
+    aSegs[0].cbSeg = sizeof(Hdr);
+    aSegs[1].pvSeg = (void *)pvFrame;
+    aSegs[1].cbSeg = Hdr.incl_len;
+    return CaptureWriterSubmitSg(hWriter, NowNanoTS, &aSegs[0], RT_ELEMENTS(aSegs));
+}
+
+
+/**
+ * Queues a GSO frame on a capture writer, one record per segment.
+ *
+ * All segments are submitted even if one of them gets dropped, so each one
+ * shows up in the writer statistics.
+ *
+ * @returns VBox status code, @see CaptureWriterSubmitSg.  The status of the
+ *          last segment which failed.
+ *
+ * @param   hWriter         The capture writer.
+ * @param   StartNanoTS     What to subtract from the RTTimeNanoTS output.
+ * @param   pGso            Pointer to the GSO context.
+ * @param   pvFrame         The start of the GSO frame.
+ * @param   cbFrame         The size of the GSO frame.
+ * @param   cbSegMax        The max number of bytes to include in the file for
+ *                          each segment.
+ */
+int PcapWriterGsoFrame(CAPTUREWRITER hWriter, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
+                       const void *pvFrame, size_t cbFrame, size_t cbSegMax)
+{
+    uint64_t const NowNanoTS = RTTimeNanoTS();
+    struct pcaprec_hdr Hdr;
+    pcapCalcHeaderEx(&Hdr, NowNanoTS, StartNanoTS, 0, 0);
+
+    int             rcRet   = VINF_SUCCESS;
+    uint8_t const  *pbFrame = (uint8_t const *)pvFrame;
+    uint8_t         abHdrs[256];
+    uint32_t const  cSegs   = PDMNetGsoCalcSegmentCount(pGso, cbFrame);
+    for (uint32_t iSeg = 0; iSeg < cSegs; iSeg++)
+    {
+        uint32_t cbSegPayload, cbHdrs;
+        uint32_t offSegPayload = PDMNetGsoCarveSegment(pGso, pbFrame, cbFrame, iSeg, cSegs, abHdrs, &cbHdrs, &cbSegPayload);
+
+        pcapUpdateHeader(&Hdr, cbHdrs + cbSegPayload, cbSegMax);
+
+        RTSGSEG aSegs[3];
+        aSegs[0].pvSeg = &Hdr;
+        aSegs[0].cbSeg = sizeof(Hdr);
+        aSegs[1].pvSeg = abHdrs;
+        aSegs[1].cbSeg = RT_MIN(Hdr.incl_len, cbHdrs);
+        aSegs[2].pvSeg = (void *)(pbFrame + offSegPayload);
+        aSegs[2].cbSeg = Hdr.incl_len > cbHdrs ? Hdr.incl_len - cbHdrs : 0;
+        int rc = CaptureWriterSubmitSg(hWriter, NowNanoTS, &aSegs[0], RT_ELEMENTS(aSegs));
+        if (RT_FAILURE(rc))
+            rcRet = rc;
+    }
+
+    return rcRet;
+}
+
@@ -21,6 +21,8 @@
 #include <iprt/stream.h>
 #include <VBox/types.h>
 
+#include "CaptureWriter.h"
+
 RT_C_DECLS_BEGIN
 
 int PcapStreamHdr(PRTSTREAM pStream, uint64_t StartNanoTS);
@@ -33,6 +35,12 @@ int PcapFileFrame(RTFILE File, uint64_t StartNanoTS, const void *pvFrame, size_t
 int PcapFileGsoFrame(RTFILE File, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
                      const void *pvFrame, size_t cbFrame, size_t cbSegMax);
 
+int PcapWriterCreate(PCAPTUREWRITER phWriter, const char *pszFilename, uint32_t fFlags,
+                     PCCAPTUREWRITERCFG pCfg, uint32_t cbSnapLen);
+int PcapWriterFrame(CAPTUREWRITER hWriter, uint64_t StartNanoTS, const void *pvFrame, size_t cbFrame, size_t cbMax);
+int PcapWriterGsoFrame(CAPTUREWRITER hWriter, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
+                       const void *pvFrame, size_t cbFrame, size_t cbSegMax);
+
 RT_C_DECLS_END
 
 #endif
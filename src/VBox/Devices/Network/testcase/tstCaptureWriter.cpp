@@ -0,0 +1,412 @@
+/* $Id$ */
+/** @file
+ * Capture writer testcase.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "../CaptureWriter.h"
+
+#include <iprt/asm.h>
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/mem.h>
+#include <iprt/path.h>
+#include <iprt/process.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Number of producer threads in the concurrency test. */
+#define TST_THREADS             8
+/** Number of records each producer thread submits. */
+#define TST_RECORDS_PER_THREAD  4096
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Self describing test record, followed by cbRec - sizeof(TSTREC) filler bytes.
+ */
+typedef struct TSTREC
+{
+    /** Total size of the record. */
+    uint32_t    cbRec;
+    /** The producer. */
+    uint32_t    iProducer;
+    /** The sequence number within the producer. */
+    uint32_t    iSeq;
+    /** The filler byte value. */
+    uint32_t    bFiller;
+} TSTREC;
+
+/**
+ * Producer thread arguments.
+ */
+typedef struct TSTPRODUCER
+{
+    CAPTUREWRITER   hWriter;
+    uint32_t        iProducer;
+    uint32_t        cSubmitted;
+} TSTPRODUCER;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static RTTEST       g_hTest;
+/** The file header used by all tests. */
+static const char   g_szHdr[] = "tstCaptureWriter header";
+/** Set to start the producer threads at the same time. */
+static bool volatile g_fGo;
+
+
+/**
+ * Builds a test record.
+ *
+ * @returns Size of the record.
+ */
+static uint32_t tstRecBuild(uint8_t *pbBuf, uint32_t iProducer, uint32_t iSeq)
+{
+    uint32_t const cbRec = sizeof(TSTREC) + (iSeq * 7 + iProducer) % 200;
+    TSTREC *pRec = (TSTREC *)pbBuf;
+    pRec->cbRec     = cbRec;
+    pRec->iProducer = iProducer;
+    pRec->iSeq      = iSeq;
+    pRec->bFiller   = (uint8_t)(iSeq ^ iProducer);
+    memset(pRec + 1, (int)pRec->bFiller, cbRec - sizeof(TSTREC));
+    return cbRec;
+}
+
+
+/**
+ * Reads a capture file and checks the header.
+ *
+ * @returns Pointer to the file content, free with RTFileReadAllFree().  NULL on failure.
+ */
+static uint8_t *tstReadFile(const char *pszFile, size_t *pcb)
+{
+    void  *pv = NULL;
+    size_t cb = 0;
+    int rc = RTFileReadAll(pszFile, &pv, &cb);
+    RTTEST_CHECK_RC_OK_RET(g_hTest, rc, NULL);
+    if (   cb < sizeof(g_szHdr)
+        || memcmp(pv, g_szHdr, sizeof(g_szHdr)))
+    {
+        RTTestFailed(g_hTest, "%s: bad header (cb=%zu)", pszFile, cb);
+        RTFileReadAllFree(pv, cb);
+        return NULL;
+    }
+    *pcb = cb;
+    return (uint8_t *)pv;
+}
+
+
+/**
+ * Walks the records in a capture file, validating each.
+ *
+ * @returns Number of records, UINT32_MAX on corruption.
+ * @param   pbFile      The file content.
+ * @param   cbFile      The file size.
+ * @param   pabSeen     Bitmap of seen records indexed by producer * cRecsPerProducer + seq,
+ *                      optional.
+ * @param   cRecsPerProducer Number of records per producer.
+ * @param   fInOrder    Whether to require strictly ascending sequence numbers per producer.
+ */
+static uint32_t tstWalkRecords(const uint8_t *pbFile, size_t cbFile, void *pabSeen, uint32_t cRecsPerProducer, bool fInOrder)
+{
+    uint32_t aiNextSeq[TST_THREADS];
+    RT_ZERO(aiNextSeq);
+
+    uint32_t cRecs = 0;
+    size_t   off   = sizeof(g_szHdr);
+    while (off < cbFile)
+    {
+        TSTREC Rec;
+        if (cbFile - off < sizeof(Rec))
+        {
+            RTTestFailed(g_hTest, "truncated record header at %#zx", off);
+            return UINT32_MAX;
+        }
+        memcpy(&Rec, &pbFile[off], sizeof(Rec));
+        if (   Rec.cbRec < sizeof(Rec)
+            || Rec.cbRec > cbFile - off
+            || Rec.iProducer >= TST_THREADS
+            || Rec.iSeq >= cRecsPerProducer
+            || (uint8_t)Rec.bFiller != (uint8_t)(Rec.iSeq ^ Rec.iProducer))
+        {
+            RTTestFailed(g_hTest, "bad record at %#zx: cb=%u producer=%u seq=%u", off, Rec.cbRec, Rec.iProducer, Rec.iSeq);
+            return UINT32_MAX;
+        }
+        if (!ASMMemIsAllU8(&pbFile[off + sizeof(Rec)], Rec.cbRec - sizeof(Rec), (uint8_t)Rec.bFiller))
+        {
+            RTTestFailed(g_hTest, "record at %#zx has corrupted payload", off);
+            return UINT32_MAX;
+        }
+        if (fInOrder)
+        {
+            if (Rec.iSeq < aiNextSeq[Rec.iProducer])
+            {
+                RTTestFailed(g_hTest, "record %u/%u out of order", Rec.iProducer, Rec.iSeq);
+                return UINT32_MAX;
+            }
+            aiNextSeq[Rec.iProducer] = Rec.iSeq + 1;
+        }
+        if (pabSeen)
+        {
+            uint32_t const iBit = Rec.iProducer * cRecsPerProducer + Rec.iSeq;
+            if (ASMBitTestAndSet(pabSeen, iBit))
+            {
+                RTTestFailed(g_hTest, "record %u/%u written twice", Rec.iProducer, Rec.iSeq);
+                return UINT32_MAX;
+            }
+        }
+        off += Rec.cbRec;
+        cRecs++;
+    }
+    return cRecs;
+}
+
+
+static void tstBasic(const char *pszFile)
+{
+    RTTestSub(g_hTest, "Basic");
+
+    CAPTUREWRITERCFG Cfg;
+    RT_ZERO(Cfg);
+    Cfg.cbRing     = _64K;
+    Cfg.cbWriteBuf = _4K; /* Small, so the buffer gets flushed in between. */
+
+    CAPTUREWRITER hWriter;
+    RTTEST_CHECK_RC_OK_RETV(g_hTest, CaptureWriterCreate(&hWriter, pszFile, CAPTUREWRITER_F_DEFAULT, &Cfg,
+                                                         g_szHdr, sizeof(g_szHdr)));
+
+    /* A single producer sticks to one ring, so everything must come out in order. */
+    uint32_t const cRecs = 1000;
+    uint8_t  abRec[sizeof(TSTREC) + 256];
+    uint32_t cSubmitted = 0;
+    for (uint32_t iSeq = 0; iSeq < cRecs; iSeq++)
+    {
+        uint32_t cbRec = tstRecBuild(abRec, 0, iSeq);
+        int rc = CaptureWriterSubmit(hWriter, RTTimeNanoTS(), abRec, cbRec);
+        if (RT_SUCCESS(rc))
+            cSubmitted++;
+        else
+        {
+            RTTEST_CHECK_RC(g_hTest, rc, VERR_BUFFER_OVERFLOW);
+            RTThreadSleep(1);
+        }
+    }
+
+    /* A record which can never fit is dropped and accounted for as such. */
+    uint8_t *pbHuge = (uint8_t *)RTMemAllocZ(_64K);
+    RTTEST_CHECK_RETV(g_hTest, pbHuge != NULL);
+    RTTEST_CHECK_RC(g_hTest, CaptureWriterSubmit(hWriter, RTTimeNanoTS(), pbHuge, _64K), VERR_BUFFER_OVERFLOW);
+    RTMemFree(pbHuge);
+
+    PCCAPTUREWRITERSTATS pStats = CaptureWriterGetStats(hWriter);
+    RTTEST_CHECK(g_hTest, pStats->cRecords == cSubmitted);
+    RTTEST_CHECK(g_hTest, pStats->cRecordsTooBig == 1);
+    RTTEST_CHECK(g_hTest, pStats->cRecordsDropped == 1 + cRecs - cSubmitted);
+    RTTEST_CHECK(g_hTest, pStats->cRingsBusy == 0);
+    CaptureWriterDestroy(hWriter);
+
+    size_t   cbFile;
+    uint8_t *pbFile = tstReadFile(pszFile, &cbFile);
+    if (pbFile)
+    {
+        uint32_t cFound = tstWalkRecords(pbFile, cbFile, NULL, cRecs, true /*fInOrder*/);
+        RTTEST_CHECK_MSG(g_hTest, cFound == cSubmitted, (g_hTest, "cFound=%u cSubmitted=%u\n", cFound, cSubmitted));
+        RTFileReadAllFree(pbFile, cbFile);
+    }
+    RTFileDelete(pszFile);
+}
+
+
+static DECLCALLBACK(int) tstProducerThread(RTTHREAD hSelf, void *pvUser)
+{
+    RT_NOREF(hSelf);
+    TSTPRODUCER *pProducer = (TSTPRODUCER *)pvUser;
+    while (!ASMAtomicReadBool(&g_fGo))
+        RTThreadYield();
+
+    uint8_t abRec[sizeof(TSTREC) + 256];
+    for (uint32_t iSeq = 0; iSeq < TST_RECORDS_PER_THREAD; iSeq++)
+    {
+        uint32_t cbRec = tstRecBuild(abRec, pProducer->iProducer, iSeq);
+        int rc = CaptureWriterSubmit(pProducer->hWriter, RTTimeNanoTS(), abRec, cbRec);
+        if (RT_SUCCESS(rc))
+            pProducer->cSubmitted++;
+        else if (rc != VERR_BUFFER_OVERFLOW && rc != VERR_TRY_AGAIN)
+            RTTestFailed(g_hTest, "producer %u: CaptureWriterSubmit -> %Rrc", pProducer->iProducer, rc);
+    }
+    return VINF_SUCCESS;
+}
+
+
+static void tstConcurrent(const char *pszFile)
+{
+    RTTestSub(g_hTest, "Concurrent producers");
+
+    /* Fewer rings than producers, so some of them find all rings busy. */
+    CAPTUREWRITERCFG Cfg;
+    RT_ZERO(Cfg);
+    Cfg.cbRing = _16K;
+    Cfg.cRings = 2;
+
+    CAPTUREWRITER hWriter;
+    RTTEST_CHECK_RC_OK_RETV(g_hTest, CaptureWriterCreate(&hWriter, pszFile, CAPTUREWRITER_F_DEFAULT, &Cfg,
+                                                         g_szHdr, sizeof(g_szHdr)));
+
+    ASMAtomicWriteBool(&g_fGo, false);
+    TSTPRODUCER aProducers[TST_THREADS];
+    RTTHREAD    ahThreads[TST_THREADS];
+    for (uint32_t i = 0; i < TST_THREADS; i++)
+    {
+        aProducers[i].hWriter    = hWriter;
+        aProducers[i].iProducer  = i;
+        aProducers[i].cSubmitted = 0;
+        int rc = RTThreadCreateF(&ahThreads[i], tstProducerThread, &aProducers[i], 0, RTTHREADTYPE_DEFAULT,
+                                 RTTHREADFLAGS_WAITABLE, "Producer%u", i);
+        RTTEST_CHECK_RC_OK(g_hTest, rc);
+        if (RT_FAILURE(rc))
+            ahThreads[i] = NIL_RTTHREAD;
+    }
+    ASMAtomicWriteBool(&g_fGo, true);
+
+    uint32_t cSubmitted = 0;
+    for (uint32_t i = 0; i < TST_THREADS; i++)
+        if (ahThreads[i] != NIL_RTTHREAD)
+        {
+            RTTEST_CHECK_RC_OK(g_hTest, RTThreadWait(ahThreads[i], RT_INDEFINITE_WAIT, NULL));
+            cSubmitted += aProducers[i].cSubmitted;
+        }
+
+    /* Every record is either queued or accounted for as dropped. */
+    PCCAPTUREWRITERSTATS pStats = CaptureWriterGetStats(hWriter);
+    RTTEST_CHECK(g_hTest, pStats->cRecords == cSubmitted);
+    RTTEST_CHECK_MSG(g_hTest, pStats->cRecords + pStats->cRecordsDropped == TST_THREADS * TST_RECORDS_PER_THREAD,
+                     (g_hTest, "cRecords=%RU64 cRecordsDropped=%RU64\n", pStats->cRecords, pStats->cRecordsDropped));
+    RTTEST_CHECK(g_hTest, pStats->cRecordsTooBig == 0);
+    RTTestPrintf(g_hTest, RTTESTLVL_ALWAYS, "%RU64 records queued, %RU64 dropped (%RU64 rings busy)\n",
+                 pStats->cRecords, pStats->cRecordsDropped, pStats->cRingsBusy);
+    CaptureWriterDestroy(hWriter);
+
+    /* Every queued record must be in the file exactly once. */
+    size_t   cbFile;
+    uint8_t *pbFile = tstReadFile(pszFile, &cbFile);
+    if (pbFile)
+    {
+        void *pvSeen = RTMemAllocZ(TST_THREADS * TST_RECORDS_PER_THREAD / 8);
+        uint32_t cFound = tstWalkRecords(pbFile, cbFile, pvSeen, TST_RECORDS_PER_THREAD, false /*fInOrder*/);
+        RTTEST_CHECK_MSG(g_hTest, cFound == cSubmitted, (g_hTest, "cFound=%u cSubmitted=%u\n", cFound, cSubmitted));
+        RTMemFree(pvSeen);
+        RTFileReadAllFree(pbFile, cbFile);
+    }
+    RTFileDelete(pszFile);
+}
+
+
+static void tstRotate(const char *pszBase, const char *pszSuffix)
+{
+    RTTestSub(g_hTest, "Size based rotation");
+
+    char szFile[RTPATH_MAX];
+    RTStrPrintf(szFile, sizeof(szFile), "%s%s", pszBase, pszSuffix);
+
+    CAPTUREWRITERCFG Cfg;
+    RT_ZERO(Cfg);
+    Cfg.cbWriteBuf   = _1K;
+    Cfg.cbRotateSize = _4K;
+
+    CAPTUREWRITER hWriter;
+    RTTEST_CHECK_RC_OK_RETV(g_hTest, CaptureWriterCreate(&hWriter, szFile, CAPTUREWRITER_F_DEFAULT, &Cfg,
+                                                         g_szHdr, sizeof(g_szHdr)));
+
+    uint32_t const cRecs = 256;
+    uint8_t abRec[sizeof(TSTREC) + 256];
+    for (uint32_t iSeq = 0; iSeq < cRecs; iSeq++)
+    {
+        uint32_t cbRec = tstRecBuild(abRec, 0, iSeq);
+        RTTEST_CHECK_RC_OK(g_hTest, CaptureWriterSubmit(hWriter, RTTimeNanoTS(), abRec, cbRec));
+        if (!(iSeq % 16))
+            RTThreadSleep(2); /* Let the writer thread catch up. */
+    }
+    RTTEST_CHECK(g_hTest, CaptureWriterGetStats(hWriter)->cRecordsDropped == 0);
+    CaptureWriterDestroy(hWriter);
+
+    /* Each file starts with the header, the records continue in order across the files. */
+    uint32_t cFound = 0;
+    uint32_t cFiles = 0;
+    for (uint32_t iFile = 0; ; iFile++)
+    {
+        if (iFile)
+            RTStrPrintf(szFile, sizeof(szFile), "%s-%u%s", pszBase, iFile, pszSuffix);
+        if (!RTFileExists(szFile))
+            break;
+        cFiles++;
+
+        size_t   cbFile;
+        uint8_t *pbFile = tstReadFile(szFile, &cbFile);
+        if (pbFile)
+        {
+            RTTEST_CHECK_MSG(g_hTest, cbFile <= Cfg.cbRotateSize + Cfg.cbWriteBuf,
+                             (g_hTest, "%s: cbFile=%zu\n", szFile, cbFile));
+            uint32_t cRecsFile = tstWalkRecords(pbFile, cbFile, NULL, cRecs, true /*fInOrder*/);
+            if (cRecsFile != UINT32_MAX)
+                cFound += cRecsFile;
+            RTFileReadAllFree(pbFile, cbFile);
+        }
+        RTFileDelete(szFile);
+    }
+    RTTEST_CHECK_MSG(g_hTest, cFiles > 1, (g_hTest, "cFiles=%u\n", cFiles));
+    RTTEST_CHECK_MSG(g_hTest, cFound == cRecs, (g_hTest, "cFound=%u\n", cFound));
+}
+
+
+int main()
+{
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstCaptureWriter", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    char szBase[RTPATH_MAX];
+    int rc = RTPathTemp(szBase, sizeof(szBase));
+    if (RT_SUCCESS(rc))
+        rc = RTPathAppend(szBase, sizeof(szBase), "tstCaptureWriter");
+    if (RT_FAILURE(rc))
+    {
+        RTTestFailed(g_hTest, "Failed to construct the temporary file name: %Rrc", rc);
+        return RTTestSummaryAndDestroy(g_hTest);
+    }
+    RTStrPrintf(&szBase[strlen(szBase)], sizeof(szBase) - strlen(szBase), "-%u", (unsigned)RTProcSelf());
+
+    char szFile[RTPATH_MAX];
+    RTStrPrintf(szFile, sizeof(szFile), "%s.pcap", szBase);
+    tstBasic(szFile);
+    tstConcurrent(szFile);
+    tstRotate(szBase, ".pcap");
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
@@ -263,6 +263,10 @@ typedef struct AHCIREQ
     bool                       fMapped;
     /** Page lock when the buffer is mapped. */
     PGMPAGEMAPLOCK             PgLck;
+#ifdef VBOX_WITH_STATISTICS
+    /** Nanosecond timestamp of when the command was fetched from the guest. */
+    uint64_t                   tsStart;
+#endif
 } AHCIREQ;
 
 /**
@@ -435,11 +439,18 @@ typedef struct AHCIPort
 
     uint32_t                        u32Alignment5;
 
+#ifdef VBOX_WITH_STATISTICS
+    /** Statistics: Command latency from fetching the command to completion. */
+    STAMHISTOGRAM                   StatReqLatency;
+#endif
 } AHCIPort;
 /** Pointer to the state of an AHCI port. */
 typedef AHCIPort *PAHCIPort;
 
 AssertCompileSizeAlignment(AHCIPort, 8);
+#ifdef VBOX_WITH_STATISTICS
+AssertCompileMemberAlignment(AHCIPort, StatReqLatency, 8);
+#endif
 
 /**
  * Main AHCI device state.
@@ -3641,6 +3652,9 @@ static PAHCIREQ ahciR3ReqAlloc(PAHCIPort pAhciPort, uint32_t uTag)
     {
         pAhciReq->hIoReq  = hIoReq;
         pAhciReq->fMapped = false;
+#ifdef VBOX_WITH_STATISTICS
+        pAhciReq->tsStart = RTTimeNanoTS();
+#endif
     }
     else
         pAhciReq = NULL;
@@ -3689,6 +3703,8 @@ static bool ahciTransferComplete(PAHCIPort pAhciPort, PAHCIREQ pAhciReq, int rcR
 
     if (rcReq != VERR_PDM_MEDIAEX_IOREQ_CANCELED)
     {
+        STAM_HISTOGRAM_ADD_SAMPLE(&pAhciPort->StatReqLatency, RTTimeNanoTS() - pAhciReq->tsStart);
+
         if (pAhciReq->enmType == PDMMEDIAEXIOREQTYPE_READ)
             pAhciPort->Led.Actual.s.fReading = 0;
         else if (pAhciReq->enmType == PDMMEDIAEXIOREQTYPE_WRITE)
@@ -4655,6 +4671,9 @@ static DECLCALLBACK(int) ahciAsyncIOLoop(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
                 Req.cbTransfer = 0;
                 Req.uOffset    = 0;
                 Req.enmType    = PDMMEDIAEXIOREQTYPE_INVALID;
+#ifdef VBOX_WITH_STATISTICS
+                Req.tsStart    = RTTimeNanoTS();
+#endif
 
                 bool fContinue = ahciR3CmdPrepare(pAhciPort, &Req);
                 if (fContinue)
@@ -6034,6 +6053,12 @@ static DECLCALLBACK(int) ahciR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
         pAhciPort->IPort.pfnQueryDeviceLocation            = ahciR3PortQueryDeviceLocation;
         pAhciPort->fWrkThreadSleeping                      = true;
 
+#ifdef VBOX_WITH_STATISTICS
+        PDMDevHlpSTAMRegisterF(pDevIns, &pAhciPort->StatReqLatency, STAMTYPE_HISTOGRAM, STAMVISIBILITY_USED, STAMUNIT_NS,
+                               "Latency of commands from fetching to completion.", "/Devices/AHCI%d/Port%u/ReqLatency",
+                               iInstance, i);
+#endif
+
         /* Query per port configuration options if available. */
         PCFGMNODE pCfgPort = CFGMR3GetChild(pDevIns->pCfg, szName);
         if (pCfgPort)
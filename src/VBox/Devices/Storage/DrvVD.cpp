@@ -189,6 +189,8 @@ typedef struct PDMMEDIAEXIOREQINT
     uint32_t                      fFlags;
     /** Timestamp when the request was submitted. */
     uint64_t                      tsSubmit;
+    /** Nanosecond timestamp when the request was submitted, for the latency statistics. */
+    uint64_t                      tsSubmitNs;
     /** Type dependent data. */
     union
     {
@@ -438,6 +440,12 @@ typedef struct VBOXDISK
     STAMCOUNTER              StatReqsDiscard;
     /** Release statistics: Number of I/O requests processed per second. */
     STAMCOUNTER              StatReqsPerSec;
+    /** Release statistics: Completion latency of read requests. */
+    STAMHISTOGRAM            StatReqLatencyRead;
+    /** Release statistics: Completion latency of write requests. */
+    STAMHISTOGRAM            StatReqLatencyWrite;
+    /** Release statistics: Completion latency of flush requests. */
+    STAMHISTOGRAM            StatReqLatencyFlush;
     /** @} */
 } VBOXDISK;
 
@@ -2820,11 +2828,33 @@ static void drvvdMediaExIoReqRetire(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT pIoReq,
     ASMAtomicXchgU32((volatile uint32_t *)&pIoReq->enmState, VDIOREQSTATE_COMPLETED);
     drvvdMediaExIoReqBufFree(pThis, pIoReq);
 
+    /*
+     * Record the completion latency.
+     */
+    uint64_t const tsNowNs = RTTimeNanoTS();
+    if (rcReq != VERR_PDM_MEDIAEX_IOREQ_CANCELED)
+    {
+        switch (pIoReq->enmType)
+        {
+            case PDMMEDIAEXIOREQTYPE_READ:
+                STAM_REL_HISTOGRAM_ADD_SAMPLE(&pThis->StatReqLatencyRead, tsNowNs - pIoReq->tsSubmitNs);
+                break;
+            case PDMMEDIAEXIOREQTYPE_WRITE:
+                STAM_REL_HISTOGRAM_ADD_SAMPLE(&pThis->StatReqLatencyWrite, tsNowNs - pIoReq->tsSubmitNs);
+                break;
+            case PDMMEDIAEXIOREQTYPE_FLUSH:
+                STAM_REL_HISTOGRAM_ADD_SAMPLE(&pThis->StatReqLatencyFlush, tsNowNs - pIoReq->tsSubmitNs);
+                break;
+            default:
+                break;
+        }
+    }
+
     /*
      * Leave a release log entry if the request was active for more than 25 seconds
      * (30 seconds is the timeout of the guest).
      */
-    uint64_t tsNow = RTTimeMilliTS();
+    uint64_t tsNow = tsNowNs / RT_NS_1MS;
     if (tsNow - pIoReq->tsSubmit >= 25 * 1000)
     {
         const char *pcszReq = NULL;
@@ -3757,7 +3787,8 @@ static DECLCALLBACK(int) drvvdIoReqRead(PPDMIMEDIAEX pInterface, PDMMEDIAEXIOREQ
     STAM_REL_COUNTER_INC(&pThis->StatReqsRead);
 
     pIoReq->enmType             = PDMMEDIAEXIOREQTYPE_READ;
-    pIoReq->tsSubmit            = RTTimeMilliTS();
+    pIoReq->tsSubmitNs          = RTTimeNanoTS();
+    pIoReq->tsSubmit            = pIoReq->tsSubmitNs / RT_NS_1MS;
     pIoReq->ReadWrite.offStart  = off;
     pIoReq->ReadWrite.cbReq     = cbRead;
     pIoReq->ReadWrite.cbReqLeft = cbRead;
@@ -3799,7 +3830,8 @@ static DECLCALLBACK(int) drvvdIoReqWrite(PPDMIMEDIAEX pInterface, PDMMEDIAEXIORE
     STAM_REL_COUNTER_INC(&pThis->StatReqsWrite);
 
     pIoReq->enmType             = PDMMEDIAEXIOREQTYPE_WRITE;
-    pIoReq->tsSubmit            = RTTimeMilliTS();
+    pIoReq->tsSubmitNs          = RTTimeNanoTS();
+    pIoReq->tsSubmit            = pIoReq->tsSubmitNs / RT_NS_1MS;
     pIoReq->ReadWrite.offStart  = off;
     pIoReq->ReadWrite.cbReq     = cbWrite;
     pIoReq->ReadWrite.cbReqLeft = cbWrite;
@@ -3840,8 +3872,9 @@ static DECLCALLBACK(int) drvvdIoReqFlush(PPDMIMEDIAEX pInterface, PDMMEDIAEXIORE
     STAM_REL_COUNTER_INC(&pThis->StatReqsSubmitted);
     STAM_REL_COUNTER_INC(&pThis->StatReqsFlush);
 
-    pIoReq->enmType  = PDMMEDIAEXIOREQTYPE_FLUSH;
-    pIoReq->tsSubmit = RTTimeMilliTS();
+    pIoReq->enmType    = PDMMEDIAEXIOREQTYPE_FLUSH;
+    pIoReq->tsSubmitNs = RTTimeNanoTS();
+    pIoReq->tsSubmit   = pIoReq->tsSubmitNs / RT_NS_1MS;
     bool fXchg = ASMAtomicCmpXchgU32((volatile uint32_t *)&pIoReq->enmState, VDIOREQSTATE_ACTIVE, VDIOREQSTATE_ALLOCATED);
     if (RT_UNLIKELY(!fXchg))
     {
@@ -3891,8 +3924,9 @@ static DECLCALLBACK(int) drvvdIoReqDiscard(PPDMIMEDIAEX pInterface, PDMMEDIAEXIO
                                                                 &pIoReq->Discard.cRanges);
     if (RT_SUCCESS(rc))
     {
-        pIoReq->enmType  = PDMMEDIAEXIOREQTYPE_DISCARD;
-        pIoReq->tsSubmit = RTTimeMilliTS();
+        pIoReq->enmType    = PDMMEDIAEXIOREQTYPE_DISCARD;
+        pIoReq->tsSubmitNs = RTTimeNanoTS();
+        pIoReq->tsSubmit   = pIoReq->tsSubmitNs / RT_NS_1MS;
         bool fXchg = ASMAtomicCmpXchgU32((volatile uint32_t *)&pIoReq->enmState, VDIOREQSTATE_ACTIVE, VDIOREQSTATE_ALLOCATED);
         if (RT_UNLIKELY(!fXchg))
         {
@@ -4350,6 +4384,16 @@ static int drvvdStatsRegister(PVBOXDISK pThis)
                                    "Number of processed I/O requests per second.", "/Devices/%s%u/Port%u/ReqsPerSec",
                                    pszCtrlUpper, iInstance, iLUN);
 
+            PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReqLatencyRead, STAMTYPE_HISTOGRAM, STAMVISIBILITY_USED, STAMUNIT_NS,
+                                   "Completion latency of read I/O requests.", "/Devices/%s%u/Port%u/ReqLatencyRead",
+                                   pszCtrlUpper, iInstance, iLUN);
+            PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReqLatencyWrite, STAMTYPE_HISTOGRAM, STAMVISIBILITY_USED, STAMUNIT_NS,
+                                   "Completion latency of write I/O requests.", "/Devices/%s%u/Port%u/ReqLatencyWrite",
+                                   pszCtrlUpper, iInstance, iLUN);
+            PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReqLatencyFlush, STAMTYPE_HISTOGRAM, STAMVISIBILITY_USED, STAMUNIT_NS,
+                                   "Completion latency of flush I/O requests.", "/Devices/%s%u/Port%u/ReqLatencyFlush",
+                                   pszCtrlUpper, iInstance, iLUN);
+
             RTStrFree(pszCtrlUpper);
         }
         else
@@ -4382,6 +4426,9 @@ static void drvvdStatsDeregister(PVBOXDISK pThis)
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqsRead);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqsDiscard);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqsPerSec);
+    PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqLatencyRead);
+    PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqLatencyWrite);
+    PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqLatencyFlush);
 }
 
 /*********************************************************************************************************************************
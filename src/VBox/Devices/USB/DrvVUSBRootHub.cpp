@@ -264,7 +264,7 @@ static DECLCALLBACK(int) vusbPDMHubAttachDevice(PPDMDRVINS pDrvIns, PPDMUSBINS p
      */
     PVUSBDEV pDev = (PVUSBDEV)RTMemAllocZ(sizeof(*pDev));
     AssertReturn(pDev, VERR_NO_MEMORY);
-    int rc = vusbDevInit(pDev, pUsbIns, pszCaptureFilename);
+    int rc = vusbDevInit(pDev, pUsbIns, pszCaptureFilename, pThis->cbCaptureRing);
     if (RT_SUCCESS(rc))
     {
         pUsbIns->pvVUsbDev2 = pDev;
@@ -1206,7 +1206,14 @@ static DECLCALLBACK(void) vusbRhDestruct(PPDMDRVINS pDrvIns)
         pRh->Hub.pszName = NULL;
     }
     if (pRh->hSniffer != VUSBSNIFFER_NIL)
+    {
+        PCCAPTUREWRITERSTATS pStats = VUSBSnifferGetStats(pRh->hSniffer);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cRecordsDropped);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cbDropped);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cRecordsTooBig);
+        PDMDrvHlpSTAMDeregister(pDrvIns, (void *)&pStats->cbWritten);
         VUSBSnifferDestroy(pRh->hSniffer);
+    }
 
     if (pRh->hSemEventPeriodFrame)
         RTSemEventMultiDestroy(pRh->hSemEventPeriodFrame);
@@ -1233,7 +1240,7 @@ static DECLCALLBACK(int) vusbRhConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
     /*
      * Validate configuration.
      */
-    if (!CFGMR3AreValuesValid(pCfg, "CaptureFilename\0"))
+    if (!CFGMR3AreValuesValid(pCfg, "CaptureFilename\0" "CaptureRingSize\0"))
         return VERR_PDM_DRVINS_UNKNOWN_CFG_VALUES;
 
     /*
@@ -1257,6 +1264,15 @@ static DECLCALLBACK(int) vusbRhConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
         return PDMDrvHlpVMSetError(pDrvIns, rc, RT_SRC_POS,
                                    N_("Configuration error: Failed to query value of \"CaptureFilename\""));
 
+    /** @cfgm{CaptureRingSize, uint32_t, 1M}
+     * Size of each buffer ring the captured URBs of the root hub and of the
+     * attached devices are queued in before the writer thread gets them to
+     * disk.  URBs larger than half a ring are dropped (and counted). */
+    rc = CFGMR3QueryU32Def(pCfg, "CaptureRingSize", &pThis->cbCaptureRing, 0);
+    if (RT_FAILURE(rc))
+        return PDMDrvHlpVMSetError(pDrvIns, rc, RT_SRC_POS,
+                                   N_("Configuration error: Failed to query value of \"CaptureRingSize\""));
+
     /*
      * Initialize the data members.
      */
@@ -1326,13 +1342,24 @@ static DECLCALLBACK(int) vusbRhConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
 
     if (pszCaptureFilename)
     {
-        rc = VUSBSnifferCreate(&pThis->hSniffer, 0, pszCaptureFilename, NULL, NULL);
+        rc = VUSBSnifferCreate(&pThis->hSniffer, 0, pszCaptureFilename, NULL, NULL, pThis->cbCaptureRing);
         if (RT_FAILURE(rc))
             return PDMDrvHlpVMSetError(pDrvIns, rc, RT_SRC_POS,
                                        N_("VUSBSniffer cannot open '%s' for writing. The directory must exist and it must be writable for the current user"),
                                        pszCaptureFilename);
 
         MMR3HeapFree(pszCaptureFilename);
+
+        PCCAPTUREWRITERSTATS pStats = VUSBSnifferGetStats(pThis->hSniffer);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cRecordsDropped, STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                               "Number of captured URB events dropped.", "/VUSB/%d/Capture/EventsDropped", pDrvIns->iInstance);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cbDropped,       STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,
+                               "Number of captured bytes dropped.", "/VUSB/%d/Capture/BytesDropped", pDrvIns->iInstance);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cRecordsTooBig,  STAMTYPE_U64, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,
+                               "Number of captured URB events dropped because they are larger than half a ring.",
+                               "/VUSB/%d/Capture/EventsTooBig", pDrvIns->iInstance);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, (void *)&pStats->cbWritten,       STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,
+                               "Number of bytes written to the capture files.", "/VUSB/%d/Capture/BytesWritten", pDrvIns->iInstance);
     }
 
     /*
@@ -1750,8 +1750,9 @@ static DECLCALLBACK(int) vusbDevGetDescriptorCacheWorker(PPDMUSBINS pUsbIns, PCP
  * @param   pDev                  The VUSB device to initialize.
  * @param   pUsbIns               Pointer to the PDM USB Device instance.
  * @param   pszCaptureFilename    Optional fileame to capture the traffic to.
+ * @param   cbCaptureRing         Size of the capture writer rings, 0 for the default.
  */
-int vusbDevInit(PVUSBDEV pDev, PPDMUSBINS pUsbIns, const char *pszCaptureFilename)
+int vusbDevInit(PVUSBDEV pDev, PPDMUSBINS pUsbIns, const char *pszCaptureFilename, uint32_t cbCaptureRing)
 {
     /*
      * Initialize the device data members.
@@ -1816,7 +1817,7 @@ int vusbDevInit(PVUSBDEV pDev, PPDMUSBINS pUsbIns, const char *pszCaptureFilenam
 
     if (pszCaptureFilename)
     {
-        rc = VUSBSnifferCreate(&pDev->hSniffer, 0, pszCaptureFilename, NULL, NULL);
+        rc = VUSBSnifferCreate(&pDev->hSniffer, 0, pszCaptureFilename, NULL, NULL, cbCaptureRing);
         AssertRCReturn(rc, rc);
     }
 
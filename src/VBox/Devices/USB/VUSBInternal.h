@@ -288,7 +288,7 @@ typedef struct VUSBDEV
 AssertCompileSizeAlignment(VUSBDEV, 8);
 
 
-int vusbDevInit(PVUSBDEV pDev, PPDMUSBINS pUsbIns, const char *pszCaptureFilename);
+int vusbDevInit(PVUSBDEV pDev, PPDMUSBINS pUsbIns, const char *pszCaptureFilename, uint32_t cbCaptureRing);
 void vusbDevDestroy(PVUSBDEV pDev);
 
 DECLINLINE(bool) vusbDevIsRh(PVUSBDEV pDev)
@@ -410,6 +410,9 @@ typedef struct VUSBROOTHUB
 
     /** Sniffer instance for the root hub. */
     VUSBSNIFFER                hSniffer;
+    /** Size of the capture writer rings of the root hub and device sniffers,
+     * 0 for the default. */
+    uint32_t                   cbCaptureRing;
     /** Version of the attached Host Controller. */
     uint32_t                   fHcVersions;
     /** Size of the HCI specific data for each URB. */
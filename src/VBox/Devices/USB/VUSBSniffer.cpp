@@ -45,12 +45,19 @@
  */
 typedef struct VUSBSNIFFERINT
 {
-    /** The file handle to dump to. */
-    RTFILE            hFile;
+    /** The asynchronous writer the recorded events are queued on. */
+    CAPTUREWRITER     hWriter;
     /** Fast Mutex protecting the state against concurrent access. */
     RTSEMFASTMUTEX    hMtx;
     /** File stream. */
     VUSBSNIFFERSTRM   Strm;
+    /** Buffer collecting the output of the format writer for the current event
+     * so it gets queued as a single record. */
+    uint8_t          *pbEvt;
+    /** Number of bytes used in the event buffer. */
+    size_t            cbEvt;
+    /** Size of the event buffer. */
+    size_t            cbEvtMax;
     /** Pointer to the used format. */
     PCVUSBSNIFFERFMT  pFmt;
     /** Format specific state - variable in size. */
@@ -81,7 +88,20 @@ static DECLCALLBACK(int) vusbSnifferStrmWrite(PVUSBSNIFFERSTRM pStrm, const void
 {
     PVUSBSNIFFERINT pThis = RT_FROM_MEMBER(pStrm, VUSBSNIFFERINT, Strm);
 
-    return RTFileWrite(pThis->hFile, pvBuf, cbBuf, NULL);
+    /* Just collect the data, the whole event is queued on the writer when done. */
+    if (pThis->cbEvt + cbBuf > pThis->cbEvtMax)
+    {
+        size_t cbNew = RT_ALIGN_Z(pThis->cbEvt + cbBuf, _4K);
+        uint8_t *pbNew = (uint8_t *)RTMemRealloc(pThis->pbEvt, cbNew);
+        if (!pbNew)
+            return VERR_NO_MEMORY;
+        pThis->pbEvt    = pbNew;
+        pThis->cbEvtMax = cbNew;
+    }
+
+    memcpy(&pThis->pbEvt[pThis->cbEvt], pvBuf, cbBuf);
+    pThis->cbEvt += cbBuf;
+    return VINF_SUCCESS;
 }
 
 /**
@@ -134,7 +154,7 @@ static PCVUSBSNIFFERFMT vusbSnifferGetFmtFromFilename(const char *pszFilename)
 
 DECLHIDDEN(int) VUSBSnifferCreate(PVUSBSNIFFER phSniffer, uint32_t fFlags,
                                   const char *pszCaptureFilename, const char *pszFmt,
-                                  const char *pszDesc)
+                                  const char *pszDesc, uint32_t cbRing)
 {
     RT_NOREF(pszDesc);
     int rc = VINF_SUCCESS;
@@ -152,7 +172,7 @@ DECLHIDDEN(int) VUSBSnifferCreate(PVUSBSNIFFER phSniffer, uint32_t fFlags,
     pThis = (PVUSBSNIFFERINT)RTMemAllocZ(RT_OFFSETOF(VUSBSNIFFERINT, abFmt[pFmt->cbFmt]));
     if (pThis)
     {
-        pThis->hFile         = NIL_RTFILE;
+        pThis->hWriter       = NIL_CAPTUREWRITER;
         pThis->hMtx          = NIL_RTSEMFASTMUTEX;
         pThis->pFmt          = pFmt;
         pThis->Strm.pfnWrite = vusbSnifferStrmWrite;
@@ -160,30 +180,34 @@ DECLHIDDEN(int) VUSBSnifferCreate(PVUSBSNIFFER phSniffer, uint32_t fFlags,
         rc = RTSemFastMutexCreate(&pThis->hMtx);
         if (RT_SUCCESS(rc))
         {
-            uint32_t fFileFlags = RTFILE_O_DENY_NONE | RTFILE_O_WRITE | RTFILE_O_READ;
-            if (fFlags & VUSBSNIFFER_F_NO_REPLACE)
-                fFileFlags |= RTFILE_O_CREATE;
-            else
-                fFileFlags |= RTFILE_O_CREATE_REPLACE;
-
-            rc = RTFileOpen(&pThis->hFile, pszCaptureFilename, fFileFlags);
+            /* Whatever the format writes during init becomes the file header. */
+            rc = pThis->pFmt->pfnInit((PVUSBSNIFFERFMTINT)&pThis->abFmt[0], &pThis->Strm);
             if (RT_SUCCESS(rc))
             {
-                rc = pThis->pFmt->pfnInit((PVUSBSNIFFERFMTINT)&pThis->abFmt[0], &pThis->Strm);
+                uint32_t fWriterFlags = CAPTUREWRITER_F_DEFAULT;
+                if (fFlags & VUSBSNIFFER_F_NO_REPLACE)
+                    fWriterFlags |= CAPTUREWRITER_F_NO_REPLACE;
+
+                CAPTUREWRITERCFG WriterCfg;
+                RT_ZERO(WriterCfg);
+                WriterCfg.cbRing = cbRing ? cbRing : VUSBSNIFFER_RING_SIZE_DEF;
+
+                rc = CaptureWriterCreate(&pThis->hWriter, pszCaptureFilename, fWriterFlags, &WriterCfg,
+                                         pThis->pbEvt, pThis->cbEvt);
                 if (RT_SUCCESS(rc))
                 {
+                    pThis->cbEvt = 0;
                     *phSniffer = pThis;
                     return VINF_SUCCESS;
                 }
 
-                RTFileClose(pThis->hFile);
-                pThis->hFile = NIL_RTFILE;
-                RTFileDelete(pszCaptureFilename);
+                pThis->pFmt->pfnDestroy((PVUSBSNIFFERFMTINT)&pThis->abFmt[0]);
             }
             RTSemFastMutexDestroy(pThis->hMtx);
             pThis->hMtx = NIL_RTSEMFASTMUTEX;
         }
 
+        RTMemFree(pThis->pbEvt);
         RTMemFree(pThis);
     }
     else
@@ -207,11 +231,19 @@ DECLHIDDEN(void) VUSBSnifferDestroy(VUSBSNIFFER hSniffer)
 
     pThis->pFmt->pfnDestroy((PVUSBSNIFFERFMTINT)&pThis->abFmt[0]);
 
-    if (pThis->hFile != NIL_RTFILE)
-        RTFileClose(pThis->hFile);
+    /* Anything written by the format on destruction goes out last. */
+    if (pThis->cbEvt)
+        CaptureWriterSubmit(pThis->hWriter, RTTimeNanoTS(), pThis->pbEvt, pThis->cbEvt);
+
+    PCCAPTUREWRITERSTATS pStats = CaptureWriterGetStats(pThis->hWriter);
+    if (pStats->cRecordsDropped)
+        LogRel(("VUSB: The capture is missing %RU64 events (%RU64 bytes, %RU64 of them too big) the writer couldn't keep up with\n",
+                pStats->cRecordsDropped, pStats->cbDropped, pStats->cRecordsTooBig));
+    CaptureWriterDestroy(pThis->hWriter);
 
     RTSemFastMutexRelease(pThis->hMtx);
     RTSemFastMutexDestroy(pThis->hMtx);
+    RTMemFree(pThis->pbEvt);
     RTMemFree(pThis);
 }
 
@@ -228,14 +260,37 @@ DECLHIDDEN(int) VUSBSnifferRecordEvent(VUSBSNIFFER hSniffer, PVUSBURB pUrb, VUSB
     int rc = VINF_SUCCESS;
     PVUSBSNIFFERINT pThis = hSniffer;
 
-    /* Write the packet to the capture file. */
+    /* Format the event and queue it for writing, the file I/O happens on the writer thread. */
     rc = RTSemFastMutexRequest(pThis->hMtx);
     if (RT_SUCCESS(rc))
     {
+        pThis->cbEvt = 0;
         rc = pThis->pFmt->pfnRecordEvent((PVUSBSNIFFERFMTINT)&pThis->abFmt[0], pUrb, enmEvent);
+        if (RT_SUCCESS(rc) && pThis->cbEvt)
+        {
+            rc = CaptureWriterSubmit(pThis->hWriter, RTTimeNanoTS(), pThis->pbEvt, pThis->cbEvt);
+            /* Dropping events is what the writer does instead of stalling the
+               guest, they are counted in its statistics. */
+            if (   rc == VERR_BUFFER_OVERFLOW
+                || rc == VERR_TRY_AGAIN)
+                rc = VINF_SUCCESS;
+        }
+        pThis->cbEvt = 0;
         RTSemFastMutexRelease(pThis->hMtx);
     }
 
     return rc;
 }
 
+/**
+ * Returns the live capture writer statistics of the given sniffer.
+ *
+ * @returns Pointer to the statistics, valid until the sniffer is destroyed.
+ * @param   hSniffer              The sniffer instance.
+ */
+DECLHIDDEN(PCCAPTUREWRITERSTATS) VUSBSnifferGetStats(VUSBSNIFFER hSniffer)
+{
+    PVUSBSNIFFERINT pThis = hSniffer;
+    return CaptureWriterGetStats(pThis->hWriter);
+}
+
@@ -22,6 +22,8 @@
 #include <VBox/types.h>
 #include <VBox/vusb.h>
 
+#include "../Network/CaptureWriter.h"
+
 RT_C_DECLS_BEGIN
 
 /** Opaque VUSB sniffer handle. */
@@ -59,6 +61,11 @@ typedef enum VUSBSNIFFEREVENT
 #define VUSBSNIFFER_F_NO_REPLACE RT_BIT_32(0)
 /** @} */
 
+/** The default size of the capture writer rings.  Events larger than half a
+ * ring are dropped, so this accommodates URBs of up to about 512KB which is
+ * more than any host controller emulation submits in one go. */
+#define VUSBSNIFFER_RING_SIZE_DEF _1M
+
 /**
  * Create a new VUSB sniffer instance dumping to the given capture file.
  *
@@ -69,10 +76,13 @@ typedef enum VUSBSNIFFEREVENT
  * @param   pszFmt                The format of the dump, NULL to select one based on the filename
  *                                extension.
  * @param   pszDesc               Optional description for the dump.
+ * @param   cbRing                Size of the capture writer rings, 0 for
+ *                                VUSBSNIFFER_RING_SIZE_DEF.  Events larger
+ *                                than half of it are dropped.
  */
 DECLHIDDEN(int) VUSBSnifferCreate(PVUSBSNIFFER phSniffer, uint32_t fFlags,
                                   const char *pszCaptureFilename, const char *pszFmt,
-                                  const char *pszDesc);
+                                  const char *pszDesc, uint32_t cbRing);
 
 /**
  * Destroys the given VUSB sniffer instance.
@@ -85,6 +95,10 @@ DECLHIDDEN(void) VUSBSnifferDestroy(VUSBSNIFFER hSniffer);
 /**
  * Records an VUSB event.
  *
+ * Events the capture writer has to drop because it can't keep up or because
+ * they are too big are not treated as failures, they are accounted for in the
+ * statistics returned by VUSBSnifferGetStats().
+ *
  * @returns VBox status code.
  * @param   hSniffer              The sniffer instance.
  * @param   pUrb                  The URB triggering the event.
@@ -92,6 +106,14 @@ DECLHIDDEN(void) VUSBSnifferDestroy(VUSBSNIFFER hSniffer);
  */
 DECLHIDDEN(int) VUSBSnifferRecordEvent(VUSBSNIFFER hSniffer, PVUSBURB pUrb, VUSBSNIFFEREVENT enmEvent);
 
+/**
+ * Returns the live capture writer statistics of the given sniffer.
+ *
+ * @returns Pointer to the statistics, valid until the sniffer is destroyed.
+ * @param   hSniffer              The sniffer instance.
+ */
+DECLHIDDEN(PCCAPTUREWRITERSTATS) VUSBSnifferGetStats(VUSBSNIFFER hSniffer);
+
 
 RT_C_DECLS_END
 #endif
@@ -489,7 +489,8 @@ static int vmmDevReqHandler_GuestHeartbeat(PVMMDEV pThis)
 /**
  * Timer that fires when where have been no heartbeats for a given time.
  *
- * @remarks Does not take the VMMDev critsect.
+ * @remarks Does not take the VMMDev critsect and may be called on the TM timer
+ *          thread instead of an EMT.
  */
 static DECLCALLBACK(void) vmmDevHeartbeatFlatlinedTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pvUser)
 {
@@ -4254,7 +4255,7 @@ static DECLCALLBACK(int) vmmdevConstruct(PPDMDEVINS pDevIns, int iInstance, PCFG
      * Create heartbeat checking timer.
      */
     rc = PDMDevHlpTMTimerCreate(pDevIns, TMCLOCK_VIRTUAL, vmmDevHeartbeatFlatlinedTimer, pThis,
-                                TMTIMER_FLAGS_NO_CRIT_SECT, "Heartbeat flatlined", &pThis->pFlatlinedTimer);
+                                TMTIMER_FLAGS_NO_CRIT_SECT | TMTIMER_FLAGS_TIMER_THREAD, "Heartbeat flatlined", &pThis->pFlatlinedTimer);
     AssertRCReturn(rc, rc);
 
 #ifdef VBOX_WITH_HGCM
@@ -280,6 +280,9 @@ int main()
      */
     CHECK_MEMBER_ALIGNMENT(AHCI, lock, 8);
     CHECK_MEMBER_ALIGNMENT(AHCI, ahciPort[0], 8);
+#ifdef VBOX_WITH_STATISTICS
+    CHECK_MEMBER_ALIGNMENT(AHCIPort, StatReqLatency, 8);
+#endif
 
     CHECK_MEMBER_ALIGNMENT(APICDEV, pDevInsR0, 8);
     CHECK_MEMBER_ALIGNMENT(APICDEV, pDevInsRC, 8);
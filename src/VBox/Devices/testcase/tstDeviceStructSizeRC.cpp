@@ -354,6 +354,8 @@ int main()
 #endif
     GEN_CHECK_OFF(VGASTATE, cMonitors);
     GEN_CHECK_OFF(VGASTATE, cMilliesRefreshInterval);
+    GEN_CHECK_OFF(VGASTATE, cRefreshIdle);
+    GEN_CHECK_OFF(VGASTATE, cRefreshRects);
     GEN_CHECK_OFF(VGASTATE, au32DirtyBitmap);
     GEN_CHECK_OFF(VGASTATE, au32DirtyBitmap[1]);
     GEN_CHECK_OFF(VGASTATE, au32DirtyBitmap[(VGA_VRAM_MAX / PAGE_SIZE / 32) - 1]);
@@ -1333,6 +1335,9 @@ int main()
     GEN_CHECK_OFF(AHCIPort, szModelNumber[AHCI_MODEL_NUMBER_LENGTH]); /* One additional byte for the termination.*/
     GEN_CHECK_OFF(AHCIPort, cErrors);
     GEN_CHECK_OFF(AHCIPort, fRedo);
+#ifdef VBOX_WITH_STATISTICS
+    GEN_CHECK_OFF(AHCIPort, StatReqLatency);
+#endif
 
     GEN_CHECK_SIZE(AHCI);
     GEN_CHECK_OFF(AHCI, dev);
@@ -1855,6 +1860,15 @@ int main()
     GEN_CHECK_OFF(HDASTREAMSTATE, Mapping);
     GEN_CHECK_OFF(HDASTREAMSTATE, BDLE);
     GEN_CHECK_OFF(HDASTREAMSTATE, pCircBuf);
+    GEN_CHECK_OFF(HDASTREAMSTATE, paBDLCache);
+    GEN_CHECK_OFF(HDASTREAMSTATE, cBDLCache);
+#ifndef VBOX_WITH_AUDIO_CALLBACKS
+    GEN_CHECK_OFF(HDASTREAMSTATE, pTimer);
+    GEN_CHECK_OFF(HDASTREAMSTATE, cbPerSec);
+    GEN_CHECK_OFF(HDASTREAMSTATE, cbFrame);
+    GEN_CHECK_OFF(HDASTREAMSTATE, tsTransfer);
+    GEN_CHECK_OFF(HDASTREAMSTATE, fRunning);
+#endif
 
     GEN_CHECK_SIZE(HDASTREAM);
     GEN_CHECK_OFF(HDASTREAM, u8SD);
@@ -1886,9 +1900,8 @@ int main()
     GEN_CHECK_OFF(HDASTATE, fR0Enabled);
     GEN_CHECK_OFF(HDASTATE, fRCEnabled);
 #ifndef VBOX_WITH_AUDIO_CALLBACKS
-    GEN_CHECK_OFF(HDASTATE, pTimer);
     GEN_CHECK_OFF(HDASTATE, cTimerTicks);
-    GEN_CHECK_OFF(HDASTATE, uTimerTS);
+    GEN_CHECK_OFF(HDASTATE, cTimerTicksMin);
 #endif
 #ifdef VBOX_WITH_STATISTICS
 # ifndef VBOX_WITH_AUDIO_CALLBACKS
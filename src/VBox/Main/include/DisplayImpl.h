@@ -36,6 +36,25 @@
 class Console;
 struct VIDEORECCONTEXT;
 
+/** The number of scaled shadow copies kept per screen, see Display::i_snapshotTake. */
+#define DISPLAY_SNAPSHOT_SCALED_MAX 3
+
+/* A scaled shadow copy of a screen. */
+typedef struct DISPLAYSNAPSHOTSCALED
+{
+    uint8_t *pu8Scaled;
+    uint32_t cxScaled;
+    uint32_t cyScaled;
+    uint32_t uScaledGeneration;
+    uint64_t u64ScaledTS;
+    /** Area of the screen updated since this copy was last refreshed. */
+    RTRECT DirtyRect;
+    /** Incremented when the scaled image changes, unique per screen. */
+    uint32_t uSeq;
+    /** The snapshot.uUseCount value of the last use, for the LRU replacement. */
+    uint32_t uLastUse;
+} DISPLAYSNAPSHOTSCALED;
+
 typedef struct _DISPLAYFBINFO
 {
     /* The following 3 fields (u32Offset, u32MaxFramebufferSize and u32InformationSize)
@@ -99,8 +118,42 @@ typedef struct _DISPLAYFBINFO
     struct
     {
         ComPtr<IDisplaySourceBitmap> pSourceBitmap;
+        /** Area updated since the last frame was sent to the recording
+         * (protected by mVideoCaptureLock). */
+        RTRECT DirtyRect;
     } videoCapture;
 #endif /* VBOX_WITH_VIDEOREC */
+
+    /* Scaled shadow copy of the screen for takeScreenShot, see Display::i_snapshotTake.
+     * The source fields and DirtyRect are protected by Display::mSnapshotDirtyLock,
+     * the scaled image and the PNG by Display::mSnapshotLock.
+     */
+    struct
+    {
+        /** Set when the screen can be read directly from VRAM. */
+        bool fUsable;
+        /** Set when a snapshot has been taken, enables the dirty tracking. */
+        bool volatile fActive;
+        uint8_t *pu8VRAM;
+        uint32_t cbLine;
+        uint32_t cx;
+        uint32_t cy;
+        /** Incremented when the source geometry changes. */
+        uint32_t uGeneration;
+        /** Area of the screen updated since the last snapshot. */
+        RTRECT DirtyRect;
+
+        /** The copies for the most recently requested sizes. */
+        DISPLAYSNAPSHOTSCALED aScaled[DISPLAY_SNAPSHOT_SCALED_MAX];
+        /** Incremented by every snapshot. */
+        uint32_t uUseCount;
+        /** The last sequence number handed out to a scaled copy. */
+        uint32_t uSeq;
+
+        uint8_t *pu8PNG;
+        uint32_t cbPNG;
+        uint32_t uSeqPNG;
+    } snapshot;
 } DISPLAYFBINFO;
 
 /* The legacy VBVA (VideoAccel) data.
@@ -207,6 +260,7 @@ public:
     void i_videoCaptureStop();
 #ifdef VBOX_WITH_VIDEOREC
     void videoCaptureScreenChanged(unsigned uScreenId);
+    void i_videoCaptureInvalidateRect(unsigned uScreenId, int32_t x, int32_t y, int32_t w, int32_t h);
 #endif
 
     void i_notifyPowerDown(void);
@@ -302,6 +356,13 @@ private:
                                  BitmapFormat_T aBitmapFormat,
                                  ULONG *pcbOut);
 
+    void i_snapshotUpdateSource(unsigned uScreenId);
+    void i_snapshotInvalidateRect(unsigned uScreenId, int x, int y, int w, int h);
+    int  i_snapshotTake(ULONG aScreenId, uint8_t *pbDst, uint32_t cx, uint32_t cy, uint32_t *puSeq);
+    bool i_snapshotQueryPNG(ULONG aScreenId, uint32_t uSeq, uint8_t *pbDst, size_t cbDst, uint32_t *pcbPNG);
+    void i_snapshotStorePNG(ULONG aScreenId, uint32_t uSeq, const uint8_t *pbPNG, uint32_t cbPNG);
+    void i_snapshotFree(unsigned uScreenId);
+
 #ifdef VBOX_WITH_CRHGSMI
     void i_setupCrHgsmiData(void);
     void i_destructCrHgsmiData(void);
@@ -318,6 +379,8 @@ private:
                                                        uint32_t cbLine, uint32_t cx, uint32_t cy);
     static DECLCALLBACK(void)  i_displayUpdateCallback(PPDMIDISPLAYCONNECTOR pInterface,
                                                        uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
+    static DECLCALLBACK(void)  i_displayUpdateRectsCallback(PPDMIDISPLAYCONNECTOR pInterface,
+                                                            PCRTRECT paRects, uint32_t cRects);
     static DECLCALLBACK(void)  i_displayRefreshCallback(PPDMIDISPLAYCONNECTOR pInterface);
     static DECLCALLBACK(void)  i_displayResetCallback(PPDMIDISPLAYCONNECTOR pInterface);
     static DECLCALLBACK(void)  i_displayLFBModeChangeCallback(PPDMIDISPLAYCONNECTOR pInterface, bool fEnabled);
@@ -387,6 +450,9 @@ private:
     static DECLCALLBACK(int)  i_displaySSMLoadScreenshot(PSSMHANDLE pSSM, void *pvUser, uint32_t uVersion, uint32_t uPass);
     static DECLCALLBACK(void) i_displaySSMSave(PSSMHANDLE pSSM, void *pvUser);
     static DECLCALLBACK(int)  i_displaySSMLoad(PSSMHANDLE pSSM, void *pvUser, uint32_t uVersion, uint32_t uPass);
+#ifdef VBOX_WITH_VIDEOREC
+    static DECLCALLBACK(void) i_videoCaptureInfo(void *pvUser, PCDBGFINFOHLP pHlp, const char *pszArgs);
+#endif
 
     Console * const         mParent;
     /** Pointer to the associated display driver. */
@@ -462,6 +528,10 @@ private:
 
     /* Serializes access to mVideoAccelLegacy and mfVideoAccelVRDP, etc between VRDP and Display. */
     RTCRITSECT mVideoAccelLock;
+    /* Serializes the screenshot shadow copy updates, see DISPLAYFBINFO::snapshot. */
+    RTCRITSECT mSnapshotLock;
+    /* Protects the source information and the dirty rectangle of the shadow copy. */
+    RTCRITSECT mSnapshotDirtyLock;
 #ifdef VBOX_WITH_VIDEOREC
     /* Serializes access to video capture source bitmaps. */
     RTCRITSECT mVideoCaptureLock;
@@ -530,6 +600,9 @@ void videoAccelLeaveVMMDev(VIDEOACCEL *pVideoAccel);
 /* helper function, code in DisplayResampleImage.cpp */
 void BitmapScale32(uint8_t *dst, int dstW, int dstH,
                    const uint8_t *src, int iDeltaLine, int srcW, int srcH);
+int BitmapScale32Rect(uint8_t *pbDst, uint32_t cbDstLine, uint32_t cxDst, uint32_t cyDst,
+                      const uint8_t *pbSrc, uint32_t cbSrcLine, uint32_t cxSrc, uint32_t cySrc,
+                      uint32_t xDst, uint32_t yDst, uint32_t cxRect, uint32_t cyRect);
 
 /* helper function, code in DisplayPNGUtul.cpp */
 int DisplayMakePNG(uint8_t *pbData, uint32_t cx, uint32_t cy,
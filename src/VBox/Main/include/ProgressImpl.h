@@ -139,6 +139,7 @@ public:
 
     bool i_notifyPointOfNoReturn(void);
     bool i_setCancelCallback(void (*pfnCallback)(void *), void *pvUser);
+    HRESULT i_setCurrentOperationDescription(const com::Utf8Str &aOperationDescription);
 
 protected:
     DECLARE_EMPTY_CTOR_DTOR(Progress)
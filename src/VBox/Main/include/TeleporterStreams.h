@@ -0,0 +1,68 @@
+/* $Id$ */
+/** @file
+ * Main - Teleporter multi-stream transport.
+ */
+
+/*
+ * Copyright (C) 2010-2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#ifndef ___TeleporterStreams_h___
+#define ___TeleporterStreams_h___
+
+#include <iprt/types.h>
+
+/** The max number of TCP connections a teleportation may be spread across. */
+#define TELEPORTERSTREAMS_MAX           16
+
+/** @name TeleporterStreamsCreate flags.
+ * @{ */
+/** Compress the blocks using LZF (source only). */
+#define TELEPORTERSTREAMS_F_LZF         RT_BIT_32(0)
+/** Valid flag mask. */
+#define TELEPORTERSTREAMS_F_VALID_MASK  UINT32_C(0x00000001)
+/** @} */
+
+/** Handle to a multi-stream transport instance. */
+typedef struct TELEPORTERSTREAMS *PTELEPORTERSTREAMS;
+
+/**
+ * Transfer statistics.
+ */
+typedef struct TELEPORTERSTREAMSSTATS
+{
+    /** Number of saved state bytes passed thru the transport. */
+    uint64_t    cbStream;
+    /** Number of bytes sent or received on the sockets, headers included. */
+    uint64_t    cbWire;
+    /** Number of data blocks transferred. */
+    uint64_t    cBlocks;
+    /** Number of data blocks that were transferred compressed. */
+    uint64_t    cBlocksCompressed;
+    /** Nanoseconds since the transport was created. */
+    uint64_t    cNsElapsed;
+    /** The number of streams (TCP connections). */
+    uint32_t    cStreams;
+} TELEPORTERSTREAMSSTATS;
+/** Pointer to transfer statistics. */
+typedef TELEPORTERSTREAMSSTATS *PTELEPORTERSTREAMSSTATS;
+
+int     TeleporterStreamsCreate(bool fIsSource, RTSOCKET const *pahSockets, uint32_t cSockets, uint32_t fFlags,
+                                PTELEPORTERSTREAMS *ppThis);
+int     TeleporterStreamsDestroy(PTELEPORTERSTREAMS pThis);
+int     TeleporterStreamsWrite(PTELEPORTERSTREAMS pThis, const void *pvBuf, size_t cbToWrite);
+int     TeleporterStreamsClose(PTELEPORTERSTREAMS pThis, bool fCancelled);
+int     TeleporterStreamsRead(PTELEPORTERSTREAMS pThis, void *pvBuf, size_t cbToRead, size_t *pcbRead);
+void    TeleporterStreamsStopReading(PTELEPORTERSTREAMS pThis, bool fStop);
+void    TeleporterStreamsQueryStats(PTELEPORTERSTREAMS pThis, PTELEPORTERSTREAMSSTATS pStats);
+
+#endif
+
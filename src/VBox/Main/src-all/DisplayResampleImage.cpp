@@ -16,25 +16,212 @@
  */
 
 #include <iprt/types.h>
+#include <iprt/assert.h>
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/string.h>
 
-DECLINLINE(void) imageSetPixel (uint8_t *im, int x, int y, int color, int w)
+#ifdef RT_ARCH_AMD64
+# include <emmintrin.h>
+#endif
+
+/*
+ * The scaler is a box filter: each destination pixel is the area weighted
+ * average of the source pixels covered by its footprint. The filter is
+ * separable, so it is done in two passes per destination row. The vertical
+ * pass sums the weighted source rows into one float accumulator per source
+ * column and colour channel, the horizontal pass then sums the weighted
+ * accumulators of each destination pixel. The weights of a pass add up to 1,
+ * so no normalization is needed at the end.
+ *
+ * On AMD64 the passes use SSE2 and process the 4 channels of a pixel at once.
+ * SSE2 is part of the AMD64 base line, so no CPU detection is needed.
+ */
+
+/**
+ * Computes the filter taps of a destination pixel along one axis.
+ *
+ * The footprint of destination pixel iDst is [iDst * cSrc / cDst, (iDst + 1) * cSrc / cDst)
+ * in source pixels. The computation is done in units of 1/cDst source pixels,
+ * so it is exact.
+ *
+ * @returns Number of taps, at most cSrc / cDst + 2.
+ * @param   iDst        The destination pixel.
+ * @param   cDst        The destination size.
+ * @param   cSrc        The source size.
+ * @param   piFirst     Where to return the first source pixel.
+ * @param   pafWeights  Where to return the weights.
+ */
+static uint32_t bitmapScaleTaps(uint32_t iDst, uint32_t cDst, uint32_t cSrc, uint32_t *piFirst, float *pafWeights)
 {
-    *(int32_t *)(im + y * w * 4 + x * 4) = color;
+    uint64_t const uStart = (uint64_t)iDst * cSrc;
+    uint64_t const uEnd   = uStart + cSrc;
+    uint32_t const iFirst = (uint32_t)(uStart / cDst);
+    uint32_t const iLast  = (uint32_t)((uEnd - 1) / cDst);
+    float const    rNorm  = 1.0f / (float)cSrc;
+
+    for (uint32_t i = iFirst; i <= iLast; i++)
+    {
+        uint64_t const uLo = RT_MAX((uint64_t)i * cDst, uStart);
+        uint64_t const uHi = RT_MIN((uint64_t)(i + 1) * cDst, uEnd);
+        pafWeights[i - iFirst] = (float)(uHi - uLo) * rNorm;
+    }
+
+    *piFirst = iFirst;
+    return iLast - iFirst + 1;
+}
+
+/**
+ * The vertical pass: adds a weighted source row to the column accumulators.
+ *
+ * @param   pafAcc      The accumulators, 4 per pixel, 16 byte aligned.
+ * @param   pbSrc       The source pixels.
+ * @param   cPixels     Number of pixels.
+ * @param   fWeight     The weight of the row.
+ */
+static void bitmapScaleAccumulateRow(float *pafAcc, const uint8_t *pbSrc, uint32_t cPixels, float fWeight)
+{
+    uint32_t i = 0;
+#ifdef RT_ARCH_AMD64
+    __m128 const  vWeight = _mm_set1_ps(fWeight);
+    __m128i const vZero   = _mm_setzero_si128();
+    for (; i + 4 <= cPixels; i += 4)
+    {
+        __m128i const v8  = _mm_loadu_si128((const __m128i *)&pbSrc[i * 4]);
+        __m128i const vLo = _mm_unpacklo_epi8(v8, vZero);
+        __m128i const vHi = _mm_unpackhi_epi8(v8, vZero);
+        float *pf = &pafAcc[i * 4];
+        _mm_store_ps(pf,      _mm_add_ps(_mm_load_ps(pf),
+                                         _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(vLo, vZero)), vWeight)));
+        _mm_store_ps(pf + 4,  _mm_add_ps(_mm_load_ps(pf + 4),
+                                         _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(vLo, vZero)), vWeight)));
+        _mm_store_ps(pf + 8,  _mm_add_ps(_mm_load_ps(pf + 8),
+                                         _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(vHi, vZero)), vWeight)));
+        _mm_store_ps(pf + 12, _mm_add_ps(_mm_load_ps(pf + 12),
+                                         _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(vHi, vZero)), vWeight)));
+    }
+#endif
+    for (; i < cPixels; i++)
+    {
+        float *pf = &pafAcc[i * 4];
+        pf[0] += pbSrc[i * 4 + 0] * fWeight;
+        pf[1] += pbSrc[i * 4 + 1] * fWeight;
+        pf[2] += pbSrc[i * 4 + 2] * fWeight;
+        pf[3] += pbSrc[i * 4 + 3] * fWeight;
+    }
 }
 
-#define trueColorGetAlpha(c) (((c) & 0x7F000000) >> 24)
-#define trueColorGetRed(c)   (((c) & 0xFF0000)   >> 16)
-#define trueColorGetGreen(c) (((c) & 0x00FF00)   >> 8)
-#define trueColorGetBlue(c)   ((c) & 0x0000FF)
+/**
+ * The horizontal pass: computes one destination pixel from the accumulators.
+ *
+ * @returns The pixel, the alpha byte is 0.
+ * @param   pafAcc      The accumulators of the first tap.
+ * @param   pafWeights  The weights.
+ * @param   cTaps       Number of taps.
+ */
+DECLINLINE(uint32_t) bitmapScalePixel(const float *pafAcc, const float *pafWeights, uint32_t cTaps)
+{
+#ifdef RT_ARCH_AMD64
+    __m128 vSum = _mm_setzero_ps();
+    for (uint32_t i = 0; i < cTaps; i++)
+        vSum = _mm_add_ps(vSum, _mm_mul_ps(_mm_load_ps(&pafAcc[i * 4]), _mm_set1_ps(pafWeights[i])));
+    __m128i v = _mm_cvttps_epi32(_mm_add_ps(vSum, _mm_set1_ps(0.5f)));
+    v = _mm_packs_epi32(v, v);
+    v = _mm_packus_epi16(v, v);
+    return (uint32_t)_mm_cvtsi128_si32(v) & UINT32_C(0x00FFFFFF);
+#else
+    float afSum[3] = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < cTaps; i++)
+    {
+        afSum[0] += pafAcc[i * 4 + 0] * pafWeights[i];
+        afSum[1] += pafAcc[i * 4 + 1] * pafWeights[i];
+        afSum[2] += pafAcc[i * 4 + 2] * pafWeights[i];
+    }
+    uint32_t u32 = 0;
+    for (unsigned iChannel = 0; iChannel < 3; iChannel++)
+    {
+        uint32_t const u = (uint32_t)(afSum[iChannel] + 0.5f);
+        u32 |= RT_MIN(u, 255) << (iChannel * 8);
+    }
+    return u32;
+#endif
+}
 
-/* Fast integer implementation for 32 bpp bitmap scaling.
- * Using fixed point values * 16.
+/**
+ * Scales a rectangle of a 32 bpp bitmap.
+ *
+ * Only the destination pixels inside the rectangle are computed, which allows
+ * a scaled copy of a bitmap to be updated incrementally.
+ *
+ * @returns IPRT status code, VERR_NO_MEMORY being the only failure.
+ * @param   pbDst       The destination bitmap.
+ * @param   cbDstLine   Bytes per line of the destination bitmap.
+ * @param   cxDst       The width of the destination bitmap.
+ * @param   cyDst       The height of the destination bitmap.
+ * @param   pbSrc       The source bitmap.
+ * @param   cbSrcLine   Bytes per line of the source bitmap.
+ * @param   cxSrc       The width of the source bitmap.
+ * @param   cySrc       The height of the source bitmap.
+ * @param   xDst        The left edge of the destination rectangle.
+ * @param   yDst        The top edge of the destination rectangle.
+ * @param   cxRect      The width of the destination rectangle.
+ * @param   cyRect      The height of the destination rectangle.
  */
-typedef int32_t FIXEDPOINT;
-#define INT_TO_FIXEDPOINT(i) (FIXEDPOINT)((i) << 4)
-#define FIXEDPOINT_TO_INT(v) (int)((v) >> 4)
-#define FIXEDPOINT_FLOOR(v) ((v) & ~0xF)
-#define FIXEDPOINT_FRACTION(v) ((v) & 0xF)
+int BitmapScale32Rect(uint8_t *pbDst, uint32_t cbDstLine, uint32_t cxDst, uint32_t cyDst,
+                      const uint8_t *pbSrc, uint32_t cbSrcLine, uint32_t cxSrc, uint32_t cySrc,
+                      uint32_t xDst, uint32_t yDst, uint32_t cxRect, uint32_t cyRect)
+{
+    AssertReturn(xDst + cxRect <= cxDst && yDst + cyRect <= cyDst, VERR_INVALID_PARAMETER);
+    if (!cxRect || !cyRect || !cxSrc || !cySrc)
+        return VINF_SUCCESS;
+
+    /*
+     * One allocation for the horizontal filter taps, the vertical weights and
+     * the column accumulators. The latter need 16 byte alignment.
+     */
+    uint32_t const cMaxTapsX = cxSrc / cxDst + 2;
+    uint32_t const cMaxTapsY = cySrc / cyDst + 2;
+    uint32_t const iColFirst = (uint32_t)((uint64_t)xDst * cxSrc / cxDst);
+    uint32_t const iColEnd   = (uint32_t)(((uint64_t)(xDst + cxRect) * cxSrc + cxDst - 1) / cxDst);
+    uint32_t const cCols     = iColEnd - iColFirst;
+
+    size_t const cbTaps    = cxRect * 2 * sizeof(uint32_t);
+    size_t const cbWeights = ((size_t)cxRect * cMaxTapsX + cMaxTapsY) * sizeof(float);
+    size_t const cbAcc     = (size_t)cCols * 4 * sizeof(float);
+    uint8_t *pbAlloc = (uint8_t *)RTMemTmpAlloc(cbTaps + cbWeights + cbAcc + 16);
+    if (!pbAlloc)
+        return VERR_NO_MEMORY;
+
+    uint32_t *paiFirstX   = (uint32_t *)pbAlloc;
+    uint32_t *pacTapsX    = &paiFirstX[cxRect];
+    float    *pafWeightsX = (float *)&pacTapsX[cxRect];
+    float    *pafWeightsY = &pafWeightsX[(size_t)cxRect * cMaxTapsX];
+    float    *pafAcc      = (float *)RT_ALIGN_PT(&pafWeightsY[cMaxTapsY], 16, float *);
+
+    for (uint32_t x = 0; x < cxRect; x++)
+    {
+        pacTapsX[x] = bitmapScaleTaps(xDst + x, cxDst, cxSrc, &paiFirstX[x], &pafWeightsX[(size_t)x * cMaxTapsX]);
+        paiFirstX[x] -= iColFirst;
+    }
+
+    for (uint32_t y = yDst; y < yDst + cyRect; y++)
+    {
+        uint32_t iRowFirst;
+        uint32_t const cTapsY = bitmapScaleTaps(y, cyDst, cySrc, &iRowFirst, pafWeightsY);
+
+        memset(pafAcc, 0, cbAcc);
+        for (uint32_t i = 0; i < cTapsY; i++)
+            bitmapScaleAccumulateRow(pafAcc, pbSrc + (size_t)(iRowFirst + i) * cbSrcLine + iColFirst * 4,
+                                     cCols, pafWeightsY[i]);
+
+        uint32_t *pu32Dst = (uint32_t *)(pbDst + (size_t)y * cbDstLine) + xDst;
+        for (uint32_t x = 0; x < cxRect; x++)
+            pu32Dst[x] = bitmapScalePixel(&pafAcc[paiFirstX[x] * 4], &pafWeightsX[(size_t)x * cMaxTapsX], pacTapsX[x]);
+    }
+
+    RTMemTmpFree(pbAlloc);
+    return VINF_SUCCESS;
+}
 
 /* For 32 bit source only. */
 void BitmapScale32 (uint8_t *dst,
@@ -43,108 +230,10 @@ void BitmapScale32 (uint8_t *dst,
                     int iDeltaLine,
                     int srcW, int srcH)
 {
-    int x, y;
-
-    for (y = 0; y < dstH; y++)
+    int rc = BitmapScale32Rect(dst, dstW * 4, dstW, dstH, src, iDeltaLine, srcW, srcH, 0, 0, dstW, dstH);
+    if (RT_FAILURE(rc))
     {
-        FIXEDPOINT sy1 = INT_TO_FIXEDPOINT(y * srcH) / dstH;
-        FIXEDPOINT sy2 = INT_TO_FIXEDPOINT((y + 1) * srcH) / dstH;
-
-        for (x = 0; x < dstW; x++)
-        {
-            FIXEDPOINT red = 0, green = 0, blue = 0;
-
-            FIXEDPOINT sx1 = INT_TO_FIXEDPOINT(x * srcW) / dstW;
-            FIXEDPOINT sx2 = INT_TO_FIXEDPOINT((x + 1) * srcW) / dstW;
-
-            FIXEDPOINT spixels = (sx2 - sx1) * (sy2 - sy1);
-
-            FIXEDPOINT sy = sy1;
-
-            do
-            {
-                FIXEDPOINT yportion;
-                if (FIXEDPOINT_FLOOR (sy) == FIXEDPOINT_FLOOR (sy1))
-                {
-                    yportion = INT_TO_FIXEDPOINT(1) - FIXEDPOINT_FRACTION(sy);
-                    if (yportion > sy2 - sy1)
-                    {
-                        yportion = sy2 - sy1;
-                    }
-                    sy = FIXEDPOINT_FLOOR (sy);
-                }
-                else if (sy == FIXEDPOINT_FLOOR (sy2))
-                {
-                    yportion = FIXEDPOINT_FRACTION(sy2);
-                }
-                else
-                {
-                    yportion = INT_TO_FIXEDPOINT(1);
-                }
-
-                const uint8_t *pu8SrcLine = src + iDeltaLine * FIXEDPOINT_TO_INT(sy);
-                FIXEDPOINT sx = sx1;
-                do
-                {
-                    FIXEDPOINT xportion;
-                    FIXEDPOINT pcontribution;
-                    int p;
-                    if (FIXEDPOINT_FLOOR (sx) == FIXEDPOINT_FLOOR (sx1))
-                    {
-                        xportion = INT_TO_FIXEDPOINT(1) - FIXEDPOINT_FRACTION(sx);
-                        if (xportion > sx2 - sx1)
-                        {
-                            xportion = sx2 - sx1;
-                        }
-                        pcontribution = xportion * yportion;
-                        sx = FIXEDPOINT_FLOOR (sx);
-                    }
-                    else if (sx == FIXEDPOINT_FLOOR (sx2))
-                    {
-                        xportion = FIXEDPOINT_FRACTION(sx2);
-                        pcontribution = xportion * yportion;
-                    }
-                    else
-                    {
-                        xportion = INT_TO_FIXEDPOINT(1);
-                        pcontribution = xportion * yportion;
-                    }
-                    /* Color depth specific code begin */
-                    p = *(uint32_t *)(pu8SrcLine + FIXEDPOINT_TO_INT(sx) * 4);
-                    /* Color depth specific code end */
-                    red   += trueColorGetRed (p) * pcontribution;
-                    green += trueColorGetGreen (p) * pcontribution;
-                    blue  += trueColorGetBlue (p) * pcontribution;
-
-                    sx += INT_TO_FIXEDPOINT(1);
-                } while (sx < sx2);
-
-                sy += INT_TO_FIXEDPOINT(1);
-            } while (sy < sy2);
-
-            if (spixels != 0)
-            {
-                red /= spixels;
-                green /= spixels;
-                blue /= spixels;
-            }
-            /* Clamping to allow for rounding errors above */
-            if (red > 255)
-            {
-                red = 255;
-            }
-            if (green > 255)
-            {
-                green = 255;
-            }
-            if (blue > 255)
-            {
-                blue = 255;
-            }
-            imageSetPixel (dst,
-                           x, y,
-                           ( ((int) red) << 16) + (((int) green) << 8) + ((int) blue),
-                           dstW);
-        }
+        /* Rather a black image than garbage. */
+        memset(dst, 0, (size_t)dstW * 4 * dstH);
     }
 }
@@ -536,6 +536,30 @@ bool Progress::i_setCancelCallback(void (*pfnCallback)(void *), void *pvUser)
     return true;
 }
 
+/**
+ * Replaces the description of the current operation without advancing to the
+ * next one.
+ *
+ * This is for long running operations wishing to show details like transfer
+ * rates in the operation description.
+ *
+ * @returns COM status code.
+ * @param   aOperationDescription   The new description.
+ */
+HRESULT Progress::i_setCurrentOperationDescription(const com::Utf8Str &aOperationDescription)
+{
+    AutoCaller autoCaller(this);
+    if (FAILED(autoCaller.rc())) return autoCaller.rc();
+
+    AutoWriteLock alock(this COMMA_LOCKVAL_SRC_POS);
+
+    if (mCompleted || mCanceled)
+        return E_FAIL;
+
+    m_operationDescription = aOperationDescription;
+    return S_OK;
+}
+
 
 // IProgress properties
 /////////////////////////////////////////////////////////////////////////////
@@ -26,12 +26,14 @@
 #include "AutoCaller.h"
 #include "Logging.h"
 #include "HashedPw.h"
+#include "TeleporterStreams.h"
 
 #include <iprt/asm.h>
 #include <iprt/err.h>
 #include <iprt/rand.h>
 #include <iprt/socket.h>
 #include <iprt/tcp.h>
+#include <iprt/time.h>
 #include <iprt/timer.h>
 
 #include <VBox/vmm/vmapi.h>
@@ -69,6 +71,20 @@ public:
     bool volatile       mfIOError;
     /** @} */
 
+    /** @name multi-stream stuff
+     * @{  */
+    /** Set if the multi-stream transport has been negotiated. */
+    bool                mfStreams;
+    /** The number of streams, 1 if only mhSocket is used. */
+    uint32_t            mcStreams;
+    /** The additional stream sockets (entry 0 is unused, that's mhSocket). */
+    RTSOCKET            mahStreamSockets[TELEPORTERSTREAMS_MAX];
+    /** The multi-stream transport while loading/saving, NULL if not used. */
+    PTELEPORTERSTREAMS  mpStreams;
+    /** When the transfer rate was last shown in the progress object. */
+    uint64_t            mnsLastRateUpdate;
+    /** @} */
+
     TeleporterState(Console *pConsole, PUVM pUVM, Progress *pProgress, bool fIsSource)
         : mptrConsole(pConsole)
         , mpUVM(pUVM)
@@ -80,7 +96,13 @@ public:
         , mfStopReading(false)
         , mfEndOfStream(false)
         , mfIOError(false)
+        , mfStreams(false)
+        , mcStreams(1)
+        , mpStreams(NULL)
+        , mnsLastRateUpdate(0)
     {
+        for (unsigned i = 0; i < RT_ELEMENTS(mahStreamSockets); i++)
+            mahStreamSockets[i] = NIL_RTSOCKET;
         VMR3RetainUVM(mpUVM);
     }
 
@@ -104,6 +126,8 @@ public:
     MachineState_T      menmOldMachineState;
     bool                mfSuspendedByUs;
     bool                mfUnlockedMedia;
+    /** Whether to LZF compress the stream blocks (requires the multi-stream transport). */
+    bool                mfCompressStreams;
 
     TeleporterStateSrc(Console *pConsole, PUVM pUVM, Progress *pProgress, MachineState_T enmOldMachineState)
         : TeleporterState(pConsole, pUVM, pProgress, true /*fIsSource*/)
@@ -112,6 +136,7 @@ public:
         , menmOldMachineState(enmOldMachineState)
         , mfSuspendedByUs(false)
         , mfUnlockedMedia(false)
+        , mfCompressStreams(false)
     {
     }
 };
@@ -126,6 +151,15 @@ public:
     IMachine                   *mpMachine;
     IInternalMachineControl    *mpControl;
     PRTTCPSERVER                mhServer;
+    /** The server accepting the additional stream connections while attaching. */
+    PRTTCPSERVER volatile       mhStreamServer;
+    /** Set by the cancel callback to abort reading the introduction of a
+     * stream connection. */
+    bool volatile               mfStreamsCancelled;
+    /** The address we're listening on (empty for any). */
+    Utf8Str                     mstrAddress;
+    /** The port we're listening on. */
+    uint32_t                    muPort;
     PRTTIMERLR                  mphTimerLR;
     bool                        mfLockedMedia;
     int                         mRc;
@@ -138,6 +172,9 @@ public:
         , mpMachine(pMachine)
         , mpControl(pControl)
         , mhServer(NULL)
+        , mhStreamServer(NULL)
+        , mfStreamsCancelled(false)
+        , muPort(0)
         , mphTimerLR(phTimerLR)
         , mfLockedMedia(false)
         , mRc(VINF_SUCCESS)
@@ -167,6 +204,9 @@ typedef struct TELEPORTERTCPHDR
 #define TELEPORTERTCPHDR_MAGIC       UINT32_C(0x19471205)
 /** The max block size. */
 #define TELEPORTERTCPHDR_MAX_SIZE    UINT32_C(0x00fffff8)
+/** How long a stream connection gets to introduce itself before it's dropped
+ * (milliseconds). */
+#define TELEPORTER_STREAM_INTRO_TIMEOUT_MS  UINT32_C(2000)
 
 
 /*********************************************************************************************************************************
@@ -176,19 +216,24 @@ static const char g_szWelcome[] = "VirtualBox-Teleporter-1.0\n";
 
 
 /**
- * Reads a string from the socket.
+ * Reads a string from the given socket.
  *
- * @returns VBox status code.
+ * @returns VBox status code.  VERR_TIMEOUT if the deadline passed and
+ *          VERR_CANCELLED if *pfCancelled got set before the line was complete.
  *
- * @param   pState      The teleporter state structure.
+ * @param   hSocket     The socket to read from.
  * @param   pszBuf      The output buffer.
  * @param   cchBuf      The size of the output buffer.
+ * @param   msDeadline  The RTTimeMilliTS deadline for the whole line,
+ *                      UINT64_MAX for none.
+ * @param   pfCancelled Flag to poll for cancellation while waiting for the
+ *                      deadline, NULL if not cancellable.
  *
  */
-static int teleporterTcpReadLine(TeleporterState *pState, char *pszBuf, size_t cchBuf)
+static int teleporterTcpReadLineEx(RTSOCKET hSocket, char *pszBuf, size_t cchBuf,
+                                   uint64_t msDeadline, bool volatile *pfCancelled)
 {
     char       *pszStart = pszBuf;
-    RTSOCKET    hSocket  = pState->mhSocket;
 
     AssertReturn(cchBuf > 1, VERR_INTERNAL_ERROR);
     *pszBuf = '\0';
@@ -196,8 +241,29 @@ static int teleporterTcpReadLine(TeleporterState *pState, char *pszBuf, size_t c
     /* dead simple approach. */
     for (;;)
     {
+        int rc;
+        if (msDeadline != UINT64_MAX)
+        {
+            /* Never block in the read below, a peer sending part of a line would keep us there forever. */
+            do
+            {
+                uint64_t const msNow = RTTimeMilliTS();
+                if (pfCancelled && ASMAtomicReadBool(pfCancelled))
+                    rc = VERR_CANCELLED;
+                else if (msNow >= msDeadline)
+                    rc = VERR_TIMEOUT;
+                else
+                    rc = RTTcpSelectOne(hSocket, (RTMSINTERVAL)RT_MIN(msDeadline - msNow, 250));
+            } while (rc == VERR_TIMEOUT && RTTimeMilliTS() < msDeadline);
+            if (RT_FAILURE(rc))
+            {
+                LogRel(("Teleporter: RTTcpSelectOne -> %Rrc while reading string ('%s')\n", rc, pszStart));
+                return rc;
+            }
+        }
+
         char ch;
-        int rc = RTTcpRead(hSocket, &ch, sizeof(ch), NULL);
+        rc = RTTcpRead(hSocket, &ch, sizeof(ch), NULL);
         if (RT_FAILURE(rc))
         {
             LogRel(("Teleporter: RTTcpRead -> %Rrc while reading string ('%s')\n", rc, pszStart));
@@ -218,6 +284,111 @@ static int teleporterTcpReadLine(TeleporterState *pState, char *pszBuf, size_t c
 }
 
 
+/**
+ * Reads a string from the socket.
+ *
+ * @returns VBox status code.
+ *
+ * @param   pState      The teleporter state structure.
+ * @param   pszBuf      The output buffer.
+ * @param   cchBuf      The size of the output buffer.
+ *
+ */
+static int teleporterTcpReadLine(TeleporterState *pState, char *pszBuf, size_t cchBuf)
+{
+    return teleporterTcpReadLineEx(pState->mhSocket, pszBuf, cchBuf, UINT64_MAX, NULL);
+}
+
+
+/**
+ * Compares a received stream cookie with the expected one in constant time.
+ *
+ * The time taken only depends on the length of the expected cookie, so it
+ * doesn't tell a peer how many leading characters it got right.
+ *
+ * @returns true if equal, false if not.
+ * @param   pszReceived The cookie received from the peer.
+ * @param   pszCookie   The expected cookie.
+ */
+static bool teleporterCookieEquals(const char *pszReceived, const char *pszCookie)
+{
+    size_t const cchCookie = strlen(pszCookie);
+    size_t const cchRecv   = strlen(pszReceived);
+    uint8_t      bDiff     = cchRecv != cchCookie;
+    for (size_t off = 0; off < cchCookie; off++)
+        bDiff |= (uint8_t)pszCookie[off] ^ (uint8_t)pszReceived[RT_MIN(off, cchRecv)];
+    return bDiff == 0;
+}
+
+
+/**
+ * Closes the additional stream sockets.
+ *
+ * @param   pState      The teleporter state structure.
+ */
+static void teleporterCloseStreamSockets(TeleporterState *pState)
+{
+    for (uint32_t i = 1; i < RT_ELEMENTS(pState->mahStreamSockets); i++)
+        if (pState->mahStreamSockets[i] != NIL_RTSOCKET)
+        {
+            if (pState->mfIsSource)
+                RTTcpClientClose(pState->mahStreamSockets[i]);
+            else
+                RTTcpServerDisconnectClient2(pState->mahStreamSockets[i]);
+            pState->mahStreamSockets[i] = NIL_RTSOCKET;
+        }
+    pState->mcStreams = 1;
+    pState->mfStreams = false;
+}
+
+
+/**
+ * Creates the multi-stream transport if it was negotiated.
+ *
+ * @returns VBox status code.
+ * @param   pState      The teleporter state structure.
+ * @param   fFlags      TELEPORTERSTREAMS_F_XXX.
+ */
+static int teleporterCreateStreams(TeleporterState *pState, uint32_t fFlags)
+{
+    Assert(!pState->mpStreams);
+    if (!pState->mfStreams)
+        return VINF_SUCCESS;
+
+    RTSOCKET ahSockets[TELEPORTERSTREAMS_MAX];
+    ahSockets[0] = pState->mhSocket;
+    for (uint32_t i = 1; i < pState->mcStreams; i++)
+        ahSockets[i] = pState->mahStreamSockets[i];
+    int rc = TeleporterStreamsCreate(pState->mfIsSource, ahSockets, pState->mcStreams, fFlags, &pState->mpStreams);
+    if (RT_FAILURE(rc))
+        LogRel(("Teleporter: TeleporterStreamsCreate failed: %Rrc\n", rc));
+    pState->mnsLastRateUpdate = RTTimeNanoTS();
+    return rc;
+}
+
+
+/**
+ * Destroys the multi-stream transport, if any, logging the statistics.
+ *
+ * @param   pState      The teleporter state structure.
+ */
+static void teleporterDestroyStreams(TeleporterState *pState)
+{
+    if (pState->mpStreams)
+    {
+        TELEPORTERSTREAMSSTATS Stats;
+        TeleporterStreamsQueryStats(pState->mpStreams, &Stats);
+        uint64_t const cMsElapsed = RT_MAX(Stats.cNsElapsed / RT_NS_1MS, 1);
+        LogRel(("Teleporter: %u streams: %'RU64 bytes in %'RU64 ms (%'RU64 KB/s), %'RU64 bytes on the wire, %'RU64 of %'RU64 blocks compressed\n",
+                Stats.cStreams, Stats.cbStream, cMsElapsed, Stats.cbStream / cMsElapsed * 1000 / _1K,
+                Stats.cbWire, Stats.cBlocksCompressed, Stats.cBlocks));
+
+        TeleporterStreamsDestroy(pState->mpStreams);
+        pState->mpStreams = NULL;
+    }
+}
+
+
 /**
  * Reads an ACK or NACK.
  *
@@ -304,6 +475,92 @@ HRESULT Console::i_teleporterSrcSubmitCommand(TeleporterStateSrc *pState, const
 }
 
 
+/**
+ * Negotiates the multi-stream transport and connects the additional streams.
+ *
+ * The destination listens for the additional connections on the port
+ * following the teleporter port.  The connections are authenticated using a
+ * random cookie passed along in the command over the main connection.  If the
+ * destination declines, we fall back on the plain single stream transport.
+ *
+ * @returns S_OK on success (mfStreams and mcStreams updated),
+ *          E_FAIL+setError() on failure.
+ * @param   pState              The teleporter source state.
+ *
+ * @remarks the setError laziness forces this to be a Console member.
+ */
+HRESULT Console::i_teleporterSrcConnectStreams(TeleporterStateSrc *pState)
+{
+    uint32_t cStreams = pState->mcStreams;
+    Assert(cStreams >= 1 && cStreams <= TELEPORTERSTREAMS_MAX);
+    pState->mcStreams = 1;
+    if (cStreams > 1 && pState->muPort >= UINT16_MAX)
+    {
+        LogRel(("Teleporter: Port %u leaves no room for additional streams, using one.\n", pState->muPort));
+        cStreams = 1;
+    }
+
+    uint8_t abCookie[16];
+    RTRandBytes(abCookie, sizeof(abCookie));
+    char szCookie[sizeof(abCookie) * 2 + 1];
+    int vrc = RTStrPrintHexBytes(szCookie, sizeof(szCookie), abCookie, sizeof(abCookie), 0 /*fFlags*/);
+    AssertRCReturn(vrc, setError(E_FAIL, "RTStrPrintHexBytes -> %Rrc", vrc));
+
+    char szCmd[128];
+    RTStrPrintf(szCmd, sizeof(szCmd), "streams=%u;%s", cStreams, szCookie);
+    HRESULT hrc = i_teleporterSrcSubmitCommand(pState, szCmd, false /*fWaitForAck*/);
+    if (FAILED(hrc))
+        return hrc;
+
+    /*
+     * A NACK is not fatal unless it's from a destination which doesn't know
+     * the command, as it'll hang up on us right after sending it.
+     */
+    char szMsg[256];
+    vrc = teleporterTcpReadLine(pState, szMsg, sizeof(szMsg));
+    if (RT_FAILURE(vrc))
+        return setError(E_FAIL, tr("Failed reading ACK(streams): %Rrc"), vrc);
+    if (!strncmp(szMsg, RT_STR_TUPLE("NACK=")))
+    {
+        int32_t vrc2 = VERR_INTERNAL_ERROR;
+        RTStrToInt32Ex(&szMsg[sizeof("NACK=") - 1], NULL, 10, &vrc2);
+        if (vrc2 == VERR_NOT_IMPLEMENTED)
+            return setError(E_FAIL, tr("The target does not support teleporting over multiple connections"));
+        LogRel(("Teleporter: The target declined %u streams (%Rrc), using the plain transport.\n", cStreams, vrc2));
+        return S_OK;
+    }
+    if (strcmp(szMsg, "ACK"))
+        return setError(E_FAIL, tr("streams: Expected ACK or NACK, got '%s'"), szMsg);
+
+    /*
+     * Connect the additional streams and introduce them.
+     */
+    for (uint32_t i = 1; i < cStreams; i++)
+    {
+        vrc = RTTcpClientConnect(pState->mstrHostname.c_str(), pState->muPort + 1, &pState->mahStreamSockets[i]);
+        if (RT_FAILURE(vrc))
+            return setError(E_FAIL, tr("Failed to connect stream #%u to port %u on '%s': %Rrc"),
+                            i, pState->muPort + 1, pState->mstrHostname.c_str(), vrc);
+        vrc = RTTcpSetSendCoalescing(pState->mahStreamSockets[i], false /*fEnable*/);
+        AssertRC(vrc);
+
+        RTStrPrintf(szCmd, sizeof(szCmd), "%s;%u\n", szCookie, i);
+        vrc = RTTcpWrite(pState->mahStreamSockets[i], szCmd, strlen(szCmd));
+        if (RT_FAILURE(vrc))
+            return setError(E_FAIL, tr("Failed to introduce stream #%u: %Rrc"), i, vrc);
+    }
+
+    hrc = i_teleporterSrcReadACK(pState, "streams-attached");
+    if (FAILED(hrc))
+        return hrc;
+
+    pState->mcStreams = cStreams;
+    pState->mfStreams = true;
+    LogRel(("Teleporter: Using %u streams%s.\n", cStreams, pState->mfCompressStreams ? " with LZF compression" : ""));
+    return S_OK;
+}
+
+
 /**
  * @copydoc SSMSTRMOPS::pfnWrite
  */
@@ -316,6 +573,18 @@ static DECLCALLBACK(int) teleporterTcpOpWrite(void *pvUser, uint64_t offStream,
     AssertReturn(cbToWrite < UINT32_MAX, VERR_OUT_OF_RANGE);
     AssertReturn(pState->mfIsSource, VERR_INVALID_HANDLE);
 
+    if (pState->mpStreams)
+    {
+        int rc = TeleporterStreamsWrite(pState->mpStreams, pvBuf, cbToWrite);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("Teleporter/TCP: Write error: %Rrc (cb=%#zx)\n", rc, cbToWrite));
+            return rc;
+        }
+        pState->moffStream += cbToWrite;
+        return VINF_SUCCESS;
+    }
+
     for (;;)
     {
         TELEPORTERTCPHDR Hdr;
@@ -394,6 +663,34 @@ static DECLCALLBACK(int) teleporterTcpOpRead(void *pvUser, uint64_t offStream, v
         if (pState->mfIOError)
             return VERR_IO_GEN_FAILURE;
 
+        /*
+         * The multi-stream transport does the block handling itself.
+         */
+        if (pState->mpStreams)
+        {
+            size_t cbRead = cbToRead;
+            rc = TeleporterStreamsRead(pState->mpStreams, pvBuf, cbToRead, pcbRead ? &cbRead : NULL);
+            if (RT_SUCCESS(rc))
+            {
+                pState->moffStream += cbRead;
+                if (pcbRead)
+                    *pcbRead = cbRead;
+            }
+            else if (rc == VERR_SSM_CANCELLED)
+                pState->mfEndOfStream = true;
+            else if (rc == VERR_EOF)
+            {
+                if (!pState->mfStopReading)
+                    pState->mfEndOfStream = true;
+            }
+            else
+            {
+                pState->mfIOError = true;
+                LogRel(("Teleporter/TCP: Read error: %Rrc (cb=%#zx)\n", rc, cbToRead));
+            }
+            return rc;
+        }
+
         /*
          * If there is no more data in the current block, read the next
          * block header.
@@ -533,7 +830,16 @@ static DECLCALLBACK(int) teleporterTcpOpClose(void *pvUser, bool fCancelled)
 {
     TeleporterState *pState = (TeleporterState *)pvUser;
 
-    if (pState->mfIsSource)
+    if (pState->mfIsSource && pState->mpStreams)
+    {
+        int rc = TeleporterStreamsClose(pState->mpStreams, fCancelled);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("Teleporter/TCP: TeleporterStreamsClose failed: %Rrc\n", rc));
+            return rc;
+        }
+    }
+    else if (pState->mfIsSource)
     {
         TELEPORTERTCPHDR EofHdr;
         EofHdr.u32Magic = TELEPORTERTCPHDR_MAGIC;
@@ -548,6 +854,8 @@ static DECLCALLBACK(int) teleporterTcpOpClose(void *pvUser, bool fCancelled)
     else
     {
         ASMAtomicWriteBool(&pState->mfStopReading, true);
+        if (pState->mpStreams)
+            TeleporterStreamsStopReading(pState->mpStreams, true);
     }
 
     return VINF_SUCCESS;
@@ -582,6 +890,10 @@ static void teleporterProgressCancelCallback(void *pvUser)
     {
         TeleporterStateTrg *pStateTrg = (TeleporterStateTrg *)pState;
         RTTcpServerShutdown(pStateTrg->mhServer);
+        ASMAtomicWriteBool(&pStateTrg->mfStreamsCancelled, true);
+        PRTTCPSERVER hStreamServer = ASMAtomicReadPtrT(&pStateTrg->mhStreamServer, PRTTCPSERVER);
+        if (hStreamServer)
+            RTTcpServerShutdown(hStreamServer);
     }
 }
 
@@ -593,6 +905,22 @@ static DECLCALLBACK(int) teleporterProgressCallback(PUVM pUVM, unsigned uPercent
     TeleporterState *pState = (TeleporterState *)pvUser;
     if (pState->mptrProgress)
     {
+        /* Show the transfer rate in the operation description about once a second. */
+        if (pState->mpStreams)
+        {
+            uint64_t const nsNow = RTTimeNanoTS();
+            if (nsNow - pState->mnsLastRateUpdate >= RT_NS_1SEC)
+            {
+                pState->mnsLastRateUpdate = nsNow;
+                TELEPORTERSTREAMSSTATS Stats;
+                TeleporterStreamsQueryStats(pState->mpStreams, &Stats);
+                uint64_t const cMsElapsed = RT_MAX(Stats.cNsElapsed / RT_NS_1MS, 1);
+                pState->mptrProgress->i_setCurrentOperationDescription(
+                    Utf8StrFmt(Console::tr("Teleporting VM (%RU64 MB/s over %u connections, %RU64 MB on the wire)"),
+                               Stats.cbStream / cMsElapsed * 1000 / _1M, Stats.cStreams, Stats.cbWire / _1M));
+            }
+        }
+
         HRESULT hrc = pState->mptrProgress->SetCurrentOperationProgress(uPercent);
         if (FAILED(hrc))
         {
@@ -677,6 +1005,14 @@ HRESULT Console::i_teleporterSrc(TeleporterStateSrc *pState)
     if (FAILED(hrc))
         return hrc;
 
+    /* Multiple streams and/or compression (configured by the caller). */
+    if (pState->mcStreams > 1 || pState->mfCompressStreams)
+    {
+        hrc = i_teleporterSrcConnectStreams(pState);
+        if (FAILED(hrc))
+            return hrc;
+    }
+
     /*
      * Start loading the state.
      *
@@ -684,9 +1020,16 @@ HRESULT Console::i_teleporterSrc(TeleporterStateSrc *pState)
      *       verified against the VM config on the other end.  This is all done
      *       in the first pass, so we should fail pretty promptly on misconfig.
      */
+    vrc = teleporterCreateStreams(pState, pState->mfCompressStreams ? TELEPORTERSTREAMS_F_LZF : 0);
+    if (RT_FAILURE(vrc))
+        return setError(E_FAIL, tr("Failed to set up the teleporter streams: %Rrc"), vrc);
+
     hrc = i_teleporterSrcSubmitCommand(pState, "load");
     if (FAILED(hrc))
+    {
+        teleporterDestroyStreams(pState);
         return hrc;
+    }
 
     RTSocketRetain(pState->mhSocket);
     void *pvUser = static_cast<void *>(static_cast<TeleporterState *>(pState));
@@ -696,6 +1039,7 @@ HRESULT Console::i_teleporterSrc(TeleporterStateSrc *pState)
                        teleporterProgressCallback,  pvUser,
                        &pState->mfSuspendedByUs);
     RTSocketRelease(pState->mhSocket);
+    teleporterDestroyStreams(pState);
     if (RT_FAILURE(vrc))
     {
         if (   vrc == VERR_SSM_CANCELLED
@@ -784,6 +1128,7 @@ Console::i_teleporterSrcThreadWrapper(RTTHREAD hThreadSelf, void *pvUser)
         RTTcpClientClose(pState->mhSocket);
         pState->mhSocket = NIL_RTSOCKET;
     }
+    teleporterCloseStreamSockets(pState);
 
     /* Aaarg! setMachineState trashes error info on Windows, so we have to
        complete things here on failure instead of right before cleanup. */
@@ -991,6 +1336,18 @@ HRESULT Console::teleport(const com::Utf8Str &aHostname, ULONG aTcpport, const c
     pState->muPort          = aTcpport;
     pState->mcMsMaxDowntime = aMaxDowntime;
 
+    /* Spread the state over several connections and compress it? */
+    Bstr bstrStreams;
+    mMachine->GetExtraData(Bstr("VBoxInternal2/TeleporterStreams").raw(), bstrStreams.asOutParam());
+    if (bstrStreams.isNotEmpty())
+    {
+        uint32_t cStreams = Utf8Str(bstrStreams).toUInt32();
+        pState->mcStreams = RT_MIN(RT_MAX(cStreams, 1), TELEPORTERSTREAMS_MAX);
+    }
+    Bstr bstrCompression;
+    mMachine->GetExtraData(Bstr("VBoxInternal2/TeleporterCompression").raw(), bstrCompression.asOutParam());
+    pState->mfCompressStreams = Utf8Str(bstrCompression).equalsIgnoreCase("lzf");
+
     void *pvUser = static_cast<void *>(static_cast<TeleporterState *>(pState));
     ptrProgress->i_setCancelCallback(teleporterProgressCancelCallback, pvUser);
 
@@ -1113,6 +1470,8 @@ HRESULT Console::i_teleporterTrg(PUVM pUVM, IMachine *pMachine, Utf8Str *pErrorM
             TeleporterStateTrg theState(this, pUVM, pProgress, pMachine, mControl, &hTimerLR, fStartPaused);
             theState.mstrPassword      = strPassword;
             theState.mhServer          = hServer;
+            theState.mstrAddress       = strAddress;
+            theState.muPort            = uPort;
 
             void *pvUser = static_cast<void *>(static_cast<TeleporterState *>(&theState));
             if (pProgress->i_setCancelCallback(teleporterProgressCancelCallback, pvUser))
@@ -1250,6 +1609,133 @@ static int teleporterTcpWriteNACK(TeleporterStateTrg *pState, int32_t rc2, const
 }
 
 
+/**
+ * Handles the "streams" command, attaching the additional stream connections.
+ *
+ * @returns VBox status code.  Failures are fatal to the teleportation, while
+ *          declining the request with a NACK is not.
+ * @param   pState      The teleporter destination state.
+ * @param   pszArgs     The command arguments: "<count>;<cookie>".
+ */
+static int teleporterTrgAttachStreams(TeleporterStateTrg *pState, const char *pszArgs)
+{
+    /*
+     * Validate the request.
+     */
+    uint32_t    cStreams  = 0;
+    char       *pszCookie = NULL;
+    int vrc = RTStrToUInt32Ex(pszArgs, &pszCookie, 10, &cStreams);
+    if (   vrc != VWRN_TRAILING_CHARS
+        || *pszCookie != ';'
+        || strlen(++pszCookie) < 16
+        || strlen(pszCookie) > 64)
+        return teleporterTcpWriteNACK(pState, VERR_INVALID_PARAMETER);
+    if (pState->mfStreams)
+        return teleporterTcpWriteNACK(pState, VERR_WRONG_ORDER);
+    if (   cStreams < 1
+        || cStreams > TELEPORTERSTREAMS_MAX
+        || (cStreams > 1 && pState->muPort >= UINT16_MAX))
+        return teleporterTcpWriteNACK(pState, VERR_OUT_OF_RANGE);
+
+    if (cStreams == 1)
+    {
+        vrc = teleporterTcpWriteACK(pState);
+        if (RT_SUCCESS(vrc))
+            vrc = teleporterTcpWriteACK(pState);
+        if (RT_SUCCESS(vrc))
+            pState->mfStreams = true;
+        return vrc;
+    }
+
+    /*
+     * Listen for the additional connections on the next port, giving the
+     * source 30 seconds to connect them.  The timer stops the accepting, the
+     * deadline the reading of the introductions.
+     */
+    PRTTCPSERVER hServer;
+    vrc = RTTcpServerCreateEx(pState->mstrAddress.isEmpty() ? NULL : pState->mstrAddress.c_str(), pState->muPort + 1, &hServer);
+    if (RT_FAILURE(vrc))
+    {
+        LogRel(("Teleporter: Failed to listen for streams on port %u: %Rrc\n", pState->muPort + 1, vrc));
+        return teleporterTcpWriteNACK(pState, vrc);
+    }
+    RTTIMERLR hTimerLR;
+    vrc = RTTimerLRCreateEx(&hTimerLR, 0 /*ns*/, RTTIMER_FLAGS_CPU_ANY, teleporterDstTimeout, hServer);
+    if (RT_SUCCESS(vrc))
+    {
+        vrc = RTTimerLRStart(hTimerLR, 30 * RT_NS_1SEC_64);
+        if (RT_FAILURE(vrc))
+            RTTimerLRDestroy(hTimerLR);
+    }
+    if (RT_FAILURE(vrc))
+    {
+        RTTcpServerDestroy(hServer);
+        return teleporterTcpWriteNACK(pState, vrc);
+    }
+    ASMAtomicWritePtr(&pState->mhStreamServer, hServer);
+
+    uint64_t const msDeadline = RTTimeMilliTS() + 30 * RT_MS_1SEC;
+    vrc = teleporterTcpWriteACK(pState);
+    uint32_t cAttached = 1;
+    while (RT_SUCCESS(vrc) && cAttached < cStreams)
+    {
+        RTSOCKET hSocket;
+        vrc = RTTcpServerListen2(hServer, &hSocket);
+        if (RT_FAILURE(vrc))
+        {
+            LogRel(("Teleporter: RTTcpServerListen2 -> %Rrc (%u of %u streams attached)\n", vrc, cAttached, cStreams));
+            break;
+        }
+
+        /* "<cookie>;<index>"  The source sends it right after connecting, so
+           don't let a silent or dribbling client hold up the real ones for long. */
+        char szLine[128];
+        vrc = teleporterTcpReadLineEx(hSocket, szLine, sizeof(szLine),
+                                      RT_MIN(RTTimeMilliTS() + TELEPORTER_STREAM_INTRO_TIMEOUT_MS, msDeadline),
+                                      &pState->mfStreamsCancelled);
+        char    *pszIdx = RT_SUCCESS(vrc) ? strchr(szLine, ';') : NULL;
+        uint32_t idx    = 0;
+        if (pszIdx)
+        {
+            *pszIdx++ = '\0';
+            if (RTStrToUInt32Full(pszIdx, 10, &idx) != VINF_SUCCESS)
+                idx = 0;
+        }
+        if (   idx >= 1
+            && idx < cStreams
+            && pState->mahStreamSockets[idx] == NIL_RTSOCKET
+            && teleporterCookieEquals(szLine, pszCookie))
+        {
+            pState->mahStreamSockets[idx] = hSocket;
+            cAttached++;
+        }
+        else
+        {
+            LogRel(("Teleporter: Rejected stream connection (%Rrc)\n", vrc));
+            RTTcpServerDisconnectClient2(hSocket);
+        }
+        if (vrc == VERR_CANCELLED)
+            break;
+        vrc = VINF_SUCCESS;
+    }
+
+    RTTimerLRDestroy(hTimerLR);
+    ASMAtomicWriteNullPtr(&pState->mhStreamServer);
+    RTTcpServerDestroy(hServer);
+
+    if (RT_SUCCESS(vrc))
+    {
+        pState->mcStreams = cStreams;
+        pState->mfStreams = true;
+        LogRel(("Teleporter: Attached %u streams.\n", cStreams));
+        return teleporterTcpWriteACK(pState);
+    }
+    teleporterCloseStreamSockets(pState);
+    teleporterTcpWriteNACK(pState, vrc);
+    return vrc;
+}
+
+
 /**
  * @copydoc FNRTTCPSERVE
  *
@@ -1343,6 +1829,13 @@ Console::i_teleporterTrgServeConnection(RTSOCKET hSocket, void *pvUser)
             if (RT_FAILURE(vrc))
                 break;
 
+            vrc = teleporterCreateStreams(pState, 0 /*fFlags*/);
+            if (RT_FAILURE(vrc))
+            {
+                teleporterTcpWriteNACK(pState, vrc);
+                break;
+            }
+
             int vrc2 = VMR3AtErrorRegister(pState->mpUVM,
                                            Console::i_genericVMSetErrorCallback, &pState->mErrorText); AssertRC(vrc2);
             RTSocketRetain(pState->mhSocket); /* For concurrent access by I/O thread and EMT. */
@@ -1366,8 +1859,12 @@ Console::i_teleporterTrgServeConnection(RTSOCKET hSocket, void *pvUser)
 
             /* The EOS might not have been read, make sure it is. */
             pState->mfStopReading = false;
+            if (pState->mpStreams)
+                TeleporterStreamsStopReading(pState->mpStreams, false);
             size_t cbRead;
             vrc = teleporterTcpOpRead(pvUser2, pState->moffStream, szCmd, 1, &cbRead);
+            teleporterDestroyStreams(pState);
+            teleporterCloseStreamSockets(pState);
             if (vrc != VERR_EOF)
             {
                 LogRel(("Teleporter: Draining teleporterTcpOpRead -> %Rrc\n", vrc));
@@ -1377,6 +1874,8 @@ Console::i_teleporterTrgServeConnection(RTSOCKET hSocket, void *pvUser)
 
             vrc = teleporterTcpWriteACK(pState);
         }
+        else if (!strncmp(szCmd, RT_STR_TUPLE("streams=")))
+            vrc = teleporterTrgAttachStreams(pState, &szCmd[sizeof("streams=") - 1]);
         else if (!strcmp(szCmd, "cancel"))
         {
             /* Don't ACK this. */
@@ -1446,6 +1945,8 @@ Console::i_teleporterTrgServeConnection(RTSOCKET hSocket, void *pvUser)
         vrc = VERR_WRONG_ORDER;
     if (RT_FAILURE(vrc))
         teleporterTrgUnlockMedia(pState);
+    teleporterDestroyStreams(pState);
+    teleporterCloseStreamSockets(pState);
 
     pState->mRc = vrc;
     pState->mhSocket = NIL_RTSOCKET;
@@ -124,6 +124,11 @@ HRESULT Display::FinalConstruct()
     rc = RTCritSectInit(&mVideoAccelLock);
     AssertRC(rc);
 
+    rc = RTCritSectInit(&mSnapshotLock);
+    AssertRC(rc);
+    rc = RTCritSectInit(&mSnapshotDirtyLock);
+    AssertRC(rc);
+
 #ifdef VBOX_WITH_HGSMI
     mu32UpdateVBVAFlags = 0;
     mfVMMDevSupportsGraphics = false;
@@ -181,6 +186,18 @@ void Display::FinalRelease()
         RT_ZERO(mVideoAccelLock);
     }
 
+    if (RTCritSectIsInitialized(&mSnapshotLock))
+    {
+        RTCritSectDelete(&mSnapshotLock);
+        RT_ZERO(mSnapshotLock);
+    }
+
+    if (RTCritSectIsInitialized(&mSnapshotDirtyLock))
+    {
+        RTCritSectDelete(&mSnapshotDirtyLock);
+        RT_ZERO(mSnapshotDirtyLock);
+    }
+
 #ifdef VBOX_WITH_CRHGSMI
     if (RTCritSectRwIsInitialized(&mCrOglLock))
     {
@@ -669,6 +686,10 @@ HRESULT Display::init(Console *aParent)
 #endif /* VBOX_WITH_HGSMI */
 #ifdef VBOX_WITH_CROGL
         RT_ZERO(maFramebuffers[ul].pendingViewportInfo);
+#endif
+        RT_ZERO(maFramebuffers[ul].snapshot);
+#ifdef VBOX_WITH_VIDEOREC
+        RT_ZERO(maFramebuffers[ul].videoCapture.DirtyRect);
 #endif
     }
 
@@ -718,6 +739,7 @@ void Display::uninit()
 #ifdef VBOX_WITH_VIDEOREC
         maFramebuffers[uScreenId].videoCapture.pSourceBitmap.setNull();
 #endif
+        i_snapshotFree(uScreenId);
     }
 
     if (mParent)
@@ -779,6 +801,11 @@ int Display::i_registerSSM(PUVM pUVM)
 
     AssertRCReturn(rc, rc);
 
+#ifdef VBOX_WITH_VIDEOREC
+    rc = DBGFR3InfoRegisterExternal(pUVM, "videorec", "Display video recording statistics.", i_videoCaptureInfo, this);
+    AssertRC(rc);
+#endif
+
     return VINF_SUCCESS;
 }
 
@@ -928,6 +955,8 @@ int Display::i_handleDisplayResize(unsigned uScreenId, uint32_t bpp, void *pvVRA
         pFBInfo->flags = flags;
     }
 
+    i_snapshotUpdateSource(uScreenId);
+
     /* Guest screen image will be invalid during resize, make sure that it is not updated. */
     if (uScreenId == VBOX_VIDEO_PRIMARY_SCREEN)
     {
@@ -1056,6 +1085,15 @@ void Display::i_handleDisplayUpdate(unsigned uScreenId, int x, int y, int w, int
     i_checkCoordBounds(&x, &y, &w, &h, maFramebuffers[uScreenId].w,
                                        maFramebuffers[uScreenId].h);
 
+    if (w != 0 && h != 0)
+    {
+        i_snapshotInvalidateRect(uScreenId, x, y, w, h);
+#ifdef VBOX_WITH_VIDEOREC
+        if (mpVideoRecCtx && maVideoRecEnabled[uScreenId])
+            i_videoCaptureInvalidateRect(uScreenId, x, y, w, h);
+#endif
+    }
+
     IFramebuffer *pFramebuffer = maFramebuffers[uScreenId].pFramebuffer;
     if (pFramebuffer != NULL)
     {
@@ -2111,6 +2149,314 @@ static int i_displayTakeScreenshot(PUVM pUVM, Display *pDisplay, struct DRVMAIND
     return vrc;
 }
 
+/** The screenshot shadow copy is rescaled completely when it is older than this,
+ * in case the guest modified the VRAM without reporting it. */
+#define DISPLAY_SNAPSHOT_MAX_AGE_MS 5000
+
+/**
+ * Extends a rectangle to cover another one.
+ *
+ * @param pRect     The rectangle to extend, may be empty.
+ * @param pAdd      The rectangle to add, ignored if empty.
+ */
+static void displaySnapshotUnionRect(RTRECT *pRect, const RTRECT *pAdd)
+{
+    if (pAdd->xLeft >= pAdd->xRight)
+        return;
+    if (pRect->xLeft >= pRect->xRight)
+        *pRect = *pAdd;
+    else
+    {
+        pRect->xLeft   = RT_MIN(pRect->xLeft, pAdd->xLeft);
+        pRect->yTop    = RT_MIN(pRect->yTop, pAdd->yTop);
+        pRect->xRight  = RT_MAX(pRect->xRight, pAdd->xRight);
+        pRect->yBottom = RT_MAX(pRect->yBottom, pAdd->yBottom);
+    }
+}
+
+/**
+ * Updates the source information of the screenshot shadow copy after the
+ * screen has been resized or VBVA was disabled.
+ *
+ * @param uScreenId The screen.
+ */
+void Display::i_snapshotUpdateSource(unsigned uScreenId)
+{
+    DISPLAYFBINFO *pFBInfo = &maFramebuffers[uScreenId];
+
+    RTCritSectEnter(&mSnapshotDirtyLock);
+
+    /* Only 32bpp VBVA screens are read directly, the VGA modes need the device
+     * to render the image and are handled by the EMT. So are the screens which
+     * might be rendered by the 3D service.
+     */
+    bool fUsable = false;
+#ifdef VBOX_WITH_HGSMI
+    fUsable =    pFBInfo->fVBVAEnabled
+              && !mfIsCr3DEnabled
+              && !pFBInfo->fDisabled
+              && pFBInfo->u16BitsPerPixel == 32
+              && pFBInfo->pu8FramebufferVRAM != NULL
+              && (pFBInfo->flags & (VBVA_SCREEN_F_ACTIVE | VBVA_SCREEN_F_DISABLED)) == VBVA_SCREEN_F_ACTIVE
+              && pFBInfo->w != 0
+              && pFBInfo->h != 0;
+#endif
+
+    pFBInfo->snapshot.fUsable = fUsable;
+    pFBInfo->snapshot.pu8VRAM = pFBInfo->pu8FramebufferVRAM;
+    pFBInfo->snapshot.cbLine  = pFBInfo->u32LineSize;
+    pFBInfo->snapshot.cx      = pFBInfo->w;
+    pFBInfo->snapshot.cy      = pFBInfo->h;
+    pFBInfo->snapshot.uGeneration++;
+    RT_ZERO(pFBInfo->snapshot.DirtyRect);
+
+    RTCritSectLeave(&mSnapshotDirtyLock);
+}
+
+/**
+ * Adds an updated area of the screen to the dirty rectangle of the shadow copy.
+ *
+ * @param uScreenId The screen.
+ * @param x         The left edge, within the screen.
+ * @param y         The top edge, within the screen.
+ * @param w         The width, not zero.
+ * @param h         The height, not zero.
+ */
+void Display::i_snapshotInvalidateRect(unsigned uScreenId, int x, int y, int w, int h)
+{
+    DISPLAYFBINFO *pFBInfo = &maFramebuffers[uScreenId];
+
+    /* Nothing to do until someone takes a screenshot. */
+    if (!ASMAtomicReadBool(&pFBInfo->snapshot.fActive))
+        return;
+
+    RTRECT const Rect = { x, y, x + w, y + h };
+    RTCritSectEnter(&mSnapshotDirtyLock);
+    displaySnapshotUnionRect(&pFBInfo->snapshot.DirtyRect, &Rect);
+    RTCritSectLeave(&mSnapshotDirtyLock);
+}
+
+/**
+ * Takes a screenshot from the scaled shadow copy of the screen.
+ *
+ * The shadow copy is updated from VRAM on the calling thread. Only the part
+ * of it covering the areas reported by i_handleDisplayUpdate since it was last
+ * used is rescaled, unless the screen mode changed. Copies are kept for the
+ * DISPLAY_SNAPSHOT_SCALED_MAX most recently requested sizes.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_NOT_SUPPORTED if the screen must be copied on the EMT, see
+ *          i_displayTakeScreenshot.
+ * @param aScreenId The screen.
+ * @param pbDst     Where to return the 32bpp image.
+ * @param cx        The width of the image.
+ * @param cy        The height of the image.
+ * @param puSeq     Where to return the sequence number of the image, for the
+ *                  PNG cache.
+ */
+int Display::i_snapshotTake(ULONG aScreenId, uint8_t *pbDst, uint32_t cx, uint32_t cy, uint32_t *puSeq)
+{
+    if (aScreenId >= mcMonitors)
+        return VERR_NOT_SUPPORTED;
+
+    DISPLAYFBINFO *pFBInfo = &maFramebuffers[aScreenId];
+
+    RTCritSectEnter(&mSnapshotLock);
+
+    /* Fetch the source and the dirty rectangle. */
+    RTCritSectEnter(&mSnapshotDirtyLock);
+    bool const      fUsable     = pFBInfo->snapshot.fUsable;
+    const uint8_t  *pu8Src      = pFBInfo->snapshot.pu8VRAM;
+    uint32_t const  cbSrcLine   = pFBInfo->snapshot.cbLine;
+    uint32_t const  cxSrc       = pFBInfo->snapshot.cx;
+    uint32_t const  cySrc       = pFBInfo->snapshot.cy;
+    uint32_t const  uGeneration = pFBInfo->snapshot.uGeneration;
+    RTRECT const    DirtyRect   = pFBInfo->snapshot.DirtyRect;
+    if (fUsable)
+    {
+        ASMAtomicWriteBool(&pFBInfo->snapshot.fActive, true);
+        RT_ZERO(pFBInfo->snapshot.DirtyRect);
+    }
+    RTCritSectLeave(&mSnapshotDirtyLock);
+
+    if (!fUsable)
+    {
+        RTCritSectLeave(&mSnapshotLock);
+        return VERR_NOT_SUPPORTED;
+    }
+
+    /* Pass the dirty area on to the copies and look up the one with the requested size.
+     * A new size replaces the least recently used copy, so callers alternating between
+     * a few sizes (thumbnails and full screenshots, say) do not rescale every time. */
+    uint32_t const uUse = ++pFBInfo->snapshot.uUseCount;
+    DISPLAYSNAPSHOTSCALED *pScaled = NULL;
+    DISPLAYSNAPSHOTSCALED *pLRU    = &pFBInfo->snapshot.aScaled[0];
+    for (unsigned i = 0; i < RT_ELEMENTS(pFBInfo->snapshot.aScaled); i++)
+    {
+        DISPLAYSNAPSHOTSCALED *pCur = &pFBInfo->snapshot.aScaled[i];
+        if (pCur->pu8Scaled)
+        {
+            displaySnapshotUnionRect(&pCur->DirtyRect, &DirtyRect);
+            if (pCur->cxScaled == cx && pCur->cyScaled == cy)
+                pScaled = pCur;
+        }
+        if (   pLRU->pu8Scaled
+            && (   !pCur->pu8Scaled
+                || uUse - pCur->uLastUse > uUse - pLRU->uLastUse))
+            pLRU = pCur;
+    }
+
+    int rc = VINF_SUCCESS;
+    if (!pScaled)
+    {
+        pScaled = pLRU;
+        RTMemFree(pScaled->pu8Scaled);
+        pScaled->pu8Scaled = (uint8_t *)RTMemAlloc((size_t)cx * 4 * cy);
+        pScaled->cxScaled = cx;
+        pScaled->cyScaled = cy;
+        pScaled->uScaledGeneration = uGeneration - 1; /* Forces a full update. */
+        RT_ZERO(pScaled->DirtyRect);
+        if (!pScaled->pu8Scaled)
+            rc = VERR_NO_MEMORY;
+    }
+    pScaled->uLastUse = uUse;
+
+    if (RT_SUCCESS(rc))
+    {
+        RTRECT const ScaledDirtyRect = pScaled->DirtyRect;
+        RT_ZERO(pScaled->DirtyRect);
+
+        uint64_t const u64Now = RTTimeMilliTS();
+        bool fUpdated = false;
+        if (   pScaled->uScaledGeneration != uGeneration
+            || u64Now - pScaled->u64ScaledTS >= DISPLAY_SNAPSHOT_MAX_AGE_MS)
+        {
+            rc = BitmapScale32Rect(pScaled->pu8Scaled, cx * 4, cx, cy,
+                                   pu8Src, cbSrcLine, cxSrc, cySrc,
+                                   0, 0, cx, cy);
+            pScaled->uScaledGeneration = uGeneration;
+            pScaled->u64ScaledTS = u64Now;
+            fUpdated = true;
+        }
+        else if (   ScaledDirtyRect.xLeft < ScaledDirtyRect.xRight
+                 && (uint32_t)ScaledDirtyRect.xLeft < cxSrc
+                 && (uint32_t)ScaledDirtyRect.yTop < cySrc)
+        {
+            /* The destination pixels whose footprint intersects the dirty rectangle. An update
+             * racing a resize may exceed the screen, hence the clipping. */
+            uint32_t const xLeft   = (uint32_t)((uint64_t)ScaledDirtyRect.xLeft * cx / cxSrc);
+            uint32_t const yTop    = (uint32_t)((uint64_t)ScaledDirtyRect.yTop * cy / cySrc);
+            uint32_t const xRight  = RT_MIN((uint32_t)(((uint64_t)ScaledDirtyRect.xRight * cx + cxSrc - 1) / cxSrc), cx);
+            uint32_t const yBottom = RT_MIN((uint32_t)(((uint64_t)ScaledDirtyRect.yBottom * cy + cySrc - 1) / cySrc), cy);
+            rc = BitmapScale32Rect(pScaled->pu8Scaled, cx * 4, cx, cy,
+                                   pu8Src, cbSrcLine, cxSrc, cySrc,
+                                   xLeft, yTop, xRight - xLeft, yBottom - yTop);
+            fUpdated = true;
+        }
+
+        if (RT_SUCCESS(rc))
+        {
+            if (fUpdated)
+                pScaled->uSeq = ++pFBInfo->snapshot.uSeq;
+            memcpy(pbDst, pScaled->pu8Scaled, (size_t)cx * 4 * cy);
+            *puSeq = pScaled->uSeq;
+        }
+    }
+
+    if (RT_FAILURE(rc))
+    {
+        /* Start from scratch next time. */
+        RTMemFree(pScaled->pu8Scaled);
+        pScaled->pu8Scaled = NULL;
+    }
+
+    RTCritSectLeave(&mSnapshotLock);
+    return rc;
+}
+
+/**
+ * Returns the cached PNG of the shadow copy if it is still current.
+ *
+ * @returns true if the PNG was copied to pbDst.
+ * @param aScreenId The screen.
+ * @param uSeq      The sequence number returned by i_snapshotTake.
+ * @param pbDst     Where to copy the PNG.
+ * @param cbDst     The size of the buffer.
+ * @param pcbPNG    Where to return the size of the PNG.
+ */
+bool Display::i_snapshotQueryPNG(ULONG aScreenId, uint32_t uSeq, uint8_t *pbDst, size_t cbDst, uint32_t *pcbPNG)
+{
+    DISPLAYFBINFO *pFBInfo = &maFramebuffers[aScreenId];
+    bool fFound = false;
+
+    RTCritSectEnter(&mSnapshotLock);
+    if (   pFBInfo->snapshot.pu8PNG
+        && pFBInfo->snapshot.uSeqPNG == uSeq
+        && pFBInfo->snapshot.cbPNG <= cbDst)
+    {
+        memcpy(pbDst, pFBInfo->snapshot.pu8PNG, pFBInfo->snapshot.cbPNG);
+        *pcbPNG = pFBInfo->snapshot.cbPNG;
+        fFound = true;
+    }
+    RTCritSectLeave(&mSnapshotLock);
+
+    return fFound;
+}
+
+/**
+ * Caches the PNG made from a shadow copy image.
+ *
+ * @param aScreenId The screen.
+ * @param uSeq      The sequence number returned by i_snapshotTake.
+ * @param pbPNG     The PNG.
+ * @param cbPNG     The size of the PNG.
+ */
+void Display::i_snapshotStorePNG(ULONG aScreenId, uint32_t uSeq, const uint8_t *pbPNG, uint32_t cbPNG)
+{
+    DISPLAYFBINFO *pFBInfo = &maFramebuffers[aScreenId];
+
+    RTCritSectEnter(&mSnapshotLock);
+    /* Another caller may have updated the shadow copy meanwhile. */
+    bool fCurrent = false;
+    for (unsigned i = 0; i < RT_ELEMENTS(pFBInfo->snapshot.aScaled); i++)
+        if (   pFBInfo->snapshot.aScaled[i].pu8Scaled
+            && pFBInfo->snapshot.aScaled[i].uSeq == uSeq)
+            fCurrent = true;
+    if (fCurrent)
+    {
+        uint8_t *pu8PNG = (uint8_t *)RTMemDup(pbPNG, cbPNG);
+        if (pu8PNG)
+        {
+            RTMemFree(pFBInfo->snapshot.pu8PNG);
+            pFBInfo->snapshot.pu8PNG = pu8PNG;
+            pFBInfo->snapshot.cbPNG = cbPNG;
+            pFBInfo->snapshot.uSeqPNG = uSeq;
+        }
+    }
+    RTCritSectLeave(&mSnapshotLock);
+}
+
+/**
+ * Frees the shadow copy of a screen.
+ *
+ * @param uScreenId The screen.
+ */
+void Display::i_snapshotFree(unsigned uScreenId)
+{
+    DISPLAYFBINFO *pFBInfo = &maFramebuffers[uScreenId];
+
+    RTCritSectEnter(&mSnapshotLock);
+    for (unsigned i = 0; i < RT_ELEMENTS(pFBInfo->snapshot.aScaled); i++)
+    {
+        RTMemFree(pFBInfo->snapshot.aScaled[i].pu8Scaled);
+        pFBInfo->snapshot.aScaled[i].pu8Scaled = NULL;
+    }
+    RTMemFree(pFBInfo->snapshot.pu8PNG);
+    pFBInfo->snapshot.pu8PNG = NULL;
+    pFBInfo->snapshot.cbPNG = 0;
+    RTCritSectLeave(&mSnapshotLock);
+}
+
 HRESULT Display::takeScreenShotWorker(ULONG aScreenId,
                                       BYTE *aAddress,
                                       ULONG aWidth,
@@ -2139,7 +2485,11 @@ HRESULT Display::takeScreenShotWorker(ULONG aScreenId,
     if (!ptrVM.isOk())
         return ptrVM.rc();
 
-    int vrc = i_displayTakeScreenshot(ptrVM.rawUVM(), this, mpDrv, aScreenId, aAddress, aWidth, aHeight);
+    /* Use the shadow copy if possible, it does not involve the EMT. */
+    uint32_t uSeq = 0;
+    int vrc = i_snapshotTake(aScreenId, aAddress, aWidth, aHeight, &uSeq);
+    if (vrc == VERR_NOT_SUPPORTED)
+        vrc = i_displayTakeScreenshot(ptrVM.rawUVM(), this, mpDrv, aScreenId, aAddress, aWidth, aHeight);
 
     if (RT_SUCCESS(vrc))
     {
@@ -2182,11 +2532,20 @@ HRESULT Display::takeScreenShotWorker(ULONG aScreenId,
             uint32_t cxPNG = 0;
             uint32_t cyPNG = 0;
 
+            if (uSeq && i_snapshotQueryPNG(aScreenId, uSeq, aAddress, cbData, &cbPNG))
+            {
+                /* The screen did not change since the PNG was made. */
+                *pcbOut = cbPNG;
+                return rc;
+            }
+
             vrc = DisplayMakePNG(aAddress, aWidth, aHeight, &pu8PNG, &cbPNG, &cxPNG, &cyPNG, 0);
             if (RT_SUCCESS(vrc))
             {
                 if (cbPNG <= cbData)
                 {
+                    if (uSeq)
+                        i_snapshotStorePNG(aScreenId, uSeq, pu8PNG, cbPNG);
                     memcpy(aAddress, pu8PNG, cbPNG);
                     *pcbOut = cbPNG;
                 }
@@ -2318,7 +2677,9 @@ int Display::i_videoCaptureStart(void)
     if (VideoRecIsEnabled(mpVideoRecCtx))
         return VINF_SUCCESS;
 
-    int rc = VideoRecContextCreate(mcMonitors, &mpVideoRecCtx);
+    /* The statistics are registered with STAM if there is a VM. */
+    Console::SafeVMPtrQuiet ptrVM(mParent);
+    int rc = VideoRecContextCreate(mcMonitors, ptrVM.isOk() ? ptrVM.rawUVM() : NULL, &mpVideoRecCtx);
     if (RT_FAILURE(rc))
     {
         LogFlow(("Failed to create video recording context (%Rrc)!\n", rc));
@@ -2433,8 +2794,11 @@ void Display::i_videoCaptureStop()
     if (!VideoRecIsEnabled(mpVideoRecCtx))
         return;
 
+    /* The lock keeps the debugger info handler away from the context. */
+    RTCritSectEnter(&mVideoCaptureLock);
     VideoRecContextDestroy(mpVideoRecCtx);
     mpVideoRecCtx = NULL;
+    RTCritSectLeave(&mVideoCaptureLock);
 
     unsigned uScreenId;
     for (uScreenId = 0; uScreenId < mcMonitors; ++uScreenId)
@@ -2461,10 +2825,84 @@ void Display::videoCaptureScreenChanged(unsigned uScreenId)
     {
         maFramebuffers[uScreenId].videoCapture.pSourceBitmap = pSourceBitmap;
 
+        /* The new bitmap must be recorded completely. */
+        RTRECT *pDirtyRect = &maFramebuffers[uScreenId].videoCapture.DirtyRect;
+        pDirtyRect->xLeft   = 0;
+        pDirtyRect->yTop    = 0;
+        pDirtyRect->xRight  = (int32_t)maFramebuffers[uScreenId].w;
+        pDirtyRect->yBottom = (int32_t)maFramebuffers[uScreenId].h;
+
         rc2 = RTCritSectLeave(&mVideoCaptureLock);
         AssertRC(rc2);
     }
 }
+
+/**
+ * Adds an updated area of a guest screen to the area which the next
+ * recorded frame has to take over from the source bitmap.
+ *
+ * Any thread, must not hold mVideoCaptureLock.
+ */
+void Display::i_videoCaptureInvalidateRect(unsigned uScreenId, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    int rc2 = RTCritSectEnter(&mVideoCaptureLock);
+    if (RT_SUCCESS(rc2))
+    {
+        RTRECT *pDirtyRect = &maFramebuffers[uScreenId].videoCapture.DirtyRect;
+        if (pDirtyRect->xLeft >= pDirtyRect->xRight || pDirtyRect->yTop >= pDirtyRect->yBottom)
+        {
+            pDirtyRect->xLeft   = x;
+            pDirtyRect->yTop    = y;
+            pDirtyRect->xRight  = x + w;
+            pDirtyRect->yBottom = y + h;
+        }
+        else
+        {
+            pDirtyRect->xLeft   = RT_MIN(pDirtyRect->xLeft,   x);
+            pDirtyRect->yTop    = RT_MIN(pDirtyRect->yTop,    y);
+            pDirtyRect->xRight  = RT_MAX(pDirtyRect->xRight,  x + w);
+            pDirtyRect->yBottom = RT_MAX(pDirtyRect->yBottom, y + h);
+        }
+
+        rc2 = RTCritSectLeave(&mVideoCaptureLock);
+        AssertRC(rc2);
+    }
+}
+
+/**
+ * @callback_method_impl{FNDBGFHANDLEREXT,
+ *      Prints the video recording statistics of the guest screens.}
+ */
+DECLCALLBACK(void) Display::i_videoCaptureInfo(void *pvUser, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    RT_NOREF(pszArgs);
+    Display *pThis = (Display *)pvUser;
+
+    int rc2 = RTCritSectEnter(&pThis->mVideoCaptureLock);
+    if (RT_FAILURE(rc2))
+        return;
+
+    if (VideoRecIsEnabled(pThis->mpVideoRecCtx))
+    {
+        for (unsigned uScreenId = 0; uScreenId < pThis->mcMonitors; uScreenId++)
+        {
+            VIDEORECSTATS Stats;
+            if (RT_FAILURE(VideoRecQueryStats(pThis->mpVideoRecCtx, uScreenId, &Stats)))
+                continue;
+            pHlp->pfnPrintf(pHlp,
+                            "Screen #%u: %RU64 frames submitted, %RU64 encoded, %RU64 unchanged, %RU64 dropped\n"
+                            "            encode latency avg %RU64 us, max %RU64 us\n",
+                            uScreenId, Stats.cFramesSubmitted, Stats.cFramesEncoded, Stats.cFramesUnchanged,
+                            Stats.cFramesDropped,
+                            Stats.cFramesEncoded ? Stats.cNsEncodeTotal / Stats.cFramesEncoded / 1000 : 0,
+                            Stats.cNsEncodeMax / 1000);
+        }
+    }
+    else
+        pHlp->pfnPrintf(pHlp, "Video recording is not active\n");
+
+    RTCritSectLeave(&pThis->mVideoCaptureLock);
+}
 #endif /* VBOX_WITH_VIDEOREC */
 
 int Display::i_drawToScreenEMT(Display *pDisplay, ULONG aScreenId, BYTE *address,
@@ -3122,6 +3560,23 @@ DECLCALLBACK(void) Display::i_displayUpdateCallback(PPDMIDISPLAYCONNECTOR pInter
     pDrv->pDisplay->i_handleDisplayUpdate(VBOX_VIDEO_PRIMARY_SCREEN, x, y, cx, cy);
 }
 
+/**
+ * Handle a batch of display updates.
+ *
+ * @see PDMIDISPLAYCONNECTOR::pfnUpdateRects
+ */
+DECLCALLBACK(void) Display::i_displayUpdateRectsCallback(PPDMIDISPLAYCONNECTOR pInterface,
+                                                         PCRTRECT paRects, uint32_t cRects)
+{
+    PDRVMAINDISPLAY pDrv = PDMIDISPLAYCONNECTOR_2_MAINDISPLAY(pInterface);
+
+    for (uint32_t i = 0; i < cRects; i++)
+        pDrv->pDisplay->i_handleDisplayUpdate(VBOX_VIDEO_PRIMARY_SCREEN,
+                                              paRects[i].xLeft, paRects[i].yTop,
+                                              paRects[i].xRight - paRects[i].xLeft,
+                                              paRects[i].yBottom - paRects[i].yTop);
+}
+
 /**
  * Periodic display refresh callback.
  *
@@ -3218,10 +3673,13 @@ DECLCALLBACK(void) Display::i_displayUpdateCallback(PPDMIDISPLAYCONNECTOR pInter
                 if (!pFBInfo->fDisabled)
                 {
                     ComPtr<IDisplaySourceBitmap> pSourceBitmap;
+                    RTRECT DirtyRect = { 0, 0, 0, 0 };
                     int rc2 = RTCritSectEnter(&pDisplay->mVideoCaptureLock);
                     if (RT_SUCCESS(rc2))
                     {
                         pSourceBitmap = pFBInfo->videoCapture.pSourceBitmap;
+                        DirtyRect = pFBInfo->videoCapture.DirtyRect;
+                        RT_ZERO(pFBInfo->videoCapture.DirtyRect);
                         RTCritSectLeave(&pDisplay->mVideoCaptureLock);
                     }
 
@@ -3243,7 +3701,7 @@ DECLCALLBACK(void) Display::i_displayUpdateCallback(PPDMIDISPLAYCONNECTOR pInter
                             rc = VideoRecSendVideoFrame(pDisplay->mpVideoRecCtx, uScreenId, 0, 0,
                                                         BitmapFormat_BGR,
                                                         ulBitsPerPixel, ulBytesPerLine, ulWidth, ulHeight,
-                                                        pbAddress, u64Now);
+                                                        pbAddress, u64Now, &DirtyRect);
                         else
                             rc = VERR_NOT_SUPPORTED;
 
@@ -3252,6 +3710,14 @@ DECLCALLBACK(void) Display::i_displayUpdateCallback(PPDMIDISPLAYCONNECTOR pInter
                     else
                         rc = VERR_NOT_SUPPORTED;
 
+                    /* Frame not taken, keep the updates for the next one. */
+                    if (   rc != VINF_SUCCESS
+                        && DirtyRect.xLeft < DirtyRect.xRight
+                        && DirtyRect.yTop  < DirtyRect.yBottom)
+                        pDisplay->i_videoCaptureInvalidateRect(uScreenId, DirtyRect.xLeft, DirtyRect.yTop,
+                                                               DirtyRect.xRight - DirtyRect.xLeft,
+                                                               DirtyRect.yBottom - DirtyRect.yTop);
+
                     if (rc == VINF_TRY_AGAIN)
                         break;
                 }
@@ -3632,7 +4098,7 @@ void  Display::i_handleCrVRecScreenshotPerform(uint32_t uScreen,
                                     uPixelFormat,
                                     uBitsPerPixel, uBytesPerLine,
                                     uGuestWidth, uGuestHeight,
-                                    pu8BufferAddress, u64Timestamp);
+                                    pu8BufferAddress, u64Timestamp, NULL /* pDirtyRect */);
     NOREF(rc);
     Assert(rc == VINF_SUCCESS /* || rc == VERR_TRY_AGAIN || rc == VINF_TRY_AGAIN*/);
 # else
@@ -3887,6 +4353,9 @@ DECLCALLBACK(void) Display::i_displayVBVADisable(PPDMIDISPLAYCONNECTOR pInterfac
     pFBInfo->fVBVAForceResize = false;
     pFBInfo->fRenderThreadMode = false;
 
+    /* The VGA device takes over, the VRAM layout is no longer known. */
+    pThis->i_snapshotUpdateSource(uScreenId);
+
     vbvaSetMemoryFlagsHGSMI(uScreenId, 0, false, pFBInfo);
 
     pFBInfo->pVBVAHostFlags = NULL;
@@ -4350,6 +4819,7 @@ DECLCALLBACK(int) Display::i_drvConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, ui
 
     pThis->IConnector.pfnResize                = Display::i_displayResizeCallback;
     pThis->IConnector.pfnUpdateRect            = Display::i_displayUpdateCallback;
+    pThis->IConnector.pfnUpdateRects           = Display::i_displayUpdateRectsCallback;
     pThis->IConnector.pfnRefresh               = Display::i_displayRefreshCallback;
     pThis->IConnector.pfnReset                 = Display::i_displayResetCallback;
     pThis->IConnector.pfnLFBModeChange         = Display::i_displayLFBModeChangeCallback;
@@ -0,0 +1,920 @@
+/* $Id$ */
+/** @file
+ * Main - Teleporter multi-stream transport.
+ *
+ * This spreads the saved state stream of a teleportation across several TCP
+ * connections.  The stream is chopped up into fixed sized blocks which are
+ * given sequence numbers, optionally compressed, and handed to whichever
+ * connection is free first.  The receiving end has one reader thread per
+ * connection which decompresses the blocks and puts them back in order.
+ */
+
+/*
+ * Copyright (C) 2010-2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "TeleporterStreams.h"
+#include "Logging.h"
+
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/critsect.h>
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/tcp.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+#include <iprt/zip.h>
+
+#include <VBox/err.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The size of a data block. */
+#define TELEPORTERSTREAMS_BLOCK_SIZE        _256K
+/** The number of blocks per stream we keep in flight. */
+#define TELEPORTERSTREAMS_BLOCKS_PER_STREAM 2
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Multi-stream block header.
+ *
+ * Every block sent on any of the connections is prefixed by this.  The end of
+ * the stream is indicated on each of the connections by a header with the
+ * TELEPORTERSTREAMHDR_F_END flag set and uSeq set to the total block count.
+ */
+typedef struct TELEPORTERSTREAMHDR
+{
+    /** Magic value (TELEPORTERSTREAMHDR_MAGIC). */
+    uint32_t    u32Magic;
+    /** Flags, TELEPORTERSTREAMHDR_F_XXX. */
+    uint32_t    fFlags;
+    /** The number of bytes following the header. */
+    uint32_t    cbData;
+    /** The uncompressed size of the block. */
+    uint32_t    cbBlock;
+    /** The block sequence number. */
+    uint64_t    uSeq;
+} TELEPORTERSTREAMHDR;
+AssertCompileSize(TELEPORTERSTREAMHDR, 24);
+/** Magic value for TELEPORTERSTREAMHDR::u32Magic. (Hermeto Pascoal) */
+#define TELEPORTERSTREAMHDR_MAGIC           UINT32_C(0x19360622)
+/** The data is LZF compressed. */
+#define TELEPORTERSTREAMHDR_F_LZF           RT_BIT_32(0)
+/** End of stream, no data follows. */
+#define TELEPORTERSTREAMHDR_F_END           RT_BIT_32(1)
+/** The stream was cancelled (only valid with TELEPORTERSTREAMHDR_F_END). */
+#define TELEPORTERSTREAMHDR_F_CANCELLED     RT_BIT_32(2)
+/** Valid flag mask. */
+#define TELEPORTERSTREAMHDR_F_VALID_MASK    UINT32_C(0x00000007)
+
+
+/**
+ * Block states.
+ */
+typedef enum TELEPORTERBLOCKSTATE
+{
+    /** Unused. */
+    TELEPORTERBLOCKSTATE_FREE = 0,
+    /** Being filled by TeleporterStreamsWrite (source). */
+    TELEPORTERBLOCKSTATE_FILLING,
+    /** Full and waiting for a stream thread (source). */
+    TELEPORTERBLOCKSTATE_QUEUED,
+    /** Owned by a stream thread. */
+    TELEPORTERBLOCKSTATE_BUSY,
+    /** Received and waiting to be consumed by TeleporterStreamsRead (target). */
+    TELEPORTERBLOCKSTATE_READY
+} TELEPORTERBLOCKSTATE;
+
+
+/**
+ * A data block.
+ *
+ * The block for sequence number N is always paBlocks[N % cBlocks], which
+ * means we don't need any free lists and that the target can simply refuse
+ * blocks which would be too far ahead of the consumer.
+ */
+typedef struct TELEPORTERBLOCK
+{
+    /** The sequence number of the block. */
+    uint64_t                uSeq;
+    /** The block state. */
+    TELEPORTERBLOCKSTATE    enmState;
+    /** The number of valid bytes in the block. */
+    uint32_t                cb;
+    /** The read offset (target). */
+    uint32_t                off;
+    /** The block data (TELEPORTERSTREAMS_BLOCK_SIZE bytes). */
+    uint8_t                *pbData;
+} TELEPORTERBLOCK;
+/** Pointer to a data block. */
+typedef TELEPORTERBLOCK *PTELEPORTERBLOCK;
+
+
+/**
+ * Per connection data.
+ */
+typedef struct TELEPORTERSTREAM
+{
+    /** Pointer to the transport instance. */
+    struct TELEPORTERSTREAMS   *pParent;
+    /** The socket. */
+    RTSOCKET                    hSocket;
+    /** The thread servicing this connection. */
+    RTTHREAD                    hThread;
+    /** Event the thread waits on. */
+    RTSEMEVENT                  hEvt;
+    /** Compression buffer (TELEPORTERSTREAMS_BLOCK_SIZE bytes). */
+    uint8_t                    *pbZip;
+    /** The stream index. */
+    uint32_t                    idx;
+} TELEPORTERSTREAM;
+/** Pointer to per connection data. */
+typedef TELEPORTERSTREAM *PTELEPORTERSTREAM;
+
+
+/**
+ * Multi-stream transport instance.
+ */
+typedef struct TELEPORTERSTREAMS
+{
+    /** Set if this is the sending end. */
+    bool                    fIsSource;
+    /** Set when the threads should terminate. */
+    bool volatile           fShutdown;
+    /** Set when TeleporterStreamsRead should return VERR_EOF (target). */
+    bool volatile           fStopReading;
+    /** Set if the end-of-stream headers said the stream was cancelled (target). */
+    bool                    fCancelled;
+    /** TELEPORTERSTREAMS_F_XXX. */
+    uint32_t                fFlags;
+    /** The first error status. */
+    int32_t volatile        rc;
+    /** Critical section protecting the block states and sequence numbers. */
+    RTCRITSECT              CritSect;
+    /** Event the user (SSM) waits on. */
+    RTSEMEVENT              hEvtUser;
+
+    /** The block being filled by TeleporterStreamsWrite (source). */
+    PTELEPORTERBLOCK        pBlockFilling;
+    /** The sequence number of the block being filled (source) or consumed (target). */
+    uint64_t                uSeqNext;
+    /** Blocks below this sequence number have been queued for sending (source). */
+    uint64_t                uSeqQueued;
+    /** The next queued block to be picked up by a stream thread (source). */
+    uint64_t                uSeqClaim;
+    /** The sequence number from the end-of-stream headers (target). */
+    uint64_t                uSeqEnd;
+    /** The number of streams which have seen the end-of-stream header (target). */
+    uint32_t                cEnded;
+
+    /** The number of blocks. */
+    uint32_t                cBlocks;
+    /** The blocks. */
+    PTELEPORTERBLOCK        paBlocks;
+    /** The memory backing the block data. */
+    uint8_t                *pbMem;
+    /** The size of the memory backing the block data. */
+    size_t                  cbMem;
+
+    /** @name Statistics.
+     * @{ */
+    uint64_t volatile       cbStream;
+    uint64_t volatile       cbWire;
+    uint64_t volatile       cBlocksXferred;
+    uint64_t volatile       cBlocksCompressed;
+    uint64_t                nsStart;
+    /** @} */
+
+    /** The number of streams. */
+    uint32_t                cStreams;
+    /** The streams. */
+    TELEPORTERSTREAM        aStreams[1];
+} TELEPORTERSTREAMS;
+
+
+/**
+ * Sets the error status if it's the first one and wakes up everyone.
+ *
+ * @returns rc.
+ * @param   pThis       The transport instance.
+ * @param   rc          The failure status.
+ */
+static int teleporterStreamsSetError(PTELEPORTERSTREAMS pThis, int rc)
+{
+    ASMAtomicCmpXchgS32(&pThis->rc, rc, VINF_SUCCESS);
+    for (uint32_t i = 0; i < pThis->cStreams; i++)
+        RTSemEventSignal(pThis->aStreams[i].hEvt);
+    RTSemEventSignal(pThis->hEvtUser);
+    return rc;
+}
+
+
+/**
+ * Wakes up all the stream threads.
+ *
+ * @param   pThis       The transport instance.
+ */
+static void teleporterStreamsSignalThreads(PTELEPORTERSTREAMS pThis)
+{
+    for (uint32_t i = 0; i < pThis->cStreams; i++)
+        RTSemEventSignal(pThis->aStreams[i].hEvt);
+}
+
+
+/**
+ * Sends one block, compressing it if possible.
+ *
+ * @returns IPRT status code.
+ * @param   pStream     The stream to send it on.
+ * @param   pBlock      The block.
+ */
+static int teleporterStreamsSendBlock(PTELEPORTERSTREAM pStream, PTELEPORTERBLOCK pBlock)
+{
+    PTELEPORTERSTREAMS  pThis  = pStream->pParent;
+    TELEPORTERSTREAMHDR Hdr;
+    Hdr.u32Magic = TELEPORTERSTREAMHDR_MAGIC;
+    Hdr.fFlags   = 0;
+    Hdr.cbData   = pBlock->cb;
+    Hdr.cbBlock  = pBlock->cb;
+    Hdr.uSeq     = pBlock->uSeq;
+    void const *pvData = pBlock->pbData;
+
+    if (pThis->fFlags & TELEPORTERSTREAMS_F_LZF)
+    {
+        /* Only use the compressed data if it saves us something. */
+        size_t cbZip;
+        int rc = RTZipBlockCompress(RTZIPTYPE_LZF, RTZIPLEVEL_FAST, 0 /*fFlags*/, pBlock->pbData, pBlock->cb,
+                                    pStream->pbZip, pBlock->cb - pBlock->cb / 16, &cbZip);
+        if (RT_SUCCESS(rc))
+        {
+            Hdr.fFlags = TELEPORTERSTREAMHDR_F_LZF;
+            Hdr.cbData = (uint32_t)cbZip;
+            pvData     = pStream->pbZip;
+            ASMAtomicIncU64(&pThis->cBlocksCompressed);
+        }
+    }
+
+    int rc = RTTcpSgWriteL(pStream->hSocket, 2, &Hdr, sizeof(Hdr), pvData, (size_t)Hdr.cbData);
+    if (RT_SUCCESS(rc))
+    {
+        ASMAtomicAddU64(&pThis->cbWire, sizeof(Hdr) + Hdr.cbData);
+        ASMAtomicIncU64(&pThis->cBlocksXferred);
+    }
+    else
+        LogRel(("Teleporter/TCP#%u: Write error: %Rrc (uSeq=%#RX64 cb=%#x)\n", pStream->idx, rc, Hdr.uSeq, Hdr.cbData));
+    return rc;
+}
+
+
+/**
+ * Sending stream thread.
+ *
+ * Picks up queued blocks in sequence order and sends them.
+ */
+static DECLCALLBACK(int) teleporterStreamsSendThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    PTELEPORTERSTREAM   pStream = (PTELEPORTERSTREAM)pvUser;
+    PTELEPORTERSTREAMS  pThis   = pStream->pParent;
+
+    for (;;)
+    {
+        RTCritSectEnter(&pThis->CritSect);
+        while (   pThis->uSeqClaim == pThis->uSeqQueued
+               && !pThis->fShutdown
+               && RT_SUCCESS(pThis->rc))
+        {
+            RTCritSectLeave(&pThis->CritSect);
+            RTSemEventWait(pStream->hEvt, RT_INDEFINITE_WAIT);
+            RTCritSectEnter(&pThis->CritSect);
+        }
+        if (   pThis->uSeqClaim == pThis->uSeqQueued
+            || RT_FAILURE(pThis->rc))
+        {
+            RTCritSectLeave(&pThis->CritSect);
+            break;
+        }
+
+        PTELEPORTERBLOCK pBlock = &pThis->paBlocks[pThis->uSeqClaim % pThis->cBlocks];
+        Assert(pBlock->enmState == TELEPORTERBLOCKSTATE_QUEUED);
+        Assert(pBlock->uSeq == pThis->uSeqClaim);
+        pBlock->enmState = TELEPORTERBLOCKSTATE_BUSY;
+        pThis->uSeqClaim++;
+        RTCritSectLeave(&pThis->CritSect);
+
+        int rc = teleporterStreamsSendBlock(pStream, pBlock);
+
+        RTCritSectEnter(&pThis->CritSect);
+        pBlock->enmState = TELEPORTERBLOCKSTATE_FREE;
+        RTCritSectLeave(&pThis->CritSect);
+        if (RT_FAILURE(rc))
+        {
+            teleporterStreamsSetError(pThis, rc);
+            break;
+        }
+        RTSemEventSignal(pThis->hEvtUser);
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Waits for the socket to become readable, polling for shutdown.
+ *
+ * @returns IPRT status code, VERR_CANCELLED on shutdown.
+ * @param   pStream     The stream.
+ */
+static int teleporterStreamsReadSelect(PTELEPORTERSTREAM pStream)
+{
+    int rc;
+    do
+    {
+        if (pStream->pParent->fShutdown)
+            return VERR_CANCELLED;
+        rc = RTTcpSelectOne(pStream->hSocket, 1000);
+    } while (rc == VERR_TIMEOUT);
+    return rc;
+}
+
+
+/**
+ * Receives one block into the block array.
+ *
+ * @returns IPRT status code, VINF_EOF when the end-of-stream header has been
+ *          processed.
+ * @param   pStream     The stream.
+ */
+static int teleporterStreamsRecvBlock(PTELEPORTERSTREAM pStream)
+{
+    PTELEPORTERSTREAMS pThis = pStream->pParent;
+
+    /*
+     * Read and validate the header.
+     */
+    int rc = teleporterStreamsReadSelect(pStream);
+    if (RT_FAILURE(rc))
+        return rc;
+    TELEPORTERSTREAMHDR Hdr;
+    rc = RTTcpRead(pStream->hSocket, &Hdr, sizeof(Hdr), NULL);
+    if (RT_FAILURE(rc))
+    {
+        LogRel(("Teleporter/TCP#%u: Header read error: %Rrc\n", pStream->idx, rc));
+        return rc;
+    }
+    if (RT_UNLIKELY(   Hdr.u32Magic != TELEPORTERSTREAMHDR_MAGIC
+                    || (Hdr.fFlags & ~TELEPORTERSTREAMHDR_F_VALID_MASK)
+                    || Hdr.cbBlock > TELEPORTERSTREAMS_BLOCK_SIZE
+                    || Hdr.cbData > Hdr.cbBlock
+                    || (   !(Hdr.fFlags & TELEPORTERSTREAMHDR_F_END)
+                        && (   Hdr.cbBlock == 0
+                            || (Hdr.fFlags & TELEPORTERSTREAMHDR_F_CANCELLED)
+                            || (!(Hdr.fFlags & TELEPORTERSTREAMHDR_F_LZF) && Hdr.cbData != Hdr.cbBlock)))
+                    || (   (Hdr.fFlags & TELEPORTERSTREAMHDR_F_END)
+                        && (Hdr.cbData != 0 || Hdr.cbBlock != 0)) ))
+    {
+        LogRel(("Teleporter/TCP#%u: Invalid block: u32Magic=%#x fFlags=%#x cbData=%#x cbBlock=%#x uSeq=%#RX64\n",
+                pStream->idx, Hdr.u32Magic, Hdr.fFlags, Hdr.cbData, Hdr.cbBlock, Hdr.uSeq));
+        return VERR_IO_GEN_FAILURE;
+    }
+    ASMAtomicAddU64(&pThis->cbWire, sizeof(Hdr) + Hdr.cbData);
+
+    /*
+     * End of stream?
+     */
+    if (Hdr.fFlags & TELEPORTERSTREAMHDR_F_END)
+    {
+        RTCritSectEnter(&pThis->CritSect);
+        if (pThis->cEnded == 0)
+            pThis->uSeqEnd = Hdr.uSeq;
+        else if (pThis->uSeqEnd != Hdr.uSeq)
+            rc = VERR_IO_GEN_FAILURE;
+        if (Hdr.fFlags & TELEPORTERSTREAMHDR_F_CANCELLED)
+            pThis->fCancelled = true;
+        pThis->cEnded++;
+        RTCritSectLeave(&pThis->CritSect);
+        RTSemEventSignal(pThis->hEvtUser);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("Teleporter/TCP#%u: End of stream mismatch: %#RX64 vs %#RX64\n", pStream->idx, Hdr.uSeq, pThis->uSeqEnd));
+            return rc;
+        }
+        return VINF_EOF;
+    }
+
+    /*
+     * Wait for the block to be within the window.  The lowest sequence number
+     * not yet received is always within the window, so this cannot deadlock.
+     */
+    RTCritSectEnter(&pThis->CritSect);
+    while (   Hdr.uSeq - pThis->uSeqNext >= pThis->cBlocks
+           && Hdr.uSeq >= pThis->uSeqNext
+           && !pThis->fShutdown
+           && RT_SUCCESS(pThis->rc))
+    {
+        RTCritSectLeave(&pThis->CritSect);
+        RTSemEventWait(pStream->hEvt, RT_INDEFINITE_WAIT);
+        RTCritSectEnter(&pThis->CritSect);
+    }
+    if (pThis->fShutdown || RT_FAILURE(pThis->rc))
+    {
+        RTCritSectLeave(&pThis->CritSect);
+        return VERR_CANCELLED;
+    }
+    PTELEPORTERBLOCK pBlock = &pThis->paBlocks[Hdr.uSeq % pThis->cBlocks];
+    if (RT_UNLIKELY(   Hdr.uSeq < pThis->uSeqNext
+                    || pBlock->enmState != TELEPORTERBLOCKSTATE_FREE))
+    {
+        RTCritSectLeave(&pThis->CritSect);
+        LogRel(("Teleporter/TCP#%u: Unexpected block sequence number %#RX64 (next %#RX64)\n",
+                pStream->idx, Hdr.uSeq, pThis->uSeqNext));
+        return VERR_IO_GEN_FAILURE;
+    }
+    pBlock->enmState = TELEPORTERBLOCKSTATE_BUSY;
+    RTCritSectLeave(&pThis->CritSect);
+
+    /*
+     * Read the data and decompress it if necessary.
+     */
+    bool const fLzf = RT_BOOL(Hdr.fFlags & TELEPORTERSTREAMHDR_F_LZF);
+    rc = RTTcpRead(pStream->hSocket, fLzf ? pStream->pbZip : pBlock->pbData, Hdr.cbData, NULL);
+    if (RT_SUCCESS(rc))
+    {
+        if (fLzf)
+        {
+            size_t cbOut = 0;
+            rc = RTZipBlockDecompress(RTZIPTYPE_LZF, 0 /*fFlags*/, pStream->pbZip, Hdr.cbData, NULL,
+                                      pBlock->pbData, Hdr.cbBlock, &cbOut);
+            if (RT_SUCCESS(rc) && cbOut != Hdr.cbBlock)
+                rc = VERR_IO_GEN_FAILURE;
+            if (RT_FAILURE(rc))
+                LogRel(("Teleporter/TCP#%u: Decompression failed: %Rrc (cbOut=%#zx cbBlock=%#x)\n",
+                        pStream->idx, rc, cbOut, Hdr.cbBlock));
+            else
+                ASMAtomicIncU64(&pThis->cBlocksCompressed);
+        }
+    }
+    else
+        LogRel(("Teleporter/TCP#%u: Data read error: %Rrc (cb=%#x)\n", pStream->idx, rc, Hdr.cbData));
+
+    RTCritSectEnter(&pThis->CritSect);
+    if (RT_SUCCESS(rc))
+    {
+        pBlock->uSeq     = Hdr.uSeq;
+        pBlock->cb       = Hdr.cbBlock;
+        pBlock->off      = 0;
+        pBlock->enmState = TELEPORTERBLOCKSTATE_READY;
+    }
+    else
+        pBlock->enmState = TELEPORTERBLOCKSTATE_FREE;
+    RTCritSectLeave(&pThis->CritSect);
+
+    if (RT_SUCCESS(rc))
+    {
+        ASMAtomicIncU64(&pThis->cBlocksXferred);
+        RTSemEventSignal(pThis->hEvtUser);
+    }
+    return rc;
+}
+
+
+/**
+ * Receiving stream thread.
+ */
+static DECLCALLBACK(int) teleporterStreamsRecvThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    PTELEPORTERSTREAM pStream = (PTELEPORTERSTREAM)pvUser;
+
+    int rc;
+    do
+        rc = teleporterStreamsRecvBlock(pStream);
+    while (rc == VINF_SUCCESS);
+
+    if (RT_FAILURE(rc) && rc != VERR_CANCELLED)
+        teleporterStreamsSetError(pStream->pParent, rc);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Creates a multi-stream transport instance.
+ *
+ * @returns IPRT status code.
+ * @param   fIsSource       Set if this is the sending end, clear if it's
+ *                          the receiving end.
+ * @param   pahSockets      The connected sockets.  The caller remains the
+ *                          owner of these and must keep them open until
+ *                          after TeleporterStreamsDestroy returns.
+ * @param   cSockets        The number of sockets, 1 thru
+ *                          TELEPORTERSTREAMS_MAX.
+ * @param   fFlags          TELEPORTERSTREAMS_F_XXX.
+ * @param   ppThis          Where to return the instance handle.
+ */
+int TeleporterStreamsCreate(bool fIsSource, RTSOCKET const *pahSockets, uint32_t cSockets, uint32_t fFlags,
+                            PTELEPORTERSTREAMS *ppThis)
+{
+    AssertPtrReturn(ppThis, VERR_INVALID_POINTER);
+    *ppThis = NULL;
+    AssertPtrReturn(pahSockets, VERR_INVALID_POINTER);
+    AssertReturn(cSockets > 0 && cSockets <= TELEPORTERSTREAMS_MAX, VERR_OUT_OF_RANGE);
+    AssertReturn(!(fFlags & ~TELEPORTERSTREAMS_F_VALID_MASK), VERR_INVALID_FLAGS);
+
+    PTELEPORTERSTREAMS pThis = (PTELEPORTERSTREAMS)RTMemAllocZ(RT_OFFSETOF(TELEPORTERSTREAMS, aStreams[cSockets]));
+    if (!pThis)
+        return VERR_NO_MEMORY;
+    pThis->fIsSource = fIsSource;
+    pThis->fFlags    = fFlags;
+    pThis->rc        = VINF_SUCCESS;
+    pThis->hEvtUser  = NIL_RTSEMEVENT;
+    pThis->cStreams  = cSockets;
+    pThis->cBlocks   = cSockets * TELEPORTERSTREAMS_BLOCKS_PER_STREAM;
+    pThis->nsStart   = RTTimeNanoTS();
+    for (uint32_t i = 0; i < cSockets; i++)
+    {
+        pThis->aStreams[i].pParent = pThis;
+        pThis->aStreams[i].hSocket = pahSockets[i];
+        pThis->aStreams[i].hThread = NIL_RTTHREAD;
+        pThis->aStreams[i].hEvt    = NIL_RTSEMEVENT;
+        pThis->aStreams[i].idx     = i;
+    }
+
+    /*
+     * Allocate the blocks and the per stream compression buffers in one go.
+     */
+    int rc = VERR_NO_MEMORY;
+    pThis->paBlocks = (PTELEPORTERBLOCK)RTMemAllocZ(sizeof(pThis->paBlocks[0]) * pThis->cBlocks);
+    if (pThis->paBlocks)
+    {
+        pThis->cbMem = (size_t)(pThis->cBlocks + cSockets) * TELEPORTERSTREAMS_BLOCK_SIZE;
+        pThis->pbMem = (uint8_t *)RTMemPageAlloc(pThis->cbMem);
+        if (pThis->pbMem)
+        {
+            uint8_t *pb = pThis->pbMem;
+            for (uint32_t i = 0; i < pThis->cBlocks; i++, pb += TELEPORTERSTREAMS_BLOCK_SIZE)
+                pThis->paBlocks[i].pbData = pb;
+            for (uint32_t i = 0; i < cSockets; i++, pb += TELEPORTERSTREAMS_BLOCK_SIZE)
+                pThis->aStreams[i].pbZip = pb;
+            rc = VINF_SUCCESS;
+        }
+    }
+    if (RT_SUCCESS(rc))
+        rc = RTCritSectInit(&pThis->CritSect);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTSemEventCreate(&pThis->hEvtUser);
+        for (uint32_t i = 0; i < cSockets && RT_SUCCESS(rc); i++)
+            rc = RTSemEventCreate(&pThis->aStreams[i].hEvt);
+
+        /*
+         * Start the threads.
+         */
+        for (uint32_t i = 0; i < cSockets && RT_SUCCESS(rc); i++)
+            rc = RTThreadCreateF(&pThis->aStreams[i].hThread,
+                                 fIsSource ? teleporterStreamsSendThread : teleporterStreamsRecvThread,
+                                 &pThis->aStreams[i], 0 /*cbStack*/, RTTHREADTYPE_IO, RTTHREADFLAGS_WAITABLE,
+                                 fIsSource ? "TeleTx%u" : "TeleRx%u", i);
+        if (RT_SUCCESS(rc))
+        {
+            *ppThis = pThis;
+            return VINF_SUCCESS;
+        }
+
+        TeleporterStreamsDestroy(pThis);
+        return rc;
+    }
+
+    if (pThis->pbMem)
+        RTMemPageFree(pThis->pbMem, pThis->cbMem);
+    RTMemFree(pThis->paBlocks);
+    RTMemFree(pThis);
+    return rc;
+}
+
+
+/**
+ * Destroys a multi-stream transport instance.
+ *
+ * The threads are told to stop and waited for.  If the instance is destroyed
+ * before TeleporterStreamsClose completed on the sending end, the caller must
+ * shut down the sockets first should the peer have stopped reading.
+ *
+ * @returns IPRT status code.
+ * @param   pThis       The instance handle.  NULL is quietly ignored.
+ */
+int TeleporterStreamsDestroy(PTELEPORTERSTREAMS pThis)
+{
+    if (!pThis)
+        return VINF_SUCCESS;
+
+    ASMAtomicWriteBool(&pThis->fShutdown, true);
+    if (pThis->fIsSource)
+        teleporterStreamsSetError(pThis, VERR_CANCELLED);  /* Drop any queued blocks. */
+    else
+        teleporterStreamsSignalThreads(pThis);
+
+    for (uint32_t i = 0; i < pThis->cStreams; i++)
+    {
+        if (pThis->aStreams[i].hThread != NIL_RTTHREAD)
+        {
+            int rc = RTThreadWait(pThis->aStreams[i].hThread, RT_INDEFINITE_WAIT, NULL);
+            AssertRC(rc);
+            pThis->aStreams[i].hThread = NIL_RTTHREAD;
+        }
+        RTSemEventDestroy(pThis->aStreams[i].hEvt);
+        pThis->aStreams[i].hEvt = NIL_RTSEMEVENT;
+    }
+
+    RTSemEventDestroy(pThis->hEvtUser);
+    pThis->hEvtUser = NIL_RTSEMEVENT;
+    RTCritSectDelete(&pThis->CritSect);
+    RTMemPageFree(pThis->pbMem, pThis->cbMem);
+    RTMemFree(pThis->paBlocks);
+    RTMemFree(pThis);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Queues the block currently being filled for sending.
+ *
+ * @param   pThis       The instance handle (source).
+ * @param   pBlock      The block being filled.
+ */
+static void teleporterStreamsQueueBlock(PTELEPORTERSTREAMS pThis, PTELEPORTERBLOCK pBlock)
+{
+    RTCritSectEnter(&pThis->CritSect);
+    Assert(pBlock->enmState == TELEPORTERBLOCKSTATE_FILLING);
+    Assert(pBlock->uSeq == pThis->uSeqQueued);
+    pBlock->enmState     = TELEPORTERBLOCKSTATE_QUEUED;
+    pThis->uSeqQueued    = ++pThis->uSeqNext;
+    pThis->pBlockFilling = NULL;
+    RTCritSectLeave(&pThis->CritSect);
+    teleporterStreamsSignalThreads(pThis);
+}
+
+
+/**
+ * Writes saved state data to the streams (source).
+ *
+ * @returns IPRT status code.
+ * @param   pThis       The instance handle.
+ * @param   pvBuf       The data.
+ * @param   cbToWrite   The number of bytes to write.
+ */
+int TeleporterStreamsWrite(PTELEPORTERSTREAMS pThis, const void *pvBuf, size_t cbToWrite)
+{
+    AssertReturn(pThis->fIsSource, VERR_INVALID_HANDLE);
+
+    while (cbToWrite > 0)
+    {
+        int rc = pThis->rc;
+        if (RT_FAILURE(rc))
+            return rc;
+
+        /*
+         * Get a block to fill.
+         */
+        PTELEPORTERBLOCK pBlock = pThis->pBlockFilling;
+        if (!pBlock)
+        {
+            pBlock = &pThis->paBlocks[pThis->uSeqNext % pThis->cBlocks];
+            RTCritSectEnter(&pThis->CritSect);
+            while (   pBlock->enmState != TELEPORTERBLOCKSTATE_FREE
+                   && RT_SUCCESS(pThis->rc))
+            {
+                RTCritSectLeave(&pThis->CritSect);
+                RTSemEventWait(pThis->hEvtUser, RT_INDEFINITE_WAIT);
+                RTCritSectEnter(&pThis->CritSect);
+            }
+            rc = pThis->rc;
+            if (RT_SUCCESS(rc))
+            {
+                pBlock->enmState     = TELEPORTERBLOCKSTATE_FILLING;
+                pBlock->uSeq         = pThis->uSeqNext;
+                pBlock->cb           = 0;
+                pThis->pBlockFilling = pBlock;
+            }
+            RTCritSectLeave(&pThis->CritSect);
+            if (RT_FAILURE(rc))
+                return rc;
+        }
+
+        /*
+         * Copy and queue it when full.
+         */
+        uint32_t cbCopy = (uint32_t)RT_MIN(TELEPORTERSTREAMS_BLOCK_SIZE - pBlock->cb, cbToWrite);
+        memcpy(&pBlock->pbData[pBlock->cb], pvBuf, cbCopy);
+        pBlock->cb += cbCopy;
+        if (pBlock->cb == TELEPORTERSTREAMS_BLOCK_SIZE)
+            teleporterStreamsQueueBlock(pThis, pBlock);
+
+        ASMAtomicAddU64(&pThis->cbStream, cbCopy);
+        cbToWrite -= cbCopy;
+        pvBuf = (uint8_t const *)pvBuf + cbCopy;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Flushes the pending data and terminates the stream on all connections
+ * (source).
+ *
+ * @returns IPRT status code.
+ * @param   pThis       The instance handle.
+ * @param   fCancelled  Whether the stream is being cancelled.  Any data not
+ *                      yet sent is dropped.
+ */
+int TeleporterStreamsClose(PTELEPORTERSTREAMS pThis, bool fCancelled)
+{
+    AssertReturn(pThis->fIsSource, VERR_INVALID_HANDLE);
+
+    /*
+     * Queue the partial block and let the threads drain the queue.
+     */
+    PTELEPORTERBLOCK pBlock = pThis->pBlockFilling;
+    if (pBlock)
+    {
+        if (!fCancelled && RT_SUCCESS(pThis->rc))
+            teleporterStreamsQueueBlock(pThis, pBlock);
+        else
+        {
+            RTCritSectEnter(&pThis->CritSect);
+            pBlock->enmState     = TELEPORTERBLOCKSTATE_FREE;
+            pThis->pBlockFilling = NULL;
+            RTCritSectLeave(&pThis->CritSect);
+        }
+    }
+
+    if (fCancelled)
+        teleporterStreamsSetError(pThis, VERR_SSM_CANCELLED);
+    ASMAtomicWriteBool(&pThis->fShutdown, true);
+    teleporterStreamsSignalThreads(pThis);
+    for (uint32_t i = 0; i < pThis->cStreams; i++)
+    {
+        int rc = RTThreadWait(pThis->aStreams[i].hThread, RT_INDEFINITE_WAIT, NULL);
+        AssertRC(rc);
+        pThis->aStreams[i].hThread = NIL_RTTHREAD;
+    }
+
+    /*
+     * Send the end-of-stream headers.
+     */
+    int rc = pThis->rc;
+    TELEPORTERSTREAMHDR EofHdr;
+    EofHdr.u32Magic = TELEPORTERSTREAMHDR_MAGIC;
+    EofHdr.fFlags   = TELEPORTERSTREAMHDR_F_END | (RT_FAILURE(rc) ? TELEPORTERSTREAMHDR_F_CANCELLED : 0);
+    EofHdr.cbData   = 0;
+    EofHdr.cbBlock  = 0;
+    EofHdr.uSeq     = pThis->uSeqClaim;
+    for (uint32_t i = 0; i < pThis->cStreams; i++)
+    {
+        int rc2 = RTTcpWrite(pThis->aStreams[i].hSocket, &EofHdr, sizeof(EofHdr));
+        if (RT_FAILURE(rc2))
+        {
+            LogRel(("Teleporter/TCP#%u: EOF Header write error: %Rrc\n", i, rc2));
+            if (RT_SUCCESS(rc))
+                rc = rc2;
+        }
+    }
+
+    if (rc == VERR_SSM_CANCELLED && fCancelled)
+        rc = VINF_SUCCESS;
+    return rc;
+}
+
+
+/**
+ * Reads saved state data from the streams (target).
+ *
+ * @returns IPRT status code.
+ * @retval  VERR_EOF at the end of the stream or when told to stop reading.
+ * @retval  VERR_SSM_CANCELLED if the source cancelled the stream.
+ *
+ * @param   pThis       The instance handle.
+ * @param   pvBuf       Where to return the data.
+ * @param   cbToRead    The number of bytes to read.
+ * @param   pcbRead     Where to return the number of bytes actually read.
+ *                      If NULL, all @a cbToRead bytes must be read.
+ */
+int TeleporterStreamsRead(PTELEPORTERSTREAMS pThis, void *pvBuf, size_t cbToRead, size_t *pcbRead)
+{
+    AssertReturn(!pThis->fIsSource, VERR_INVALID_HANDLE);
+
+    size_t cbRead = 0;
+    while (cbToRead > 0)
+    {
+        if (pThis->fStopReading)
+            return VERR_EOF;
+
+        RTCritSectEnter(&pThis->CritSect);
+        PTELEPORTERBLOCK pBlock = &pThis->paBlocks[pThis->uSeqNext % pThis->cBlocks];
+        if (pBlock->enmState != TELEPORTERBLOCKSTATE_READY)
+        {
+            /*
+             * Nothing there yet, figure out if there ever will be.
+             */
+            int rc = VINF_SUCCESS;
+            if (pThis->cEnded == pThis->cStreams)
+            {
+                if (pThis->fCancelled)
+                    rc = VERR_SSM_CANCELLED;
+                else if (pThis->uSeqNext >= pThis->uSeqEnd)
+                    rc = VERR_EOF;
+                else
+                {
+                    LogRel(("Teleporter/TCP: Missing block %#RX64 (end %#RX64)\n", pThis->uSeqNext, pThis->uSeqEnd));
+                    rc = VERR_IO_GEN_FAILURE;
+                }
+            }
+            else if (RT_FAILURE(pThis->rc))
+                rc = pThis->rc;
+            RTCritSectLeave(&pThis->CritSect);
+            if (RT_FAILURE(rc))
+                return rc;
+
+            RTSemEventWait(pThis->hEvtUser, RT_INDEFINITE_WAIT);
+            continue;
+        }
+        Assert(pBlock->uSeq == pThis->uSeqNext);
+        RTCritSectLeave(&pThis->CritSect);
+
+        /*
+         * Copy out what we can and free the block when it's consumed.
+         */
+        uint32_t cbCopy = (uint32_t)RT_MIN(pBlock->cb - pBlock->off, cbToRead);
+        memcpy(pvBuf, &pBlock->pbData[pBlock->off], cbCopy);
+        pBlock->off += cbCopy;
+        if (pBlock->off == pBlock->cb)
+        {
+            RTCritSectEnter(&pThis->CritSect);
+            pBlock->enmState = TELEPORTERBLOCKSTATE_FREE;
+            pThis->uSeqNext++;
+            RTCritSectLeave(&pThis->CritSect);
+            teleporterStreamsSignalThreads(pThis);
+        }
+
+        ASMAtomicAddU64(&pThis->cbStream, cbCopy);
+        cbRead   += cbCopy;
+        cbToRead -= cbCopy;
+        pvBuf = (uint8_t *)pvBuf + cbCopy;
+        if (pcbRead)
+            break;
+    }
+
+    if (pcbRead)
+        *pcbRead = cbRead;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Makes TeleporterStreamsRead return VERR_EOF, or resumes reading (target).
+ *
+ * @param   pThis       The instance handle.
+ * @param   fStop       Whether to stop or resume reading.
+ */
+void TeleporterStreamsStopReading(PTELEPORTERSTREAMS pThis, bool fStop)
+{
+    ASMAtomicWriteBool(&pThis->fStopReading, fStop);
+    if (fStop)
+        RTSemEventSignal(pThis->hEvtUser);
+}
+
+
+/**
+ * Queries the transfer statistics.
+ *
+ * @param   pThis       The instance handle.
+ * @param   pStats      Where to return the statistics.
+ */
+void TeleporterStreamsQueryStats(PTELEPORTERSTREAMS pThis, PTELEPORTERSTREAMSSTATS pStats)
+{
+    pStats->cbStream          = ASMAtomicReadU64(&pThis->cbStream);
+    pStats->cbWire            = ASMAtomicReadU64(&pThis->cbWire);
+    pStats->cBlocks           = ASMAtomicReadU64(&pThis->cBlocksXferred);
+    pStats->cBlocksCompressed = ASMAtomicReadU64(&pThis->cBlocksCompressed);
+    pStats->cNsElapsed        = RTTimeNanoTS() - pThis->nsStart;
+    pStats->cStreams          = pThis->cStreams;
+}
+
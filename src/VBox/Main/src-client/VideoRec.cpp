@@ -21,6 +21,7 @@
 #include <vector>
 
 #include <VBox/log.h>
+#include <VBox/vmm/stam.h>
 #include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/semaphore.h>
@@ -43,7 +44,7 @@
 # define DEFAULTCODEC (vpx_codec_vp8_cx())
 #endif /* VBOX_WITH_LIBVPX */
 
-static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStrm);
+static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStrm, uint64_t uTimeStampMs);
 static int videoRecRGBToYUV(PVIDEORECSTREAM pStrm);
 
 using namespace com;
@@ -104,11 +105,15 @@ typedef struct VIDEORECCODEC
  */
 typedef struct VIDEORECSTREAM
 {
+    /** The recording context this stream belongs to. */
+    PVIDEORECCONTEXT    pCtx;
     /** Container context. */
     WebMWriter         *pEBML;
 #ifdef VBOX_WITH_AUDIO_VIDEOREC
     /** Track number of audio stream. */
     uint8_t             uTrackAudio;
+    /** Sequence number of the last audio frame written to this stream. */
+    uint32_t            uAudioSeqWritten;
 #endif
     /** Track number of video stream. */
     uint8_t             uTrackVideo;
@@ -122,6 +127,10 @@ typedef struct VIDEORECSTREAM
     uint64_t            uLastTimeStampMs;
     /** Time stamp (in ms) of the current frame. */
     uint64_t            uCurTimeStampMs;
+    /** Encoder worker thread of this stream. */
+    RTTHREAD            Thread;
+    /** Semaphore to signal the encoder worker thread. */
+    RTSEMEVENT          WaitEvent;
 
     /** Whether the RGB buffer is filled or not. */
     bool                fHasVideoData;
@@ -140,13 +149,22 @@ typedef struct VIDEORECSTREAM
         uint8_t            *pu8RgbBuf;
         /** YUV buffer the encode function fetches the frame from. */
         uint8_t            *pu8YuvBuf;
+        /** Two lines of 32 bpp pixels for converting the other pixel formats. */
+        uint8_t            *pu8LineBuf;
         /** Pixel format of the current frame. */
         uint32_t            uPixelFormat;
+        /** Area of the RGB buffer changed since the last conversion to YUV. */
+        RTRECT              DirtyRect;
         /** Minimal delay (in ms) between two frames. */
         uint32_t            uDelayMs;
         /** Encoder deadline. */
         unsigned int        uEncoderDeadline;
+        /** Time stamp (RTTimeNanoTS) of handing over the current frame. */
+        uint64_t            nsSubmitted;
     } Video;
+
+    /** Statistics. */
+    VIDEORECSTATS       Stats;
 } VIDEORECSTREAM, *PVIDEORECSTREAM;
 
 #ifdef VBOX_WITH_AUDIO_VIDEOREC
@@ -169,356 +187,136 @@ typedef struct VIDEORECCONTEXT
 {
     /** The current state. */
     uint32_t            enmState;
-    /** Semaphore to signal the encoding worker thread. */
-    RTSEMEVENT          WaitEvent;
     /** Whether video recording is enabled or not. */
     bool                fEnabled;
     /** Shutdown indicator. */
     bool                fShutdown;
-    /** Worker thread. */
-    RTTHREAD            Thread;
     /** Maximal time (in ms) to record. */
     uint64_t            uMaxTimeMs;
     /** Maximal file size (in MB) to record. */
     uint32_t            uMaxSizeMB;
+    /** The user mode VM handle for registering the statistics, NULL if none. */
+    PUVM                pUVM;
     /** Vector of current video recording stream contexts. */
     VideoRecStreams     vecStreams;
 #ifdef VBOX_WITH_AUDIO_VIDEOREC
     bool                fHasAudioData;
+    /** Incremented for each audio frame. */
+    uint32_t            uAudioSeq;
+    /** Number of streams which still have to write the current audio frame. */
+    uint32_t volatile   cAudioRefs;
     VIDEORECAUDIOFRAME  Audio;
 #endif
 } VIDEORECCONTEXT, *PVIDEORECCONTEXT;
 
 
 /**
- * Iterator class for running through a BGRA32 image buffer and converting
- * it to RGB.
+ * Adds a rectangle to a dirty rectangle.
  */
-class ColorConvBGRA32Iter
+DECLINLINE(void) videoRecRectUnion(PRTRECT pRect, int32_t xLeft, int32_t yTop, int32_t xRight, int32_t yBottom)
 {
-private:
-    enum { PIX_SIZE = 4 };
-public:
-    ColorConvBGRA32Iter(unsigned aWidth, unsigned aHeight, uint8_t *aBuf)
-    {
-        LogFlow(("width = %d height=%d aBuf=%lx\n", aWidth, aHeight, aBuf));
-        mPos = 0;
-        mSize = aWidth * aHeight * PIX_SIZE;
-        mBuf = aBuf;
-    }
-    /**
-     * Convert the next pixel to RGB.
-     * @returns true on success, false if we have reached the end of the buffer
-     * @param   aRed    where to store the red value
-     * @param   aGreen  where to store the green value
-     * @param   aBlue   where to store the blue value
-     */
-    bool getRGB(unsigned *aRed, unsigned *aGreen, unsigned *aBlue)
-    {
-        bool rc = false;
-        if (mPos + PIX_SIZE <= mSize)
-        {
-            *aRed   = mBuf[mPos + 2];
-            *aGreen = mBuf[mPos + 1];
-            *aBlue  = mBuf[mPos    ];
-            mPos += PIX_SIZE;
-            rc = true;
-        }
-        return rc;
-    }
-
-    /**
-     * Skip forward by a certain number of pixels
-     * @param aPixels  how many pixels to skip
-     */
-    void skip(unsigned aPixels)
+    if (xLeft >= xRight || yTop >= yBottom)
+        return;
+    if (pRect->xLeft >= pRect->xRight)
     {
-        mPos += PIX_SIZE * aPixels;
+        pRect->xLeft   = xLeft;
+        pRect->yTop    = yTop;
+        pRect->xRight  = xRight;
+        pRect->yBottom = yBottom;
     }
-private:
-    /** Size of the picture buffer */
-    unsigned mSize;
-    /** Current position in the picture buffer */
-    unsigned mPos;
-    /** Address of the picture buffer */
-    uint8_t *mBuf;
-};
-
-/**
- * Iterator class for running through an BGR24 image buffer and converting
- * it to RGB.
- */
-class ColorConvBGR24Iter
-{
-private:
-    enum { PIX_SIZE = 3 };
-public:
-    ColorConvBGR24Iter(unsigned aWidth, unsigned aHeight, uint8_t *aBuf)
+    else
     {
-        mPos = 0;
-        mSize = aWidth * aHeight * PIX_SIZE;
-        mBuf = aBuf;
-    }
-    /**
-     * Convert the next pixel to RGB.
-     * @returns true on success, false if we have reached the end of the buffer
-     * @param   aRed    where to store the red value
-     * @param   aGreen  where to store the green value
-     * @param   aBlue   where to store the blue value
-     */
-    bool getRGB(unsigned *aRed, unsigned *aGreen, unsigned *aBlue)
-    {
-        bool rc = false;
-        if (mPos + PIX_SIZE <= mSize)
-        {
-            *aRed   = mBuf[mPos + 2];
-            *aGreen = mBuf[mPos + 1];
-            *aBlue  = mBuf[mPos    ];
-            mPos += PIX_SIZE;
-            rc = true;
-        }
-        return rc;
-    }
-
-    /**
-     * Skip forward by a certain number of pixels
-     * @param aPixels  how many pixels to skip
-     */
-    void skip(unsigned aPixels)
-    {
-        mPos += PIX_SIZE * aPixels;
-    }
-private:
-    /** Size of the picture buffer */
-    unsigned mSize;
-    /** Current position in the picture buffer */
-    unsigned mPos;
-    /** Address of the picture buffer */
-    uint8_t *mBuf;
-};
-
-/**
- * Iterator class for running through an BGR565 image buffer and converting
- * it to RGB.
- */
-class ColorConvBGR565Iter
-{
-private:
-    enum { PIX_SIZE = 2 };
-public:
-    ColorConvBGR565Iter(unsigned aWidth, unsigned aHeight, uint8_t *aBuf)
-    {
-        mPos = 0;
-        mSize = aWidth * aHeight * PIX_SIZE;
-        mBuf = aBuf;
-    }
-    /**
-     * Convert the next pixel to RGB.
-     * @returns true on success, false if we have reached the end of the buffer
-     * @param   aRed    where to store the red value
-     * @param   aGreen  where to store the green value
-     * @param   aBlue   where to store the blue value
-     */
-    bool getRGB(unsigned *aRed, unsigned *aGreen, unsigned *aBlue)
-    {
-        bool rc = false;
-        if (mPos + PIX_SIZE <= mSize)
-        {
-            unsigned uFull =  (((unsigned) mBuf[mPos + 1]) << 8)
-                             | ((unsigned) mBuf[mPos]);
-            *aRed   = (uFull >> 8) & ~7;
-            *aGreen = (uFull >> 3) & ~3 & 0xff;
-            *aBlue  = (uFull << 3) & ~7 & 0xff;
-            mPos += PIX_SIZE;
-            rc = true;
-        }
-        return rc;
+        pRect->xLeft   = RT_MIN(pRect->xLeft,   xLeft);
+        pRect->yTop    = RT_MIN(pRect->yTop,    yTop);
+        pRect->xRight  = RT_MAX(pRect->xRight,  xRight);
+        pRect->yBottom = RT_MAX(pRect->yBottom, yBottom);
     }
+}
 
-    /**
-     * Skip forward by a certain number of pixels
-     * @param aPixels  how many pixels to skip
-     */
-    void skip(unsigned aPixels)
-    {
-        mPos += PIX_SIZE * aPixels;
-    }
-private:
-    /** Size of the picture buffer */
-    unsigned mSize;
-    /** Current position in the picture buffer */
-    unsigned mPos;
-    /** Address of the picture buffer */
-    uint8_t *mBuf;
-};
-
+#ifdef VBOX_WITH_AUDIO_VIDEOREC
 /**
- * Convert an image to YUV420p format
- * @returns true on success, false on failure
- * @param aWidth    width of image
- * @param aHeight   height of image
- * @param aDestBuf  an allocated memory buffer large enough to hold the
- *                  destination image (i.e. width * height * 12bits)
- * @param aSrcBuf   the source image as an array of bytes
+ * Writes the current audio frame of the context to a stream, unless it has
+ * been written already.
+ *
+ * @param   pStream             Recording stream.
  */
-template <class T>
-inline bool colorConvWriteYUV420p(unsigned aWidth, unsigned aHeight, uint8_t *aDestBuf, uint8_t *aSrcBuf)
+static void videoRecStreamWriteAudio(PVIDEORECSTREAM pStream)
 {
-    AssertReturn(!(aWidth & 1), false);
-    AssertReturn(!(aHeight & 1), false);
-    bool fRc = true;
-    T iter1(aWidth, aHeight, aSrcBuf);
-    T iter2 = iter1;
-    iter2.skip(aWidth);
-    unsigned cPixels = aWidth * aHeight;
-    unsigned offY = 0;
-    unsigned offU = cPixels;
-    unsigned offV = cPixels + cPixels / 4;
-    unsigned const cyHalf = aHeight / 2;
-    unsigned const cxHalf = aWidth  / 2;
-    for (unsigned i = 0; i < cyHalf && fRc; ++i)
-    {
-        for (unsigned j = 0; j < cxHalf; ++j)
-        {
-            unsigned red, green, blue;
-            fRc = iter1.getRGB(&red, &green, &blue);
-            AssertReturn(fRc, false);
-            aDestBuf[offY] = ((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16;
-            unsigned u = (((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128) / 4;
-            unsigned v = (((112 * red - 94 * green -  18 * blue + 128) >> 8) + 128) / 4;
-
-            fRc = iter1.getRGB(&red, &green, &blue);
-            AssertReturn(fRc, false);
-            aDestBuf[offY + 1] = ((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16;
-            u += (((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128) / 4;
-            v += (((112 * red - 94 * green -  18 * blue + 128) >> 8) + 128) / 4;
-
-            fRc = iter2.getRGB(&red, &green, &blue);
-            AssertReturn(fRc, false);
-            aDestBuf[offY + aWidth] = ((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16;
-            u += (((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128) / 4;
-            v += (((112 * red - 94 * green -  18 * blue + 128) >> 8) + 128) / 4;
-
-            fRc = iter2.getRGB(&red, &green, &blue);
-            AssertReturn(fRc, false);
-            aDestBuf[offY + aWidth + 1] = ((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16;
-            u += (((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128) / 4;
-            v += (((112 * red - 94 * green -  18 * blue + 128) >> 8) + 128) / 4;
-
-            aDestBuf[offU] = u;
-            aDestBuf[offV] = v;
-            offY += 2;
-            ++offU;
-            ++offV;
-        }
+    PVIDEORECCONTEXT pCtx = pStream->pCtx;
+    if (!ASMAtomicReadBool(&pCtx->fHasAudioData))
+        return;
 
-        iter1.skip(aWidth);
-        iter2.skip(aWidth);
-        offY += aWidth;
-    }
+    uint32_t const uSeq = ASMAtomicReadU32(&pCtx->uAudioSeq);
+    if (pStream->uAudioSeqWritten == uSeq)
+        return;
+    pStream->uAudioSeqWritten = uSeq;
 
-    return true;
-}
+    WebMWriter::BlockData_Opus blockData = { pCtx->Audio.abBuf, pCtx->Audio.cbBuf, pCtx->Audio.uTimeStampMs };
+    pStream->pEBML->WriteBlock(pStream->uTrackAudio, &blockData, sizeof(blockData));
 
-/**
- * Convert an image to RGB24 format
- * @returns true on success, false on failure
- * @param aWidth    width of image
- * @param aHeight   height of image
- * @param aDestBuf  an allocated memory buffer large enough to hold the
- *                  destination image (i.e. width * height * 12bits)
- * @param aSrcBuf   the source image as an array of bytes
- */
-template <class T>
-inline bool colorConvWriteRGB24(unsigned aWidth, unsigned aHeight,
-                                uint8_t *aDestBuf, uint8_t *aSrcBuf)
-{
-    enum { PIX_SIZE = 3 };
-    bool rc = true;
-    AssertReturn(0 == (aWidth & 1), false);
-    AssertReturn(0 == (aHeight & 1), false);
-    T iter(aWidth, aHeight, aSrcBuf);
-    unsigned cPixels = aWidth * aHeight;
-    for (unsigned i = 0; i < cPixels && rc; ++i)
-    {
-        unsigned red, green, blue;
-        rc = iter.getRGB(&red, &green, &blue);
-        if (rc)
-        {
-            aDestBuf[i * PIX_SIZE    ] = red;
-            aDestBuf[i * PIX_SIZE + 1] = green;
-            aDestBuf[i * PIX_SIZE + 2] = blue;
-        }
-    }
-    return rc;
+    /* The last stream releases the frame. */
+    if (ASMAtomicDecU32(&pCtx->cAudioRefs) == 0)
+        ASMAtomicWriteBool(&pCtx->fHasAudioData, false);
 }
+#endif
 
 /**
- * Worker thread for all streams of a video recording context.
+ * Encoder worker thread of a video recording stream.
  *
- * Does RGB/YUV conversion and encoding.
+ * Does RGB/YUV conversion and encoding. Each recorded screen has its own
+ * worker, so the screens are encoded in parallel.
  */
-static DECLCALLBACK(int) videoRecThread(RTTHREAD hThreadSelf, void *pvUser)
+static DECLCALLBACK(int) videoRecStreamThread(RTTHREAD hThreadSelf, void *pvUser)
 {
-    PVIDEORECCONTEXT pCtx = (PVIDEORECCONTEXT)pvUser;
+    PVIDEORECSTREAM  pStream = (PVIDEORECSTREAM)pvUser;
+    PVIDEORECCONTEXT pCtx    = pStream->pCtx;
 
     /* Signal that we're up and rockin'. */
     RTThreadUserSignal(hThreadSelf);
 
     for (;;)
     {
-        int rc = RTSemEventWait(pCtx->WaitEvent, RT_INDEFINITE_WAIT);
+        int rc = RTSemEventWait(pStream->WaitEvent, RT_INDEFINITE_WAIT);
         AssertRCBreak(rc);
 
         if (ASMAtomicReadBool(&pCtx->fShutdown))
             break;
 
-#ifdef VBOX_WITH_AUDIO_VIDEOREC
-        const bool fHasAudioData = ASMAtomicReadBool(&pCtx->fHasAudioData);
-#endif
-        /** @todo r=andy This is inefficient -- as we already wake up this thread
-         *               for every screen from Main, we here go again (on every wake up) through
-         *               all screens.  */
-        for (VideoRecStreams::iterator it = pCtx->vecStreams.begin(); it != pCtx->vecStreams.end(); it++)
+        if (ASMAtomicReadBool(&pStream->fHasVideoData))
         {
-            PVIDEORECSTREAM pStream = (*it);
+            uint64_t const uTimeStampMs = pStream->uCurTimeStampMs;
+            uint64_t const nsSubmitted  = pStream->Video.nsSubmitted;
 
-            if (!pStream->fEnabled)
-                continue;
+            rc = videoRecRGBToYUV(pStream);
 
-            if (ASMAtomicReadBool(&pStream->fHasVideoData))
-            {
-                rc = videoRecRGBToYUV(pStream);
-
-                ASMAtomicWriteBool(&pStream->fHasVideoData, false);
+            /* The RGB buffer is not needed anymore, accept the next frame. */
+            ASMAtomicWriteBool(&pStream->fHasVideoData, false);
 
-                if (RT_SUCCESS(rc))
-                    rc = videoRecEncodeAndWrite(pStream);
+            if (RT_SUCCESS(rc))
+                rc = videoRecEncodeAndWrite(pStream, uTimeStampMs);
 
-                if (RT_FAILURE(rc))
-                {
-                    static unsigned s_cErrEnc = 100;
-                    if (s_cErrEnc > 0)
-                    {
-                        LogRel(("VideoRec: Error %Rrc encoding / writing video frame\n", rc));
-                        s_cErrEnc--;
-                    }
-                }
+            if (RT_SUCCESS(rc))
+            {
+                uint64_t const cNsElapsed = RTTimeNanoTS() - nsSubmitted;
+                pStream->Stats.cFramesEncoded++;
+                pStream->Stats.cNsEncodeTotal += cNsElapsed;
+                if (cNsElapsed > pStream->Stats.cNsEncodeMax)
+                    pStream->Stats.cNsEncodeMax = cNsElapsed;
             }
-
-#ifdef VBOX_WITH_AUDIO_VIDEOREC
-            /* Each (enabled) screen has to get the audio data. */
-            if (fHasAudioData)
+            else
             {
-                WebMWriter::BlockData_Opus blockData = { pCtx->Audio.abBuf, pCtx->Audio.cbBuf, pCtx->Audio.uTimeStampMs };
-                rc = pStream->pEBML->WriteBlock(pStream->uTrackAudio, &blockData, sizeof(blockData));
+                static unsigned s_cErrEnc = 100;
+                if (s_cErrEnc > 0)
+                {
+                    LogRel(("VideoRec: Error %Rrc encoding / writing video frame of screen #%u\n", rc, pStream->uScreen));
+                    s_cErrEnc--;
+                }
             }
-#endif
-        } /* for */
+        }
 
 #ifdef VBOX_WITH_AUDIO_VIDEOREC
-        if (fHasAudioData)
-            ASMAtomicWriteBool(&pCtx->fHasAudioData, false);
+        /* Each (enabled) screen has to get the audio data. */
+        videoRecStreamWriteAudio(pStream);
 #endif
     }
 
@@ -530,9 +328,11 @@ static DECLCALLBACK(int) videoRecThread(RTTHREAD hThreadSelf, void *pvUser)
  *
  * @returns IPRT status code.
  * @param   cScreens         Number of screens to create context for.
+ * @param   pUVM             The user mode VM handle for registering the
+ *                           statistics of the streams, optional.
  * @param   ppCtx            Pointer to created video recording context on success.
  */
-int VideoRecContextCreate(uint32_t cScreens, PVIDEORECCONTEXT *ppCtx)
+int VideoRecContextCreate(uint32_t cScreens, PUVM pUVM, PVIDEORECCONTEXT *ppCtx)
 {
     AssertReturn(cScreens, VERR_INVALID_PARAMETER);
     AssertPtrReturn(ppCtx, VERR_INVALID_POINTER);
@@ -554,7 +354,10 @@ int VideoRecContextCreate(uint32_t cScreens, PVIDEORECCONTEXT *ppCtx)
 
         try
         {
+            pStream->pCtx    = pCtx;
             pStream->uScreen = uScreen;
+            pStream->Thread    = NIL_RTTHREAD;
+            pStream->WaitEvent = NIL_RTSEMEVENT;
 
             pCtx->vecStreams.push_back(pStream);
 
@@ -569,26 +372,14 @@ int VideoRecContextCreate(uint32_t cScreens, PVIDEORECCONTEXT *ppCtx)
 
     if (RT_SUCCESS(rc))
     {
-        pCtx->enmState  = VIDEORECSTS_UNINITIALIZED;
+        /* The encoder workers are started by VideoRecStreamInit. */
+        pCtx->enmState  = VIDEORECSTS_IDLE;
         pCtx->fShutdown = false;
+        pCtx->fEnabled  = true;
+        pCtx->pUVM      = pUVM;
 
-        rc = RTSemEventCreate(&pCtx->WaitEvent);
-        AssertRCReturn(rc, rc);
-
-        rc = RTThreadCreate(&pCtx->Thread, videoRecThread, (void *)pCtx, 0,
-                            RTTHREADTYPE_MAIN_WORKER, RTTHREADFLAGS_WAITABLE, "VideoRec");
-
-        if (RT_SUCCESS(rc)) /* Wait for the thread to start. */
-            rc = RTThreadUserWait(pCtx->Thread, 30 * 1000 /* 30s timeout */);
-
-        if (RT_SUCCESS(rc))
-        {
-            pCtx->enmState = VIDEORECSTS_IDLE;
-            pCtx->fEnabled = true;
-
-            if (ppCtx)
-                *ppCtx = pCtx;
-        }
+        if (ppCtx)
+            *ppCtx = pCtx;
     }
 
     if (RT_FAILURE(rc))
@@ -627,25 +418,40 @@ int VideoRecContextDestroy(PVIDEORECCONTEXT pCtx)
     /* Set shutdown indicator. */
     ASMAtomicWriteBool(&pCtx->fShutdown, true);
 
-    /* Signal the thread. */
-    RTSemEventSignal(pCtx->WaitEvent);
-
-    int rc = RTThreadWait(pCtx->Thread, 10 * 1000 /* 10s timeout */, NULL);
-    if (RT_FAILURE(rc))
-        return rc;
+    /* Signal the encoder workers and wait for them to terminate. */
+    VideoRecStreams::iterator it;
+    for (it = pCtx->vecStreams.begin(); it != pCtx->vecStreams.end(); ++it)
+        if ((*it)->WaitEvent != NIL_RTSEMEVENT)
+            RTSemEventSignal((*it)->WaitEvent);
 
-    rc = RTSemEventDestroy(pCtx->WaitEvent);
-    AssertRC(rc);
-
-    pCtx->WaitEvent = NIL_RTSEMEVENT;
+    for (it = pCtx->vecStreams.begin(); it != pCtx->vecStreams.end(); ++it)
+    {
+        PVIDEORECSTREAM pStream = (*it);
+        if (pStream->Thread != NIL_RTTHREAD)
+        {
+            int rc = RTThreadWait(pStream->Thread, 10 * 1000 /* 10s timeout */, NULL);
+            if (RT_FAILURE(rc))
+                return rc;
+            pStream->Thread = NIL_RTTHREAD;
+        }
+        if (pStream->WaitEvent != NIL_RTSEMEVENT)
+        {
+            int rc = RTSemEventDestroy(pStream->WaitEvent);
+            AssertRC(rc);
+            pStream->WaitEvent = NIL_RTSEMEVENT;
+        }
+    }
 
-    VideoRecStreams::iterator it = pCtx->vecStreams.begin();
+    it = pCtx->vecStreams.begin();
     while (it != pCtx->vecStreams.end())
     {
         PVIDEORECSTREAM pStream = (*it);
 
         if (pStream->fEnabled)
         {
+            if (pCtx->pUVM)
+                STAMR3DeregisterF(pCtx->pUVM, "/Main/VideoRec/Screen%u/*", pStream->uScreen);
+
             AssertPtr(pStream->pEBML);
             pStream->pEBML->Close();
 
@@ -653,15 +459,19 @@ int VideoRecContextDestroy(PVIDEORECCONTEXT pCtx)
             vpx_codec_err_t rcv = vpx_codec_destroy(&pStream->Codec.VPX.CodecCtx);
             Assert(rcv == VPX_CODEC_OK); RT_NOREF(rcv);
 
-            if (pStream->Video.pu8RgbBuf)
-            {
-                RTMemFree(pStream->Video.pu8RgbBuf);
-                pStream->Video.pu8RgbBuf = NULL;
-            }
-
-            LogRel(("VideoRec: Recording screen #%u stopped\n", pStream->uScreen));
+            LogRel(("VideoRec: Recording screen #%u stopped: %RU64 frames encoded, %RU64 unchanged, %RU64 dropped, "
+                    "encode latency avg %RU64 us max %RU64 us\n",
+                    pStream->uScreen, pStream->Stats.cFramesEncoded, pStream->Stats.cFramesUnchanged,
+                    pStream->Stats.cFramesDropped,
+                    pStream->Stats.cFramesEncoded ? pStream->Stats.cNsEncodeTotal / pStream->Stats.cFramesEncoded / 1000 : 0,
+                    pStream->Stats.cNsEncodeMax / 1000));
         }
 
+        RTMemFree(pStream->Video.pu8RgbBuf);
+        pStream->Video.pu8RgbBuf = NULL;
+        RTMemFree(pStream->Video.pu8LineBuf);
+        pStream->Video.pu8LineBuf = NULL;
+
         if (pStream->pEBML)
         {
             delete pStream->pEBML;
@@ -745,6 +555,14 @@ int VideoRecStreamInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszF
     pStream->Video.uDstHeight = uHeight;
     pStream->Video.pu8RgbBuf = (uint8_t *)RTMemAllocZ(uWidth * uHeight * 4);
     AssertReturn(pStream->Video.pu8RgbBuf, VERR_NO_MEMORY);
+    pStream->Video.pu8LineBuf = (uint8_t *)RTMemAlloc(uWidth * 4 * 2);
+    AssertReturn(pStream->Video.pu8LineBuf, VERR_NO_MEMORY);
+
+    /* The first frame is converted completely. */
+    pStream->Video.DirtyRect.xLeft   = 0;
+    pStream->Video.DirtyRect.yTop    = 0;
+    pStream->Video.DirtyRect.xRight  = (int32_t)uWidth;
+    pStream->Video.DirtyRect.yBottom = (int32_t)uHeight;
 
     /* Play safe: the file must not exist, overwriting is potentially
      * hazardous as nothing prevents the user from picking a file name of some
@@ -894,8 +712,45 @@ int VideoRecStreamInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszF
 
     pStream->Video.pu8YuvBuf = pStream->Codec.VPX.RawImage.planes[0];
 #endif
+
+    /* Start the encoder worker of the stream. */
+    rc = RTSemEventCreate(&pStream->WaitEvent);
+    AssertRCReturn(rc, rc);
+
+    rc = RTThreadCreateF(&pStream->Thread, videoRecStreamThread, pStream, 0,
+                         RTTHREADTYPE_MAIN_WORKER, RTTHREADFLAGS_WAITABLE, "VideoRec%u", uScreen);
+    if (RT_SUCCESS(rc)) /* Wait for the thread to start. */
+        rc = RTThreadUserWait(pStream->Thread, 30 * 1000 /* 30s timeout */);
+    if (RT_FAILURE(rc))
+    {
+        LogRel(("VideoRec: Failed to start the encoder thread for screen #%u (%Rrc)\n", uScreen, rc));
+        return rc;
+    }
+
     pStream->fEnabled = true;
 
+    if (pCtx->pUVM)
+    {
+        STAMR3RegisterFU(pCtx->pUVM, &pStream->Stats.cFramesSubmitted, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,
+                         STAMUNIT_OCCURENCES, "Frames handed over to the encoder.",
+                         "/Main/VideoRec/Screen%u/FramesSubmitted", uScreen);
+        STAMR3RegisterFU(pCtx->pUVM, &pStream->Stats.cFramesDropped, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,
+                         STAMUNIT_OCCURENCES, "Frames dropped because the encoder was still busy.",
+                         "/Main/VideoRec/Screen%u/FramesDropped", uScreen);
+        STAMR3RegisterFU(pCtx->pUVM, &pStream->Stats.cFramesEncoded, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,
+                         STAMUNIT_OCCURENCES, "Frames encoded and written.",
+                         "/Main/VideoRec/Screen%u/FramesEncoded", uScreen);
+        STAMR3RegisterFU(pCtx->pUVM, &pStream->Stats.cFramesUnchanged, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,
+                         STAMUNIT_OCCURENCES, "Frames which did not need any color conversion.",
+                         "/Main/VideoRec/Screen%u/FramesUnchanged", uScreen);
+        STAMR3RegisterFU(pCtx->pUVM, &pStream->Stats.cNsEncodeTotal, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,
+                         STAMUNIT_NS, "Total time from handing over the frames until they were written.",
+                         "/Main/VideoRec/Screen%u/EncodeTotal", uScreen);
+        STAMR3RegisterFU(pCtx->pUVM, &pStream->Stats.cNsEncodeMax, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,
+                         STAMUNIT_NS, "Maximum time from handing over a frame until it was written.",
+                         "/Main/VideoRec/Screen%u/EncodeMax", uScreen);
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -1004,13 +859,13 @@ bool VideoRecIsLimitReached(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint64_t ts
  * @returns IPRT status code.
  * @param   pStream             Stream to encode and write.
  */
-static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStream)
+static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStream, uint64_t uTimeStampMs)
 {
     int rc;
 
 #ifdef VBOX_WITH_LIBVPX
     /* Presentation Time Stamp (PTS). */
-    vpx_codec_pts_t pts = pStream->uCurTimeStampMs;
+    vpx_codec_pts_t pts = uTimeStampMs;
     vpx_codec_err_t rcv = vpx_codec_encode(&pStream->Codec.VPX.CodecCtx,
                                            &pStream->Codec.VPX.RawImage,
                                            pts                           /* Time stamp */,
@@ -1047,7 +902,7 @@ static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStream)
         }
     }
 #else
-    RT_NOREF(pStream);
+    RT_NOREF(pStream, uTimeStampMs);
     rc = VERR_NOT_SUPPORTED;
 #endif /* VBOX_WITH_LIBVPX */
     return rc;
@@ -1056,40 +911,74 @@ static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStream)
 /**
  * VideoRec utility function to convert RGB to YUV.
  *
+ * Only the part of the frame which changed since the last conversion is
+ * converted, the rest of the YUV buffer is still current.
+ *
  * @returns IPRT status code.
  * @param   pStream             Recording stream to convert RGB to YUV video frame buffer for.
  */
 static int videoRecRGBToYUV(PVIDEORECSTREAM pStream)
 {
+    uint32_t const cx = pStream->Video.uDstWidth;
+    uint32_t const cy = pStream->Video.uDstHeight;
+    AssertReturn(!(cx & 1), VERR_INVALID_PARAMETER);
+    AssertReturn(!(cy & 1), VERR_INVALID_PARAMETER);
+
+    uint32_t cbPixel;
     switch (pStream->Video.uPixelFormat)
     {
-        case VIDEORECPIXELFMT_RGB32:
-            LogFlow(("32 bit\n"));
-            if (!colorConvWriteYUV420p<ColorConvBGRA32Iter>(pStream->Video.uDstWidth,
-                                                            pStream->Video.uDstHeight,
-                                                            pStream->Video.pu8YuvBuf,
-                                                            pStream->Video.pu8RgbBuf))
-                return VERR_INVALID_PARAMETER;
-            break;
-        case VIDEORECPIXELFMT_RGB24:
-            LogFlow(("24 bit\n"));
-            if (!colorConvWriteYUV420p<ColorConvBGR24Iter>(pStream->Video.uDstWidth,
-                                                           pStream->Video.uDstHeight,
-                                                           pStream->Video.pu8YuvBuf,
-                                                           pStream->Video.pu8RgbBuf))
-                return VERR_INVALID_PARAMETER;
-            break;
-        case VIDEORECPIXELFMT_RGB565:
-            LogFlow(("565 bit\n"));
-            if (!colorConvWriteYUV420p<ColorConvBGR565Iter>(pStream->Video.uDstWidth,
-                                                            pStream->Video.uDstHeight,
-                                                            pStream->Video.pu8YuvBuf,
-                                                            pStream->Video.pu8RgbBuf))
-                return VERR_INVALID_PARAMETER;
-            break;
+        case VIDEORECPIXELFMT_RGB32:  cbPixel = 4; break;
+        case VIDEORECPIXELFMT_RGB24:  cbPixel = 3; break;
+        case VIDEORECPIXELFMT_RGB565: cbPixel = 2; break;
         default:
             return VERR_NOT_SUPPORTED;
     }
+
+    /* Clip the dirty rectangle and align it to the 2x2 chroma blocks. */
+    RTRECT const DirtyRect = pStream->Video.DirtyRect;
+    RT_ZERO(pStream->Video.DirtyRect);
+
+    uint32_t const xLeft   = (uint32_t)RT_MAX(DirtyRect.xLeft, 0) & ~UINT32_C(1);
+    uint32_t const yTop    = (uint32_t)RT_MAX(DirtyRect.yTop, 0) & ~UINT32_C(1);
+    uint32_t const xRight  = RT_MIN(RT_ALIGN_32((uint32_t)RT_MAX(DirtyRect.xRight, 0), 2), cx);
+    uint32_t const yBottom = RT_MIN(RT_ALIGN_32((uint32_t)RT_MAX(DirtyRect.yBottom, 0), 2), cy);
+    if (xLeft >= xRight || yTop >= yBottom)
+    {
+        pStream->Stats.cFramesUnchanged++;
+        return VINF_SUCCESS;
+    }
+
+    uint32_t const cxRect  = xRight - xLeft;
+    uint8_t       *pbY     = pStream->Video.pu8YuvBuf;
+    uint8_t       *pbU     = pbY + cx * cy;
+    uint8_t       *pbV     = pbU + cx * cy / 4;
+    uint32_t const cbLine  = cx * cbPixel;
+    uint8_t       *pbLine0 = pStream->Video.pu8LineBuf;
+    uint8_t       *pbLine1 = pbLine0 + cx * 4;
+    for (uint32_t y = yTop; y < yBottom; y += 2)
+    {
+        const uint8_t *pbSrc0 = pStream->Video.pu8RgbBuf + y * cbLine + xLeft * cbPixel;
+        const uint8_t *pbSrc1 = pbSrc0 + cbLine;
+        if (cbPixel == 3)
+        {
+            VideoRecExpandBGR24(pbLine0, pbSrc0, cxRect);
+            VideoRecExpandBGR24(pbLine1, pbSrc1, cxRect);
+            pbSrc0 = pbLine0;
+            pbSrc1 = pbLine1;
+        }
+        else if (cbPixel == 2)
+        {
+            VideoRecExpandRGB565(pbLine0, pbSrc0, cxRect);
+            VideoRecExpandRGB565(pbLine1, pbSrc1, cxRect);
+            pbSrc0 = pbLine0;
+            pbSrc1 = pbLine1;
+        }
+
+        VideoRecConvBGRA32ToI420(pbSrc0, pbSrc1, cxRect,
+                                 &pbY[y * cx + xLeft], &pbY[(y + 1) * cx + xLeft],
+                                 &pbU[y / 2 * (cx / 2) + xLeft / 2], &pbV[y / 2 * (cx / 2) + xLeft / 2]);
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -1119,16 +1008,37 @@ int VideoRecSendAudioFrame(PVIDEORECCONTEXT pCtx, const void *pvData, size_t cbD
      * audio data at the same given point in time.
      */
 
-    if (ASMAtomicReadBool(&pCtx->fHasAudioData))
-        return VERR_TRY_AGAIN; /* Previous frame not yet encoded. */
+    int rc = VINF_SUCCESS;
+    if (!ASMAtomicReadBool(&pCtx->fHasAudioData))
+    {
+        uint32_t cStreams = 0;
+        VideoRecStreams::iterator it;
+        for (it = pCtx->vecStreams.begin(); it != pCtx->vecStreams.end(); ++it)
+            if ((*it)->fEnabled)
+                cStreams++;
 
-    memcpy(pCtx->Audio.abBuf, pvData, RT_MIN(_64K, cbData));
+        if (cStreams)
+        {
+            memcpy(pCtx->Audio.abBuf, pvData, RT_MIN(_64K, cbData));
 
-    pCtx->Audio.cbBuf        = cbData;
-    pCtx->Audio.uTimeStampMs = uTimeStampMs;
+            pCtx->Audio.cbBuf        = cbData;
+            pCtx->Audio.uTimeStampMs = uTimeStampMs;
 
-    ASMAtomicWriteBool(&pCtx->fHasAudioData, true);
-    RTSemEventSignal(pCtx->WaitEvent);
+            /* Each encoder worker writes the frame to its stream, the last one releases it. */
+            ASMAtomicWriteU32(&pCtx->cAudioRefs, cStreams);
+            ASMAtomicIncU32(&pCtx->uAudioSeq);
+            ASMAtomicWriteBool(&pCtx->fHasAudioData, true);
+
+            for (it = pCtx->vecStreams.begin(); it != pCtx->vecStreams.end(); ++it)
+                if ((*it)->fEnabled)
+                    RTSemEventSignal((*it)->WaitEvent);
+        }
+    }
+    else
+        rc = VERR_TRY_AGAIN; /* Previous frame not yet encoded. */
+
+    ASMAtomicCmpXchgU32(&pCtx->enmState, VIDEORECSTS_IDLE, VIDEORECSTS_BUSY);
+    return rc;
 #else
     RT_NOREF(pCtx, pvData, cbData, uTimeStampMs);
 #endif
@@ -1153,11 +1063,14 @@ int VideoRecSendAudioFrame(PVIDEORECCONTEXT pCtx, const void *pvData, size_t cbD
  * @param   uSrcHeight         Height of the video frame.
  * @param   puSrcData          Pointer to video frame data.
  * @param   uTimeStampMs       Time stamp (in ms).
+ * @param   pDirtyRect         The area of the video frame which changed since the
+ *                             last frame accepted for this screen, NULL if unknown.
+ *                             Only this area is copied and converted.
  */
 int VideoRecSendVideoFrame(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x, uint32_t y,
                            uint32_t uPixelFormat, uint32_t uBPP, uint32_t uBytesPerLine,
                            uint32_t uSrcWidth, uint32_t uSrcHeight, uint8_t *puSrcData,
-                           uint64_t uTimeStampMs)
+                           uint64_t uTimeStampMs, PCRTRECT pDirtyRect)
 {
     /* Do not execute during termination and guard against termination. */
     if (!ASMAtomicCmpXchgU32(&pCtx->enmState, VIDEORECSTS_BUSY, VIDEORECSTS_IDLE))
@@ -1192,6 +1105,7 @@ int VideoRecSendVideoFrame(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x,
 
         if (ASMAtomicReadBool(&pStream->fHasVideoData))
         {
+            pStream->Stats.cFramesDropped++;
             rc = VERR_TRY_AGAIN; /* Previous frame not yet encoded. */
             break;
         }
@@ -1248,6 +1162,7 @@ int VideoRecSendVideoFrame(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x,
             h = pStream->Video.uDstHeight - destY;
 
         /* Calculate bytes per pixel. */
+        uint32_t const uPixelFormatOld = pStream->Video.uPixelFormat;
         uint32_t bpp = 1;
         if (uPixelFormat == BitmapFormat_BGR)
         {
@@ -1279,30 +1194,70 @@ int VideoRecSendVideoFrame(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x,
             || uSrcHeight < pStream->Video.uSrcLastHeight)
             memset(pStream->Video.pu8RgbBuf, 0, pStream->Video.uDstWidth * pStream->Video.uDstHeight * 4);
 
+        /* The whole frame must be copied if the frame moved within the buffer or the
+         * format changed, otherwise only the part that changed. */
+        uint32_t xCopy = x;
+        uint32_t yCopy = y;
+        uint32_t wCopy = w;
+        uint32_t hCopy = h;
+        if (   pDirtyRect
+            && uSrcWidth  == pStream->Video.uSrcLastWidth
+            && uSrcHeight == pStream->Video.uSrcLastHeight
+            && pStream->Video.uPixelFormat == uPixelFormatOld)
+        {
+            int32_t const xLeft   = RT_MAX(pDirtyRect->xLeft,   (int32_t)x);
+            int32_t const yTop    = RT_MAX(pDirtyRect->yTop,    (int32_t)y);
+            int32_t const xRight  = RT_MIN(pDirtyRect->xRight,  (int32_t)(x + w));
+            int32_t const yBottom = RT_MIN(pDirtyRect->yBottom, (int32_t)(y + h));
+            if (xLeft < xRight && yTop < yBottom)
+            {
+                xCopy = (uint32_t)xLeft;
+                yCopy = (uint32_t)yTop;
+                wCopy = (uint32_t)(xRight - xLeft);
+                hCopy = (uint32_t)(yBottom - yTop);
+            }
+            else
+                wCopy = hCopy = 0;
+
+            destX += xCopy - x;
+            destY += yCopy - y;
+        }
+        else
+        {
+            /* Convert everything, the parts outside of the frame were cleared or moved. */
+            videoRecRectUnion(&pStream->Video.DirtyRect, 0, 0,
+                              (int32_t)pStream->Video.uDstWidth, (int32_t)pStream->Video.uDstHeight);
+        }
+
         pStream->Video.uSrcLastWidth  = uSrcWidth;
         pStream->Video.uSrcLastHeight = uSrcHeight;
 
+        videoRecRectUnion(&pStream->Video.DirtyRect, (int32_t)destX, (int32_t)destY,
+                          (int32_t)(destX + wCopy), (int32_t)(destY + hCopy));
+
         /* Calculate start offset in source and destination buffers. */
-        uint32_t offSrc = y * uBytesPerLine + x * bpp;
+        uint32_t offSrc = yCopy * uBytesPerLine + xCopy * bpp;
         uint32_t offDst = (destY * pStream->Video.uDstWidth + destX) * bpp;
 
         /* Do the copy. */
-        for (unsigned int i = 0; i < h; i++)
+        for (unsigned int i = 0; i < hCopy; i++)
         {
             /* Overflow check. */
-            Assert(offSrc + w * bpp <= uSrcHeight * uBytesPerLine);
-            Assert(offDst + w * bpp <= pStream->Video.uDstHeight * pStream->Video.uDstWidth * bpp);
+            Assert(offSrc + wCopy * bpp <= uSrcHeight * uBytesPerLine);
+            Assert(offDst + wCopy * bpp <= pStream->Video.uDstHeight * pStream->Video.uDstWidth * bpp);
 
-            memcpy(pStream->Video.pu8RgbBuf + offDst, puSrcData + offSrc, w * bpp);
+            memcpy(pStream->Video.pu8RgbBuf + offDst, puSrcData + offSrc, wCopy * bpp);
 
             offSrc += uBytesPerLine;
             offDst += pStream->Video.uDstWidth * bpp;
         }
 
-        pStream->uCurTimeStampMs = uTimeStampMs;
+        pStream->uCurTimeStampMs     = uTimeStampMs;
+        pStream->Video.nsSubmitted   = RTTimeNanoTS();
+        pStream->Stats.cFramesSubmitted++;
 
         ASMAtomicWriteBool(&pStream->fHasVideoData, true);
-        RTSemEventSignal(pCtx->WaitEvent);
+        RTSemEventSignal(pStream->WaitEvent);
 
     } while (0);
 
@@ -1310,3 +1265,27 @@ int VideoRecSendVideoFrame(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x,
 
     return rc;
 }
+
+/**
+ * Retrieves the statistics of a video recording stream.
+ *
+ * The counters are updated without locking, so the values may be slightly
+ * inconsistent with each other.
+ *
+ * @returns IPRT status code.
+ * @param   pCtx                Pointer to the video recording context.
+ * @param   uScreen             Screen number.
+ * @param   pStats              Where to return the statistics.
+ */
+int VideoRecQueryStats(PVIDEORECCONTEXT pCtx, uint32_t uScreen, PVIDEORECSTATS pStats)
+{
+    AssertPtrReturn(pStats, VERR_INVALID_POINTER);
+
+    PVIDEORECSTREAM pStream = videoRecStreamGet(pCtx, uScreen);
+    if (   !pStream
+        || !pStream->fEnabled)
+        return VERR_NOT_FOUND;
+
+    *pStats = pStream->Stats;
+    return VINF_SUCCESS;
+}
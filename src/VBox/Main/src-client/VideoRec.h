@@ -18,13 +18,34 @@
 #ifndef ____H_VIDEOREC
 #define ____H_VIDEOREC
 
+#include <VBox/types.h>
+
 struct VIDEORECCONTEXT;
 typedef struct VIDEORECCONTEXT *PVIDEORECCONTEXT;
 
 struct VIDEORECSTREAM;
 typedef struct VIDEORECSTREAM *PVIDEORECSTREAM;
 
-int VideoRecContextCreate(uint32_t cScreens, PVIDEORECCONTEXT *ppCtx);
+/**
+ * Statistics of a video recording stream.
+ */
+typedef struct VIDEORECSTATS
+{
+    /** Number of frames handed over to the encoder. */
+    uint64_t            cFramesSubmitted;
+    /** Number of frames dropped because the encoder was still busy. */
+    uint64_t            cFramesDropped;
+    /** Number of frames encoded and written. */
+    uint64_t            cFramesEncoded;
+    /** Number of frames which did not need any color conversion. */
+    uint64_t            cFramesUnchanged;
+    /** Total time (in ns) from handing over the frames until they were written. */
+    uint64_t            cNsEncodeTotal;
+    /** Maximum time (in ns) from handing over a frame until it was written. */
+    uint64_t            cNsEncodeMax;
+} VIDEORECSTATS, *PVIDEORECSTATS;
+
+int VideoRecContextCreate(uint32_t cScreens, PUVM pUVM, PVIDEORECCONTEXT *ppCtx);
 int VideoRecContextDestroy(PVIDEORECCONTEXT pCtx);
 
 int  VideoRecStreamInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFile,
@@ -36,9 +57,19 @@ int  VideoRecSendAudioFrame(PVIDEORECCONTEXT pCtx, const void *pvData, size_t cb
 int  VideoRecSendVideoFrame(PVIDEORECCONTEXT pCtx, uint32_t uScreen,
                             uint32_t x, uint32_t y, uint32_t uPixelFormat, uint32_t uBPP,
                             uint32_t uBytesPerLine, uint32_t uSrcWidth, uint32_t uSrcHeight,
-                            uint8_t *puSrcData, uint64_t uTimeStampMs);
+                            uint8_t *puSrcData, uint64_t uTimeStampMs, PCRTRECT pDirtyRect);
 bool VideoRecIsReady(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint64_t uTimeStampMs);
 bool VideoRecIsLimitReached(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint64_t tsNowMs);
+int  VideoRecQueryStats(PVIDEORECCONTEXT pCtx, uint32_t uScreen, PVIDEORECSTATS pStats);
+
+/* Pixel format conversion, code in VideoRecConv.cpp. */
+void VideoRecConvBGRA32ToI420(const uint8_t *pbSrc0, const uint8_t *pbSrc1, uint32_t cx,
+                              uint8_t *pbY0, uint8_t *pbY1, uint8_t *pbU, uint8_t *pbV);
+void VideoRecConvBGRA32ToI420Generic(const uint8_t *pbSrc0, const uint8_t *pbSrc1, uint32_t cx,
+                                     uint8_t *pbY0, uint8_t *pbY1, uint8_t *pbU, uint8_t *pbV);
+void VideoRecExpandBGR24(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cx);
+void VideoRecExpandRGB565(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cx);
+void VideoRecExpandRGB565Generic(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cx);
 
 #endif /* !____H_VIDEOREC */
 
@@ -0,0 +1,229 @@
+/* $Id$ */
+/** @file
+ * Video recording pixel format conversion.
+ */
+
+/*
+ * Copyright (C) 2012-2017 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#include <iprt/types.h>
+#include <iprt/string.h>
+
+#ifdef RT_ARCH_AMD64
+# include <emmintrin.h>
+#endif
+
+#include "VideoRec.h"
+
+
+/*
+ * BGRA32 to I420 conversion.
+ *
+ * The kernels convert two lines at a time, as each 2x2 pixel block shares
+ * one U and one V sample. The colors of the block are averaged before
+ * computing U and V. The other pixel formats are expanded to BGRA32 line by
+ * line first. On AMD64 the kernels use SSE2, which is part of the base line.
+ * The Generic variants are plain C; they convert the pixels left over by the
+ * SSE2 loops and serve as the reference in tstVideoRecConv.
+ */
+
+/** Computes Y from 8-bit R, G and B values (BT.601, limited range). */
+#define VIDEOREC_Y(r, g, b)     ((( 66 * (int)(r) + 129 * (int)(g) +  25 * (int)(b) + 128) >> 8) +  16)
+/** Computes U from 8-bit R, G and B values (BT.601, limited range). */
+#define VIDEOREC_U(r, g, b)     (((-38 * (int)(r) -  74 * (int)(g) + 112 * (int)(b) + 128) >> 8) + 128)
+/** Computes V from 8-bit R, G and B values (BT.601, limited range). */
+#define VIDEOREC_V(r, g, b)     (((112 * (int)(r) -  94 * (int)(g) -  18 * (int)(b) + 128) >> 8) + 128)
+
+#ifdef RT_ARCH_AMD64
+/**
+ * Loads 8 BGRA32 pixels and splits them into 16-bit B, G and R vectors.
+ */
+DECLINLINE(void) videoRecSse2LoadBGRA32(const uint8_t *pbSrc, __m128i *pvB, __m128i *pvG, __m128i *pvR)
+{
+    __m128i const vMask = _mm_set1_epi32(0xff);
+    __m128i const vLo   = _mm_loadu_si128((const __m128i *)pbSrc);
+    __m128i const vHi   = _mm_loadu_si128((const __m128i *)(pbSrc + 16));
+    *pvB = _mm_packs_epi32(_mm_and_si128(vLo, vMask), _mm_and_si128(vHi, vMask));
+    *pvG = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(vLo, 8), vMask), _mm_and_si128(_mm_srli_epi32(vHi, 8), vMask));
+    *pvR = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(vLo, 16), vMask), _mm_and_si128(_mm_srli_epi32(vHi, 16), vMask));
+}
+
+/**
+ * Computes 8 Y values, see VIDEOREC_Y.
+ *
+ * The sum fits into an unsigned 16-bit value, so the wrapping 16-bit
+ * arithmetic and a logical shift do the job.
+ */
+DECLINLINE(void) videoRecSse2StoreY(uint8_t *pbY, __m128i vB, __m128i vG, __m128i vR)
+{
+    __m128i vY = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(vR, _mm_set1_epi16(66)),
+                                             _mm_mullo_epi16(vG, _mm_set1_epi16(129))),
+                               _mm_add_epi16(_mm_mullo_epi16(vB, _mm_set1_epi16(25)),
+                                             _mm_set1_epi16(128)));
+    vY = _mm_add_epi16(_mm_srli_epi16(vY, 8), _mm_set1_epi16(16));
+    _mm_storel_epi64((__m128i *)pbY, _mm_packus_epi16(vY, vY));
+}
+
+/**
+ * Computes 4 U or V values from the averaged 2x2 blocks, see VIDEOREC_U and
+ * VIDEOREC_V. The products fit into signed 16-bit values.
+ */
+DECLINLINE(void) videoRecSse2StoreChroma(uint8_t *pbDst, __m128i vB, __m128i vG, __m128i vR,
+                                         int16_t iCoefR, int16_t iCoefG, int16_t iCoefB)
+{
+    __m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(vR, _mm_set1_epi16(iCoefR)),
+                                            _mm_mullo_epi16(vG, _mm_set1_epi16(iCoefG))),
+                              _mm_add_epi16(_mm_mullo_epi16(vB, _mm_set1_epi16(iCoefB)),
+                                            _mm_set1_epi16(128)));
+    v = _mm_add_epi16(_mm_srai_epi16(v, 8), _mm_set1_epi16(128));
+    uint32_t const u32 = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    memcpy(pbDst, &u32, sizeof(u32));
+}
+
+/**
+ * Sums the horizontally adjacent pixels of two lines and averages the 2x2
+ * blocks, returning 4 values in the low 16-bit lanes.
+ */
+DECLINLINE(__m128i) videoRecSse2Average2x2(__m128i v0, __m128i v1)
+{
+    __m128i v = _mm_madd_epi16(_mm_add_epi16(v0, v1), _mm_set1_epi16(1));
+    v = _mm_srli_epi32(_mm_add_epi32(v, _mm_set1_epi32(2)), 2);
+    return _mm_packs_epi32(v, v);
+}
+#endif /* RT_ARCH_AMD64 */
+
+/**
+ * Converts two lines of BGRA32 pixels to I420, plain C version.
+ *
+ * This is the reference for the SSE2 code and handles the pixels left over
+ * by it.
+ *
+ * @param   pbSrc0      The first line.
+ * @param   pbSrc1      The second line.
+ * @param   cx          Number of pixels, even.
+ * @param   pbY0        Where to store the Y values of the first line.
+ * @param   pbY1        Where to store the Y values of the second line.
+ * @param   pbU         Where to store the U values, cx / 2.
+ * @param   pbV         Where to store the V values, cx / 2.
+ */
+void VideoRecConvBGRA32ToI420Generic(const uint8_t *pbSrc0, const uint8_t *pbSrc1, uint32_t cx,
+                                     uint8_t *pbY0, uint8_t *pbY1, uint8_t *pbU, uint8_t *pbV)
+{
+    for (uint32_t x = 0; x < cx; x += 2)
+    {
+        const uint8_t *pb00 = &pbSrc0[x * 4];
+        const uint8_t *pb01 = pb00 + 4;
+        const uint8_t *pb10 = &pbSrc1[x * 4];
+        const uint8_t *pb11 = pb10 + 4;
+        pbY0[x]     = (uint8_t)VIDEOREC_Y(pb00[2], pb00[1], pb00[0]);
+        pbY0[x + 1] = (uint8_t)VIDEOREC_Y(pb01[2], pb01[1], pb01[0]);
+        pbY1[x]     = (uint8_t)VIDEOREC_Y(pb10[2], pb10[1], pb10[0]);
+        pbY1[x + 1] = (uint8_t)VIDEOREC_Y(pb11[2], pb11[1], pb11[0]);
+
+        unsigned const uB = (pb00[0] + pb01[0] + pb10[0] + pb11[0] + 2) >> 2;
+        unsigned const uG = (pb00[1] + pb01[1] + pb10[1] + pb11[1] + 2) >> 2;
+        unsigned const uR = (pb00[2] + pb01[2] + pb10[2] + pb11[2] + 2) >> 2;
+        pbU[x / 2] = (uint8_t)VIDEOREC_U(uR, uG, uB);
+        pbV[x / 2] = (uint8_t)VIDEOREC_V(uR, uG, uB);
+    }
+}
+
+/**
+ * Converts two lines of BGRA32 pixels to I420.
+ *
+ * @param   pbSrc0      The first line.
+ * @param   pbSrc1      The second line.
+ * @param   cx          Number of pixels, even.
+ * @param   pbY0        Where to store the Y values of the first line.
+ * @param   pbY1        Where to store the Y values of the second line.
+ * @param   pbU         Where to store the U values, cx / 2.
+ * @param   pbV         Where to store the V values, cx / 2.
+ */
+void VideoRecConvBGRA32ToI420(const uint8_t *pbSrc0, const uint8_t *pbSrc1, uint32_t cx,
+                              uint8_t *pbY0, uint8_t *pbY1, uint8_t *pbU, uint8_t *pbV)
+{
+    uint32_t x = 0;
+#ifdef RT_ARCH_AMD64
+    for (; x + 8 <= cx; x += 8)
+    {
+        __m128i vB0, vG0, vR0, vB1, vG1, vR1;
+        videoRecSse2LoadBGRA32(&pbSrc0[x * 4], &vB0, &vG0, &vR0);
+        videoRecSse2LoadBGRA32(&pbSrc1[x * 4], &vB1, &vG1, &vR1);
+
+        videoRecSse2StoreY(&pbY0[x], vB0, vG0, vR0);
+        videoRecSse2StoreY(&pbY1[x], vB1, vG1, vR1);
+
+        __m128i const vB = videoRecSse2Average2x2(vB0, vB1);
+        __m128i const vG = videoRecSse2Average2x2(vG0, vG1);
+        __m128i const vR = videoRecSse2Average2x2(vR0, vR1);
+        videoRecSse2StoreChroma(&pbU[x / 2], vB, vG, vR, -38, -74, 112);
+        videoRecSse2StoreChroma(&pbV[x / 2], vB, vG, vR, 112, -94, -18);
+    }
+#endif
+    if (x < cx)
+        VideoRecConvBGRA32ToI420Generic(&pbSrc0[x * 4], &pbSrc1[x * 4], cx - x,
+                                        &pbY0[x], &pbY1[x], &pbU[x / 2], &pbV[x / 2]);
+}
+
+/**
+ * Expands a line of BGR24 pixels to BGRA32.
+ */
+void VideoRecExpandBGR24(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cx)
+{
+    for (uint32_t x = 0; x < cx; x++)
+    {
+        pbDst[x * 4]     = pbSrc[x * 3];
+        pbDst[x * 4 + 1] = pbSrc[x * 3 + 1];
+        pbDst[x * 4 + 2] = pbSrc[x * 3 + 2];
+        pbDst[x * 4 + 3] = 0;
+    }
+}
+
+/**
+ * Expands a line of RGB565 pixels to BGRA32, plain C version.
+ *
+ * The low bits of the components are left zero, like the 565 conversion has
+ * always done.
+ */
+void VideoRecExpandRGB565Generic(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cx)
+{
+    for (uint32_t x = 0; x < cx; x++)
+    {
+        unsigned const uFull = ((unsigned)pbSrc[x * 2 + 1] << 8) | pbSrc[x * 2];
+        pbDst[x * 4]     = (uFull << 3) & 0xf8;
+        pbDst[x * 4 + 1] = (uFull >> 3) & 0xfc;
+        pbDst[x * 4 + 2] = (uFull >> 8) & 0xf8;
+        pbDst[x * 4 + 3] = 0;
+    }
+}
+
+/**
+ * Expands a line of RGB565 pixels to BGRA32.
+ */
+void VideoRecExpandRGB565(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cx)
+{
+    uint32_t x = 0;
+#ifdef RT_ARCH_AMD64
+    for (; x + 8 <= cx; x += 8)
+    {
+        __m128i const v  = _mm_loadu_si128((const __m128i *)&pbSrc[x * 2]);
+        __m128i const vR = _mm_and_si128(_mm_srli_epi16(v, 8), _mm_set1_epi16(0xf8));
+        __m128i const vG = _mm_and_si128(_mm_srli_epi16(v, 3), _mm_set1_epi16(0xfc));
+        __m128i const vB = _mm_and_si128(_mm_slli_epi16(v, 3), _mm_set1_epi16(0xf8));
+        __m128i const vBG = _mm_or_si128(vB, _mm_slli_epi16(vG, 8));
+        _mm_storeu_si128((__m128i *)&pbDst[x * 4],      _mm_unpacklo_epi16(vBG, vR));
+        _mm_storeu_si128((__m128i *)&pbDst[x * 4 + 16], _mm_unpackhi_epi16(vBG, vR));
+    }
+#endif
+    if (x < cx)
+        VideoRecExpandRGB565Generic(&pbDst[x * 4], &pbSrc[x * 2], cx - x);
+}
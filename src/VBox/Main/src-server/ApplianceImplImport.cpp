@@ -925,9 +925,18 @@ RTVFSIOSTREAM Appliance::i_importOpenSourceFile(ImportStack &stack, Utf8Str cons
     }
     else
     {
-        int vrc = RTVfsIoStrmOpenNormal(rstrSrcPath.c_str(), RTFILE_O_OPEN | RTFILE_O_READ | RTFILE_O_DENY_NONE, &hVfsIosSrc);
+        RTVFSIOSTREAM hVfsIosFile;
+        int vrc = RTVfsIoStrmOpenNormal(rstrSrcPath.c_str(), RTFILE_O_OPEN | RTFILE_O_READ | RTFILE_O_DENY_NONE, &hVfsIosFile);
         if (RT_FAILURE(vrc))
             throw setErrorVrc(vrc, tr("Error opening '%s' for reading (%Rrc)"), rstrSrcPath.c_str(), vrc);
+
+        /* Keep several reads in flight.  This has to go below the digest
+           passthru, as parallel read ahead needs a file to read from. */
+        vrc = RTVfsCreateReadAheadForIoStream(hVfsIosFile, RTVFSREADAHEAD_F_PARALLEL, 0 /*cBuffers=default*/,
+                                              0 /*cbBuffers=default*/, &hVfsIosSrc);
+        RTVfsIoStrmRelease(hVfsIosFile);
+        if (RT_FAILURE(vrc))
+            throw setErrorVrc(vrc, tr("Error initializing read ahead thread for '%s' (%Rrc)"), rstrSrcPath.c_str(), vrc);
     }
 
     /*
@@ -1073,10 +1082,11 @@ void Appliance::i_importDecompressFile(ImportStack &stack, Utf8Str const &rstrSr
     }
 
     /*
-     * Add decompression step.
+     * Add decompression step.  Only block-wise (BGZF style) files from third
+     * party tools are inflated in parallel, we don't write such files ourselves.
      */
     RTVFSIOSTREAM hVfsIosSrc;
-    vrc = RTZipGzipDecompressIoStream(hVfsIosReadAhead, 0, &hVfsIosSrc);
+    vrc = RTZipGzipDecompressIoStream(hVfsIosReadAhead, RTZIPGZIPDECOMP_F_PARALLEL, &hVfsIosSrc);
     RTVfsIoStrmRelease(hVfsIosReadAhead);
     if (RT_FAILURE(vrc))
     {
@@ -2131,9 +2141,19 @@ HRESULT Appliance::i_importFSOVA(TaskOVF *pTask, AutoWriteLockBase &rWriteLock)
     if (RT_FAILURE(vrc))
         return setErrorVrc(vrc, tr("Error opening the OVA file '%s' (%Rrc)"), pTask->locInfo.strPath.c_str(), vrc);
 
-    RTVFSFSSTREAM hVfsFssOva;
-    vrc = RTZipTarFsStreamFromIoStream(hVfsIosOva, 0 /*fFlags*/, &hVfsFssOva);
+    /* Keep several reads in flight.  The tar stream isn't a file, so this has
+       to be done here rather than on the individual members. */
+    RTVFSIOSTREAM hVfsIosReadAhead;
+    vrc = RTVfsCreateReadAheadForIoStream(hVfsIosOva, RTVFSREADAHEAD_F_PARALLEL, 0 /*cBuffers=default*/,
+                                          0 /*cbBuffers=default*/, &hVfsIosReadAhead);
     RTVfsIoStrmRelease(hVfsIosOva);
+    if (RT_FAILURE(vrc))
+        return setErrorVrc(vrc, tr("Error initializing read ahead thread for '%s' (%Rrc)"),
+                           pTask->locInfo.strPath.c_str(), vrc);
+
+    RTVFSFSSTREAM hVfsFssOva;
+    vrc = RTZipTarFsStreamFromIoStream(hVfsIosReadAhead, 0 /*fFlags*/, &hVfsFssOva);
+    RTVfsIoStrmRelease(hVfsIosReadAhead);
     if (RT_FAILURE(vrc))
         return setErrorVrc(vrc, tr("Error reading the OVA file '%s' (%Rrc)"), pTask->locInfo.strPath.c_str(), vrc);
 
@@ -2625,9 +2645,11 @@ void Appliance::i_importOneDiskImage(const ovf::DiskImage &di,
                         hVfsIosSrc = i_importOpenSourceFile(stack, strSrcFilePath, strSourceOVF.c_str());
 
                     /* Add a read ahead thread to try speed things up with concurrent reads and
-                       writes going on in different threads. */
+                       writes going on in different threads.  Parallel mode only makes a difference
+                       for the decompressed temporary file, i_importOpenSourceFile already reads
+                       ahead in parallel below the digest passthru where it can. */
                     RTVFSIOSTREAM hVfsIosReadAhead;
-                    vrc = RTVfsCreateReadAheadForIoStream(hVfsIosSrc, 0 /*fFlags*/, 0 /*cBuffers=default*/,
+                    vrc = RTVfsCreateReadAheadForIoStream(hVfsIosSrc, RTVFSREADAHEAD_F_PARALLEL, 0 /*cBuffers=default*/,
                                                           0 /*cbBuffers=default*/, &hVfsIosReadAhead);
                     RTVfsIoStrmRelease(hVfsIosSrc);
                     if (RT_FAILURE(vrc))
@@ -0,0 +1,375 @@
+/* $Id$ */
+/** @file
+ * Display Testcase - BitmapScale32Rect accuracy, sub-rectangles and speed.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** A 32bpp bitmap. */
+typedef struct TSTBITMAP
+{
+    uint8_t *pb;
+    uint32_t cx;
+    uint32_t cy;
+    uint32_t cbLine;
+} TSTBITMAP;
+
+
+/*********************************************************************************************************************************
+*   Internal Functions                                                                                                           *
+*********************************************************************************************************************************/
+/* Code in DisplayResampleImage.cpp, see DisplayImpl.h. */
+int BitmapScale32Rect(uint8_t *pbDst, uint32_t cbDstLine, uint32_t cxDst, uint32_t cyDst,
+                      const uint8_t *pbSrc, uint32_t cbSrcLine, uint32_t cxSrc, uint32_t cySrc,
+                      uint32_t xDst, uint32_t yDst, uint32_t cxRect, uint32_t cyRect);
+
+
+/**
+ * The fixed-point scaler BitmapScale32 used before BitmapScale32Rect, kept as
+ * the baseline for the accuracy and speed comparison. Positions are quantized
+ * to 1/16 of a pixel.
+ */
+static void tstOldBitmapScale32(uint8_t *dst, int dstW, int dstH, const uint8_t *src, int iDeltaLine, int srcW, int srcH)
+{
+#define FIXEDPOINT_FROM_INT(i)  ((int32_t)((i) << 4))
+#define FIXEDPOINT_TO_INT(v)    ((int)((v) >> 4))
+#define FIXEDPOINT_FLOOR(v)     ((v) & ~0xF)
+#define FIXEDPOINT_FRACTION(v)  ((v) & 0xF)
+    for (int y = 0; y < dstH; y++)
+    {
+        int32_t const sy1 = FIXEDPOINT_FROM_INT(y * srcH) / dstH;
+        int32_t const sy2 = FIXEDPOINT_FROM_INT((y + 1) * srcH) / dstH;
+        for (int x = 0; x < dstW; x++)
+        {
+            int32_t red = 0, green = 0, blue = 0;
+            int32_t const sx1 = FIXEDPOINT_FROM_INT(x * srcW) / dstW;
+            int32_t const sx2 = FIXEDPOINT_FROM_INT((x + 1) * srcW) / dstW;
+            int32_t const spixels = (sx2 - sx1) * (sy2 - sy1);
+            int32_t sy = sy1;
+            do
+            {
+                int32_t yportion;
+                if (FIXEDPOINT_FLOOR(sy) == FIXEDPOINT_FLOOR(sy1))
+                {
+                    yportion = FIXEDPOINT_FROM_INT(1) - FIXEDPOINT_FRACTION(sy);
+                    if (yportion > sy2 - sy1)
+                        yportion = sy2 - sy1;
+                    sy = FIXEDPOINT_FLOOR(sy);
+                }
+                else if (sy == FIXEDPOINT_FLOOR(sy2))
+                    yportion = FIXEDPOINT_FRACTION(sy2);
+                else
+                    yportion = FIXEDPOINT_FROM_INT(1);
+
+                const uint8_t *pu8SrcLine = src + iDeltaLine * FIXEDPOINT_TO_INT(sy);
+                int32_t sx = sx1;
+                do
+                {
+                    int32_t xportion;
+                    if (FIXEDPOINT_FLOOR(sx) == FIXEDPOINT_FLOOR(sx1))
+                    {
+                        xportion = FIXEDPOINT_FROM_INT(1) - FIXEDPOINT_FRACTION(sx);
+                        if (xportion > sx2 - sx1)
+                            xportion = sx2 - sx1;
+                        sx = FIXEDPOINT_FLOOR(sx);
+                    }
+                    else if (sx == FIXEDPOINT_FLOOR(sx2))
+                        xportion = FIXEDPOINT_FRACTION(sx2);
+                    else
+                        xportion = FIXEDPOINT_FROM_INT(1);
+                    int32_t const pcontribution = xportion * yportion;
+                    uint32_t const p = *(const uint32_t *)(pu8SrcLine + FIXEDPOINT_TO_INT(sx) * 4);
+                    red   += ((p >> 16) & 0xFF) * pcontribution;
+                    green += ((p >>  8) & 0xFF) * pcontribution;
+                    blue  += ( p        & 0xFF) * pcontribution;
+                    sx += FIXEDPOINT_FROM_INT(1);
+                } while (sx < sx2);
+                sy += FIXEDPOINT_FROM_INT(1);
+            } while (sy < sy2);
+
+            if (spixels != 0)
+            {
+                red   /= spixels;
+                green /= spixels;
+                blue  /= spixels;
+            }
+            *(uint32_t *)(dst + y * dstW * 4 + x * 4) = (RT_MIN(red, 255) << 16) | (RT_MIN(green, 255) << 8) | RT_MIN(blue, 255);
+        }
+    }
+#undef FIXEDPOINT_FROM_INT
+#undef FIXEDPOINT_TO_INT
+#undef FIXEDPOINT_FLOOR
+#undef FIXEDPOINT_FRACTION
+}
+
+
+/**
+ * Computes one channel of a destination pixel with an exact area average in
+ * double precision.
+ */
+static double tstRefPixel(TSTBITMAP const *pSrc, uint32_t cxDst, uint32_t cyDst, uint32_t x, uint32_t y, unsigned iChannel)
+{
+    double const dx1 = (double)x * pSrc->cx / cxDst;
+    double const dx2 = (double)(x + 1) * pSrc->cx / cxDst;
+    double const dy1 = (double)y * pSrc->cy / cyDst;
+    double const dy2 = (double)(y + 1) * pSrc->cy / cyDst;
+
+    double dSum = 0.0;
+    for (uint32_t ySrc = (uint32_t)dy1; ySrc < pSrc->cy && ySrc < dy2; ySrc++)
+    {
+        double const dWeightY = RT_MIN(dy2, ySrc + 1.0) - RT_MAX(dy1, (double)ySrc);
+        for (uint32_t xSrc = (uint32_t)dx1; xSrc < pSrc->cx && xSrc < dx2; xSrc++)
+        {
+            double const dWeightX = RT_MIN(dx2, xSrc + 1.0) - RT_MAX(dx1, (double)xSrc);
+            dSum += pSrc->pb[(size_t)ySrc * pSrc->cbLine + xSrc * 4 + iChannel] * dWeightX * dWeightY;
+        }
+    }
+    return dSum / ((dx2 - dx1) * (dy2 - dy1));
+}
+
+
+/**
+ * Allocates a bitmap with a smooth gradient overlaid by random noise, so that
+ * both the weights and the rounding are exercised.
+ */
+static bool tstBitmapInit(TSTBITMAP *pBitmap, uint32_t cx, uint32_t cy)
+{
+    pBitmap->cx     = cx;
+    pBitmap->cy     = cy;
+    pBitmap->cbLine = cx * 4 + 12; /* not the natural pitch */
+    pBitmap->pb     = (uint8_t *)RTMemAlloc((size_t)pBitmap->cbLine * cy);
+    RTTESTI_CHECK_RET(pBitmap->pb != NULL, false);
+    for (uint32_t y = 0; y < cy; y++)
+        for (uint32_t x = 0; x < cx; x++)
+        {
+            uint8_t *pb = &pBitmap->pb[(size_t)y * pBitmap->cbLine + x * 4];
+            pb[0] = (uint8_t)(x * 255 / cx);
+            pb[1] = (uint8_t)RTRandU32Ex(0, 255);
+            pb[2] = (uint8_t)((x + y) & 1 ? 255 : 0);
+            pb[3] = (uint8_t)RTRandU32Ex(0, 255);
+        }
+    return true;
+}
+
+
+/**
+ * Checks BitmapScale32Rect and the old scaler against the exact area average.
+ */
+static void tstAccuracy(void)
+{
+    RTTestISub("Accuracy");
+
+    static struct { uint32_t cxSrc, cySrc, cxDst, cyDst; } const s_aSizes[] =
+    {
+        { 1024,  768,  100,   75 },
+        {  800,  600,  333,  250 },
+        { 1920, 1080,  160,   90 },
+        {  641,  479,  640,  480 },
+        {   64,   48,  200,  150 },
+        {   37,   23,   37,   23 },
+        {    1,    1,    7,    3 },
+    };
+    uint32_t uMaxErrOld = 0;
+    for (unsigned iSize = 0; iSize < RT_ELEMENTS(s_aSizes); iSize++)
+    {
+        uint32_t const cxDst = s_aSizes[iSize].cxDst;
+        uint32_t const cyDst = s_aSizes[iSize].cyDst;
+        TSTBITMAP Src;
+        if (!tstBitmapInit(&Src, s_aSizes[iSize].cxSrc, s_aSizes[iSize].cySrc))
+            return;
+        uint32_t *pau32New = (uint32_t *)RTMemAlloc((size_t)cxDst * 4 * cyDst);
+        uint32_t *pau32Old = (uint32_t *)RTMemAlloc((size_t)cxDst * 4 * cyDst);
+        if (pau32New && pau32Old)
+        {
+            RTTESTI_CHECK_RC(BitmapScale32Rect((uint8_t *)pau32New, cxDst * 4, cxDst, cyDst,
+                                               Src.pb, Src.cbLine, Src.cx, Src.cy, 0, 0, cxDst, cyDst), VINF_SUCCESS);
+            tstOldBitmapScale32((uint8_t *)pau32Old, (int)cxDst, (int)cyDst, Src.pb, (int)Src.cbLine, (int)Src.cx, (int)Src.cy);
+
+            /* Rounding the exact value gives at most 0.5 off, allow a little for the float accumulation. */
+            double dMaxErrNew = 0.0;
+            for (uint32_t y = 0; y < cyDst; y++)
+                for (uint32_t x = 0; x < cxDst; x++)
+                {
+                    uint32_t const u32New = pau32New[(size_t)y * cxDst + x];
+                    uint32_t const u32Old = pau32Old[(size_t)y * cxDst + x];
+                    RTTESTI_CHECK_MSG_BREAK(!(u32New & UINT32_C(0xFF000000)), ("%u,%u: %#x\n", x, y, u32New));
+                    for (unsigned iChannel = 0; iChannel < 3; iChannel++)
+                    {
+                        double const dRef = tstRefPixel(&Src, cxDst, cyDst, x, y, iChannel);
+                        double const dErrNew = RT_ABS((double)((u32New >> (iChannel * 8)) & 0xFF) - dRef);
+                        double const dErrOld = RT_ABS((double)((u32Old >> (iChannel * 8)) & 0xFF) - dRef);
+                        dMaxErrNew = RT_MAX(dMaxErrNew, dErrNew);
+                        uMaxErrOld = RT_MAX(uMaxErrOld, (uint32_t)(dErrOld + 0.5));
+                    }
+                }
+            RTTESTI_CHECK_MSG(dMaxErrNew <= 0.51, ("%ux%u -> %ux%u: error %d/1000\n", Src.cx, Src.cy, cxDst, cyDst,
+                                                   (int)(dMaxErrNew * 1000)));
+
+            /* Same size is a plain copy. */
+            if (cxDst == Src.cx && cyDst == Src.cy)
+                for (uint32_t y = 0; y < cyDst; y++)
+                    for (uint32_t x = 0; x < cxDst; x++)
+                        RTTESTI_CHECK_MSG_BREAK(   pau32New[(size_t)y * cxDst + x]
+                                                == (*(uint32_t *)&Src.pb[(size_t)y * Src.cbLine + x * 4] & UINT32_C(0x00FFFFFF)),
+                                                ("%u,%u\n", x, y));
+        }
+        else
+            RTTestIFailed("out of memory");
+        RTMemFree(pau32Old);
+        RTMemFree(pau32New);
+        RTMemFree(Src.pb);
+    }
+    RTTestIValue("Old scaler max error", uMaxErrOld, RTTESTUNIT_NONE);
+}
+
+
+/**
+ * Checks that rendering sub-rectangles gives the same pixels as scaling the
+ * whole bitmap and leaves everything else alone.
+ */
+static void tstSubRect(void)
+{
+    RTTestISub("Sub-rectangles");
+
+    uint32_t const cxDst = 301;
+    uint32_t const cyDst = 199;
+    TSTBITMAP Src;
+    if (!tstBitmapInit(&Src, 1023, 767))
+        return;
+    size_t const cbDst = (size_t)cxDst * 4 * cyDst;
+    uint8_t *pbFull = (uint8_t *)RTMemAlloc(cbDst);
+    uint8_t *pbRect = (uint8_t *)RTMemAlloc(cbDst);
+    if (pbFull && pbRect)
+    {
+        RTTESTI_CHECK_RC(BitmapScale32Rect(pbFull, cxDst * 4, cxDst, cyDst, Src.pb, Src.cbLine, Src.cx, Src.cy,
+                                           0, 0, cxDst, cyDst), VINF_SUCCESS);
+        for (unsigned i = 0; i < 200; i++)
+        {
+            uint32_t const xDst   = RTRandU32Ex(0, cxDst - 1);
+            uint32_t const yDst   = RTRandU32Ex(0, cyDst - 1);
+            uint32_t const cxRect = RTRandU32Ex(0, cxDst - xDst);
+            uint32_t const cyRect = RTRandU32Ex(0, cyDst - yDst);
+            memset(pbRect, 0xAA, cbDst);
+            RTTESTI_CHECK_RC_BREAK(BitmapScale32Rect(pbRect, cxDst * 4, cxDst, cyDst, Src.pb, Src.cbLine, Src.cx, Src.cy,
+                                                     xDst, yDst, cxRect, cyRect), VINF_SUCCESS);
+            for (uint32_t y = 0; y < cyDst; y++)
+            {
+                bool const fRow = y >= yDst && y < yDst + cyRect;
+                for (uint32_t x = 0; x < cxDst; x++)
+                {
+                    uint32_t const u32 = ((uint32_t *)pbRect)[(size_t)y * cxDst + x];
+                    if (fRow && x >= xDst && x < xDst + cxRect)
+                        RTTESTI_CHECK_MSG_RETV(u32 == ((uint32_t *)pbFull)[(size_t)y * cxDst + x],
+                                               ("rect %u,%u %ux%u: %u,%u differs\n", xDst, yDst, cxRect, cyRect, x, y));
+                    else
+                        RTTESTI_CHECK_MSG_RETV(u32 == UINT32_C(0xAAAAAAAA),
+                                               ("rect %u,%u %ux%u: %u,%u outside modified\n", xDst, yDst, cxRect, cyRect, x, y));
+                }
+            }
+        }
+
+        /* Rectangles exceeding the destination are refused. */
+        RTTestDisableAssertions(NIL_RTTEST);
+        RTTESTI_CHECK_RC(BitmapScale32Rect(pbRect, cxDst * 4, cxDst, cyDst, Src.pb, Src.cbLine, Src.cx, Src.cy,
+                                           1, 0, cxDst, cyDst), VERR_INVALID_PARAMETER);
+        RTTESTI_CHECK_RC(BitmapScale32Rect(pbRect, cxDst * 4, cxDst, cyDst, Src.pb, Src.cbLine, Src.cx, Src.cy,
+                                           0, cyDst, 1, 1), VERR_INVALID_PARAMETER);
+        RTTestRestoreAssertions(NIL_RTTEST);
+    }
+    else
+        RTTestIFailed("out of memory");
+    RTMemFree(pbRect);
+    RTMemFree(pbFull);
+    RTMemFree(Src.pb);
+}
+
+
+/**
+ * Times BitmapScale32Rect against the old scaler on thumbnail and screenshot
+ * sizes. Only reported, the ratio depends on the host and the build type.
+ */
+static void tstBenchmark(void)
+{
+    RTTestISub("Benchmark");
+
+    static struct { uint32_t cxSrc, cySrc, cxDst, cyDst; const char *pszName; } const s_aSizes[] =
+    {
+        { 1920, 1080,  320,  180, "1920x1080->320x180" },
+        { 1920, 1080, 1280,  720, "1920x1080->1280x720" },
+        { 1024,  768,  640,  480, "1024x768->640x480" },
+    };
+    for (unsigned iSize = 0; iSize < RT_ELEMENTS(s_aSizes); iSize++)
+    {
+        uint32_t const cxDst = s_aSizes[iSize].cxDst;
+        uint32_t const cyDst = s_aSizes[iSize].cyDst;
+        TSTBITMAP Src;
+        if (!tstBitmapInit(&Src, s_aSizes[iSize].cxSrc, s_aSizes[iSize].cySrc))
+            return;
+        uint8_t *pbDst = (uint8_t *)RTMemAlloc((size_t)cxDst * 4 * cyDst);
+        if (pbDst)
+        {
+            unsigned const cIterations = 10;
+            uint64_t nsNew = UINT64_MAX;
+            uint64_t nsOld = UINT64_MAX;
+            for (unsigned i = 0; i < cIterations; i++)
+            {
+                uint64_t nsStart = RTTimeNanoTS();
+                BitmapScale32Rect(pbDst, cxDst * 4, cxDst, cyDst, Src.pb, Src.cbLine, Src.cx, Src.cy, 0, 0, cxDst, cyDst);
+                nsNew = RT_MIN(nsNew, RTTimeNanoTS() - nsStart);
+
+                nsStart = RTTimeNanoTS();
+                tstOldBitmapScale32(pbDst, (int)cxDst, (int)cyDst, Src.pb, (int)Src.cbLine, (int)Src.cx, (int)Src.cy);
+                nsOld = RT_MIN(nsOld, RTTimeNanoTS() - nsStart);
+            }
+            RTTestIValueF(nsNew, RTTESTUNIT_NS, "%s new", s_aSizes[iSize].pszName);
+            RTTestIValueF(nsOld, RTTESTUNIT_NS, "%s old", s_aSizes[iSize].pszName);
+            RTTestIValueF(nsOld * 100 / RT_MAX(nsNew, 1), RTTESTUNIT_PCT, "%s old/new", s_aSizes[iSize].pszName);
+        }
+        else
+            RTTestIFailed("out of memory");
+        RTMemFree(pbDst);
+        RTMemFree(Src.pb);
+    }
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstDisplayResample", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    tstAccuracy();
+    tstSubRect();
+    tstBenchmark();
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
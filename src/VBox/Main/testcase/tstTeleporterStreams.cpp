@@ -0,0 +1,220 @@
+/* $Id$ */
+/** @file
+ * Teleporter multi-stream transport testcase.
+ */
+
+/*
+ * Copyright (C) 2010-2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "TeleporterStreams.h"
+
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/tcp.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+
+#include <VBox/err.h>
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** Writer thread arguments. */
+typedef struct TSTWRITER
+{
+    PTELEPORTERSTREAMS  pStreams;
+    uint64_t            cbTotal;
+    bool                fCancel;
+    int                 rc;
+} TSTWRITER;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static RTTEST g_hTest;
+
+
+/**
+ * Produces the test pattern for the given stream offset.
+ *
+ * Every other megabyte is zero so that the compression has something to chew
+ * on and both block variants get exercised.
+ */
+static void tstFill(uint64_t off, uint8_t *pb, size_t cb)
+{
+    for (size_t i = 0; i < cb; i++, off++)
+        pb[i] = (off >> 20) & 1 ? 0 : (uint8_t)(off * 7 + (off >> 12));
+}
+
+
+static DECLCALLBACK(int) tstWriterThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    TSTWRITER *pArgs = (TSTWRITER *)pvUser;
+    static uint8_t s_abBuf[_128K];
+
+    int      rc  = VINF_SUCCESS;
+    uint64_t off = 0;
+    while (off < pArgs->cbTotal && RT_SUCCESS(rc))
+    {
+        size_t cb = RTRandU32Ex(1, sizeof(s_abBuf));
+        cb = (size_t)RT_MIN(cb, pArgs->cbTotal - off);
+        tstFill(off, s_abBuf, cb);
+        rc = TeleporterStreamsWrite(pArgs->pStreams, s_abBuf, cb);
+        off += cb;
+    }
+    int rc2 = TeleporterStreamsClose(pArgs->pStreams, pArgs->fCancel);
+    pArgs->rc = RT_SUCCESS(rc) ? rc2 : rc;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Transfers a stream over @a cStreams loopback connections and verifies it.
+ */
+static void tstTransfer(PRTTCPSERVER pServer, uint32_t uPort, uint32_t cStreams, uint32_t fFlags, bool fCancel)
+{
+    RTTestSubF(g_hTest, "%u streams%s%s", cStreams, fFlags & TELEPORTERSTREAMS_F_LZF ? ", lzf" : "", fCancel ? ", cancel" : "");
+
+    /*
+     * Connect the streams.
+     */
+    RTSOCKET ahClients[TELEPORTERSTREAMS_MAX];
+    RTSOCKET ahServers[TELEPORTERSTREAMS_MAX];
+    for (uint32_t i = 0; i < cStreams; i++)
+    {
+        RTTESTI_CHECK_RC_RETV(RTTcpClientConnect("127.0.0.1", uPort, &ahClients[i]), VINF_SUCCESS);
+        RTTESTI_CHECK_RC_RETV(RTTcpServerListen2(pServer, &ahServers[i]), VINF_SUCCESS);
+    }
+
+    PTELEPORTERSTREAMS pSrc, pDst;
+    RTTESTI_CHECK_RC_RETV(TeleporterStreamsCreate(true /*fIsSource*/, ahClients, cStreams, fFlags, &pSrc), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_RETV(TeleporterStreamsCreate(false /*fIsSource*/, ahServers, cStreams, 0, &pDst), VINF_SUCCESS);
+
+    /*
+     * Write on a separate thread and verify what we read here.
+     */
+    TSTWRITER Args;
+    Args.pStreams = pSrc;
+    Args.cbTotal  = _32M + RTRandU32Ex(0, _1M);
+    Args.fCancel  = fCancel;
+    Args.rc       = VERR_INTERNAL_ERROR;
+    RTTHREAD hThread;
+    RTTESTI_CHECK_RC_RETV(RTThreadCreate(&hThread, tstWriterThread, &Args, 0, RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE,
+                                         "Writer"), VINF_SUCCESS);
+
+    static uint8_t s_abBuf[_128K];
+    static uint8_t s_abExpect[_128K];
+    uint64_t off = 0;
+    int rc;
+    for (;;)
+    {
+        size_t cbRead = 0;
+        size_t cbToRead = RTRandU32Ex(1, sizeof(s_abBuf));
+        if (RTRandU32Ex(0, 1))
+            rc = TeleporterStreamsRead(pDst, s_abBuf, cbToRead, &cbRead);
+        else
+        {
+            cbToRead = (size_t)RT_MIN(cbToRead, RT_MAX(Args.cbTotal - off, 1));
+            rc = TeleporterStreamsRead(pDst, s_abBuf, cbToRead, NULL);
+            if (RT_SUCCESS(rc))
+                cbRead = cbToRead;
+        }
+        if (RT_FAILURE(rc))
+            break;
+        tstFill(off, s_abExpect, cbRead);
+        if (memcmp(s_abBuf, s_abExpect, cbRead))
+        {
+            RTTestFailed(g_hTest, "Data mismatch at %#RX64 LB %#zx", off, cbRead);
+            break;
+        }
+        off += cbRead;
+    }
+
+    RTTESTI_CHECK_RC(RTThreadWait(hThread, RT_INDEFINITE_WAIT, NULL), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(Args.rc, VINF_SUCCESS);
+    if (fCancel)
+        RTTESTI_CHECK_RC(rc, VERR_SSM_CANCELLED);
+    else
+    {
+        RTTESTI_CHECK_RC(rc, VERR_EOF);
+        RTTESTI_CHECK_MSG(off == Args.cbTotal, ("off=%#RX64 cbTotal=%#RX64\n", off, Args.cbTotal));
+    }
+
+    TELEPORTERSTREAMSSTATS SrcStats, DstStats;
+    TeleporterStreamsQueryStats(pSrc, &SrcStats);
+    TeleporterStreamsQueryStats(pDst, &DstStats);
+    if (!fCancel)
+    {
+        RTTESTI_CHECK(SrcStats.cbStream == Args.cbTotal);
+        RTTESTI_CHECK(DstStats.cbStream == Args.cbTotal);
+        RTTESTI_CHECK(SrcStats.cBlocks == DstStats.cBlocks);
+        RTTESTI_CHECK(SrcStats.cBlocksCompressed == DstStats.cBlocksCompressed);
+        if (fFlags & TELEPORTERSTREAMS_F_LZF)
+            RTTESTI_CHECK(SrcStats.cBlocksCompressed > 0 && SrcStats.cbWire < Args.cbTotal);
+        else
+            RTTESTI_CHECK(SrcStats.cBlocksCompressed == 0);
+        RTTestValueF(g_hTest, SrcStats.cbStream * RT_NS_1SEC / RT_MAX(SrcStats.cNsElapsed, 1) / _1M,
+                     RTTESTUNIT_MEGABYTES_PER_SEC, "%u streams%s", cStreams, fFlags & TELEPORTERSTREAMS_F_LZF ? ", lzf" : "");
+    }
+
+    RTTESTI_CHECK_RC(TeleporterStreamsDestroy(pSrc), VINF_SUCCESS);
+    RTTESTI_CHECK_RC(TeleporterStreamsDestroy(pDst), VINF_SUCCESS);
+    for (uint32_t i = 0; i < cStreams; i++)
+    {
+        RTTcpClientClose(ahClients[i]);
+        RTTcpServerDisconnectClient2(ahServers[i]);
+    }
+}
+
+
+int main()
+{
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstTeleporterStreams", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    /*
+     * Create a loopback server on some random port.
+     */
+    PRTTCPSERVER pServer = NULL;
+    uint32_t     uPort   = 0;
+    int          rc      = VERR_NET_ADDRESS_IN_USE;
+    for (unsigned cTries = 0; cTries < 256 && rc == VERR_NET_ADDRESS_IN_USE; cTries++)
+    {
+        uPort = RTRandU32Ex(49152, 65534);
+        rc = RTTcpServerCreateEx("127.0.0.1", uPort, &pServer);
+    }
+    if (RT_SUCCESS(rc))
+    {
+        tstTransfer(pServer, uPort, 1, 0, false /*fCancel*/);
+        tstTransfer(pServer, uPort, 4, 0, false /*fCancel*/);
+        tstTransfer(pServer, uPort, 4, TELEPORTERSTREAMS_F_LZF, false /*fCancel*/);
+        tstTransfer(pServer, uPort, TELEPORTERSTREAMS_MAX, TELEPORTERSTREAMS_F_LZF, false /*fCancel*/);
+        tstTransfer(pServer, uPort, 3, TELEPORTERSTREAMS_F_LZF, true /*fCancel*/);
+        RTTcpServerDestroy(pServer);
+    }
+    else
+        RTTestFailed(g_hTest, "RTTcpServerCreateEx -> %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
@@ -0,0 +1,185 @@
+/* $Id$ */
+/** @file
+ * Video recording pixel format conversion testcase.
+ */
+
+/*
+ * Copyright (C) 2017 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+#include "VideoRec.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The longest line tested, in pixels. */
+#define TST_MAX_PIXELS      256
+/** Guard bytes behind every output buffer. */
+#define TST_GUARD           16
+
+
+/**
+ * Checks that the guard bytes behind a buffer are untouched.
+ */
+static bool tstCheckGuard(const uint8_t *pb, const char *pszWhat, uint32_t cx)
+{
+    for (unsigned i = 0; i < TST_GUARD; i++)
+        if (pb[i] != 0xAA)
+        {
+            RTTestIFailed("%s: cx=%u overwrites the guard\n", pszWhat, cx);
+            return false;
+        }
+    return true;
+}
+
+
+/**
+ * Compares VideoRecConvBGRA32ToI420, which uses SSE2 on AMD64, with the
+ * plain C version for all line lengths around the SSE2 block size and
+ * misaligned buffers.
+ */
+static void tstConvBGRA32ToI420(void)
+{
+    RTTestISub("BGRA32 to I420");
+
+    static uint8_t s_abSrc0[TST_MAX_PIXELS * 4 + 16];
+    static uint8_t s_abSrc1[TST_MAX_PIXELS * 4 + 16];
+    static uint8_t s_abY0[2][TST_MAX_PIXELS + TST_GUARD + 16];
+    static uint8_t s_abY1[2][TST_MAX_PIXELS + TST_GUARD + 16];
+    static uint8_t s_abU[2][TST_MAX_PIXELS / 2 + TST_GUARD + 16];
+    static uint8_t s_abV[2][TST_MAX_PIXELS / 2 + TST_GUARD + 16];
+
+    for (unsigned iRound = 0; iRound < 64; iRound++)
+    {
+        /* Random pixels, with every other round using the extremes which stress the 16-bit arithmetic. */
+        for (unsigned i = 0; i < sizeof(s_abSrc0); i++)
+        {
+            s_abSrc0[i] = (uint8_t)(iRound & 1 ? RTRandU32Ex(0, 255) : RTRandU32Ex(0, 1) * 255);
+            s_abSrc1[i] = (uint8_t)(iRound & 1 ? RTRandU32Ex(0, 255) : RTRandU32Ex(0, 1) * 255);
+        }
+
+        uint32_t const offSrc = RTRandU32Ex(0, 15);
+        uint32_t const offDst = RTRandU32Ex(0, 15);
+        for (uint32_t cx = 0; cx <= TST_MAX_PIXELS - 4; cx += 2)
+        {
+            for (unsigned iImpl = 0; iImpl < 2; iImpl++)
+            {
+                memset(s_abY0[iImpl], 0xAA, sizeof(s_abY0[iImpl]));
+                memset(s_abY1[iImpl], 0xAA, sizeof(s_abY1[iImpl]));
+                memset(s_abU[iImpl],  0xAA, sizeof(s_abU[iImpl]));
+                memset(s_abV[iImpl],  0xAA, sizeof(s_abV[iImpl]));
+                if (iImpl == 0)
+                    VideoRecConvBGRA32ToI420(&s_abSrc0[offSrc], &s_abSrc1[offSrc], cx,
+                                             &s_abY0[0][offDst], &s_abY1[0][offDst], &s_abU[0][offDst], &s_abV[0][offDst]);
+                else
+                    VideoRecConvBGRA32ToI420Generic(&s_abSrc0[offSrc], &s_abSrc1[offSrc], cx,
+                                                    &s_abY0[1][offDst], &s_abY1[1][offDst], &s_abU[1][offDst], &s_abV[1][offDst]);
+            }
+
+            RTTESTI_CHECK_MSG_RETV(!memcmp(s_abY0[0], s_abY0[1], sizeof(s_abY0[0])), ("Y0 differs, cx=%u\n", cx));
+            RTTESTI_CHECK_MSG_RETV(!memcmp(s_abY1[0], s_abY1[1], sizeof(s_abY1[0])), ("Y1 differs, cx=%u\n", cx));
+            RTTESTI_CHECK_MSG_RETV(!memcmp(s_abU[0],  s_abU[1],  sizeof(s_abU[0])),  ("U differs, cx=%u\n", cx));
+            RTTESTI_CHECK_MSG_RETV(!memcmp(s_abV[0],  s_abV[1],  sizeof(s_abV[0])),  ("V differs, cx=%u\n", cx));
+            if (   !tstCheckGuard(&s_abY0[0][offDst + cx], "Y0", cx)
+                || !tstCheckGuard(&s_abY1[0][offDst + cx], "Y1", cx)
+                || !tstCheckGuard(&s_abU[0][offDst + cx / 2], "U", cx)
+                || !tstCheckGuard(&s_abV[0][offDst + cx / 2], "V", cx))
+                return;
+        }
+    }
+
+    /* Black and white give the limits of the limited range and neutral chroma. */
+    static uint8_t const s_abBlack[8 * 4] = { 0 };
+    static uint8_t s_abWhite[8 * 4];
+    memset(s_abWhite, 0xFF, sizeof(s_abWhite));
+    uint8_t abY0[8], abY1[8], abU[4], abV[4];
+    VideoRecConvBGRA32ToI420(s_abBlack, s_abWhite, 8, abY0, abY1, abU, abV);
+    for (unsigned i = 0; i < 8; i++)
+    {
+        RTTESTI_CHECK(abY0[i] == 16);
+        RTTESTI_CHECK(abY1[i] == 235);
+    }
+    for (unsigned i = 0; i < 4; i++)
+    {
+        RTTESTI_CHECK(abU[i] == 128);
+        RTTESTI_CHECK(abV[i] == 128);
+    }
+}
+
+
+/**
+ * Compares VideoRecExpandRGB565, which uses SSE2 on AMD64, with the plain C
+ * version for every 565 value and all line lengths around the block size.
+ */
+static void tstExpandRGB565(void)
+{
+    RTTestISub("RGB565 expansion");
+
+    static uint16_t s_au16Src[_64K + 8];
+    static uint8_t  s_abDst[2][(_64K + 8) * 4 + TST_GUARD];
+
+    /* Every value once, at an odd offset so the loads are misaligned. */
+    for (uint32_t i = 0; i < _64K; i++)
+        s_au16Src[i + 1] = (uint16_t)i;
+    memset(s_abDst, 0xAA, sizeof(s_abDst));
+    VideoRecExpandRGB565(s_abDst[0], (const uint8_t *)&s_au16Src[1], _64K);
+    VideoRecExpandRGB565Generic(s_abDst[1], (const uint8_t *)&s_au16Src[1], _64K);
+    RTTESTI_CHECK(!memcmp(s_abDst[0], s_abDst[1], sizeof(s_abDst[0])));
+    if (!tstCheckGuard(&s_abDst[0][_64K * 4], "RGB565", _64K))
+        return;
+
+    /* The 565 components land in the top bits of B, G and R. */
+    uint32_t u32;
+    memcpy(&u32, &s_abDst[0][0xF800 * 4], sizeof(u32));
+    RTTESTI_CHECK(u32 == UINT32_C(0x00F80000));
+    memcpy(&u32, &s_abDst[0][0x07E0 * 4], sizeof(u32));
+    RTTESTI_CHECK(u32 == UINT32_C(0x0000FC00));
+    memcpy(&u32, &s_abDst[0][0x001F * 4], sizeof(u32));
+    RTTESTI_CHECK(u32 == UINT32_C(0x000000F8));
+
+    /* The lengths not covered by the SSE2 loop alone. */
+    for (uint32_t cx = 0; cx <= 40; cx++)
+    {
+        for (uint32_t i = 0; i < cx; i++)
+            s_au16Src[i] = (uint16_t)RTRandU32Ex(0, 0xFFFF);
+        memset(s_abDst, 0xAA, sizeof(s_abDst));
+        VideoRecExpandRGB565(s_abDst[0], (const uint8_t *)s_au16Src, cx);
+        VideoRecExpandRGB565Generic(s_abDst[1], (const uint8_t *)s_au16Src, cx);
+        RTTESTI_CHECK_MSG_RETV(!memcmp(s_abDst[0], s_abDst[1], cx * 4 + TST_GUARD), ("cx=%u\n", cx));
+        if (!tstCheckGuard(&s_abDst[0][cx * 4], "RGB565", cx))
+            return;
+    }
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstVideoRecConv", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    tstConvBGRA32ToI420();
+    tstExpandRGB565();
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
@@ -41,6 +41,8 @@ public:
     RTNETADDRIPV4 m_address;
     RTNETADDRIPV4 m_network;
     RTMAC m_mac;
+    /** The client identifier (option 61), empty if the client didn't send one. */
+    std::string m_clientId;
 
     bool fHasClient;
 
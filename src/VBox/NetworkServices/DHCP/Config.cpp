@@ -21,8 +21,14 @@
  */
 
 #include <iprt/asm.h>
+#include <iprt/ctype.h>
+#include <iprt/file.h>
 #include <iprt/getopt.h>
 #include <iprt/net.h>
+#include <iprt/path.h>
+#include <iprt/stream.h>
+#include <iprt/string.h>
+#include <iprt/thread.h>
 #include <iprt/time.h>
 
 #include <VBox/sup.h>
@@ -41,6 +47,8 @@
 #include "../NetLib/VBoxNetLib.h"
 #include "../NetLib/shared_ptr.h"
 
+#include <stdio.h>
+
 #include <list>
 #include <vector>
 #include <map>
@@ -133,21 +141,100 @@ RootConfigEntity::RootConfigEntity(std::string name, uint32_t expPeriod):
     m_u32ExpirationPeriod = expPeriod;
 }
 
+/** Number of journal records after which the lease file is compacted. */
+#define DHCP_JOURNAL_COMPACT_THRESHOLD  1024
+/** Pools larger than this many addresses don't get a free address bitmap. */
+#define DHCP_POOL_BITMAP_MAX_ADDRESSES  _16M
+
+/**
+ * Free address bitmap of an address pool, a set bit means the address is taken.
+ */
+struct AddressPool
+{
+    /** The first address of the pool (host byte order). */
+    uint32_t              u32Lower;
+    /** Number of addresses in the pool. */
+    uint32_t              cAddresses;
+    /** The bitmap, padding bits at the end are set. */
+    std::vector<uint32_t> bitmap;
+
+    bool contains(uint32_t u32) const
+    {
+        return u32 - u32Lower < cAddresses;
+    }
+
+    void mark(uint32_t u32, bool fTaken)
+    {
+        if (contains(u32))
+        {
+            if (fTaken)
+                ASMBitSet(&bitmap[0], (int32_t)(u32 - u32Lower));
+            else
+                ASMBitClear(&bitmap[0], (int32_t)(u32 - u32Lower));
+        }
+    }
+};
+typedef std::map<const NetworkConfigEntity *, AddressPool> MapNetCfg2AddressPool;
+
+/**
+ * Arguments for the background lease file compaction.
+ */
+struct LeaseCompaction
+{
+    /** Snapshot of the leases to write. */
+    std::vector<ClientData> leases;
+    /** The lease file. */
+    com::Utf8Str            strFilename;
+    /** The retired journal to delete once the lease file is written. */
+    com::Utf8Str            strJournalOld;
+};
+
+static int leasesWriteToFile(const std::vector<ClientData>& leases, const com::Utf8Str& strFilename);
+
 /* Configuration Manager */
 struct ConfigurationManager::Data
 {
-    Data():fFileExists(false){}
+    Data():fFileExists(false),
+           m_hJournal(NIL_RTFILE),
+           m_cJournalRecords(0),
+           m_hCompactThread(NIL_RTTHREAD)
+    {}
 
     MapLease2Ip4Address  m_allocations;
     Ipv4AddressContainer m_nameservers;
     Ipv4AddressContainer m_routers;
 
     std::string          m_domainName;
-    VecClient            m_clients;
+    /** Clients by MAC address. */
+    MapMac2Client        m_clientsByMac;
+    /** Clients by client identifier. */
+    MapClientId2Client   m_clientsById;
+    /** Allocated leases by address, mirrors m_allocations. */
+    MapIp4Address2Lease  m_leasesByAddress;
+    /** Free address bitmaps of the pools we've allocated from. */
+    MapNetCfg2AddressPool m_pools;
     com::Utf8Str         m_leaseStorageFilename;
     bool                 fFileExists;
+
+    /** The lease journal, records are appended on every lease change. */
+    RTFILE               m_hJournal;
+    /** Number of records in the journal. */
+    uint32_t             m_cJournalRecords;
+    /** The background compaction thread, NIL if none was started. */
+    RTTHREAD             m_hCompactThread;
+
+    com::Utf8Str journalName() const { return m_leaseStorageFilename + "-journal"; }
+    com::Utf8Str journalOldName() const { return m_leaseStorageFilename + "-journal.old"; }
 };
 
+
+/** Packs a MAC address into a map key. */
+static uint64_t dhcpMacToKey(const RTMAC& mac)
+{
+    return   ((uint64_t)mac.au8[0] << 40) | ((uint64_t)mac.au8[1] << 32) | ((uint64_t)mac.au8[2] << 24)
+           | ((uint64_t)mac.au8[3] << 16) | ((uint64_t)mac.au8[4] <<  8) |  (uint64_t)mac.au8[5];
+}
+
 ConfigurationManager *ConfigurationManager::getConfigurationManager()
 {
     if (!g_ConfigurationManager)
@@ -196,64 +283,88 @@ int ConfigurationManager::loadFromFile(const com::Utf8Str& leaseStorageFileName)
     xml::XmlFileParser parser;
     xml::Document doc;
 
+    bool fParsed = true;
     try {
         parser.read(m->m_leaseStorageFilename.c_str(), doc);
     }
     catch (...)
     {
-        return VINF_SUCCESS;
+        /* No lease file (yet), there may still be a journal though. */
+        fParsed = false;
     }
 
-    /* XML parsing */
-    xml::ElementNode *root = doc.getRootElement();
-
-    if (!root || !root->nameEquals(tagXMLLeases.c_str()))
+    if (fParsed)
     {
-        m->fFileExists = false;
-        return VERR_NOT_FOUND;
-    }
+        /* XML parsing */
+        xml::ElementNode *root = doc.getRootElement();
 
-    com::Utf8Str version;
-    if (root)
-        root->getAttributeValue(tagXMLLeasesAttributeVersion.c_str(), version);
+        if (!root || !root->nameEquals(tagXMLLeases.c_str()))
+        {
+            m->fFileExists = false;
+            return VERR_NOT_FOUND;
+        }
 
-    /* XXX: version check */
-    xml::NodesLoop leases(*root);
+        com::Utf8Str version;
+        if (root)
+            root->getAttributeValue(tagXMLLeasesAttributeVersion.c_str(), version);
 
-    const xml::ElementNode *lease;
-    while ((lease = leases.forAllNodes()))
-    {
-        if (!lease->nameEquals(tagXMLLease.c_str()))
-            continue;
+        /* XXX: version check */
+        xml::NodesLoop leases(*root);
 
-        ClientData *data = new ClientData();
-        Lease l(data);
-        if (l.fromXML(lease))
+        const xml::ElementNode *lease;
+        while ((lease = leases.forAllNodes()))
         {
+            if (!lease->nameEquals(tagXMLLease.c_str()))
+                continue;
 
-            m->m_allocations.insert(MapLease2Ip4AddressPair(l, l.getAddress()));
-
+            ClientData *data = new ClientData();
+            Lease l(data);
+            if (l.fromXML(lease))
+            {
+                addAllocation(l, l.getAddress());
 
-            NetworkConfigEntity *pNetCfg = NULL;
-            Client c(data);
-            int rc = g_RootConfig->match(c, (BaseConfigEntity **)&pNetCfg);
-            Assert(rc >= 0 && pNetCfg); RT_NOREF(rc);
+                NetworkConfigEntity *pNetCfg = NULL;
+                Client c(data);
+                int rc = g_RootConfig->match(c, (BaseConfigEntity **)&pNetCfg);
+                Assert(rc >= 0 && pNetCfg); RT_NOREF(rc);
 
-            l.setConfig(pNetCfg);
+                l.setConfig(pNetCfg);
 
-            m->m_clients.push_back(c);
+                indexClient(c);
+            }
         }
     }
 
+    /*
+     * Replay the journals on top, the retired one first in case a compaction
+     * didn't complete, and fold everything back into the lease file.
+     */
+    bool fReplayed = false;
+    if (RTFileExists(m->journalOldName().c_str()))
+    {
+        journalReplay(m->journalOldName());
+        fReplayed = true;
+    }
+    if (RTFileExists(m->journalName().c_str()))
+    {
+        journalReplay(m->journalName());
+        fReplayed = true;
+    }
+    if (fReplayed)
+        return saveToFile();
+
     return VINF_SUCCESS;
 }
 
 
-int ConfigurationManager::saveToFile()
+/**
+ * Writes the given lease snapshot to the lease file.
+ *
+ * @note    Runs on the compaction thread, so it must not touch the
+ *          configuration manager.
+ */
+static int leasesWriteToFile(const std::vector<ClientData>& leases, const com::Utf8Str& strFilename)
 {
-    if (m->m_leaseStorageFilename.isEmpty())
-        return VINF_SUCCESS;
-
     xml::Document doc;
 
     xml::ElementNode *root = doc.createRootElement(tagXMLLeases.c_str());
@@ -262,11 +373,11 @@ int ConfigurationManager::saveToFile()
 
     root->setAttribute(tagXMLLeasesAttributeVersion.c_str(), tagXMLLeasesVersion_1_0.c_str());
 
-    for(MapLease2Ip4AddressConstIterator it = m->m_allocations.begin();
-        it != m->m_allocations.end(); ++it)
+    for (std::vector<ClientData>::const_iterator it = leases.begin();
+         it != leases.end(); ++it)
     {
         xml::ElementNode *lease = root->createChild(tagXMLLease.c_str());
-        if (!it->first.toXML(lease))
+        if (!Lease::toXML(*it, lease))
         {
             /* XXX: todo logging + error handling */
         }
@@ -274,13 +385,324 @@ int ConfigurationManager::saveToFile()
 
     try {
         xml::XmlFileWriter writer(doc);
-        writer.write(m->m_leaseStorageFilename.c_str(), true);
-    } catch(...){}
+        writer.write(strFilename.c_str(), true);
+    } catch(...)
+    {
+        return VERR_WRITE_ERROR;
+    }
+
+    return VINF_SUCCESS;
+}
+
+
+int ConfigurationManager::saveToFile()
+{
+    if (m->m_leaseStorageFilename.isEmpty())
+        return VINF_SUCCESS;
+
+    return compactLeases(true /* fWait */);
+}
+
+
+/**
+ * Appends a record to the lease journal, opening it if necessary.
+ *
+ * Lease changes are only journaled, the lease file itself is rewritten by
+ * compactLeases() once enough records have piled up.
+ *
+ * @returns VBox status code.
+ * @param   pszFmt      The record format string, a newline is appended.
+ * @param   ...         Format arguments.
+ */
+int ConfigurationManager::journalAppend(const char *pszFmt, ...)
+{
+    if (m->m_leaseStorageFilename.isEmpty())
+        return VINF_SUCCESS;
+
+    if (m->m_hJournal == NIL_RTFILE)
+    {
+        int rc = RTFileOpen(&m->m_hJournal, m->journalName().c_str(),
+                            RTFILE_O_WRITE | RTFILE_O_APPEND | RTFILE_O_OPEN_CREATE | RTFILE_O_DENY_WRITE);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("DHCP: failed to open lease journal '%s': %Rrc\n", m->journalName().c_str(), rc));
+            m->m_hJournal = NIL_RTFILE;
+            return rc;
+        }
+    }
+
+    char szRecord[256];
+    va_list va;
+    va_start(va, pszFmt);
+    size_t cch = RTStrPrintfV(szRecord, sizeof(szRecord) - 1, pszFmt, va);
+    va_end(va);
+    szRecord[cch++] = '\n';
+
+    int rc = RTFileWrite(m->m_hJournal, szRecord, cch, NULL);
+    if (RT_SUCCESS(rc))
+    {
+        if (++m->m_cJournalRecords >= DHCP_JOURNAL_COMPACT_THRESHOLD)
+            compactLeases(false /* fWait */);
+    }
+    return rc;
+}
+
+
+/**
+ * A parsed lease journal record.
+ */
+struct DhcpJournalRecord
+{
+    /** Set for a lease record, clear for an expire record. */
+    bool            fLease;
+    /** The client MAC address. */
+    RTMAC           mac;
+    /** The network (lease records only). */
+    RTNETADDRIPV4   network;
+    /** The leased address (lease records only). */
+    RTNETADDRIPV4   address;
+    /** When the lease was issued (lease records only). */
+    uint64_t        u64Issued;
+    /** The lease expiration period (lease records only). */
+    uint32_t        u32Expiration;
+};
+
+
+/**
+ * Cuts the next blank separated word off a journal line.
+ *
+ * @returns Pointer to the terminated word, NULL if there is none left.
+ * @param   ppsz        The line position, advanced past the word.
+ */
+static char *dhcpJournalNextWord(char **ppsz)
+{
+    char *psz = RTStrStripL(*ppsz);
+    if (!*psz)
+        return NULL;
+
+    char *pszEnd = psz;
+    while (*pszEnd && !RT_C_IS_SPACE(*pszEnd))
+        pszEnd++;
+    if (*pszEnd)
+        *pszEnd++ = '\0';
+    *ppsz = pszEnd;
+    return psz;
+}
+
+
+/**
+ * Parses a lease journal record, see journalReplay() for the format.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_PARSE_ERROR if the line isn't a valid record.
+ * @param   pszLine     The line, modified.
+ * @param   pRec        Where to return the record.
+ */
+static int dhcpJournalParseRecord(char *pszLine, DhcpJournalRecord *pRec)
+{
+    RT_ZERO(*pRec);
+
+    char *pszCmd = dhcpJournalNextWord(&pszLine);
+    char *pszMac = dhcpJournalNextWord(&pszLine);
+    if (   !pszCmd
+        || !pszMac
+        || RT_FAILURE(RTNetStrToMacAddr(pszMac, &pRec->mac)))
+        return VERR_PARSE_ERROR;
+
+    if (!strcmp(pszCmd, "lease"))
+    {
+        char *pszNetwork    = dhcpJournalNextWord(&pszLine);
+        char *pszAddress    = dhcpJournalNextWord(&pszLine);
+        char *pszIssued     = dhcpJournalNextWord(&pszLine);
+        char *pszExpiration = dhcpJournalNextWord(&pszLine);
+        if (   !pszExpiration
+            || RT_FAILURE(RTNetStrToIPv4Addr(pszNetwork, &pRec->network))
+            || RT_FAILURE(RTNetStrToIPv4Addr(pszAddress, &pRec->address))
+            || RTStrToUInt64Full(pszIssued, 10, &pRec->u64Issued) != VINF_SUCCESS
+            || RTStrToUInt32Full(pszExpiration, 10, &pRec->u32Expiration) != VINF_SUCCESS)
+            return VERR_PARSE_ERROR;
+        pRec->fLease = true;
+    }
+    else if (strcmp(pszCmd, "expire"))
+        return VERR_PARSE_ERROR;
+
+    /* Nothing may follow. */
+    if (dhcpJournalNextWord(&pszLine))
+        return VERR_PARSE_ERROR;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Replays a lease journal on top of the leases loaded so far.
+ *
+ * @verbatim
+   lease <mac> <network> <address> <issued> <expiration>
+   expire <mac>
+   @endverbatim
+ *
+ * Records which don't parse, like a torn last line after a crash, are skipped.
+ *
+ * @returns VBox status code.
+ * @param   strJournal  The journal file.
+ */
+int ConfigurationManager::journalReplay(const com::Utf8Str& strJournal)
+{
+    PRTSTREAM pStrm;
+    int rc = RTStrmOpen(strJournal.c_str(), "r", &pStrm);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    char szLine[256];
+    while (RT_SUCCESS(RTStrmGetLine(pStrm, szLine, sizeof(szLine))))
+    {
+        DhcpJournalRecord rec;
+        if (RT_FAILURE(dhcpJournalParseRecord(szLine, &rec)))
+        {
+            LogRel(("DHCP: skipping malformed lease journal record\n"));
+            continue;
+        }
+
+        RTMAC const mac = rec.mac;
+        if (rec.fLease)
+        {
+            ClientData *data = new ClientData();
+            data->m_mac = mac;
+            data->m_network = rec.network;
+            data->m_address = rec.address;
+            data->u64TimestampLeasingStarted = rec.u64Issued;
+            data->u32LeaseExpirationPeriod = rec.u32Expiration;
+            data->fBinding = false;
+            data->fHasLease = true;
+
+            /* Drop whatever the client had before. */
+            MapMac2ClientIterator itClient = m->m_clientsByMac.find(dhcpMacToKey(mac));
+            if (itClient != m->m_clientsByMac.end())
+            {
+                Lease old = itClient->second.lease();
+                if (old != Lease::NullLease)
+                {
+                    MapLease2Ip4AddressIterator it = m->m_allocations.find(old);
+                    if (it != m->m_allocations.end())
+                        removeAllocation(it);
+                }
+                if (!itClient->second.m->m_clientId.empty())
+                    m->m_clientsById.erase(itClient->second.m->m_clientId);
+                m->m_clientsByMac.erase(itClient);
+            }
+
+            Lease l(data);
+            Lease taken;
+            if (isAddressTaken(data->m_address, taken))
+            {
+                MapLease2Ip4AddressIterator it = m->m_allocations.find(taken);
+                if (it != m->m_allocations.end())
+                    removeAllocation(it);
+            }
+            addAllocation(l, data->m_address);
+
+            NetworkConfigEntity *pNetCfg = NULL;
+            Client c(data);
+            g_RootConfig->match(c, (BaseConfigEntity **)&pNetCfg);
+            l.setConfig(pNetCfg);
+            indexClient(c);
+        }
+        else
+        {
+            MapMac2ClientIterator itClient = m->m_clientsByMac.find(dhcpMacToKey(mac));
+            if (itClient != m->m_clientsByMac.end())
+            {
+                Lease old = itClient->second.lease();
+                if (old != Lease::NullLease)
+                {
+                    MapLease2Ip4AddressIterator it = m->m_allocations.find(old);
+                    if (it != m->m_allocations.end())
+                        removeAllocation(it);
+                }
+            }
+        }
+    }
 
+    RTStrmClose(pStrm);
     return VINF_SUCCESS;
 }
 
 
+/**
+ * Compacts the journal into the lease file.
+ *
+ * The current journal is retired and a snapshot of the leases is written to
+ * the lease file by a background thread, which deletes the retired journal
+ * when done.  Should we crash in between, loadFromFile() replays the retired
+ * journal.
+ *
+ * @returns VBox status code.
+ * @param   fWait       Whether to write the lease file synchronously.
+ */
+int ConfigurationManager::compactLeases(bool fWait)
+{
+    if (m->m_hCompactThread != NIL_RTTHREAD)
+    {
+        /* Still busy with the previous compaction?  Try again later. */
+        int rc = RTThreadWait(m->m_hCompactThread, fWait ? RT_INDEFINITE_WAIT : 0, NULL);
+        if (RT_FAILURE(rc))
+            return fWait ? rc : VINF_SUCCESS;
+        m->m_hCompactThread = NIL_RTTHREAD;
+    }
+
+    LeaseCompaction *pArgs = new LeaseCompaction();
+    pArgs->strFilename = m->m_leaseStorageFilename;
+    pArgs->strJournalOld = m->journalOldName();
+    for (MapLease2Ip4AddressConstIterator it = m->m_allocations.begin();
+         it != m->m_allocations.end(); ++it)
+        pArgs->leases.push_back(*it->first.m.get());
+
+    /* Retire the journal, new records go to a fresh one. */
+    if (m->m_hJournal != NIL_RTFILE)
+    {
+        RTFileClose(m->m_hJournal);
+        m->m_hJournal = NIL_RTFILE;
+    }
+    if (RTFileExists(m->journalName().c_str()))
+        RTFileRename(m->journalName().c_str(), pArgs->strJournalOld.c_str(), RTPATHRENAME_FLAGS_REPLACE);
+    m->m_cJournalRecords = 0;
+
+    if (!fWait)
+    {
+        int rc = RTThreadCreate(&m->m_hCompactThread, ConfigurationManager::compactLeasesThread, pArgs, 0,
+                                RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "DhcpLeases");
+        if (RT_SUCCESS(rc))
+            return VINF_SUCCESS;
+        m->m_hCompactThread = NIL_RTTHREAD;
+    }
+
+    return compactLeasesThread(NIL_RTTHREAD, pArgs);
+}
+
+
+/**
+ * Writes a lease snapshot and deletes the retired journal, see compactLeases().
+ *
+ * @returns VBox status code.
+ * @param   hThreadSelf Unused.
+ * @param   pvUser      The LeaseCompaction, freed.
+ */
+/* static */ DECLCALLBACK(int) ConfigurationManager::compactLeasesThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    LeaseCompaction *pArgs = (LeaseCompaction *)pvUser;
+
+    int rc = leasesWriteToFile(pArgs->leases, pArgs->strFilename);
+    if (RT_SUCCESS(rc))
+        RTFileDelete(pArgs->strJournalOld.c_str());
+    else
+        LogRel(("DHCP: failed to write lease file '%s': %Rrc\n", pArgs->strFilename.c_str(), rc));
+
+    delete pArgs;
+    return rc;
+}
+
+
 int ConfigurationManager::extractRequestList(PCRTNETBOOTP pDhcpMsg, size_t cbDhcpMsg, RawOption& rawOpt)
 {
     return ConfigurationManager::findOption(RTNET_DHCP_OPT_PARAM_REQ_LIST, pDhcpMsg, cbDhcpMsg, rawOpt);
@@ -289,8 +711,6 @@ int ConfigurationManager::extractRequestList(PCRTNETBOOTP pDhcpMsg, size_t cbDhc
 
 Client ConfigurationManager::getClientByDhcpPacket(const RTNETBOOTP *pDhcpMsg, size_t cbDhcpMsg)
 {
-
-    VecClientIterator it;
     bool fDhcpValid = false;
     uint8_t uMsgType = 0;
 
@@ -298,29 +718,43 @@ Client ConfigurationManager::getClientByDhcpPacket(const RTNETBOOTP *pDhcpMsg, s
     AssertReturn(fDhcpValid, Client::NullClient);
 
     LogFlowFunc(("dhcp:mac:%RTmac\n", &pDhcpMsg->bp_chaddr.Mac));
+
     /* 1st. client IDs */
-    for ( it = m->m_clients.begin();
-         it != m->m_clients.end();
-         ++it)
+    std::string clientId;
+    RawOption opt;
+    int rc = findOption(RTNET_DHCP_OPT_CLIENT_ID, pDhcpMsg, cbDhcpMsg, opt);
+    if (RT_SUCCESS(rc) && opt.cbRawOpt)
     {
-        if ((*it) == pDhcpMsg->bp_chaddr.Mac)
+        clientId.assign((const char *)&opt.au8RawOpt[0], opt.cbRawOpt);
+        MapClientId2ClientIterator it = m->m_clientsById.find(clientId);
+        if (it != m->m_clientsById.end())
         {
-            LogFlowFunc(("client:mac:%RTmac\n",  it->getMacAddress()));
-            /* check timestamp that request wasn't expired. */
-            return (*it);
+            LogFlowFunc(("client:id:%.*Rhxs\n", opt.cbRawOpt, &opt.au8RawOpt[0]));
+            return it->second;
         }
     }
 
-    if (it == m->m_clients.end())
+    /* 2nd. MAC addresses */
+    MapMac2ClientIterator it = m->m_clientsByMac.find(dhcpMacToKey(pDhcpMsg->bp_chaddr.Mac));
+    if (it != m->m_clientsByMac.end())
     {
-        /* We hasn't got any session for this client */
-        Client c;
-        c.initWithMac(pDhcpMsg->bp_chaddr.Mac);
-        m->m_clients.push_back(c);
-        return m->m_clients.back();
+        LogFlowFunc(("client:mac:%RTmac\n",  &it->second.getMacAddress()));
+        /* Remember the client ID if we see it for the first time. */
+        if (!clientId.empty() && it->second.m->m_clientId.empty())
+        {
+            it->second.m->m_clientId = clientId;
+            indexClient(it->second);
+        }
+        /* check timestamp that request wasn't expired. */
+        return it->second;
     }
 
-    return Client::NullClient;
+    /* We hasn't got any session for this client */
+    Client c;
+    c.initWithMac(pDhcpMsg->bp_chaddr.Mac);
+    c.m->m_clientId = clientId;
+    indexClient(c);
+    return c;
 }
 
 /**
@@ -447,25 +881,18 @@ Lease ConfigurationManager::allocateLease4Client(const Client& client, PCRTNETBO
         Lease l(cl);
         l.setConfig(pNetCfg);
         l.setAddress(hintAddress);
-        m->m_allocations.insert(MapLease2Ip4AddressPair(l, hintAddress));
+        addAllocation(l, hintAddress);
         return l;
     }
 
-    uint32_t u32 = 0;
-    for(u32 = RT_H2N_U32(pNetCfg->lowerIp().u);
-        u32 <= RT_H2N_U32(pNetCfg->upperIp().u);
-        ++u32)
+    RTNETADDRIPV4 address;
+    if (findFreeAddress(pNetCfg, address))
     {
-        RTNETADDRIPV4 address;
-        address.u = RT_H2N_U32(u32);
-        if (!isAddressTaken(address))
-        {
-            Lease l(cl);
-            l.setConfig(pNetCfg);
-            l.setAddress(address);
-            m->m_allocations.insert(MapLease2Ip4AddressPair(l, address));
-            return l;
-        }
+        Lease l(cl);
+        l.setConfig(pNetCfg);
+        l.setAddress(address);
+        addAllocation(l, address);
+        return l;
     }
 
     return Lease::NullLease;
@@ -484,7 +911,9 @@ int ConfigurationManager::commitLease4Client(Client& client)
     l.setExpiration(pCfg->expirationPeriod());
     l.phaseStart(RTTimeMilliTS());
 
-    saveToFile();
+    journalAppend("lease %RTmac %RTnaipv4 %RTnaipv4 %RU64 %RU32",
+                  &l.m->m_mac, l.m->m_network, l.m->m_address,
+                  l.m->u64TimestampLeasingStarted, l.m->u32LeaseExpirationPeriod);
 
     return VINF_SUCCESS;
 }
@@ -504,7 +933,8 @@ int ConfigurationManager::expireLease4Client(Client& client)
         /*
          * XXX: perhaps it better to keep this allocation ????
          */
-        m->m_allocations.erase(it);
+        removeAllocation(it);
+        journalAppend("expire %RTmac", &client.getMacAddress());
 
         l.expire();
         return VINF_SUCCESS;
@@ -517,19 +947,11 @@ int ConfigurationManager::expireLease4Client(Client& client)
 
 bool ConfigurationManager::isAddressTaken(const RTNETADDRIPV4& addr, Lease& lease)
 {
-    MapLease2Ip4AddressIterator it;
-
-    for (it = m->m_allocations.begin();
-         it != m->m_allocations.end();
-         ++it)
+    MapIp4Address2LeaseIterator it = m->m_leasesByAddress.find(RT_N2H_U32(addr.u));
+    if (it != m->m_leasesByAddress.end())
     {
-        if (it->second.u == addr.u)
-        {
-            if (lease != Lease::NullLease)
-                lease = it->first;
-
-            return true;
-        }
+        lease = it->second;
+        return true;
     }
     lease = Lease::NullLease;
     return false;
@@ -543,6 +965,98 @@ bool ConfigurationManager::isAddressTaken(const RTNETADDRIPV4& addr)
 }
 
 
+void ConfigurationManager::addAllocation(const Lease& lease, const RTNETADDRIPV4& addr)
+{
+    m->m_allocations.insert(MapLease2Ip4AddressPair(lease, addr));
+
+    uint32_t const u32 = RT_N2H_U32(addr.u);
+    m->m_leasesByAddress[u32] = lease;
+    for (MapNetCfg2AddressPool::iterator it = m->m_pools.begin(); it != m->m_pools.end(); ++it)
+        it->second.mark(u32, true);
+}
+
+
+void ConfigurationManager::removeAllocation(MapLease2Ip4AddressIterator itAlloc)
+{
+    uint32_t const u32 = RT_N2H_U32(itAlloc->second.u);
+    MapIp4Address2LeaseIterator it = m->m_leasesByAddress.find(u32);
+    if (   it != m->m_leasesByAddress.end()
+        && it->second == itAlloc->first)
+    {
+        m->m_leasesByAddress.erase(it);
+        for (MapNetCfg2AddressPool::iterator itPool = m->m_pools.begin(); itPool != m->m_pools.end(); ++itPool)
+            itPool->second.mark(u32, false);
+    }
+
+    m->m_allocations.erase(itAlloc);
+}
+
+
+/**
+ * Finds the lowest free address of the given pool.
+ *
+ * The pool gets a free address bitmap on first use, built from the address
+ * index and kept up to date by addAllocation() and removeAllocation().
+ */
+bool ConfigurationManager::findFreeAddress(const NetworkConfigEntity *pNetCfg, RTNETADDRIPV4& addr)
+{
+    uint32_t const u32Lower = RT_N2H_U32(pNetCfg->lowerIp().u);
+    uint32_t const u32Upper = RT_N2H_U32(pNetCfg->upperIp().u);
+    if (u32Upper < u32Lower)
+        return false;
+
+    uint64_t const cAddresses = (uint64_t)u32Upper - u32Lower + 1;
+    if (cAddresses > DHCP_POOL_BITMAP_MAX_ADDRESSES)
+    {
+        /* Huge pool, walk the address index for the first gap instead. */
+        uint32_t u32 = u32Lower;
+        for (MapIp4Address2LeaseConstIterator it = m->m_leasesByAddress.lower_bound(u32Lower);
+             it != m->m_leasesByAddress.end() && it->first == u32;
+             ++it)
+        {
+            if (u32 == u32Upper)
+                return false;
+            u32++;
+        }
+        addr.u = RT_H2N_U32(u32);
+        return true;
+    }
+
+    MapNetCfg2AddressPool::iterator itPool = m->m_pools.find(pNetCfg);
+    if (itPool == m->m_pools.end())
+    {
+        AddressPool pool;
+        pool.u32Lower   = u32Lower;
+        pool.cAddresses = (uint32_t)cAddresses;
+        uint32_t const cBits = RT_ALIGN_32(pool.cAddresses, 32);
+        pool.bitmap.resize(cBits / 32, 0);
+        for (uint32_t iBit = pool.cAddresses; iBit < cBits; iBit++)
+            ASMBitSet(&pool.bitmap[0], (int32_t)iBit);
+        for (MapIp4Address2LeaseConstIterator it = m->m_leasesByAddress.lower_bound(u32Lower);
+             it != m->m_leasesByAddress.end() && it->first <= u32Upper;
+             ++it)
+            ASMBitSet(&pool.bitmap[0], (int32_t)(it->first - u32Lower));
+        itPool = m->m_pools.insert(MapNetCfg2AddressPool::value_type(pNetCfg, pool)).first;
+    }
+
+    AddressPool &pool = itPool->second;
+    int32_t iBit = ASMBitFirstClear(&pool.bitmap[0], (uint32_t)pool.bitmap.size() * 32);
+    if (iBit < 0)
+        return false;
+
+    addr.u = RT_H2N_U32(pool.u32Lower + (uint32_t)iBit);
+    return true;
+}
+
+
+void ConfigurationManager::indexClient(const Client& client)
+{
+    m->m_clientsByMac[dhcpMacToKey(client.getMacAddress())] = client;
+    if (!client.m->m_clientId.empty())
+        m->m_clientsById[client.m->m_clientId] = client;
+}
+
+
 NetworkConfigEntity *ConfigurationManager::addNetwork(NetworkConfigEntity *,
                                     const RTNETADDRIPV4& networkId,
                                     const RTNETADDRIPV4& netmask,
@@ -674,7 +1188,17 @@ void ConfigurationManager::init()
 }
 
 
-ConfigurationManager::~ConfigurationManager() { if (m) delete m; }
+ConfigurationManager::~ConfigurationManager()
+{
+    if (m)
+    {
+        if (m->m_hCompactThread != NIL_RTTHREAD)
+            RTThreadWait(m->m_hCompactThread, RT_INDEFINITE_WAIT, NULL);
+        if (m->m_hJournal != NIL_RTFILE)
+            RTFileClose(m->m_hJournal);
+        delete m;
+    }
+}
 
 /**
  * Network manager
@@ -1408,6 +1932,13 @@ Lease::Lease(ClientData *pd):m(SharedPtr<ClientData>(pd)){}
 
 bool Lease::toXML(xml::ElementNode *node) const
 {
+    return toXML(*m.get(), node);
+}
+
+
+/* static */ bool Lease::toXML(const ClientData& data, xml::ElementNode *node)
+{
+    const ClientData *m = &data;
     xml::AttributeNode *pAttribNode = node->setAttribute(tagXMLLeaseAttributeMac.c_str(),
                                                          com::Utf8StrFmt("%RTmac", &m->m_mac));
     if (!pAttribNode)
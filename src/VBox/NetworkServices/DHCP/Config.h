@@ -133,6 +133,7 @@ class Lease
     const MapOptionId2RawOption& options() const;
 
     bool toXML(xml::ElementNode *) const;
+    static bool toXML(const ClientData&, xml::ElementNode *);
     bool fromXML(const xml::ElementNode *);
 
     public:
@@ -160,6 +161,22 @@ typedef MapLease2Ip4Address::iterator MapLease2Ip4AddressIterator;
 typedef MapLease2Ip4Address::const_iterator MapLease2Ip4AddressConstIterator;
 typedef MapLease2Ip4Address::value_type MapLease2Ip4AddressPair;
 
+/** Client index by MAC address, the key is the MAC packed into the low 48 bits. */
+typedef std::map<uint64_t, Client> MapMac2Client;
+typedef MapMac2Client::iterator MapMac2ClientIterator;
+typedef MapMac2Client::value_type MapMac2ClientPair;
+
+/** Client index by client identifier (option 61). */
+typedef std::map<std::string, Client> MapClientId2Client;
+typedef MapClientId2Client::iterator MapClientId2ClientIterator;
+typedef MapClientId2Client::value_type MapClientId2ClientPair;
+
+/** Lease index by address, the key is the address in host byte order. */
+typedef std::map<uint32_t, Lease> MapIp4Address2Lease;
+typedef MapIp4Address2Lease::iterator MapIp4Address2LeaseIterator;
+typedef MapIp4Address2Lease::const_iterator MapIp4Address2LeaseConstIterator;
+typedef MapIp4Address2Lease::value_type MapIp4Address2LeasePair;
+
 /**
  *
  */
@@ -426,6 +443,7 @@ public:
     static int extractRequestList(PCRTNETBOOTP pDhcpMsg, size_t cbDhcpMsg, RawOption& rawOpt);
 
     int loadFromFile(const com::Utf8Str&);
+    /** Writes all leases to the lease file synchronously and empties the journal. */
     int saveToFile();
     /**
      *
@@ -473,6 +491,18 @@ private:
     bool isAddressTaken(const RTNETADDRIPV4& addr, Lease& lease);
     bool isAddressTaken(const RTNETADDRIPV4& addr);
 
+    /* Allocation bookkeeping keeping the indexes and pool bitmaps in sync. */
+    void addAllocation(const Lease& lease, const RTNETADDRIPV4& addr);
+    void removeAllocation(MapLease2Ip4AddressIterator it);
+    bool findFreeAddress(const NetworkConfigEntity *pNetCfg, RTNETADDRIPV4& addr);
+    void indexClient(const Client& client);
+
+    /* Lease journal. */
+    int journalAppend(const char *pszFmt, ...);
+    int journalReplay(const com::Utf8Str& strJournal);
+    int compactLeases(bool fWait);
+    static DECLCALLBACK(int) compactLeasesThread(RTTHREAD hThreadSelf, void *pvUser);
+
 public:
     /* nulls */
     const Ipv4AddressContainer m_empty;
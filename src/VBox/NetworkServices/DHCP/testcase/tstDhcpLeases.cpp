@@ -0,0 +1,364 @@
+/* $Id$ */
+/** @file
+ * DHCP server testcase - Lease indexes, journal replay and compaction.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/net.h>
+#include <iprt/path.h>
+#include <iprt/process.h>
+#include <iprt/stream.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+
+#include <VBox/com/string.h>
+
+#define BASE_SERVICES_ONLY
+#include "../../NetLib/VBoxNetBaseService.h"
+#include "../../NetLib/VBoxNetLib.h"
+#include "../../NetLib/shared_ptr.h"
+
+#include <list>
+#include <vector>
+#include <map>
+#include <string>
+
+#include "../Config.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Number of leases committed to push the journal past the compaction threshold
+ * (DHCP_JOURNAL_COMPACT_THRESHOLD in Config.cpp is 1024). */
+#define TST_COMPACT_LEASES      1100
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** A DHCP message buffer. */
+typedef union TSTDHCPMSG
+{
+    RTNETBOOTP  BootP;
+    uint8_t     ab[RTNET_DHCP_NORMAL_SIZE];
+} TSTDHCPMSG;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static RTTEST g_hTest;
+
+
+/**
+ * Builds a test MAC address.
+ */
+static RTMAC tstMac(uint32_t iClient)
+{
+    RTMAC Mac;
+    Mac.au8[0] = 0x02;
+    Mac.au8[1] = 0x00;
+    Mac.au8[2] = (uint8_t)(iClient >> 24);
+    Mac.au8[3] = (uint8_t)(iClient >> 16);
+    Mac.au8[4] = (uint8_t)(iClient >> 8);
+    Mac.au8[5] = (uint8_t)iClient;
+    return Mac;
+}
+
+
+/**
+ * Builds a DHCPDISCOVER message.
+ *
+ * @returns Size of the message.
+ * @param   pMsg        The message buffer.
+ * @param   Mac         The client MAC address.
+ * @param   pszClientId The client identifier (option 61), optional.
+ * @param   pAddrHint   The requested address (option 50), optional.
+ */
+static size_t tstBuildDiscover(TSTDHCPMSG *pMsg, RTMAC Mac, const char *pszClientId, PCRTNETADDRIPV4 pAddrHint)
+{
+    RT_ZERO(*pMsg);
+    pMsg->BootP.bp_op     = RTNETBOOTP_OP_REQUEST;
+    pMsg->BootP.bp_htype  = RTNET_ARP_ETHER;
+    pMsg->BootP.bp_hlen   = sizeof(RTMAC);
+    pMsg->BootP.bp_xid    = 0x1234;
+    pMsg->BootP.bp_chaddr.Mac = Mac;
+    pMsg->BootP.bp_vend.Dhcp.dhcp_cookie = RT_H2N_U32_C(RTNET_DHCP_COOKIE);
+
+    uint8_t *pbOpt = &pMsg->BootP.bp_vend.Dhcp.dhcp_opts[0];
+    *pbOpt++ = RTNET_DHCP_OPT_MSG_TYPE;
+    *pbOpt++ = 1;
+    *pbOpt++ = RTNET_DHCP_MT_DISCOVER;
+    if (pszClientId)
+    {
+        size_t cch = strlen(pszClientId);
+        *pbOpt++ = RTNET_DHCP_OPT_CLIENT_ID;
+        *pbOpt++ = (uint8_t)cch;
+        memcpy(pbOpt, pszClientId, cch);
+        pbOpt += cch;
+    }
+    if (pAddrHint)
+    {
+        *pbOpt++ = RTNET_DHCP_OPT_REQ_ADDR;
+        *pbOpt++ = sizeof(pAddrHint->u);
+        memcpy(pbOpt, &pAddrHint->u, sizeof(pAddrHint->u));
+        pbOpt += sizeof(pAddrHint->u);
+    }
+    *pbOpt++ = RTNET_DHCP_OPT_END;
+    return sizeof(*pMsg);
+}
+
+
+/**
+ * Runs a DISCOVER for the given client and returns the address it was offered.
+ *
+ * @returns The offered address, 0 on failure.
+ * @param   pMgr        The configuration manager.
+ * @param   Mac         The client MAC address.
+ * @param   fCommit     Whether to commit the lease as on DHCPREQUEST.
+ * @param   pszClientId The client identifier, optional.
+ * @param   pAddrHint   The requested address, optional.
+ */
+static RTNETADDRIPV4 tstLease(ConfigurationManager *pMgr, RTMAC Mac, bool fCommit,
+                              const char *pszClientId = NULL, PCRTNETADDRIPV4 pAddrHint = NULL)
+{
+    RTNETADDRIPV4 Addr;
+    Addr.u = 0;
+
+    TSTDHCPMSG Msg;
+    size_t cbMsg = tstBuildDiscover(&Msg, Mac, pszClientId, pAddrHint);
+    Client client = pMgr->getClientByDhcpPacket(&Msg.BootP, cbMsg);
+    Lease l = pMgr->allocateLease4Client(client, &Msg.BootP, cbMsg);
+    if (l == Lease::NullLease)
+    {
+        RTTestFailed(g_hTest, "No lease for %RTmac", &Mac);
+        return Addr;
+    }
+    if (fCommit)
+        RTTEST_CHECK_RC_OK(g_hTest, pMgr->commitLease4Client(client));
+    return l.getAddress();
+}
+
+
+/**
+ * Counts the lines of a text file, 0 if it doesn't exist.
+ */
+static uint32_t tstCountLines(const char *pszFile)
+{
+    PRTSTREAM pStrm;
+    if (RT_FAILURE(RTStrmOpen(pszFile, "r", &pStrm)))
+        return 0;
+    uint32_t cLines = 0;
+    char szLine[512];
+    while (RT_SUCCESS(RTStrmGetLine(pStrm, szLine, sizeof(szLine))))
+        cLines++;
+    RTStrmClose(pStrm);
+    return cLines;
+}
+
+
+/**
+ * Counts the occurrences of a string in a file.
+ */
+static uint32_t tstCountInFile(const char *pszFile, const char *pszNeedle)
+{
+    void  *pv;
+    size_t cb;
+    if (RT_FAILURE(RTFileReadAll(pszFile, &pv, &cb)))
+        return 0;
+    std::string str((const char *)pv, cb);
+    RTFileReadAllFree(pv, cb);
+
+    uint32_t cHits = 0;
+    for (size_t off = str.find(pszNeedle); off != std::string::npos; off = str.find(pszNeedle, off + 1))
+        cHits++;
+    return cHits;
+}
+
+
+static void tstWriteFile(const char *pszFile, const char *pszContent)
+{
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, pszFile, RTFILE_O_WRITE | RTFILE_O_CREATE_REPLACE | RTFILE_O_DENY_NONE);
+    RTTEST_CHECK_RC_OK_RETV(g_hTest, rc);
+    RTTEST_CHECK_RC_OK(g_hTest, RTFileWrite(hFile, pszContent, strlen(pszContent), NULL));
+    RTFileClose(hFile);
+}
+
+
+static void tstCleanup(const char *pszLeases)
+{
+    RTFileDelete(pszLeases);
+    RTFileDelete(com::Utf8StrFmt("%s-journal", pszLeases).c_str());
+    RTFileDelete(com::Utf8StrFmt("%s-journal.old", pszLeases).c_str());
+}
+
+
+int main()
+{
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstDhcpLeases", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    char szLeases[RTPATH_MAX];
+    int rc = RTPathTemp(szLeases, sizeof(szLeases));
+    if (RT_SUCCESS(rc))
+        rc = RTPathAppend(szLeases, sizeof(szLeases), "tstDhcpLeases");
+    if (RT_FAILURE(rc))
+    {
+        RTTestFailed(g_hTest, "Failed to construct the temporary file name: %Rrc", rc);
+        return RTTestSummaryAndDestroy(g_hTest);
+    }
+    RTStrPrintf(&szLeases[strlen(szLeases)], sizeof(szLeases) - strlen(szLeases), "-%u.leases", (unsigned)RTProcSelf());
+    com::Utf8Str strJournal    = com::Utf8StrFmt("%s-journal", szLeases);
+    com::Utf8Str strJournalOld = com::Utf8StrFmt("%s-journal.old", szLeases);
+    tstCleanup(szLeases);
+
+    /* 10.0.0.0/16 handing out 10.0.1.1 thru 10.0.254.254. */
+    ConfigurationManager *pMgr = ConfigurationManager::getConfigurationManager();
+    RTNETADDRIPV4 NetworkId, Netmask, Lower, Upper;
+    RTNetStrToIPv4Addr("10.0.0.0", &NetworkId);
+    RTNetStrToIPv4Addr("255.255.0.0", &Netmask);
+    RTNetStrToIPv4Addr("10.0.1.1", &Lower);
+    RTNetStrToIPv4Addr("10.0.254.254", &Upper);
+    RTTEST_CHECK(g_hTest, pMgr->addNetwork(g_RootConfig, NetworkId, Netmask, Lower, Upper) != NULL);
+    RTTEST_CHECK_RC_OK(g_hTest, pMgr->loadFromFile(szLeases));
+    uint32_t cAllocations = 0;
+
+    /*
+     * Address allocation and the client indexes.
+     */
+    RTTestSub(g_hTest, "Allocation and indexes");
+    RTNETADDRIPV4 aAddrs[16];
+    for (uint32_t i = 0; i < RT_ELEMENTS(aAddrs); i++)
+    {
+        aAddrs[i] = tstLease(pMgr, tstMac(i), true /*fCommit*/);
+        cAllocations++;
+        /* The free address bitmap hands out the lowest free address. */
+        RTTEST_CHECK_MSG(g_hTest, RT_N2H_U32(aAddrs[i].u) == RT_N2H_U32(Lower.u) + i,
+                         (g_hTest, "client %u got %RTnaipv4\n", i, aAddrs[i].u));
+    }
+
+    /* A known client gets its lease back. */
+    RTNETADDRIPV4 Addr = tstLease(pMgr, tstMac(3), false /*fCommit*/);
+    RTTEST_CHECK(g_hTest, Addr.u == aAddrs[3].u);
+
+    /* A client is found by its identifier even when it shows up with another MAC. */
+    RTNETADDRIPV4 AddrId = tstLease(pMgr, tstMac(100), true /*fCommit*/, "tst-client-id");
+    cAllocations++;
+    Addr = tstLease(pMgr, tstMac(101), false /*fCommit*/, "tst-client-id");
+    RTTEST_CHECK_MSG(g_hTest, Addr.u == AddrId.u, (g_hTest, "%RTnaipv4 vs %RTnaipv4\n", Addr.u, AddrId.u));
+
+    /* An expired binding frees its address again, the next client gets it. */
+    RTNETADDRIPV4 AddrExpired = tstLease(pMgr, tstMac(200), false /*fCommit*/);
+    {
+        TSTDHCPMSG Msg;
+        size_t cbMsg = tstBuildDiscover(&Msg, tstMac(200), NULL, NULL);
+        Client client = pMgr->getClientByDhcpPacket(&Msg.BootP, cbMsg);
+        RTTEST_CHECK_RC_OK(g_hTest, pMgr->expireLease4Client(client));
+    }
+    Addr = tstLease(pMgr, tstMac(201), true /*fCommit*/);
+    cAllocations++;
+    RTTEST_CHECK_MSG(g_hTest, Addr.u == AddrExpired.u, (g_hTest, "%RTnaipv4 vs %RTnaipv4\n", Addr.u, AddrExpired.u));
+
+    /* A free requested address is honoured. */
+    RTNETADDRIPV4 Hint;
+    RTNetStrToIPv4Addr("10.0.100.100", &Hint);
+    Addr = tstLease(pMgr, tstMac(202), true /*fCommit*/, NULL, &Hint);
+    cAllocations++;
+    RTTEST_CHECK(g_hTest, Addr.u == Hint.u);
+
+    /* Each commit and the expiry went to the journal, the lease file isn't written yet. */
+    RTTEST_CHECK_MSG(g_hTest, tstCountLines(strJournal.c_str()) == RT_ELEMENTS(aAddrs) + 4,
+                     (g_hTest, "%u journal lines\n", tstCountLines(strJournal.c_str())));
+    RTTEST_CHECK(g_hTest, !RTFileExists(szLeases));
+
+    /*
+     * Saving folds the journal into the lease file.
+     */
+    RTTestSub(g_hTest, "Compaction");
+    RTTEST_CHECK_RC_OK(g_hTest, pMgr->saveToFile());
+    RTTEST_CHECK(g_hTest, !RTFileExists(strJournal.c_str()));
+    RTTEST_CHECK(g_hTest, !RTFileExists(strJournalOld.c_str()));
+    RTTEST_CHECK_MSG(g_hTest, tstCountInFile(szLeases, "<Lease ") == cAllocations,
+                     (g_hTest, "%u leases in the file, expected %u\n", tstCountInFile(szLeases, "<Lease "), cAllocations));
+
+    /* Enough records trigger a background compaction, only the records after it stay in the journal. */
+    for (uint32_t i = 0; i < TST_COMPACT_LEASES; i++)
+    {
+        tstLease(pMgr, tstMac(0x10000 + i), true /*fCommit*/);
+        cAllocations++;
+    }
+    RTTEST_CHECK_MSG(g_hTest, tstCountLines(strJournal.c_str()) == TST_COMPACT_LEASES - 1024,
+                     (g_hTest, "%u journal lines\n", tstCountLines(strJournal.c_str())));
+    RTTEST_CHECK_RC_OK(g_hTest, pMgr->saveToFile());
+    RTTEST_CHECK(g_hTest, !RTFileExists(strJournal.c_str()));
+    RTTEST_CHECK(g_hTest, !RTFileExists(strJournalOld.c_str()));
+    RTTEST_CHECK_MSG(g_hTest, tstCountInFile(szLeases, "<Lease ") == cAllocations,
+                     (g_hTest, "%u leases in the file, expected %u\n", tstCountInFile(szLeases, "<Lease "), cAllocations));
+    tstCleanup(szLeases);
+
+    /*
+     * Replay of journals left behind by a crash, the retired one first.
+     */
+    RTTestSub(g_hTest, "Journal replay");
+    char szLeases2[RTPATH_MAX];
+    RTStrPrintf(szLeases2, sizeof(szLeases2), "%s-2", szLeases);
+    tstCleanup(szLeases2);
+    /* Lease times are RTTimeMilliTS based, keep the replayed leases valid. */
+    uint64_t const uNow = RTTimeMilliTS();
+    tstWriteFile(com::Utf8StrFmt("%s-journal.old", szLeases2).c_str(),
+                 com::Utf8StrFmt("lease 02:00:00:00:03:00 10.0.0.0 10.0.200.1 %RU64 3600\n", uNow).c_str());
+    tstWriteFile(com::Utf8StrFmt("%s-journal", szLeases2).c_str(),
+                 com::Utf8StrFmt("lease 02:00:00:00:03:01 10.0.0.0 10.0.200.2 %RU64 3600\n"
+                                 "lease 02:00:00:00:03:00 10.0.0.0 10.0.200.3 %RU64 3600\n"
+                                 "bogus 02:00:00:00:03:00\n"
+                                 "lease 02:00:00:00:03:02 10.0.0.0 10.0.200.4 12x 3600\n"
+                                 "lease 02:00:00:00:03:02 10.0.0.0 10.0.200.4 %RU64 3600 trailing\n"
+                                 "expire 02:00:00:00:03:01\n"
+                                 "lease 02:00:00:00:03:03 10.0.0.0 10.0.20" /* torn */,
+                                 uNow, uNow, uNow).c_str());
+    RTTEST_CHECK_RC_OK(g_hTest, pMgr->loadFromFile(szLeases2));
+    RTTEST_CHECK(g_hTest, !RTFileExists(com::Utf8StrFmt("%s-journal", szLeases2).c_str()));
+    RTTEST_CHECK(g_hTest, !RTFileExists(com::Utf8StrFmt("%s-journal.old", szLeases2).c_str()));
+
+    /* The moved lease is known at its new address only, the expired and the bad ones are gone. */
+    Addr = tstLease(pMgr, tstMac(0x300), false /*fCommit*/);
+    RTTEST_CHECK_MSG(g_hTest, Addr.u == RT_H2N_U32_C(0x0a00c803), (g_hTest, "%RTnaipv4\n", Addr.u));
+    RTTEST_CHECK(g_hTest, tstCountInFile(szLeases2, "10.0.200.3") == 1);
+    RTTEST_CHECK(g_hTest, tstCountInFile(szLeases2, "10.0.200.1") == 0);
+    RTTEST_CHECK(g_hTest, tstCountInFile(szLeases2, "10.0.200.2") == 0);
+    RTTEST_CHECK(g_hTest, tstCountInFile(szLeases2, "10.0.200.4") == 0);
+    RTTEST_CHECK(g_hTest, tstCountInFile(szLeases2, "02:00:00:00:03:03") == 0);
+
+    /* The addresses freed by the replay can be handed out again. */
+    RTNetStrToIPv4Addr("10.0.200.1", &Hint);
+    Addr = tstLease(pMgr, tstMac(0x400), false /*fCommit*/, NULL, &Hint);
+    RTTEST_CHECK(g_hTest, Addr.u == Hint.u);
+    RTNetStrToIPv4Addr("10.0.200.2", &Hint);
+    Addr = tstLease(pMgr, tstMac(0x401), false /*fCommit*/, NULL, &Hint);
+    RTTEST_CHECK(g_hTest, Addr.u == Hint.u);
+    tstCleanup(szLeases2);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
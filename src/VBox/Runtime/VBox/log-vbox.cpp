@@ -264,6 +264,7 @@ RTDECL(PRTLOGGER) RTLogDefaultInit(void)
     ASSERT_LOG_GROUP(DRV_ACPI);
     ASSERT_LOG_GROUP(DRV_AUDIO);
     ASSERT_LOG_GROUP(DRV_BLOCK);
+    ASSERT_LOG_GROUP(DRV_CAPTURE);
     ASSERT_LOG_GROUP(DRV_CHAR);
     ASSERT_LOG_GROUP(DRV_DISK_INTEGRITY);
     ASSERT_LOG_GROUP(DRV_DISPLAY);
@@ -36,11 +36,24 @@
 #include <iprt/critsect.h>
 #include <iprt/err.h>
 #include <iprt/mem.h>
+#include <iprt/once.h>
 #include <iprt/param.h>
+#include <iprt/thread.h>
 
 #include "internal/magics.h"
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The initial number of rounds in a magazine. */
+#define RTMEMCACHE_MAG_ROUNDS_INIT          16
+/** The max number of rounds in a magazine. */
+#define RTMEMCACHE_MAG_ROUNDS_MAX           256
+/** The number of depot operations between each working set update. */
+#define RTMEMCACHE_DEPOT_REAP_INTERVAL      1024
+
+
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
@@ -48,6 +61,10 @@
 typedef struct RTMEMCACHEINT  *PRTMEMCACHEINT;
 /** Pointer to a cache page. */
 typedef struct RTMEMCACHEPAGE *PRTMEMCACHEPAGE;
+/** Pointer to a magazine. */
+typedef struct RTMEMCACHEMAG *PRTMEMCACHEMAG;
+/** Pointer to the per-thread magazine state. */
+typedef struct RTMEMCACHETHRD *PRTMEMCACHETHRD;
 
 
 
@@ -99,6 +116,56 @@ typedef struct RTMEMCACHEPAGE
 AssertCompileMemberOffset(RTMEMCACHEPAGE, cFree, 64);
 
 
+/**
+ * A magazine, i.e. a stack of allocated (and constructed) objects.
+ *
+ * Magazines are either loaded by a thread (RTMEMCACHETHRD) or sitting in the
+ * depot of the cache.  Those in the depot are always completely full or
+ * completely empty.
+ */
+typedef struct RTMEMCACHEMAG
+{
+    /** Pointer to the next magazine in the depot list. */
+    PRTMEMCACHEMAG              pNext;
+    /** The number of objects (rounds) in the magazine. */
+    uint32_t                    cRounds;
+    /** The capacity of the magazine. */
+    uint32_t                    cRoundsMax;
+    /** The objects. */
+    void                       *apvRounds[1];
+} RTMEMCACHEMAG;
+
+
+/**
+ * The per-thread magazine state of a cache.
+ *
+ * A thread has one of these for each cache with magazines it has used, they
+ * are chained off the shared TLS entry (g_iMemCacheTls) with the most
+ * recently used one first.  Only the owning thread touches the magazines and
+ * the pNextInThread list, pNext is protected by RTMEMCACHEINT::CritSect.
+ *
+ * When a cache is destroyed before the thread terminates, the cache frees the
+ * magazines and sets pCache to NULL, leaving the structure itself to the
+ * owning thread.
+ */
+typedef struct RTMEMCACHETHRD
+{
+    /** The loaded magazine, objects are allocated from and freed to this one. */
+    PRTMEMCACHEMAG              pLoaded;
+    /** The previously loaded magazine, always full or empty. */
+    PRTMEMCACHEMAG              pPrevious;
+    /** Pointer to the cache, NULL if the cache has been destroyed. */
+    PRTMEMCACHEINT volatile     pCache;
+    /** Pointer to the next thread state of the cache. */
+    PRTMEMCACHETHRD             pNext;
+    /** Pointer to the next state of the owning thread (other caches). */
+    PRTMEMCACHETHRD             pNextInThread;
+    /** Padding to keep the state of different threads in different cache lines. */
+    uint8_t                     abPadding[64 - 5 * sizeof(void *)];
+} RTMEMCACHETHRD;
+AssertCompileSize(RTMEMCACHETHRD, 64);
+
+
 /**
  * Memory object cache instance.
  */
@@ -130,9 +197,39 @@ typedef struct RTMEMCACHEINT
     PFNMEMCACHEDTOR             pfnDtor;
     /** Callback argument. */
     void                       *pvUser;
-    /** Critical section serializing page allocation and similar. */
+    /** Critical section serializing page allocation and similar, this also
+     * protects the magazine depot and the thread state list. */
     RTCRITSECT                  CritSect;
 
+    /** @name Magazine layer (RTMEMCACHE_F_MAGAZINES).
+     * @{ */
+    /** Whether the magazine layer is used. */
+    bool                        fMagazines;
+    /** The per-thread states. */
+    PRTMEMCACHETHRD             pThreadHead;
+    /** Depot: Full magazines. */
+    PRTMEMCACHEMAG volatile     pDepotFull;
+    /** Depot: Empty magazines. */
+    PRTMEMCACHEMAG              pDepotEmpty;
+    /** The number of magazines in the pDepotFull list. */
+    uint32_t                    cDepotFull;
+    /** The number of magazines in the pDepotEmpty list. */
+    uint32_t                    cDepotEmpty;
+    /** The lowest cDepotFull value since the last working set update.  This
+     * many full magazines were not needed during the interval. */
+    uint32_t                    cDepotFullMin;
+    /** The lowest cDepotEmpty value since the last working set update. */
+    uint32_t                    cDepotEmptyMin;
+    /** Depot operations since the last working set update. */
+    uint32_t                    cDepotOps;
+    /** The number of times the depot lock was found busy since the last
+     * working set update. */
+    uint32_t volatile           cDepotContention;
+    /** The capacity of new magazines.  This is increased when there is
+     * contention on the depot. */
+    uint32_t volatile           cMagRounds;
+    /** @} */
+
     /** The total object count. */
     uint32_t volatile           cTotal;
     /** The number of free objects. */
@@ -153,6 +250,43 @@ typedef struct RTMEMCACHEINT
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
 static void rtMemCacheFreeList(RTMEMCACHEINT *pThis, PRTMEMCACHEFREEOBJ pHead);
+static void rtMemCacheFreeInner(RTMEMCACHEINT *pThis, void *pvObj);
+static DECLCALLBACK(void) rtMemCacheThrdDtor(void *pvValue);
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** Initialize the magazine layer globals once. */
+static RTONCE                   g_MemCacheTlsOnce = RTONCE_INITIALIZER;
+/** The TLS entry shared by all caches with magazines.  It points to the
+ * calling thread's list of RTMEMCACHETHRD structures.  NIL_RTTLS if not
+ * available, in which case no cache uses magazines. */
+static RTTLS                    g_iMemCacheTls = NIL_RTTLS;
+/** Serializes the TLS destructor against cache destruction. */
+static RTCRITSECT               g_MemCacheThrdCritSect;
+
+
+/**
+ * @callback_method_impl{FNRTONCE, Allocates the shared TLS entry.}
+ */
+static DECLCALLBACK(int32_t) rtMemCacheTlsInitOnce(void *pvUser)
+{
+    RT_NOREF(pvUser);
+
+    /* Without a TLS destructor the magazines of terminated threads would be
+       stranded until the cache is destroyed, so we don't do magazines then. */
+    int rc = RTCritSectInit(&g_MemCacheThrdCritSect);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTTlsAllocEx(&g_iMemCacheTls, rtMemCacheThrdDtor);
+        if (RT_SUCCESS(rc))
+            return VINF_SUCCESS;
+        g_iMemCacheTls = NIL_RTTLS;
+        RTCritSectDelete(&g_MemCacheThrdCritSect);
+    }
+    return rc;
+}
 
 
 RTDECL(int) RTMemCacheCreate(PRTMEMCACHE phMemCache, size_t cbObject, size_t cbAlignment, uint32_t cMaxObjects,
@@ -165,7 +299,7 @@ RTDECL(int) RTMemCacheCreate(PRTMEMCACHE phMemCache, size_t cbObject, size_t cbA
     AssertReturn(!pfnDtor || pfnCtor, VERR_INVALID_PARAMETER);
     AssertReturn(cbObject > 0, VERR_INVALID_PARAMETER);
     AssertReturn(cbObject <= PAGE_SIZE / 8, VERR_INVALID_PARAMETER);
-    AssertReturn(!fFlags, VERR_INVALID_PARAMETER);
+    AssertReturn(!(fFlags & ~RTMEMCACHE_F_VALID_MASK), VERR_INVALID_FLAGS);
 
     if (cbAlignment == 0)
     {
@@ -224,6 +358,23 @@ RTDECL(int) RTMemCacheCreate(PRTMEMCACHE phMemCache, size_t cbObject, size_t cbA
     pThis->cFree            = 0;
     pThis->pPageHint        = NULL;
     pThis->pFreeTop         = NULL;
+    pThis->fMagazines       = false;
+    pThis->pThreadHead      = NULL;
+    pThis->pDepotFull       = NULL;
+    pThis->pDepotEmpty      = NULL;
+    pThis->cDepotFull       = 0;
+    pThis->cDepotEmpty      = 0;
+    pThis->cDepotFullMin    = 0;
+    pThis->cDepotEmptyMin   = 0;
+    pThis->cDepotOps        = 0;
+    pThis->cDepotContention = 0;
+    pThis->cMagRounds       = RTMEMCACHE_MAG_ROUNDS_INIT;
+
+    /* All caches share a single TLS entry, they are a limited resource.  If
+       we cannot get one, or the host has no TLS destructors, just do without
+       the magazines. */
+    if (fFlags & RTMEMCACHE_F_MAGAZINES)
+        pThis->fMagazines = RT_SUCCESS(RTOnce(&g_MemCacheTlsOnce, rtMemCacheTlsInitOnce, NULL));
 
     *phMemCache = pThis;
     return VINF_SUCCESS;
@@ -249,6 +400,42 @@ RTDECL(int) RTMemCacheDestroy(RTMEMCACHE hMemCache)
      * Destroy it.
      */
     AssertReturn(ASMAtomicCmpXchgU32(&pThis->u32Magic, RTMEMCACHE_MAGIC_DEAD, RTMEMCACHE_MAGIC), VERR_INVALID_HANDLE);
+
+    /*
+     * Drop the magazines.  The objects in them are still marked as allocated
+     * and constructed in the pages, so they're taken care of below.
+     */
+    if (pThis->fMagazines)
+    {
+        /* The thread states belong to their threads, which free them the next
+           time they look up a cache or when they terminate. */
+        RTCritSectEnter(&g_MemCacheThrdCritSect);
+        while (pThis->pThreadHead)
+        {
+            PRTMEMCACHETHRD pThrd = pThis->pThreadHead;
+            pThis->pThreadHead = pThrd->pNext;
+            RTMemFree(pThrd->pLoaded);
+            pThrd->pLoaded = NULL;
+            RTMemFree(pThrd->pPrevious);
+            pThrd->pPrevious = NULL;
+            ASMAtomicWriteNullPtr(&pThrd->pCache);
+        }
+        RTCritSectLeave(&g_MemCacheThrdCritSect);
+
+        while (pThis->pDepotFull)
+        {
+            PRTMEMCACHEMAG pMag = pThis->pDepotFull;
+            pThis->pDepotFull = pMag->pNext;
+            RTMemFree(pMag);
+        }
+        while (pThis->pDepotEmpty)
+        {
+            PRTMEMCACHEMAG pMag = pThis->pDepotEmpty;
+            pThis->pDepotEmpty = pMag->pNext;
+            RTMemFree(pMag);
+        }
+    }
+
     RTCritSectDelete(&pThis->CritSect);
 
     while (pThis->pPageHead)
@@ -360,12 +547,15 @@ DECL_FORCE_INLINE(int32_t) rtMemCacheGrabObj(PRTMEMCACHEPAGE pPage)
 }
 
 
-RTDECL(int) RTMemCacheAllocEx(RTMEMCACHE hMemCache, void **ppvObj)
+/**
+ * Allocates an object from the pages, bypassing the magazine layer.
+ *
+ * @returns IPRT status code.
+ * @param   pThis               The memory cache.
+ * @param   ppvObj              Where to return the object.
+ */
+static int rtMemCacheAllocInner(RTMEMCACHEINT *pThis, void **ppvObj)
 {
-    RTMEMCACHEINT *pThis = hMemCache;
-    AssertPtrReturn(pThis, VERR_INVALID_PARAMETER);
-    AssertReturn(pThis->u32Magic == RTMEMCACHE_MAGIC, VERR_INVALID_PARAMETER);
-
     /*
      * Try grab a free object from the stack.
      */
@@ -468,11 +658,11 @@ RTDECL(int) RTMemCacheAllocEx(RTMEMCACHE hMemCache, void **ppvObj)
     if (   pThis->pfnCtor
         && !ASMAtomicBitTestAndSet(pPage->pbmCtor, iObj))
     {
-        int rc = pThis->pfnCtor(hMemCache, pvObj, pThis->pvUser);
+        int rc = pThis->pfnCtor(pThis, pvObj, pThis->pvUser);
         if (RT_FAILURE(rc))
         {
             ASMAtomicBitClear(pPage->pbmCtor, iObj);
-            RTMemCacheFree(pThis, pvObj);
+            rtMemCacheFreeInner(pThis, pvObj);
             return rc;
         }
     }
@@ -482,6 +672,379 @@ RTDECL(int) RTMemCacheAllocEx(RTMEMCACHE hMemCache, void **ppvObj)
 }
 
 
+/**
+ * Allocates a magazine with the current default capacity.
+ *
+ * @returns Pointer to the empty magazine, NULL if out of memory.
+ * @param   cRoundsMax          The capacity.
+ */
+static PRTMEMCACHEMAG rtMemCacheMagAlloc(uint32_t cRoundsMax)
+{
+    PRTMEMCACHEMAG pMag = (PRTMEMCACHEMAG)RTMemAlloc(RT_UOFFSETOF(RTMEMCACHEMAG, apvRounds) + cRoundsMax * sizeof(void *));
+    if (pMag)
+    {
+        pMag->pNext      = NULL;
+        pMag->cRounds    = 0;
+        pMag->cRoundsMax = cRoundsMax;
+    }
+    return pMag;
+}
+
+
+/**
+ * Returns the objects in a magazine to the pages.
+ *
+ * @param   pThis               The memory cache.
+ * @param   pMag                The magazine.  Empty on return.
+ */
+static void rtMemCacheMagFlush(RTMEMCACHEINT *pThis, PRTMEMCACHEMAG pMag)
+{
+    while (pMag->cRounds > 0)
+        rtMemCacheFreeInner(pThis, pMag->apvRounds[--pMag->cRounds]);
+}
+
+
+/**
+ * Enters the depot lock, counting contention.
+ *
+ * @param   pThis               The memory cache.
+ */
+DECLINLINE(void) rtMemCacheDepotEnter(RTMEMCACHEINT *pThis)
+{
+    if (RT_FAILURE(RTCritSectTryEnter(&pThis->CritSect)))
+    {
+        ASMAtomicIncU32(&pThis->cDepotContention);
+        RTCritSectEnter(&pThis->CritSect);
+    }
+}
+
+
+/**
+ * Pushes a full magazine onto the depot.
+ *
+ * @param   pThis               The memory cache.
+ * @param   pMag                The full magazine.
+ */
+DECLINLINE(void) rtMemCacheDepotPushFull(RTMEMCACHEINT *pThis, PRTMEMCACHEMAG pMag)
+{
+    Assert(pMag->cRounds == pMag->cRoundsMax);
+    pMag->pNext = pThis->pDepotFull;
+    pThis->pDepotFull = pMag;
+    pThis->cDepotFull++;
+}
+
+
+/**
+ * Pushes an empty magazine onto the depot.
+ *
+ * @param   pThis               The memory cache.
+ * @param   pMag                The empty magazine.
+ */
+DECLINLINE(void) rtMemCacheDepotPushEmpty(RTMEMCACHEINT *pThis, PRTMEMCACHEMAG pMag)
+{
+    Assert(pMag->cRounds == 0);
+    pMag->pNext = pThis->pDepotEmpty;
+    pThis->pDepotEmpty = pMag;
+    pThis->cDepotEmpty++;
+}
+
+
+/**
+ * Updates the depot working set, releasing magazines that were not needed
+ * during the last interval and adjusting the magazine size.
+ *
+ * Called every RTMEMCACHE_DEPOT_REAP_INTERVAL depot operations.
+ *
+ * @param   pThis               The memory cache.  Caller owns the lock.
+ */
+static void rtMemCacheDepotReap(RTMEMCACHEINT *pThis)
+{
+    /*
+     * Threads waiting on the depot lock is an indicator that the magazines
+     * are too small, so make new ones bigger and drop the small empty ones.
+     */
+    uint32_t const cContention = ASMAtomicXchgU32(&pThis->cDepotContention, 0);
+    bool const     fGrow       = cContention > pThis->cDepotOps / 16
+                              && pThis->cMagRounds < RTMEMCACHE_MAG_ROUNDS_MAX;
+    if (fGrow)
+        pThis->cMagRounds *= 2;
+
+    /*
+     * Full magazines which have sat in the depot for the whole interval are
+     * surplus, return their objects to the pages.
+     */
+    uint32_t cFree = pThis->cDepotFullMin;
+    while (cFree-- > 0 && pThis->pDepotFull)
+    {
+        PRTMEMCACHEMAG pMag = pThis->pDepotFull;
+        pThis->pDepotFull = pMag->pNext;
+        pThis->cDepotFull--;
+        rtMemCacheMagFlush(pThis, pMag);
+        RTMemFree(pMag);
+    }
+
+    /*
+     * Same for the empty magazines.
+     */
+    cFree = fGrow ? pThis->cDepotEmpty : pThis->cDepotEmptyMin;
+    while (cFree-- > 0 && pThis->pDepotEmpty)
+    {
+        PRTMEMCACHEMAG pMag = pThis->pDepotEmpty;
+        pThis->pDepotEmpty = pMag->pNext;
+        pThis->cDepotEmpty--;
+        RTMemFree(pMag);
+    }
+
+    pThis->cDepotFullMin  = pThis->cDepotFull;
+    pThis->cDepotEmptyMin = pThis->cDepotEmpty;
+    pThis->cDepotOps      = 0;
+}
+
+
+/**
+ * Accounts for a depot operation.
+ *
+ * @param   pThis               The memory cache.  Caller owns the lock.
+ */
+DECLINLINE(void) rtMemCacheDepotOpDone(RTMEMCACHEINT *pThis)
+{
+    if (pThis->cDepotFull < pThis->cDepotFullMin)
+        pThis->cDepotFullMin = pThis->cDepotFull;
+    if (pThis->cDepotEmpty < pThis->cDepotEmptyMin)
+        pThis->cDepotEmptyMin = pThis->cDepotEmpty;
+    if (++pThis->cDepotOps >= RTMEMCACHE_DEPOT_REAP_INTERVAL)
+        rtMemCacheDepotReap(pThis);
+}
+
+
+/**
+ * Slow path of rtMemCacheThrdGet that searches the thread's list, moving the
+ * state to the front, or creates a new state.
+ *
+ * Thread states of destroyed caches are freed on the way.
+ *
+ * @returns Pointer to the thread state, NULL if out of memory.
+ * @param   pThis               The memory cache.
+ * @param   pHead               The head of the calling thread's list.
+ */
+static PRTMEMCACHETHRD rtMemCacheThrdGetSlow(RTMEMCACHEINT *pThis, PRTMEMCACHETHRD pHead)
+{
+    PRTMEMCACHETHRD  pFound = NULL;
+    PRTMEMCACHETHRD *ppCur  = &pHead;
+    PRTMEMCACHETHRD  pCur;
+    while ((pCur = *ppCur) != NULL)
+    {
+        PRTMEMCACHEINT const pCache = ASMAtomicReadPtrT(&pCur->pCache, PRTMEMCACHEINT);
+        if (pCache == pThis)
+        {
+            *ppCur = pCur->pNextInThread;
+            pFound = pCur;
+        }
+        else if (!pCache)
+        {
+            *ppCur = pCur->pNextInThread;
+            RTMemFree(pCur);
+        }
+        else
+            ppCur = &pCur->pNextInThread;
+    }
+
+    if (!pFound)
+    {
+        pFound = (PRTMEMCACHETHRD)RTMemAllocZ(sizeof(*pFound));
+        if (pFound)
+        {
+            uint32_t const cRoundsMax = ASMAtomicUoReadU32(&pThis->cMagRounds);
+            pFound->pLoaded   = rtMemCacheMagAlloc(cRoundsMax);
+            pFound->pPrevious = rtMemCacheMagAlloc(cRoundsMax);
+            if (pFound->pLoaded && pFound->pPrevious)
+            {
+                pFound->pCache = pThis;
+                RTCritSectEnter(&pThis->CritSect);
+                pFound->pNext = pThis->pThreadHead;
+                pThis->pThreadHead = pFound;
+                RTCritSectLeave(&pThis->CritSect);
+            }
+            else
+            {
+                RTMemFree(pFound->pLoaded);
+                RTMemFree(pFound->pPrevious);
+                RTMemFree(pFound);
+                pFound = NULL;
+            }
+        }
+    }
+
+    if (pFound)
+    {
+        pFound->pNextInThread = pHead;
+        pHead = pFound;
+    }
+    int rc = RTTlsSet(g_iMemCacheTls, pHead);
+    AssertRC(rc);
+    return pFound;
+}
+
+
+/**
+ * Gets the magazine state of the calling thread, creating it if necessary.
+ *
+ * @returns Pointer to the thread state, NULL if out of memory.
+ * @param   pThis               The memory cache.
+ */
+DECLINLINE(PRTMEMCACHETHRD) rtMemCacheThrdGet(RTMEMCACHEINT *pThis)
+{
+    PRTMEMCACHETHRD pHead = (PRTMEMCACHETHRD)RTTlsGet(g_iMemCacheTls);
+    if (RT_LIKELY(pHead && pHead->pCache == pThis))
+        return pHead;
+    return rtMemCacheThrdGetSlow(pThis, pHead);
+}
+
+
+/**
+ * TLS destructor that hands the magazines of a terminating thread to the
+ * depots of the caches and frees the thread states.
+ *
+ * @param   pvValue             The head of the thread state list.
+ */
+static DECLCALLBACK(void) rtMemCacheThrdDtor(void *pvValue)
+{
+    /* Keep the caches from being destroyed while we're at it. */
+    RTCritSectEnter(&g_MemCacheThrdCritSect);
+
+    PRTMEMCACHETHRD pThrd = (PRTMEMCACHETHRD)pvValue;
+    while (pThrd)
+    {
+        PRTMEMCACHETHRD const pNext = pThrd->pNextInThread;
+        RTMEMCACHEINT * const pThis = pThrd->pCache;
+        if (pThis)
+        {
+            RTCritSectEnter(&pThis->CritSect);
+
+            PRTMEMCACHEMAG apMags[2] = { pThrd->pLoaded, pThrd->pPrevious };
+            for (unsigned i = 0; i < RT_ELEMENTS(apMags); i++)
+            {
+                PRTMEMCACHEMAG pMag = apMags[i];
+                if (pMag->cRounds == pMag->cRoundsMax)
+                    rtMemCacheDepotPushFull(pThis, pMag);
+                else
+                {
+                    rtMemCacheMagFlush(pThis, pMag);
+                    rtMemCacheDepotPushEmpty(pThis, pMag);
+                }
+            }
+
+            PRTMEMCACHETHRD *ppCur = &pThis->pThreadHead;
+            while (*ppCur && *ppCur != pThrd)
+                ppCur = &(*ppCur)->pNext;
+            Assert(*ppCur == pThrd);
+            if (*ppCur)
+                *ppCur = pThrd->pNext;
+
+            RTCritSectLeave(&pThis->CritSect);
+        }
+        RTMemFree(pThrd);
+        pThrd = pNext;
+    }
+
+    RTCritSectLeave(&g_MemCacheThrdCritSect);
+}
+
+
+/**
+ * Returns the objects in the calling thread's magazines and in the depot to
+ * the pages, used when the cache has reached its max size.
+ *
+ * @param   pThis               The memory cache.
+ * @param   pThrd               The thread state of the calling thread.
+ */
+static void rtMemCacheReclaim(RTMEMCACHEINT *pThis, PRTMEMCACHETHRD pThrd)
+{
+    rtMemCacheMagFlush(pThis, pThrd->pLoaded);
+    rtMemCacheMagFlush(pThis, pThrd->pPrevious);
+
+    RTCritSectEnter(&pThis->CritSect);
+    while (pThis->pDepotFull)
+    {
+        PRTMEMCACHEMAG pMag = pThis->pDepotFull;
+        pThis->pDepotFull = pMag->pNext;
+        pThis->cDepotFull--;
+        rtMemCacheMagFlush(pThis, pMag);
+        rtMemCacheDepotPushEmpty(pThis, pMag);
+    }
+    pThis->cDepotFullMin = 0;
+    RTCritSectLeave(&pThis->CritSect);
+}
+
+
+RTDECL(int) RTMemCacheAllocEx(RTMEMCACHE hMemCache, void **ppvObj)
+{
+    RTMEMCACHEINT *pThis = hMemCache;
+    AssertPtrReturn(pThis, VERR_INVALID_PARAMETER);
+    AssertReturn(pThis->u32Magic == RTMEMCACHE_MAGIC, VERR_INVALID_PARAMETER);
+
+    if (!pThis->fMagazines)
+        return rtMemCacheAllocInner(pThis, ppvObj);
+
+    PRTMEMCACHETHRD pThrd = rtMemCacheThrdGet(pThis);
+    if (RT_UNLIKELY(!pThrd))
+        return rtMemCacheAllocInner(pThis, ppvObj);
+
+    /*
+     * Try the loaded magazine, then the previous one if it's full.
+     */
+    PRTMEMCACHEMAG pMag = pThrd->pLoaded;
+    if (RT_LIKELY(pMag->cRounds > 0))
+    {
+        *ppvObj = pMag->apvRounds[--pMag->cRounds];
+        return VINF_SUCCESS;
+    }
+
+    pMag = pThrd->pPrevious;
+    if (pMag->cRounds > 0)
+    {
+        pThrd->pPrevious = pThrd->pLoaded;
+        pThrd->pLoaded   = pMag;
+        *ppvObj = pMag->apvRounds[--pMag->cRounds];
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * Both are empty, exchange the previous one for a full one from the depot.
+     */
+    if (ASMAtomicUoReadPtrT(&pThis->pDepotFull, PRTMEMCACHEMAG))
+    {
+        rtMemCacheDepotEnter(pThis);
+        pMag = pThis->pDepotFull;
+        if (pMag)
+        {
+            pThis->pDepotFull = pMag->pNext;
+            pThis->cDepotFull--;
+            rtMemCacheDepotPushEmpty(pThis, pThrd->pPrevious);
+            rtMemCacheDepotOpDone(pThis);
+            RTCritSectLeave(&pThis->CritSect);
+
+            pThrd->pPrevious = pThrd->pLoaded;
+            pThrd->pLoaded   = pMag;
+            *ppvObj = pMag->apvRounds[--pMag->cRounds];
+            return VINF_SUCCESS;
+        }
+        RTCritSectLeave(&pThis->CritSect);
+    }
+
+    /*
+     * Nothing cached, get a new object from the pages.
+     */
+    int rc = rtMemCacheAllocInner(pThis, ppvObj);
+    if (rc == VERR_MEM_CACHE_MAX_SIZE)
+    {
+        rtMemCacheReclaim(pThis, pThrd);
+        rc = rtMemCacheAllocInner(pThis, ppvObj);
+    }
+    return rc;
+}
+
+
 RTDECL(void *) RTMemCacheAlloc(RTMEMCACHE hMemCache)
 {
     void *pvObj;
@@ -544,18 +1107,14 @@ static void rtMemCacheFreeList(RTMEMCACHEINT *pThis, PRTMEMCACHEFREEOBJ pHead)
 
 
 
-RTDECL(void) RTMemCacheFree(RTMEMCACHE hMemCache, void *pvObj)
+/**
+ * Frees an object to the pages, bypassing the magazine layer.
+ *
+ * @param   pThis               The memory cache.
+ * @param   pvObj               The memory object to free.
+ */
+static void rtMemCacheFreeInner(RTMEMCACHEINT *pThis, void *pvObj)
 {
-    if (!pvObj)
-        return;
-
-    RTMEMCACHEINT *pThis = hMemCache;
-    AssertPtrReturnVoid(pThis);
-    AssertReturnVoid(pThis->u32Magic == RTMEMCACHE_MAGIC);
-
-    AssertPtr(pvObj);
-    Assert(RT_ALIGN_P(pvObj, pThis->cbAlignment) == pvObj);
-
     if (!pThis->fUseFreeList)
         rtMemCacheFreeOne(pThis, pvObj);
     else
@@ -583,3 +1142,83 @@ RTDECL(void) RTMemCacheFree(RTMEMCACHE hMemCache, void *pvObj)
     }
 }
 
+
+RTDECL(void) RTMemCacheFree(RTMEMCACHE hMemCache, void *pvObj)
+{
+    if (!pvObj)
+        return;
+
+    RTMEMCACHEINT *pThis = hMemCache;
+    AssertPtrReturnVoid(pThis);
+    AssertReturnVoid(pThis->u32Magic == RTMEMCACHE_MAGIC);
+
+    AssertPtr(pvObj);
+    Assert(RT_ALIGN_P(pvObj, pThis->cbAlignment) == pvObj);
+
+    if (!pThis->fMagazines)
+    {
+        rtMemCacheFreeInner(pThis, pvObj);
+        return;
+    }
+
+    PRTMEMCACHETHRD pThrd = rtMemCacheThrdGet(pThis);
+    if (RT_UNLIKELY(!pThrd))
+    {
+        rtMemCacheFreeInner(pThis, pvObj);
+        return;
+    }
+#ifdef RT_STRICT
+    PRTMEMCACHEPAGE pPage = (PRTMEMCACHEPAGE)(((uintptr_t)pvObj) & ~(uintptr_t)PAGE_OFFSET_MASK);
+    Assert(pPage->pCache == pThis);
+#endif
+
+    /*
+     * Try the loaded magazine, then the previous one if it's empty.
+     */
+    PRTMEMCACHEMAG pMag = pThrd->pLoaded;
+    if (RT_LIKELY(pMag->cRounds < pMag->cRoundsMax))
+    {
+        pMag->apvRounds[pMag->cRounds++] = pvObj;
+        return;
+    }
+
+    pMag = pThrd->pPrevious;
+    if (pMag->cRounds == 0)
+    {
+        pThrd->pPrevious = pThrd->pLoaded;
+        pThrd->pLoaded   = pMag;
+        pMag->apvRounds[pMag->cRounds++] = pvObj;
+        return;
+    }
+
+    /*
+     * Both are full, exchange the previous one for an empty one from the depot.
+     */
+    rtMemCacheDepotEnter(pThis);
+    pMag = pThis->pDepotEmpty;
+    if (pMag)
+    {
+        pThis->pDepotEmpty = pMag->pNext;
+        pThis->cDepotEmpty--;
+    }
+    else
+    {
+        uint32_t const cRoundsMax = pThis->cMagRounds;
+        RTCritSectLeave(&pThis->CritSect);
+        pMag = rtMemCacheMagAlloc(cRoundsMax);
+        if (!pMag)
+        {
+            rtMemCacheFreeInner(pThis, pvObj);
+            return;
+        }
+        rtMemCacheDepotEnter(pThis);
+    }
+    rtMemCacheDepotPushFull(pThis, pThrd->pPrevious);
+    rtMemCacheDepotOpDone(pThis);
+    RTCritSectLeave(&pThis->CritSect);
+
+    pThrd->pPrevious = pThrd->pLoaded;
+    pThrd->pLoaded   = pMag;
+    pMag->apvRounds[pMag->cRounds++] = pvObj;
+}
+
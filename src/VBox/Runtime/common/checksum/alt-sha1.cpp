@@ -43,6 +43,7 @@
 #include <iprt/assert.h>
 #include <iprt/asm.h>
 #include <iprt/string.h>
+#include "internal/sha.h"
 
 
 /** Our private context structure. */
@@ -68,6 +69,14 @@ AssertCompile(RT_SIZEOFMEMB(RTSHA1CONTEXT, abPadding) >= RT_SIZEOFMEMB(RTSHA1CON
 AssertCompileMemberSize(RTSHA1ALTPRIVATECTX, auH, RTSHA1_HASH_SIZE);
 
 
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+#ifdef RTSHA_WITH_X86_SIMD
+/** The usable SIMD features (RTSHA_SIMD_F_XXX), zero until detected. */
+static uint32_t volatile g_fRtSha1Simd = 0;
+#endif
+
 
 
 RTDECL(void) RTSha1Init(PRTSHA1CONTEXT pCtx)
@@ -367,6 +376,257 @@ static void rtSha1BlockProcess(PRTSHA1CONTEXT pCtx)
 }
 
 
+#ifdef RTSHA_WITH_X86_SIMD
+
+/**
+ * Gets the usable SIMD features, detecting them on the first call.
+ *
+ * @returns RTSHA_SIMD_F_XXX.
+ */
+DECLINLINE(uint32_t) rtSha1SimdFeatures(void)
+{
+    uint32_t fFeatures = g_fRtSha1Simd;
+    if (RT_LIKELY(fFeatures))
+        return fFeatures;
+    fFeatures = rtShaSimdDetect();
+    ASMAtomicWriteU32(&g_fRtSha1Simd, fFeatures);
+    return fFeatures;
+}
+
+
+/**
+ * Processes a number of blocks using the SHA-NI instructions.
+ *
+ * @param   pauH                The hash values (host endian), updated.
+ * @param   pbBlocks            The blocks.  No alignment requirements.
+ * @param   cBlocks             The number of blocks.
+ */
+static RTSHA_TARGET_SHANI void rtSha1ShaNiBlocks(uint32_t *pauH, uint8_t const *pbBlocks, size_t cBlocks)
+{
+    __m128i const uBSwap = _mm_set_epi64x(UINT64_C(0x0001020304050607), UINT64_C(0x08090a0b0c0d0e0f));
+
+    __m128i uAbcd = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const *)&pauH[0]), 0x1b);
+    __m128i uE0   = _mm_set_epi32((int)pauH[4], 0, 0, 0);
+    __m128i uE1;
+    __m128i uMsg0;
+    __m128i uMsg1 = _mm_setzero_si128();
+    __m128i uMsg2 = _mm_setzero_si128();
+    __m128i uMsg3 = _mm_setzero_si128();
+
+    /* Four rounds, scheduling the message words for the following ones.  The
+       E values alternate between uE0 and uE1. */
+# define RTSHA1_SHANI_QUAD(a_iQuad, a_uECur, a_uENext, a_uMsgCur, a_uMsgNext, a_uMsgNext2, a_uMsgPrev) \
+        do { \
+            if ((a_iQuad) == 0) \
+                a_uECur = _mm_add_epi32(a_uECur, a_uMsgCur); \
+            else \
+                a_uECur = _mm_sha1nexte_epu32(a_uECur, a_uMsgCur); \
+            a_uENext = uAbcd; \
+            if ((a_iQuad) >= 3 && (a_iQuad) <= 18) \
+                a_uMsgNext = _mm_sha1msg2_epu32(a_uMsgNext, a_uMsgCur); \
+            uAbcd = _mm_sha1rnds4_epu32(uAbcd, a_uECur, (a_iQuad) / 5); \
+            if ((a_iQuad) >= 1 && (a_iQuad) <= 16) \
+                a_uMsgPrev = _mm_sha1msg1_epu32(a_uMsgPrev, a_uMsgCur); \
+            if ((a_iQuad) >= 2 && (a_iQuad) <= 17) \
+                a_uMsgNext2 = _mm_xor_si128(a_uMsgNext2, a_uMsgCur); \
+        } while (0)
+
+    while (cBlocks-- > 0)
+    {
+        __m128i const uAbcdSaved = uAbcd;
+        __m128i const uE0Saved   = uE0;
+
+        uMsg0 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[0]), uBSwap);
+        RTSHA1_SHANI_QUAD( 0, uE0, uE1, uMsg0, uMsg1, uMsg2, uMsg3);
+        uMsg1 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[16]), uBSwap);
+        RTSHA1_SHANI_QUAD( 1, uE1, uE0, uMsg1, uMsg2, uMsg3, uMsg0);
+        uMsg2 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[32]), uBSwap);
+        RTSHA1_SHANI_QUAD( 2, uE0, uE1, uMsg2, uMsg3, uMsg0, uMsg1);
+        uMsg3 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[48]), uBSwap);
+        RTSHA1_SHANI_QUAD( 3, uE1, uE0, uMsg3, uMsg0, uMsg1, uMsg2);
+        RTSHA1_SHANI_QUAD( 4, uE0, uE1, uMsg0, uMsg1, uMsg2, uMsg3);
+        RTSHA1_SHANI_QUAD( 5, uE1, uE0, uMsg1, uMsg2, uMsg3, uMsg0);
+        RTSHA1_SHANI_QUAD( 6, uE0, uE1, uMsg2, uMsg3, uMsg0, uMsg1);
+        RTSHA1_SHANI_QUAD( 7, uE1, uE0, uMsg3, uMsg0, uMsg1, uMsg2);
+        RTSHA1_SHANI_QUAD( 8, uE0, uE1, uMsg0, uMsg1, uMsg2, uMsg3);
+        RTSHA1_SHANI_QUAD( 9, uE1, uE0, uMsg1, uMsg2, uMsg3, uMsg0);
+        RTSHA1_SHANI_QUAD(10, uE0, uE1, uMsg2, uMsg3, uMsg0, uMsg1);
+        RTSHA1_SHANI_QUAD(11, uE1, uE0, uMsg3, uMsg0, uMsg1, uMsg2);
+        RTSHA1_SHANI_QUAD(12, uE0, uE1, uMsg0, uMsg1, uMsg2, uMsg3);
+        RTSHA1_SHANI_QUAD(13, uE1, uE0, uMsg1, uMsg2, uMsg3, uMsg0);
+        RTSHA1_SHANI_QUAD(14, uE0, uE1, uMsg2, uMsg3, uMsg0, uMsg1);
+        RTSHA1_SHANI_QUAD(15, uE1, uE0, uMsg3, uMsg0, uMsg1, uMsg2);
+        RTSHA1_SHANI_QUAD(16, uE0, uE1, uMsg0, uMsg1, uMsg2, uMsg3);
+        RTSHA1_SHANI_QUAD(17, uE1, uE0, uMsg1, uMsg2, uMsg3, uMsg0);
+        RTSHA1_SHANI_QUAD(18, uE0, uE1, uMsg2, uMsg3, uMsg0, uMsg1);
+        RTSHA1_SHANI_QUAD(19, uE1, uE0, uMsg3, uMsg0, uMsg1, uMsg2);
+
+        uE0   = _mm_sha1nexte_epu32(uE0, uE0Saved);
+        uAbcd = _mm_add_epi32(uAbcd, uAbcdSaved);
+        pbBlocks += RTSHA1_BLOCK_SIZE;
+    }
+# undef RTSHA1_SHANI_QUAD
+
+    _mm_storeu_si128((__m128i *)&pauH[0], _mm_shuffle_epi32(uAbcd, 0x1b));
+    pauH[4] = (uint32_t)_mm_extract_epi32(uE0, 3);
+}
+
+
+/**
+ * Processes a number of blocks of eight messages in parallel using AVX2.
+ *
+ * Each 32-bit element of the vectors holds the state of one message (lane).
+ *
+ * @param   pauH                The hash values of the lanes (host endian),
+ *                              indexed by word and then lane.  Updated.
+ * @param   papbLanes           The message data of each lane, no alignment
+ *                              requirements.
+ * @param   cBlocks             The number of blocks to process in each lane.
+ */
+static RTSHA_TARGET_AVX2 void rtSha1Avx2x8Blocks(uint32_t pauH[5][8], uint8_t const * const *papbLanes, size_t cBlocks)
+{
+# define RTSHA1_AVX2_ROL(a_u, a_cShift) \
+        _mm256_or_si256(_mm256_slli_epi32(a_u, a_cShift), _mm256_srli_epi32(a_u, 32 - (a_cShift)))
+
+    __m256i auState[5];
+    for (unsigned iWord = 0; iWord < 5; iWord++)
+        auState[iWord] = _mm256_loadu_si256((__m256i const *)&pauH[iWord][0]);
+
+    for (size_t iBlock = 0; iBlock < cBlocks; iBlock++)
+    {
+        __m256i auW[16];
+        rtShaAvx2x8LoadBlock(auW, papbLanes, iBlock * RTSHA1_BLOCK_SIZE);
+
+        /*
+         * The 80 rounds, the message schedule is kept in a 16 entry ring.
+         */
+        __m256i uA = auState[0];
+        __m256i uB = auState[1];
+        __m256i uC = auState[2];
+        __m256i uD = auState[3];
+        __m256i uE = auState[4];
+        for (unsigned iRound = 0; iRound < 80; iRound++)
+        {
+            if (iRound >= 16)
+            {
+                __m256i uW = _mm256_xor_si256(auW[(iRound - 3) & 15], auW[(iRound - 8) & 15]);
+                uW = _mm256_xor_si256(uW, auW[(iRound - 14) & 15]);
+                uW = _mm256_xor_si256(uW, auW[iRound & 15]);
+                auW[iRound & 15] = RTSHA1_AVX2_ROL(uW, 1);
+            }
+
+            __m256i  uF;
+            uint32_t uK;
+            if (iRound < 20)
+            {
+                uF = _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(uC, uD), uB), uD);
+                uK = UINT32_C(0x5a827999);
+            }
+            else if (iRound < 40)
+            {
+                uF = _mm256_xor_si256(_mm256_xor_si256(uB, uC), uD);
+                uK = UINT32_C(0x6ed9eba1);
+            }
+            else if (iRound < 60)
+            {
+                uF = _mm256_or_si256(_mm256_and_si256(uB, uC), _mm256_and_si256(_mm256_or_si256(uB, uC), uD));
+                uK = UINT32_C(0x8f1bbcdc);
+            }
+            else
+            {
+                uF = _mm256_xor_si256(_mm256_xor_si256(uB, uC), uD);
+                uK = UINT32_C(0xca62c1d6);
+            }
+
+            __m256i uTemp = _mm256_add_epi32(RTSHA1_AVX2_ROL(uA, 5), uF);
+            uTemp = _mm256_add_epi32(uTemp, uE);
+            uTemp = _mm256_add_epi32(uTemp, auW[iRound & 15]);
+            uTemp = _mm256_add_epi32(uTemp, _mm256_set1_epi32((int)uK));
+
+            uE = uD;
+            uD = uC;
+            uC = RTSHA1_AVX2_ROL(uB, 30);
+            uB = uA;
+            uA = uTemp;
+        }
+
+        auState[0] = _mm256_add_epi32(auState[0], uA);
+        auState[1] = _mm256_add_epi32(auState[1], uB);
+        auState[2] = _mm256_add_epi32(auState[2], uC);
+        auState[3] = _mm256_add_epi32(auState[3], uD);
+        auState[4] = _mm256_add_epi32(auState[4], uE);
+    }
+# undef RTSHA1_AVX2_ROL
+
+    for (unsigned iWord = 0; iWord < 5; iWord++)
+        _mm256_storeu_si256((__m256i *)&pauH[iWord][0], auState[iWord]);
+    _mm256_zeroupper();
+}
+
+
+/**
+ * RTSha1Multi worker using rtSha1Avx2x8Blocks.
+ */
+static void rtSha1MultiAvx2(size_t cBufs, const void * const *papvBufs, size_t cbBuf, uint8_t (*paHashes)[RTSHA1_HASH_SIZE])
+{
+    size_t const cFullBlocks = cbBuf / RTSHA1_BLOCK_SIZE;
+
+    for (size_t iFirst = 0; iFirst < cBufs; iFirst += 8)
+    {
+        /* Unused lanes just repeat the last buffer. */
+        size_t const   cLanes = RT_MIN(cBufs - iFirst, 8);
+        uint8_t const *apbLanes[8];
+        for (unsigned iLane = 0; iLane < 8; iLane++)
+            apbLanes[iLane] = (uint8_t const *)papvBufs[iFirst + RT_MIN(iLane, cLanes - 1)];
+
+        uint32_t auH[5][8];
+        for (unsigned iLane = 0; iLane < 8; iLane++)
+        {
+            auH[0][iLane] = UINT32_C(0x67452301);
+            auH[1][iLane] = UINT32_C(0xefcdab89);
+            auH[2][iLane] = UINT32_C(0x98badcfe);
+            auH[3][iLane] = UINT32_C(0x10325476);
+            auH[4][iLane] = UINT32_C(0xc3d2e1f0);
+        }
+        rtSha1Avx2x8Blocks(auH, apbLanes, cFullBlocks);
+
+        /* The tail, the padding and the length are the same size for all lanes. */
+        uint8_t        abTails[8][128];
+        uint8_t const *apbTails[8];
+        size_t const   cTailBlocks = rtShaX8BuildTails(abTails, apbTails, apbLanes, cbBuf);
+        rtSha1Avx2x8Blocks(auH, apbTails, cTailBlocks);
+
+        for (size_t iLane = 0; iLane < cLanes; iLane++)
+            for (unsigned iWord = 0; iWord < 5; iWord++)
+            {
+                uint32_t const uBe = RT_H2BE_U32(auH[iWord][iLane]);
+                memcpy(&paHashes[iFirst + iLane][iWord * 4], &uBe, 4);
+            }
+    }
+}
+
+#endif /* RTSHA_WITH_X86_SIMD */
+
+
+/**
+ * Processes the block buffered in the first 16 words of auW.
+ *
+ * @param   pCtx                The SHA1 context.
+ */
+DECLINLINE(void) rtSha1BlockProcessBuffered(PRTSHA1CONTEXT pCtx)
+{
+#ifdef RTSHA_WITH_X86_SIMD
+    if (rtSha1SimdFeatures() & RTSHA_SIMD_F_SHANI)
+    {
+        rtSha1ShaNiBlocks(&pCtx->AltPrivate.auH[0], (uint8_t const *)&pCtx->AltPrivate.auW[0], 1);
+        return;
+    }
+#endif
+    rtSha1BlockInitBuffered(pCtx);
+    rtSha1BlockProcess(pCtx);
+}
+
+
 RTDECL(void) RTSha1Update(PRTSHA1CONTEXT pCtx, const void *pvBuf, size_t cbBuf)
 {
     Assert(pCtx->AltPrivate.cbMessage < UINT64_MAX / 2);
@@ -386,8 +646,7 @@ RTDECL(void) RTSha1Update(PRTSHA1CONTEXT pCtx, const void *pvBuf, size_t cbBuf)
             pbBuf += cbMissing;
             cbBuf -= cbMissing;
 
-            rtSha1BlockInitBuffered(pCtx);
-            rtSha1BlockProcess(pCtx);
+            rtSha1BlockProcessBuffered(pCtx);
         }
         else
         {
@@ -397,6 +656,21 @@ RTDECL(void) RTSha1Update(PRTSHA1CONTEXT pCtx, const void *pvBuf, size_t cbBuf)
         }
     }
 
+#ifdef RTSHA_WITH_X86_SIMD
+    if (   cbBuf >= RTSHA1_BLOCK_SIZE
+        && (rtSha1SimdFeatures() & RTSHA_SIMD_F_SHANI))
+    {
+        /*
+         * Process all the full blocks in one go, alignment doesn't matter.
+         */
+        size_t const cbBlocks = cbBuf & ~(size_t)(RTSHA1_BLOCK_SIZE - 1U);
+        rtSha1ShaNiBlocks(&pCtx->AltPrivate.auH[0], pbBuf, cbBlocks / RTSHA1_BLOCK_SIZE);
+        pCtx->AltPrivate.cbMessage += cbBlocks;
+        pbBuf += cbBlocks;
+        cbBuf -= cbBlocks;
+    }
+    else
+#endif
     if (!((uintptr_t)pbBuf & 3))
     {
         /*
@@ -420,8 +694,7 @@ RTDECL(void) RTSha1Update(PRTSHA1CONTEXT pCtx, const void *pvBuf, size_t cbBuf)
         while (cbBuf >= RTSHA1_BLOCK_SIZE)
         {
             memcpy((uint8_t *)&pCtx->AltPrivate.auW[0], pbBuf, RTSHA1_BLOCK_SIZE);
-            rtSha1BlockInitBuffered(pCtx);
-            rtSha1BlockProcess(pCtx);
+            rtSha1BlockProcessBuffered(pCtx);
 
             pCtx->AltPrivate.cbMessage += RTSHA1_BLOCK_SIZE;
             pbBuf += RTSHA1_BLOCK_SIZE;
@@ -469,8 +742,7 @@ static void rtSha1FinalInternal(PRTSHA1CONTEXT pCtx)
     /*
      * Process the last buffered block constructed/completed above.
      */
-    rtSha1BlockInitBuffered(pCtx);
-    rtSha1BlockProcess(pCtx);
+    rtSha1BlockProcessBuffered(pCtx);
 
     /*
      * Convert the byte order of the hash words and we're done.
@@ -523,3 +795,21 @@ RTDECL(bool) RTSha1Check(const void *pvBuf, size_t cbBuf, uint8_t const pabHash[
 }
 RT_EXPORT_SYMBOL(RTSha1Check);
 
+
+RTDECL(void) RTSha1Multi(size_t cBufs, const void * const *papvBufs, size_t cbBuf, uint8_t (*paHashes)[RTSHA1_HASH_SIZE])
+{
+#ifdef RTSHA_WITH_X86_SIMD
+    /* SHA-NI on one message at a time beats AVX2 on eight. */
+    uint32_t const fFeatures = rtSha1SimdFeatures();
+    if (   (fFeatures & (RTSHA_SIMD_F_SHANI | RTSHA_SIMD_F_AVX2)) == RTSHA_SIMD_F_AVX2
+        && cBufs > 1)
+    {
+        rtSha1MultiAvx2(cBufs, papvBufs, cbBuf, paHashes);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < cBufs; i++)
+        RTSha1(papvBufs[i], cbBuf, paHashes[i]);
+}
+RT_EXPORT_SYMBOL(RTSha1Multi);
+
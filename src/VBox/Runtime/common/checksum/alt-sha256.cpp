@@ -43,6 +43,7 @@
 #include <iprt/assert.h>
 #include <iprt/asm.h>
 #include <iprt/string.h>
+#include "internal/sha.h"
 
 
 /** Our private context structure. */
@@ -70,7 +71,7 @@ AssertCompileMemberSize(RTSHA256ALTPRIVATECTX, auH, RTSHA256_HASH_SIZE);
 /*********************************************************************************************************************************
 *   Global Variables                                                                                                             *
 *********************************************************************************************************************************/
-#ifndef RTSHA256_UNROLLED
+#if !defined(RTSHA256_UNROLLED) || defined(RTSHA_WITH_X86_SIMD)
 /** The K constants */
 static uint32_t const g_auKs[] =
 {
@@ -91,7 +92,12 @@ static uint32_t const g_auKs[] =
     UINT32_C(0x748f82ee), UINT32_C(0x78a5636f), UINT32_C(0x84c87814), UINT32_C(0x8cc70208),
     UINT32_C(0x90befffa), UINT32_C(0xa4506ceb), UINT32_C(0xbef9a3f7), UINT32_C(0xc67178f2),
 };
-#endif /* !RTSHA256_UNROLLED */
+#endif /* !RTSHA256_UNROLLED || RTSHA_WITH_X86_SIMD */
+
+#ifdef RTSHA_WITH_X86_SIMD
+/** The usable SIMD features (RTSHA_SIMD_F_XXX), zero until detected. */
+static uint32_t volatile g_fRtSha256Simd = 0;
+#endif
 
 
 
@@ -458,6 +464,261 @@ static void rtSha256BlockProcess(PRTSHA256CONTEXT pCtx)
 }
 
 
+#ifdef RTSHA_WITH_X86_SIMD
+
+/**
+ * Gets the usable SIMD features, detecting them on the first call.
+ *
+ * @returns RTSHA_SIMD_F_XXX.
+ */
+DECLINLINE(uint32_t) rtSha256SimdFeatures(void)
+{
+    uint32_t fFeatures = g_fRtSha256Simd;
+    if (RT_LIKELY(fFeatures))
+        return fFeatures;
+    fFeatures = rtShaSimdDetect();
+    ASMAtomicWriteU32(&g_fRtSha256Simd, fFeatures);
+    return fFeatures;
+}
+
+
+/**
+ * Processes a number of blocks using the SHA-NI instructions.
+ *
+ * @param   pauH                The hash values (host endian), updated.
+ * @param   pbBlocks            The blocks.  No alignment requirements.
+ * @param   cBlocks             The number of blocks.
+ */
+static RTSHA_TARGET_SHANI void rtSha256ShaNiBlocks(uint32_t *pauH, uint8_t const *pbBlocks, size_t cBlocks)
+{
+    __m128i const uBSwap = _mm_set_epi64x(UINT64_C(0x0c0d0e0f08090a0b), UINT64_C(0x0405060700010203));
+
+    /* The instructions want the state as ABEF and CDGH. */
+    __m128i uTmp    = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const *)&pauH[0]), 0xb1);  /* CDAB */
+    __m128i uState1 = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const *)&pauH[4]), 0x1b);  /* EFGH */
+    __m128i uState0 = _mm_alignr_epi8(uTmp, uState1, 8);                                    /* ABEF */
+    uState1         = _mm_blend_epi16(uState1, uTmp, 0xf0);                                 /* CDGH */
+
+    __m128i uMsg;
+    __m128i uMsg0;
+    __m128i uMsg1 = _mm_setzero_si128();
+    __m128i uMsg2 = _mm_setzero_si128();
+    __m128i uMsg3 = _mm_setzero_si128();
+
+    /* Four rounds, scheduling the message words for the following ones. */
+# define RTSHA256_SHANI_QUAD(a_iQuad, a_uMsgCur, a_uMsgPrev, a_uMsgNext) \
+        do { \
+            uMsg    = _mm_add_epi32(a_uMsgCur, _mm_loadu_si128((__m128i const *)&g_auKs[(a_iQuad) * 4])); \
+            uState1 = _mm_sha256rnds2_epu32(uState1, uState0, uMsg); \
+            if ((a_iQuad) >= 3 && (a_iQuad) <= 14) \
+            { \
+                a_uMsgNext = _mm_add_epi32(a_uMsgNext, _mm_alignr_epi8(a_uMsgCur, a_uMsgPrev, 4)); \
+                a_uMsgNext = _mm_sha256msg2_epu32(a_uMsgNext, a_uMsgCur); \
+            } \
+            uMsg    = _mm_shuffle_epi32(uMsg, 0x0e); \
+            uState0 = _mm_sha256rnds2_epu32(uState0, uState1, uMsg); \
+            if ((a_iQuad) >= 1 && (a_iQuad) <= 12) \
+                a_uMsgPrev = _mm_sha256msg1_epu32(a_uMsgPrev, a_uMsgCur); \
+        } while (0)
+
+    while (cBlocks-- > 0)
+    {
+        __m128i const uState0Saved = uState0;
+        __m128i const uState1Saved = uState1;
+
+        uMsg0 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[0]), uBSwap);
+        RTSHA256_SHANI_QUAD( 0, uMsg0, uMsg3, uMsg1);
+        uMsg1 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[16]), uBSwap);
+        RTSHA256_SHANI_QUAD( 1, uMsg1, uMsg0, uMsg2);
+        uMsg2 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[32]), uBSwap);
+        RTSHA256_SHANI_QUAD( 2, uMsg2, uMsg1, uMsg3);
+        uMsg3 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)&pbBlocks[48]), uBSwap);
+        RTSHA256_SHANI_QUAD( 3, uMsg3, uMsg2, uMsg0);
+        RTSHA256_SHANI_QUAD( 4, uMsg0, uMsg3, uMsg1);
+        RTSHA256_SHANI_QUAD( 5, uMsg1, uMsg0, uMsg2);
+        RTSHA256_SHANI_QUAD( 6, uMsg2, uMsg1, uMsg3);
+        RTSHA256_SHANI_QUAD( 7, uMsg3, uMsg2, uMsg0);
+        RTSHA256_SHANI_QUAD( 8, uMsg0, uMsg3, uMsg1);
+        RTSHA256_SHANI_QUAD( 9, uMsg1, uMsg0, uMsg2);
+        RTSHA256_SHANI_QUAD(10, uMsg2, uMsg1, uMsg3);
+        RTSHA256_SHANI_QUAD(11, uMsg3, uMsg2, uMsg0);
+        RTSHA256_SHANI_QUAD(12, uMsg0, uMsg3, uMsg1);
+        RTSHA256_SHANI_QUAD(13, uMsg1, uMsg0, uMsg2);
+        RTSHA256_SHANI_QUAD(14, uMsg2, uMsg1, uMsg3);
+        RTSHA256_SHANI_QUAD(15, uMsg3, uMsg2, uMsg0);
+
+        uState0 = _mm_add_epi32(uState0, uState0Saved);
+        uState1 = _mm_add_epi32(uState1, uState1Saved);
+        pbBlocks += RTSHA256_BLOCK_SIZE;
+    }
+# undef RTSHA256_SHANI_QUAD
+
+    /* Back to ABCD and EFGH. */
+    uTmp    = _mm_shuffle_epi32(uState0, 0x1b);         /* FEBA */
+    uState1 = _mm_shuffle_epi32(uState1, 0xb1);         /* DCHG */
+    uState0 = _mm_blend_epi16(uTmp, uState1, 0xf0);     /* DCBA */
+    uState1 = _mm_alignr_epi8(uState1, uTmp, 8);        /* HGFE */
+    _mm_storeu_si128((__m128i *)&pauH[0], uState0);
+    _mm_storeu_si128((__m128i *)&pauH[4], uState1);
+}
+
+
+/**
+ * Processes a number of blocks of eight messages in parallel using AVX2.
+ *
+ * Each 32-bit element of the vectors holds the state of one message (lane).
+ *
+ * @param   pauH                The hash values of the lanes (host endian),
+ *                              indexed by word and then lane.  Updated.
+ * @param   papbLanes           The message data of each lane, no alignment
+ *                              requirements.
+ * @param   cBlocks             The number of blocks to process in each lane.
+ */
+static RTSHA_TARGET_AVX2 void rtSha256Avx2x8Blocks(uint32_t pauH[8][8], uint8_t const * const *papbLanes, size_t cBlocks)
+{
+# define RTSHA256_AVX2_ROR(a_u, a_cShift) \
+        _mm256_or_si256(_mm256_srli_epi32(a_u, a_cShift), _mm256_slli_epi32(a_u, 32 - (a_cShift)))
+
+    __m256i auState[8];
+    for (unsigned iWord = 0; iWord < 8; iWord++)
+        auState[iWord] = _mm256_loadu_si256((__m256i const *)&pauH[iWord][0]);
+
+    for (size_t iBlock = 0; iBlock < cBlocks; iBlock++)
+    {
+        __m256i auW[16];
+        rtShaAvx2x8LoadBlock(auW, papbLanes, iBlock * RTSHA256_BLOCK_SIZE);
+
+        /*
+         * The 64 rounds, the message schedule is kept in a 16 entry ring.
+         */
+        __m256i uA = auState[0];
+        __m256i uB = auState[1];
+        __m256i uC = auState[2];
+        __m256i uD = auState[3];
+        __m256i uE = auState[4];
+        __m256i uF = auState[5];
+        __m256i uG = auState[6];
+        __m256i uH = auState[7];
+        for (unsigned iRound = 0; iRound < 64; iRound++)
+        {
+            if (iRound >= 16)
+            {
+                __m256i const uW15 = auW[(iRound - 15) & 15];
+                __m256i const uW2  = auW[(iRound - 2) & 15];
+                __m256i uSigma0 = _mm256_xor_si256(RTSHA256_AVX2_ROR(uW15, 7), RTSHA256_AVX2_ROR(uW15, 18));
+                uSigma0         = _mm256_xor_si256(uSigma0, _mm256_srli_epi32(uW15, 3));
+                __m256i uSigma1 = _mm256_xor_si256(RTSHA256_AVX2_ROR(uW2, 17), RTSHA256_AVX2_ROR(uW2, 19));
+                uSigma1         = _mm256_xor_si256(uSigma1, _mm256_srli_epi32(uW2, 10));
+                auW[iRound & 15] = _mm256_add_epi32(_mm256_add_epi32(auW[iRound & 15], uSigma0),
+                                                    _mm256_add_epi32(auW[(iRound - 7) & 15], uSigma1));
+            }
+
+            __m256i uT1 = _mm256_xor_si256(RTSHA256_AVX2_ROR(uE, 6), RTSHA256_AVX2_ROR(uE, 11));
+            uT1 = _mm256_xor_si256(uT1, RTSHA256_AVX2_ROR(uE, 25));
+            uT1 = _mm256_add_epi32(uT1, uH);
+            uT1 = _mm256_add_epi32(uT1, _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(uF, uG), uE), uG));
+            uT1 = _mm256_add_epi32(uT1, _mm256_set1_epi32((int)g_auKs[iRound]));
+            uT1 = _mm256_add_epi32(uT1, auW[iRound & 15]);
+
+            __m256i uT2 = _mm256_xor_si256(RTSHA256_AVX2_ROR(uA, 2), RTSHA256_AVX2_ROR(uA, 13));
+            uT2 = _mm256_xor_si256(uT2, RTSHA256_AVX2_ROR(uA, 22));
+            uT2 = _mm256_add_epi32(uT2, _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(uB, uC), uA),
+                                                         _mm256_and_si256(uB, uC)));
+
+            uH = uG;
+            uG = uF;
+            uF = uE;
+            uE = _mm256_add_epi32(uD, uT1);
+            uD = uC;
+            uC = uB;
+            uB = uA;
+            uA = _mm256_add_epi32(uT1, uT2);
+        }
+
+        auState[0] = _mm256_add_epi32(auState[0], uA);
+        auState[1] = _mm256_add_epi32(auState[1], uB);
+        auState[2] = _mm256_add_epi32(auState[2], uC);
+        auState[3] = _mm256_add_epi32(auState[3], uD);
+        auState[4] = _mm256_add_epi32(auState[4], uE);
+        auState[5] = _mm256_add_epi32(auState[5], uF);
+        auState[6] = _mm256_add_epi32(auState[6], uG);
+        auState[7] = _mm256_add_epi32(auState[7], uH);
+    }
+# undef RTSHA256_AVX2_ROR
+
+    for (unsigned iWord = 0; iWord < 8; iWord++)
+        _mm256_storeu_si256((__m256i *)&pauH[iWord][0], auState[iWord]);
+    _mm256_zeroupper();
+}
+
+
+/**
+ * RTSha256Multi worker using rtSha256Avx2x8Blocks.
+ */
+static void rtSha256MultiAvx2(size_t cBufs, const void * const *papvBufs, size_t cbBuf,
+                              uint8_t (*paHashes)[RTSHA256_HASH_SIZE])
+{
+    size_t const cFullBlocks = cbBuf / RTSHA256_BLOCK_SIZE;
+
+    for (size_t iFirst = 0; iFirst < cBufs; iFirst += 8)
+    {
+        /* Unused lanes just repeat the last buffer. */
+        size_t const   cLanes = RT_MIN(cBufs - iFirst, 8);
+        uint8_t const *apbLanes[8];
+        for (unsigned iLane = 0; iLane < 8; iLane++)
+            apbLanes[iLane] = (uint8_t const *)papvBufs[iFirst + RT_MIN(iLane, cLanes - 1)];
+
+        uint32_t auH[8][8];
+        for (unsigned iLane = 0; iLane < 8; iLane++)
+        {
+            auH[0][iLane] = UINT32_C(0x6a09e667);
+            auH[1][iLane] = UINT32_C(0xbb67ae85);
+            auH[2][iLane] = UINT32_C(0x3c6ef372);
+            auH[3][iLane] = UINT32_C(0xa54ff53a);
+            auH[4][iLane] = UINT32_C(0x510e527f);
+            auH[5][iLane] = UINT32_C(0x9b05688c);
+            auH[6][iLane] = UINT32_C(0x1f83d9ab);
+            auH[7][iLane] = UINT32_C(0x5be0cd19);
+        }
+        rtSha256Avx2x8Blocks(auH, apbLanes, cFullBlocks);
+
+        /* The tail, the padding and the length are the same size for all lanes. */
+        uint8_t        abTails[8][128];
+        uint8_t const *apbTails[8];
+        size_t const   cTailBlocks = rtShaX8BuildTails(abTails, apbTails, apbLanes, cbBuf);
+        rtSha256Avx2x8Blocks(auH, apbTails, cTailBlocks);
+
+        for (size_t iLane = 0; iLane < cLanes; iLane++)
+            for (unsigned iWord = 0; iWord < 8; iWord++)
+            {
+                uint32_t const uBe = RT_H2BE_U32(auH[iWord][iLane]);
+                memcpy(&paHashes[iFirst + iLane][iWord * 4], &uBe, 4);
+            }
+    }
+}
+
+#endif /* RTSHA_WITH_X86_SIMD */
+
+
+/**
+ * Processes the block buffered in the first 16 words of auW.
+ *
+ * @param   pCtx                The SHA-256 context.
+ */
+DECLINLINE(void) rtSha256BlockProcessBuffered(PRTSHA256CONTEXT pCtx)
+{
+#ifdef RTSHA_WITH_X86_SIMD
+    if (rtSha256SimdFeatures() & RTSHA_SIMD_F_SHANI)
+    {
+        rtSha256ShaNiBlocks(&pCtx->AltPrivate.auH[0], (uint8_t const *)&pCtx->AltPrivate.auW[0], 1);
+        return;
+    }
+#endif
+    rtSha256BlockInitBuffered(pCtx);
+    rtSha256BlockProcess(pCtx);
+}
+
+
 RTDECL(void) RTSha256Update(PRTSHA256CONTEXT pCtx, const void *pvBuf, size_t cbBuf)
 {
     Assert(pCtx->AltPrivate.cbMessage < UINT64_MAX / 8);
@@ -477,8 +738,7 @@ RTDECL(void) RTSha256Update(PRTSHA256CONTEXT pCtx, const void *pvBuf, size_t cbB
             pbBuf += cbMissing;
             cbBuf -= cbMissing;
 
-            rtSha256BlockInitBuffered(pCtx);
-            rtSha256BlockProcess(pCtx);
+            rtSha256BlockProcessBuffered(pCtx);
         }
         else
         {
@@ -488,6 +748,21 @@ RTDECL(void) RTSha256Update(PRTSHA256CONTEXT pCtx, const void *pvBuf, size_t cbB
         }
     }
 
+#ifdef RTSHA_WITH_X86_SIMD
+    if (   cbBuf >= RTSHA256_BLOCK_SIZE
+        && (rtSha256SimdFeatures() & RTSHA_SIMD_F_SHANI))
+    {
+        /*
+         * Process all the full blocks in one go, alignment doesn't matter.
+         */
+        size_t const cbBlocks = cbBuf & ~(size_t)(RTSHA256_BLOCK_SIZE - 1U);
+        rtSha256ShaNiBlocks(&pCtx->AltPrivate.auH[0], pbBuf, cbBlocks / RTSHA256_BLOCK_SIZE);
+        pCtx->AltPrivate.cbMessage += cbBlocks;
+        pbBuf += cbBlocks;
+        cbBuf -= cbBlocks;
+    }
+    else
+#endif
     if (!((uintptr_t)pbBuf & (sizeof(void *) - 1)))
     {
         /*
@@ -511,8 +786,7 @@ RTDECL(void) RTSha256Update(PRTSHA256CONTEXT pCtx, const void *pvBuf, size_t cbB
         while (cbBuf >= RTSHA256_BLOCK_SIZE)
         {
             memcpy((uint8_t *)&pCtx->AltPrivate.auW[0], pbBuf, RTSHA256_BLOCK_SIZE);
-            rtSha256BlockInitBuffered(pCtx);
-            rtSha256BlockProcess(pCtx);
+            rtSha256BlockProcessBuffered(pCtx);
 
             pCtx->AltPrivate.cbMessage += RTSHA256_BLOCK_SIZE;
             pbBuf += RTSHA256_BLOCK_SIZE;
@@ -566,8 +840,7 @@ static void rtSha256FinalInternal(PRTSHA256CONTEXT pCtx)
     /*
      * Process the last buffered block constructed/completed above.
      */
-    rtSha256BlockInitBuffered(pCtx);
-    rtSha256BlockProcess(pCtx);
+    rtSha256BlockProcessBuffered(pCtx);
 
     /*
      * Convert the byte order of the hash words and we're done.
@@ -621,6 +894,24 @@ RTDECL(bool) RTSha256Check(const void *pvBuf, size_t cbBuf, uint8_t const pabHas
 RT_EXPORT_SYMBOL(RTSha256Check);
 
 
+RTDECL(void) RTSha256Multi(size_t cBufs, const void * const *papvBufs, size_t cbBuf, uint8_t (*paHashes)[RTSHA256_HASH_SIZE])
+{
+#ifdef RTSHA_WITH_X86_SIMD
+    /* SHA-NI on one message at a time beats AVX2 on eight. */
+    uint32_t const fFeatures = rtSha256SimdFeatures();
+    if (   (fFeatures & (RTSHA_SIMD_F_SHANI | RTSHA_SIMD_F_AVX2)) == RTSHA_SIMD_F_AVX2
+        && cBufs > 1)
+    {
+        rtSha256MultiAvx2(cBufs, papvBufs, cbBuf, paHashes);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < cBufs; i++)
+        RTSha256(papvBufs[i], cbBuf, paHashes[i]);
+}
+RT_EXPORT_SYMBOL(RTSha256Multi);
+
+
 
 /*
  * SHA-224 is just SHA-256 with different initial values an a truncated result.
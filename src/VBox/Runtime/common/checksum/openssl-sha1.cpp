@@ -66,6 +66,15 @@ RTDECL(bool) RTSha1Check(const void *pvBuf, size_t cbBuf, uint8_t const pabDiges
 RT_EXPORT_SYMBOL(RTSha1Check);
 
 
+RTDECL(void) RTSha1Multi(size_t cBufs, const void * const *papvBufs, size_t cbBuf, uint8_t (*paHashes)[RTSHA1_HASH_SIZE])
+{
+    /* OpenSSL has no multi-buffer interface, so just do one at a time. */
+    for (size_t i = 0; i < cBufs; i++)
+        RTSha1(papvBufs[i], cbBuf, paHashes[i]);
+}
+RT_EXPORT_SYMBOL(RTSha1Multi);
+
+
 RTDECL(void) RTSha1Init(PRTSHA1CONTEXT pCtx)
 {
     SHA1_Init(&pCtx->Private);
@@ -66,6 +66,15 @@ RTDECL(bool) RTSha256Check(const void *pvBuf, size_t cbBuf, uint8_t const pabDig
 RT_EXPORT_SYMBOL(RTSha256Check);
 
 
+RTDECL(void) RTSha256Multi(size_t cBufs, const void * const *papvBufs, size_t cbBuf, uint8_t (*paHashes)[RTSHA256_HASH_SIZE])
+{
+    /* OpenSSL has no multi-buffer interface, so just do one at a time. */
+    for (size_t i = 0; i < cBufs; i++)
+        RTSha256(papvBufs[i], cbBuf, paHashes[i]);
+}
+RT_EXPORT_SYMBOL(RTSha256Multi);
+
+
 RTDECL(void) RTSha256Init(PRTSHA256CONTEXT pCtx)
 {
     SHA256_Init(&pCtx->Private);
@@ -59,6 +59,8 @@
 #ifdef IN_RING3
 # include <iprt/alloca.h>
 # include <stdio.h>
+# include "internal/logbin.h"
+# include "internal/strhash.h"
 #endif
 
 
@@ -88,6 +90,25 @@ AssertCompile(sizeof(RTLOG_RINGBUF_EYE_CATCHER) == 16);
 #define RTLOG_RINGBUF_EYE_CATCHER_END    "\0\0\0END RING BUF"
 AssertCompile(sizeof(RTLOG_RINGBUF_EYE_CATCHER_END) == 16);
 
+#ifdef IN_RING3
+/** The size of the asynchronous file writing buffer (power of two). */
+# define RTLOG_ASYNC_BUF_SIZE               _1M
+AssertCompile(!(RTLOG_ASYNC_BUF_SIZE & (RTLOG_ASYNC_BUF_SIZE - 1)));
+/** How long a logging thread may wait for the asynchronous writer to make
+ * room before its output is dropped (milliseconds). */
+# define RTLOG_ASYNC_MAX_WAIT_MS            1000
+/** The size of the buffer RTLogLoggerExV formats messages into before taking
+ * the logger lock when asynchronous file writing is active.  Longer messages
+ * are formatted under the lock as usual. */
+# define RTLOG_ASYNC_PREFMT_SIZE            512
+/** The number of entries in the binary logging format string cache (power of
+ * two). */
+# define RTLOG_BIN_FMT_CACHE_SIZE           2048
+AssertCompile(!(RTLOG_BIN_FMT_CACHE_SIZE & (RTLOG_BIN_FMT_CACHE_SIZE - 1)));
+/** The max size of the group names in the binary log header record. */
+# define RTLOG_BIN_MAX_GROUP_NAMES          _8K
+#endif
+
 
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
@@ -105,6 +126,40 @@ typedef struct RTLOGOUTPUTPREFIXEDARGS
     unsigned                iGroup;
 } RTLOGOUTPUTPREFIXEDARGS, *PRTLOGOUTPUTPREFIXEDARGS;
 
+#ifdef IN_RING3
+/**
+ * A message formatted by RTLogLoggerExV before taking the logger lock.
+ */
+typedef struct RTLOGPREFMT
+{
+    /** The number of characters in achText. */
+    size_t                  cchText;
+    /** Set if the message didn't fit. */
+    bool                    fOverflow;
+    /** The formatted message. */
+    char                    achText[RTLOG_ASYNC_PREFMT_SIZE];
+} RTLOGPREFMT;
+/** Pointer to a pre-formatted message. */
+typedef RTLOGPREFMT *PRTLOGPREFMT;
+#endif
+
+#ifdef IN_RING3
+/**
+ * Binary logging format string cache entry.
+ */
+typedef struct RTLOGBINFMTCACHE
+{
+    /** The format string address. */
+    const char             *pszFormat;
+    /** The hash of the format string when it was recorded. */
+    uint32_t                uHash;
+    /** The length of the format string when it was recorded. */
+    uint32_t                cchFormat;
+} RTLOGBINFMTCACHE;
+/** Pointer to a binary logging format string cache entry. */
+typedef RTLOGBINFMTCACHE *PRTLOGBINFMTCACHE;
+#endif
+
 #ifndef IN_RC
 
 /**
@@ -199,11 +254,53 @@ typedef struct RTLOGGERINTERNAL
     /** Pointer to filename. */
     char                    szFilename[RTPATH_MAX];
     /** @} */
+
+    /** @name Asynchronous file writing (RTLOGFLAGS_ASYNC).
+     * When active, rtlogFlush() copies the file output into a single producer,
+     * single consumer ring buffer and a dedicated thread writes it to the file,
+     * so logging threads don't stall on disk I/O while owning hSpinMtx.  The
+     * producer side is always the owner of hSpinMtx.
+     * @{ */
+    /** The writer thread, NIL_RTTHREAD if asynchronous writing isn't active. */
+    RTTHREAD                hAsyncThread;
+    /** Event semaphore the writer thread waits on. */
+    RTSEMEVENT              hAsyncEvt;
+    /** Event semaphore the writer thread signals after writing something. */
+    RTSEMEVENT              hAsyncSpaceEvt;
+    /** The buffer (RTLOG_ASYNC_BUF_SIZE bytes). */
+    char                   *pchAsyncBuf;
+    /** Free running producer offset. */
+    uint64_t volatile       offAsyncWrite;
+    /** Free running consumer offset. */
+    uint64_t volatile       offAsyncRead;
+    /** Number of times a logging thread had to wait for buffer space. */
+    uint64_t volatile       cAsyncWaits;
+    /** Number of flushes dropped because the buffer stayed full. */
+    uint64_t volatile       cAsyncDropped;
+    /** Number of bytes dropped because the buffer stayed full. */
+    uint64_t volatile       cbAsyncDropped;
+    /** The cAsyncDropped value last reported in the log file (writer thread). */
+    uint64_t                cAsyncDroppedReported;
+    /** Set when the writer thread should terminate. */
+    bool volatile           fAsyncTerminate;
+    /** @} */
+
+    /** @name Binary logging (RTLOGFLAGS_BINARY).
+     * @{ */
+    /** Set when the binary log header has been written to the current file. */
+    bool                    fBinHdrWritten;
+    /** The cAsyncDropped value last seen by the binary logging code. */
+    uint64_t                cBinAsyncDroppedSeen;
+    /** The format strings recorded in the current file, indexed by a hash of
+     * the format string address (RTLOG_BIN_FMT_CACHE_SIZE entries).  Allocated
+     * on first use. */
+    PRTLOGBINFMTCACHE       paBinFmtCache;
+    /** @} */
 # endif /* IN_RING3 */
 } RTLOGGERINTERNAL;
 
 /** The revision of the internal logger structure. */
-# define RTLOGGERINTERNAL_REV    UINT32_C(10)
+# define RTLOGGERINTERNAL_REV    UINT32_C(12)
 
 # ifdef IN_RING3
 /** The size of the RTLOGGERINTERNAL structure in ring-0.  */
@@ -229,6 +326,10 @@ static void rtR0LogLoggerExFallback(uint32_t fDestFlags, uint32_t fFlags, PRTLOG
 #ifdef IN_RING3
 static int rtlogFileOpen(PRTLOGGER pLogger, char *pszErrorMsg, size_t cchErrorMsg);
 static void rtlogRotate(PRTLOGGER pLogger, uint32_t uTimeSlot, bool fFirst);
+static int rtlogAsyncStart(PRTLOGGER pLogger);
+static void rtlogAsyncStop(PRTLOGGER pLogger, bool fLocked);
+static void rtlogAsyncDrain(PRTLOGGER pLogger);
+static bool rtlogBinLoggerExVLocked(PRTLOGGER pLogger, unsigned fFlags, unsigned iGroup, const char *pszFormat, va_list args);
 #endif
 #ifndef IN_RC
 static void rtLogRingBufFlush(PRTLOGGER pLogger);
@@ -317,6 +418,8 @@ static struct
     { "writethru",    sizeof("writethru"   ) - 1,   RTLOGFLAGS_WRITE_THROUGH,       false },
     { "writethrough", sizeof("writethrough") - 1,   RTLOGFLAGS_WRITE_THROUGH,       false },
     { "flush",        sizeof("flush"       ) - 1,   RTLOGFLAGS_FLUSH,               false },
+    { "async",        sizeof("async"       ) - 1,   RTLOGFLAGS_ASYNC,               false },
+    { "binary",       sizeof("binary"      ) - 1,   RTLOGFLAGS_BINARY,              false },
     { "lockcnts",     sizeof("lockcnts"    ) - 1,   RTLOGFLAGS_PREFIX_LOCK_COUNTS,  false },
     { "cpuid",        sizeof("cpuid"       ) - 1,   RTLOGFLAGS_PREFIX_CPUID,        false },
     { "pid",          sizeof("pid"         ) - 1,   RTLOGFLAGS_PREFIX_PID,          false },
@@ -726,6 +829,7 @@ static void rtLogRingBufFlush(PRTLOGGER pLogger)
 # ifdef IN_RING3
     if (pLogger->fDestFlags & RTLOGDEST_FILE)
     {
+        rtlogAsyncDrain(pLogger);
         if (pLogger->pInt->hFile != NIL_RTFILE)
         {
             if (cchPreamble)
@@ -843,6 +947,10 @@ RTDECL(int) RTLogCreateExV(PRTLOGGER *ppLogger, uint32_t fFlags, const char *psz
 # ifdef IN_RING3
         pLogger->pInt->pfnPhase                 = pfnPhase;
         pLogger->pInt->hFile                    = NIL_RTFILE;
+        pLogger->pInt->hAsyncThread             = NIL_RTTHREAD;
+        pLogger->pInt->hAsyncEvt                = NIL_RTSEMEVENT;
+        pLogger->pInt->hAsyncSpaceEvt           = NIL_RTSEMEVENT;
+        pLogger->pInt->paBinFmtCache            = NULL;
         pLogger->pInt->cHistory                 = cHistory;
         if (cbHistoryFileMax == 0)
             pLogger->pInt->cbHistoryFileMax     = UINT64_MAX;
@@ -999,6 +1107,10 @@ RTDECL(int) RTLogCreateExV(PRTLOGGER *ppLogger, uint32_t fFlags, const char *psz
                     Assert(VALID_PTR(pLogger->pInt->pfnPhase) || pLogger->pInt->pfnPhase == NULL);
                     if (pLogger->pInt->pfnPhase)
                         pLogger->pInt->pfnPhase(pLogger, RTLOGPHASE_BEGIN, rtlogPhaseMsgNormal);
+
+                    /* Start the asynchronous file writer, falling back on synchronous writes on failure. */
+                    if (pLogger->fFlags & RTLOGFLAGS_ASYNC)
+                        rtlogAsyncStart(pLogger);
 # endif
                     pLogger->pInt->fCreated = true;
                     *ppLogger = pLogger;
@@ -1107,9 +1219,15 @@ RTDECL(int) RTLogDestroy(PRTLOGGER pLogger)
      * Add end of logging message.
      */
     if (   (pLogger->fDestFlags & RTLOGDEST_FILE)
-        && pLogger->pInt->hFile != NIL_RTFILE)
+        && pLogger->pInt->hFile != NIL_RTFILE
+        && pLogger->pInt->pfnPhase)
         pLogger->pInt->pfnPhase(pLogger, RTLOGPHASE_END, rtlogPhaseMsgLocked);
 
+    /*
+     * Stop the asynchronous writer, this writes out whatever is pending.
+     */
+    rtlogAsyncStop(pLogger, true /*fLocked*/);
+
     /*
      * Close output stuffs.
      */
@@ -1121,6 +1239,9 @@ RTDECL(int) RTLogDestroy(PRTLOGGER pLogger)
             rc = rc2;
         pLogger->pInt->hFile = NIL_RTFILE;
     }
+
+    RTMemFree(pLogger->pInt->paBinFmtCache);
+    pLogger->pInt->paBinFmtCache = NULL;
 # endif
 
     /*
@@ -2078,6 +2199,23 @@ RTDECL(int) RTLogFlags(PRTLOGGER pLogger, const char *pszValue)
             pszValue++;
     } /* while more environment variable value left */
 
+#ifdef IN_RING3
+    /*
+     * Start or stop the asynchronous file writer.  During creation this is
+     * taken care of by RTLogCreateExV.
+     */
+    if (   pLogger->pInt->fCreated
+        && pLogger->pInt->cbSelf == sizeof(RTLOGGERINTERNAL))
+    {
+        if (   (pLogger->fFlags & RTLOGFLAGS_ASYNC)
+            && pLogger->pInt->hAsyncThread == NIL_RTTHREAD)
+            rtlogAsyncStart(pLogger);
+        else if (   !(pLogger->fFlags & RTLOGFLAGS_ASYNC)
+                 && pLogger->pInt->hAsyncThread != NIL_RTTHREAD)
+            rtlogAsyncStop(pLogger, false /*fLocked*/);
+    }
+#endif
+
     return rc;
 }
 RT_EXPORT_SYMBOL(RTLogFlags);
@@ -2584,6 +2722,9 @@ RTDECL(void) RTLogFlush(PRTLOGGER pLogger)
     if (   pLogger->offScratch
 #ifndef IN_RC
         || (pLogger->fDestFlags & RTLOGDEST_RINGBUF)
+#endif
+#ifdef IN_RING3
+        || pLogger->pInt->hAsyncThread != NIL_RTTHREAD
 #endif
        )
     {
@@ -2609,6 +2750,13 @@ RTDECL(void) RTLogFlush(PRTLOGGER pLogger)
             && pLogger->pInt->pszRingBuf /* paranoia */)
             rtLogRingBufFlush(pLogger);
 
+# ifdef IN_RING3
+        /*
+         * Likewise, an explicit flush should put everything in the file.
+         */
+        rtlogAsyncDrain(pLogger);
+# endif
+
         /*
          * Release the semaphore.
          */
@@ -2853,6 +3001,30 @@ RTDECL(void) RTLogLoggerV(PRTLOGGER pLogger, const char *pszFormat, va_list args
 RT_EXPORT_SYMBOL(RTLogLoggerV);
 
 
+#ifdef IN_RING3
+/**
+ * Callback for RTLogFormatV which collects a message in a RTLOGPREFMT buffer.
+ * See PFNLOGOUTPUT() for details.
+ */
+static DECLCALLBACK(size_t) rtlogPreFmtOutput(void *pv, const char *pachChars, size_t cbChars)
+{
+    PRTLOGPREFMT pPreFmt = (PRTLOGPREFMT)pv;
+    if (cbChars)
+    {
+        if (   !pPreFmt->fOverflow
+            && cbChars <= sizeof(pPreFmt->achText) - pPreFmt->cchText)
+        {
+            memcpy(&pPreFmt->achText[pPreFmt->cchText], pachChars, cbChars);
+            pPreFmt->cchText += cbChars;
+        }
+        else
+            pPreFmt->fOverflow = true;
+    }
+    return cbChars;
+}
+#endif
+
+
 /**
  * Write to a logger instance.
  *
@@ -2900,6 +3072,27 @@ RTDECL(void) RTLogLoggerExV(PRTLOGGER pLogger, unsigned fFlags, unsigned iGroup,
         &&  (pLogger->afGroups[iGroup] & (fFlags | RTLOGGRPFLAGS_ENABLED)) != (fFlags | RTLOGGRPFLAGS_ENABLED))
         return;
 
+#ifdef IN_RING3
+    /*
+     * When writing the file asynchronously, expand the message before taking
+     * the lock so logging threads only contend for stamping the prefixes and
+     * queueing the text.  Only the binary format needs the raw arguments.
+     */
+    RTLOGPREFMT     PreFmt;
+    PRTLOGPREFMT    pPreFmt = NULL;
+    if ((pLogger->fFlags & (RTLOGFLAGS_ASYNC | RTLOGFLAGS_BINARY)) == RTLOGFLAGS_ASYNC)
+    {
+        PreFmt.cchText   = 0;
+        PreFmt.fOverflow = false;
+        va_list va;
+        va_copy(va, args);
+        RTLogFormatV(rtlogPreFmtOutput, &PreFmt, pszFormat, va);
+        va_end(va);
+        if (!PreFmt.fOverflow)
+            pPreFmt = &PreFmt;
+    }
+#endif
+
     /*
      * Acquire logger instance sem.
      */
@@ -2927,7 +3120,12 @@ RTDECL(void) RTLogLoggerExV(PRTLOGGER pLogger, unsigned fFlags, unsigned iGroup,
             pLogger->pInt->pacEntriesPerGroup[iGroup] = cEntries - 1;
         else
         {
-            rtlogLoggerExVLocked(pLogger, fFlags, iGroup, pszFormat, args);
+# ifdef IN_RING3
+            if (pPreFmt)
+                rtlogLoggerExFLocked(pLogger, fFlags, iGroup, "%.*s", (int)pPreFmt->cchText, pPreFmt->achText);
+            else
+# endif
+                rtlogLoggerExVLocked(pLogger, fFlags, iGroup, pszFormat, args);
             if (   pLogger->pInt->papszGroups
                 && pLogger->pInt->papszGroups[iGroup])
                 rtlogLoggerExFLocked(pLogger, fFlags, iGroup, "%u messages from group %s (#%u), muting it.\n",
@@ -2938,6 +3136,11 @@ RTDECL(void) RTLogLoggerExV(PRTLOGGER pLogger, unsigned fFlags, unsigned iGroup,
         }
     }
     else
+#endif
+#ifdef IN_RING3
+    if (pPreFmt)
+        rtlogLoggerExFLocked(pLogger, fFlags, iGroup, "%.*s", (int)pPreFmt->cchText, pPreFmt->achText);
+    else
 #endif
         rtlogLoggerExVLocked(pLogger, fFlags, iGroup, pszFormat, args);
 
@@ -3167,6 +3370,7 @@ static int rtlogFileOpen(PRTLOGGER pLogger, char *pszErrorMsg, size_t cchErrorMs
     }
     if (RT_SUCCESS(rc))
     {
+        pLogger->pInt->fBinHdrWritten = false;
         rc = RTFileGetSize(pLogger->pInt->hFile, &pLogger->pInt->cbHistoryFileWritten);
         if (RT_FAILURE(rc))
         {
@@ -3237,6 +3441,7 @@ static void rtlogRotate(PRTLOGGER pLogger, uint32_t uTimeSlot, bool fFirst)
             pLogger->pInt->pfnPhase(pLogger, RTLOGPHASE_PREROTATE, rtlogPhaseMsgLocked);
             pLogger->fDestFlags = fODestFlags;
         }
+        rtlogAsyncDrain(pLogger);
         RTFileClose(pLogger->pInt->hFile);
         pLogger->pInt->hFile = NIL_RTFILE;
     }
@@ -3308,6 +3513,465 @@ static void rtlogRotate(PRTLOGGER pLogger, uint32_t uTimeSlot, bool fFirst)
     pLogger->fFlags         = fSavedFlags;
 }
 
+
+/**
+ * The asynchronous file writer thread.
+ *
+ * @returns VINF_SUCCESS.
+ * @param   hThreadSelf The thread handle.
+ * @param   pvUser      The logger instance.
+ */
+static DECLCALLBACK(int) rtlogAsyncThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PRTLOGGER           pLogger = (PRTLOGGER)pvUser;
+    PRTLOGGERINTERNAL   pInt    = pLogger->pInt;
+    RT_NOREF(hThreadSelf);
+
+    for (;;)
+    {
+        uint64_t const offRead  = pInt->offAsyncRead;
+        uint64_t const offWrite = ASMAtomicReadU64(&pInt->offAsyncWrite);
+        if (offRead != offWrite)
+        {
+            uint32_t const off = (uint32_t)offRead & (RTLOG_ASYNC_BUF_SIZE - 1);
+            size_t   const cb  = (size_t)RT_MIN(offWrite - offRead, RTLOG_ASYNC_BUF_SIZE - off);
+
+            /* Note! All file access must be done before advancing offAsyncRead,
+                     as rtlogAsyncDrain() callers may close the file afterwards. */
+            RTFILE const hFile = pInt->hFile;
+            if (hFile != NIL_RTFILE)
+            {
+                uint64_t const cDropped = ASMAtomicReadU64(&pInt->cAsyncDropped);
+                if (cDropped != pInt->cAsyncDroppedReported)
+                {
+                    char   szMsg[128];
+                    size_t cchMsg = RTStrPrintf(szMsg, sizeof(szMsg),
+                                                "RTLog: Dropped %RU64 bytes of log output in %RU64 flushes (async buffer full)\n",
+                                                ASMAtomicReadU64(&pInt->cbAsyncDropped), cDropped);
+                    RTFileWrite(hFile, szMsg, cchMsg, NULL);
+                    pInt->cAsyncDroppedReported = cDropped;
+                }
+
+                RTFileWrite(hFile, &pInt->pchAsyncBuf[off], cb, NULL);
+                if (   offRead + cb == offWrite
+                    && (pLogger->fFlags & RTLOGFLAGS_FLUSH))
+                    RTFileFlush(hFile);
+            }
+
+            ASMAtomicWriteU64(&pInt->offAsyncRead, offRead + cb);
+            RTSemEventSignal(pInt->hAsyncSpaceEvt);
+        }
+        else if (ASMAtomicReadBool(&pInt->fAsyncTerminate))
+            break;
+        else
+            RTSemEventWait(pInt->hAsyncEvt, RT_INDEFINITE_WAIT);
+    }
+
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Starts asynchronous file writing.
+ *
+ * Must be called without owning the logger lock, as thread creation may end
+ * up logging.  Like the rest of the flag changing code, this isn't safe
+ * against concurrent callers.
+ *
+ * @returns IPRT status code.
+ * @param   pLogger     The logger instance.
+ */
+static int rtlogAsyncStart(PRTLOGGER pLogger)
+{
+    PRTLOGGERINTERNAL pInt = pLogger->pInt;
+    AssertReturn(pInt->hAsyncThread == NIL_RTTHREAD, VERR_WRONG_ORDER);
+
+    /*
+     * Set up the buffer and the writer thread.  Nothing is queued for it till
+     * hAsyncThread is set below.
+     */
+    pInt->pchAsyncBuf = (char *)RTMemAlloc(RTLOG_ASYNC_BUF_SIZE);
+    if (!pInt->pchAsyncBuf)
+        return VERR_NO_MEMORY;
+    pInt->offAsyncWrite         = 0;
+    pInt->offAsyncRead          = 0;
+    pInt->cAsyncDroppedReported = pInt->cAsyncDropped;
+    pInt->fAsyncTerminate       = false;
+
+    RTTHREAD hThread = NIL_RTTHREAD;
+    int rc = RTSemEventCreate(&pInt->hAsyncEvt);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTSemEventCreate(&pInt->hAsyncSpaceEvt);
+        if (RT_SUCCESS(rc))
+        {
+            rc = RTThreadCreate(&hThread, rtlogAsyncThread, pLogger, 0 /*cbStack*/, RTTHREADTYPE_IO,
+                                RTTHREADFLAGS_WAITABLE, "RTLogAsync");
+            if (RT_SUCCESS(rc))
+            {
+                /*
+                 * Write out what's buffered synchronously to keep the order and
+                 * then direct the file output to the writer thread.
+                 */
+                rc = rtlogLock(pLogger);
+                if (RT_SUCCESS(rc))
+                {
+                    rtlogFlush(pLogger);
+                    pInt->hAsyncThread = hThread;
+                    rtlogUnlock(pLogger);
+                    return VINF_SUCCESS;
+                }
+
+                ASMAtomicWriteBool(&pInt->fAsyncTerminate, true);
+                RTSemEventSignal(pInt->hAsyncEvt);
+                RTThreadWait(hThread, RT_INDEFINITE_WAIT, NULL);
+            }
+            RTSemEventDestroy(pInt->hAsyncSpaceEvt);
+            pInt->hAsyncSpaceEvt = NIL_RTSEMEVENT;
+        }
+        RTSemEventDestroy(pInt->hAsyncEvt);
+        pInt->hAsyncEvt = NIL_RTSEMEVENT;
+    }
+    RTMemFree(pInt->pchAsyncBuf);
+    pInt->pchAsyncBuf = NULL;
+    return rc;
+}
+
+
+/**
+ * Stops asynchronous file writing (if active), writing out pending output.
+ *
+ * The caller must own the logger lock when fLocked is set, which is only
+ * safe when logging is disabled as the writer thread may log on its way out.
+ *
+ * @param   pLogger     The logger instance.
+ * @param   fLocked     Whether the caller owns the logger lock.  If not, the
+ *                      lock is taken to detach the writer and released
+ *                      before waiting for it.
+ */
+static void rtlogAsyncStop(PRTLOGGER pLogger, bool fLocked)
+{
+    PRTLOGGERINTERNAL pInt = pLogger->pInt;
+    if (!fLocked && RT_FAILURE(rtlogLock(pLogger)))
+        return;
+
+    RTTHREAD const hThread = pInt->hAsyncThread;
+    if (hThread == NIL_RTTHREAD || hThread == RTThreadSelf())
+    {
+        if (!fLocked)
+            rtlogUnlock(pLogger);
+        return;
+    }
+
+    /* Detach it after writing out everything queued, so the file output
+       goes directly to the file from now on. */
+    rtlogAsyncDrain(pLogger);
+    pInt->hAsyncThread = NIL_RTTHREAD;
+    if (!fLocked)
+        rtlogUnlock(pLogger);
+
+    ASMAtomicWriteBool(&pInt->fAsyncTerminate, true);
+    RTSemEventSignal(pInt->hAsyncEvt);
+    int rc = RTThreadWait(hThread, RT_INDEFINITE_WAIT, NULL);
+    AssertRC(rc);
+
+    RTSemEventDestroy(pInt->hAsyncEvt);
+    pInt->hAsyncEvt = NIL_RTSEMEVENT;
+    RTSemEventDestroy(pInt->hAsyncSpaceEvt);
+    pInt->hAsyncSpaceEvt = NIL_RTSEMEVENT;
+    RTMemFree(pInt->pchAsyncBuf);
+    pInt->pchAsyncBuf = NULL;
+}
+
+
+/**
+ * Waits for the asynchronous writer to write out everything queued so far.
+ *
+ * The caller must own the logger lock.  This is a no-op if asynchronous
+ * writing isn't active.
+ *
+ * @param   pLogger     The logger instance.
+ */
+static void rtlogAsyncDrain(PRTLOGGER pLogger)
+{
+    PRTLOGGERINTERNAL pInt = pLogger->pInt;
+    if (   pInt->hAsyncThread == NIL_RTTHREAD
+        || pInt->hAsyncThread == RTThreadSelf())
+        return;
+
+    while (ASMAtomicReadU64(&pInt->offAsyncRead) != pInt->offAsyncWrite)
+    {
+        RTSemEventSignal(pInt->hAsyncEvt);
+        RTSemEventWait(pInt->hAsyncSpaceEvt, 10);
+    }
+}
+
+
+/**
+ * Queues log output for the asynchronous writer.
+ *
+ * If the buffer is full, the caller waits up to RTLOG_ASYNC_MAX_WAIT_MS for
+ * the writer thread to make room, after which the output is dropped and
+ * accounted for in the drop counters.
+ *
+ * The caller must own the logger lock.
+ *
+ * @param   pInt        The internal logger data.
+ * @param   pachText    The output to queue.
+ * @param   cchText     The number of bytes to queue.
+ */
+static void rtlogAsyncWrite(PRTLOGGERINTERNAL pInt, const char *pachText, size_t cchText)
+{
+    uint64_t const offWrite = pInt->offAsyncWrite;
+    uint64_t       cbUsed   = offWrite - ASMAtomicReadU64(&pInt->offAsyncRead);
+    Assert(cbUsed <= RTLOG_ASYNC_BUF_SIZE);
+    if (RT_UNLIKELY(RTLOG_ASYNC_BUF_SIZE - cbUsed < cchText))
+    {
+        /* Wait for the writer, unless it is the one logging. */
+        if (   cchText <= RTLOG_ASYNC_BUF_SIZE
+            && pInt->hAsyncThread != RTThreadSelf())
+        {
+            ASMAtomicIncU64(&pInt->cAsyncWaits);
+            uint64_t const msStart = RTTimeMilliTS();
+            do
+            {
+                RTSemEventSignal(pInt->hAsyncEvt);
+                RTSemEventWait(pInt->hAsyncSpaceEvt, 10);
+                cbUsed = offWrite - ASMAtomicReadU64(&pInt->offAsyncRead);
+            } while (   RTLOG_ASYNC_BUF_SIZE - cbUsed < cchText
+                     && RTTimeMilliTS() - msStart < RTLOG_ASYNC_MAX_WAIT_MS);
+        }
+        if (RTLOG_ASYNC_BUF_SIZE - cbUsed < cchText)
+        {
+            ASMAtomicIncU64(&pInt->cAsyncDropped);
+            ASMAtomicAddU64(&pInt->cbAsyncDropped, cchText);
+            return;
+        }
+    }
+
+    uint32_t const off     = (uint32_t)offWrite & (RTLOG_ASYNC_BUF_SIZE - 1);
+    size_t   const cbFirst = RT_MIN(cchText, RTLOG_ASYNC_BUF_SIZE - off);
+    memcpy(&pInt->pchAsyncBuf[off], pachText, cbFirst);
+    if (cbFirst < cchText)
+        memcpy(pInt->pchAsyncBuf, &pachText[cbFirst], cchText - cbFirst);
+    ASMAtomicWriteU64(&pInt->offAsyncWrite, offWrite + cchText);
+
+    /* The writer only needs waking up if it may have run out of work.  It
+       re-checks offAsyncWrite after advancing offAsyncRead before going to
+       sleep, so one of us is guaranteed to see the other's update. */
+    if (ASMAtomicReadU64(&pInt->offAsyncRead) == offWrite)
+        RTSemEventSignal(pInt->hAsyncEvt);
+}
+
+
+RTDECL(int) RTLogQueryAsyncStats(PRTLOGGER pLogger, PRTLOGASYNCSTATS pStats)
+{
+    AssertPtrReturn(pStats, VERR_INVALID_PARAMETER);
+    RT_ZERO(*pStats);
+
+    /*
+     * Resolve defaults.
+     */
+    if (!pLogger)
+    {
+        pLogger = RTLogDefaultInstance();
+        if (!pLogger)
+            return VINF_SUCCESS;
+    }
+    AssertReturn(pLogger->u32Magic == RTLOGGER_MAGIC, VERR_INVALID_MAGIC);
+    PRTLOGGERINTERNAL pInt = pLogger->pInt;
+
+    /*
+     * The counters are updated atomically, so no need to take the lock.
+     */
+    pStats->cWaits    = ASMAtomicReadU64(&pInt->cAsyncWaits);
+    pStats->cDropped  = ASMAtomicReadU64(&pInt->cAsyncDropped);
+    pStats->cbDropped = ASMAtomicReadU64(&pInt->cbAsyncDropped);
+    pStats->fActive   = pInt->hAsyncThread != NIL_RTTHREAD;
+    if (pStats->fActive)
+    {
+        uint64_t const offRead = ASMAtomicReadU64(&pInt->offAsyncRead);
+        pStats->cbQueued = ASMAtomicReadU64(&pInt->offAsyncWrite) - offRead;
+    }
+    return VINF_SUCCESS;
+}
+RT_EXPORT_SYMBOL(RTLogQueryAsyncStats);
+
+
+/**
+ * Calculates the size of the binary log header record.
+ *
+ * @returns Size in bytes.
+ * @param   pLogger     The logger instance.
+ * @param   pcGroups    Where to return the number of group names to include.
+ */
+static size_t rtlogBinHdrSize(PRTLOGGER pLogger, uint32_t *pcGroups)
+{
+    size_t             cbNames     = 0;
+    uint32_t const     cGroups     = pLogger->cGroups;
+    const char * const *papszGroups = pLogger->pInt->papszGroups;
+    for (uint32_t i = 0; i < cGroups; i++)
+        cbNames += (papszGroups && papszGroups[i] ? strlen(papszGroups[i]) : 0) + 1;
+    if (cbNames > RTLOG_BIN_MAX_GROUP_NAMES)
+    {
+        *pcGroups = 0;
+        return sizeof(RTLOGBINHDR);
+    }
+    *pcGroups = cGroups;
+    return sizeof(RTLOGBINHDR) + cbNames;
+}
+
+
+/**
+ * Records a message in binary form (RTLOGFLAGS_BINARY).
+ *
+ * This only works when the log file is the sole destination, as the other
+ * destinations wouldn't know what to do with the records.  It also fails for
+ * format strings with types that cannot be recorded without formatting them,
+ * see rtLogBinParseSpec().
+ *
+ * @returns true if recorded, false if the caller must format the message.
+ * @param   pLogger     The logger instance.  Caller owns the lock.
+ * @param   fFlags      The logging flags.
+ * @param   iGroup      The group.
+ * @param   pszFormat   Format string.
+ * @param   args        Format arguments.  Not consumed.
+ */
+static bool rtlogBinLoggerExVLocked(PRTLOGGER pLogger, unsigned fFlags, unsigned iGroup, const char *pszFormat, va_list args)
+{
+    PRTLOGGERINTERNAL pInt = pLogger->pInt;
+    if (   (pLogger->fDestFlags & ~RTLOGDEST_DUMMY) != RTLOGDEST_FILE
+        || pInt->cbSelf != sizeof(RTLOGGERINTERNAL))
+        return false;
+    if (RT_UNLIKELY(!pInt->paBinFmtCache))
+    {
+        pInt->paBinFmtCache = (PRTLOGBINFMTCACHE)RTMemAllocZ(sizeof(pInt->paBinFmtCache[0]) * RTLOG_BIN_FMT_CACHE_SIZE);
+        if (!pInt->paBinFmtCache)
+            return false;
+    }
+
+    /* Records dropped by the asynchronous writer may include the header or
+       format strings, so start over after a drop. */
+    if (RT_UNLIKELY(pInt->cBinAsyncDroppedSeen != ASMAtomicReadU64(&pInt->cAsyncDropped)))
+    {
+        pInt->cBinAsyncDroppedSeen = ASMAtomicReadU64(&pInt->cAsyncDropped);
+        pInt->fBinHdrWritten = false;
+    }
+
+    size_t         cchFormat;
+    uint32_t const uHash = sdbm(pszFormat, &cchFormat);
+    if (cchFormat >= _16K)
+        return false;
+
+    /*
+     * Make sure there is room for the worst case.  Flushing may rotate the
+     * log file, requiring a new header, so recheck after flushing.
+     */
+    uint32_t cGroups = 0;
+    size_t   cbHdr;
+    for (;;)
+    {
+        cbHdr = pInt->fBinHdrWritten ? 0 : rtlogBinHdrSize(pLogger, &cGroups);
+        size_t const cbNeeded = cbHdr + sizeof(RTLOGBINFMT) + cchFormat + 1 + sizeof(RTLOGBINMSG) + RTLOGBIN_MAX_ARGS;
+        if (pLogger->offScratch + cbNeeded < sizeof(pLogger->achScratch))
+            break;
+        if (!pLogger->offScratch)
+            return false;
+        rtlogFlush(pLogger);
+    }
+
+    /*
+     * The header record, first thing in each file.
+     */
+    if (cbHdr)
+    {
+        RTLOGBINHDR Hdr;
+        RT_ZERO(Hdr);
+        Hdr.Core.u32Magic   = RTLOGBINREC_MAGIC;
+        Hdr.Core.u16Type    = RTLOGBINREC_TYPE_HDR;
+        Hdr.Core.cbRec      = (uint32_t)cbHdr;
+        Hdr.u32Version      = RTLOGBINHDR_VERSION;
+        Hdr.cbPtr           = sizeof(void *);
+        Hdr.cbLong          = sizeof(long);
+# ifdef RT_BIG_ENDIAN
+        Hdr.fBigEndian      = true;
+# endif
+        Hdr.cGroups         = cGroups;
+        Hdr.uPid            = RTProcSelf();
+        RTTIMESPEC Now;
+        Hdr.nsStartUtc      = RTTimeSpecGetNano(RTTimeNow(&Now));
+        Hdr.nsStart         = RTTimeNanoTS();
+        Hdr.nsStartProg     = RTTimeProgramNanoTS();
+        char *pch = &pLogger->achScratch[pLogger->offScratch];
+        memcpy(pch, &Hdr, sizeof(Hdr));
+        pch += sizeof(Hdr);
+        for (uint32_t i = 0; i < cGroups; i++)
+        {
+            const char *pszGroup = pInt->papszGroups && pInt->papszGroups[i] ? pInt->papszGroups[i] : "";
+            size_t const cbGroup = strlen(pszGroup) + 1;
+            memcpy(pch, pszGroup, cbGroup);
+            pch += cbGroup;
+        }
+        Assert((size_t)(pch - &pLogger->achScratch[pLogger->offScratch]) == cbHdr);
+        pLogger->offScratch += (uint32_t)cbHdr;
+
+        pInt->fBinHdrWritten = true;
+        RT_BZERO(pInt->paBinFmtCache, sizeof(pInt->paBinFmtCache[0]) * RTLOG_BIN_FMT_CACHE_SIZE);
+    }
+
+    /*
+     * Define the format string unless already done.  We check the hash and
+     * length too in case someone is using a buffer as format string.
+     */
+    uintptr_t const   uFmt   = (uintptr_t)pszFormat;
+    PRTLOGBINFMTCACHE pEntry = &pInt->paBinFmtCache[(uFmt ^ (uFmt >> 12)) & (RTLOG_BIN_FMT_CACHE_SIZE - 1)];
+    if (   pEntry->pszFormat != pszFormat
+        || pEntry->uHash     != uHash
+        || pEntry->cchFormat != cchFormat)
+    {
+        RTLOGBINFMT Fmt;
+        RT_ZERO(Fmt);
+        Fmt.Core.u32Magic   = RTLOGBINREC_MAGIC;
+        Fmt.Core.u16Type    = RTLOGBINREC_TYPE_FMT;
+        Fmt.Core.cbRec      = (uint32_t)(sizeof(Fmt) + cchFormat + 1);
+        Fmt.uKey            = uFmt;
+        memcpy(&pLogger->achScratch[pLogger->offScratch], &Fmt, sizeof(Fmt));
+        memcpy(&pLogger->achScratch[pLogger->offScratch + sizeof(Fmt)], pszFormat, cchFormat + 1);
+        pLogger->offScratch += Fmt.Core.cbRec;
+
+        pEntry->pszFormat   = pszFormat;
+        pEntry->uHash       = uHash;
+        pEntry->cchFormat   = (uint32_t)cchFormat;
+    }
+
+    /*
+     * The message record.
+     */
+    size_t cbArgs = 0;
+    int rc = rtLogBinEncodeArgs(&pLogger->achScratch[pLogger->offScratch + sizeof(RTLOGBINMSG)], RTLOGBIN_MAX_ARGS,
+                                pszFormat, args, &cbArgs);
+    if (RT_FAILURE(rc))
+        return false;
+
+    RTLOGBINMSG Msg;
+    Msg.Core.u32Magic       = RTLOGBINREC_MAGIC;
+    Msg.Core.u16Type        = RTLOGBINREC_TYPE_MSG;
+    Msg.Core.u16Reserved    = 0;
+    Msg.Core.cbRec          = (uint32_t)(sizeof(Msg) + cbArgs);
+    Msg.iGroup              = iGroup;
+    Msg.uFmtKey             = uFmt;
+    Msg.nsTS                = RTTimeNanoTS();
+    Msg.idThread            = (uint64_t)RTThreadNativeSelf();
+    Msg.fFlags              = fFlags;
+    Msg.u32Reserved         = 0;
+    memcpy(&pLogger->achScratch[pLogger->offScratch], &Msg, sizeof(Msg));
+    pLogger->offScratch += Msg.Core.cbRec;
+
+    if (!(pLogger->fFlags & RTLOGFLAGS_BUFFERED))
+        rtlogFlush(pLogger);
+    return true;
+}
+
 #endif /* IN_RING3 */
 
 
@@ -3356,7 +4020,9 @@ static void rtlogFlush(PRTLOGGER pLogger)
 # ifdef IN_RING3
         if ((pLogger->fDestFlags & (RTLOGDEST_FILE | RTLOGDEST_RINGBUF)) == RTLOGDEST_FILE)
         {
-            if (pLogger->pInt->hFile != NIL_RTFILE)
+            if (pLogger->pInt->hAsyncThread != NIL_RTTHREAD)
+                rtlogAsyncWrite(pLogger->pInt, pLogger->achScratch, cchScratch);
+            else if (pLogger->pInt->hFile != NIL_RTFILE)
             {
                 RTFileWrite(pLogger->pInt->hFile, pLogger->achScratch, cchScratch, NULL);
                 if (pLogger->fFlags & RTLOGFLAGS_FLUSH)
@@ -3929,6 +4595,15 @@ static DECLCALLBACK(size_t) rtLogOutputPrefixed(void *pv, const char *pachChars,
  */
 static void rtlogLoggerExVLocked(PRTLOGGER pLogger, unsigned fFlags, unsigned iGroup, const char *pszFormat, va_list args)
 {
+#ifdef IN_RING3
+    /*
+     * Record it in binary form if requested and possible.
+     */
+    if (   (pLogger->fFlags & RTLOGFLAGS_BINARY)
+        && rtlogBinLoggerExVLocked(pLogger, fFlags, iGroup, pszFormat, args))
+        return;
+#endif
+
     /*
      * Format the message and perhaps flush it.
      */
@@ -0,0 +1,937 @@
+/* $Id$ */
+/** @file
+ * IPRT - Binary Logging, argument encoding and decoding.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/log.h>
+#include "internal/iprt.h"
+
+#include <iprt/assert.h>
+#include <iprt/avl.h>
+#include <iprt/ctype.h>
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/mem.h>
+#include <iprt/string.h>
+#include "internal/logbin.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The size of the file read buffer used by the decoder. */
+#define RTLOGBIN_DECODE_BUF_SIZE    _1M
+/** The max record size the decoder accepts. */
+#define RTLOGBIN_DECODE_MAX_REC     _512K
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * A format string known to the decoder.
+ */
+typedef struct RTLOGBINDECFMT
+{
+    /** The AVL node core, the key is the format string key. */
+    AVLRU64NODECORE     Core;
+    /** The format string. */
+    char                szFormat[1];
+} RTLOGBINDECFMT;
+/** Pointer to a format string known to the decoder. */
+typedef RTLOGBINDECFMT *PRTLOGBINDECFMT;
+
+/**
+ * The decoder state.
+ */
+typedef struct RTLOGBINDECODER
+{
+    /** RTLOGBINDECODE_F_XXX. */
+    uint32_t            fFlags;
+    /** Set if we've seen a header record. */
+    bool                fHaveHdr;
+    /** Set if the output is at the start of a line. */
+    bool                fAtLineStart;
+    /** The output callback. */
+    PFNRTSTROUTPUT      pfnOutput;
+    /** The output callback argument. */
+    void               *pvArgOutput;
+    /** The most recent header record. */
+    RTLOGBINHDR         Hdr;
+    /** The group names of the most recent header (pointers into
+     * pszGroupNames). */
+    const char        **papszGroups;
+    /** The group name strings. */
+    char               *pszGroupNames;
+    /** The format strings. */
+    AVLRU64TREE         FmtTree;
+    /** The message being decoded (for the prefix). */
+    RTLOGBINMSG const  *pMsg;
+} RTLOGBINDECODER;
+/** Pointer to the decoder state. */
+typedef RTLOGBINDECODER *PRTLOGBINDECODER;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/**
+ * The '%R' types taking integer arguments, sorted for binary search.
+ *
+ * This is the integer subset of the table in rtstrFormatRt(), the remaining
+ * types take pointers to data that may have changed by the time the message
+ * is formatted.
+ */
+static const struct
+{
+    uint8_t     cch;        /**< The length of the string. */
+    char        sz[7];      /**< The part following 'R'. */
+    uint8_t     cb;         /**< The size of the type. */
+} g_aRtIntTypes[] =
+{
+#define STRMEM(str) sizeof(str) - 1, str
+    { STRMEM("Ci"),      sizeof(RTINT)          },
+    { STRMEM("Cp"),      sizeof(RTCCPHYS)       },
+    { STRMEM("Cr"),      sizeof(RTCCUINTREG)    },
+    { STRMEM("Cu"),      sizeof(RTUINT)         },
+    { STRMEM("Cv"),      sizeof(void *)         },
+    { STRMEM("Cx"),      sizeof(RTUINT)         },
+    { STRMEM("Gi"),      sizeof(RTGCINT)        },
+    { STRMEM("Gp"),      sizeof(RTGCPHYS)       },
+    { STRMEM("Gr"),      sizeof(RTGCUINTREG)    },
+    { STRMEM("Gu"),      sizeof(RTGCUINT)       },
+    { STRMEM("Gv"),      sizeof(RTGCPTR)        },
+    { STRMEM("Gx"),      sizeof(RTGCUINT)       },
+    { STRMEM("Hi"),      sizeof(RTHCINT)        },
+    { STRMEM("Hp"),      sizeof(RTHCPHYS)       },
+    { STRMEM("Hr"),      sizeof(RTHCUINTREG)    },
+    { STRMEM("Hu"),      sizeof(RTHCUINT)       },
+    { STRMEM("Hv"),      sizeof(RTHCPTR)        },
+    { STRMEM("Hx"),      sizeof(RTHCUINT)       },
+    { STRMEM("I16"),     sizeof(int16_t)        },
+    { STRMEM("I32"),     sizeof(int32_t)        },
+    { STRMEM("I64"),     sizeof(int64_t)        },
+    { STRMEM("I8"),      sizeof(int8_t)         },
+    { STRMEM("Rv"),      sizeof(RTRCPTR)        },
+    { STRMEM("Tbool"),   sizeof(bool)           },
+    { STRMEM("Tfile"),   sizeof(RTFILE)         },
+    { STRMEM("Tfmode"),  sizeof(RTFMODE)        },
+    { STRMEM("Tfoff"),   sizeof(RTFOFF)         },
+    { STRMEM("Tgid"),    sizeof(RTGID)          },
+    { STRMEM("Tino"),    sizeof(RTINODE)        },
+    { STRMEM("Tint"),    sizeof(RTINT)          },
+    { STRMEM("Tiop"),    sizeof(RTIOPORT)       },
+    { STRMEM("Tldrm"),   sizeof(RTLDRMOD)       },
+    { STRMEM("Tnthrd"),  sizeof(RTNATIVETHREAD) },
+    { STRMEM("Tproc"),   sizeof(RTPROCESS)      },
+    { STRMEM("Tptr"),    sizeof(RTUINTPTR)      },
+    { STRMEM("Treg"),    sizeof(RTCCUINTREG)    },
+    { STRMEM("Tsel"),    sizeof(RTSEL)          },
+    { STRMEM("Tsem"),    sizeof(RTSEMEVENT)     },
+    { STRMEM("Tsock"),   sizeof(RTSOCKET)       },
+    { STRMEM("Tthrd"),   sizeof(RTTHREAD)       },
+    { STRMEM("Tuid"),    sizeof(RTUID)          },
+    { STRMEM("Tuint"),   sizeof(RTUINT)         },
+    { STRMEM("Tunicp"),  sizeof(RTUNICP)        },
+    { STRMEM("Tutf16"),  sizeof(RTUTF16)        },
+    { STRMEM("Txint"),   sizeof(RTUINT)         },
+    { STRMEM("U16"),     sizeof(uint16_t)       },
+    { STRMEM("U32"),     sizeof(uint32_t)       },
+    { STRMEM("U64"),     sizeof(uint64_t)       },
+    { STRMEM("U8"),      sizeof(uint8_t)        },
+    { STRMEM("X16"),     sizeof(uint16_t)       },
+    { STRMEM("X32"),     sizeof(uint32_t)       },
+    { STRMEM("X64"),     sizeof(uint64_t)       },
+    { STRMEM("X8"),      sizeof(uint8_t)        },
+#undef STRMEM
+};
+
+
+/**
+ * Looks up an integer '%R' type.
+ *
+ * @returns The size of the promoted argument (4 or 8), 0 if not an integer
+ *          type we know.
+ * @param   pszType     The type name following the 'R'.
+ * @param   pcchType    Where to return the length of the type name.
+ */
+static uint8_t rtLogBinLookupRtIntType(const char *pszType, size_t *pcchType)
+{
+    int iStart = 0;
+    int iEnd   = RT_ELEMENTS(g_aRtIntTypes) - 1;
+    while (iStart <= iEnd)
+    {
+        int i = iStart + (iEnd - iStart) / 2;
+        int iDiff = strncmp(pszType, g_aRtIntTypes[i].sz, g_aRtIntTypes[i].cch);
+        if (!iDiff)
+        {
+            *pcchType = g_aRtIntTypes[i].cch;
+            return g_aRtIntTypes[i].cb > sizeof(uint32_t) ? sizeof(uint64_t) : sizeof(uint32_t);
+        }
+        if (iDiff < 0)
+            iEnd = i - 1;
+        else
+            iStart = i + 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Parses a conversion specification the same way RTStrFormatV does.
+ *
+ * @returns Pointer to the character following the specification, NULL if it
+ *          is something we cannot record in binary form.
+ * @param   pszFormat   Pointer to the '%'.
+ * @param   pSpec       Where to return the parsed specification.
+ */
+DECLHIDDEN(const char *) rtLogBinParseSpec(const char *pszFormat, PRTLOGBINSPEC pSpec)
+{
+    Assert(*pszFormat == '%');
+    pszFormat++;
+
+    pSpec->pchFlags      = pszFormat;
+    pSpec->cchFlags      = 0;
+    pSpec->cbValue       = 0;
+    pSpec->fWidthArg     = false;
+    pSpec->fPrecisionArg = false;
+    pSpec->fPrecision    = false;
+    pSpec->cchWidth      = -1;
+    pSpec->cchPrecision  = -1;
+    if (*pszFormat == '%')
+    {
+        pSpec->enmKind = RTLOGBINSPEC_KIND_PERCENT;
+        pSpec->pchConv = pszFormat;
+        pSpec->cchConv = 1;
+        return pszFormat + 1;
+    }
+
+    /* flags */
+    while (   *pszFormat == '#' || *pszFormat == '-' || *pszFormat == '+'
+           || *pszFormat == ' ' || *pszFormat == '0' || *pszFormat == '\'')
+        pszFormat++;
+    if (pszFormat - pSpec->pchFlags > 16)
+        return NULL;
+    pSpec->cchFlags = (uint8_t)(pszFormat - pSpec->pchFlags);
+
+    /* width */
+    if (RT_C_IS_DIGIT(*pszFormat))
+    {
+        int32_t cchWidth = 0;
+        while (RT_C_IS_DIGIT(*pszFormat) && cchWidth < _64K)
+            cchWidth = cchWidth * 10 + *pszFormat++ - '0';
+        pSpec->cchWidth = cchWidth;
+    }
+    else if (*pszFormat == '*')
+    {
+        pSpec->fWidthArg = true;
+        pszFormat++;
+    }
+
+    /* precision */
+    if (*pszFormat == '.')
+    {
+        pszFormat++;
+        pSpec->fPrecision = true;
+        if (RT_C_IS_DIGIT(*pszFormat))
+        {
+            int32_t cchPrecision = 0;
+            while (RT_C_IS_DIGIT(*pszFormat) && cchPrecision < _64K)
+                cchPrecision = cchPrecision * 10 + *pszFormat++ - '0';
+            pSpec->cchPrecision = cchPrecision;
+        }
+        else if (*pszFormat == '*')
+        {
+            pSpec->fPrecisionArg = true;
+            pszFormat++;
+        }
+        else
+            pSpec->cchPrecision = 0;
+    }
+    if (RT_C_IS_DIGIT(*pszFormat))
+        return NULL;
+
+    /* argument size */
+    pSpec->pchConv = pszFormat;
+    char chArgSize = *pszFormat;
+    switch (chArgSize)
+    {
+        default:
+            chArgSize = 0;
+            break;
+
+        case 'z':
+        case 'L':
+        case 'j':
+        case 't':
+            pszFormat++;
+            break;
+
+        case 'l':
+            pszFormat++;
+            if (*pszFormat == 'l')
+            {
+                chArgSize = 'L';
+                pszFormat++;
+            }
+            break;
+
+        case 'h':
+            pszFormat++;
+            if (*pszFormat == 'h')
+            {
+                chArgSize = 'H';
+                pszFormat++;
+            }
+            break;
+
+        case 'I':
+            if (pszFormat[1] == '6' && pszFormat[2] == '4')
+            {
+                pszFormat += 3;
+                chArgSize = 'L';
+            }
+            else if (pszFormat[1] == '3' && pszFormat[2] == '2')
+            {
+                pszFormat += 3;
+                chArgSize = 0;
+            }
+            else
+            {
+                pszFormat += 1;
+                chArgSize = 'j';
+            }
+            break;
+
+        case 'q':
+            pszFormat++;
+            chArgSize = 'L';
+            break;
+    }
+
+    /* type */
+    switch (*pszFormat++)
+    {
+        case 'c':
+            pSpec->enmKind = RTLOGBINSPEC_KIND_INT;
+            pSpec->cbValue = sizeof(int);
+            break;
+
+        case 'S':
+        case 's':
+            if (chArgSize)
+                return NULL; /* UTF-16 and code point strings are rare, format them as text. */
+            pSpec->enmKind = RTLOGBINSPEC_KIND_STR;
+            break;
+
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            pSpec->enmKind = RTLOGBINSPEC_KIND_INT;
+            switch (chArgSize)
+            {
+                case 'L':
+                case 'j':   pSpec->cbValue = sizeof(uint64_t); break;
+                case 'l':   pSpec->cbValue = sizeof(unsigned long); break;
+                case 'z':   pSpec->cbValue = sizeof(size_t); break;
+                case 't':   pSpec->cbValue = sizeof(ptrdiff_t); break;
+                default:    pSpec->cbValue = sizeof(unsigned int); break;
+            }
+            break;
+
+        case 'p':
+            pSpec->enmKind = RTLOGBINSPEC_KIND_INT;
+            pSpec->cbValue = sizeof(uintptr_t);
+            break;
+
+        case 'R':
+        {
+            if (chArgSize)
+                return NULL;
+            pSpec->enmKind = RTLOGBINSPEC_KIND_INT;
+            if (*pszFormat == 'r')
+            {
+                /* %Rrc, %Rrs, %Rrf and %Rra take an int status code. */
+                if (   pszFormat[1] != 'c' && pszFormat[1] != 's'
+                    && pszFormat[1] != 'f' && pszFormat[1] != 'a')
+                    return NULL;
+                pszFormat += 2;
+                pSpec->cbValue = sizeof(int);
+            }
+            else
+            {
+                size_t cchType;
+                pSpec->cbValue = rtLogBinLookupRtIntType(pszFormat, &cchType);
+                if (!pSpec->cbValue)
+                    return NULL;
+                pszFormat += cchType;
+            }
+            break;
+        }
+
+        /* %M and %N, custom types, floating point and unknown stuff. */
+        default:
+            return NULL;
+    }
+
+    AssertCompile(sizeof(unsigned long) == 4 || sizeof(unsigned long) == 8);
+    AssertCompile(sizeof(size_t) == 4 || sizeof(size_t) == 8);
+    if (pszFormat - pSpec->pchConv > 16)
+        return NULL;
+    pSpec->cchConv = (uint8_t)(pszFormat - pSpec->pchConv);
+    return pszFormat;
+}
+
+
+/**
+ * Encodes the arguments of a log message (see @ref pg_rt_log_bin).
+ *
+ * @returns IPRT status code.
+ * @retval  VERR_NOT_SUPPORTED if the format string contains something that
+ *          cannot be recorded in binary form.
+ * @retval  VERR_BUFFER_OVERFLOW if the arguments don't fit.
+ * @param   pvDst       Where to store the arguments.
+ * @param   cbDst       The size of the destination buffer.
+ * @param   pszFormat   The format string.
+ * @param   va          The arguments.  A copy is made, so the caller can still
+ *                      use them on failure.
+ * @param   pcbUsed     Where to return the number of bytes used on success.
+ */
+DECLHIDDEN(int) rtLogBinEncodeArgs(void *pvDst, size_t cbDst, const char *pszFormat, va_list va, size_t *pcbUsed)
+{
+    uint8_t *pbDst = (uint8_t *)pvDst;
+    size_t   off   = 0;
+    int      rc    = VINF_SUCCESS;
+    va_list  args;
+    va_copy(args, va);
+
+#define RTLOGBIN_PUT(a_Value) \
+        do { \
+            if (cbDst - off < sizeof(a_Value)) \
+            { \
+                rc = VERR_BUFFER_OVERFLOW; \
+                break; \
+            } \
+            memcpy(&pbDst[off], &(a_Value), sizeof(a_Value)); \
+            off += sizeof(a_Value); \
+        } while (0)
+
+    const char *pch;
+    while (   RT_SUCCESS(rc)
+           && (pch = strchr(pszFormat, '%')) != NULL)
+    {
+        RTLOGBINSPEC Spec;
+        pszFormat = rtLogBinParseSpec(pch, &Spec);
+        if (!pszFormat)
+        {
+            rc = VERR_NOT_SUPPORTED;
+            break;
+        }
+        if (Spec.enmKind == RTLOGBINSPEC_KIND_PERCENT)
+            continue;
+
+        if (Spec.fWidthArg)
+        {
+            int32_t cchWidth = va_arg(args, int);
+            RTLOGBIN_PUT(cchWidth);
+        }
+        if (Spec.fPrecisionArg)
+        {
+            int32_t cchPrecision = va_arg(args, int);
+            RTLOGBIN_PUT(cchPrecision);
+            Spec.cchPrecision = RT_MAX(cchPrecision, 0);
+        }
+        if (RT_FAILURE(rc))
+            break;
+
+        if (Spec.enmKind == RTLOGBINSPEC_KIND_INT)
+        {
+            if (Spec.cbValue == sizeof(uint64_t))
+            {
+                uint64_t u64 = va_arg(args, uint64_t);
+                RTLOGBIN_PUT(u64);
+            }
+            else
+            {
+                uint32_t u32 = va_arg(args, uint32_t);
+                RTLOGBIN_PUT(u32);
+            }
+        }
+        else
+        {
+            Assert(Spec.enmKind == RTLOGBINSPEC_KIND_STR);
+            const char *pszStr = va_arg(args, const char *);
+            if (!VALID_PTR(pszStr))
+                pszStr = "<NULL>";
+            if (cbDst - off <= sizeof(uint16_t))
+            {
+                rc = VERR_BUFFER_OVERFLOW;
+                break;
+            }
+            size_t const cchLimit = RT_MIN(cbDst - off - sizeof(uint16_t), UINT16_MAX);
+            size_t const cchMax   = Spec.fPrecision ? (size_t)Spec.cchPrecision : ~(size_t)0;
+            size_t const cchStr   = RTStrNLen(pszStr, RT_MIN(cchMax, cchLimit + 1));
+            if (cchStr > cchLimit)
+            {
+                rc = VERR_BUFFER_OVERFLOW;
+                break;
+            }
+            uint16_t const cchStored = (uint16_t)cchStr;
+            RTLOGBIN_PUT(cchStored);
+            memcpy(&pbDst[off], pszStr, cchStr);
+            off += cchStr;
+        }
+    }
+#undef RTLOGBIN_PUT
+
+    va_end(args);
+    *pcbUsed = off;
+    return rc;
+}
+
+
+/**
+ * Output callback which prefixes lines of decoded messages.
+ */
+static DECLCALLBACK(size_t) rtLogBinDecodeOutput(void *pvArg, const char *pachChars, size_t cbChars)
+{
+    PRTLOGBINDECODER pThis = (PRTLOGBINDECODER)pvArg;
+    size_t const     cbRet = cbChars;
+    while (cbChars > 0)
+    {
+        if (pThis->fAtLineStart)
+        {
+            pThis->fAtLineStart = false;
+            if (!(pThis->fFlags & RTLOGBINDECODE_F_NO_PREFIX) && pThis->pMsg)
+            {
+                /* The time is in the RTLOGFLAGS_PREFIX_TIME_PROG style. */
+                RTLOGBINMSG const *pMsg = pThis->pMsg;
+                uint64_t const     cUs  = (pThis->Hdr.nsStartProg + (pMsg->nsTS - pThis->Hdr.nsStart)) / RT_NS_1US;
+                uint32_t const     cUsInHour = (uint32_t)(cUs % RT_US_1HOUR);
+                char               szGroup[16];
+                const char        *pszGroup = szGroup;
+                if (pMsg->iGroup == UINT32_MAX)
+                    pszGroup = "--";
+                else if (pMsg->iGroup < pThis->Hdr.cGroups && pThis->papszGroups[pMsg->iGroup][0])
+                    pszGroup = pThis->papszGroups[pMsg->iGroup];
+                else
+                    RTStrPrintf(szGroup, sizeof(szGroup), "#%u", pMsg->iGroup);
+
+                char   szPrefix[128];
+                size_t cchPrefix = RTStrPrintf(szPrefix, sizeof(szPrefix), "%02u:%02u:%02u.%06u %0*RX64 %-8s ",
+                                               (uint32_t)(cUs / RT_US_1HOUR), cUsInHour / RT_US_1MIN,
+                                               cUsInHour % RT_US_1MIN / RT_US_1SEC, cUsInHour % RT_US_1SEC,
+                                               pThis->Hdr.cbPtr * 2, pMsg->idThread, pszGroup);
+                pThis->pfnOutput(pThis->pvArgOutput, szPrefix, cchPrefix);
+            }
+        }
+
+        const char *pchEol = (const char *)memchr(pachChars, '\n', cbChars);
+        size_t const cchLine = pchEol ? pchEol - pachChars + 1 : cbChars;
+        pThis->pfnOutput(pThis->pvArgOutput, pachChars, cchLine);
+        if (pchEol)
+            pThis->fAtLineStart = true;
+        pachChars += cchLine;
+        cbChars   -= cchLine;
+    }
+    return cbRet;
+}
+
+
+/**
+ * Passes thru text found in the log file.
+ */
+static void rtLogBinDecodeText(PRTLOGBINDECODER pThis, const char *pachText, size_t cchText)
+{
+    if (cchText)
+    {
+        pThis->pfnOutput(pThis->pvArgOutput, pachText, cchText);
+        pThis->fAtLineStart = pachText[cchText - 1] == '\n';
+    }
+}
+
+
+/**
+ * AVL destruction callback for the format string tree.
+ */
+static DECLCALLBACK(int) rtLogBinDecodeFreeFmt(PAVLRU64NODECORE pNode, void *pvUser)
+{
+    RT_NOREF(pvUser);
+    RTMemFree(pNode);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Processes a header record.
+ */
+static int rtLogBinDecodeHdr(PRTLOGBINDECODER pThis, const uint8_t *pbRec, uint32_t cbRec)
+{
+    RTLOGBINHDR Hdr;
+    if (cbRec < sizeof(Hdr))
+        return VERR_INVALID_MAGIC;
+    memcpy(&Hdr, pbRec, sizeof(Hdr));
+    if ((Hdr.u32Version >> 16) != (RTLOGBINHDR_VERSION >> 16))
+        return VERR_VERSION_MISMATCH;
+#ifdef RT_BIG_ENDIAN
+    bool const fBigEndian = true;
+#else
+    bool const fBigEndian = false;
+#endif
+    if (   Hdr.cbPtr  != sizeof(void *)
+        || Hdr.cbLong != sizeof(long)
+        || RT_BOOL(Hdr.fBigEndian) != fBigEndian)
+        return VERR_NOT_SUPPORTED;
+
+    /* A new header means a new process, forget the format strings. */
+    RTAvlrU64Destroy(&pThis->FmtTree, rtLogBinDecodeFreeFmt, NULL);
+    RTMemFree(pThis->papszGroups);
+    pThis->papszGroups = NULL;
+    RTMemFree(pThis->pszGroupNames);
+    pThis->pszGroupNames = NULL;
+
+    /* Split up the group names. */
+    const char *pchNames = (const char *)pbRec + sizeof(Hdr);
+    size_t      cbNames  = cbRec - sizeof(Hdr);
+    if (Hdr.cGroups)
+    {
+        pThis->papszGroups   = (const char **)RTMemAllocZ(sizeof(pThis->papszGroups[0]) * Hdr.cGroups);
+        pThis->pszGroupNames = (char *)RTMemAllocZ(cbNames + 1);
+        if (!pThis->papszGroups || !pThis->pszGroupNames)
+            return VERR_NO_MEMORY;
+        memcpy(pThis->pszGroupNames, pchNames, cbNames);
+        const char *psz    = pThis->pszGroupNames;
+        const char *pszEnd = psz + cbNames;
+        for (uint32_t i = 0; i < Hdr.cGroups; i++)
+        {
+            if (psz < pszEnd)
+            {
+                pThis->papszGroups[i] = psz;
+                psz += strlen(psz) + 1;
+            }
+            else
+                pThis->papszGroups[i] = "";
+        }
+    }
+
+    pThis->Hdr      = Hdr;
+    pThis->fHaveHdr = true;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Processes a format string record.
+ */
+static int rtLogBinDecodeFmt(PRTLOGBINDECODER pThis, const uint8_t *pbRec, uint32_t cbRec)
+{
+    RTLOGBINFMT Fmt;
+    if (cbRec <= sizeof(Fmt))
+        return VERR_INVALID_MAGIC;
+    memcpy(&Fmt, pbRec, sizeof(Fmt));
+
+    size_t const    cchFormat = RTStrNLen((const char *)pbRec + sizeof(Fmt), cbRec - sizeof(Fmt));
+    PRTLOGBINDECFMT pFmt = (PRTLOGBINDECFMT)RTMemAlloc(RT_OFFSETOF(RTLOGBINDECFMT, szFormat[cchFormat + 1]));
+    if (!pFmt)
+        return VERR_NO_MEMORY;
+    pFmt->Core.Key     = Fmt.uKey;
+    pFmt->Core.KeyLast = Fmt.uKey;
+    memcpy(pFmt->szFormat, pbRec + sizeof(Fmt), cchFormat);
+    pFmt->szFormat[cchFormat] = '\0';
+
+    /* The most recent definition wins. */
+    PAVLRU64NODECORE pOld = RTAvlrU64Remove(&pThis->FmtTree, Fmt.uKey);
+    RTMemFree(pOld);
+    bool fRc = RTAvlrU64Insert(&pThis->FmtTree, &pFmt->Core);
+    Assert(fRc); RT_NOREF(fRc);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Processes a message record, formatting the message.
+ */
+static int rtLogBinDecodeMsg(PRTLOGBINDECODER pThis, const uint8_t *pbRec, uint32_t cbRec)
+{
+    RTLOGBINMSG Msg;
+    if (cbRec < sizeof(Msg))
+        return VERR_INVALID_MAGIC;
+    memcpy(&Msg, pbRec, sizeof(Msg));
+    if (!pThis->fHaveHdr)
+        return VINF_SUCCESS; /* Can't make sense of it without a header. */
+    pThis->pMsg = &Msg;
+
+    PRTLOGBINDECFMT pFmt = (PRTLOGBINDECFMT)RTAvlrU64Get(&pThis->FmtTree, Msg.uFmtKey);
+    if (!pFmt)
+    {
+        RTStrFormat(rtLogBinDecodeOutput, pThis, NULL, NULL, "<unknown format string %#RX64>\n", Msg.uFmtKey);
+        pThis->pMsg = NULL;
+        return VINF_SUCCESS;
+    }
+
+    const uint8_t *pbArgs = pbRec + sizeof(Msg);
+    size_t         cbArgs = cbRec - sizeof(Msg);
+#define RTLOGBIN_GET(a_Var) \
+        do { \
+            if (cbArgs < sizeof(a_Var)) \
+                goto l_truncated; \
+            memcpy(&(a_Var), pbArgs, sizeof(a_Var)); \
+            pbArgs += sizeof(a_Var); \
+            cbArgs -= sizeof(a_Var); \
+        } while (0)
+
+    const char *pszFormat = pFmt->szFormat;
+    for (;;)
+    {
+        const char *pch = strchr(pszFormat, '%');
+        if (!pch)
+        {
+            rtLogBinDecodeOutput(pThis, pszFormat, strlen(pszFormat));
+            break;
+        }
+        if (pch != pszFormat)
+            rtLogBinDecodeOutput(pThis, pszFormat, pch - pszFormat);
+
+        RTLOGBINSPEC Spec;
+        pszFormat = rtLogBinParseSpec(pch, &Spec);
+        if (!pszFormat)
+        {
+            RTStrFormat(rtLogBinDecodeOutput, pThis, NULL, NULL, "<bad format spec '%.16s'>\n", pch);
+            break;
+        }
+        if (Spec.enmKind == RTLOGBINSPEC_KIND_PERCENT)
+        {
+            rtLogBinDecodeOutput(pThis, "%", 1);
+            continue;
+        }
+
+        /*
+         * Reassemble the specification with the width and precision
+         * arguments inlined and format the single argument.
+         */
+        int32_t cchWidth     = Spec.cchWidth;
+        int32_t cchPrecision = Spec.cchPrecision;
+        if (Spec.fWidthArg)
+            RTLOGBIN_GET(cchWidth);
+        if (Spec.fPrecisionArg)
+        {
+            RTLOGBIN_GET(cchPrecision);
+            cchPrecision = RT_MAX(cchPrecision, 0);
+        }
+
+        const char *pszStr = NULL;
+        uint16_t    cchStr = 0;
+        if (Spec.enmKind == RTLOGBINSPEC_KIND_STR)
+        {
+            RTLOGBIN_GET(cchStr);
+            if (cbArgs < cchStr)
+                goto l_truncated;
+            pszStr  = (const char *)pbArgs;
+            pbArgs += cchStr;
+            cbArgs -= cchStr;
+            cchPrecision = cchStr; /* The string isn't terminated. */
+        }
+
+        char   szSpec[64];
+        size_t offSpec = 0;
+        szSpec[offSpec++] = '%';
+        memcpy(&szSpec[offSpec], Spec.pchFlags, Spec.cchFlags);
+        offSpec += Spec.cchFlags;
+        if (cchWidth < 0 && Spec.fWidthArg)
+        {
+            szSpec[offSpec++] = '-';
+            cchWidth = -cchWidth;
+        }
+        if (cchWidth >= 0)
+            offSpec += RTStrFormatNumber(&szSpec[offSpec], (uint32_t)RT_MIN(cchWidth, _64K), 10, 0, 0, 0);
+        if (cchPrecision >= 0)
+        {
+            szSpec[offSpec++] = '.';
+            offSpec += RTStrFormatNumber(&szSpec[offSpec], (uint32_t)RT_MIN(cchPrecision, _64K), 10, 0, 0, 0);
+        }
+        memcpy(&szSpec[offSpec], Spec.pchConv, Spec.cchConv);
+        offSpec += Spec.cchConv;
+        szSpec[offSpec] = '\0';
+        Assert(offSpec < sizeof(szSpec));
+
+        if (Spec.enmKind == RTLOGBINSPEC_KIND_STR)
+            RTStrFormat(rtLogBinDecodeOutput, pThis, NULL, NULL, szSpec, pszStr);
+        else if (Spec.cbValue == sizeof(uint64_t))
+        {
+            uint64_t u64;
+            RTLOGBIN_GET(u64);
+            RTStrFormat(rtLogBinDecodeOutput, pThis, NULL, NULL, szSpec, u64);
+        }
+        else
+        {
+            uint32_t u32;
+            RTLOGBIN_GET(u32);
+            RTStrFormat(rtLogBinDecodeOutput, pThis, NULL, NULL, szSpec, u32);
+        }
+    }
+#undef RTLOGBIN_GET
+
+    pThis->pMsg = NULL;
+    return VINF_SUCCESS;
+
+l_truncated:
+    rtLogBinDecodeOutput(pThis, RT_STR_TUPLE("<truncated>\n"));
+    pThis->pMsg = NULL;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Decodes what's in the buffer.
+ *
+ * @returns IPRT status code.
+ * @param   pThis       The decoder state.
+ * @param   pbBuf       The buffer.
+ * @param   cbBuf       The number of valid bytes in the buffer.
+ * @param   fEof        Whether the end of the file has been reached.
+ * @param   pcbUsed     Where to return the number of bytes consumed.  The
+ *                      rest has to be presented again with more data.
+ */
+static int rtLogBinDecodeBuf(PRTLOGBINDECODER pThis, const uint8_t *pbBuf, size_t cbBuf, bool fEof, size_t *pcbUsed)
+{
+    uint32_t const u32Magic = RTLOGBINREC_MAGIC;
+    uint8_t        abMagic[sizeof(u32Magic)];
+    memcpy(abMagic, &u32Magic, sizeof(abMagic));
+
+    int    rc  = VINF_SUCCESS;
+    size_t off = 0;
+    while (off < cbBuf && RT_SUCCESS(rc))
+    {
+        size_t const cbLeft = cbBuf - off;
+        if (pbBuf[off] == abMagic[0])
+        {
+            if (cbLeft < sizeof(RTLOGBINREC) && !fEof)
+                break;
+            RTLOGBINREC Rec;
+            if (cbLeft >= sizeof(Rec))
+                memcpy(&Rec, &pbBuf[off], sizeof(Rec));
+            if (   cbLeft >= sizeof(Rec)
+                && Rec.u32Magic == RTLOGBINREC_MAGIC
+                && Rec.cbRec >= sizeof(Rec)
+                && Rec.cbRec <= RTLOGBIN_DECODE_MAX_REC)
+            {
+                if (Rec.cbRec > cbLeft)
+                {
+                    if (!fEof)
+                        break;
+                    rtLogBinDecodeOutput(pThis, RT_STR_TUPLE("<truncated record>\n"));
+                    off = cbBuf;
+                    break;
+                }
+                switch (Rec.u16Type)
+                {
+                    case RTLOGBINREC_TYPE_HDR:  rc = rtLogBinDecodeHdr(pThis, &pbBuf[off], Rec.cbRec); break;
+                    case RTLOGBINREC_TYPE_FMT:  rc = rtLogBinDecodeFmt(pThis, &pbBuf[off], Rec.cbRec); break;
+                    case RTLOGBINREC_TYPE_MSG:  rc = rtLogBinDecodeMsg(pThis, &pbBuf[off], Rec.cbRec); break;
+                    default: /* Skip unknown records. */ break;
+                }
+                off += Rec.cbRec;
+                continue;
+            }
+
+            /* Not a record, treat the byte as text. */
+            rtLogBinDecodeText(pThis, (const char *)&pbBuf[off], 1);
+            off++;
+            continue;
+        }
+
+        /* Pass thru text up to the next potential record. */
+        const uint8_t *pbNext = (const uint8_t *)memchr(&pbBuf[off], abMagic[0], cbLeft);
+        size_t const   cbText = pbNext ? (size_t)(pbNext - &pbBuf[off]) : cbLeft;
+        rtLogBinDecodeText(pThis, (const char *)&pbBuf[off], cbText);
+        off += cbText;
+    }
+
+    *pcbUsed = off;
+    return rc;
+}
+
+
+RTDECL(int) RTLogBinDecodeFile(const char *pszFilename, uint32_t fFlags, PFNRTSTROUTPUT pfnOutput, void *pvArgOutput)
+{
+    AssertPtrReturn(pszFilename, VERR_INVALID_POINTER);
+    AssertReturn(!(fFlags & ~RTLOGBINDECODE_F_VALID_MASK), VERR_INVALID_FLAGS);
+    AssertPtrReturn(pfnOutput, VERR_INVALID_POINTER);
+
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, pszFilename, RTFILE_O_READ | RTFILE_O_OPEN | RTFILE_O_DENY_NONE);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    uint8_t *pbBuf = (uint8_t *)RTMemAlloc(RTLOGBIN_DECODE_BUF_SIZE);
+    if (pbBuf)
+    {
+        RTLOGBINDECODER This;
+        RT_ZERO(This);
+        This.fFlags       = fFlags;
+        This.fAtLineStart = true;
+        This.pfnOutput    = pfnOutput;
+        This.pvArgOutput  = pvArgOutput;
+
+        size_t cbBuf = 0;
+        bool   fEof  = false;
+        while (!fEof)
+        {
+            size_t const cbToRead = RTLOGBIN_DECODE_BUF_SIZE - cbBuf;
+            size_t       cbRead   = 0;
+            rc = RTFileRead(hFile, &pbBuf[cbBuf], cbToRead, &cbRead);
+            if (RT_FAILURE(rc))
+                break;
+            cbBuf += cbRead;
+            fEof = cbRead < cbToRead;
+
+            size_t cbUsed = 0;
+            rc = rtLogBinDecodeBuf(&This, pbBuf, cbBuf, fEof, &cbUsed);
+            if (RT_FAILURE(rc))
+                break;
+            memmove(pbBuf, &pbBuf[cbUsed], cbBuf - cbUsed);
+            cbBuf -= cbUsed;
+        }
+        pfnOutput(pvArgOutput, NULL, 0);
+
+        RTAvlrU64Destroy(&This.FmtTree, rtLogBinDecodeFreeFmt, NULL);
+        RTMemFree(This.papszGroups);
+        RTMemFree(This.pszGroupNames);
+        RTMemFree(pbBuf);
+    }
+    else
+        rc = VERR_NO_MEMORY;
+
+    RTFileClose(hFile);
+    return rc;
+}
+RT_EXPORT_SYMBOL(RTLogBinDecodeFile);
+
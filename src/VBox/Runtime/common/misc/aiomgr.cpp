@@ -1141,7 +1141,7 @@ RTDECL(int) RTAioMgrCreate(PRTAIOMGR phAioMgr, uint32_t cReqsMax)
             if (RT_SUCCESS(rc))
             {
                 rc = RTMemCacheCreate(&pThis->hMemCacheReqs, sizeof(RTAIOMGRREQ),
-                                      0, UINT32_MAX, rtAioMgrReqCtor, rtAioMgrReqDtor, NULL, 0);
+                                      0, UINT32_MAX, rtAioMgrReqCtor, rtAioMgrReqDtor, NULL, RTMEMCACHE_F_MAGAZINES);
                 if (RT_SUCCESS(rc))
                 {
                     rc = RTFileAioCtxCreate(&pThis->hAioCtx, cReqsMax == UINT32_MAX
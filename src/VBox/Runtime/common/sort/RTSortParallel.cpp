@@ -0,0 +1,314 @@
+/* $Id$ */
+/** @file
+ * IPRT - RTSortParallel and RTSortApvParallel.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "internal/iprt.h"
+#include <iprt/sort.h>
+
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/err.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/mp.h>
+#include <iprt/once.h>
+#include <iprt/req.h>
+#include <iprt/string.h>
+#include "internal/sort.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Below this number of elements we don't bother with threads. */
+#define RTSORTPAR_MIN_ELEMENTS      _64K
+/** Max number of chunks (and threads). */
+#define RTSORTPAR_MAX_CHUNKS        16
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Parallel sort state.
+ */
+typedef struct RTSORTPAR
+{
+    /** The element size. */
+    size_t          cbElement;
+    /** The compare function. */
+    PFNRTSORTCMP    pfnCmp;
+    /** The user argument for pfnCmp. */
+    void           *pvUser;
+    /** Number of chunks, power of two. */
+    uint32_t        cChunks;
+    /** Start index of each chunk, with an extra entry for the end. */
+    size_t          aiChunks[RTSORTPAR_MAX_CHUNKS + 1];
+} RTSORTPAR;
+/** Pointer to the parallel sort state. */
+typedef RTSORTPAR *PRTSORTPAR;
+
+/**
+ * A job: sorting a chunk or merging two sorted runs.
+ */
+typedef struct RTSORTPARJOB
+{
+    /** The sort state. */
+    PRTSORTPAR      pThis;
+    /** The source, i.e. the chunk to sort or the two runs to merge. */
+    uint8_t        *pbSrc;
+    /** The merge destination, NULL when sorting a chunk. */
+    uint8_t        *pbDst;
+    /** Number of elements in the chunk / left run. */
+    size_t          cLeft;
+    /** Number of elements in the right run. */
+    size_t          cRight;
+    /** The request handle if queued. */
+    PRTREQ          hReq;
+} RTSORTPARJOB;
+/** Pointer to a parallel sort job. */
+typedef RTSORTPARJOB *PRTSORTPARJOB;
+
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** Initialize the worker pool once. */
+static RTONCE       g_RTSortParOnce = RTONCE_INITIALIZER;
+/** The worker pool shared by all RTSortParallel calls.  The idle workers
+ * terminate after a second, so this costs nothing between sorts. */
+static RTREQPOOL    g_hRTSortParPool = NIL_RTREQPOOL;
+/** The number of chunks to split the array into, power of two. */
+static uint32_t     g_cRTSortParChunks = 1;
+
+
+/**
+ * @callback_method_impl{FNRTTERMCALLBACK}
+ */
+static DECLCALLBACK(void) rtSortParallelTermCallback(RTTERMREASON enmReason, int32_t iStatus, void *pvUser)
+{
+    RT_NOREF2(iStatus, pvUser);
+    if (enmReason == RTTERMREASON_UNLOAD)
+    {
+        RTReqPoolRelease(g_hRTSortParPool);
+        g_hRTSortParPool = NIL_RTREQPOOL;
+    }
+}
+
+
+/**
+ * @callback_method_impl{FNRTONCE, Creates the worker pool.}
+ */
+static DECLCALLBACK(int) rtSortParallelInitOnce(void *pvUser)
+{
+    RT_NOREF(pvUser);
+    uint32_t const cChunks = RT_BIT_32(ASMBitLastSetU32(RT_MIN(RTMpGetOnlineCount(), RTSORTPAR_MAX_CHUNKS)) - 1);
+    if (cChunks < 2)
+        return VERR_NOT_SUPPORTED;
+    int rc = RTReqPoolCreate(cChunks - 1, RT_MS_1SEC, cChunks - 1, 0 /*cMsMaxPushBack*/, "RTSort", &g_hRTSortParPool);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTTermRegisterCallback(rtSortParallelTermCallback, NULL);
+        if (RT_SUCCESS(rc))
+        {
+            g_cRTSortParChunks = cChunks;
+            return VINF_SUCCESS;
+        }
+        RTReqPoolRelease(g_hRTSortParPool);
+        g_hRTSortParPool = NIL_RTREQPOOL;
+    }
+    return rc;
+}
+
+/**
+ * Job worker: sorts a chunk or merges two runs into the destination buffer.
+ *
+ * @param   pJob            The job.
+ */
+static DECLCALLBACK(void) rtSortParallelJob(PRTSORTPARJOB pJob)
+{
+    PRTSORTPAR const pThis = pJob->pThis;
+    size_t const     cb    = pThis->cbElement;
+    if (!pJob->pbDst)
+    {
+        RTSortIntro(pJob->pbSrc, pJob->cLeft, cb, pThis->pfnCmp, pThis->pvUser);
+        return;
+    }
+
+    uint8_t const *pbLeft    = pJob->pbSrc;
+    uint8_t const *pbLeftEnd = &pbLeft[pJob->cLeft * cb];
+    uint8_t const *pbRight   = pbLeftEnd;
+    uint8_t const *pbEnd     = &pbRight[pJob->cRight * cb];
+    uint8_t       *pbDst     = pJob->pbDst;
+    while (pbLeft < pbLeftEnd && pbRight < pbEnd)
+    {
+        if (pThis->pfnCmp(pbRight, pbLeft, pThis->pvUser) < 0)
+        {
+            memcpy(pbDst, pbRight, cb);
+            pbRight += cb;
+        }
+        else
+        {
+            memcpy(pbDst, pbLeft, cb);
+            pbLeft += cb;
+        }
+        pbDst += cb;
+    }
+    memcpy(pbDst, pbLeft, pbLeftEnd - pbLeft);
+    pbDst += pbLeftEnd - pbLeft;
+    memcpy(pbDst, pbRight, pbEnd - pbRight);
+}
+
+
+/**
+ * Runs a set of jobs, the first on the calling thread and the rest on the
+ * pool, and waits for them all to complete.
+ *
+ * @param   paJobs          The jobs.
+ * @param   cJobs           The number of jobs.
+ */
+static void rtSortParallelRunJobs(PRTSORTPARJOB paJobs, uint32_t cJobs)
+{
+    for (uint32_t i = 1; i < cJobs; i++)
+    {
+        paJobs[i].hReq = NIL_RTREQ;
+        int rc = RTReqPoolCallEx(g_hRTSortParPool, 0 /*cMillies*/, &paJobs[i].hReq, RTREQFLAGS_VOID,
+                                 (PFNRT)rtSortParallelJob, 1, &paJobs[i]);
+        if (rc != VINF_SUCCESS && rc != VERR_TIMEOUT)
+        {
+            /* Couldn't queue it, do it ourselves. */
+            if (paJobs[i].hReq != NIL_RTREQ)
+            {
+                RTReqRelease(paJobs[i].hReq);
+                paJobs[i].hReq = NIL_RTREQ;
+            }
+            rtSortParallelJob(&paJobs[i]);
+        }
+    }
+
+    rtSortParallelJob(&paJobs[0]);
+
+    for (uint32_t i = 1; i < cJobs; i++)
+        if (paJobs[i].hReq != NIL_RTREQ)
+        {
+            int rc = RTReqWait(paJobs[i].hReq, RT_INDEFINITE_WAIT);
+            AssertRC(rc);
+            RTReqRelease(paJobs[i].hReq);
+        }
+}
+
+
+RTDECL(void) RTSortParallel(void *pvArray, size_t cElements, size_t cbElement, PFNRTSORTCMP pfnCmp, void *pvUser)
+{
+    /*
+     * Small arrays, single CPU hosts and resource shortages are dealt with by
+     * the single threaded introsort.
+     */
+    if (   cElements < RTSORTPAR_MIN_ELEMENTS
+        || RT_FAILURE(RTOnce(&g_RTSortParOnce, rtSortParallelInitOnce, NULL)))
+    {
+        RTSortIntro(pvArray, cElements, cbElement, pfnCmp, pvUser);
+        return;
+    }
+
+    uint8_t *pbTmp = (uint8_t *)RTMemTmpAlloc(cElements * cbElement);
+    if (!pbTmp)
+    {
+        RTSortIntro(pvArray, cElements, cbElement, pfnCmp, pvUser);
+        return;
+    }
+
+    RTSORTPAR This;
+    This.cbElement = cbElement;
+    This.pfnCmp    = pfnCmp;
+    This.pvUser    = pvUser;
+    This.cChunks   = g_cRTSortParChunks;
+    for (uint32_t i = 0; i <= This.cChunks; i++)
+        This.aiChunks[i] = (size_t)((uint64_t)cElements * i / This.cChunks);
+
+    /*
+     * Sort the chunks.
+     */
+    RTSORTPARJOB aJobs[RTSORTPAR_MAX_CHUNKS];
+    uint8_t     *pbSrc = (uint8_t *)pvArray;
+    uint8_t     *pbDst = pbTmp;
+    for (uint32_t i = 0; i < This.cChunks; i++)
+    {
+        aJobs[i].pThis  = &This;
+        aJobs[i].pbSrc  = &pbSrc[This.aiChunks[i] * cbElement];
+        aJobs[i].pbDst  = NULL;
+        aJobs[i].cLeft  = This.aiChunks[i + 1] - This.aiChunks[i];
+        aJobs[i].cRight = 0;
+    }
+    rtSortParallelRunJobs(aJobs, This.cChunks);
+
+    /*
+     * Merge pairs of runs, ping-ponging between the array and the buffer,
+     * halving the number of runs (and jobs) each round.
+     */
+    for (uint32_t cWidth = 1; cWidth < This.cChunks; cWidth *= 2)
+    {
+        uint32_t cJobs = 0;
+        for (uint32_t iChunk = 0; iChunk < This.cChunks; iChunk += cWidth * 2)
+        {
+            size_t const iStart = This.aiChunks[iChunk];
+            size_t const iMid   = This.aiChunks[iChunk + cWidth];
+            size_t const iEnd   = This.aiChunks[iChunk + cWidth * 2];
+            aJobs[cJobs].pThis  = &This;
+            aJobs[cJobs].pbSrc  = &pbSrc[iStart * cbElement];
+            aJobs[cJobs].pbDst  = &pbDst[iStart * cbElement];
+            aJobs[cJobs].cLeft  = iMid - iStart;
+            aJobs[cJobs].cRight = iEnd - iMid;
+            cJobs++;
+        }
+        rtSortParallelRunJobs(aJobs, cJobs);
+
+        uint8_t *pbSwap = pbSrc;
+        pbSrc = pbDst;
+        pbDst = pbSwap;
+    }
+
+    if (pbSrc != (uint8_t *)pvArray)
+        memcpy(pvArray, pbSrc, cElements * cbElement);
+
+    RTMemTmpFree(pbTmp);
+}
+RT_EXPORT_SYMBOL(RTSortParallel);
+
+
+RTDECL(void) RTSortApvParallel(void **papvArray, size_t cElements, PFNRTSORTCMP pfnCmp, void *pvUser)
+{
+    RTSORTAPVCTX Ctx;
+    Ctx.pfnCmp = pfnCmp;
+    Ctx.pvUser = pvUser;
+    RTSortParallel(papvArray, cElements, sizeof(papvArray[0]), rtSortApvCompare, &Ctx);
+}
+RT_EXPORT_SYMBOL(RTSortApvParallel);
+
@@ -0,0 +1,291 @@
+/* $Id$ */
+/** @file
+ * IPRT - RTSortIntro and RTSortApvIntro.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "internal/iprt.h"
+#include <iprt/sort.h>
+
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/string.h>
+#include "internal/sort.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Above this number of elements the pivot is the median of three medians. */
+#define RTSORTINTRO_NINTHER_THRESHOLD   128
+/** Max number of elements moved by rtSortIntroPartialInsertion. */
+#define RTSORTINTRO_PARTIAL_LIMIT       8
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Sort parameters, to avoid passing them all down the recursion.
+ */
+typedef struct RTSORTINTRO
+{
+    /** The element size. */
+    size_t          cbElement;
+    /** The compare function. */
+    PFNRTSORTCMP    pfnCmp;
+    /** The user argument for pfnCmp. */
+    void           *pvUser;
+} RTSORTINTRO;
+typedef RTSORTINTRO const *PCRTSORTINTRO;
+
+
+/**
+ * Insertion sort, for short runs.
+ */
+static void rtSortIntroInsertion(PCRTSORTINTRO pThis, uint8_t *pbArray, size_t cElements)
+{
+    size_t const cb = pThis->cbElement;
+    for (size_t i = 1; i < cElements; i++)
+        for (size_t j = i; j > 0 && pThis->pfnCmp(&pbArray[(j - 1) * cb], &pbArray[j * cb], pThis->pvUser) > 0; j--)
+            rtSortSwap(&pbArray[(j - 1) * cb], &pbArray[j * cb], cb);
+}
+
+
+/**
+ * Insertion sort that gives up after moving RTSORTINTRO_PARTIAL_LIMIT
+ * elements, used on partitions that look like they're already sorted.
+ *
+ * @returns true if sorted, false if it gave up.
+ */
+static bool rtSortIntroPartialInsertion(PCRTSORTINTRO pThis, uint8_t *pbArray, size_t cElements)
+{
+    size_t const cb     = pThis->cbElement;
+    size_t       cMoves = 0;
+    for (size_t i = 1; i < cElements; i++)
+    {
+        size_t j = i;
+        for (; j > 0 && pThis->pfnCmp(&pbArray[(j - 1) * cb], &pbArray[j * cb], pThis->pvUser) > 0; j--)
+            rtSortSwap(&pbArray[(j - 1) * cb], &pbArray[j * cb], cb);
+        cMoves += i - j;
+        if (cMoves > RTSORTINTRO_PARTIAL_LIMIT)
+            return false;
+    }
+    return true;
+}
+
+
+/**
+ * Sifts an element down a heap, helper for rtSortIntroHeap.
+ *
+ * @param   pThis           The sort parameters.
+ * @param   pbArray         The heap.
+ * @param   iRoot           The index of the element to sift down.
+ * @param   cHeap           The number of elements in the heap.
+ */
+DECLINLINE(void) rtSortIntroSiftDown(PCRTSORTINTRO pThis, uint8_t *pbArray, size_t iRoot, size_t cHeap)
+{
+    size_t const cb      = pThis->cbElement;
+    size_t       iParent = iRoot;
+    for (;;)
+    {
+        size_t iChild = iParent * 2 + 1;
+        if (iChild >= cHeap)
+            break;
+        if (   iChild + 1 < cHeap
+            && pThis->pfnCmp(&pbArray[iChild * cb], &pbArray[(iChild + 1) * cb], pThis->pvUser) < 0)
+            iChild++;
+        if (pThis->pfnCmp(&pbArray[iParent * cb], &pbArray[iChild * cb], pThis->pvUser) >= 0)
+            break;
+        rtSortSwap(&pbArray[iParent * cb], &pbArray[iChild * cb], cb);
+        iParent = iChild;
+    }
+}
+
+
+/**
+ * Heap sort, the fallback when the partitioning goes bad.
+ */
+static void rtSortIntroHeap(PCRTSORTINTRO pThis, uint8_t *pbArray, size_t cElements)
+{
+    size_t const cb = pThis->cbElement;
+    for (size_t i = cElements / 2; i-- > 0;)
+        rtSortIntroSiftDown(pThis, pbArray, i, cElements);
+    for (size_t cHeap = cElements - 1; cHeap > 0; cHeap--)
+    {
+        rtSortSwap(&pbArray[0], &pbArray[cHeap * cb], cb);
+        rtSortIntroSiftDown(pThis, pbArray, 0, cHeap);
+    }
+}
+
+
+/**
+ * Orders three elements and returns the index of the median.
+ */
+DECLINLINE(size_t) rtSortIntroMedian3(PCRTSORTINTRO pThis, uint8_t *pbArray, size_t i1, size_t i2, size_t i3)
+{
+    size_t const cb = pThis->cbElement;
+    if (pThis->pfnCmp(&pbArray[i2 * cb], &pbArray[i1 * cb], pThis->pvUser) < 0)
+        rtSortSwap(&pbArray[i2 * cb], &pbArray[i1 * cb], cb);
+    if (pThis->pfnCmp(&pbArray[i3 * cb], &pbArray[i2 * cb], pThis->pvUser) < 0)
+    {
+        rtSortSwap(&pbArray[i3 * cb], &pbArray[i2 * cb], cb);
+        if (pThis->pfnCmp(&pbArray[i2 * cb], &pbArray[i1 * cb], pThis->pvUser) < 0)
+            rtSortSwap(&pbArray[i2 * cb], &pbArray[i1 * cb], cb);
+    }
+    return i2;
+}
+
+
+/**
+ * The introsort worker.
+ *
+ * This is quicksort with a median-of-three (or ninther) pivot, recursing
+ * into the smaller partition and looping on the larger one.  Small ranges
+ * are insertion sorted, and when the recursion gets too deep (bad pivots)
+ * it switches to heap sort, guaranteeing O(n log n).
+ *
+ * Like pattern-defeating quicksort, a partitioning step that didn't have to
+ * move anything is taken as a hint that the input is (nearly) sorted, and a
+ * bounded insertion sort is tried on both partitions before carrying on.
+ *
+ * @param   pThis           The sort parameters.
+ * @param   pbArray         The array range to sort.
+ * @param   cElements       The number of elements in the range.
+ * @param   cDepthLeft      How many more levels we'll go before resorting to
+ *                          heap sort.
+ */
+static void rtSortIntroWorker(PCRTSORTINTRO pThis, uint8_t *pbArray, size_t cElements, unsigned cDepthLeft)
+{
+    size_t const cb = pThis->cbElement;
+    while (cElements > RTSORT_INSERTION_THRESHOLD)
+    {
+        if (cDepthLeft == 0)
+        {
+            rtSortIntroHeap(pThis, pbArray, cElements);
+            return;
+        }
+        cDepthLeft--;
+
+        /*
+         * Pick the pivot and move it to the start of the range.
+         */
+        size_t iPivot;
+        size_t const iMid = cElements / 2;
+        if (cElements > RTSORTINTRO_NINTHER_THRESHOLD)
+        {
+            size_t const cStep = cElements / 8;
+            size_t const i1 = rtSortIntroMedian3(pThis, pbArray, 0, cStep, 2 * cStep);
+            size_t const i2 = rtSortIntroMedian3(pThis, pbArray, iMid - cStep, iMid, iMid + cStep);
+            size_t const i3 = rtSortIntroMedian3(pThis, pbArray, cElements - 1 - 2 * cStep, cElements - 1 - cStep, cElements - 1);
+            iPivot = rtSortIntroMedian3(pThis, pbArray, i1, i2, i3);
+        }
+        else
+            iPivot = rtSortIntroMedian3(pThis, pbArray, 0, iMid, cElements - 1);
+        rtSortSwap(&pbArray[0], &pbArray[iPivot * cb], cb);
+
+        /*
+         * Partition: [0, j) <= pivot, j = pivot, (j, cElements) >= pivot.
+         * Stopping on equal elements on both sides keeps ranges with lots of
+         * duplicates balanced.
+         */
+        uint8_t const *pbPivot  = &pbArray[0];
+        size_t         i        = 0;
+        size_t         j        = cElements;
+        bool           fSwapped = false;
+        for (;;)
+        {
+            do
+                i++;
+            while (i < cElements && pThis->pfnCmp(&pbArray[i * cb], pbPivot, pThis->pvUser) < 0);
+            do
+                j--;
+            while (pThis->pfnCmp(&pbArray[j * cb], pbPivot, pThis->pvUser) > 0);
+            if (i >= j)
+                break;
+            rtSortSwap(&pbArray[i * cb], &pbArray[j * cb], cb);
+            fSwapped = true;
+        }
+        rtSortSwap(&pbArray[0], &pbArray[j * cb], cb);
+
+        uint8_t     *pbRight = &pbArray[(j + 1) * cb];
+        size_t const cLeft   = j;
+        size_t const cRight  = cElements - j - 1;
+
+        /* Looks sorted already?  Try finish it off cheaply. */
+        if (   !fSwapped
+            && rtSortIntroPartialInsertion(pThis, pbArray, cLeft)
+            && rtSortIntroPartialInsertion(pThis, pbRight, cRight))
+            return;
+
+        /*
+         * Recurse on the smaller partition, loop on the larger.
+         */
+        if (cLeft < cRight)
+        {
+            rtSortIntroWorker(pThis, pbArray, cLeft, cDepthLeft);
+            pbArray   = pbRight;
+            cElements = cRight;
+        }
+        else
+        {
+            rtSortIntroWorker(pThis, pbRight, cRight, cDepthLeft);
+            cElements = cLeft;
+        }
+    }
+
+    rtSortIntroInsertion(pThis, pbArray, cElements);
+}
+
+
+RTDECL(void) RTSortIntro(void *pvArray, size_t cElements, size_t cbElement, PFNRTSORTCMP pfnCmp, void *pvUser)
+{
+    /* Anything worth sorting? */
+    if (cElements < 2)
+        return;
+
+    RTSORTINTRO This;
+    This.cbElement = cbElement;
+    This.pfnCmp    = pfnCmp;
+    This.pvUser    = pvUser;
+
+    /* Allow 2 * log2(n) levels of quicksort before falling back on heap sort. */
+    unsigned const cDepth = 2 * (unsigned)(ASMBitLastSetU64(cElements));
+    rtSortIntroWorker(&This, (uint8_t *)pvArray, cElements, cDepth);
+}
+RT_EXPORT_SYMBOL(RTSortIntro);
+
+
+RTDECL(void) RTSortApvIntro(void **papvArray, size_t cElements, PFNRTSORTCMP pfnCmp, void *pvUser)
+{
+    RTSORTAPVCTX Ctx;
+    Ctx.pfnCmp = pfnCmp;
+    Ctx.pvUser = pvUser;
+    RTSortIntro(papvArray, cElements, sizeof(papvArray[0]), rtSortApvCompare, &Ctx);
+}
+RT_EXPORT_SYMBOL(RTSortApvIntro);
+
@@ -0,0 +1,241 @@
+/* $Id$ */
+/** @file
+ * IPRT - RTSortMerge and RTSortApvMerge.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "internal/iprt.h"
+#include <iprt/sort.h>
+
+#include <iprt/assert.h>
+#include <iprt/mem.h>
+#include <iprt/string.h>
+#include "internal/sort.h"
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Sort parameters, to avoid passing them all down the recursion.
+ */
+typedef struct RTSORTMERGE
+{
+    /** The element size. */
+    size_t          cbElement;
+    /** The compare function. */
+    PFNRTSORTCMP    pfnCmp;
+    /** The user argument for pfnCmp. */
+    void           *pvUser;
+    /** Temporary buffer for half the array, NULL if we're doing it in place. */
+    uint8_t        *pbTmp;
+} RTSORTMERGE;
+typedef RTSORTMERGE const *PCRTSORTMERGE;
+
+
+/**
+ * Stable insertion sort, for short runs.
+ */
+static void rtSortMergeInsertion(PCRTSORTMERGE pThis, uint8_t *pbArray, size_t cElements)
+{
+    size_t const cb = pThis->cbElement;
+    for (size_t i = 1; i < cElements; i++)
+        for (size_t j = i; j > 0 && pThis->pfnCmp(&pbArray[(j - 1) * cb], &pbArray[j * cb], pThis->pvUser) > 0; j--)
+            rtSortSwap(&pbArray[(j - 1) * cb], &pbArray[j * cb], cb);
+}
+
+
+/**
+ * Reverses a range of elements.
+ */
+static void rtSortMergeReverse(PCRTSORTMERGE pThis, uint8_t *pbArray, size_t cElements)
+{
+    size_t const cb = pThis->cbElement;
+    for (size_t i = 0, j = cElements - 1; i < j; i++, j--)
+        rtSortSwap(&pbArray[i * cb], &pbArray[j * cb], cb);
+}
+
+
+/**
+ * Merges two adjacent sorted runs in place, when we couldn't get a buffer.
+ *
+ * This is the classic recursive rotation based merge, O(n log n) for the
+ * merge and thus O(n log^2 n) for the whole sort.
+ */
+static void rtSortMergeInPlace(PCRTSORTMERGE pThis, uint8_t *pbArray, size_t cLeft, size_t cRight)
+{
+    size_t const cb = pThis->cbElement;
+    if (!cLeft || !cRight)
+        return;
+    if (cLeft + cRight == 2)
+    {
+        if (pThis->pfnCmp(&pbArray[cb], &pbArray[0], pThis->pvUser) < 0)
+            rtSortSwap(&pbArray[0], &pbArray[cb], cb);
+        return;
+    }
+
+    /* Split the longer run in two, and find where its middle element goes in
+       the other run (upper bound for the left run, lower bound for the right). */
+    size_t iCutLeft;
+    size_t iCutRight;
+    if (cLeft > cRight)
+    {
+        iCutLeft = cLeft / 2;
+        size_t iLow = 0, iHigh = cRight;
+        while (iLow < iHigh)
+        {
+            size_t const iMid = iLow + (iHigh - iLow) / 2;
+            if (pThis->pfnCmp(&pbArray[(cLeft + iMid) * cb], &pbArray[iCutLeft * cb], pThis->pvUser) < 0)
+                iLow = iMid + 1;
+            else
+                iHigh = iMid;
+        }
+        iCutRight = iLow;
+    }
+    else
+    {
+        iCutRight = cRight / 2;
+        size_t iLow = 0, iHigh = cLeft;
+        while (iLow < iHigh)
+        {
+            size_t const iMid = iLow + (iHigh - iLow) / 2;
+            if (pThis->pfnCmp(&pbArray[(cLeft + iCutRight) * cb], &pbArray[iMid * cb], pThis->pvUser) < 0)
+                iHigh = iMid;
+            else
+                iLow = iMid + 1;
+        }
+        iCutLeft = iLow;
+    }
+
+    /* Rotate [iCutLeft, cLeft + iCutRight) so the right part's head comes
+       before the left part's tail, then merge the two halves. */
+    size_t const cTail = cLeft - iCutLeft;
+    if (cTail && iCutRight)
+    {
+        uint8_t *pbRot = &pbArray[iCutLeft * cb];
+        rtSortMergeReverse(pThis, pbRot, cTail);
+        rtSortMergeReverse(pThis, &pbArray[cLeft * cb], iCutRight);
+        rtSortMergeReverse(pThis, pbRot, cTail + iCutRight);
+    }
+    size_t const iNewMid = iCutLeft + iCutRight;
+    rtSortMergeInPlace(pThis, pbArray, iCutLeft, iCutRight);
+    rtSortMergeInPlace(pThis, &pbArray[iNewMid * cb], cTail, cRight - iCutRight);
+}
+
+
+/**
+ * Merges two adjacent sorted runs using the temporary buffer.
+ *
+ * Only the left run is copied to the buffer, so the buffer needs to be half
+ * the array size only.
+ */
+static void rtSortMergeBuffered(PCRTSORTMERGE pThis, uint8_t *pbArray, size_t cLeft, size_t cRight)
+{
+    size_t const cb = pThis->cbElement;
+
+    /* Nothing to do if the runs are already in order (presorted input). */
+    if (pThis->pfnCmp(&pbArray[cLeft * cb], &pbArray[(cLeft - 1) * cb], pThis->pvUser) >= 0)
+        return;
+
+    memcpy(pThis->pbTmp, pbArray, cLeft * cb);
+    uint8_t const *pbLeft    = pThis->pbTmp;
+    uint8_t const *pbLeftEnd = &pThis->pbTmp[cLeft * cb];
+    uint8_t const *pbRight   = &pbArray[cLeft * cb];
+    uint8_t const *pbEnd     = &pbArray[(cLeft + cRight) * cb];
+    uint8_t       *pbDst     = pbArray;
+    while (pbLeft < pbLeftEnd && pbRight < pbEnd)
+    {
+        /* Take from the left one on equality, that's what makes it stable. */
+        if (pThis->pfnCmp(pbRight, pbLeft, pThis->pvUser) < 0)
+        {
+            memcpy(pbDst, pbRight, cb);
+            pbRight += cb;
+        }
+        else
+        {
+            memcpy(pbDst, pbLeft, cb);
+            pbLeft += cb;
+        }
+        pbDst += cb;
+    }
+    /* Whatever is left of the right run is already in place. */
+    memcpy(pbDst, pbLeft, pbLeftEnd - pbLeft);
+}
+
+
+/**
+ * The top-down merge sort worker.
+ */
+static void rtSortMergeWorker(PCRTSORTMERGE pThis, uint8_t *pbArray, size_t cElements)
+{
+    if (cElements <= RTSORT_INSERTION_THRESHOLD)
+    {
+        rtSortMergeInsertion(pThis, pbArray, cElements);
+        return;
+    }
+
+    size_t const cLeft  = cElements / 2;
+    size_t const cRight = cElements - cLeft;
+    rtSortMergeWorker(pThis, pbArray, cLeft);
+    rtSortMergeWorker(pThis, &pbArray[cLeft * pThis->cbElement], cRight);
+    if (pThis->pbTmp)
+        rtSortMergeBuffered(pThis, pbArray, cLeft, cRight);
+    else
+        rtSortMergeInPlace(pThis, pbArray, cLeft, cRight);
+}
+
+
+RTDECL(void) RTSortMerge(void *pvArray, size_t cElements, size_t cbElement, PFNRTSORTCMP pfnCmp, void *pvUser)
+{
+    /* Anything worth sorting? */
+    if (cElements < 2)
+        return;
+
+    RTSORTMERGE This;
+    This.cbElement = cbElement;
+    This.pfnCmp    = pfnCmp;
+    This.pvUser    = pvUser;
+    This.pbTmp     = NULL;
+    if (cElements > RTSORT_INSERTION_THRESHOLD)
+        This.pbTmp = (uint8_t *)RTMemTmpAlloc((cElements / 2) * cbElement);
+
+    rtSortMergeWorker(&This, (uint8_t *)pvArray, cElements);
+
+    RTMemTmpFree(This.pbTmp);
+}
+RT_EXPORT_SYMBOL(RTSortMerge);
+
+
+RTDECL(void) RTSortApvMerge(void **papvArray, size_t cElements, PFNRTSORTCMP pfnCmp, void *pvUser)
+{
+    RTSORTAPVCTX Ctx;
+    Ctx.pfnCmp = pfnCmp;
+    Ctx.pvUser = pvUser;
+    RTSortMerge(papvArray, cElements, sizeof(papvArray[0]), rtSortApvCompare, &Ctx);
+}
+RT_EXPORT_SYMBOL(RTSortApvMerge);
+
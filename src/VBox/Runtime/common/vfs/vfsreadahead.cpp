@@ -53,9 +53,19 @@
 #include <iprt/critsect.h>
 #include <iprt/err.h>
 #include <iprt/mem.h>
+#include <iprt/semaphore.h>
 #include <iprt/thread.h>
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The default number of concurrent requests in parallel mode. */
+#define RTVFSREADAHEAD_DEFAULT_REQS     4
+/** The max number of worker threads in parallel mode. */
+#define RTVFSREADAHEAD_MAX_WORKERS      16
+
+
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
@@ -71,8 +81,10 @@ typedef struct RTVFSREADAHEADBUFDESC
     /** The amount of the buffer that has been filled.
      * (Buffer size is RTVFSREADAHEAD::cbBuffer.)  */
     uint32_t            cbFilled;
-    /** */
-    uint32_t volatile   fReserved;
+    /** The read ahead generation this buffer was read for (parallel mode).
+     * Buffers from an older generation are stale and are discarded when the
+     * read completes. */
+    uint32_t            uGeneration;
     /** Pointer to the buffer. */
     uint8_t            *pbBuffer;
 } RTVFSREADAHEADBUFDESC;
@@ -101,6 +113,8 @@ typedef struct RTVFSREADAHEAD
     RTLISTANCHOR            ConsumerList;
     /** List of buffers available for the producer. */
     RTLISTANCHOR            FreeList;
+    /** List of buffers being read into by the workers (parallel mode). */
+    RTLISTANCHOR            InFlightList;
 
     /** The current file position from the consumer point of view. */
     uint64_t                offConsumer;
@@ -109,13 +123,56 @@ typedef struct RTVFSREADAHEAD
      *  set when reading past EOF.  */
     uint64_t                offEof;
 
-    /** The read ahead thread. */
+    /** The read ahead thread (the first worker in parallel mode). */
     RTTHREAD                hThread;
     /** Set when we want the thread to terminate. */
     bool volatile           fTerminateThread;
     /** Creation flags. */
     uint32_t                fFlags;
 
+    /** @name Parallel mode (RTVFSREADAHEAD_F_PARALLEL on a file).
+     * All but the event semaphores and thread handles are protected by
+     * BufferCritSect.
+     * @{ */
+    /** Set if we're using several workers doing positional reads. */
+    bool                    fParallel;
+    /** The number of worker threads (concurrent requests). */
+    uint32_t                cWorkers;
+    /** The file offset the workers will read ahead from next. */
+    uint64_t                offNextReadAhead;
+    /** Where a worker read failed, UINT64_MAX if none did.  The workers won't
+     * read beyond this until the consumer has passed it. */
+    uint64_t                offReadAheadError;
+    /** The current read ahead generation, incremented when the consumer jumps
+     * out of the read ahead window. */
+    uint32_t                uGeneration;
+    /** The current read ahead window size (in buffers): how far ahead of the
+     * consumer the workers may read.  Grows when the consumer stalls and
+     * shrinks when read ahead data is thrown away. */
+    uint32_t                cWindow;
+    /** Event semaphore the idle workers wait on. */
+    RTSEMEVENTMULTI         hEvtWork;
+    /** Event semaphore signalled when a worker completes a read, the consumer
+     * waits on this for in-flight buffers. */
+    RTSEMEVENTMULTI         hEvtDone;
+    /** The other worker threads. */
+    RTTHREAD                ahWorkers[RTVFSREADAHEAD_MAX_WORKERS - 1];
+    /** @} */
+
+    /** @name Statistics (protected by BufferCritSect).
+     * @{ */
+    /** Bytes returned from the read ahead buffers. */
+    uint64_t                cbStatHits;
+    /** Bytes read directly from the source by the consumer. */
+    uint64_t                cbStatDirect;
+    /** Number of times the consumer waited for an in-flight buffer. */
+    uint32_t                cStatStalls;
+    /** Number of buffers discarded without being consumed. */
+    uint32_t                cStatWasted;
+    /** The largest window size reached. */
+    uint32_t                cStatMaxWindow;
+    /** @} */
+
     /** The I/O stream we read from. */
     RTVFSIOSTREAM           hIos;
     /** The file face of hIos, if we're fronting for an actual file. */
@@ -134,6 +191,84 @@ typedef RTVFSREADAHEAD *PRTVFSREADAHEAD;
 
 
 
+/**
+ * Wakes up the read ahead thread(s) because there is more work for them.
+ *
+ * @param   pThis           The read ahead instance.
+ */
+static void rtVfsReadAheadPokeReader(PRTVFSREADAHEAD pThis)
+{
+    if (pThis->fParallel)
+        RTSemEventMultiSignal(pThis->hEvtWork);
+    else
+        RTThreadUserSignal(pThis->hThread);
+}
+
+
+/**
+ * Deals with the consumer moving out of the read ahead window in parallel
+ * mode, discarding the read ahead buffers and restarting at the new position.
+ *
+ * @param   pThis           The read ahead instance.
+ * @param   offNew          The new consumer position.
+ *
+ * @note    Caller owns BufferCritSect.
+ */
+static void rtVfsReadAheadParallelReposition(PRTVFSREADAHEAD pThis, uint64_t offNew)
+{
+    Assert(pThis->fParallel);
+
+    /* Nothing to do if the new position is within the data we've got or are
+       reading (small seeks, or the consumer stepping back a little). */
+    PRTVFSREADAHEADBUFDESC pFirst = RTListGetFirst(&pThis->ConsumerList, RTVFSREADAHEADBUFDESC, ListEntry);
+    uint64_t const offLow = pFirst ? pFirst->off : pThis->offConsumer;
+    if (offNew >= offLow && offNew <= pThis->offNextReadAhead)
+        return;
+
+    /* Everything we've got is useless now.  In-flight reads are marked stale
+       by the generation change and discarded by the workers upon completion. */
+    uint32_t cWasted = 0;
+    PRTVFSREADAHEADBUFDESC pBufDesc, pNextBufDesc;
+    RTListForEachSafe(&pThis->ConsumerList, pBufDesc, pNextBufDesc, RTVFSREADAHEADBUFDESC, ListEntry)
+    {
+        RTListNodeRemove(&pBufDesc->ListEntry);
+        RTListAppend(&pThis->FreeList, &pBufDesc->ListEntry);
+        cWasted++;
+    }
+    pThis->cStatWasted     += cWasted;
+    pThis->uGeneration     += 1;
+    pThis->offNextReadAhead = offNew;
+
+    /* Random-ish access, so be less aggressive. */
+    if (cWasted)
+        pThis->cWindow = RT_MAX(pThis->cWindow / 2, pThis->cWorkers);
+    Log(("rtVfsReadAheadParallelReposition: %#llx -> %#llx, wasted %u, window %u\n",
+         pThis->offConsumer, offNew, cWasted, pThis->cWindow));
+}
+
+
+/**
+ * Checks if there is an in-flight read covering the given offset.
+ *
+ * @returns true if there is, false if not.
+ * @param   pThis           The read ahead instance.
+ * @param   off             The offset.
+ *
+ * @note    Caller owns BufferCritSect.
+ */
+static bool rtVfsReadAheadParallelIsInFlight(PRTVFSREADAHEAD pThis, uint64_t off)
+{
+    PRTVFSREADAHEADBUFDESC pBufDesc;
+    RTListForEach(&pThis->InFlightList, pBufDesc, RTVFSREADAHEADBUFDESC, ListEntry)
+    {
+        if (   pBufDesc->uGeneration == pThis->uGeneration
+            && off - pBufDesc->off < pThis->cbBuffer)
+            return true;
+    }
+    return false;
+}
+
+
 /**
  * @interface_method_impl{RTVFSOBJOPS,pfnClose}
  */
@@ -143,18 +278,37 @@ static DECLCALLBACK(int) rtVfsReadAhead_Close(void *pvThis)
     int rc;
 
     /*
-     * Stop the read-ahead thread.
+     * Stop the read-ahead thread(s).
      */
-    if (pThis->hThread != NIL_RTTHREAD)
+    ASMAtomicWriteBool(&pThis->fTerminateThread, true);
+    if (pThis->fParallel)
     {
-        ASMAtomicWriteBool(&pThis->fTerminateThread, true);
-        rc = RTThreadUserSignal(pThis->hThread);
+        rc = RTSemEventMultiSignal(pThis->hEvtWork);
         AssertRC(rc);
+        for (uint32_t i = 0; i < RT_ELEMENTS(pThis->ahWorkers); i++)
+            if (pThis->ahWorkers[i] != NIL_RTTHREAD)
+            {
+                rc = RTThreadWait(pThis->ahWorkers[i], RT_INDEFINITE_WAIT, NULL);
+                AssertRCReturn(rc, rc);
+                pThis->ahWorkers[i] = NIL_RTTHREAD;
+            }
+    }
+    if (pThis->hThread != NIL_RTTHREAD)
+    {
+        if (!pThis->fParallel)
+        {
+            rc = RTThreadUserSignal(pThis->hThread);
+            AssertRC(rc);
+        }
         rc = RTThreadWait(pThis->hThread, RT_INDEFINITE_WAIT, NULL);
         AssertRCReturn(rc, rc);
         pThis->hThread = NIL_RTTHREAD;
     }
 
+    Log(("rtVfsReadAhead_Close: hits=%llu direct=%llu stalls=%u wasted=%u window=%u/%u (max %u)\n",
+         pThis->cbStatHits, pThis->cbStatDirect, pThis->cStatStalls, pThis->cStatWasted, pThis->cWindow,
+         pThis->cBuffers, pThis->cStatMaxWindow));
+
     /*
      * Release the upstream objects.
      */
@@ -179,10 +333,14 @@ static DECLCALLBACK(int) rtVfsReadAhead_Close(void *pvThis)
     RTCritSectLeave(&pThis->BufferCritSect);
 
     /*
-     * Destroy the critical sections.
+     * Destroy the critical sections and semaphores.
      */
     RTCritSectDelete(&pThis->BufferCritSect);
     RTCritSectDelete(&pThis->IoCritSect);
+    RTSemEventMultiDestroy(pThis->hEvtWork);
+    pThis->hEvtWork = NIL_RTSEMEVENTMULTI;
+    RTSemEventMultiDestroy(pThis->hEvtDone);
+    pThis->hEvtDone = NIL_RTSEMEVENTMULTI;
 
     return VINF_SUCCESS;
 }
@@ -228,7 +386,11 @@ static DECLCALLBACK(int) rtVfsReadAhead_Read(void *pvThis, RTFOFF off, PCRTSGBUF
         {
             offCur = (uint64_t)off;
             if (pThis->offConsumer != offCur)
+            {
                 fPokeReader = true; /* If the current position changed, poke it in case it stopped at EOF. */
+                if (pThis->fParallel)
+                    rtVfsReadAheadParallelReposition(pThis, offCur);
+            }
             pThis->offConsumer = offCur;
         }
 
@@ -250,6 +412,7 @@ static DECLCALLBACK(int) rtVfsReadAhead_Read(void *pvThis, RTFOFF off, PCRTSGBUF
                 cbDst              -= cbFromCurBuf;
                 cbTotalRead        += cbFromCurBuf;
                 offCur             += cbFromCurBuf;
+                pThis->cbStatHits  += cbFromCurBuf;
             }
 
             /* Discard buffers we've read past. */
@@ -283,6 +446,37 @@ static DECLCALLBACK(int) rtVfsReadAhead_Read(void *pvThis, RTFOFF off, PCRTSGBUF
         }
 
 
+        /*
+         * In parallel mode, wait for any worker currently reading the data we
+         * need rather than reading it a second time.  This means the window
+         * is too small for the consumption rate, so grow it.
+         */
+        if (pThis->fParallel && rtVfsReadAheadParallelIsInFlight(pThis, offCur))
+        {
+            pThis->cStatStalls++;
+            if (pThis->cWindow < pThis->cBuffers)
+            {
+                pThis->cWindow++;
+                pThis->cStatMaxWindow = RT_MAX(pThis->cStatMaxWindow, pThis->cWindow);
+                fPokeReader = true;
+            }
+            if (!fBlocking)
+            {
+                rc = VINF_TRY_AGAIN;
+                break;
+            }
+            RTSemEventMultiReset(pThis->hEvtDone);
+            RTCritSectLeave(&pThis->BufferCritSect);
+            if (fPokeReader)
+            {
+                RTSemEventMultiSignal(pThis->hEvtWork);
+                fPokeReader = false;
+            }
+            RTSemEventMultiWait(pThis->hEvtDone, RT_MS_1SEC);
+            RTCritSectEnter(&pThis->BufferCritSect);
+            continue;
+        }
+
         /*
          * First time around we don't own the I/O critsect and need to take it
          * and repeat the above buffer reading code.
@@ -300,7 +494,18 @@ static DECLCALLBACK(int) rtVfsReadAhead_Read(void *pvThis, RTFOFF off, PCRTSGBUF
         /*
          * Do a direct read of the remaining data.
          */
-        if (off == -1)
+        if (pThis->fParallel)
+        {
+            /* The workers don't maintain the source position.  A miss means
+               we're outrunning the workers too, so grow the window. */
+            off = offCur;
+            if (pThis->cWindow < pThis->cBuffers)
+            {
+                pThis->cWindow++;
+                pThis->cStatMaxWindow = RT_MAX(pThis->cStatMaxWindow, pThis->cWindow);
+            }
+        }
+        else if (off == -1)
         {
             RTFOFF offActual = RTVfsIoStrmTell(pThis->hIos);
             if (offActual >= 0 && (uint64_t)offActual != offCur)
@@ -315,7 +520,8 @@ static DECLCALLBACK(int) rtVfsReadAhead_Read(void *pvThis, RTFOFF off, PCRTSGBUF
         {
             cbTotalRead += cbThisRead;
             offCur      += cbThisRead;
-            pThis->offConsumer = offCur;
+            pThis->offConsumer   = offCur;
+            pThis->cbStatDirect += cbThisRead;
             if (rc != VINF_EOF)
                 fPokeReader = true;
             else
@@ -332,7 +538,7 @@ static DECLCALLBACK(int) rtVfsReadAhead_Read(void *pvThis, RTFOFF off, PCRTSGBUF
     if (fOwnsIoCritSect)
         RTCritSectLeave(&pThis->IoCritSect);
     if (fPokeReader && rc != VINF_EOF && rc != VERR_EOF)
-        RTThreadUserSignal(pThis->hThread);
+        rtVfsReadAheadPokeReader(pThis);
 
     if (pcbRead)
         *pcbRead = cbTotalRead;
@@ -459,10 +665,20 @@ static DECLCALLBACK(int) rtVfsReadAhead_Seek(void *pvThis, RTFOFF offSeek, unsig
     RTCritSectEnter(&pThis->IoCritSect);        /* protects against concurrent I/O using the offset. */
     RTCritSectEnter(&pThis->BufferCritSect);    /* protects offConsumer */
 
+    /* The source position is ahead of the consumer when reading ahead, so
+       make relative seeks relative to the consumer position. */
+    if (uMethod == RTFILE_SEEK_CURRENT)
+    {
+        offSeek += (RTFOFF)pThis->offConsumer;
+        uMethod  = RTFILE_SEEK_BEGIN;
+    }
+
     uint64_t offActual = UINT64_MAX;
     int rc = RTVfsFileSeek(pThis->hFile, offSeek, uMethod, &offActual);
     if (RT_SUCCESS(rc))
     {
+        if (pThis->fParallel && offActual != pThis->offConsumer)
+            rtVfsReadAheadParallelReposition(pThis, offActual);
         pThis->offConsumer = offActual;
         if (poffActual)
             *poffActual = offActual;
@@ -674,6 +890,102 @@ static DECLCALLBACK(int) rtVfsReadAheadThreadProc(RTTHREAD hThreadSelf, void *pv
 }
 
 
+/**
+ * @callback_method_impl{PFNRTTHREAD, Read ahead worker for parallel mode}
+ *
+ * Each worker claims a free buffer and the next offset in the read ahead
+ * window, and reads into it using a positional read without holding any
+ * locks, so up to RTVFSREADAHEAD::cWorkers reads are outstanding at a time.
+ */
+static DECLCALLBACK(int) rtVfsReadAheadWorkerProc(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PRTVFSREADAHEAD pThis = (PRTVFSREADAHEAD)pvUser;
+    Assert(pThis); RT_NOREF_PV(hThreadSelf);
+
+    RTCritSectEnter(&pThis->BufferCritSect);
+    while (!pThis->fTerminateThread)
+    {
+        /*
+         * Anything to read?  We stay within the window and stop at EOF.
+         */
+        if (pThis->offConsumer > pThis->offReadAheadError)
+            pThis->offReadAheadError = UINT64_MAX;
+        uint64_t const offRead = RT_MAX(pThis->offNextReadAhead, pThis->offConsumer);
+        if (   offRead < pThis->offEof
+            && offRead < pThis->offReadAheadError
+            && offRead - pThis->offConsumer < (uint64_t)pThis->cWindow * pThis->cbBuffer
+            && !RTListIsEmpty(&pThis->FreeList))
+        {
+            PRTVFSREADAHEADBUFDESC pBufDesc = RTListRemoveFirst(&pThis->FreeList, RTVFSREADAHEADBUFDESC, ListEntry);
+            pBufDesc->off           = offRead;
+            pBufDesc->cbFilled      = 0;
+            pBufDesc->uGeneration   = pThis->uGeneration;
+            RTListAppend(&pThis->InFlightList, &pBufDesc->ListEntry);
+            pThis->offNextReadAhead = offRead + pThis->cbBuffer;
+            RTCritSectLeave(&pThis->BufferCritSect);
+
+            size_t cbRead = 0;
+            int rc = RTVfsFileReadAt(pThis->hFile, (RTFOFF)offRead, pBufDesc->pbBuffer, pThis->cbBuffer, &cbRead);
+
+            RTCritSectEnter(&pThis->BufferCritSect);
+            RTListNodeRemove(&pBufDesc->ListEntry);
+            if (   RT_SUCCESS(rc)
+                && pBufDesc->uGeneration == pThis->uGeneration)
+            {
+                if (rc == VINF_EOF && offRead + cbRead < pThis->offEof)
+                {
+                    pThis->offEof = offRead + cbRead;
+                    Log(("rtVfsReadAheadWorkerProc: EOF %llu (%#llx)\n", pThis->offEof, pThis->offEof));
+                }
+                pBufDesc->cbFilled = (uint32_t)cbRead;
+            }
+            else
+                pBufDesc->cbFilled = 0;
+
+            if (pBufDesc->cbFilled && pBufDesc->off + pBufDesc->cbFilled > pThis->offConsumer)
+            {
+                /* Insert it into the sorted consumer list, usually at the end. */
+                PRTVFSREADAHEADBUFDESC pAfter = RTListGetLast(&pThis->ConsumerList, RTVFSREADAHEADBUFDESC, ListEntry);
+                while (pAfter && pAfter->off > pBufDesc->off)
+                    pAfter = RTListGetPrev(&pThis->ConsumerList, pAfter, RTVFSREADAHEADBUFDESC, ListEntry);
+                if (!pAfter)
+                    RTListPrepend(&pThis->ConsumerList, &pBufDesc->ListEntry);
+                else
+                    RTListNodeInsertAfter(&pAfter->ListEntry, &pBufDesc->ListEntry);
+            }
+            else
+            {
+                /* Stale, failed, past EOF or already passed by the consumer. */
+                if (pBufDesc->cbFilled || pBufDesc->uGeneration != pThis->uGeneration)
+                    pThis->cStatWasted++;
+                else if (RT_FAILURE(rc))
+                    Log(("rtVfsReadAheadWorkerProc: read at %#llx failed: %Rrc\n", offRead, rc));
+                RTListPrepend(&pThis->FreeList, &pBufDesc->ListEntry);
+
+                /* Leave it to the consumer to read (and fail) from here on, rather
+                   than retrying in a tight loop. */
+                if (RT_FAILURE(rc) && pBufDesc->uGeneration == pThis->uGeneration)
+                    pThis->offReadAheadError = RT_MIN(pThis->offReadAheadError, offRead);
+            }
+            RTSemEventMultiSignal(pThis->hEvtDone);
+            continue;
+        }
+
+        /*
+         * Wait for more to do.  The reset must be done while owning the
+         * critical section, or we could miss a wakeup.
+         */
+        RTSemEventMultiReset(pThis->hEvtWork);
+        RTCritSectLeave(&pThis->BufferCritSect);
+        RTSemEventMultiWait(pThis->hEvtWork, RT_MS_1MIN);
+        RTCritSectEnter(&pThis->BufferCritSect);
+    }
+    RTCritSectLeave(&pThis->BufferCritSect);
+
+    return VINF_SUCCESS;
+}
+
+
 static int rtVfsCreateReadAheadInstance(RTVFSIOSTREAM hVfsIosSrc, RTVFSFILE hVfsFileSrc, uint32_t fFlags,
                                         uint32_t cBuffers, uint32_t cbBuffer, PRTVFSIOSTREAM phVfsIos, PRTVFSFILE phVfsFile)
 {
@@ -681,14 +993,20 @@ static int rtVfsCreateReadAheadInstance(RTVFSIOSTREAM hVfsIosSrc, RTVFSFILE hVfs
      * Validate input a little.
      */
     int rc = VINF_SUCCESS;
+    AssertStmt(!(fFlags & ~RTVFSREADAHEAD_F_VALID_MASK), rc = VERR_INVALID_FLAGS);
+    bool const fParallel = (fFlags & RTVFSREADAHEAD_F_PARALLEL) && hVfsFileSrc != NIL_RTVFSFILE;
     AssertStmt(cBuffers < _4K, rc = VERR_OUT_OF_RANGE);
     if (cBuffers == 0)
-        cBuffers = 4;
+        cBuffers = fParallel ? 16 : 4;
     AssertStmt(cbBuffer <= _4M, rc = VERR_OUT_OF_RANGE);
     if (cbBuffer == 0)
-        cbBuffer = _256K / cBuffers;
+        cbBuffer = fParallel ? _128K : _256K / cBuffers;
     AssertStmt(cbBuffer * cBuffers < (ARCH_BITS < 64 ? _64M : _256M), rc = VERR_OUT_OF_RANGE);
-    AssertStmt(!fFlags, rc = VERR_INVALID_FLAGS);
+    uint32_t cWorkers = (fFlags & RTVFSREADAHEAD_F_REQS_MASK) >> RTVFSREADAHEAD_F_REQS_SHIFT;
+    AssertStmt(cWorkers <= RTVFSREADAHEAD_MAX_WORKERS, rc = VERR_OUT_OF_RANGE);
+    if (cWorkers == 0)
+        cWorkers = RTVFSREADAHEAD_DEFAULT_REQS;
+    cWorkers = fParallel ? RT_MIN(cWorkers, cBuffers) : 1;
 
     if (RT_SUCCESS(rc))
     {
@@ -709,6 +1027,7 @@ static int rtVfsCreateReadAheadInstance(RTVFSIOSTREAM hVfsIosSrc, RTVFSFILE hVfs
         {
             RTListInit(&pThis->ConsumerList);
             RTListInit(&pThis->FreeList);
+            RTListInit(&pThis->InFlightList);
             pThis->hThread          = NIL_RTTHREAD;
             pThis->fTerminateThread = false;
             pThis->fFlags           = fFlags;
@@ -718,11 +1037,30 @@ static int rtVfsCreateReadAheadInstance(RTVFSIOSTREAM hVfsIosSrc, RTVFSFILE hVfs
             pThis->cbBuffer         = cbBuffer;
             pThis->offEof           = UINT64_MAX;
             pThis->offConsumer      = RTVfsIoStrmTell(hVfsIosSrc);
+            pThis->fParallel        = fParallel;
+            pThis->cWorkers         = cWorkers;
+            pThis->offNextReadAhead = pThis->offConsumer;
+            pThis->offReadAheadError = UINT64_MAX;
+            pThis->uGeneration      = 0;
+            pThis->cWindow          = RT_MIN(cWorkers * 2, cBuffers);
+            pThis->hEvtWork         = NIL_RTSEMEVENTMULTI;
+            pThis->hEvtDone         = NIL_RTSEMEVENTMULTI;
+            for (uint32_t i = 0; i < RT_ELEMENTS(pThis->ahWorkers); i++)
+                pThis->ahWorkers[i] = NIL_RTTHREAD;
+            pThis->cbStatHits       = 0;
+            pThis->cbStatDirect     = 0;
+            pThis->cStatStalls      = 0;
+            pThis->cStatWasted      = 0;
+            pThis->cStatMaxWindow   = pThis->cWindow;
             if ((RTFOFF)pThis->offConsumer >= 0)
             {
                 rc = RTCritSectInit(&pThis->IoCritSect);
                 if (RT_SUCCESS(rc))
                     rc = RTCritSectInit(&pThis->BufferCritSect);
+                if (RT_SUCCESS(rc) && fParallel)
+                    rc = RTSemEventMultiCreate(&pThis->hEvtWork);
+                if (RT_SUCCESS(rc) && fParallel)
+                    rc = RTSemEventMultiCreate(&pThis->hEvtDone);
                 if (RT_SUCCESS(rc))
                 {
                     pThis->pbAllBuffers = (uint8_t *)RTMemPageAlloc(pThis->cbBuffer * pThis->cBuffers);
@@ -732,15 +1070,26 @@ static int rtVfsCreateReadAheadInstance(RTVFSIOSTREAM hVfsIosSrc, RTVFSFILE hVfs
                         {
                             pThis->aBufDescs[i].cbFilled = 0;
                             pThis->aBufDescs[i].off      = UINT64_MAX / 2;
+                            pThis->aBufDescs[i].uGeneration = 0;
                             pThis->aBufDescs[i].pbBuffer = &pThis->pbAllBuffers[cbBuffer * i];
                             RTListAppend(&pThis->FreeList, &pThis->aBufDescs[i].ListEntry);
                         }
 
                         /*
-                         * Create thread.
+                         * Create thread(s).  We can live with fewer workers than asked for.
                          */
-                        rc = RTThreadCreate(&pThis->hThread, rtVfsReadAheadThreadProc, pThis, 0, RTTHREADTYPE_DEFAULT,
-                                            RTTHREADFLAGS_WAITABLE, "vfsreadahead");
+                        rc = RTThreadCreate(&pThis->hThread, fParallel ? rtVfsReadAheadWorkerProc : rtVfsReadAheadThreadProc,
+                                            pThis, 0, RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "vfsreadahead");
+                        for (uint32_t i = 1; i < cWorkers && RT_SUCCESS(rc); i++)
+                        {
+                            int rc2 = RTThreadCreateF(&pThis->ahWorkers[i - 1], rtVfsReadAheadWorkerProc, pThis, 0,
+                                                      RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "vfsreadahead%u", i);
+                            if (RT_FAILURE(rc2))
+                            {
+                                Log(("rtVfsCreateReadAheadInstance: Failed to create worker #%u: %Rrc\n", i, rc2));
+                                break;
+                            }
+                        }
                         if (RT_SUCCESS(rc))
                         {
                             /*
@@ -813,3 +1162,26 @@ RTDECL(int) RTVfsCreateReadAheadForFile(RTVFSFILE hVfsFile, uint32_t fFlags, uin
     return rtVfsCreateReadAheadInstance(hVfsIos, hVfsFile, fFlags, cBuffers, cbBuffer, NULL, phVfsFile);
 }
 
+
+
+RTDECL(int) RTVfsReadAheadQueryStats(RTVFSIOSTREAM hVfsIos, PRTVFSREADAHEADSTATS pStats)
+{
+    AssertPtrReturn(pStats, VERR_INVALID_POINTER);
+    PRTVFSREADAHEAD pThis = (PRTVFSREADAHEAD)RTVfsIoStreamToPrivate(hVfsIos, &g_VfsReadAheadIosOps);
+    if (!pThis)
+        pThis = (PRTVFSREADAHEAD)RTVfsIoStreamToPrivate(hVfsIos, &g_VfsReadAheadFileOps.Stream);
+    AssertReturn(pThis, VERR_INVALID_HANDLE);
+
+    RTCritSectEnter(&pThis->BufferCritSect);
+    pStats->cbHits     = pThis->cbStatHits;
+    pStats->cbDirect   = pThis->cbStatDirect;
+    pStats->cStalls    = pThis->cStatStalls;
+    pStats->cWasted    = pThis->cStatWasted;
+    pStats->cWindow    = pThis->cWindow;
+    pStats->cMaxWindow = pThis->cStatMaxWindow;
+    pStats->cBuffers   = pThis->cBuffers;
+    pStats->cWorkers   = pThis->cWorkers;
+    pStats->fParallel  = pThis->fParallel;
+    RTCritSectLeave(&pThis->BufferCritSect);
+    return VINF_SUCCESS;
+}
@@ -34,7 +34,10 @@
 #include <iprt/assert.h>
 #include <iprt/file.h>
 #include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/mp.h>
 #include <iprt/poll.h>
+#include <iprt/req.h>
 #include <iprt/string.h>
 #include <iprt/vfslowlevel.h>
 
@@ -133,6 +136,23 @@ typedef RTZIPGZIPHDR const *PCRTZIPGZIPHDR;
 #define RTZIPGZIPHDR_OS_UNKNOWN         UINT8_C(0xff)
 /** @}  */
 
+/** @name Block-wise (BGZF style) compression, RTZIPGZIPDECOMP_F_PARALLEL.
+ * @{ */
+/** The extra subfield ID holding the compressed member size minus one. */
+#define RTZIPGZIP_BGZF_SI1              UINT8_C(0x42) /* 'B' */
+#define RTZIPGZIP_BGZF_SI2              UINT8_C(0x43) /* 'C' */
+/** The size of the gzip member trailer (CRC32 and ISIZE). */
+#define RTZIPGZIP_TRAILER_SIZE          8
+/** The max size of the extra field we look at when probing the input. */
+#define RTZIPGZIPPAR_MAX_XLEN           64
+/** The max uncompressed member size we accept. */
+#define RTZIPGZIPPAR_MAX_MEMBER_SIZE    _16M
+/** The max number of inflate worker threads. */
+#define RTZIPGZIPPAR_MAX_THREADS        8
+/** The number of members in flight per worker thread. */
+#define RTZIPGZIPPAR_BLOCKS_PER_THREAD  4
+/** @} */
+
 
 /**
  * The internal data of a GZIP I/O stream.
@@ -168,6 +188,69 @@ typedef struct RTZIPGZIPSTREAM
 typedef RTZIPGZIPSTREAM *PRTZIPGZIPSTREAM;
 
 
+/**
+ * A gzip member being inflated by the parallel decompressor.
+ */
+typedef struct RTZIPGZIPPARBLOCK
+{
+    /** The request handle, NIL_RTREQ if not queued or already reaped. */
+    PRTREQ              hReq;
+    /** The inflate status. */
+    int volatile        rc;
+    /** The size of the member. */
+    uint32_t            cbIn;
+    /** The uncompressed size (ISIZE). */
+    uint32_t            cbOut;
+    /** The size of the pbOut allocation. */
+    uint32_t            cbOutAlloc;
+    /** The whole member (header, compressed data, trailer), _64K bytes. */
+    uint8_t            *pbIn;
+    /** The uncompressed data. */
+    uint8_t            *pbOut;
+} RTZIPGZIPPARBLOCK;
+/** Pointer to a gzip member being inflated by the parallel decompressor. */
+typedef RTZIPGZIPPARBLOCK *PRTZIPGZIPPARBLOCK;
+
+/**
+ * The internal data of a parallel gzip decompression I/O stream.
+ *
+ * The input is read one member at a time and the members are handed to a
+ * request pool for inflating.  The blocks form a ring, iHead being the one
+ * the reader is consuming, so the output order is the input order.
+ */
+typedef struct RTZIPGZIPPARSTREAM
+{
+    /** The stream we're reading the compressed data from. */
+    RTVFSIOSTREAM       hVfsIos;
+    /** The request pool, NIL_RTREQPOOL if inflating on the reader thread. */
+    RTREQPOOL           hPool;
+    /** The stream offset for pfnTell, always the uncompressed data. */
+    RTFOFF              offStream;
+    /** Set when all the input has been read. */
+    bool                fEndOfInput;
+    /** Sticky error status from reading or inflating. */
+    int                 rcSticky;
+    /** The number of blocks in the ring. */
+    uint32_t            cBlocks;
+    /** The block the reader is consuming. */
+    uint32_t            iHead;
+    /** The number of blocks holding a member, starting at iHead. */
+    uint32_t            cBusy;
+    /** The read offset into the output of the head block. */
+    uint32_t            offBlock;
+    /** The number of bytes left in abPrefix. */
+    uint32_t            cbPrefix;
+    /** The read offset into abPrefix. */
+    uint32_t            offPrefix;
+    /** The start of the first member, consumed while probing the input. */
+    uint8_t             abPrefix[sizeof(RTZIPGZIPHDR) + 2 + RTZIPGZIPPAR_MAX_XLEN];
+    /** The block ring. */
+    RTZIPGZIPPARBLOCK   aBlocks[1];
+} RTZIPGZIPPARSTREAM;
+/** Pointer to the internal data of a parallel gzip decompression I/O stream. */
+typedef RTZIPGZIPPARSTREAM *PRTZIPGZIPPARSTREAM;
+
+
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
@@ -682,10 +765,534 @@ static RTVFSIOSTREAMOPS g_rtZipGzipOps =
 };
 
 
+/**
+ * Looks for the BGZF size subfield in a gzip extra field.
+ *
+ * @returns true if found, false if not.
+ * @param   pbExtra         The extra field (without XLEN).
+ * @param   cbExtra         The size of the extra field (XLEN).
+ * @param   pcbMember       Where to return the member size (BSIZE + 1).
+ */
+static bool rtZipGzipParFindBlockSize(uint8_t const *pbExtra, uint32_t cbExtra, uint32_t *pcbMember)
+{
+    while (cbExtra >= 4)
+    {
+        uint32_t const cbSub = RT_MAKE_U16(pbExtra[2], pbExtra[3]);
+        if (cbSub > cbExtra - 4)
+            break;
+        if (   pbExtra[0] == RTZIPGZIP_BGZF_SI1
+            && pbExtra[1] == RTZIPGZIP_BGZF_SI2
+            && cbSub == 2)
+        {
+            *pcbMember = (uint32_t)RT_MAKE_U16(pbExtra[4], pbExtra[5]) + 1;
+            return true;
+        }
+        pbExtra += 4 + cbSub;
+        cbExtra -= 4 + cbSub;
+    }
+    return false;
+}
+
+
+/**
+ * Reads from the input stream, consuming the probed prefix first.
+ *
+ * @returns IPRT status code, VINF_EOF if less than @a cbToRead bytes were read.
+ * @param   pThis           The parallel gzip stream instance data.
+ * @param   pvBuf           Where to put the bytes.
+ * @param   cbToRead        The number of bytes to read.
+ * @param   pcbRead         Where to return the number of bytes read.
+ */
+static int rtZipGzipPar_ReadInput(PRTZIPGZIPPARSTREAM pThis, void *pvBuf, size_t cbToRead, size_t *pcbRead)
+{
+    size_t cbRead = 0;
+    if (pThis->cbPrefix)
+    {
+        cbRead = RT_MIN(cbToRead, pThis->cbPrefix);
+        memcpy(pvBuf, &pThis->abPrefix[pThis->offPrefix], cbRead);
+        pThis->offPrefix += (uint32_t)cbRead;
+        pThis->cbPrefix  -= (uint32_t)cbRead;
+    }
+
+    int rc = VINF_SUCCESS;
+    if (cbRead < cbToRead)
+    {
+        size_t cbReadIn = 0;
+        rc = RTVfsIoStrmRead(pThis->hVfsIos, (uint8_t *)pvBuf + cbRead, cbToRead - cbRead, true /*fBlocking*/, &cbReadIn);
+        cbRead += cbReadIn;
+    }
+    *pcbRead = cbRead;
+    if (RT_SUCCESS(rc) && cbRead < cbToRead)
+        rc = VINF_EOF;
+    return rc;
+}
+
+
+/**
+ * Reads the next member into a block.
+ *
+ * @returns IPRT status code.
+ * @retval  VINF_EOF if there are no more members.
+ * @retval  VERR_ZIP_BAD_HEADER if the member isn't block-wise compressed.
+ * @retval  VERR_ZIP_CORRUPTED if the member is truncated or inconsistent.
+ * @param   pThis           The parallel gzip stream instance data.
+ * @param   pBlock          The block.
+ */
+static int rtZipGzipPar_ReadMember(PRTZIPGZIPPARSTREAM pThis, PRTZIPGZIPPARBLOCK pBlock)
+{
+    /*
+     * The fixed header and XLEN.
+     */
+    uint8_t *pbIn   = pBlock->pbIn;
+    size_t   cbRead = 0;
+    int rc = rtZipGzipPar_ReadInput(pThis, pbIn, sizeof(RTZIPGZIPHDR) + 2, &cbRead);
+    if (RT_FAILURE(rc))
+        return rc;
+    if (rc == VINF_EOF)
+        return cbRead == 0 ? VINF_EOF : VERR_ZIP_CORRUPTED;
+
+    PCRTZIPGZIPHDR pHdr = (PCRTZIPGZIPHDR)pbIn;
+    if (   pHdr->bId1 != RTZIPGZIPHDR_ID1
+        || pHdr->bId2 != RTZIPGZIPHDR_ID2
+        || pHdr->bCompressionMethod != RTZIPGZIPHDR_CM_DEFLATE
+        || (pHdr->fFlags & ~RTZIPGZIPHDR_FLG_VALID_MASK)
+        || !(pHdr->fFlags & RTZIPGZIPHDR_FLG_EXTRA))
+        return VERR_ZIP_BAD_HEADER;
+
+    /*
+     * The extra field with the member size, then the rest of the member.
+     */
+    uint32_t const offExtra = sizeof(RTZIPGZIPHDR) + 2;
+    uint32_t const cbExtra  = RT_MAKE_U16(pbIn[sizeof(RTZIPGZIPHDR)], pbIn[sizeof(RTZIPGZIPHDR) + 1]);
+    if (offExtra + cbExtra + RTZIPGZIP_TRAILER_SIZE > _64K)
+        return VERR_ZIP_CORRUPTED;
+    rc = rtZipGzipPar_ReadInput(pThis, &pbIn[offExtra], cbExtra, &cbRead);
+    if (rc != VINF_SUCCESS)
+        return RT_FAILURE(rc) ? rc : VERR_ZIP_CORRUPTED;
+
+    uint32_t cbMember = 0;
+    if (!rtZipGzipParFindBlockSize(&pbIn[offExtra], cbExtra, &cbMember))
+        return VERR_ZIP_BAD_HEADER;
+    if (cbMember < offExtra + cbExtra + RTZIPGZIP_TRAILER_SIZE)
+        return VERR_ZIP_CORRUPTED;
+
+    rc = rtZipGzipPar_ReadInput(pThis, &pbIn[offExtra + cbExtra], cbMember - offExtra - cbExtra, &cbRead);
+    if (rc != VINF_SUCCESS)
+        return RT_FAILURE(rc) ? rc : VERR_ZIP_CORRUPTED;
+    pBlock->cbIn = cbMember;
+
+    /*
+     * Size the output buffer according to ISIZE.
+     */
+    uint32_t const cbOut = RT_MAKE_U32_FROM_U8(pbIn[cbMember - 4], pbIn[cbMember - 3], pbIn[cbMember - 2], pbIn[cbMember - 1]);
+    if (cbOut > RTZIPGZIPPAR_MAX_MEMBER_SIZE)
+        return VERR_ZIP_CORRUPTED;
+    if (cbOut > pBlock->cbOutAlloc)
+    {
+        void *pvNew = RTMemRealloc(pBlock->pbOut, cbOut);
+        if (!pvNew)
+            return VERR_NO_MEMORY;
+        pBlock->pbOut      = (uint8_t *)pvNew;
+        pBlock->cbOutAlloc = cbOut;
+    }
+    pBlock->cbOut = cbOut;
+    pBlock->rc    = VINF_SUCCESS;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Inflates a member, called on a request pool thread.
+ *
+ * The header has been partially validated by rtZipGzipPar_ReadMember.
+ *
+ * @param   pBlock          The block.
+ */
+static DECLCALLBACK(void) rtZipGzipParInflateWorker(PRTZIPGZIPPARBLOCK pBlock)
+{
+    uint8_t const *pbIn  = pBlock->pbIn;
+    uint32_t const cbIn  = pBlock->cbIn;
+    uint8_t const  fFlg  = ((PCRTZIPGZIPHDR)pbIn)->fFlags;
+    uint32_t       off   = sizeof(RTZIPGZIPHDR) + 2 + RT_MAKE_U16(pbIn[sizeof(RTZIPGZIPHDR)], pbIn[sizeof(RTZIPGZIPHDR) + 1]);
+    uint32_t const cbEnd = cbIn - RTZIPGZIP_TRAILER_SIZE;
+
+    /* Skip the optional name, comment and header CRC. */
+    if (fFlg & RTZIPGZIPHDR_FLG_NAME)
+    {
+        while (off < cbEnd && pbIn[off] != '\0')
+            off++;
+        off++;
+    }
+    if (fFlg & RTZIPGZIPHDR_FLG_COMMENT)
+    {
+        while (off < cbEnd && pbIn[off] != '\0')
+            off++;
+        off++;
+    }
+    if (fFlg & RTZIPGZIPHDR_FLG_HDR_CRC)
+        off += 2;
+    if (off > cbEnd)
+    {
+        pBlock->rc = VERR_ZIP_CORRUPTED;
+        return;
+    }
+
+    /* Raw inflate straight into the output buffer. */
+    z_stream Zlib;
+    RT_ZERO(Zlib);
+    int rcZlib = inflateInit2(&Zlib, -MAX_WBITS);
+    if (rcZlib != Z_OK)
+    {
+        pBlock->rc = rcZlib == Z_MEM_ERROR ? VERR_ZIP_NO_MEMORY : VERR_ZIP_ERROR;
+        return;
+    }
+    /* An empty member (e.g. the BGZF EOF block) may come without an output
+       buffer, but zlib insists on a non-NULL next_out. */
+    uint8_t bDummy;
+    Zlib.next_in   = (Bytef *)&pbIn[off];
+    Zlib.avail_in  = cbEnd - off;
+    Zlib.next_out  = pBlock->cbOut ? pBlock->pbOut : &bDummy;
+    Zlib.avail_out = pBlock->cbOut;
+    rcZlib = inflate(&Zlib, Z_FINISH);
+    uint32_t const cbProduced = (uint32_t)Zlib.total_out;
+    inflateEnd(&Zlib);
+
+    int rc;
+    if (rcZlib == Z_STREAM_END && cbProduced == pBlock->cbOut)
+    {
+        uint32_t const uCrc32 = RT_MAKE_U32_FROM_U8(pbIn[cbEnd], pbIn[cbEnd + 1], pbIn[cbEnd + 2], pbIn[cbEnd + 3]);
+        uint32_t const uCrc32Calc = pBlock->cbOut ? (uint32_t)crc32(crc32(0, NULL, 0), pBlock->pbOut, pBlock->cbOut) : 0;
+        if (uCrc32Calc == uCrc32)
+            rc = VINF_SUCCESS;
+        else
+            rc = VERR_ZIP_CORRUPTED;
+    }
+    else if (rcZlib == Z_MEM_ERROR)
+        rc = VERR_ZIP_NO_MEMORY;
+    else
+        rc = VERR_ZIP_CORRUPTED;
+    pBlock->rc = rc;
+}
+
+
+/**
+ * Reads members into the free blocks and queues them for inflating.
+ *
+ * @param   pThis           The parallel gzip stream instance data.
+ */
+static void rtZipGzipPar_Fill(PRTZIPGZIPPARSTREAM pThis)
+{
+    while (   pThis->cBusy < pThis->cBlocks
+           && !pThis->fEndOfInput
+           && RT_SUCCESS(pThis->rcSticky))
+    {
+        PRTZIPGZIPPARBLOCK pBlock = &pThis->aBlocks[(pThis->iHead + pThis->cBusy) % pThis->cBlocks];
+        Assert(pBlock->hReq == NIL_RTREQ);
+        int rc = rtZipGzipPar_ReadMember(pThis, pBlock);
+        if (rc != VINF_SUCCESS)
+        {
+            if (rc == VINF_EOF)
+                pThis->fEndOfInput = true;
+            else
+                pThis->rcSticky = rc;
+            break;
+        }
+
+        if (pThis->hPool != NIL_RTREQPOOL)
+        {
+            rc = RTReqPoolCallEx(pThis->hPool, 0 /*cMillies*/, &pBlock->hReq, RTREQFLAGS_VOID,
+                                 (PFNRT)rtZipGzipParInflateWorker, 1, pBlock);
+            if (rc != VINF_SUCCESS && rc != VERR_TIMEOUT)
+            {
+                pBlock->hReq = NIL_RTREQ;
+                rtZipGzipParInflateWorker(pBlock);
+            }
+        }
+        else
+            rtZipGzipParInflateWorker(pBlock);
+        pThis->cBusy++;
+    }
+}
+
+
+/**
+ * Waits for the head block to be inflated.
+ *
+ * @param   pBlock          The block.
+ */
+static void rtZipGzipPar_WaitBlock(PRTZIPGZIPPARBLOCK pBlock)
+{
+    if (pBlock->hReq != NIL_RTREQ)
+    {
+        RTReqWait(pBlock->hReq, RT_INDEFINITE_WAIT);
+        RTReqRelease(pBlock->hReq);
+        pBlock->hReq = NIL_RTREQ;
+    }
+}
+
+
+/**
+ * @interface_method_impl{RTVFSOBJOPS,pfnClose}
+ */
+static DECLCALLBACK(int) rtZipGzipPar_Close(void *pvThis)
+{
+    PRTZIPGZIPPARSTREAM pThis = (PRTZIPGZIPPARSTREAM)pvThis;
+
+    for (uint32_t i = 0; i < pThis->cBlocks; i++)
+    {
+        rtZipGzipPar_WaitBlock(&pThis->aBlocks[i]);
+        RTMemFree(pThis->aBlocks[i].pbIn);
+        pThis->aBlocks[i].pbIn = NULL;
+        RTMemFree(pThis->aBlocks[i].pbOut);
+        pThis->aBlocks[i].pbOut = NULL;
+    }
+    pThis->cBusy = 0;
+
+    RTReqPoolRelease(pThis->hPool);
+    pThis->hPool = NIL_RTREQPOOL;
+    RTVfsIoStrmRelease(pThis->hVfsIos);
+    pThis->hVfsIos = NIL_RTVFSIOSTREAM;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * @interface_method_impl{RTVFSOBJOPS,pfnQueryInfo}
+ */
+static DECLCALLBACK(int) rtZipGzipPar_QueryInfo(void *pvThis, PRTFSOBJINFO pObjInfo, RTFSOBJATTRADD enmAddAttr)
+{
+    PRTZIPGZIPPARSTREAM pThis = (PRTZIPGZIPPARSTREAM)pvThis;
+    return RTVfsIoStrmQueryInfo(pThis->hVfsIos, pObjInfo, enmAddAttr);
+}
+
+
+/**
+ * @interface_method_impl{RTVFSIOSTREAMOPS,pfnRead}
+ *
+ * @remarks Always blocks, the reading and inflating is done in whole members.
+ */
+static DECLCALLBACK(int) rtZipGzipPar_Read(void *pvThis, RTFOFF off, PCRTSGBUF pSgBuf, bool fBlocking, size_t *pcbRead)
+{
+    PRTZIPGZIPPARSTREAM pThis = (PRTZIPGZIPPARSTREAM)pvThis;
+    RT_NOREF_PV(fBlocking);
+
+    Assert(pSgBuf->cSegs == 1);
+    AssertReturn(off == -1 || off == pThis->offStream , VERR_INVALID_PARAMETER);
+
+    uint8_t *pbDst    = (uint8_t *)pSgBuf->paSegs[0].pvSeg;
+    size_t   cbToRead = pSgBuf->paSegs[0].cbSeg;
+    size_t   cbRead   = 0;
+    int      rc       = VINF_SUCCESS;
+    while (cbToRead > 0)
+    {
+        rtZipGzipPar_Fill(pThis);
+        if (!pThis->cBusy)
+        {
+            if (RT_FAILURE(pThis->rcSticky))
+                rc = pThis->rcSticky;
+            else
+                rc = pcbRead ? VINF_EOF : VERR_EOF;
+            break;
+        }
+
+        PRTZIPGZIPPARBLOCK pBlock = &pThis->aBlocks[pThis->iHead];
+        rtZipGzipPar_WaitBlock(pBlock);
+        if (RT_FAILURE(pBlock->rc))
+        {
+            /* Deliver what's been inflated so far, fail the next call. */
+            pThis->rcSticky = pBlock->rc;
+            rc = pBlock->rc;
+            break;
+        }
+
+        size_t const cbCopy = RT_MIN(pBlock->cbOut - pThis->offBlock, cbToRead);
+        if (cbCopy)
+            memcpy(pbDst, &pBlock->pbOut[pThis->offBlock], cbCopy);
+        pbDst           += cbCopy;
+        cbToRead        -= cbCopy;
+        cbRead          += cbCopy;
+        pThis->offBlock += (uint32_t)cbCopy;
+        if (pThis->offBlock >= pBlock->cbOut)
+        {
+            pThis->offBlock = 0;
+            pThis->iHead    = (pThis->iHead + 1) % pThis->cBlocks;
+            pThis->cBusy--;
+        }
+    }
+
+    pThis->offStream += cbRead;
+    if (pcbRead)
+    {
+        *pcbRead = cbRead;
+        if (RT_FAILURE(rc) && cbRead > 0)
+            rc = VINF_SUCCESS;
+    }
+    return rc;
+}
+
+
+/**
+ * @interface_method_impl{RTVFSIOSTREAMOPS,pfnWrite}
+ */
+static DECLCALLBACK(int) rtZipGzipPar_Write(void *pvThis, RTFOFF off, PCRTSGBUF pSgBuf, bool fBlocking, size_t *pcbWritten)
+{
+    RT_NOREF(pvThis, off, pSgBuf, fBlocking, pcbWritten);
+    return VERR_ACCESS_DENIED;
+}
+
+
+/**
+ * @interface_method_impl{RTVFSIOSTREAMOPS,pfnFlush}
+ */
+static DECLCALLBACK(int) rtZipGzipPar_Flush(void *pvThis)
+{
+    RT_NOREF_PV(pvThis);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * @interface_method_impl{RTVFSIOSTREAMOPS,pfnPollOne}
+ */
+static DECLCALLBACK(int) rtZipGzipPar_PollOne(void *pvThis, uint32_t fEvents, RTMSINTERVAL cMillies, bool fIntr,
+                                              uint32_t *pfRetEvents)
+{
+    PRTZIPGZIPPARSTREAM pThis = (PRTZIPGZIPPARSTREAM)pvThis;
+
+    uint32_t fRetEvents = 0;
+    if (RT_FAILURE(pThis->rcSticky))
+        fRetEvents |= RTPOLL_EVT_ERROR;
+    fEvents &= ~RTPOLL_EVT_WRITE;
+    if (pThis->cBusy > 0)
+        fRetEvents |= RTPOLL_EVT_READ;
+
+    int rc = VINF_SUCCESS;
+    fRetEvents &= fEvents;
+    if (!fRetEvents)
+        rc = RTVfsIoStrmPoll(pThis->hVfsIos, fEvents, cMillies, fIntr, pfRetEvents);
+    else
+        *pfRetEvents = fRetEvents;
+    return rc;
+}
+
+
+/**
+ * @interface_method_impl{RTVFSIOSTREAMOPS,pfnTell}
+ */
+static DECLCALLBACK(int) rtZipGzipPar_Tell(void *pvThis, PRTFOFF poffActual)
+{
+    PRTZIPGZIPPARSTREAM pThis = (PRTZIPGZIPPARSTREAM)pvThis;
+    *poffActual = pThis->offStream;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * The parallel GZIP decompression I/O stream vtable.
+ */
+static RTVFSIOSTREAMOPS g_rtZipGzipParOps =
+{
+    { /* Obj */
+        RTVFSOBJOPS_VERSION,
+        RTVFSOBJTYPE_IO_STREAM,
+        "gzip-parallel",
+        rtZipGzipPar_Close,
+        rtZipGzipPar_QueryInfo,
+        RTVFSOBJOPS_VERSION
+    },
+    RTVFSIOSTREAMOPS_VERSION,
+    RTVFSIOSTREAMOPS_FEAT_NO_SG,
+    rtZipGzipPar_Read,
+    rtZipGzipPar_Write,
+    rtZipGzipPar_Flush,
+    rtZipGzipPar_PollOne,
+    rtZipGzipPar_Tell,
+    NULL /* Skip */,
+    NULL /*ZeroFill*/,
+    RTVFSIOSTREAMOPS_VERSION,
+};
+
+
+/**
+ * Creates the parallel decompression stream for block-wise compressed input.
+ *
+ * @returns IPRT status code.
+ * @param   hVfsIosIn           The compressed input stream, a reference is
+ *                              retained on success.
+ * @param   pabPrefix           The start of the first member, already read
+ *                              from @a hVfsIosIn while probing.
+ * @param   cbPrefix            The number of bytes at @a pabPrefix.
+ * @param   phVfsIosOut         Where to return the decompression stream.
+ */
+static int rtZipGzipParCreate(RTVFSIOSTREAM hVfsIosIn, uint8_t const *pabPrefix, uint32_t cbPrefix,
+                              PRTVFSIOSTREAM phVfsIosOut)
+{
+    /*
+     * Leave one CPU for the reader and the consumer.  With only one CPU
+     * the members are inflated on the reader thread.
+     */
+    uint32_t const cCpus    = RTMpGetOnlineCount();
+    uint32_t const cThreads = RT_MIN(cCpus > 1 ? cCpus - 1 : 0, RTZIPGZIPPAR_MAX_THREADS);
+    uint32_t const cBlocks  = RT_MAX(cThreads, 1) * RTZIPGZIPPAR_BLOCKS_PER_THREAD;
+
+    RTVFSIOSTREAM       hVfsIos;
+    PRTZIPGZIPPARSTREAM pThis;
+    int rc = RTVfsNewIoStream(&g_rtZipGzipParOps, RT_OFFSETOF(RTZIPGZIPPARSTREAM, aBlocks[cBlocks]), RTFILE_O_READ,
+                              NIL_RTVFS, NIL_RTVFSLOCK, &hVfsIos, (void **)&pThis);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    pThis->hVfsIos     = hVfsIosIn;
+    RTVfsIoStrmRetain(hVfsIosIn);
+    pThis->hPool       = NIL_RTREQPOOL;
+    pThis->offStream   = 0;
+    pThis->fEndOfInput = false;
+    pThis->rcSticky    = VINF_SUCCESS;
+    pThis->cBlocks     = cBlocks;
+    pThis->iHead       = 0;
+    pThis->cBusy       = 0;
+    pThis->offBlock    = 0;
+    pThis->offPrefix   = 0;
+    pThis->cbPrefix    = cbPrefix;
+    Assert(cbPrefix <= sizeof(pThis->abPrefix));
+    memcpy(pThis->abPrefix, pabPrefix, cbPrefix);
+    for (uint32_t i = 0; i < cBlocks; i++)
+    {
+        pThis->aBlocks[i].hReq       = NIL_RTREQ;
+        pThis->aBlocks[i].rc         = VINF_SUCCESS;
+        pThis->aBlocks[i].cbIn       = 0;
+        pThis->aBlocks[i].cbOut      = 0;
+        pThis->aBlocks[i].cbOutAlloc = 0;
+        pThis->aBlocks[i].pbOut      = NULL;
+        pThis->aBlocks[i].pbIn       = (uint8_t *)RTMemAlloc(_64K);
+        if (!pThis->aBlocks[i].pbIn)
+            rc = VERR_NO_MEMORY;
+    }
+
+    if (RT_SUCCESS(rc) && cThreads > 0)
+    {
+        rc = RTReqPoolCreate(cThreads, RT_MS_1SEC, cThreads, 0 /*cMsMaxPushBack*/, "GzipInflate", &pThis->hPool);
+        if (RT_FAILURE(rc))
+        {
+            pThis->hPool = NIL_RTREQPOOL;
+            rc = VINF_SUCCESS;
+        }
+    }
+
+    if (RT_SUCCESS(rc))
+    {
+        *phVfsIosOut = hVfsIos;
+        return VINF_SUCCESS;
+    }
+    RTVfsIoStrmRelease(hVfsIos);
+    return rc;
+}
+
+
 RTDECL(int) RTZipGzipDecompressIoStream(RTVFSIOSTREAM hVfsIosIn, uint32_t fFlags, PRTVFSIOSTREAM phVfsIosOut)
 {
     AssertPtrReturn(hVfsIosIn, VERR_INVALID_HANDLE);
-    AssertReturn(!(fFlags & ~RTZIPGZIPDECOMP_F_ALLOW_ZLIB_HDR), VERR_INVALID_PARAMETER);
+    AssertReturn(!(fFlags & ~(RTZIPGZIPDECOMP_F_ALLOW_ZLIB_HDR | RTZIPGZIPDECOMP_F_PARALLEL)), VERR_INVALID_PARAMETER);
     AssertPtrReturn(phVfsIosOut, VERR_INVALID_POINTER);
 
     uint32_t cRefs = RTVfsIoStrmRetain(hVfsIosIn);
@@ -750,6 +1357,40 @@ RTDECL(int) RTZipGzipDecompressIoStream(RTVFSIOSTREAM hVfsIosIn, uint32_t fFlags
                     if (pHdr)
                     {
                         pThis->Hdr = *pHdr;
+
+                        /*
+                         * Block-wise compressed input can be inflated member
+                         * by member in parallel.  Peek at the extra field for
+                         * the member size, leaving whatever we read in the
+                         * input buffer for zlib in case we don't use it.
+                         */
+                        if (   (fFlags & RTZIPGZIPDECOMP_F_PARALLEL)
+                            && (pHdr->fFlags & RTZIPGZIPHDR_FLG_EXTRA))
+                        {
+                            uint8_t *pbXLen = &pThis->abBuffer[sizeof(RTZIPGZIPHDR)];
+                            rc = RTVfsIoStrmRead(pThis->hVfsIos, pbXLen, 2, true /*fBlocking*/, NULL /*pcbRead*/);
+                            if (RT_SUCCESS(rc))
+                            {
+                                pThis->Zlib.avail_in += 2;
+                                uint32_t const cbExtra = RT_MAKE_U16(pbXLen[0], pbXLen[1]);
+                                if (cbExtra <= RTZIPGZIPPAR_MAX_XLEN)
+                                {
+                                    rc = RTVfsIoStrmRead(pThis->hVfsIos, &pbXLen[2], cbExtra, true /*fBlocking*/, NULL);
+                                    if (RT_SUCCESS(rc))
+                                    {
+                                        pThis->Zlib.avail_in += cbExtra;
+                                        uint32_t cbMember;
+                                        if (rtZipGzipParFindBlockSize(&pbXLen[2], cbExtra, &cbMember))
+                                        {
+                                            rc = rtZipGzipParCreate(hVfsIosIn, pThis->abBuffer, pThis->Zlib.avail_in, phVfsIosOut);
+                                            RTVfsIoStrmRelease(hVfsIos);
+                                            return rc;
+                                        }
+                                    }
+                                }
+                            }
+                        }
+
                         /* Parse on if there are names or comments. */
                         if (pHdr->fFlags & (RTZIPGZIPHDR_FLG_NAME | RTZIPGZIPHDR_FLG_COMMENT))
                         {
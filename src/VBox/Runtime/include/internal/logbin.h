@@ -0,0 +1,231 @@
+/* $Id$ */
+/** @file
+ * IPRT - Internal header for the binary log format (RTLOGFLAGS_BINARY).
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+#ifndef ___internal_logbin_h
+#define ___internal_logbin_h
+
+#include <iprt/types.h>
+#include <iprt/assert.h>
+#include <iprt/stdarg.h>
+
+RT_C_DECLS_BEGIN
+
+/** @page pg_rt_log_bin     Binary Log Format
+ *
+ * With RTLOGFLAGS_BINARY set, the logger doesn't format the messages going
+ * to the log file.  Instead it records the format string address, the group,
+ * the flags, a timestamp, the thread and the raw arguments, leaving the
+ * formatting to RTLogBinDecodeFile() (and the RTLogDecode tool).
+ *
+ * The file is a sequence of records (RTLOGBINREC) interleaved with ordinary
+ * text, the latter comes from messages that could not be recorded in binary
+ * form (unsupported format types, huge strings) and from loggers writing to
+ * the file before binary mode was enabled.  Every record starts with
+ * RTLOGBINREC_MAGIC, which begins with a byte that cannot occur in UTF-8
+ * text, so the decoder simply passes thru everything up to the next magic.
+ *
+ * The first record after the file has been opened is a header record
+ * (RTLOGBINHDR) with the group names and the ABI parameters the arguments
+ * were recorded with.  A format string is defined by a RTLOGBINFMT record
+ * before the first message record referring to it.  Format strings are keyed
+ * by their address, so a key may be redefined if a format buffer is reused,
+ * the decoder always uses the most recent definition.
+ *
+ * The arguments of a message record are stored back to back in the order
+ * the format string consumes them, without any tags, so they can only be
+ * decoded by walking the format string with rtLogBinParseSpec():
+ *      - '*' width and precision: int32_t.
+ *      - Integers, characters and pointers: 4 or 8 bytes, the size of the
+ *        argument after default promotion (RTLOGBINSPEC::cbValue).
+ *      - Strings: uint16_t length followed by that many bytes of the string,
+ *        already truncated to the precision and without terminator.
+ *
+ * All values are stored in host byte order, decoding is only supported on a
+ * host with the same ABI parameters as the one producing the log.  Records
+ * are not aligned in any way, so they must be accessed using memcpy.
+ */
+
+/** The magic value at the start of each record.
+ * The bytes are 0xfe 'L' 'b' 'R' in memory on little endian hosts. */
+#define RTLOGBINREC_MAGIC           UINT32_C(0x52624cfe)
+
+/** @name Record types (RTLOGBINREC::u16Type).
+ * @{ */
+/** RTLOGBINHDR. */
+#define RTLOGBINREC_TYPE_HDR        UINT16_C(1)
+/** RTLOGBINFMT. */
+#define RTLOGBINREC_TYPE_FMT        UINT16_C(2)
+/** RTLOGBINMSG. */
+#define RTLOGBINREC_TYPE_MSG        UINT16_C(3)
+/** @} */
+
+/** The max size of the argument area of a RTLOGBINMSG record.  Messages with
+ * more argument data than this are formatted as text. */
+#define RTLOGBIN_MAX_ARGS           _4K
+
+/**
+ * The common record header.
+ */
+typedef struct RTLOGBINREC
+{
+    /** RTLOGBINREC_MAGIC. */
+    uint32_t            u32Magic;
+    /** The record type (RTLOGBINREC_TYPE_XXX). */
+    uint16_t            u16Type;
+    /** Reserved, zero. */
+    uint16_t            u16Reserved;
+    /** The size of the record, including this header. */
+    uint32_t            cbRec;
+} RTLOGBINREC;
+AssertCompileSize(RTLOGBINREC, 12);
+
+/** The current RTLOGBINHDR::u32Version value. */
+#define RTLOGBINHDR_VERSION         UINT32_C(0x00010000)
+
+/**
+ * The header record, RTLOGBINREC_TYPE_HDR.
+ *
+ * Followed by RTLOGBINHDR::cGroups zero terminated group names.
+ */
+typedef struct RTLOGBINHDR
+{
+    /** The common record header. */
+    RTLOGBINREC         Core;
+    /** The format version (RTLOGBINHDR_VERSION). */
+    uint32_t            u32Version;
+    /** sizeof(void *) of the producer. */
+    uint8_t             cbPtr;
+    /** sizeof(long) of the producer. */
+    uint8_t             cbLong;
+    /** Set if the producer is big endian. */
+    uint8_t             fBigEndian;
+    /** Reserved, zero. */
+    uint8_t             bReserved;
+    /** The number of group names following the header. */
+    uint32_t            cGroups;
+    /** The process ID of the producer. */
+    uint32_t            uPid;
+    /** Reserved, zero. */
+    uint32_t            u32Reserved;
+    /** RTTimeNanoTS() when the header was written. */
+    uint64_t            nsStart;
+    /** The UTC time when the header was written (nanoseconds since the epoch). */
+    int64_t             nsStartUtc;
+    /** RTTimeProgramNanoTS() when the header was written. */
+    uint64_t            nsStartProg;
+} RTLOGBINHDR;
+AssertCompileSize(RTLOGBINHDR, 56);
+
+/**
+ * The format string record, RTLOGBINREC_TYPE_FMT.
+ *
+ * Followed by the zero terminated format string.
+ */
+typedef struct RTLOGBINFMT
+{
+    /** The common record header. */
+    RTLOGBINREC         Core;
+    /** Reserved, zero. */
+    uint32_t            u32Reserved;
+    /** The format string key (its address in the producer). */
+    uint64_t            uKey;
+} RTLOGBINFMT;
+AssertCompileSize(RTLOGBINFMT, 24);
+
+/**
+ * The message record, RTLOGBINREC_TYPE_MSG.
+ *
+ * Followed by the arguments.
+ */
+typedef struct RTLOGBINMSG
+{
+    /** The common record header. */
+    RTLOGBINREC         Core;
+    /** The group, UINT32_MAX for ~0U. */
+    uint32_t            iGroup;
+    /** The format string key. */
+    uint64_t            uFmtKey;
+    /** RTTimeNanoTS() of the message. */
+    uint64_t            nsTS;
+    /** The native thread handle of the logging thread. */
+    uint64_t            idThread;
+    /** The logging flags (RTLOGGRPFLAGS_XXX). */
+    uint32_t            fFlags;
+    /** Reserved, zero. */
+    uint32_t            u32Reserved;
+} RTLOGBINMSG;
+AssertCompileSize(RTLOGBINMSG, 48);
+
+
+/** @name Conversion kinds (RTLOGBINSPEC::enmKind).
+ * @{ */
+/** Not a conversion: '%%'. */
+#define RTLOGBINSPEC_KIND_PERCENT   1
+/** Integer conversion (incl. '%c', '%p' and the integer '%R' types). */
+#define RTLOGBINSPEC_KIND_INT       2
+/** Narrow string, '%s'. */
+#define RTLOGBINSPEC_KIND_STR       3
+/** @} */
+
+/**
+ * A parsed conversion specification.
+ */
+typedef struct RTLOGBINSPEC
+{
+    /** The flag characters following the '%'. */
+    const char         *pchFlags;
+    /** The number of flag characters. */
+    uint8_t             cchFlags;
+    /** The number of characters of the conversion proper (size modifiers
+     * and type) at pchConv. */
+    uint8_t             cchConv;
+    /** The conversion kind (RTLOGBINSPEC_KIND_XXX). */
+    uint8_t             enmKind;
+    /** The argument size for RTLOGBINSPEC_KIND_INT, 4 or 8. */
+    uint8_t             cbValue;
+    /** Whether the width is taken from the arguments. */
+    bool                fWidthArg;
+    /** Whether the precision is taken from the arguments. */
+    bool                fPrecisionArg;
+    /** Whether there is a precision. */
+    bool                fPrecision;
+    /** The fixed width, -1 if none. */
+    int32_t             cchWidth;
+    /** The fixed precision, -1 if none. */
+    int32_t             cchPrecision;
+    /** The conversion proper (size modifiers and type). */
+    const char         *pchConv;
+} RTLOGBINSPEC;
+/** Pointer to a parsed conversion specification. */
+typedef RTLOGBINSPEC *PRTLOGBINSPEC;
+
+DECLHIDDEN(const char *) rtLogBinParseSpec(const char *pszFormat, PRTLOGBINSPEC pSpec);
+DECLHIDDEN(int) rtLogBinEncodeArgs(void *pvDst, size_t cbDst, const char *pszFormat, va_list va, size_t *pcbUsed);
+
+RT_C_DECLS_END
+
+#endif
+
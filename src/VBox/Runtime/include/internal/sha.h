@@ -0,0 +1,202 @@
+/* $Id$ */
+/** @file
+ * IPRT - Internal header for the SHA-1/SHA-256 SIMD code paths.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+#ifndef ___internal_sha_h
+#define ___internal_sha_h
+
+#include <iprt/types.h>
+
+/** @def RTSHA_WITH_X86_SIMD
+ * Defined when alt-sha1.cpp and alt-sha256.cpp include the SHA-NI and AVX2
+ * code paths, selected at runtime according to the CPU features.
+ *
+ * This is restricted to ring-3 since the kernels use the XMM and YMM
+ * registers, and to compilers that can target the instruction set extensions
+ * on a per function basis (RTSHA_TARGET_SHANI, RTSHA_TARGET_AVX2). */
+#if (defined(RT_ARCH_AMD64) || defined(RT_ARCH_X86)) \
+ && defined(IN_RING3) \
+ && !defined(IPRT_NO_CRT) \
+ && (   (defined(_MSC_VER) && _MSC_VER >= 1900) \
+     || (defined(__GNUC__) && !defined(__clang__) && RT_GNUC_PREREQ(4, 9)) )
+# define RTSHA_WITH_X86_SIMD
+#endif
+
+#ifdef RTSHA_WITH_X86_SIMD
+# include <iprt/asm-amd64-x86.h>
+# include <iprt/x86.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+# endif
+# include <immintrin.h>
+
+/** @def RTSHA_TARGET_SHANI
+ * Function attribute for code using the SHA, SSSE3 and SSE4.1 intrinsics. */
+/** @def RTSHA_TARGET_AVX2
+ * Function attribute for code using the AVX2 intrinsics. */
+# ifdef __GNUC__
+#  define RTSHA_TARGET_SHANI        __attribute__((__target__("sha,ssse3,sse4.1")))
+#  define RTSHA_TARGET_AVX2         __attribute__((__target__("avx2")))
+# else
+#  define RTSHA_TARGET_SHANI
+#  define RTSHA_TARGET_AVX2
+# endif
+
+/** @name RTSHA_SIMD_F_XXX - CPU features usable by the SHA code.
+ * @{ */
+/** SHA-NI together with SSSE3 and SSE4.1. */
+# define RTSHA_SIMD_F_SHANI         RT_BIT_32(0)
+/** AVX2 with the YMM state enabled by the OS. */
+# define RTSHA_SIMD_F_AVX2          RT_BIT_32(1)
+/** Set once the detection has been done. */
+# define RTSHA_SIMD_F_DETECTED      RT_BIT_32(31)
+/** @} */
+
+/**
+ * Detects the CPU features usable by the SHA code.
+ *
+ * @returns RTSHA_SIMD_F_XXX, RTSHA_SIMD_F_DETECTED always set.
+ */
+DECLINLINE(uint32_t) rtShaSimdDetect(void)
+{
+    uint32_t fFeatures = RTSHA_SIMD_F_DETECTED;
+    if (ASMHasCpuId())
+    {
+        uint32_t uMaxLeaf, uEbx, uEcx, uEdx;
+        ASMCpuId(0, &uMaxLeaf, &uEbx, &uEcx, &uEdx);
+        if (uMaxLeaf >= 7)
+        {
+            uint32_t uEax, uEbx7, uEcx7, uEdx7;
+            ASMCpuId(1, &uEax, &uEbx, &uEcx, &uEdx);
+            ASMCpuId_Idx_ECX(7, 0, &uEax, &uEbx7, &uEcx7, &uEdx7);
+
+            if (   (uEbx7 & X86_CPUID_STEXT_FEATURE_EBX_SHA)
+                && (uEcx & X86_CPUID_FEATURE_ECX_SSSE3)
+                && (uEcx & X86_CPUID_FEATURE_ECX_SSE4_1))
+                fFeatures |= RTSHA_SIMD_F_SHANI;
+
+            if (   (uEbx7 & X86_CPUID_STEXT_FEATURE_EBX_AVX2)
+                && (uEcx & X86_CPUID_FEATURE_ECX_OSXSAVE))
+            {
+                /* Inlined xgetbv, ASMGetXcr0 isn't in all the runtime flavours. */
+# ifdef _MSC_VER
+                uint64_t const fXcr0 = _xgetbv(0);
+# else
+                uint32_t uXcr0Lo, uXcr0Hi;
+                __asm__ __volatile__(".byte 0x0f,0x01,0xd0" /* xgetbv */ : "=a" (uXcr0Lo), "=d" (uXcr0Hi) : "c" (0));
+                uint64_t const fXcr0 = RT_MAKE_U64(uXcr0Lo, uXcr0Hi);
+# endif
+                if ((fXcr0 & (XSAVE_C_SSE | XSAVE_C_YMM)) == (XSAVE_C_SSE | XSAVE_C_YMM))
+                    fFeatures |= RTSHA_SIMD_F_AVX2;
+            }
+        }
+    }
+    return fFeatures;
+}
+
+
+/**
+ * Loads a 64 byte block from each of eight messages for the AVX2 code.
+ *
+ * The blocks are transposed and byte swapped, so that element N of vector
+ * iWord is the big endian word iWord of message N.
+ *
+ * @param   pauW        Where to return the 16 message word vectors.
+ * @param   papbLanes   The eight messages, no alignment requirements.
+ * @param   offBlock    The offset of the block into the messages.
+ */
+RTSHA_TARGET_AVX2 DECLINLINE(void) rtShaAvx2x8LoadBlock(__m256i *pauW, uint8_t const * const *papbLanes, size_t offBlock)
+{
+    __m256i const uBSwap = _mm256_set_epi8(12, 13, 14, 15,  8,  9, 10, 11,  4,  5,  6,  7,  0,  1,  2,  3,
+                                           12, 13, 14, 15,  8,  9, 10, 11,  4,  5,  6,  7,  0,  1,  2,  3);
+    for (unsigned iHalf = 0; iHalf < 2; iHalf++)
+    {
+        __m256i auRow[8];
+        for (unsigned iLane = 0; iLane < 8; iLane++)
+            auRow[iLane] = _mm256_loadu_si256((__m256i const *)&papbLanes[iLane][offBlock + iHalf * 32]);
+
+        __m256i const uT0 = _mm256_unpacklo_epi32(auRow[0], auRow[1]);
+        __m256i const uT1 = _mm256_unpackhi_epi32(auRow[0], auRow[1]);
+        __m256i const uT2 = _mm256_unpacklo_epi32(auRow[2], auRow[3]);
+        __m256i const uT3 = _mm256_unpackhi_epi32(auRow[2], auRow[3]);
+        __m256i const uT4 = _mm256_unpacklo_epi32(auRow[4], auRow[5]);
+        __m256i const uT5 = _mm256_unpackhi_epi32(auRow[4], auRow[5]);
+        __m256i const uT6 = _mm256_unpacklo_epi32(auRow[6], auRow[7]);
+        __m256i const uT7 = _mm256_unpackhi_epi32(auRow[6], auRow[7]);
+
+        __m256i const uU0 = _mm256_unpacklo_epi64(uT0, uT2);
+        __m256i const uU1 = _mm256_unpackhi_epi64(uT0, uT2);
+        __m256i const uU2 = _mm256_unpacklo_epi64(uT1, uT3);
+        __m256i const uU3 = _mm256_unpackhi_epi64(uT1, uT3);
+        __m256i const uU4 = _mm256_unpacklo_epi64(uT4, uT6);
+        __m256i const uU5 = _mm256_unpackhi_epi64(uT4, uT6);
+        __m256i const uU6 = _mm256_unpacklo_epi64(uT5, uT7);
+        __m256i const uU7 = _mm256_unpackhi_epi64(uT5, uT7);
+
+        __m256i *puW = &pauW[iHalf * 8];
+        puW[0] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU0, uU4, 0x20), uBSwap);
+        puW[1] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU1, uU5, 0x20), uBSwap);
+        puW[2] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU2, uU6, 0x20), uBSwap);
+        puW[3] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU3, uU7, 0x20), uBSwap);
+        puW[4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU0, uU4, 0x31), uBSwap);
+        puW[5] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU1, uU5, 0x31), uBSwap);
+        puW[6] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU2, uU6, 0x31), uBSwap);
+        puW[7] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(uU3, uU7, 0x31), uBSwap);
+    }
+}
+
+
+/**
+ * Builds the final block(s) of eight equally sized messages for the AVX2 code.
+ *
+ * @returns Number of blocks, 1 or 2.
+ * @param   pabTails    Eight 128 byte buffers for the blocks.
+ * @param   papbTails   Where to return the pointers to the tail blocks.
+ * @param   papbLanes   The eight messages.
+ * @param   cbMsg       The message size.
+ */
+DECLINLINE(size_t) rtShaX8BuildTails(uint8_t (*pabTails)[128], uint8_t const **papbTails,
+                                     uint8_t const * const *papbLanes, size_t cbMsg)
+{
+    size_t const   offTail      = cbMsg & ~(size_t)63;
+    size_t const   cbTail       = cbMsg & 63;
+    size_t const   cbTailBlocks = cbTail + 1 + 8 > 64 ? 128 : 64;
+    uint64_t const cBitsBe      = RT_H2BE_U64((uint64_t)cbMsg * 8);
+    for (unsigned iLane = 0; iLane < 8; iLane++)
+    {
+        uint8_t *pbTail = &pabTails[iLane][0];
+        memcpy(pbTail, &papbLanes[iLane][offTail], cbTail);
+        pbTail[cbTail] = 0x80;
+        memset(&pbTail[cbTail + 1], 0, cbTailBlocks - cbTail - 1 - 8);
+        memcpy(&pbTail[cbTailBlocks - 8], &cBitsBe, 8);
+        papbTails[iLane] = pbTail;
+    }
+    return cbTailBlocks / 64;
+}
+
+#endif /* RTSHA_WITH_X86_SIMD */
+
+#endif
+
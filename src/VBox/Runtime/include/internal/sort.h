@@ -0,0 +1,115 @@
+/* $Id$ */
+/** @file
+ * IPRT - Internal header for the sorting code.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+#ifndef ___internal_sort_h
+#define ___internal_sort_h
+
+#include <iprt/sort.h>
+#include <iprt/string.h>
+
+RT_C_DECLS_BEGIN
+
+/** Below this number of elements the sorters resort to insertion sort. */
+#define RTSORT_INSERTION_THRESHOLD      16
+
+/**
+ * Swaps two array elements.
+ *
+ * @param   pvElement1      The 1st element.
+ * @param   pvElement2      The 2nd element.
+ * @param   cbElement       The element size.
+ */
+DECLINLINE(void) rtSortSwap(void *pvElement1, void *pvElement2, size_t cbElement)
+{
+    switch (cbElement)
+    {
+        case sizeof(uint32_t):
+        {
+            uint32_t u1, u2;
+            memcpy(&u1, pvElement1, sizeof(u1));
+            memcpy(&u2, pvElement2, sizeof(u2));
+            memcpy(pvElement1, &u2, sizeof(u2));
+            memcpy(pvElement2, &u1, sizeof(u1));
+            break;
+        }
+
+        case sizeof(uint64_t):
+        {
+            uint64_t u1, u2;
+            memcpy(&u1, pvElement1, sizeof(u1));
+            memcpy(&u2, pvElement2, sizeof(u2));
+            memcpy(pvElement1, &u2, sizeof(u2));
+            memcpy(pvElement2, &u1, sizeof(u1));
+            break;
+        }
+
+        default:
+        {
+            uint8_t *pb1 = (uint8_t *)pvElement1;
+            uint8_t *pb2 = (uint8_t *)pvElement2;
+            while (cbElement > 0)
+            {
+                uint8_t      abTmp[32];
+                size_t const cbThis = RT_MIN(cbElement, sizeof(abTmp));
+                memcpy(abTmp, pb1, cbThis);
+                memcpy(pb1, pb2, cbThis);
+                memcpy(pb2, abTmp, cbThis);
+                pb1       += cbThis;
+                pb2       += cbThis;
+                cbElement -= cbThis;
+            }
+            break;
+        }
+    }
+}
+
+
+/**
+ * Context for sorting pointer arrays using the variable sized element
+ * sorters, see rtSortApvCompare.
+ */
+typedef struct RTSORTAPVCTX
+{
+    /** The user's compare function taking the pointers. */
+    PFNRTSORTCMP    pfnCmp;
+    /** The user argument. */
+    void           *pvUser;
+} RTSORTAPVCTX;
+
+/**
+ * @callback_method_impl{FNRTSORTCMP, Adaptor for pointer arrays, pvUser is
+ *      a RTSORTAPVCTX.}
+ */
+static DECLCALLBACK(int) rtSortApvCompare(void const *pvElement1, void const *pvElement2, void *pvUser)
+{
+    RTSORTAPVCTX const *pCtx = (RTSORTAPVCTX const *)pvUser;
+    return pCtx->pfnCmp(*(void * const *)pvElement1, *(void * const *)pvElement2, pCtx->pvUser);
+}
+
+RT_C_DECLS_END
+
+#endif
+
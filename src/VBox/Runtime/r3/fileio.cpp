@@ -200,27 +200,6 @@ int rtFileRecalcAndValidateFlags(uint64_t *pfOpen)
 
 
 
-/**
- * Read bytes from a file at a given offset.
- * This function may modify the file position.
- *
- * @returns iprt status code.
- * @param   File        Handle to the file.
- * @param   off         Where to read.
- * @param   pvBuf       Where to put the bytes we read.
- * @param   cbToRead    How much to read.
- * @param   *pcbRead    How much we actually read.
- *                      If NULL an error will be returned for a partial read.
- */
-RTR3DECL(int)  RTFileReadAt(RTFILE File, RTFOFF off, void *pvBuf, size_t cbToRead, size_t *pcbRead)
-{
-    int rc = RTFileSeek(File, off, RTFILE_SEEK_BEGIN, NULL);
-    if (RT_SUCCESS(rc))
-        rc = RTFileRead(File, pvBuf, cbToRead, pcbRead);
-    return rc;
-}
-
-
 /**
  * Read bytes from a file at a given offset into a S/G buffer.
  * This function may modify the file position.
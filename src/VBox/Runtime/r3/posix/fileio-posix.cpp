@@ -490,6 +490,56 @@ RTR3DECL(int)  RTFileRead(RTFILE hFile, void *pvBuf, size_t cbToRead, size_t *pc
 }
 
 
+RTR3DECL(int)  RTFileReadAt(RTFILE hFile, RTFOFF off, void *pvBuf, size_t cbToRead, size_t *pcbRead)
+{
+#ifdef RT_OS_OS2
+    /* No pread here, so this isn't safe for concurrent use. */
+    int rc = RTFileSeek(hFile, off, RTFILE_SEEK_BEGIN, NULL);
+    if (RT_SUCCESS(rc))
+        rc = RTFileRead(hFile, pvBuf, cbToRead, pcbRead);
+    return rc;
+#else
+    if (cbToRead <= 0)
+    {
+        if (pcbRead)
+            *pcbRead = 0;
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * Attempt read.  Unlike seeking followed by read() this doesn't touch
+     * the file position, so several threads can read at different offsets
+     * using the same handle.
+     */
+    ssize_t cbRead = pread(RTFileToNative(hFile), pvBuf, cbToRead, off);
+    if (cbRead >= 0)
+    {
+        if (pcbRead)
+            /* caller can handle partial read. */
+            *pcbRead = cbRead;
+        else
+        {
+            /* Caller expects all to be read. */
+            while ((ssize_t)cbToRead > cbRead)
+            {
+                ssize_t cbReadPart = pread(RTFileToNative(hFile), (char *)pvBuf + cbRead, cbToRead - cbRead, off + cbRead);
+                if (cbReadPart <= 0)
+                {
+                    if (cbReadPart == 0)
+                        return VERR_EOF;
+                    return RTErrConvertFromErrno(errno);
+                }
+                cbRead += cbReadPart;
+            }
+        }
+        return VINF_SUCCESS;
+    }
+
+    return RTErrConvertFromErrno(errno);
+#endif
+}
+
+
 RTR3DECL(int)  RTFileWrite(RTFILE hFile, const void *pvBuf, size_t cbToWrite, size_t *pcbWritten)
 {
     if (cbToWrite <= 0)
@@ -491,6 +491,83 @@ RTR3DECL(int)  RTFileRead(RTFILE hFile, void *pvBuf, size_t cbToRead, size_t *pc
 }
 
 
+/**
+ * Worker for RTFileReadAt that reads once at the given offset.
+ *
+ * Passing the offset in an OVERLAPPED structure doesn't depend on the file
+ * pointer, so several threads can read at different offsets using the same
+ * handle.
+ *
+ * @returns IPRT status code.
+ * @param   hFile       The file handle.
+ * @param   off         Where to read.
+ * @param   pvBuf       Where to put the bytes read.
+ * @param   cbToRead    How much to read.
+ * @param   pcbRead     Where to return how much was read, 0 at end of file.
+ */
+static int rtFileWinReadAtOnce(RTFILE hFile, RTFOFF off, void *pvBuf, ULONG cbToRead, ULONG *pcbRead)
+{
+    OVERLAPPED Ovl;
+    RT_ZERO(Ovl);
+    Ovl.Offset     = (DWORD)off;
+    Ovl.OffsetHigh = (DWORD)((uint64_t)off >> 32);
+
+    *pcbRead = 0;
+    if (ReadFile((HANDLE)RTFileToNative(hFile), pvBuf, cbToRead, pcbRead, &Ovl))
+        return VINF_SUCCESS;
+
+    DWORD dwErr = GetLastError();
+    if (   dwErr == ERROR_IO_PENDING
+        && GetOverlappedResult((HANDLE)RTFileToNative(hFile), &Ovl, pcbRead, TRUE /*bWait*/))
+        return VINF_SUCCESS;
+    if (dwErr == ERROR_IO_PENDING)
+        dwErr = GetLastError();
+    if (dwErr == ERROR_HANDLE_EOF)
+    {
+        *pcbRead = 0;
+        return VINF_SUCCESS;
+    }
+    return RTErrConvertFromWin32(dwErr);
+}
+
+
+RTR3DECL(int)  RTFileReadAt(RTFILE hFile, RTFOFF off, void *pvBuf, size_t cbToRead, size_t *pcbRead)
+{
+    if (cbToRead <= 0)
+    {
+        if (pcbRead)
+            *pcbRead = 0;
+        return VINF_SUCCESS;
+    }
+    ULONG cbToReadAdj = (ULONG)cbToRead;
+    AssertReturn(cbToReadAdj == cbToRead, VERR_NUMBER_TOO_BIG);
+
+    ULONG cbRead = 0;
+    int rc = rtFileWinReadAtOnce(hFile, off, pvBuf, cbToReadAdj, &cbRead);
+    if (RT_SUCCESS(rc))
+    {
+        if (pcbRead)
+            /* Caller can handle partial reads. */
+            *pcbRead = cbRead;
+        else
+        {
+            /* Caller expects everything to be read. */
+            while (cbToReadAdj > cbRead)
+            {
+                ULONG cbReadPart = 0;
+                rc = rtFileWinReadAtOnce(hFile, off + cbRead, (char *)pvBuf + cbRead, cbToReadAdj - cbRead, &cbReadPart);
+                if (RT_FAILURE(rc))
+                    return rc;
+                if (cbReadPart == 0)
+                    return VERR_EOF;
+                cbRead += cbReadPart;
+            }
+        }
+    }
+    return rc;
+}
+
+
 RTR3DECL(int)  RTFileWrite(RTFILE hFile, const void *pvBuf, size_t cbToWrite, size_t *pcbWritten)
 {
     if (cbToWrite <= 0)
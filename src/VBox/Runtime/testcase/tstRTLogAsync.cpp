@@ -0,0 +1,305 @@
+/* $Id$ */
+/** @file
+ * IPRT Testcase - Asynchronous log file writing.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/log.h>
+
+#include <iprt/asm.h>
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/path.h>
+#include <iprt/process.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Number of logging threads. */
+#define TST_THREADS             4
+/** Number of lines each thread logs. */
+#define TST_LINES_PER_THREAD    20000
+/** The payload length of the long lines, chosen to exceed what the logger
+ * formats before taking its lock. */
+#define TST_LONG_LINE_CCH       600
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static PRTLOGGER        g_pLogger;
+static uint32_t volatile g_cThreadsDone;
+
+
+static DECLCALLBACK(int) tstLoggerThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    uint32_t const iThread = (uint32_t)(uintptr_t)pvUser;
+    for (uint32_t iLine = 0; iLine < TST_LINES_PER_THREAD; iLine++)
+        RTLogLogger(g_pLogger, NULL, "T%u L%u some padding to make the lines a bit longer\n", iThread, iLine);
+    ASMAtomicIncU32(&g_cThreadsDone);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Logs every other line with a long payload of the letter belonging to the
+ * thread.
+ */
+static DECLCALLBACK(int) tstLongLoggerThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    uint32_t const iThread = (uint32_t)(uintptr_t)pvUser;
+    char szPayload[TST_LONG_LINE_CCH + 1];
+    memset(szPayload, 'a' + iThread, TST_LONG_LINE_CCH);
+    szPayload[TST_LONG_LINE_CCH] = '\0';
+    for (uint32_t iLine = 0; iLine < TST_LINES_PER_THREAD; iLine++)
+        if (iLine & 1)
+            RTLogLogger(g_pLogger, NULL, "T%u L%u %s\n", iThread, iLine, szPayload);
+        else
+            RTLogLogger(g_pLogger, NULL, "T%u L%u some padding to make the lines a bit longer\n", iThread, iLine);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Checks that the log file contains all lines of all threads in order.
+ *
+ * @param   pszPath         The log file.
+ * @param   cLinesPerThread The number of lines each thread logged.
+ * @param   fPrefixed       Whether the lines are prefixed by the thread name
+ *                          and carry the payloads of tstLongLoggerThread.
+ */
+static void tstVerifyFile(const char *pszPath, uint32_t cLinesPerThread, bool fPrefixed)
+{
+    void  *pvFile;
+    size_t cbFile;
+    RTTESTI_CHECK_RC_RETV(RTFileReadAll(pszPath, &pvFile, &cbFile), VINF_SUCCESS);
+
+    uint32_t    aiNext[TST_THREADS] = { 0 };
+    const char *pch    = (const char *)pvFile;
+    const char *pchEnd = pch + cbFile;
+    while (pch < pchEnd)
+    {
+        const char *pchEol = (const char *)memchr(pch, '\n', pchEnd - pch);
+        if (!pchEol)
+        {
+            RTTestIFailed("Incomplete last line: %.*s", (int)(pchEnd - pch), pch);
+            break;
+        }
+        uint32_t iThreadPrefix = UINT32_MAX;
+        if (fPrefixed && !strncmp(pch, RT_STR_TUPLE("Logger")))
+        {
+            char *pszNext;
+            RTStrToUInt32Ex(pch + sizeof("Logger") - 1, &pszNext, 10, &iThreadPrefix);
+            pch = RTStrStripL(pszNext);
+        }
+        if (*pch == 'T')
+        {
+            uint32_t iThread = UINT32_MAX;
+            uint32_t iLine   = UINT32_MAX;
+            char    *pszNext;
+            RTStrToUInt32Ex(pch + 1, &pszNext, 10, &iThread);
+            if (iThread < TST_THREADS && pszNext[0] == ' ' && pszNext[1] == 'L')
+                RTStrToUInt32Ex(pszNext + 2, &pszNext, 10, &iLine);
+            if (iThread >= TST_THREADS || iLine != aiNext[iThread])
+            {
+                RTTestIFailed("Unexpected line (iThread=%u iLine=%u): %.*s", iThread, iLine, (int)(pchEol - pch), pch);
+                break;
+            }
+            if (fPrefixed)
+            {
+                /* The logger starts out without a pending prefix. */
+                if (   iThreadPrefix != iThread
+                    && (iThreadPrefix != UINT32_MAX || pch != pvFile))
+                {
+                    RTTestIFailed("Line of thread %u has the prefix of thread %u", iThread, iThreadPrefix);
+                    break;
+                }
+                size_t const cchPayload = pchEol - pszNext;
+                if (iLine & 1)
+                {
+                    bool fOk = cchPayload == 1 + TST_LONG_LINE_CCH && *pszNext == ' ';
+                    for (size_t off = 1; fOk && off < cchPayload; off++)
+                        fOk = pszNext[off] == (char)('a' + iThread);
+                    if (!fOk)
+                    {
+                        RTTestIFailed("Bad long payload (iThread=%u iLine=%u cch=%zu)", iThread, iLine, cchPayload);
+                        break;
+                    }
+                }
+            }
+            aiNext[iThread]++;
+        }
+        pch = pchEol + 1;
+    }
+
+    for (uint32_t iThread = 0; iThread < TST_THREADS; iThread++)
+        if (aiNext[iThread] != cLinesPerThread)
+            RTTestIFailed("Thread %u: found %u lines, expected %u", iThread, aiNext[iThread], cLinesPerThread);
+
+    RTFileReadAllFree(pvFile, cbFile);
+}
+
+
+/**
+ * Logs from several threads, optionally toggling asynchronous writing on and
+ * off while doing so.
+ */
+static void tstLogging(const char *pszPath, bool fToggle)
+{
+    RTTestISubF("%u threads%s", TST_THREADS, fToggle ? ", toggling" : "");
+
+    RTTESTI_CHECK_RC_RETV(RTLogCreate(&g_pLogger, RTLOGFLAGS_ASYNC, NULL, NULL, 0, NULL, RTLOGDEST_FILE, "%s", pszPath),
+                          VINF_SUCCESS);
+
+    char szFlags[256];
+    RTTESTI_CHECK_RC(RTLogGetFlags(g_pLogger, szFlags, sizeof(szFlags)), VINF_SUCCESS);
+    RTTESTI_CHECK_MSG(strstr(szFlags, "async") != NULL, ("%s\n", szFlags));
+
+    RTLOGASYNCSTATS Stats;
+    RTTESTI_CHECK_RC(RTLogQueryAsyncStats(g_pLogger, &Stats), VINF_SUCCESS);
+    RTTESTI_CHECK(Stats.fActive);
+    RTTESTI_CHECK(Stats.cDropped == 0 && Stats.cbDropped == 0);
+
+    g_cThreadsDone = 0;
+    RTTHREAD ahThreads[TST_THREADS];
+    for (uint32_t i = 0; i < TST_THREADS; i++)
+        RTTESTI_CHECK_RC_RETV(RTThreadCreateF(&ahThreads[i], tstLoggerThread, (void *)(uintptr_t)i, 0, RTTHREADTYPE_DEFAULT,
+                                              RTTHREADFLAGS_WAITABLE, "Logger%u", i), VINF_SUCCESS);
+
+    if (fToggle)
+    {
+        bool fAsync = true;
+        while (ASMAtomicReadU32(&g_cThreadsDone) < TST_THREADS)
+        {
+            RTThreadSleep(1);
+            fAsync = !fAsync;
+            RTLogFlags(g_pLogger, fAsync ? "async" : "noasync");
+        }
+        RTLogFlags(g_pLogger, "async");
+    }
+
+    for (uint32_t i = 0; i < TST_THREADS; i++)
+        RTTESTI_CHECK_RC(RTThreadWait(ahThreads[i], RT_INDEFINITE_WAIT, NULL), VINF_SUCCESS);
+
+    /* An explicit flush must put everything in the file. */
+    RTLogFlush(g_pLogger);
+    tstVerifyFile(pszPath, TST_LINES_PER_THREAD, false /*fPrefixed*/);
+
+    /* Nothing may be queued after the flush, and since every line made it
+       into the file nothing can have been dropped. */
+    RTTESTI_CHECK_RC(RTLogQueryAsyncStats(g_pLogger, &Stats), VINF_SUCCESS);
+    RTTESTI_CHECK(Stats.fActive);
+    RTTESTI_CHECK_MSG(Stats.cbQueued == 0, ("cbQueued=%RU64\n", Stats.cbQueued));
+    RTTESTI_CHECK_MSG(Stats.cDropped == 0 && Stats.cbDropped == 0,
+                      ("cDropped=%RU64 cbDropped=%RU64\n", Stats.cDropped, Stats.cbDropped));
+    RTTestIValue("Buffer full waits", Stats.cWaits, RTTESTUNIT_OCCURRENCES);
+
+    /* The counters survive turning asynchronous writing off. */
+    RTLogFlags(g_pLogger, "noasync");
+    RTLOGASYNCSTATS Stats2;
+    RTTESTI_CHECK_RC(RTLogQueryAsyncStats(g_pLogger, &Stats2), VINF_SUCCESS);
+    RTTESTI_CHECK(!Stats2.fActive);
+    RTTESTI_CHECK(Stats2.cbQueued == 0);
+    RTTESTI_CHECK(Stats2.cWaits == Stats.cWaits);
+    RTLogFlags(g_pLogger, "async");
+
+    /* More output after the flush must survive destruction. */
+    for (uint32_t i = 0; i < TST_THREADS; i++)
+        RTLogLogger(g_pLogger, NULL, "T%u L%u\n", i, TST_LINES_PER_THREAD);
+    RTTESTI_CHECK_RC(RTLogDestroy(g_pLogger), VINF_SUCCESS);
+    g_pLogger = NULL;
+    tstVerifyFile(pszPath, TST_LINES_PER_THREAD + 1, false /*fPrefixed*/);
+
+    RTFileDelete(pszPath);
+}
+
+
+/**
+ * Logs with thread name prefixes, half of the lines being too long for the
+ * logger to format before taking its lock.
+ */
+static void tstLoggingPrefixed(const char *pszPath)
+{
+    RTTestISubF("%u threads, prefixed, long lines", TST_THREADS);
+
+    RTTESTI_CHECK_RC_RETV(RTLogCreate(&g_pLogger, RTLOGFLAGS_ASYNC | RTLOGFLAGS_PREFIX_THREAD, NULL, NULL, 0, NULL,
+                                      RTLOGDEST_FILE, "%s", pszPath), VINF_SUCCESS);
+
+    RTTHREAD ahThreads[TST_THREADS];
+    for (uint32_t i = 0; i < TST_THREADS; i++)
+        RTTESTI_CHECK_RC_RETV(RTThreadCreateF(&ahThreads[i], tstLongLoggerThread, (void *)(uintptr_t)i, 0, RTTHREADTYPE_DEFAULT,
+                                              RTTHREADFLAGS_WAITABLE, "Logger%u", i), VINF_SUCCESS);
+    for (uint32_t i = 0; i < TST_THREADS; i++)
+        RTTESTI_CHECK_RC(RTThreadWait(ahThreads[i], RT_INDEFINITE_WAIT, NULL), VINF_SUCCESS);
+
+    RTLogFlush(g_pLogger);
+    tstVerifyFile(pszPath, TST_LINES_PER_THREAD, true /*fPrefixed*/);
+
+    RTLOGASYNCSTATS Stats;
+    RTTESTI_CHECK_RC(RTLogQueryAsyncStats(g_pLogger, &Stats), VINF_SUCCESS);
+    RTTESTI_CHECK_MSG(Stats.cDropped == 0, ("cDropped=%RU64\n", Stats.cDropped));
+
+    RTTESTI_CHECK_RC(RTLogDestroy(g_pLogger), VINF_SUCCESS);
+    g_pLogger = NULL;
+    RTFileDelete(pszPath);
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstRTLogAsync", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    char szPath[RTPATH_MAX];
+    int rc = RTPathTemp(szPath, sizeof(szPath));
+    if (RT_SUCCESS(rc))
+    {
+        char szName[64];
+        RTStrPrintf(szName, sizeof(szName), "tstRTLogAsync-%u.log", RTProcSelf());
+        rc = RTPathAppend(szPath, sizeof(szPath), szName);
+    }
+    if (RT_SUCCESS(rc))
+    {
+        tstLogging(szPath, false /*fToggle*/);
+        tstLogging(szPath, true /*fToggle*/);
+        tstLoggingPrefixed(szPath);
+    }
+    else
+        RTTestFailed(hTest, "Failed to construct the log file path: %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
@@ -0,0 +1,213 @@
+/* $Id$ */
+/** @file
+ * IPRT Testcase - Binary logging and decoding.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/log.h>
+
+#include <iprt/err.h>
+#include <iprt/file.h>
+#include <iprt/mem.h>
+#include <iprt/path.h>
+#include <iprt/process.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+#include <iprt/uuid.h>
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** Growing output buffer for the decoder and the expected output. */
+typedef struct TSTBUF
+{
+    char       *pszBuf;
+    size_t      cchBuf;
+    size_t      cbAlloc;
+} TSTBUF;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static const char * const g_apszGroups[] = { "DEFAULT", "TEST" };
+static TSTBUF   g_Expected;
+
+
+static DECLCALLBACK(size_t) tstBufOutput(void *pvArg, const char *pachChars, size_t cbChars)
+{
+    TSTBUF *pBuf = (TSTBUF *)pvArg;
+    if (pBuf->cchBuf + cbChars + 1 > pBuf->cbAlloc)
+    {
+        size_t cbNew = RT_MAX(pBuf->cbAlloc * 2, pBuf->cchBuf + cbChars + _4K);
+        char *pszNew = (char *)RTMemRealloc(pBuf->pszBuf, cbNew);
+        if (!pszNew)
+            return 0;
+        pBuf->pszBuf  = pszNew;
+        pBuf->cbAlloc = cbNew;
+    }
+    memcpy(&pBuf->pszBuf[pBuf->cchBuf], pachChars, cbChars);
+    pBuf->cchBuf += cbChars;
+    pBuf->pszBuf[pBuf->cchBuf] = '\0';
+    return cbChars;
+}
+
+
+/**
+ * Logs a message and appends the expected output to g_Expected.
+ */
+static void tstLog(PRTLOGGER pLogger, const char *pszFormat, ...)
+{
+    va_list va;
+    va_start(va, pszFormat);
+    RTLogLoggerExV(pLogger, RTLOGGRPFLAGS_LEVEL_1, 1, pszFormat, va);
+    va_end(va);
+
+    va_start(va, pszFormat);
+    RTStrFormatV(tstBufOutput, &g_Expected, NULL, NULL, pszFormat, va);
+    va_end(va);
+}
+
+
+static void tstRoundTrip(const char *pszPath)
+{
+    RTTestISub("round trip");
+
+    PRTLOGGER pLogger;
+    RTTESTI_CHECK_RC_RETV(RTLogCreate(&pLogger, RTLOGFLAGS_BINARY | RTLOGFLAGS_BUFFERED, "+all", NULL,
+                                      RT_ELEMENTS(g_apszGroups), g_apszGroups, RTLOGDEST_FILE, "%s", pszPath), VINF_SUCCESS);
+
+    char szBuf[] = "buffer used as format string %u\n";
+    RTUUID Uuid;
+    RTUuidCreate(&Uuid);
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        tstLog(pLogger, "plain text\n");
+        tstLog(pLogger, "int %d %u %x %#x %5d|%-5d| %05d %c\n", -1, i, 0xdeadbeef, 0x10, 7, 8, 9, 'Q');
+        tstLog(pLogger, "sizes %lld %llx %ld %zu %zx %hd %hhu\n", (long long)-5 * i, 0x123456789abcULL, -77L,
+               (size_t)i, (size_t)0xff, (short)-2, (unsigned char)200);
+        tstLog(pLogger, "rt %RX64 %RU64 %RI64 %RX32 %RU8 %RX16 %RGp %RHv %RTbool\n", UINT64_C(0xfeedface12345678),
+               (uint64_t)i, (int64_t)-3, 0xabcdu, (uint8_t)200, (uint16_t)0xffff, (RTGCPHYS)_4K * i, (void *)pLogger, true);
+        tstLog(pLogger, "str '%s' '%.3s' '%10s' '%-10s|' '%*s' '%.*s' %s\n", "abc", "abcdef", "xy", "left", 6, "star",
+               2, "prec", (const char *)NULL);
+        tstLog(pLogger, "status %Rrc %Rrs, ptr %p, %%\n", VERR_NOT_SUPPORTED, VINF_SUCCESS, pLogger);
+        tstLog(pLogger, "multiple\nlines %u\n", i);
+        tstLog(pLogger, "partial %u, ", i);
+        tstLog(pLogger, "continued\n");
+        /* These are formatted as text. */
+        tstLog(pLogger, "uuid %RTuuid\n", &Uuid);
+        tstLog(pLogger, "hex %.8Rhxs\n", &Uuid);
+        /* Reusing the same buffer for different format strings. */
+        RTStrPrintf(szBuf, sizeof(szBuf), "format string buffer, take %u: %%u\n", i % 10);
+        tstLog(pLogger, szBuf, i);
+    }
+
+    RTTESTI_CHECK_RC(RTLogDestroy(pLogger), VINF_SUCCESS);
+
+    TSTBUF Decoded = { NULL, 0, 0 };
+    RTTESTI_CHECK_RC(RTLogBinDecodeFile(pszPath, RTLOGBINDECODE_F_NO_PREFIX, tstBufOutput, &Decoded), VINF_SUCCESS);
+    if (   !Decoded.pszBuf
+        || !g_Expected.pszBuf
+        || strcmp(Decoded.pszBuf, g_Expected.pszBuf))
+        RTTestIFailed("Decoded output differs (%zu vs %zu bytes)", Decoded.cchBuf, g_Expected.cchBuf);
+
+    /* With prefixes every message line should be tagged with the group name. */
+    TSTBUF Prefixed = { NULL, 0, 0 };
+    RTTESTI_CHECK_RC(RTLogBinDecodeFile(pszPath, 0, tstBufOutput, &Prefixed), VINF_SUCCESS);
+    RTTESTI_CHECK(Prefixed.pszBuf && strstr(Prefixed.pszBuf, " TEST     plain text\n") != NULL);
+
+    /* The binary file should be smaller than the text. */
+    uint64_t cbFile = 0;
+    RTFileQuerySize(pszPath, &cbFile);
+    RTTestIValue("Binary file size", cbFile, RTTESTUNIT_BYTES);
+    RTTestIValue("Text size", g_Expected.cchBuf, RTTESTUNIT_BYTES);
+
+    RTMemFree(Decoded.pszBuf);
+    RTMemFree(Prefixed.pszBuf);
+    RTMemFree(g_Expected.pszBuf);
+    RTFileDelete(pszPath);
+}
+
+
+/**
+ * Measures the time spent in the logging call with and without binary mode.
+ */
+static void tstBenchmark(const char *pszPath)
+{
+    RTTestISub("benchmark");
+
+    static const char * const s_apszFlags[] = { "", "binary" };
+    for (unsigned iMode = 0; iMode < RT_ELEMENTS(s_apszFlags); iMode++)
+    {
+        PRTLOGGER pLogger;
+        RTTESTI_CHECK_RC_RETV(RTLogCreate(&pLogger, RTLOGFLAGS_BUFFERED, "+all", NULL, RT_ELEMENTS(g_apszGroups),
+                                          g_apszGroups, RTLOGDEST_FILE, "%s", pszPath), VINF_SUCCESS);
+        RTLogFlags(pLogger, s_apszFlags[iMode]);
+
+        uint32_t const cCalls = 200000;
+        uint64_t const nsStart = RTTimeNanoTS();
+        for (uint32_t i = 0; i < cCalls; i++)
+            RTLogLoggerEx(pLogger, RTLOGGRPFLAGS_LEVEL_1, 1, "iteration %u: rc=%Rrc addr=%RGp cb=%#x name=%s\n",
+                          i, VINF_SUCCESS, (RTGCPHYS)i << 12, i * 3, "some-device");
+        uint64_t const cNsElapsed = RTTimeNanoTS() - nsStart;
+
+        RTTESTI_CHECK_RC(RTLogDestroy(pLogger), VINF_SUCCESS);
+        RTTestIValueF(cNsElapsed / cCalls, RTTESTUNIT_NS_PER_CALL, "%s", iMode ? "binary" : "text");
+        RTFileDelete(pszPath);
+    }
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstRTLogBinary", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    char szPath[RTPATH_MAX];
+    int rc = RTPathTemp(szPath, sizeof(szPath));
+    if (RT_SUCCESS(rc))
+    {
+        char szName[64];
+        RTStrPrintf(szName, sizeof(szName), "tstRTLogBinary-%u.vboxlog.bin", RTProcSelf());
+        rc = RTPathAppend(szPath, sizeof(szPath), szName);
+    }
+    if (RT_SUCCESS(rc))
+    {
+        tstRoundTrip(szPath);
+        tstBenchmark(szPath);
+    }
+    else
+        RTTestFailed(hTest, "Failed to construct the log file path: %Rrc", rc);
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
@@ -197,6 +197,179 @@ static void tst2(void)
 }
 
 
+/** Constructor/destructor call counters for tst4. */
+static uint32_t volatile    g_cTst4Ctors, g_cTst4Dtors;
+
+/** Constructor for tst4. */
+static DECLCALLBACK(int) tst4Ctor(RTMEMCACHE hMemCache, void *pvObj, void *pvUser)
+{
+    RT_NOREF_PV(hMemCache); RT_NOREF_PV(pvUser);
+    ASMAtomicIncU32(&g_cTst4Ctors);
+    *(uint32_t *)pvObj = UINT32_C(0x19790401);
+    return VINF_SUCCESS;
+}
+
+
+/** Destructor for tst4. */
+static DECLCALLBACK(void) tst4Dtor(RTMEMCACHE hMemCache, void *pvObj, void *pvUser)
+{
+    RT_NOREF_PV(hMemCache); RT_NOREF_PV(pvUser);
+    RTTESTI_CHECK(*(uint32_t *)pvObj == UINT32_C(0x19790401));
+    ASMAtomicIncU32(&g_cTst4Dtors);
+}
+
+
+/** Thread allocating and freeing objects in random patterns for tst4. */
+static DECLCALLBACK(int) tst4Thread(RTTHREAD hThreadSelf, void *pvArg)
+{
+    RT_NOREF_PV(hThreadSelf); RT_NOREF_PV(pvArg);
+    void       *apv[256];
+    uint32_t    cUsed = 0;
+    for (uint32_t i = 0; i < _256K; i++)
+    {
+        if (   cUsed < RT_ELEMENTS(apv)
+            && (cUsed == 0 || RTRandU32Ex(0, 1)))
+        {
+            void *pv = RTMemCacheAlloc(g_hMemCache);
+            RTTESTI_CHECK_RET(pv != NULL, VERR_NO_MEMORY);
+            RTTESTI_CHECK(*(uint32_t *)pv == UINT32_C(0x19790401));
+            *(uint32_t *)pv = UINT32_C(0xdeadbeef);
+            apv[cUsed++] = pv;
+        }
+        else
+        {
+            void *pv = apv[--cUsed];
+            *(uint32_t *)pv = UINT32_C(0x19790401);
+            RTMemCacheFree(g_hMemCache, pv);
+        }
+    }
+    while (cUsed > 0)
+    {
+        void *pv = apv[--cUsed];
+        *(uint32_t *)pv = UINT32_C(0x19790401);
+        RTMemCacheFree(g_hMemCache, pv);
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Test the magazine layer.
+ */
+static void tst4(void)
+{
+    RTTestISub("Magazines");
+
+    /* The max size must still be reachable by a single thread. */
+    uint32_t const cObjects = PAGE_SIZE * 2 / 256;
+    RTMEMCACHE hMemCache;
+    RTTESTI_CHECK_RC_RETV(RTMemCacheCreate(&hMemCache, 256, 32, cObjects, NULL, NULL, NULL, RTMEMCACHE_F_MAGAZINES),
+                          VINF_SUCCESS);
+    for (uint32_t iLoop = 0; iLoop < 20; iLoop++)
+    {
+        void *apv[cObjects];
+        for (uint32_t i = 0; i < cObjects; i++)
+        {
+            apv[i] = NULL;
+            RTTESTI_CHECK_RC(RTMemCacheAllocEx(hMemCache, &apv[i]), VINF_SUCCESS);
+        }
+
+        void *pv;
+        int   rc;
+        RTTESTI_CHECK_RC(rc = RTMemCacheAllocEx(hMemCache, &pv), VERR_MEM_CACHE_MAX_SIZE);
+        if (RT_SUCCESS(rc))
+            RTMemCacheFree(hMemCache, pv);
+
+        for (uint32_t i = 0; i < cObjects; i++)
+            RTMemCacheFree(hMemCache, apv[i]);
+    }
+    RTTESTI_CHECK_RC(RTMemCacheDestroy(hMemCache), VINF_SUCCESS);
+
+    /* Several threads, objects constructed once and destructed once. */
+    g_cTst4Ctors = g_cTst4Dtors = 0;
+    RTTESTI_CHECK_RC_RETV(RTMemCacheCreate(&g_hMemCache, 64, 0 /*cbAlignment*/, UINT32_MAX, tst4Ctor, tst4Dtor, NULL,
+                                           RTMEMCACHE_F_MAGAZINES), VINF_SUCCESS);
+    RTTHREAD ahThreads[4];
+    for (uint32_t i = 0; i < RT_ELEMENTS(ahThreads); i++)
+        RTTESTI_CHECK_RC_OK_RETV(RTThreadCreateF(&ahThreads[i], tst4Thread, NULL, 0, RTTHREADTYPE_DEFAULT,
+                                                 RTTHREADFLAGS_WAITABLE, "tst4-%u", i));
+    for (uint32_t i = 0; i < RT_ELEMENTS(ahThreads); i++)
+        RTTESTI_CHECK_RC_OK(RTThreadWait(ahThreads[i], RT_INDEFINITE_WAIT, NULL));
+
+    /* Objects freed by the threads that have terminated must be reusable. */
+    void *pv = RTMemCacheAlloc(g_hMemCache);
+    RTTESTI_CHECK(pv && *(uint32_t *)pv == UINT32_C(0x19790401));
+    RTMemCacheFree(g_hMemCache, pv);
+
+    RTTESTI_CHECK_RC(RTMemCacheDestroy(g_hMemCache), VINF_SUCCESS);
+    RTTESTI_CHECK_MSG(g_cTst4Ctors == g_cTst4Dtors, ("cCtors=%u cDtors=%u\n", g_cTst4Ctors, g_cTst4Dtors));
+}
+
+
+/** The caches for tst5. */
+static RTMEMCACHE           g_ahTst5Caches[2048];
+
+
+/** Thread using all the tst5 caches, destroying every other one half way. */
+static DECLCALLBACK(int) tst5Thread(RTTHREAD hThreadSelf, void *pvArg)
+{
+    RT_NOREF_PV(hThreadSelf); RT_NOREF_PV(pvArg);
+    for (uint32_t iRound = 0; iRound < 2; iRound++)
+    {
+        for (uint32_t i = 0; i < RT_ELEMENTS(g_ahTst5Caches); i++)
+            if (g_ahTst5Caches[i] != NIL_RTMEMCACHE)
+            {
+                void *pv = RTMemCacheAlloc(g_ahTst5Caches[i]);
+                RTTESTI_CHECK_RET(pv != NULL, VERR_NO_MEMORY);
+                RTTESTI_CHECK(*(uint32_t *)pv == UINT32_C(0x19790401));
+                RTMemCacheFree(g_ahTst5Caches[i], pv);
+            }
+
+        /* The thread states of destroyed caches are left to the thread. */
+        if (iRound == 0)
+            for (uint32_t i = 0; i < RT_ELEMENTS(g_ahTst5Caches); i += 2)
+            {
+                RTTESTI_CHECK_RC(RTMemCacheDestroy(g_ahTst5Caches[i]), VINF_SUCCESS);
+                g_ahTst5Caches[i] = NIL_RTMEMCACHE;
+            }
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Test lots of caches with magazines, more than there are TLS entries on most
+ * hosts.
+ */
+static void tst5(void)
+{
+    RTTestISub("Many magazine caches");
+
+    g_cTst4Ctors = g_cTst4Dtors = 0;
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_ahTst5Caches); i++)
+        RTTESTI_CHECK_RC_RETV(RTMemCacheCreate(&g_ahTst5Caches[i], 64, 0 /*cbAlignment*/, UINT32_MAX, tst4Ctor, tst4Dtor, NULL,
+                                               RTMEMCACHE_F_MAGAZINES), VINF_SUCCESS);
+
+    /* The caches share a single TLS entry, so there must be some left. */
+    RTTLS iTls = RTTlsAlloc();
+    RTTESTI_CHECK(iTls != NIL_RTTLS);
+    RTTlsFree(iTls);
+
+    RTTHREAD hThread;
+    RTTESTI_CHECK_RC_OK_RETV(RTThreadCreate(&hThread, tst5Thread, NULL, 0, RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE,
+                                            "tst5"));
+    RTTESTI_CHECK_RC_OK(RTThreadWait(hThread, RT_INDEFINITE_WAIT, NULL));
+
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_ahTst5Caches); i++)
+        if (g_ahTst5Caches[i] != NIL_RTMEMCACHE)
+        {
+            RTTESTI_CHECK_RC(RTMemCacheDestroy(g_ahTst5Caches[i]), VINF_SUCCESS);
+            g_ahTst5Caches[i] = NIL_RTMEMCACHE;
+        }
+    RTTESTI_CHECK_MSG(g_cTst4Ctors == g_cTst4Dtors, ("cCtors=%u cDtors=%u\n", g_cTst4Ctors, g_cTst4Dtors));
+}
+
+
 /**
  * Thread that allocates
  * @returns
@@ -260,14 +433,16 @@ static DECLCALLBACK(int) tst3Thread(RTTHREAD hThreadSelf, void *pvArg)
 static void tst3(uint32_t cThreads, uint32_t cbObject, int iMethod, uint32_t cSecs)
 {
     RTTestISubF("Benchmark - %u threads, %u bytes, %u secs, %s", cThreads, cbObject, cSecs,
-                iMethod == 0 ? "RTMemCache"
+                  iMethod == 0 ? "RTMemCache"
+                : iMethod == 2 ? "RTMemCache/magazines"
                 : "RTMemAlloc");
 
     /*
      * Create a cache with unlimited space, a start semaphore and line up
      * the threads.
      */
-    RTTESTI_CHECK_RC_RETV(RTMemCacheCreate(&g_hMemCache, cbObject, 0 /*cbAlignment*/, UINT32_MAX, NULL, NULL, NULL, 0 /*fFlags*/), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_RETV(RTMemCacheCreate(&g_hMemCache, cbObject, 0 /*cbAlignment*/, UINT32_MAX, NULL, NULL, NULL,
+                                           iMethod == 2 ? RTMEMCACHE_F_MAGAZINES : 0), VINF_SUCCESS);
 
     RTSEMEVENTMULTI hEvt;
     RTTESTI_CHECK_RC_OK_RETV(RTSemEventMultiCreate(&hEvt));
@@ -280,7 +455,7 @@ static void tst3(uint32_t cThreads, uint32_t cbObject, int iMethod, uint32_t cSe
     {
         aThreads[i].hThread     = NIL_RTTHREAD;
         aThreads[i].cIterations = 0;
-        aThreads[i].fUseCache   = iMethod == 0;
+        aThreads[i].fUseCache   = iMethod != 1;
         aThreads[i].cbObject    = cbObject;
         aThreads[i].hEvt        = hEvt;
         RTTESTI_CHECK_RC_OK_RETV(RTThreadCreateF(&aThreads[i].hThread, tst3Thread, &aThreads[i], 0,
@@ -319,6 +494,7 @@ static void tst3(uint32_t cThreads, uint32_t cbObject, int iMethod, uint32_t cSe
 static void tst3AllMethods(uint32_t cThreads, uint32_t cbObject, uint32_t cSecs)
 {
     tst3(cThreads, cbObject, 0, cSecs);
+    tst3(cThreads, cbObject, 2, cSecs);
     tst3(cThreads, cbObject, 1, cSecs);
 }
 
@@ -336,6 +512,8 @@ int main(int argc, char **argv)
 
     tst1();
     tst2();
+    tst4();
+    tst5();
     if (RTTestIErrorCount() == 0)
     {
         uint32_t cSecs = argc == 1 ? 5 : 2;
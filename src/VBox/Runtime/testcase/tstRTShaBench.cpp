@@ -0,0 +1,165 @@
+/* $Id$ */
+/** @file
+ * IPRT Testcase - SHA-1 and SHA-256 throughput, single and multi-buffer.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/sha.h>
+
+#include <iprt/err.h>
+#include <iprt/mem.h>
+#include <iprt/param.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Number of pages in the benchmark buffer. */
+#define TST_PAGES       256
+/** Number of passes over the buffer. */
+#define TST_PASSES      16
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The page buffer. */
+static uint8_t     *g_pbPages;
+/** Pointers to the individual pages in g_pbPages. */
+static const void  *g_apvPages[TST_PAGES];
+
+
+/**
+ * Reports the throughput for hashing the page buffer TST_PASSES times.
+ */
+static void tstReportThroughput(uint64_t cNsElapsed, const char *pszName)
+{
+    uint64_t const cbTotal = (uint64_t)TST_PAGES * PAGE_SIZE * TST_PASSES;
+    RTTestIValueF(cbTotal * RT_NS_1SEC / RT_MAX(cNsElapsed, 1) / _1M, RTTESTUNIT_MEGABYTES_PER_SEC, "%s", pszName);
+}
+
+
+static void tstSha1(void)
+{
+    RTTestISub("SHA-1");
+
+    /*
+     * Check RTSha1Multi against RTSha1 for a range of buffer sizes and counts,
+     * including sizes needing two padding blocks and counts which aren't a
+     * multiple of the SIMD lane count.
+     */
+    static uint8_t s_abHashes[TST_PAGES][RTSHA1_HASH_SIZE];
+    static size_t const s_acbBufs[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 1000, PAGE_SIZE };
+    for (unsigned iSize = 0; iSize < RT_ELEMENTS(s_acbBufs); iSize++)
+        for (size_t cBufs = 1; cBufs <= 19; cBufs++)
+        {
+            RTSha1Multi(cBufs, g_apvPages, s_acbBufs[iSize], s_abHashes);
+            for (size_t i = 0; i < cBufs; i++)
+            {
+                uint8_t abHash[RTSHA1_HASH_SIZE];
+                RTSha1(g_apvPages[i], s_acbBufs[iSize], abHash);
+                if (memcmp(abHash, s_abHashes[i], sizeof(abHash)))
+                    RTTestIFailed("RTSha1Multi mismatch: cbBuf=%zu cBufs=%zu i=%zu", s_acbBufs[iSize], cBufs, i);
+            }
+        }
+
+    /*
+     * Throughput.
+     */
+    uint64_t nsStart = RTTimeNanoTS();
+    for (unsigned iPass = 0; iPass < TST_PASSES; iPass++)
+        for (unsigned iPage = 0; iPage < TST_PAGES; iPage++)
+            RTSha1(g_apvPages[iPage], PAGE_SIZE, s_abHashes[iPage]);
+    tstReportThroughput(RTTimeNanoTS() - nsStart, "RTSha1");
+
+    nsStart = RTTimeNanoTS();
+    for (unsigned iPass = 0; iPass < TST_PASSES; iPass++)
+        RTSha1Multi(TST_PAGES, g_apvPages, PAGE_SIZE, s_abHashes);
+    tstReportThroughput(RTTimeNanoTS() - nsStart, "RTSha1Multi");
+}
+
+
+static void tstSha256(void)
+{
+    RTTestISub("SHA-256");
+
+    static uint8_t s_abHashes[TST_PAGES][RTSHA256_HASH_SIZE];
+    static size_t const s_acbBufs[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 1000, PAGE_SIZE };
+    for (unsigned iSize = 0; iSize < RT_ELEMENTS(s_acbBufs); iSize++)
+        for (size_t cBufs = 1; cBufs <= 19; cBufs++)
+        {
+            RTSha256Multi(cBufs, g_apvPages, s_acbBufs[iSize], s_abHashes);
+            for (size_t i = 0; i < cBufs; i++)
+            {
+                uint8_t abHash[RTSHA256_HASH_SIZE];
+                RTSha256(g_apvPages[i], s_acbBufs[iSize], abHash);
+                if (memcmp(abHash, s_abHashes[i], sizeof(abHash)))
+                    RTTestIFailed("RTSha256Multi mismatch: cbBuf=%zu cBufs=%zu i=%zu", s_acbBufs[iSize], cBufs, i);
+            }
+        }
+
+    uint64_t nsStart = RTTimeNanoTS();
+    for (unsigned iPass = 0; iPass < TST_PASSES; iPass++)
+        for (unsigned iPage = 0; iPage < TST_PAGES; iPage++)
+            RTSha256(g_apvPages[iPage], PAGE_SIZE, s_abHashes[iPage]);
+    tstReportThroughput(RTTimeNanoTS() - nsStart, "RTSha256");
+
+    nsStart = RTTimeNanoTS();
+    for (unsigned iPass = 0; iPass < TST_PASSES; iPass++)
+        RTSha256Multi(TST_PAGES, g_apvPages, PAGE_SIZE, s_abHashes);
+    tstReportThroughput(RTTimeNanoTS() - nsStart, "RTSha256Multi");
+}
+
+
+int main()
+{
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstRTShaBench", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    g_pbPages = (uint8_t *)RTTestGuardedAllocTail(hTest, TST_PAGES * PAGE_SIZE);
+    if (g_pbPages)
+    {
+        RTRandBytes(g_pbPages, TST_PAGES * PAGE_SIZE);
+        for (unsigned iPage = 0; iPage < TST_PAGES; iPage++)
+            g_apvPages[iPage] = &g_pbPages[iPage * PAGE_SIZE];
+
+        tstSha1();
+        tstSha256();
+    }
+    else
+        RTTestFailed(hTest, "Out of memory");
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
@@ -47,6 +47,14 @@ typedef struct TSTRTSORTAPV
     size_t      cElements;
 } TSTRTSORTAPV;
 
+/** A symbol table like entry for the stability test and the benchmark. */
+typedef struct TSTRTSORTSYM
+{
+    uint64_t    uAddr;
+    uint32_t    cb;
+    uint32_t    iOrder;
+} TSTRTSORTSYM;
+
 
 static DECLCALLBACK(int) testApvCompare(void const *pvElement1, void const *pvElement2, void *pvUser)
 {
@@ -134,6 +142,103 @@ static void testSorter(RTTEST hTest, FNRTSORT pfnSorter, const char *pszName)
 }
 
 
+static DECLCALLBACK(int) testSymCompare(void const *pvElement1, void const *pvElement2, void *pvUser)
+{
+    TSTRTSORTSYM const *pSym1 = (TSTRTSORTSYM const *)pvElement1;
+    TSTRTSORTSYM const *pSym2 = (TSTRTSORTSYM const *)pvElement2;
+    RT_NOREF_PV(pvUser);
+    if (pSym1->uAddr < pSym2->uAddr)
+        return -1;
+    if (pSym1->uAddr > pSym2->uAddr)
+        return 1;
+    return 0;
+}
+
+static void testStable(RTTEST hTest, FNRTSORT pfnSorter, const char *pszName)
+{
+    RTTestISub(pszName);
+
+    uint32_t const cElements = _64K;
+    TSTRTSORTSYM  *paSyms;
+    RTTESTI_CHECK_RC_OK_RETV(RTTestGuardedAlloc(hTest, cElements * sizeof(paSyms[0]), 1 /*cbAlign*/, false /*fHead*/,
+                                                (void **)&paSyms));
+
+    /* Lots of duplicate keys, the original order recorded in iOrder. */
+    for (uint32_t i = 0; i < cElements; i++)
+    {
+        paSyms[i].uAddr  = RTRandU32Ex(0, 255);
+        paSyms[i].cb     = 0;
+        paSyms[i].iOrder = i;
+    }
+
+    pfnSorter(paSyms, cElements, sizeof(paSyms[0]), testSymCompare, NULL);
+
+    for (uint32_t i = 1; i < cElements; i++)
+        if (   paSyms[i - 1].uAddr > paSyms[i].uAddr
+            || (paSyms[i - 1].uAddr == paSyms[i].uAddr && paSyms[i - 1].iOrder > paSyms[i].iOrder))
+        {
+            RTTestIFailed("not stable at %u", i);
+            break;
+        }
+
+    RTTestGuardedFree(hTest, paSyms);
+}
+
+
+/**
+ * Compares the sorters on symbol table sized arrays, random, sorted and
+ * reversed.
+ */
+static void testBenchmark(RTTEST hTest)
+{
+    RTTestISub("Benchmark");
+
+    static struct
+    {
+        PFNRTSORT   pfnSorter;
+        const char *pszName;
+    } const s_aSorters[] =
+    {
+        { RTSortShell,      "shell" },
+        { RTSortIntro,      "intro" },
+        { RTSortMerge,      "merge" },
+        { RTSortParallel,   "parallel" },
+    };
+    static const char * const s_apszOrders[] = { "random", "sorted", "reversed" };
+
+    RTRAND hRand;
+    RTTESTI_CHECK_RC_OK_RETV(RTRandAdvCreateParkMiller(&hRand));
+
+    uint32_t const cElements = _256K;
+    TSTRTSORTSYM  *paSyms = (TSTRTSORTSYM *)RTTestGuardedAllocTail(hTest, cElements * sizeof(paSyms[0]));
+    RTTESTI_CHECK_RETV(paSyms);
+
+    for (unsigned iOrder = 0; iOrder < RT_ELEMENTS(s_apszOrders); iOrder++)
+        for (unsigned iSorter = 0; iSorter < RT_ELEMENTS(s_aSorters); iSorter++)
+        {
+            /* Same input for each sorter. */
+            RTRandAdvSeed(hRand, 0x1234);
+            for (uint32_t i = 0; i < cElements; i++)
+            {
+                paSyms[i].uAddr  = iOrder == 0 ? RTRandAdvU64(hRand) : iOrder == 1 ? (uint64_t)i * 32 : (uint64_t)(cElements - i) * 32;
+                paSyms[i].cb     = 32;
+                paSyms[i].iOrder = i;
+            }
+
+            uint64_t const nsStart = RTTimeNanoTS();
+            s_aSorters[iSorter].pfnSorter(paSyms, cElements, sizeof(paSyms[0]), testSymCompare, NULL);
+            uint64_t const cNsElapsed = RTTimeNanoTS() - nsStart;
+
+            if (!RTSortIsSorted(paSyms, cElements, sizeof(paSyms[0]), testSymCompare, NULL))
+                RTTestIFailed("%s failed sorting %s input", s_aSorters[iSorter].pszName, s_apszOrders[iOrder]);
+            RTTestIValueF(cNsElapsed, RTTESTUNIT_NS, "%s, %s", s_aSorters[iSorter].pszName, s_apszOrders[iOrder]);
+        }
+
+    RTTestGuardedFree(hTest, paSyms);
+    RTRandAdvDestroy(hRand);
+}
+
+
 int main()
 {
     RTTEST hTest;
@@ -147,6 +252,18 @@ int main()
      */
     testSorter(hTest, RTSortShell, "RTSortShell - shell sort, variable sized element array");
     testApvSorter(RTSortApvShell, "RTSortApvShell - shell sort, pointer array");
+    testSorter(hTest, RTSortIntro, "RTSortIntro - introsort, variable sized element array");
+    testApvSorter(RTSortApvIntro, "RTSortApvIntro - introsort, pointer array");
+    testSorter(hTest, RTSortMerge, "RTSortMerge - merge sort, variable sized element array");
+    testApvSorter(RTSortApvMerge, "RTSortApvMerge - merge sort, pointer array");
+    testStable(hTest, RTSortMerge, "RTSortMerge - stability");
+    testSorter(hTest, RTSortParallel, "RTSortParallel - parallel sort, variable sized element array");
+    testApvSorter(RTSortApvParallel, "RTSortApvParallel - parallel sort, pointer array");
+
+    /*
+     * Compare them.
+     */
+    testBenchmark(hTest);
 
     /*
      * Summary.
@@ -33,6 +33,11 @@
 #include <iprt/err.h>
 #include <iprt/test.h>
 #include <iprt/file.h>
+#include <iprt/manifest.h>
+#include <iprt/mem.h>
+#include <iprt/path.h>
+#include <iprt/process.h>
+#include <iprt/rand.h>
 #include <iprt/string.h>
 
 
@@ -82,6 +87,219 @@ static void tstVfsIoFromStandardHandle(RTTEST hTest, RTHANDLESTD enmHandle)
 
 
 
+/**
+ * Reads the whole of a read ahead stream in odd sized chunks and compares.
+ */
+static void tstVfsReadAheadReadAll(RTVFSIOSTREAM hVfsIos, uint8_t const *pbData, size_t cbData)
+{
+    uint8_t *pbBuf = (uint8_t *)RTMemAlloc(_64K);
+    RTTESTI_CHECK_RETV(pbBuf);
+    size_t off = 0;
+    for (;;)
+    {
+        size_t cbRead = 0;
+        int rc = RTVfsIoStrmRead(hVfsIos, pbBuf, RTRandU32Ex(1, _64K), true /*fBlocking*/, &cbRead);
+        RTTESTI_CHECK_MSG_BREAK(RT_SUCCESS(rc), ("off=%#zx rc=%Rrc\n", off, rc));
+        RTTESTI_CHECK_MSG_BREAK(off + cbRead <= cbData && memcmp(pbBuf, &pbData[off], cbRead) == 0,
+                                ("off=%#zx cbRead=%#zx\n", off, cbRead));
+        off += cbRead;
+        if (rc == VINF_EOF)
+            break;
+    }
+    RTTESTI_CHECK_MSG(off == cbData, ("off=%#zx cbData=%#zx\n", off, cbData));
+    RTMemFree(pbBuf);
+}
+
+
+/**
+ * Reads a real file with several workers in parallel mode, which relies on
+ * RTFileReadAt being safe for concurrent use on the same handle.
+ */
+static void tstVfsReadAheadStdFile(RTTEST hTest, uint8_t const *pbData, size_t cbData)
+{
+    RTTestSub(hTest, "RTVfsCreateReadAheadForFile(parallel, std file)");
+
+    char szPath[RTPATH_MAX];
+    RTTESTI_CHECK_RC_RETV(RTPathTemp(szPath, sizeof(szPath)), VINF_SUCCESS);
+    char szName[64];
+    RTStrPrintf(szName, sizeof(szName), "tstRTVfs-%u.tmp", RTProcSelf());
+    RTTESTI_CHECK_RC_RETV(RTPathAppend(szPath, sizeof(szPath), szName), VINF_SUCCESS);
+
+    RTFILE hFile;
+    RTTESTI_CHECK_RC_RETV(RTFileOpen(&hFile, szPath, RTFILE_O_WRITE | RTFILE_O_DENY_NONE | RTFILE_O_CREATE_REPLACE),
+                          VINF_SUCCESS);
+    int rc = RTFileWrite(hFile, pbData, cbData, NULL);
+    RTTESTI_CHECK_RC_OK(rc);
+    RTTESTI_CHECK_RC_OK(RTFileClose(hFile));
+
+    RTVFSFILE hVfsFile;
+    if (RT_SUCCESS(rc))
+    {
+        RTTESTI_CHECK_RC_OK(rc = RTVfsFileOpenNormal(szPath, RTFILE_O_READ | RTFILE_O_DENY_NONE | RTFILE_O_OPEN, &hVfsFile));
+        if (RT_SUCCESS(rc))
+        {
+            RTVFSFILE hVfsFileRA;
+            RTTESTI_CHECK_RC_OK(rc = RTVfsCreateReadAheadForFile(hVfsFile, RTVFSREADAHEAD_F_PARALLEL | RTVFSREADAHEAD_F_REQS(8),
+                                                                 16 /*cBuffers*/, _16K /*cbBuffer*/, &hVfsFileRA));
+            if (RT_SUCCESS(rc))
+            {
+                RTVFSIOSTREAM hVfsIosRA = RTVfsFileToIoStream(hVfsFileRA);
+                RTVFSREADAHEADSTATS Stats;
+                RTTESTI_CHECK_RC_OK(RTVfsReadAheadQueryStats(hVfsIosRA, &Stats));
+                RTTESTI_CHECK(Stats.fParallel);
+                RTTESTI_CHECK(Stats.cWorkers == 8);
+
+                /* Twice, the second time from the page cache with reads
+                   completing quickly and racing each other more. */
+                for (unsigned iPass = 0; iPass < 2; iPass++)
+                {
+                    RTTESTI_CHECK_RC_OK(RTVfsFileSeek(hVfsFileRA, 0, RTFILE_SEEK_BEGIN, NULL));
+                    tstVfsReadAheadReadAll(hVfsIosRA, pbData, cbData);
+                }
+
+                RTVfsIoStrmRelease(hVfsIosRA);
+                RTVfsFileRelease(hVfsFileRA);
+            }
+            RTVfsFileRelease(hVfsFile);
+        }
+    }
+
+    RTTESTI_CHECK_RC_OK(RTFileDelete(szPath));
+}
+
+
+/**
+ * Tests the read ahead code with several workers in parallel mode, as well
+ * as the single thread fallback for sources that aren't files.
+ */
+static void tstVfsReadAhead(RTTEST hTest)
+{
+    RTTestSub(hTest, "RTVfsCreateReadAheadForFile(parallel)");
+
+    size_t const cbData = _8M + 4321;
+    uint8_t *pbData = (uint8_t *)RTMemAlloc(cbData);
+    RTTESTI_CHECK_RETV(pbData);
+    RTRandBytes(pbData, cbData);
+
+    RTVFSFILE hVfsFile;
+    RTTESTI_CHECK_RC_RETV(RTVfsFileFromBuffer(RTFILE_O_READ, pbData, cbData, &hVfsFile), VINF_SUCCESS);
+
+    RTVFSFILE hVfsFileRA;
+    int rc = RTVfsCreateReadAheadForFile(hVfsFile, RTVFSREADAHEAD_F_PARALLEL | RTVFSREADAHEAD_F_REQS(4),
+                                         16 /*cBuffers*/, _64K /*cbBuffer*/, &hVfsFileRA);
+    RTTESTI_CHECK_RC_OK(rc);
+    if (RT_SUCCESS(rc))
+    {
+        RTVFSIOSTREAM hVfsIosRA = RTVfsFileToIoStream(hVfsFileRA);
+        RTVFSREADAHEADSTATS Stats;
+        RTTESTI_CHECK_RC_OK(RTVfsReadAheadQueryStats(hVfsIosRA, &Stats));
+        RTTESTI_CHECK(Stats.fParallel);
+        RTTESTI_CHECK(Stats.cWorkers == 4);
+        RTTESTI_CHECK(Stats.cBuffers == 16);
+
+        /* Sequential, which should mostly be served from the buffers. */
+        tstVfsReadAheadReadAll(hVfsIosRA, pbData, cbData);
+        RTTESTI_CHECK_RC_OK(RTVfsReadAheadQueryStats(hVfsIosRA, &Stats));
+        RTTESTI_CHECK_MSG(Stats.cbHits + Stats.cbDirect == cbData,
+                          ("cbHits=%#RX64 cbDirect=%#RX64\n", Stats.cbHits, Stats.cbDirect));
+        RTTestIValue("Sequential hits", Stats.cbHits, RTTESTUNIT_BYTES);
+        RTTestIValue("Sequential direct", Stats.cbDirect, RTTESTUNIT_BYTES);
+        RTTestIValue("Sequential stalls", Stats.cStalls, RTTESTUNIT_OCCURRENCES);
+
+        /* Seeking around throws read ahead data away, while in-flight reads
+           complete.  The data must still be right. */
+        uint8_t *pbBuf = (uint8_t *)RTMemAlloc(_256K);
+        if (pbBuf)
+        {
+            for (unsigned i = 0; i < 256; i++)
+            {
+                size_t const off = RTRandU32Ex(0, (uint32_t)cbData - 1);
+                size_t const cb  = RTRandU32Ex(1, _256K);
+                size_t cbRead = 0;
+                rc = RTVfsFileReadAt(hVfsFileRA, off, pbBuf, cb, &cbRead);
+                RTTESTI_CHECK_MSG_BREAK(RT_SUCCESS(rc), ("off=%#zx cb=%#zx rc=%Rrc\n", off, cb, rc));
+                RTTESTI_CHECK_MSG_BREAK(   cbRead == RT_MIN(cb, cbData - off)
+                                        && memcmp(pbBuf, &pbData[off], cbRead) == 0,
+                                        ("off=%#zx cb=%#zx cbRead=%#zx\n", off, cb, cbRead));
+
+                /* Read on sequentially for a bit now and then. */
+                if (i % 16 == 0 && off + cbRead + _1M + _4K + 1 <= cbData)
+                {
+                    size_t const offSeq = off + cbRead;
+                    size_t       cbSeq  = 0;
+                    while (cbSeq < _1M && RT_SUCCESS(rc))
+                    {
+                        rc = RTVfsFileRead(hVfsFileRA, pbBuf, _4K + 1, &cbRead);
+                        RTTESTI_CHECK_MSG(   RT_SUCCESS(rc)
+                                          && memcmp(pbBuf, &pbData[offSeq + cbSeq], cbRead) == 0,
+                                          ("off=%#zx rc=%Rrc\n", offSeq + cbSeq, rc));
+                        cbSeq += cbRead;
+                        if (rc == VINF_EOF || !cbRead)
+                            break;
+                    }
+                }
+            }
+            RTMemFree(pbBuf);
+        }
+        RTTESTI_CHECK_RC_OK(RTVfsReadAheadQueryStats(hVfsIosRA, &Stats));
+        RTTESTI_CHECK(Stats.cWindow >= 1 && Stats.cWindow <= Stats.cBuffers);
+        RTTESTI_CHECK(Stats.cMaxWindow >= Stats.cWindow);
+        RTTestIValue("Random wasted", Stats.cWasted, RTTESTUNIT_OCCURRENCES);
+        RTTestIValue("Max window", Stats.cMaxWindow, RTTESTUNIT_OCCURRENCES);
+
+        RTVfsIoStrmRelease(hVfsIosRA);
+        RTVfsFileRelease(hVfsFileRA);
+    }
+
+    /*
+     * A source that isn't a file gets the single sequential reader.
+     */
+    RTTestSub(hTest, "RTVfsCreateReadAheadForIoStream(passthru)");
+    RTTESTI_CHECK_RC_OK(RTVfsFileSeek(hVfsFile, 0, RTFILE_SEEK_BEGIN, NULL));
+    RTMANIFEST hManifest;
+    RTTESTI_CHECK_RC_OK(rc = RTManifestCreate(0 /*fFlags*/, &hManifest));
+    if (RT_SUCCESS(rc))
+    {
+        RTVFSIOSTREAM hVfsIosFile = RTVfsFileToIoStream(hVfsFile);
+        RTVFSIOSTREAM hVfsIosPt;
+        RTTESTI_CHECK_RC_OK(rc = RTManifestEntryAddPassthruIoStream(hManifest, hVfsIosFile, "data", RTMANIFEST_ATTR_SHA256,
+                                                                    true /*fReadOrWrite*/, &hVfsIosPt));
+        RTVfsIoStrmRelease(hVfsIosFile);
+        if (RT_SUCCESS(rc))
+        {
+            RTVFSIOSTREAM hVfsIosRA;
+            RTTESTI_CHECK_RC_OK(rc = RTVfsCreateReadAheadForIoStream(hVfsIosPt, RTVFSREADAHEAD_F_PARALLEL, 0 /*cBuffers*/,
+                                                                     0 /*cbBuffer*/, &hVfsIosRA));
+            if (RT_SUCCESS(rc))
+            {
+                RTVFSREADAHEADSTATS Stats;
+                RTTESTI_CHECK_RC_OK(RTVfsReadAheadQueryStats(hVfsIosRA, &Stats));
+                RTTESTI_CHECK(!Stats.fParallel);
+                RTTESTI_CHECK(Stats.cWorkers == 1);
+                tstVfsReadAheadReadAll(hVfsIosRA, pbData, cbData);
+                RTVfsIoStrmRelease(hVfsIosRA);
+            }
+            RTVfsIoStrmRelease(hVfsIosPt);
+        }
+        RTManifestRelease(hManifest);
+    }
+
+    /* Not a read ahead stream. */
+    RTVFSREADAHEADSTATS Stats;
+    RTVFSIOSTREAM hVfsIosFile = RTVfsFileToIoStream(hVfsFile);
+    RTTestDisableAssertions(hTest);
+    RTTESTI_CHECK_RC(RTVfsReadAheadQueryStats(hVfsIosFile, &Stats), VERR_INVALID_HANDLE);
+    RTTestRestoreAssertions(hTest);
+    RTVfsIoStrmRelease(hVfsIosFile);
+
+    RTVfsFileRelease(hVfsFile);
+
+    tstVfsReadAheadStdFile(hTest, pbData, cbData);
+
+    RTMemFree(pbData);
+}
+
+
 int main(int argc, char **argv)
 {
     RT_NOREF2(argc, argv);
@@ -98,6 +316,7 @@ int main(int argc, char **argv)
     tstVfsIoFromStandardHandle(hTest, RTHANDLESTD_INPUT);
     tstVfsIoFromStandardHandle(hTest, RTHANDLESTD_OUTPUT);
     tstVfsIoFromStandardHandle(hTest, RTHANDLESTD_ERROR);
+    tstVfsReadAhead(hTest);
 
     /*
      * Summary
@@ -37,8 +37,12 @@
 #include <iprt/mem.h>
 #include <iprt/message.h>
 #include <iprt/param.h>
+#include <iprt/rand.h>
 #include <iprt/string.h>
 #include <iprt/test.h>
+#include <iprt/vfs.h>
+
+#include <zlib.h>
 
 
 static void testFile(const char *pszFilename)
@@ -61,6 +65,151 @@ static void testFile(const char *pszFilename)
 }
 
 
+/**
+ * Appends a gzip member to a buffer, optionally with the BGZF size subfield.
+ *
+ * @returns Pointer to the end of the member.
+ */
+static uint8_t *tstGzipAppendMember(uint8_t *pbDst, uint8_t const *pbSrc, uint32_t cbSrc, bool fBlockSize)
+{
+    uint8_t *pbMember = pbDst;
+    *pbDst++ = 0x1f;
+    *pbDst++ = 0x8b;
+    *pbDst++ = 8;                           /* CM=deflate */
+    *pbDst++ = fBlockSize ? 0x04 : 0x00;    /* FLG.FEXTRA */
+    *pbDst++ = 0; *pbDst++ = 0; *pbDst++ = 0; *pbDst++ = 0;
+    *pbDst++ = 0;
+    *pbDst++ = 0xff;                        /* OS=unknown */
+    uint8_t *pbBSize = NULL;
+    if (fBlockSize)
+    {
+        *pbDst++ = 6; *pbDst++ = 0;         /* XLEN */
+        *pbDst++ = 'B'; *pbDst++ = 'C'; *pbDst++ = 2; *pbDst++ = 0;
+        pbBSize = pbDst;
+        pbDst += 2;
+    }
+
+    z_stream Zlib;
+    RT_ZERO(Zlib);
+    RTTESTI_CHECK(deflateInit2(&Zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    Zlib.next_in   = (Bytef *)pbSrc;
+    Zlib.avail_in  = cbSrc;
+    Zlib.next_out  = pbDst;
+    Zlib.avail_out = (uInt)deflateBound(&Zlib, cbSrc);
+    RTTESTI_CHECK(deflate(&Zlib, Z_FINISH) == Z_STREAM_END);
+    pbDst += Zlib.total_out;
+    deflateEnd(&Zlib);
+
+    uint32_t const uCrc32 = crc32(crc32(0, NULL, 0), pbSrc, cbSrc);
+    *pbDst++ = RT_BYTE1(uCrc32); *pbDst++ = RT_BYTE2(uCrc32); *pbDst++ = RT_BYTE3(uCrc32); *pbDst++ = RT_BYTE4(uCrc32);
+    *pbDst++ = RT_BYTE1(cbSrc);  *pbDst++ = RT_BYTE2(cbSrc);  *pbDst++ = RT_BYTE3(cbSrc);  *pbDst++ = RT_BYTE4(cbSrc);
+
+    if (pbBSize)
+    {
+        size_t const cbMember = pbDst - pbMember;
+        RTTESTI_CHECK(cbMember <= _64K);
+        pbBSize[0] = RT_BYTE1(cbMember - 1);
+        pbBSize[1] = RT_BYTE2(cbMember - 1);
+    }
+    return pbDst;
+}
+
+
+/**
+ * Decompresses a gzip stream from memory and compares it with the expected data.
+ */
+static void tstGzipDecompress(uint8_t const *pbGzip, size_t cbGzip, uint8_t const *pbExpect, size_t cbExpect,
+                              int rcExpect)
+{
+    RTVFSFILE hVfsFile;
+    RTTESTI_CHECK_RC_RETV(RTVfsFileFromBuffer(RTFILE_O_READ, pbGzip, cbGzip, &hVfsFile), VINF_SUCCESS);
+    RTVFSIOSTREAM hVfsIosSrc = RTVfsFileToIoStream(hVfsFile);
+    RTVfsFileRelease(hVfsFile);
+
+    RTVFSIOSTREAM hVfsIos;
+    int rc = RTZipGzipDecompressIoStream(hVfsIosSrc, RTZIPGZIPDECOMP_F_PARALLEL, &hVfsIos);
+    RTVfsIoStrmRelease(hVfsIosSrc);
+    RTTESTI_CHECK_RC_OK_RETV(rc);
+
+    uint8_t *pbOut = (uint8_t *)RTMemAlloc(cbExpect + _64K);
+    size_t   cbOut = 0;
+    for (;;)
+    {
+        /* Odd sized reads so they straddle the member boundaries. */
+        size_t cbRead = 0;
+        rc = RTVfsIoStrmRead(hVfsIos, &pbOut[cbOut], RT_MIN(12345, cbExpect + _64K - cbOut), true /*fBlocking*/, &cbRead);
+        cbOut += cbRead;
+        if (rc != VINF_SUCCESS || cbOut >= cbExpect + _64K)
+            break;
+    }
+    if (rcExpect == VINF_SUCCESS)
+    {
+        RTTESTI_CHECK_RC(rc, VINF_EOF);
+        RTTESTI_CHECK_MSG(cbOut == cbExpect, ("cbOut=%zu cbExpect=%zu\n", cbOut, cbExpect));
+        RTTESTI_CHECK(cbOut != cbExpect || memcmp(pbOut, pbExpect, cbExpect) == 0);
+    }
+    else
+        RTTESTI_CHECK_RC(rc, rcExpect);
+
+    RTMemFree(pbOut);
+    RTVfsIoStrmRelease(hVfsIos);
+}
+
+
+/**
+ * Tests RTZIPGZIPDECOMP_F_PARALLEL with block-wise and plain gzip input.
+ */
+static void testGzipParallel(void)
+{
+    RTTestISub("gzip parallel inflate");
+
+    /* Compressible but not trivial input. */
+    uint32_t const cbData = _4M + 1234;
+    uint8_t *pbData = (uint8_t *)RTMemAlloc(cbData);
+    uint8_t *pbGzip = (uint8_t *)RTMemAlloc(cbData + cbData / 8 + _1M);
+    RTTESTI_CHECK_RETV(pbData && pbGzip);
+    for (uint32_t off = 0; off < cbData; off++)
+        pbData[off] = (uint8_t)(RTRandU32Ex(0, 15) + (off >> 12));
+
+    /* Block-wise, 60000 bytes per member and the empty end member. */
+    uint8_t *pbDst = pbGzip;
+    for (uint32_t off = 0; off < cbData; off += 60000)
+        pbDst = tstGzipAppendMember(pbDst, &pbData[off], RT_MIN(60000, cbData - off), true /*fBlockSize*/);
+    pbDst = tstGzipAppendMember(pbDst, pbData, 0, true /*fBlockSize*/);
+    size_t const cbGzip = pbDst - pbGzip;
+    tstGzipDecompress(pbGzip, cbGzip, pbData, cbData, VINF_SUCCESS);
+
+    /* A corrupted CRC in the middle must be reported. */
+    uint8_t *pbBad = (uint8_t *)RTMemDup(pbGzip, cbGzip);
+    uint32_t const cbFirst = RT_MAKE_U16(pbGzip[16], pbGzip[17]) + 1;
+    pbBad[cbFirst - 8] ^= 0x55;
+    tstGzipDecompress(pbBad, cbGzip, pbData, cbData, VERR_ZIP_CORRUPTED);
+    RTMemFree(pbBad);
+
+    /* A small BGZF file ending with the canonical EOF block, where the empty
+       member lands in a block that has never had an output buffer. */
+    static uint8_t const s_abBgzfEof[28] =
+    {
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+        0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    pbDst = tstGzipAppendMember(pbGzip, pbData, 100, true /*fBlockSize*/);
+    memcpy(pbDst, s_abBgzfEof, sizeof(s_abBgzfEof));
+    pbDst += sizeof(s_abBgzfEof);
+    tstGzipDecompress(pbGzip, pbDst - pbGzip, pbData, 100, VINF_SUCCESS);
+
+    /* Just the EOF block. */
+    tstGzipDecompress(s_abBgzfEof, sizeof(s_abBgzfEof), pbData, 0, VINF_SUCCESS);
+
+    /* A plain single member gzip falls back on the normal decompressor. */
+    pbDst = tstGzipAppendMember(pbGzip, pbData, cbData, false /*fBlockSize*/);
+    tstGzipDecompress(pbGzip, pbDst - pbGzip, pbData, cbData, VINF_SUCCESS);
+
+    RTMemFree(pbGzip);
+    RTMemFree(pbData);
+}
+
+
 int main(int argc, char **argv)
 {
     RTTEST hTest;
@@ -75,9 +224,7 @@ int main(int argc, char **argv)
             testFile(argv[i]);
     }
     else
-    {
-        /** @todo testcase */
-    }
+        testGzipParallel();
 
     /*
      * Summary.
@@ -0,0 +1,126 @@
+/* $Id$ */
+/** @file
+ * IPRT - Binary Log File Decoder.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/log.h>
+
+#include <iprt/buildconfig.h>
+#include <iprt/err.h>
+#include <iprt/getopt.h>
+#include <iprt/initterm.h>
+#include <iprt/message.h>
+#include <iprt/path.h>
+#include <iprt/stream.h>
+#include <iprt/string.h>
+
+
+/**
+ * Output callback writing to the output stream.
+ */
+static DECLCALLBACK(size_t) rtLogDecodeOutput(void *pvArg, const char *pachChars, size_t cbChars)
+{
+    if (cbChars)
+        RTStrmWrite((PRTSTREAM)pvArg, pachChars, cbChars);
+    return cbChars;
+}
+
+
+int main(int argc, char **argv)
+{
+    int rc = RTR3InitExe(argc, &argv, 0);
+    if (RT_FAILURE(rc))
+        return RTMsgInitFailure(rc);
+
+    static const RTGETOPTDEF s_aOptions[] =
+    {
+        { "--no-prefix",    'n', RTGETOPT_REQ_NOTHING },
+        { "--output",       'o', RTGETOPT_REQ_STRING  },
+    };
+
+    RTEXITCODE  rcExit    = RTEXITCODE_SUCCESS;
+    uint32_t    fFlags    = 0;
+    PRTSTREAM   pOutput   = g_pStdOut;
+    unsigned    cFiles    = 0;
+
+    RTGETOPTSTATE GetState;
+    RTGetOptInit(&GetState, argc, argv, s_aOptions, RT_ELEMENTS(s_aOptions), 1, RTGETOPTINIT_FLAGS_OPTS_FIRST);
+    RTGETOPTUNION ValueUnion;
+    while ((rc = RTGetOpt(&GetState, &ValueUnion)) != 0)
+    {
+        switch (rc)
+        {
+            case 'n':
+                fFlags |= RTLOGBINDECODE_F_NO_PREFIX;
+                break;
+
+            case 'o':
+                if (pOutput != g_pStdOut)
+                    RTStrmClose(pOutput);
+                rc = RTStrmOpen(ValueUnion.psz, "w", &pOutput);
+                if (RT_FAILURE(rc))
+                    return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to open '%s' for writing: %Rrc", ValueUnion.psz, rc);
+                break;
+
+            case VINF_GETOPT_NOT_OPTION:
+                cFiles++;
+                rc = RTLogBinDecodeFile(ValueUnion.psz, fFlags, rtLogDecodeOutput, pOutput);
+                if (RT_FAILURE(rc))
+                    rcExit = RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to decode '%s': %Rrc", ValueUnion.psz, rc);
+                break;
+
+            case 'h':
+                RTPrintf("Usage: %s [--no-prefix] [--output <file>] <log.vboxlog.bin> [..]\n"
+                         "\n"
+                         "Formats log files written with the 'binary' log flag.  Text in the files\n"
+                         "is passed thru as-is.  The files must be decoded on a host with the same\n"
+                         "architecture as the one producing them.\n",
+                         RTPathFilename(argv[0]));
+                return RTEXITCODE_SUCCESS;
+
+            case 'V':
+                RTPrintf("%sr%d\n", RTBldCfgVersion(), RTBldCfgRevision());
+                return RTEXITCODE_SUCCESS;
+
+            default:
+                return RTGetOptPrintError(rc, &ValueUnion);
+        }
+    }
+
+    if (!cFiles)
+        return RTMsgErrorExit(RTEXITCODE_SYNTAX, "No log files specified. Try --help.");
+
+    if (pOutput != g_pStdOut)
+    {
+        rc = RTStrmClose(pOutput);
+        if (RT_FAILURE(rc))
+            rcExit = RTMsgErrorExit(RTEXITCODE_FAILURE, "Error closing the output file: %Rrc", rc);
+    }
+    return rcExit;
+}
+
@@ -32,6 +32,8 @@
 #include <iprt/rand.h>
 #include <iprt/zip.h>
 #include <iprt/asm.h>
+#include <iprt/mp.h>
+#include <iprt/req.h>
 
 #include "VDBackends.h"
 
@@ -306,6 +308,18 @@ typedef struct VMDKEXTENT
  */
 #define VMDK_GT_CACHELINE_SIZE 128
 
+/**
+ * Maximum number of worker threads compressing grains when writing
+ * streamOptimized images.
+ */
+#define VMDK_DEFLATE_MAX_THREADS 8
+
+/**
+ * Number of grains in flight per compression worker thread, gives the
+ * writer some slack when grains take different amounts of time.
+ */
+#define VMDK_DEFLATE_JOBS_PER_THREAD 4
+
 
 /**
  * Maximum number of lines in a descriptor file. Not worth the effort of
@@ -435,9 +449,71 @@ typedef struct VMDKIMAGE
     size_t          cbDescAlloc;
     /** Parsed descriptor file content. */
     VMDKDESCRIPTOR  Descriptor;
+
+    /** Parallel grain compression pipeline for writing streamOptimized
+     * images, NULL if grains are compressed synchronously. */
+    struct VMDKDEFLATEPIPE *pDeflatePipe;
 } VMDKIMAGE;
 
 
+/**
+ * Grain compression job of the parallel streamOptimized writer.
+ */
+typedef struct VMDKDEFLATEJOB
+{
+    /** The worker request, NIL_RTREQ if done on the writing thread. */
+    PRTREQ          hReq;
+    /** Status of the compression, set by the worker. */
+    int             rc;
+    /** Size of the compressed grain incl. marker and padding, set by the
+     * worker. */
+    uint32_t        cbMarkerData;
+    /** The grain number. */
+    uint32_t        uGrain;
+    /** The first sector of the grain (for the marker). */
+    uint64_t        uLBA;
+    /** The uncompressed grain. */
+    void           *pvGrain;
+    /** The compressed grain with marker, VMDKDEFLATEPIPE::cbCompGrain bytes. */
+    void           *pvCompGrain;
+} VMDKDEFLATEJOB;
+/** Pointer to a grain compression job. */
+typedef VMDKDEFLATEJOB *PVMDKDEFLATEJOB;
+
+/**
+ * Parallel grain compression pipeline for writing streamOptimized images.
+ *
+ * The writing thread copies each grain into a job and hands it to the
+ * worker pool.  Grains are written out strictly in submission order (which
+ * is grain order) as soon as the oldest job is done and its slot is needed,
+ * so the file layout is the same as with synchronous compression.  The
+ * grain table entry is only set when the grain is written, as that is when
+ * its file offset is known, so the pipeline has to be drained before a grain
+ * table is flushed.
+ */
+typedef struct VMDKDEFLATEPIPE
+{
+    /** The worker thread pool. */
+    RTREQPOOL       hPool;
+    /** Number of jobs. */
+    uint32_t        cJobs;
+    /** Index of the oldest job in flight, i.e. the next one to write. */
+    uint32_t        iHead;
+    /** Number of jobs in flight. */
+    uint32_t        cBusy;
+    /** Sticky error status, once a grain failed nothing more is written. */
+    int             rcSticky;
+    /** The size of an uncompressed grain. */
+    size_t          cbGrain;
+    /** The size of the compressed grain buffers. */
+    size_t          cbCompGrain;
+    /** The jobs (variable size). */
+    VMDKDEFLATEJOB  aJobs[1];
+} VMDKDEFLATEPIPE;
+/** Pointer to a grain compression pipeline. */
+typedef VMDKDEFLATEPIPE *PVMDKDEFLATEPIPE;
+
+
 /** State for the input/output callout of the inflate reader/deflate writer. */
 typedef struct VMDKCOMPRESSIO
 {
@@ -787,13 +863,12 @@ static DECLCALLBACK(int) vmdkFileDeflateHelper(void *pvUser, const void *pvBuf,
 }
 
 /**
- * Internal: deflate the uncompressed data and write to a file,
- * distinguishing between async and normal operation
+ * Internal: deflate the uncompressed data into a compressed grain buffer and
+ * fill in the grain marker.  Safe to call on any thread.
  */
-DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
-                                    uint64_t uOffset, const void *pvBuf,
-                                    size_t cbToWrite, uint64_t uLBA,
-                                    uint32_t *pcbMarkerData)
+static int vmdkFileDeflateToBuf(PVMDKIMAGE pImage, void *pvCompGrain, size_t cbCompGrain,
+                                const void *pvBuf, size_t cbToWrite, uint64_t uLBA,
+                                uint32_t *pcbMarkerData)
 {
     int rc;
     PRTZIPCOMP pZip = NULL;
@@ -801,8 +876,8 @@ DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
 
     DeflateState.pImage = pImage;
     DeflateState.iOffset = -1;
-    DeflateState.cbCompGrain = pExtent->cbCompGrain;
-    DeflateState.pvCompGrain = pExtent->pvCompGrain;
+    DeflateState.cbCompGrain = cbCompGrain;
+    DeflateState.pvCompGrain = pvCompGrain;
 
     rc = RTZipCompCreate(&pZip, &DeflateState, vmdkFileDeflateHelper,
                          RTZIPTYPE_ZLIB, RTZIPLEVEL_DEFAULT);
@@ -822,23 +897,40 @@ DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
         if (uSize % 512)
         {
             uint32_t uSizeAlign = RT_ALIGN(uSize, 512);
-            memset((uint8_t *)pExtent->pvCompGrain + uSize, '\0',
+            memset((uint8_t *)pvCompGrain + uSize, '\0',
                    uSizeAlign - uSize);
             uSize = uSizeAlign;
         }
 
-        if (pcbMarkerData)
-            *pcbMarkerData = uSize;
+        *pcbMarkerData = uSize;
 
         /* Compressed grain marker. Data follows immediately. */
-        VMDKMARKER *pMarker = (VMDKMARKER *)pExtent->pvCompGrain;
+        VMDKMARKER *pMarker = (VMDKMARKER *)pvCompGrain;
         pMarker->uSector = RT_H2LE_U64(uLBA);
         pMarker->cbSize = RT_H2LE_U32(  DeflateState.iOffset
                                       - RT_OFFSETOF(VMDKMARKER, uType));
+    }
+    return rc;
+}
+
+/**
+ * Internal: deflate the uncompressed data and write to a file,
+ * distinguishing between async and normal operation
+ */
+DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
+                                    uint64_t uOffset, const void *pvBuf,
+                                    size_t cbToWrite, uint64_t uLBA,
+                                    uint32_t *pcbMarkerData)
+{
+    uint32_t cbMarkerData = 0;
+    int rc = vmdkFileDeflateToBuf(pImage, pExtent->pvCompGrain, pExtent->cbCompGrain,
+                                  pvBuf, cbToWrite, uLBA, &cbMarkerData);
+    if (RT_SUCCESS(rc))
+    {
+        if (pcbMarkerData)
+            *pcbMarkerData = cbMarkerData;
         rc = vdIfIoIntFileWriteSync(pImage->pIfIo, pExtent->pFile->pStorage,
-                                    uOffset, pMarker, uSize);
-        if (RT_FAILURE(rc))
-            return rc;
+                                    uOffset, pExtent->pvCompGrain, cbMarkerData);
     }
     return rc;
 }
@@ -2866,6 +2958,197 @@ static void vmdkFreeStreamBuffers(PVMDKEXTENT pExtent)
     }
 }
 
+/**
+ * Internal: worker compressing one grain for the parallel streamOptimized
+ * writer.
+ */
+static DECLCALLBACK(void) vmdkStreamDeflateWorker(PVMDKDEFLATEPIPE pPipe, PVMDKDEFLATEJOB pJob)
+{
+    pJob->rc = vmdkFileDeflateToBuf(NULL, pJob->pvCompGrain, pPipe->cbCompGrain,
+                                    pJob->pvGrain, pPipe->cbGrain, pJob->uLBA,
+                                    &pJob->cbMarkerData);
+}
+
+/**
+ * Internal: destroy the parallel grain compression pipeline, anything still
+ * in flight is waited for and discarded.
+ */
+static void vmdkStreamDeflateDestroy(PVMDKIMAGE pImage)
+{
+    PVMDKDEFLATEPIPE pPipe = pImage->pDeflatePipe;
+    if (!pPipe)
+        return;
+    pImage->pDeflatePipe = NULL;
+
+    for (uint32_t i = 0; i < pPipe->cJobs; i++)
+    {
+        PVMDKDEFLATEJOB pJob = &pPipe->aJobs[i];
+        if (pJob->hReq != NIL_RTREQ)
+        {
+            RTReqWait(pJob->hReq, RT_INDEFINITE_WAIT);
+            RTReqRelease(pJob->hReq);
+        }
+        RTMemFree(pJob->pvGrain);
+        RTMemFree(pJob->pvCompGrain);
+    }
+    RTReqPoolRelease(pPipe->hPool);
+    RTMemFree(pPipe);
+}
+
+/**
+ * Internal: set up parallel grain compression for writing a streamOptimized
+ * image, if there are CPUs to spare.  Failure isn't fatal, the grains are
+ * compressed synchronously then.
+ */
+static void vmdkStreamDeflateCreate(PVMDKIMAGE pImage, PVMDKEXTENT pExtent)
+{
+    uint32_t const cCpus    = RTMpGetOnlineCount();
+    uint32_t const cThreads = RT_MIN(cCpus > 1 ? cCpus - 1 : 0, VMDK_DEFLATE_MAX_THREADS);
+    if (!cThreads)
+        return;
+
+    uint32_t const cJobs = cThreads * VMDK_DEFLATE_JOBS_PER_THREAD;
+    PVMDKDEFLATEPIPE pPipe = (PVMDKDEFLATEPIPE)RTMemAllocZ(RT_OFFSETOF(VMDKDEFLATEPIPE, aJobs[cJobs]));
+    if (!pPipe)
+        return;
+    pPipe->hPool       = NIL_RTREQPOOL;
+    pPipe->cJobs       = cJobs;
+    pPipe->cbGrain     = VMDK_SECTOR2BYTE(pExtent->cSectorsPerGrain);
+    pPipe->cbCompGrain = pExtent->cbCompGrain;
+    pImage->pDeflatePipe = pPipe;
+
+    int rc = VINF_SUCCESS;
+    for (uint32_t i = 0; i < cJobs && RT_SUCCESS(rc); i++)
+    {
+        pPipe->aJobs[i].hReq        = NIL_RTREQ;
+        pPipe->aJobs[i].pvGrain     = RTMemAlloc(pPipe->cbGrain);
+        pPipe->aJobs[i].pvCompGrain = RTMemAlloc(pPipe->cbCompGrain);
+        if (!pPipe->aJobs[i].pvGrain || !pPipe->aJobs[i].pvCompGrain)
+            rc = VERR_NO_MEMORY;
+    }
+    if (RT_SUCCESS(rc))
+        rc = RTReqPoolCreate(cThreads, RT_MS_1SEC, cThreads, 0 /*cMsMaxPushBack*/, "VmdkZip", &pPipe->hPool);
+    if (RT_SUCCESS(rc))
+        LogRel(("VMDK: Using %u threads for compressing '%s'\n", cThreads, pImage->pszFilename));
+    else
+    {
+        LogRel(("VMDK: Failed to set up parallel compression for '%s' (%Rrc), continuing without\n",
+                pImage->pszFilename, rc));
+        vmdkStreamDeflateDestroy(pImage);
+    }
+}
+
+/**
+ * Internal: wait for the oldest grain in the compression pipeline and write
+ * it out, setting its grain table entry.  With fWrite clear, or after an
+ * earlier failure, the grain is just discarded.
+ */
+static int vmdkStreamDeflateWriteOne(PVMDKIMAGE pImage, PVMDKEXTENT pExtent, bool fWrite)
+{
+    PVMDKDEFLATEPIPE pPipe = pImage->pDeflatePipe;
+    Assert(pPipe->cBusy > 0);
+    PVMDKDEFLATEJOB pJob = &pPipe->aJobs[pPipe->iHead];
+    pPipe->iHead = (pPipe->iHead + 1) % pPipe->cJobs;
+    pPipe->cBusy--;
+
+    if (pJob->hReq != NIL_RTREQ)
+    {
+        int rc2 = RTReqWait(pJob->hReq, RT_INDEFINITE_WAIT);
+        AssertRC(rc2);
+        RTReqRelease(pJob->hReq);
+        pJob->hReq = NIL_RTREQ;
+    }
+    if (!fWrite || RT_FAILURE(pPipe->rcSticky))
+        return pPipe->rcSticky;
+
+    int rc = pJob->rc;
+    if (RT_SUCCESS(rc))
+    {
+        uint64_t uFileOffset = pExtent->uAppendPosition;
+        if (!uFileOffset)
+            rc = VERR_INTERNAL_ERROR;
+        else
+        {
+            /* Align to sector, as the previous write could have been any size. */
+            uFileOffset = RT_ALIGN_64(uFileOffset, 512);
+            rc = vdIfIoIntFileWriteSync(pImage->pIfIo, pExtent->pFile->pStorage,
+                                        uFileOffset, pJob->pvCompGrain, pJob->cbMarkerData);
+            if (RT_SUCCESS(rc))
+            {
+                uint32_t uCacheLine = pJob->uGrain % pExtent->cGTEntries / VMDK_GT_CACHELINE_SIZE;
+                uint32_t uCacheEntry = pJob->uGrain % VMDK_GT_CACHELINE_SIZE;
+                pImage->pGTCache->aGTCache[uCacheLine].aGTData[uCacheEntry] = VMDK_BYTE2SECTOR(uFileOffset);
+                pExtent->uAppendPosition += pJob->cbMarkerData;
+                return VINF_SUCCESS;
+            }
+        }
+    }
+
+    pPipe->rcSticky = rc;
+    pExtent->uGrainSectorAbs = 0;
+    AssertRC(rc);
+    return vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("VMDK: cannot write compressed data block in '%s'"), pExtent->pszFullname);
+}
+
+/**
+ * Internal: write out (or discard) all grains in the compression pipeline.
+ */
+static int vmdkStreamDeflateDrain(PVMDKIMAGE pImage, PVMDKEXTENT pExtent, bool fWrite)
+{
+    int rc = VINF_SUCCESS;
+    while (pImage->pDeflatePipe->cBusy > 0)
+    {
+        int rc2 = vmdkStreamDeflateWriteOne(pImage, pExtent, fWrite);
+        if (RT_FAILURE(rc2) && RT_SUCCESS(rc))
+            rc = rc2;
+    }
+    return rc;
+}
+
+/**
+ * Internal: queue a grain for compression, writing out the oldest one if
+ * the pipeline is full.
+ */
+static int vmdkStreamDeflateSubmit(PVMDKIMAGE pImage, PVMDKEXTENT pExtent, uint64_t uSector,
+                                   uint32_t uGrain, PVDIOCTX pIoCtx, uint64_t cbWrite)
+{
+    PVMDKDEFLATEPIPE pPipe = pImage->pDeflatePipe;
+    if (RT_FAILURE(pPipe->rcSticky))
+        return pPipe->rcSticky;
+    if (pPipe->cBusy >= pPipe->cJobs)
+    {
+        int rc = vmdkStreamDeflateWriteOne(pImage, pExtent, true /*fWrite*/);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
+    /* The I/O context is only valid during this call, so take a copy. */
+    PVMDKDEFLATEJOB pJob = &pPipe->aJobs[(pPipe->iHead + pPipe->cBusy) % pPipe->cJobs];
+    Assert(pJob->hReq == NIL_RTREQ);
+    vdIfIoIntIoCtxCopyFrom(pImage->pIfIo, pIoCtx, pJob->pvGrain, cbWrite);
+    if (cbWrite < pPipe->cbGrain)
+        memset((uint8_t *)pJob->pvGrain + cbWrite, '\0', pPipe->cbGrain - cbWrite);
+    pJob->uGrain       = uGrain;
+    pJob->uLBA         = uSector;
+    pJob->cbMarkerData = 0;
+    pJob->rc           = VERR_INTERNAL_ERROR;
+
+    int rc = RTReqPoolCallEx(pPipe->hPool, 0 /*cMillies*/, &pJob->hReq, RTREQFLAGS_VOID,
+                             (PFNRT)vmdkStreamDeflateWorker, 2, pPipe, pJob);
+    if (rc != VINF_SUCCESS && rc != VERR_TIMEOUT)
+    {
+        /* Do it ourselves if the pool is having trouble. */
+        LogRelMax(16, ("VMDK: RTReqPoolCallEx failed: %Rrc\n", rc));
+        if (pJob->hReq != NIL_RTREQ)
+            RTReqRelease(pJob->hReq);
+        pJob->hReq = NIL_RTREQ;
+        vmdkStreamDeflateWorker(pPipe, pJob);
+    }
+    pPipe->cBusy++;
+    pExtent->uLastGrainAccess = uGrain;
+    return VINF_SUCCESS;
+}
+
 /**
  * Internal: free the memory used by the extent data structure, optionally
  * deleting the referenced files.
@@ -3874,6 +4157,9 @@ static int vmdkCreateStreamImage(PVMDKIMAGE pImage, uint64_t cbSize)
     if (RT_FAILURE(rc))
         return vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("VMDK: could not create new grain directory in '%s'"), pExtent->pszFullname);
 
+    /* Compress the grains on worker threads if possible. */
+    vmdkStreamDeflateCreate(pImage, pExtent);
+
     rc = vmdkDescBaseSetStr(pImage, &pImage->Descriptor, "createType",
                             "streamOptimized");
     if (RT_FAILURE(rc))
@@ -4206,9 +4492,18 @@ static int vmdkFreeImage(PVMDKIMAGE pImage, bool fDelete)
 
         if (pImage->uImageFlags & VD_VMDK_IMAGE_FLAGS_STREAM_OPTIMIZED)
         {
+            /* Write out the grains still being compressed, or just wait for
+             * them if the file will be deleted. */
+            if (pImage->pDeflatePipe)
+            {
+                rc = vmdkStreamDeflateDrain(pImage, &pImage->pExtents[0], !fDelete);
+                vmdkStreamDeflateDestroy(pImage);
+            }
+
             /* No need to write any pending data if the file will be deleted
              * or if the new file wasn't successfully created. */
-            if (   !fDelete && pImage->pExtents
+            if (   RT_SUCCESS(rc)
+                && !fDelete && pImage->pExtents
                 && pImage->pExtents[0].cGTEntries
                 && pImage->pExtents[0].uAppendPosition)
             {
@@ -4550,6 +4845,13 @@ static int vmdkStreamAllocGrain(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
 
     if (uGDEntry != uLastGDEntry)
     {
+        /* The grain table entries are set when the grains are written. */
+        if (pImage->pDeflatePipe)
+        {
+            rc = vmdkStreamDeflateDrain(pImage, pExtent, true /*fWrite*/);
+            if (RT_FAILURE(rc))
+                return rc;
+        }
         rc = vmdkStreamFlushGT(pImage, pExtent, uLastGDEntry);
         if (RT_FAILURE(rc))
             return rc;
@@ -4577,6 +4879,18 @@ static int vmdkStreamAllocGrain(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
         || pImage->pGTCache->aGTCache[uCacheLine].aGTData[uCacheEntry])
         return VERR_INTERNAL_ERROR;
 
+    /* The grain table entry of a grain still being compressed isn't set yet,
+     * so check the pipeline as well.  Grains are submitted in ascending
+     * order, so only the newest one can match. */
+    if (   pImage->pDeflatePipe
+        && pImage->pDeflatePipe->cBusy > 0
+        && pImage->pDeflatePipe->aJobs[  (pImage->pDeflatePipe->iHead + pImage->pDeflatePipe->cBusy - 1)
+                                       % pImage->pDeflatePipe->cJobs].uGrain == uGrain)
+        return VERR_INTERNAL_ERROR;
+
+    if (pImage->pDeflatePipe)
+        return vmdkStreamDeflateSubmit(pImage, pExtent, uSector, uGrain, pIoCtx, cbWrite);
+
     /* Update grain table entry. */
     pImage->pGTCache->aGTCache[uCacheLine].aGTData[uCacheEntry] = VMDK_BYTE2SECTOR(uFileOffset);
 
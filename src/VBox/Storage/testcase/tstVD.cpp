@@ -843,6 +843,111 @@ static void tstVmdk()
     RTFileDelete("tmpVDCreate-s003.vmdk");
 }
 
+/**
+ * Writes a streamOptimized VMDK grain by grain (with the grains compressed
+ * on worker threads when there are CPUs to spare), reopens it and compares.
+ * The image spans several grain tables so the pipeline gets drained in the
+ * middle as well as when closing.
+ */
+static int tstVmdkStreamOptimized(const char *pszFilename, uint32_t u32Seed)
+{
+    int rc;
+    PVBOXHDD pVD = NULL;
+    VDGEOMETRY PCHS = { 0, 0, 0 };
+    VDGEOMETRY LCHS = { 0, 0, 0 };
+    uint64_t const cbDisk  = 80 * _1M;
+    size_t const   cbGrain = _64K;
+    PVDINTERFACE     pVDIfs = NULL;
+    VDINTERFACEERROR VDIfError;
+
+#define CHECK(str) \
+    do \
+    { \
+        RTPrintf("%s rc=%Rrc\n", str, rc); \
+        if (RT_FAILURE(rc)) \
+        { \
+            RTMemFree(pbRead); \
+            RTMemFree(pbData); \
+            VDDestroy(pVD); \
+            return rc; \
+        } \
+    } while (0)
+
+    uint8_t *pbData = (uint8_t *)RTMemAlloc((size_t)cbDisk);
+    uint8_t *pbRead = (uint8_t *)RTMemAlloc(cbGrain);
+    if (!pbData || !pbRead)
+    {
+        RTMemFree(pbRead);
+        RTMemFree(pbData);
+        return VERR_NO_MEMORY;
+    }
+
+    /* Compressible grains of varying content, every 7th one left empty. */
+    RNDCTX ctx;
+    initializeRandomGenerator(&ctx, u32Seed);
+    for (size_t off = 0; off < cbDisk; off++)
+        pbData[off] = (off / cbGrain) % 7 == 3 ? 0 : (uint8_t)((RTPRandU32(&ctx) & 15) + off / cbGrain);
+
+    /* Create error interface. */
+    VDIfError.pfnError = tstVDError;
+    VDIfError.pfnMessage = tstVDMessage;
+
+    rc = VDInterfaceAdd(&VDIfError.Core, "tstVD_Error", VDINTERFACETYPE_ERROR,
+                        NULL, sizeof(VDINTERFACEERROR), &pVDIfs);
+    AssertRC(rc);
+
+    rc = VDCreate(pVDIfs, VDTYPE_HDD, &pVD);
+    CHECK("VDCreate()");
+
+    RTFileDelete(pszFilename);
+    rc = VDCreateBase(pVD, "VMDK", pszFilename, cbDisk,
+                      VD_VMDK_IMAGE_FLAGS_STREAM_OPTIMIZED, "Test image",
+                      &PCHS, &LCHS, NULL, VD_OPEN_FLAGS_NORMAL,
+                      NULL, NULL);
+    CHECK("VDCreateBase()");
+
+    for (uint64_t off = 0; off < cbDisk && RT_SUCCESS(rc); off += cbGrain)
+        rc = VDWrite(pVD, off, &pbData[off], cbGrain);
+    CHECK("VDWrite()");
+
+    /* Rewriting the last grain, which is most likely still being
+     * compressed, must be refused and must not end up in the image twice. */
+    memset(pbRead, 0x55, cbGrain);
+    rc = VDWrite(pVD, cbDisk - cbGrain, pbRead, cbGrain);
+    if (RT_SUCCESS(rc))
+    {
+        RTPrintf("tstVD: rewriting the last streamOptimized grain succeeded!\n");
+        g_cErrors++;
+    }
+
+    rc = VDCloseAll(pVD);
+    CHECK("VDCloseAll()");
+
+    rc = VDOpen(pVD, "VMDK", pszFilename, VD_OPEN_FLAGS_READONLY, NULL);
+    CHECK("VDOpen()");
+    for (uint64_t off = 0; off < cbDisk; off += cbGrain)
+    {
+        rc = VDRead(pVD, off, pbRead, cbGrain);
+        if (RT_FAILURE(rc))
+            break;
+        if (memcmp(pbRead, &pbData[off], cbGrain))
+        {
+            RTPrintf("tstVD: streamOptimized data mismatch at %#RX64\n", off);
+            rc = VERR_INTERNAL_ERROR;
+            break;
+        }
+    }
+    CHECK("VDRead()");
+
+    VDCloseAll(pVD);
+    VDDestroy(pVD);
+    RTFileDelete(pszFilename);
+    RTMemFree(pbRead);
+    RTMemFree(pbData);
+#undef CHECK
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     RTR3InitExe(argc, &argv, 0);
@@ -917,6 +1022,13 @@ int main(int argc, char *argv[])
     }
 
     tstVmdk();
+
+    rc = tstVmdkStreamOptimized("tmpVDCreate.vmdk", u32Seed);
+    if (RT_FAILURE(rc))
+    {
+        RTPrintf("tstVD: streamOptimized VMDK test failed! rc=%Rrc\n", rc);
+        g_cErrors++;
+    }
 #endif /* VMDK_TEST */
 #ifdef VDI_TEST
     rc = tstVDCreateDelete("VDI", "tmpVDCreate.vdi", 2 * _4G,
@@ -288,6 +288,25 @@ VMM_INT_DECL(bool) HMIsNestedPagingActive(PVM pVM)
 }
 
 
+/**
+ * Gets the number of times the guest code ran natively with nested paging.
+ *
+ * The guest can change its page tables without exiting when nested paging is
+ * used, so IEM compares this with the count it saw when it last flushed its
+ * TLBs to tell whether they may be stale.
+ *
+ * @returns The number of world switch exits, 0 if nested paging isn't active.
+ * @param   pVCpu       The cross context virtual CPU structure.
+ */
+VMM_INT_DECL(uint32_t) HMGetNestedPagingWorldSwitchExits(PVMCPU pVCpu)
+{
+    PVM pVM = pVCpu->CTX_SUFF(pVM);
+    if (HMIsEnabled(pVM) && pVM->hm.s.fNestedPaging)
+        return ASMAtomicUoReadU32(&pVCpu->hm.s.cWorldSwitchExits);
+    return 0;
+}
+
+
 /**
  * Checks if both nested paging and unhampered guest execution are enabled.
  *
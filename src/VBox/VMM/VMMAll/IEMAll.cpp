@@ -124,6 +124,7 @@
 #include <iprt/assert.h>
 #include <iprt/string.h>
 #include <iprt/x86.h>
+#include "IEMInline.h"
 
 
 /*********************************************************************************************************************************
@@ -832,6 +833,30 @@ DECLINLINE(IEMMODE) iemCalcCpuMode(PCPUMCTX pCtx)
 }
 
 
+/**
+ * Flushes the TLBs if the guest ran natively with nested paging since they were
+ * last flushed.
+ *
+ * The guest can change its page tables and flush its TLB without exiting then,
+ * so the cached translations may be stale.  Doing this here rather than on
+ * every world switch means exits that never get to IEM don't pay for it.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ */
+DECLINLINE(void) iemTlbSyncWithHm(PVMCPU pVCpu)
+{
+    uint32_t const cWorldSwitchExits = HMGetNestedPagingWorldSwitchExits(pVCpu);
+    if (cWorldSwitchExits == pVCpu->iem.s.cHmWorldSwitchExitsTlb)
+    { /* likely */ }
+    else
+    {
+        pVCpu->iem.s.cHmWorldSwitchExitsTlb = cWorldSwitchExits;
+        IEMTlbInvalidateAll(pVCpu, false /*fVmm*/);
+    }
+}
+
+
 /**
  * Initializes the execution state.
  *
@@ -904,6 +929,7 @@ DECLINLINE(void) iemInitExec(PVMCPU pVCpu, bool fBypassHandlers)
     if (!pVCpu->iem.s.fInPatchCode)
         CPUMRawLeave(pVCpu, VINF_SUCCESS);
 #endif
+    iemTlbSyncWithHm(pVCpu);
 
 #ifdef IEM_VERIFICATION_MODE_FULL
     pVCpu->iem.s.fNoRemSavedByExec = pVCpu->iem.s.fNoRem;
@@ -1018,6 +1044,7 @@ DECLINLINE(void) iemInitDecoder(PVMCPU pVCpu, bool fBypassHandlers)
     if (!pVCpu->iem.s.fInPatchCode)
         CPUMRawLeave(pVCpu, VINF_SUCCESS);
 #endif
+    iemTlbSyncWithHm(pVCpu);
 
 #ifdef DBGFTRACE_ENABLED
     switch (enmMode)
@@ -1158,6 +1185,330 @@ DECLINLINE(void) iemReInitDecoder(PVMCPU pVCpu)
 
 
 
+#if defined(IN_RING3) && !defined(IEM_VERIFICATION_MODE_FULL) && !defined(IEM_VERIFICATION_MODE_MINIMAL)
+/** Whether guest pages can be read directly thru IEMTLBENTRY::pbMappingR3 in
+ * this context. */
+# define IEM_WITH_TLB_DIRECT_READS
+#endif
+
+
+/**
+ * Loads the guest page table side of a TLB entry by walking the guest page
+ * tables.
+ *
+ * The physical page side of the entry is left invalid, see iemTlbLoadPhysInfo.
+ *
+ * @returns VBox status code from PGMGstGetPage.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ * @param   pTlbe       The TLB entry to load.
+ * @param   uTag        The TLB tag for @a GCPtr (IEMTLB_CALC_TAG).
+ * @param   GCPtr       The guest virtual address.
+ * @param   pfGstFlags  Where to return the page table flags returned by PGM.
+ */
+IEM_STATIC int iemTlbLoadEntry(PVMCPU pVCpu, PIEMTLBENTRY pTlbe, uint64_t uTag, RTGCPTR GCPtr, uint64_t *pfGstFlags)
+{
+    RTGCPHYS    GCPhys;
+    uint64_t    fFlags;
+    int rc = PGMGstGetPage(pVCpu, GCPtr, &fFlags, &GCPhys);
+    if (RT_SUCCESS(rc))
+    {
+        AssertCompile(IEMTLBE_F_PT_NO_EXEC == 1);
+        AssertCompile(IEMTLBE_F_PT_NO_WRITE == X86_PTE_RW);
+        AssertCompile(IEMTLBE_F_PT_NO_USER == X86_PTE_US);
+        AssertCompile(IEMTLBE_F_PT_NO_DIRTY == X86_PTE_D);
+        pTlbe->uTag             = uTag;
+        pTlbe->fFlagsAndPhysRev = (~fFlags & (X86_PTE_US | X86_PTE_RW | X86_PTE_D)) | (fFlags >> X86_PTE_PAE_BIT_NX);
+        pTlbe->GCPhys           = GCPhys & ~(RTGCPHYS)X86_PAGE_OFFSET_MASK;
+        pTlbe->pbMappingR3      = NULL;
+        *pfGstFlags = fFlags;
+    }
+    else
+        pTlbe->uTag = 0;
+    return rc;
+}
+
+
+#ifdef IEM_WITH_TLB_DIRECT_READS
+/**
+ * Makes sure the physical page side of a TLB entry is up to date.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ * @param   pTlb        The TLB the entry belongs to.
+ * @param   pTlbe       The TLB entry.
+ */
+DECLINLINE(void) iemTlbLoadPhysInfo(PVMCPU pVCpu, PIEMTLB pTlb, PIEMTLBENTRY pTlbe)
+{
+    if (iemTlbIsPhysInfoCurrent(pTlb, pTlbe))
+    { /* likely */ }
+    else
+    {
+        AssertCompile(PGMIEMGCPHYS2PTR_F_NO_WRITE     == IEMTLBE_F_PG_NO_WRITE);
+        AssertCompile(PGMIEMGCPHYS2PTR_F_NO_READ      == IEMTLBE_F_PG_NO_READ);
+        AssertCompile(PGMIEMGCPHYS2PTR_F_NO_MAPPINGR3 == IEMTLBE_F_NO_MAPPINGR3);
+        pTlbe->fFlagsAndPhysRev &= ~(  IEMTLBE_F_PHYS_REV
+                                     | IEMTLBE_F_NO_MAPPINGR3 | IEMTLBE_F_PG_NO_READ | IEMTLBE_F_PG_NO_WRITE);
+        int rc = PGMPhysIemGCPhys2PtrNoLock(pVCpu->CTX_SUFF(pVM), pVCpu, pTlbe->GCPhys, &pTlb->uTlbPhysRev,
+                                            &pTlbe->pbMappingR3, &pTlbe->fFlagsAndPhysRev);
+        if (RT_SUCCESS(rc))
+        { /* likely */ }
+        else
+        {
+            AssertRC(rc);
+            pTlbe->fFlagsAndPhysRev &= ~IEMTLBE_F_PHYS_REV;
+            pTlbe->pbMappingR3       = NULL;
+        }
+    }
+}
+
+
+/**
+ * Gets the ring-3 address of a guest page that can be read directly, loading
+ * the physical page info of the TLB entry if necessary.
+ *
+ * @returns Pointer to the start of the page, NULL if the page has to be read
+ *          the regular way (access handlers, MMIO, no ring-3 mapping, ...).
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ * @param   pTlb        The TLB the entry belongs to.
+ * @param   pTlbe       The TLB entry, valid.
+ */
+DECLINLINE(uint8_t *) iemTlbGetDirectReadPage(PVMCPU pVCpu, PIEMTLB pTlb, PIEMTLBENTRY pTlbe)
+{
+    iemTlbLoadPhysInfo(pVCpu, pTlb, pTlbe);
+    if (   (pTlbe->fFlagsAndPhysRev & (IEMTLBE_F_PHYS_REV | IEMTLBE_F_NO_MAPPINGR3 | IEMTLBE_F_PG_NO_READ))
+        == pTlb->uTlbPhysRev)
+        return pTlbe->pbMappingR3;
+    pTlb->cTlbSlowReadPath++;
+    return NULL;
+}
+#endif /* IEM_WITH_TLB_DIRECT_READS */
+
+
+#if !defined(IEM_WITH_CODE_TLB) && defined(IEM_WITH_TLB_DIRECT_READS)
+/** Whether IEMExecLots uses the decoded instruction cache (IEMDECODEDCACHE).
+ * Hits are verified against guest memory, so this requires direct reads. */
+# define IEM_WITH_DECODED_CACHE
+#endif
+
+#ifdef IEM_WITH_DECODED_CACHE
+
+/**
+ * Flushes the decoded instruction cache.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ */
+IEM_STATIC void iemDecodedCacheFlush(PVMCPU pVCpu)
+{
+    PIEMDECODEDCACHE pCache = &pVCpu->iem.s.DecodedCache;
+    pCache->bmCodePages     = 0;
+    pCache->GCPhysRecording = NIL_RTGCPHYS;
+    if (++pCache->uGeneration == 0)
+    {
+        pCache->uGeneration = 1;
+        PIEMDECODEDINSTR paEntries = pVCpu->iem.s.paDecodedCacheR3;
+        if (paEntries)
+        {
+            unsigned i = IEMDECODEDCACHE_ENTRIES;
+            while (i-- > 0)
+                paEntries[i].uGeneration = 0;
+        }
+    }
+}
+
+
+/**
+ * Notifies the decoded instruction cache about IEM writing to guest memory.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ * @param   GCPhys      The guest physical address being written to.
+ */
+DECLINLINE(void) iemDecodedCacheNoteWrite(PVMCPU pVCpu, RTGCPHYS GCPhys)
+{
+    if (!(pVCpu->iem.s.DecodedCache.bmCodePages & RT_BIT_64((GCPhys >> X86_PAGE_SHIFT) & 63)))
+    { /* likely */ }
+    else
+    {
+        pVCpu->iem.s.DecodedCache.cWriteFlushes++;
+        iemDecodedCacheFlush(pVCpu);
+    }
+}
+
+
+/**
+ * Notes the decoder state once all the prefixes and the opcode byte following
+ * them have been fetched.
+ *
+ * Called by the prefix handlers and IEMExecLots right before dispatching the
+ * opcode byte, the last call for an instruction is the one that counts.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ */
+DECLINLINE(void) iemDecodedCacheNotePrefixes(PVMCPU pVCpu)
+{
+    PIEMDECODEDSTATE pState = &pVCpu->iem.s.DecodedCache.Pending;
+    pState->fPrefixes       = pVCpu->iem.s.fPrefixes;
+    pState->enmCpuMode      = (uint8_t)pVCpu->iem.s.enmCpuMode;
+    pState->enmEffOpSize    = (uint8_t)pVCpu->iem.s.enmEffOpSize;
+    pState->enmEffAddrMode  = (uint8_t)pVCpu->iem.s.enmEffAddrMode;
+    pState->iEffSeg         = pVCpu->iem.s.iEffSeg;
+    pState->uRexReg         = pVCpu->iem.s.uRexReg;
+    pState->uRexB           = pVCpu->iem.s.uRexB;
+    pState->uRexIndex       = pVCpu->iem.s.uRexIndex;
+    pState->idxPrefix       = pVCpu->iem.s.idxPrefix;
+    pState->uVex3rdReg      = pVCpu->iem.s.uVex3rdReg;
+    pState->uVexLength      = pVCpu->iem.s.uVexLength;
+    pState->fEvexStuff      = pVCpu->iem.s.fEvexStuff;
+    pState->offOpcode       = pVCpu->iem.s.offOpcode;
+}
+
+
+/**
+ * Looks up the instruction at CS:rIP in the decoded instruction cache.
+ *
+ * The instruction is translated thru the code TLB, only TLB hits on directly
+ * readable pages are considered, anything out of the ordinary is left to the
+ * regular decoder.  A matching entry is only used if its bytes are still what
+ * guest memory holds.  On a cache miss the address is remembered and the page
+ * marked as holding cached code before the instruction executes, so an
+ * instruction modifying its own page isn't recorded, and
+ * iemDecodedCacheRecord adds it after it executed successfully.
+ *
+ * @returns Pointer to the entry on hit, NULL on miss or if the cache is
+ *          disabled.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ * @param   pCtx        The CPU context.
+ */
+DECLINLINE(PCIEMDECODEDINSTR) iemDecodedCacheLookup(PVMCPU pVCpu, PCCPUMCTX pCtx)
+{
+    PIEMDECODEDCACHE pCache = &pVCpu->iem.s.DecodedCache;
+    pCache->GCPhysRecording = NIL_RTGCPHYS;
+    PIEMDECODEDINSTR const paEntries = pVCpu->iem.s.paDecodedCacheR3;
+    if (!paEntries)
+        return NULL;
+
+    RTGCPTR  GCPtrPC;
+    uint32_t cbMax;
+    if (pVCpu->iem.s.enmCpuMode == IEMMODE_64BIT)
+    {
+        if (!IEM_IS_CANONICAL(pCtx->rip))
+            return NULL;
+        GCPtrPC = pCtx->rip;
+        cbMax   = 15;
+    }
+    else
+    {
+        if (pCtx->eip > pCtx->cs.u32Limit)
+            return NULL;
+        GCPtrPC = (uint32_t)pCtx->cs.u64Base + pCtx->eip;
+        cbMax   = pCtx->cs.u32Limit - pCtx->eip + 1;
+    }
+
+    uint64_t        uTag;
+    PIEMTLBENTRY    pTlbe = iemTlbLookup(&pVCpu->iem.s.CodeTlb, GCPtrPC, &uTag);
+    if (   pTlbe->uTag != uTag
+        || (   (pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PT_NO_USER)
+            && pVCpu->iem.s.uCpl == 3)
+        || (   (pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PT_NO_EXEC)
+            && (pCtx->msrEFER & MSR_K6_EFER_NXE)))
+        return NULL;
+    uint8_t const *pbPage = iemTlbGetDirectReadPage(pVCpu, &pVCpu->iem.s.CodeTlb, pTlbe);
+    if (!pbPage)
+        return NULL;
+
+    RTGCPHYS const      GCPhys = pTlbe->GCPhys | (GCPtrPC & X86_PAGE_OFFSET_MASK);
+    uint64_t const      uTlbPhysRev = pVCpu->iem.s.CodeTlb.uTlbPhysRev;
+    PCIEMDECODEDINSTR   pEntry = &paEntries[GCPhys & (IEMDECODEDCACHE_ENTRIES - 1)];
+    if (   pEntry->GCPhys           == GCPhys
+        && pEntry->uGeneration      == pCache->uGeneration
+        && pEntry->uTlbPhysRev      == uTlbPhysRev
+        && pEntry->State.enmCpuMode == (uint8_t)pVCpu->iem.s.enmCpuMode
+        && pEntry->cbInstr          <= cbMax)
+    {
+        if (!memcmp(&pbPage[GCPhys & X86_PAGE_OFFSET_MASK], pEntry->abOpcode, pEntry->cbInstr))
+        {
+            pCache->cHits++;
+            return pEntry;
+        }
+        pCache->cModified++;
+    }
+
+    pCache->cMisses++;
+    pCache->GCPhysRecording      = GCPhys;
+    pCache->uTlbPhysRevRecording = uTlbPhysRev;
+    pCache->bmCodePages         |= RT_BIT_64((GCPhys >> X86_PAGE_SHIFT) & 63);
+    return NULL;
+}
+
+
+/**
+ * Sets up the decoder for replaying a cached instruction.
+ *
+ * @returns The opcode byte following the prefixes.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ * @param   pEntry      The cache entry returned by iemDecodedCacheLookup.
+ */
+DECLINLINE(uint8_t) iemDecodedCacheReplay(PVMCPU pVCpu, PCIEMDECODEDINSTR pEntry)
+{
+    memcpy(pVCpu->iem.s.abOpcode, pEntry->abOpcode, sizeof(pVCpu->iem.s.abOpcode));
+    pVCpu->iem.s.cbOpcode       = pEntry->cbInstr;
+    pVCpu->iem.s.offOpcode      = pEntry->State.offOpcode;
+    pVCpu->iem.s.fPrefixes      = pEntry->State.fPrefixes;
+    pVCpu->iem.s.enmEffOpSize   = (IEMMODE)pEntry->State.enmEffOpSize;
+    pVCpu->iem.s.enmEffAddrMode = (IEMMODE)pEntry->State.enmEffAddrMode;
+    pVCpu->iem.s.iEffSeg        = pEntry->State.iEffSeg;
+    pVCpu->iem.s.uRexReg        = pEntry->State.uRexReg;
+    pVCpu->iem.s.uRexB          = pEntry->State.uRexB;
+    pVCpu->iem.s.uRexIndex      = pEntry->State.uRexIndex;
+    pVCpu->iem.s.idxPrefix      = pEntry->State.idxPrefix;
+    pVCpu->iem.s.uVex3rdReg     = pEntry->State.uVex3rdReg;
+    pVCpu->iem.s.uVexLength     = pEntry->State.uVexLength;
+    pVCpu->iem.s.fEvexStuff     = pEntry->State.fEvexStuff;
+    return pEntry->abOpcode[pEntry->State.offOpcode - 1];
+}
+
+
+/**
+ * Adds the instruction that just executed successfully to the decoded
+ * instruction cache, if iemDecodedCacheLookup started recording it.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      thread.
+ */
+DECLINLINE(void) iemDecodedCacheRecord(PVMCPU pVCpu)
+{
+    PIEMDECODEDCACHE pCache = &pVCpu->iem.s.DecodedCache;
+    RTGCPHYS const   GCPhys = pCache->GCPhysRecording;
+    if (GCPhys != NIL_RTGCPHYS)
+    {
+        /* Skip instructions crossing a page boundary, only the first page
+           would be covered by the write notifications. */
+        uint8_t const cbInstr = pVCpu->iem.s.offOpcode;
+        if (   (GCPhys & X86_PAGE_OFFSET_MASK) + cbInstr <= X86_PAGE_SIZE
+            && pCache->Pending.offOpcode > 0
+            && pCache->Pending.offOpcode <= cbInstr)
+        {
+            PIEMDECODEDINSTR pEntry = &pVCpu->iem.s.paDecodedCacheR3[GCPhys & (IEMDECODEDCACHE_ENTRIES - 1)];
+            pEntry->GCPhys      = GCPhys;
+            pEntry->uTlbPhysRev = pCache->uTlbPhysRevRecording;
+            pEntry->uGeneration = pCache->uGeneration;
+            pEntry->cbInstr     = cbInstr;
+            pEntry->State       = pCache->Pending;
+            memcpy(pEntry->abOpcode, pVCpu->iem.s.abOpcode, sizeof(pVCpu->iem.s.abOpcode));
+        }
+        pCache->GCPhysRecording = NIL_RTGCPHYS;
+    }
+}
+
+#endif /* IEM_WITH_DECODED_CACHE */
+
+
 /**
  * Prefetch opcodes the first time when starting executing.
  *
@@ -1226,31 +1577,47 @@ IEM_STATIC VBOXSTRICTRC iemInitDecoderAndPrefetchOpcodes(PVMCPU pVCpu, bool fByp
     }
 # endif /* VBOX_WITH_RAW_MODE_NOT_R0 */
 
-    RTGCPHYS    GCPhys;
-    uint64_t    fFlags;
-    int rc = PGMGstGetPage(pVCpu, GCPtrPC, &fFlags, &GCPhys);
-    if (RT_SUCCESS(rc)) { /* probable */ }
+    /*
+     * Look up CS:rIP in the code TLB, walking the guest page tables on a miss.
+     */
+    int             rc;
+    uint64_t        uTag;
+    PIEMTLBENTRY    pTlbe = iemTlbLookup(&pVCpu->iem.s.CodeTlb, GCPtrPC, &uTag);
+    if (pTlbe->uTag == uTag)
+    {
+# ifdef VBOX_WITH_STATISTICS
+        pVCpu->iem.s.CodeTlb.cTlbHits++;
+# endif
+    }
     else
     {
-        Log(("iemInitDecoderAndPrefetchOpcodes: %RGv - rc=%Rrc\n", GCPtrPC, rc));
-        return iemRaisePageFault(pVCpu, GCPtrPC, IEM_ACCESS_INSTRUCTION, rc);
+        pVCpu->iem.s.CodeTlb.cTlbMisses++;
+        uint64_t fGstFlags;
+        rc = iemTlbLoadEntry(pVCpu, pTlbe, uTag, GCPtrPC, &fGstFlags);
+        if (RT_SUCCESS(rc)) { /* probable */ }
+        else
+        {
+            Log(("iemInitDecoderAndPrefetchOpcodes: %RGv - rc=%Rrc\n", GCPtrPC, rc));
+            return iemRaisePageFault(pVCpu, GCPtrPC, IEM_ACCESS_INSTRUCTION, rc);
+        }
     }
-    if ((fFlags & X86_PTE_US) || pVCpu->iem.s.uCpl != 3) { /* likely */ }
+    if (!(pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PT_NO_USER) || pVCpu->iem.s.uCpl != 3) { /* likely */ }
     else
     {
         Log(("iemInitDecoderAndPrefetchOpcodes: %RGv - supervisor page\n", GCPtrPC));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pVCpu, GCPtrPC, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    if (!(fFlags & X86_PTE_PAE_NX) || !(pCtx->msrEFER & MSR_K6_EFER_NXE)) { /* likely */ }
+    if (!(pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PT_NO_EXEC) || !(pCtx->msrEFER & MSR_K6_EFER_NXE)) { /* likely */ }
     else
     {
         Log(("iemInitDecoderAndPrefetchOpcodes: %RGv - NX\n", GCPtrPC));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pVCpu, GCPtrPC, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    GCPhys |= GCPtrPC & PAGE_OFFSET_MASK;
+    RTGCPHYS const GCPhys = pTlbe->GCPhys | (GCPtrPC & PAGE_OFFSET_MASK);
     /** @todo Check reserved bits and such stuff. PGM is better at doing
-     *        that, so do it when implementing the guest virtual address
-     *        TLB... */
+     *        that. */
 
 # ifdef IEM_VERIFICATION_MODE_FULL
     /*
@@ -1293,6 +1660,12 @@ IEM_STATIC VBOXSTRICTRC iemInitDecoderAndPrefetchOpcodes(PVMCPU pVCpu, bool fByp
         if (cbToTryRead > sizeof(pVCpu->iem.s.abOpcode))
             cbToTryRead = sizeof(pVCpu->iem.s.abOpcode);
 
+# ifdef IEM_WITH_TLB_DIRECT_READS
+        uint8_t const *pbPage = iemTlbGetDirectReadPage(pVCpu, &pVCpu->iem.s.CodeTlb, pTlbe);
+        if (pbPage)
+            memcpy(pVCpu->iem.s.abOpcode, &pbPage[GCPtrPC & PAGE_OFFSET_MASK], cbToTryRead);
+        else
+# endif
         if (!pVCpu->iem.s.fBypassHandlers)
         {
             VBOXSTRICTRC rcStrict = PGMPhysRead(pVM, GCPhys, pVCpu->iem.s.abOpcode, cbToTryRead, PGMACCESSORIGIN_IEM);
@@ -1335,7 +1708,10 @@ IEM_STATIC VBOXSTRICTRC iemInitDecoderAndPrefetchOpcodes(PVMCPU pVCpu, bool fByp
 /**
  * Invalidates the IEM TLBs.
  *
- * This is called internally as well as by PGM when moving GC mappings.
+ * This is called internally as well as by PGM when moving GC mappings and
+ * flushing the guest TLB (CR3 loads, paging mode changes and such).  After the
+ * guest ran natively with nested paging, iemTlbSyncWithHm calls it the next
+ * time IEM is used.
  *
  * @returns
  * @param   pVCpu       The cross context virtual CPU structure of the calling
@@ -1346,31 +1722,12 @@ VMM_INT_DECL(void) IEMTlbInvalidateAll(PVMCPU pVCpu, bool fVmm)
 {
 #ifdef IEM_WITH_CODE_TLB
     pVCpu->iem.s.cbInstrBufTotal = 0;
-    pVCpu->iem.s.CodeTlb.uTlbRevision += IEMTLB_REVISION_INCR;
-    if (pVCpu->iem.s.CodeTlb.uTlbRevision != 0)
-    { /* very likely */ }
-    else
-    {
-        pVCpu->iem.s.CodeTlb.uTlbRevision = IEMTLB_REVISION_INCR;
-        unsigned i = RT_ELEMENTS(pVCpu->iem.s.CodeTlb.aEntries);
-        while (i-- > 0)
-            pVCpu->iem.s.CodeTlb.aEntries[i].uTag = 0;
-    }
 #endif
-
+    iemTlbInvalidateAllWorker(&pVCpu->iem.s.CodeTlb);
 #ifdef IEM_WITH_DATA_TLB
-    pVCpu->iem.s.DataTlb.uTlbRevision += IEMTLB_REVISION_INCR;
-    if (pVCpu->iem.s.DataTlb.uTlbRevision != 0)
-    { /* very likely */ }
-    else
-    {
-        pVCpu->iem.s.DataTlb.uTlbRevision = IEMTLB_REVISION_INCR;
-        unsigned i = RT_ELEMENTS(pVCpu->iem.s.DataTlb.aEntries);
-        while (i-- > 0)
-            pVCpu->iem.s.DataTlb.aEntries[i].uTag = 0;
-    }
+    iemTlbInvalidateAllWorker(&pVCpu->iem.s.DataTlb);
 #endif
-    NOREF(pVCpu); NOREF(fVmm);
+    NOREF(fVmm);
 }
 
 
@@ -1383,27 +1740,19 @@ VMM_INT_DECL(void) IEMTlbInvalidateAll(PVMCPU pVCpu, bool fVmm)
  */
 VMM_INT_DECL(void) IEMTlbInvalidatePage(PVMCPU pVCpu, RTGCPTR GCPtr)
 {
-#if defined(IEM_WITH_CODE_TLB) || defined(IEM_WITH_DATA_TLB)
-    GCPtr = GCPtr >> X86_PAGE_SHIFT;
     AssertCompile(RT_ELEMENTS(pVCpu->iem.s.CodeTlb.aEntries) == 256);
     AssertCompile(RT_ELEMENTS(pVCpu->iem.s.DataTlb.aEntries) == 256);
-    uintptr_t idx = (uint8_t)GCPtr;
-
-# ifdef IEM_WITH_CODE_TLB
-    if (pVCpu->iem.s.CodeTlb.aEntries[idx].uTag == (GCPtr | pVCpu->iem.s.CodeTlb.uTlbRevision))
+    uint64_t const uTagNoRev = IEMTLB_CALC_TAG_NO_REV(GCPtr);
+    if (iemTlbInvalidatePageWorker(&pVCpu->iem.s.CodeTlb, uTagNoRev))
     {
-        pVCpu->iem.s.CodeTlb.aEntries[idx].uTag = 0;
-        if (GCPtr == (pVCpu->iem.s.uInstrBufPc >> X86_PAGE_SHIFT))
+#ifdef IEM_WITH_CODE_TLB
+        if (uTagNoRev == IEMTLB_CALC_TAG_NO_REV(pVCpu->iem.s.uInstrBufPc))
             pVCpu->iem.s.cbInstrBufTotal = 0;
+#endif
     }
-# endif
 
-# ifdef IEM_WITH_DATA_TLB
-    if (pVCpu->iem.s.DataTlb.aEntries[idx].uTag == (GCPtr | pVCpu->iem.s.DataTlb.uTlbRevision))
-        pVCpu->iem.s.DataTlb.aEntries[idx].uTag = 0;
-# endif
-#else
-    NOREF(pVCpu); NOREF(GCPtr);
+#ifdef IEM_WITH_DATA_TLB
+    iemTlbInvalidatePageWorker(&pVCpu->iem.s.DataTlb, uTagNoRev);
 #endif
 }
 
@@ -1418,51 +1767,28 @@ VMM_INT_DECL(void) IEMTlbInvalidatePage(PVMCPU pVCpu, RTGCPTR GCPtr)
  */
 VMM_INT_DECL(void) IEMTlbInvalidateAllPhysical(PVMCPU pVCpu)
 {
-#if defined(IEM_WITH_CODE_TLB) || defined(IEM_WITH_DATA_TLB)
-    /* Note! This probably won't end up looking exactly like this, but it give an idea... */
-
-# ifdef IEM_WITH_CODE_TLB
+#ifdef IEM_WITH_CODE_TLB
     pVCpu->iem.s.cbInstrBufTotal = 0;
-# endif
-    uint64_t uTlbPhysRev = pVCpu->iem.s.CodeTlb.uTlbPhysRev + IEMTLB_PHYS_REV_INCR;
-    if (uTlbPhysRev != 0)
-    {
-        pVCpu->iem.s.CodeTlb.uTlbPhysRev = uTlbPhysRev;
-        pVCpu->iem.s.DataTlb.uTlbPhysRev = uTlbPhysRev;
-    }
-    else
-    {
-        pVCpu->iem.s.CodeTlb.uTlbPhysRev = IEMTLB_PHYS_REV_INCR;
-        pVCpu->iem.s.DataTlb.uTlbPhysRev = IEMTLB_PHYS_REV_INCR;
-
-        unsigned i;
-# ifdef IEM_WITH_CODE_TLB
-        i = RT_ELEMENTS(pVCpu->iem.s.CodeTlb.aEntries);
-        while (i-- > 0)
-        {
-            pVCpu->iem.s.CodeTlb.aEntries[i].pbMappingR3       = NULL;
-            pVCpu->iem.s.CodeTlb.aEntries[i].fFlagsAndPhysRev &= ~(IEMTLBE_F_PG_NO_WRITE | IEMTLBE_F_PG_NO_READ | IEMTLBE_F_PHYS_REV);
-        }
-# endif
-# ifdef IEM_WITH_DATA_TLB
-        i = RT_ELEMENTS(pVCpu->iem.s.DataTlb.aEntries);
-        while (i-- > 0)
-        {
-            pVCpu->iem.s.DataTlb.aEntries[i].pbMappingR3       = NULL;
-            pVCpu->iem.s.DataTlb.aEntries[i].fFlagsAndPhysRev &= ~(IEMTLBE_F_PG_NO_WRITE | IEMTLBE_F_PG_NO_READ | IEMTLBE_F_PHYS_REV);
-        }
-# endif
-    }
-#else
-    NOREF(pVCpu);
 #endif
+    uint64_t const uTlbPhysRev = pVCpu->iem.s.CodeTlb.uTlbPhysRev + IEMTLB_PHYS_REV_INCR;
+    iemTlbInvalidateAllPhysicalWorker(&pVCpu->iem.s.CodeTlb, uTlbPhysRev);
+    iemTlbInvalidateAllPhysicalWorker(&pVCpu->iem.s.DataTlb, uTlbPhysRev);
 }
 
 
 /**
- * Invalidates the host physical aspects of the IEM TLBs.
+ * Invalidates the host physical aspects of the IEM TLBs on all virtual CPUs.
  *
- * This is called internally as well as by PGM when moving GC mappings.
+ * This is called by PGM whenever the backing, the access handler state or the
+ * host mapping of guest physical pages changes.
+ *
+ * The calling EMT does a regular IEMTlbInvalidateAllPhysical.  The TLBs of the
+ * other virtual CPUs only get their physical revision bumped atomically, since
+ * their owners may be using them concurrently.  The revision is 56 bits wide,
+ * so it cannot realistically wrap around for another EMT, but should it do so
+ * the revision is set to something that is very unlikely to match any
+ * entry and the owner will do the proper wraparound cleanup the next time it
+ * invalidates its TLBs.
  *
  * @param   pVM         The cross context VM structure.
  *
@@ -1470,9 +1796,24 @@ VMM_INT_DECL(void) IEMTlbInvalidateAllPhysical(PVMCPU pVCpu)
  */
 VMM_INT_DECL(void) IEMTlbInvalidateAllPhysicalAllCpus(PVM pVM)
 {
-    RT_NOREF_PV(pVM);
+    PVMCPU pVCpuCaller = VMMGetCpu(pVM);
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PVMCPU pVCpu = &pVM->aCpus[idCpu];
+        if (pVCpu == pVCpuCaller)
+            IEMTlbInvalidateAllPhysical(pVCpu);
+        else
+        {
+            uint64_t uTlbPhysRev = ASMAtomicReadU64(&pVCpu->iem.s.CodeTlb.uTlbPhysRev) + IEMTLB_PHYS_REV_INCR;
+            if (RT_UNLIKELY(uTlbPhysRev == 0))
+                uTlbPhysRev = IEMTLB_PHYS_REV_INCR * 2;
+            ASMAtomicWriteU64(&pVCpu->iem.s.CodeTlb.uTlbPhysRev, uTlbPhysRev);
+            ASMAtomicWriteU64(&pVCpu->iem.s.DataTlb.uTlbPhysRev, uTlbPhysRev);
+        }
+    }
 }
 
+
 #ifdef IEM_WITH_CODE_TLB
 
 /**
@@ -1566,9 +1907,9 @@ IEM_STATIC void iemOpcodeFetchBytesJmp(PVMCPU pVCpu, size_t cbDst, void *pvDst)
         /*
          * Get the TLB entry for this piece of code.
          */
-        uint64_t     uTag  = (GCPtrFirst >> X86_PAGE_SHIFT) | pVCpu->iem.s.CodeTlb.uTlbRevision;
+        uint64_t     uTag  = IEMTLB_CALC_TAG(&pVCpu->iem.s.CodeTlb, GCPtrFirst);
         AssertCompile(RT_ELEMENTS(pVCpu->iem.s.CodeTlb.aEntries) == 256);
-        PIEMTLBENTRY pTlbe = &pVCpu->iem.s.CodeTlb.aEntries[(uint8_t)uTag];
+        PIEMTLBENTRY pTlbe = IEMTLB_TAG_TO_ENTRY(&pVCpu->iem.s.CodeTlb, uTag);
         if (pTlbe->uTag == uTag)
         {
             /* likely when executing lots of code, otherwise unlikely */
@@ -1841,29 +2182,42 @@ IEM_STATIC VBOXSTRICTRC iemOpcodeFetchMoreBytes(PVMCPU pVCpu, size_t cbMin)
     }
 # endif /* VBOX_WITH_RAW_MODE_NOT_R0 */
 
-    RTGCPHYS    GCPhys;
-    uint64_t    fFlags;
-    int rc = PGMGstGetPage(pVCpu, GCPtrNext, &fFlags, &GCPhys);
-    if (RT_FAILURE(rc))
+    int             rc;
+    uint64_t        uTag;
+    PIEMTLBENTRY    pTlbe = iemTlbLookup(&pVCpu->iem.s.CodeTlb, GCPtrNext, &uTag);
+    if (pTlbe->uTag == uTag)
     {
-        Log(("iemOpcodeFetchMoreBytes: %RGv - rc=%Rrc\n", GCPtrNext, rc));
-        return iemRaisePageFault(pVCpu, GCPtrNext, IEM_ACCESS_INSTRUCTION, rc);
+# ifdef VBOX_WITH_STATISTICS
+        pVCpu->iem.s.CodeTlb.cTlbHits++;
+# endif
     }
-    if (!(fFlags & X86_PTE_US) && pVCpu->iem.s.uCpl == 3)
+    else
+    {
+        pVCpu->iem.s.CodeTlb.cTlbMisses++;
+        uint64_t fGstFlags;
+        rc = iemTlbLoadEntry(pVCpu, pTlbe, uTag, GCPtrNext, &fGstFlags);
+        if (RT_FAILURE(rc))
+        {
+            Log(("iemOpcodeFetchMoreBytes: %RGv - rc=%Rrc\n", GCPtrNext, rc));
+            return iemRaisePageFault(pVCpu, GCPtrNext, IEM_ACCESS_INSTRUCTION, rc);
+        }
+    }
+    if ((pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PT_NO_USER) && pVCpu->iem.s.uCpl == 3)
     {
         Log(("iemOpcodeFetchMoreBytes: %RGv - supervisor page\n", GCPtrNext));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pVCpu, GCPtrNext, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    if ((fFlags & X86_PTE_PAE_NX) && (pCtx->msrEFER & MSR_K6_EFER_NXE))
+    if ((pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PT_NO_EXEC) && (pCtx->msrEFER & MSR_K6_EFER_NXE))
     {
         Log(("iemOpcodeFetchMoreBytes: %RGv - NX\n", GCPtrNext));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pVCpu, GCPtrNext, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    GCPhys |= GCPtrNext & PAGE_OFFSET_MASK;
+    RTGCPHYS const GCPhys = pTlbe->GCPhys | (GCPtrNext & PAGE_OFFSET_MASK);
     Log5(("GCPtrNext=%RGv GCPhys=%RGp cbOpcodes=%#x\n",  GCPtrNext,  GCPhys,  pVCpu->iem.s.cbOpcode));
     /** @todo Check reserved bits and such stuff. PGM is better at doing
-     *        that, so do it when implementing the guest virtual address
-     *        TLB... */
+     *        that. */
 
     /*
      * Read the bytes at this address.
@@ -1872,6 +2226,12 @@ IEM_STATIC VBOXSTRICTRC iemOpcodeFetchMoreBytes(PVMCPU pVCpu, size_t cbMin)
      * and since PATM should only patch the start of an instruction there
      * should be no need to check again here.
      */
+# ifdef IEM_WITH_TLB_DIRECT_READS
+    uint8_t const *pbPage = iemTlbGetDirectReadPage(pVCpu, &pVCpu->iem.s.CodeTlb, pTlbe);
+    if (pbPage)
+        memcpy(&pVCpu->iem.s.abOpcode[pVCpu->iem.s.cbOpcode], &pbPage[GCPtrNext & PAGE_OFFSET_MASK], cbToTryRead);
+    else
+# endif
     if (!pVCpu->iem.s.fBypassHandlers)
     {
         VBOXSTRICTRC rcStrict = PGMPhysRead(pVCpu->CTX_SUFF(pVM), GCPhys, &pVCpu->iem.s.abOpcode[pVCpu->iem.s.cbOpcode],
@@ -7606,6 +7966,110 @@ iemMemApplySegment(PVMCPU pVCpu, uint32_t fAccess, uint8_t iSegReg, size_t cbMem
 IEM_STATIC VBOXSTRICTRC
 iemMemPageTranslateAndCheckAccess(PVMCPU pVCpu, RTGCPTR GCPtrMem, uint32_t fAccess, PRTGCPHYS pGCPhysMem)
 {
+#ifdef IEM_WITH_DATA_TLB
+    /*
+     * Look up the page in the data TLB, walking the guest page tables on a miss.
+     */
+    uint64_t        uTag;
+    PIEMTLBENTRY    pTlbe = iemTlbLookup(&pVCpu->iem.s.DataTlb, GCPtrMem, &uTag);
+    uint64_t        fGstFlags;
+    bool const      fMiss = pTlbe->uTag != uTag;
+    if (!fMiss)
+    {
+# ifdef VBOX_WITH_STATISTICS
+        pVCpu->iem.s.DataTlb.cTlbHits++;
+# endif
+        fGstFlags = 0; /* shut up gcc */
+    }
+    else
+    {
+        pVCpu->iem.s.DataTlb.cTlbMisses++;
+        int rc = iemTlbLoadEntry(pVCpu, pTlbe, uTag, GCPtrMem, &fGstFlags);
+        if (RT_FAILURE(rc))
+        {
+            /** @todo Check unassigned memory in unpaged mode. */
+            /** @todo Reserved bits in page tables. Requires new PGM interface. */
+            *pGCPhysMem = NIL_RTGCPHYS;
+            return iemRaisePageFault(pVCpu, GCPtrMem, fAccess, rc);
+        }
+    }
+
+    /* If the page is writable and does not have the no-exec bit set, all
+       access is allowed.  Otherwise we'll have to check more carefully... */
+    uint64_t const fTlbFlags = pTlbe->fFlagsAndPhysRev;
+    if (fTlbFlags & (IEMTLBE_F_PT_NO_WRITE | IEMTLBE_F_PT_NO_USER | IEMTLBE_F_PT_NO_EXEC))
+    {
+        /* Write to read only memory? */
+        if (   (fAccess & IEM_ACCESS_TYPE_WRITE)
+            && (fTlbFlags & IEMTLBE_F_PT_NO_WRITE)
+            && (   pVCpu->iem.s.uCpl == 3
+                || (IEM_GET_CTX(pVCpu)->cr0 & X86_CR0_WP)))
+        {
+            Log(("iemMemPageTranslateAndCheckAccess: GCPtrMem=%RGv - read-only page -> #PF\n", GCPtrMem));
+            pTlbe->uTag = 0;
+            *pGCPhysMem = NIL_RTGCPHYS;
+            return iemRaisePageFault(pVCpu, GCPtrMem, fAccess & ~IEM_ACCESS_TYPE_READ, VERR_ACCESS_DENIED);
+        }
+
+        /* Kernel memory accessed by userland? */
+        if (   (fTlbFlags & IEMTLBE_F_PT_NO_USER)
+            && pVCpu->iem.s.uCpl == 3
+            && !(fAccess & IEM_ACCESS_WHAT_SYS))
+        {
+            Log(("iemMemPageTranslateAndCheckAccess: GCPtrMem=%RGv - user access to kernel page -> #PF\n", GCPtrMem));
+            pTlbe->uTag = 0;
+            *pGCPhysMem = NIL_RTGCPHYS;
+            return iemRaisePageFault(pVCpu, GCPtrMem, fAccess, VERR_ACCESS_DENIED);
+        }
+
+        /* Executing non-executable memory? */
+        if (   (fAccess & IEM_ACCESS_TYPE_EXEC)
+            && (fTlbFlags & IEMTLBE_F_PT_NO_EXEC)
+            && (IEM_GET_CTX(pVCpu)->msrEFER & MSR_K6_EFER_NXE) )
+        {
+            Log(("iemMemPageTranslateAndCheckAccess: GCPtrMem=%RGv - NX -> #PF\n", GCPtrMem));
+            pTlbe->uTag = 0;
+            *pGCPhysMem = NIL_RTGCPHYS;
+            return iemRaisePageFault(pVCpu, GCPtrMem, fAccess & ~(IEM_ACCESS_TYPE_READ | IEM_ACCESS_TYPE_WRITE),
+                                     VERR_ACCESS_DENIED);
+        }
+    }
+
+    /*
+     * Set the dirty / access flags.
+     * ASSUMES this is set when the address is translated rather than on committ...
+     *
+     * The accessed bit is always set when loading the entry, so on a hit we
+     * only need to care about the first write to a clean page.
+     */
+    /** @todo testcase: check when A and D bits are actually set by the CPU.  */
+    if (fMiss)
+    {
+        uint32_t fAccessedDirty = fAccess & IEM_ACCESS_TYPE_WRITE ? X86_PTE_D | X86_PTE_A : X86_PTE_A;
+        if ((fGstFlags & fAccessedDirty) != fAccessedDirty)
+        {
+            int rc2 = PGMGstModifyPage(pVCpu, GCPtrMem, 1, fAccessedDirty, ~(uint64_t)fAccessedDirty);
+            AssertRC(rc2);
+        }
+        if (fAccess & IEM_ACCESS_TYPE_WRITE)
+            pTlbe->fFlagsAndPhysRev &= ~IEMTLBE_F_PT_NO_DIRTY;
+    }
+    else if (   (fAccess & IEM_ACCESS_TYPE_WRITE)
+             && (fTlbFlags & IEMTLBE_F_PT_NO_DIRTY))
+    {
+        int rc2 = PGMGstModifyPage(pVCpu, GCPtrMem, 1, X86_PTE_D | X86_PTE_A, ~(uint64_t)(X86_PTE_D | X86_PTE_A));
+        AssertRC(rc2);
+        pTlbe->fFlagsAndPhysRev &= ~IEMTLBE_F_PT_NO_DIRTY;
+    }
+
+    *pGCPhysMem = pTlbe->GCPhys | (GCPtrMem & PAGE_OFFSET_MASK);
+# ifdef IEM_WITH_DECODED_CACHE
+    if (fAccess & IEM_ACCESS_TYPE_WRITE)
+        iemDecodedCacheNoteWrite(pVCpu, pTlbe->GCPhys);
+# endif
+    return VINF_SUCCESS;
+
+#else  /* !IEM_WITH_DATA_TLB */
     /** @todo Need a different PGM interface here.  We're currently using
      *        generic / REM interfaces. this won't cut it for R0 & RC. */
     RTGCPHYS    GCPhys;
@@ -7670,7 +8134,12 @@ iemMemPageTranslateAndCheckAccess(PVMCPU pVCpu, RTGCPTR GCPtrMem, uint32_t fAcce
 
     GCPhys |= GCPtrMem & PAGE_OFFSET_MASK;
     *pGCPhysMem = GCPhys;
+# ifdef IEM_WITH_DECODED_CACHE
+    if (fAccess & IEM_ACCESS_TYPE_WRITE)
+        iemDecodedCacheNoteWrite(pVCpu, GCPhys);
+# endif
     return VINF_SUCCESS;
+#endif /* !IEM_WITH_DATA_TLB */
 }
 
 
@@ -7749,6 +8218,36 @@ DECLINLINE(void) iemMemPageUnmap(PVMCPU pVCpu, RTGCPHYS GCPhysMem, uint32_t fAcc
 }
 
 
+#ifdef IEM_WITH_TLB_DIRECT_READS
+/**
+ * Tries to get a direct, unlocked ring-3 pointer for reading a page thru the
+ * data TLB.
+ *
+ * Must be called right after iemMemPageTranslateAndCheckAccess succeeded for
+ * the same address, so that the TLB entry is valid.
+ *
+ * @returns Pointer to the byte at GCPtrMem on success, NULL if the access has
+ *          to go thru iemMemPageMap.
+ * @param   pVCpu               The cross context virtual CPU structure of the calling thread.
+ * @param   GCPtrMem            The virtual address.
+ * @param   fAccess             The intended access.
+ */
+DECLINLINE(void *) iemMemPageMapDirectRead(PVMCPU pVCpu, RTGCPTR GCPtrMem, uint32_t fAccess)
+{
+    if (   (fAccess & IEM_ACCESS_TYPE_WRITE)
+        || pVCpu->iem.s.fBypassHandlers)
+        return NULL;
+    uint64_t        uTag;
+    PIEMTLBENTRY    pTlbe = iemTlbLookup(&pVCpu->iem.s.DataTlb, GCPtrMem, &uTag);
+    Assert(pTlbe->uTag == uTag);
+    uint8_t *pbPage = iemTlbGetDirectReadPage(pVCpu, &pVCpu->iem.s.DataTlb, pTlbe);
+    if (pbPage)
+        return &pbPage[GCPtrMem & PAGE_OFFSET_MASK];
+    return NULL;
+}
+#endif
+
+
 /**
  * Looks up a memory mapping entry.
  *
@@ -8391,9 +8890,17 @@ iemMemMap(PVMCPU pVCpu, void **ppvMem, size_t cbMem, uint8_t iSegReg, RTGCPTR GC
         Log9(("IEM RD %RGv (%RGp) LB %#zx\n", GCPtrMem, GCPhysFirst, cbMem));
 
     void *pvMem;
-    rcStrict = iemMemPageMap(pVCpu, GCPhysFirst, fAccess, &pvMem, &pVCpu->iem.s.aMemMappingLocks[iMemMap].Lock);
-    if (rcStrict != VINF_SUCCESS)
-        return iemMemBounceBufferMapPhys(pVCpu, iMemMap, ppvMem, cbMem, GCPhysFirst, fAccess, rcStrict);
+#ifdef IEM_WITH_TLB_DIRECT_READS
+    pvMem = iemMemPageMapDirectRead(pVCpu, GCPtrMem, fAccess);
+    if (pvMem)
+        fAccess |= IEM_ACCESS_NOT_LOCKED;
+    else
+#endif
+    {
+        rcStrict = iemMemPageMap(pVCpu, GCPhysFirst, fAccess, &pvMem, &pVCpu->iem.s.aMemMappingLocks[iMemMap].Lock);
+        if (rcStrict != VINF_SUCCESS)
+            return iemMemBounceBufferMapPhys(pVCpu, iMemMap, ppvMem, cbMem, GCPhysFirst, fAccess, rcStrict);
+    }
 
     /*
      * Fill in the mapping table entry.
@@ -8428,8 +8935,8 @@ IEM_STATIC VBOXSTRICTRC iemMemCommitAndUnmap(PVMCPU pVCpu, void *pvMem, uint32_t
         if (pVCpu->iem.s.aMemMappings[iMemMap].fAccess & IEM_ACCESS_TYPE_WRITE)
             return iemMemBounceBufferCommitAndUnmap(pVCpu, iMemMap, false /*fPostponeFail*/);
     }
-    /* Otherwise unlock it. */
-    else
+    /* Otherwise unlock it, unless it was accessed directly thru the TLB. */
+    else if (!(pVCpu->iem.s.aMemMappings[iMemMap].fAccess & IEM_ACCESS_NOT_LOCKED))
         PGMPhysReleasePageMappingLock(pVCpu->CTX_SUFF(pVM), &pVCpu->iem.s.aMemMappingLocks[iMemMap].Lock);
 
     /* Free the entry. */
@@ -8521,6 +9028,12 @@ IEM_STATIC void *iemMemMapJmp(PVMCPU pVCpu, size_t cbMem, uint8_t iSegReg, RTGCP
         Log9(("IEM RD %RGv (%RGp) LB %#zx\n", GCPtrMem, GCPhysFirst, cbMem));
 
     void *pvMem;
+#ifdef IEM_WITH_TLB_DIRECT_READS
+    pvMem = iemMemPageMapDirectRead(pVCpu, GCPtrMem, fAccess);
+    if (pvMem)
+        fAccess |= IEM_ACCESS_NOT_LOCKED;
+    else
+#endif
     rcStrict = iemMemPageMap(pVCpu, GCPhysFirst, fAccess, &pvMem, &pVCpu->iem.s.aMemMappingLocks[iMemMap].Lock);
     if (rcStrict == VINF_SUCCESS)
     { /* likely */ }
@@ -8568,8 +9081,8 @@ IEM_STATIC void iemMemCommitAndUnmapJmp(PVMCPU pVCpu, void *pvMem, uint32_t fAcc
             longjmp(*pVCpu->iem.s.CTX_SUFF(pJmpBuf), VBOXSTRICTRC_VAL(rcStrict));
         }
     }
-    /* Otherwise unlock it. */
-    else
+    /* Otherwise unlock it, unless it was accessed directly thru the TLB. */
+    else if (!(pVCpu->iem.s.aMemMappings[iMemMap].fAccess & IEM_ACCESS_NOT_LOCKED))
         PGMPhysReleasePageMappingLock(pVCpu->CTX_SUFF(pVM), &pVCpu->iem.s.aMemMappingLocks[iMemMap].Lock);
 
     /* Free the entry. */
@@ -8605,8 +9118,8 @@ IEM_STATIC VBOXSTRICTRC iemMemCommitAndUnmapPostponeTroubleToR3(PVMCPU pVCpu, vo
         if (pVCpu->iem.s.aMemMappings[iMemMap].fAccess & IEM_ACCESS_TYPE_WRITE)
             return iemMemBounceBufferCommitAndUnmap(pVCpu, iMemMap, true /*fPostponeFail*/);
     }
-    /* Otherwise unlock it. */
-    else
+    /* Otherwise unlock it, unless it was accessed directly thru the TLB. */
+    else if (!(pVCpu->iem.s.aMemMappings[iMemMap].fAccess & IEM_ACCESS_NOT_LOCKED))
         PGMPhysReleasePageMappingLock(pVCpu->CTX_SUFF(pVM), &pVCpu->iem.s.aMemMappingLocks[iMemMap].Lock);
 
     /* Free the entry. */
@@ -8638,7 +9151,7 @@ IEM_STATIC void iemMemRollback(PVMCPU pVCpu)
         {
             AssertMsg(!(fAccess & ~IEM_ACCESS_VALID_MASK) && fAccess != 0, ("%#x\n", fAccess));
             pVCpu->iem.s.aMemMappings[iMemMap].fAccess = IEM_ACCESS_INVALID;
-            if (!(fAccess & IEM_ACCESS_BOUNCE_BUFFERED))
+            if (!(fAccess & (IEM_ACCESS_BOUNCE_BUFFERED | IEM_ACCESS_NOT_LOCKED)))
                 PGMPhysReleasePageMappingLock(pVCpu->CTX_SUFF(pVM), &pVCpu->iem.s.aMemMappingLocks[iMemMap].Lock);
             Assert(pVCpu->iem.s.cActiveMappings > 0);
             pVCpu->iem.s.cActiveMappings--;
@@ -8898,11 +9411,33 @@ IEM_STATIC uint32_t iemMemFetchDataU32SafeJmp(PVMCPU pVCpu, uint8_t iSegReg, RTG
  */
 DECL_NO_INLINE(IEM_STATIC, uint32_t) iemMemFetchDataU32Jmp(PVMCPU pVCpu, uint8_t iSegReg, RTGCPTR GCPtrMem)
 {
-# ifdef IEM_WITH_DATA_TLB
+# ifdef IEM_WITH_TLB_DIRECT_READS
+    /*
+     * Fast path: the page is in the data TLB and can be read directly, so no
+     * mapping table entry is needed.  The accessed bit was set when the entry
+     * was loaded.  Everything else is left to the safe variant.
+     */
     RTGCPTR GCPtrEff = iemMemApplySegmentToReadJmp(pVCpu, iSegReg, sizeof(uint32_t), GCPtrMem);
     if (RT_LIKELY((GCPtrEff & X86_PAGE_OFFSET_MASK) <= X86_PAGE_SIZE - sizeof(uint32_t)))
     {
-        /// @todo more later.
+        uint64_t        uTag;
+        PIEMTLBENTRY    pTlbe = iemTlbLookup(&pVCpu->iem.s.DataTlb, GCPtrEff, &uTag);
+        if (   pTlbe->uTag == uTag
+            && (   !(pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PT_NO_USER)
+                || pVCpu->iem.s.uCpl != 3)
+            && !pVCpu->iem.s.fBypassHandlers)
+        {
+            uint8_t const *pbPage = iemTlbGetDirectReadPage(pVCpu, &pVCpu->iem.s.DataTlb, pTlbe);
+            if (pbPage)
+            {
+#  ifdef VBOX_WITH_STATISTICS
+                pVCpu->iem.s.DataTlb.cTlbHits++;
+#  endif
+                Log9(("IEM RD dword %d|%RGv: %#010x\n", iSegReg, GCPtrMem,
+                      *(uint32_t const *)&pbPage[GCPtrEff & X86_PAGE_OFFSET_MASK]));
+                return *(uint32_t const *)&pbPage[GCPtrEff & X86_PAGE_OFFSET_MASK];
+            }
+        }
     }
 
     return iemMemFetchDataU32SafeJmp(pVCpu, iSegReg, GCPtrMem);
@@ -11581,6 +12116,16 @@ IEM_STATIC VBOXSTRICTRC iemMemMarkSelDescAccessed(PVMCPU pVCpu, uint16_t uSel)
 
 /** Only a REX prefix immediately preceeding the first opcode byte takes
  * effect. This macro helps ensuring this as well as logging bad guest code.  */
+/**
+ * Notes the decoder state for the decoded instruction cache right before
+ * dispatching the opcode byte following a prefix.
+ */
+#ifdef IEM_WITH_DECODED_CACHE
+# define IEMOP_HLP_NOTE_PREFIXES_DECODED()  iemDecodedCacheNotePrefixes(pVCpu)
+#else
+# define IEMOP_HLP_NOTE_PREFIXES_DECODED()  do { } while (0)
+#endif
+
 #define IEMOP_HLP_CLEAR_REX_NOT_BEFORE_OPCODE(a_szPrf) \
     do \
     { \
@@ -14132,13 +14677,29 @@ VMMDECL(VBOXSTRICTRC) IEMExecLots(PVMCPU pVCpu, uint32_t *pcInstructions)
 # endif
 
                 /*
-                 * Do the decoding and emulation.
+                 * Do the decoding and emulation, replaying the prefix decoding
+                 * and opcode fetching from the decoded instruction cache if we can.
                  */
-                uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
-                rcStrict = FNIEMOP_CALL(g_apfnOneByteMap[b]);
+# ifdef IEM_WITH_DECODED_CACHE
+                PCIEMDECODEDINSTR pCached = iemDecodedCacheLookup(pVCpu, pCtx);
+                if (pCached)
+                {
+                    uint8_t const b = iemDecodedCacheReplay(pVCpu, pCached);
+                    rcStrict = FNIEMOP_CALL(g_apfnOneByteMap[b]);
+                }
+                else
+# endif
+                {
+                    uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+                    IEMOP_HLP_NOTE_PREFIXES_DECODED();
+                    rcStrict = FNIEMOP_CALL(g_apfnOneByteMap[b]);
+                }
                 if (RT_LIKELY(rcStrict == VINF_SUCCESS))
                 {
                     Assert(pVCpu->iem.s.cActiveMappings == 0);
+# ifdef IEM_WITH_DECODED_CACHE
+                    iemDecodedCacheRecord(pVCpu);
+# endif
                     pVCpu->iem.s.cInstructions++;
                     if (RT_LIKELY(pVCpu->iem.s.rcPassUp == VINF_SUCCESS))
                     {
@@ -8595,6 +8595,7 @@ FNIEMOP_DEF(iemOp_seg_ES)
     pVCpu->iem.s.iEffSeg    = X86_SREG_ES;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -8666,6 +8667,7 @@ FNIEMOP_DEF(iemOp_seg_CS)
     pVCpu->iem.s.iEffSeg    = X86_SREG_CS;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -8743,6 +8745,7 @@ FNIEMOP_DEF(iemOp_seg_SS)
     pVCpu->iem.s.iEffSeg    = X86_SREG_SS;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -8807,6 +8810,7 @@ FNIEMOP_DEF(iemOp_seg_DS)
     pVCpu->iem.s.iEffSeg    = X86_SREG_DS;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -8872,6 +8876,7 @@ FNIEMOP_DEF(iemOp_inc_eAX)
         pVCpu->iem.s.fPrefixes |= IEM_OP_PRF_REX;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -8893,6 +8898,7 @@ FNIEMOP_DEF(iemOp_inc_eCX)
         pVCpu->iem.s.uRexB     = 1 << 3;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -8914,6 +8920,7 @@ FNIEMOP_DEF(iemOp_inc_eDX)
         pVCpu->iem.s.uRexIndex = 1 << 3;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -8937,6 +8944,7 @@ FNIEMOP_DEF(iemOp_inc_eBX)
         pVCpu->iem.s.uRexIndex = 1 << 3;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -8958,6 +8966,7 @@ FNIEMOP_DEF(iemOp_inc_eSP)
         pVCpu->iem.s.uRexReg   = 1 << 3;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -8980,6 +8989,7 @@ FNIEMOP_DEF(iemOp_inc_eBP)
         pVCpu->iem.s.uRexB     = 1 << 3;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9002,6 +9012,7 @@ FNIEMOP_DEF(iemOp_inc_eSI)
         pVCpu->iem.s.uRexIndex = 1 << 3;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9025,6 +9036,7 @@ FNIEMOP_DEF(iemOp_inc_eDI)
         pVCpu->iem.s.uRexIndex = 1 << 3;
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9046,6 +9058,7 @@ FNIEMOP_DEF(iemOp_dec_eAX)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9068,6 +9081,7 @@ FNIEMOP_DEF(iemOp_dec_eCX)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9090,6 +9104,7 @@ FNIEMOP_DEF(iemOp_dec_eDX)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9113,6 +9128,7 @@ FNIEMOP_DEF(iemOp_dec_eBX)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9135,6 +9151,7 @@ FNIEMOP_DEF(iemOp_dec_eSP)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9158,6 +9175,7 @@ FNIEMOP_DEF(iemOp_dec_eBP)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9181,6 +9199,7 @@ FNIEMOP_DEF(iemOp_dec_eSI)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9205,6 +9224,7 @@ FNIEMOP_DEF(iemOp_dec_eDI)
         iemRecalEffOpSize(pVCpu);
 
         uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+        IEMOP_HLP_NOTE_PREFIXES_DECODED();
         return FNIEMOP_CALL(g_apfnOneByteMap[b]);
     }
 
@@ -9622,6 +9642,7 @@ FNIEMOP_DEF(iemOp_seg_FS)
     pVCpu->iem.s.iEffSeg    = X86_SREG_FS;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -9636,6 +9657,7 @@ FNIEMOP_DEF(iemOp_seg_GS)
     pVCpu->iem.s.iEffSeg    = X86_SREG_GS;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -9655,6 +9677,7 @@ FNIEMOP_DEF(iemOp_op_size)
         pVCpu->iem.s.idxPrefix = 1;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -9675,6 +9698,7 @@ FNIEMOP_DEF(iemOp_addr_size)
     }
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -17715,6 +17739,7 @@ FNIEMOP_DEF(iemOp_lock)
     pVCpu->iem.s.fPrefixes |= IEM_OP_PRF_LOCK;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -17742,6 +17767,7 @@ FNIEMOP_DEF(iemOp_repne)
     pVCpu->iem.s.idxPrefix = 3;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
@@ -17759,6 +17785,7 @@ FNIEMOP_DEF(iemOp_repe)
     pVCpu->iem.s.idxPrefix = 2;
 
     uint8_t b; IEM_OPCODE_GET_NEXT_U8(&b);
+    IEMOP_HLP_NOTE_PREFIXES_DECODED();
     return FNIEMOP_CALL(g_apfnOneByteMap[b]);
 }
 
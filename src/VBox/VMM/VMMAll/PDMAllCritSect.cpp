@@ -35,6 +35,9 @@
 #ifdef IN_RING3
 # include <iprt/lockvalidator.h>
 # include <iprt/semaphore.h>
+# ifdef VBOX_WITH_STATISTICS
+#  include <iprt/time.h>
+# endif
 #endif
 #if defined(IN_RING3) || defined(IN_RING0)
 # include <iprt/thread.h>
@@ -44,14 +47,6 @@
 /*********************************************************************************************************************************
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
-/** The number loops to spin for in ring-3. */
-#define PDMCRITSECT_SPIN_COUNT_R3       20
-/** The number loops to spin for in ring-0. */
-#define PDMCRITSECT_SPIN_COUNT_R0       256
-/** The number loops to spin for in the raw-mode context. */
-#define PDMCRITSECT_SPIN_COUNT_RC       256
-
-
 /** Skips some of the overly paranoid atomic updates.
  * Makes some assumptions about cache coherence, though not brave enough not to
  * always end with an atomic update. */
@@ -117,6 +112,50 @@ DECL_FORCE_INLINE(int) pdmCritSectEnterFirst(PPDMCRITSECT pCritSect, RTNATIVETHR
 }
 
 
+/**
+ * Calculates the spin budget for a contended enter.
+ *
+ * The budget is twice the average number of spins it took to get the section
+ * on recent occasions plus a small constant, capped by the per VM maximum for
+ * the context.  So, short hold times earn a budget covering them while
+ * sections held for long periods quickly stop wasting CPU on spinning.
+ *
+ * @returns Number of spins, zero if spinning is disabled.
+ * @param   pCritSect           The critical section.
+ */
+DECL_FORCE_INLINE(uint32_t) pdmCritSectSpinBudget(PCPDMCRITSECT pCritSect)
+{
+    PVM pVM = pCritSect->s.CTX_SUFF(pVM); AssertPtr(pVM);
+#ifdef IN_RING3
+    uint32_t const cSpinMax = pVM->pdm.s.cCritSectSpinMaxR3;
+#else
+    uint32_t const cSpinMax = pVM->pdm.s.cCritSectSpinMaxRZ;
+#endif
+    uint32_t const cSpins   = pCritSect->s.uSpinAvg * 2 / PDMCRITSECT_SPIN_AVG_SCALE + PDMCRITSECT_SPIN_MIN;
+    return RT_MIN(cSpins, cSpinMax);
+}
+
+
+/**
+ * Updates the spin average after spinning on a contended section.
+ *
+ * @param   pCritSect           The critical section.
+ * @param   cSpins              The number of spins it took to get the
+ *                              section, UINT32_MAX if we didn't get it.
+ */
+DECL_FORCE_INLINE(void) pdmCritSectSpinUpdate(PPDMCRITSECT pCritSect, uint32_t cSpins)
+{
+    uint32_t uAvg = pCritSect->s.uSpinAvg;
+    uAvg -= uAvg / PDMCRITSECT_SPIN_AVG_SCALE;
+    if (cSpins != UINT32_MAX)
+        uAvg += cSpins;
+    pCritSect->s.uSpinAvg = (uint16_t)RT_MIN(uAvg, UINT16_MAX);
+#if defined(IN_RING3) && defined(VBOX_WITH_STATISTICS)
+    pdmR3CritSectStatsSpin(&pCritSect->s, cSpins != UINT32_MAX);
+#endif
+}
+
+
 #if defined(IN_RING3) || defined(IN_RING0)
 /**
  * Deals with the contended case in ring-3 and ring-0.
@@ -147,6 +186,9 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
     PSUPDRVSESSION  pSession    = pCritSect->s.CTX_SUFF(pVM)->pSession;
     SUPSEMEVENT     hEvent      = (SUPSEMEVENT)pCritSect->s.Core.EventSem;
 # ifdef IN_RING3
+#  ifdef VBOX_WITH_STATISTICS
+    uint64_t const  nsStart     = RTTimeNanoTS();
+#  endif
 #  ifdef PDMCRITSECT_STRICT
     RTTHREAD        hThreadSelf = RTThreadSelfAutoAdopt();
     int rc2 = RTLockValidatorRecExclCheckOrder(pCritSect->s.Core.pValidatorRec, hThreadSelf, pSrcPos, RT_INDEFINITE_WAIT);
@@ -190,7 +232,15 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
         if (RT_UNLIKELY(pCritSect->s.Core.u32Magic != RTCRITSECT_MAGIC))
             return VERR_SEM_DESTROYED;
         if (rc == VINF_SUCCESS)
+        {
+# if defined(IN_RING3) && defined(VBOX_WITH_STATISTICS)
+            pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+            pdmR3CritSectStatsWait(&pCritSect->s, RTTimeNanoTS() - nsStart);
+            return VINF_SUCCESS;
+# else
             return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+# endif
+        }
         AssertMsg(rc == VERR_INTERRUPTED, ("rc=%Rrc\n", rc));
 
 # ifdef IN_RING0
@@ -263,21 +313,28 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
     }
 
     /*
-     * Spin for a bit without incrementing the counter.
+     * Spin for a bit without incrementing the counter.  The budget adapts to
+     * how long the section is typically held (see pdmCritSectSpinBudget) and
+     * is zero on single CPU hosts.
      */
-    /** @todo Move this to cfgm variables since it doesn't make sense to spin on UNI
-     *        cpu systems. */
-    int32_t cSpinsLeft = CTX_SUFF(PDMCRITSECT_SPIN_COUNT_);
-    while (cSpinsLeft-- > 0)
+    uint32_t const cSpinBudget = pdmCritSectSpinBudget(pCritSect);
+    if (cSpinBudget > 0)
     {
-        if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
-            return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
-        ASMNopPause();
-        /** @todo Should use monitor/mwait on e.g. &cLockers here, possibly with a
-           cli'ed pendingpreemption check up front using sti w/ instruction fusing
-           for avoiding races. Hmm ... This is assuming the other party is actually
-           executing code on another CPU ... which we could keep track of if we
-           wanted. */
+        for (uint32_t cSpins = 1; cSpins <= cSpinBudget; cSpins++)
+        {
+            ASMNopPause();
+            if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
+            {
+                pdmCritSectSpinUpdate(pCritSect, cSpins);
+                return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+            }
+            /** @todo Should use monitor/mwait on e.g. &cLockers here, possibly with a
+               cli'ed pendingpreemption check up front using sti w/ instruction fusing
+               for avoiding races. Hmm ... This is assuming the other party is actually
+               executing code on another CPU ... which we could keep track of if we
+               wanted. */
+        }
+        pdmCritSectSpinUpdate(pCritSect, UINT32_MAX);
     }
 
 #ifdef IN_RING3
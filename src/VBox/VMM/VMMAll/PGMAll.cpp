@@ -2081,6 +2081,7 @@ VMMDECL(int) PGMUpdateCR3(PVMCPU pVCpu, uint64_t cr3)
         pVCpu->pgm.s.GCPhysCR3 = GCPhysCR3;
         rc = PGM_BTH_PFN(MapCR3, pVCpu)(pVCpu, GCPhysCR3);
         AssertRCSuccess(rc); /* Assumes VINF_PGM_SYNC_CR3 doesn't apply to nested paging. */ /** @todo this isn't true for the mac, but we need hw to test/fix this. */
+        IEMTlbInvalidateAll(pVCpu, false /*fVmm*/);
     }
 
     VMCPU_FF_CLEAR(pVCpu, VMCPU_FF_HM_UPDATE_CR3);
@@ -2290,6 +2291,7 @@ VMMDECL(int) PGMChangeMode(PVMCPU pVCpu, uint64_t cr0, uint64_t cr4, uint64_t ef
 
     /* Flush the TLB */
     PGM_INVL_VCPU_TLBS(pVCpu);
+    IEMTlbInvalidateAll(pVCpu, false /*fVmm*/);
 
 #ifdef IN_RING3
     return PGMR3ChangeMode(pVCpu->CTX_SUFF(pVM), pVCpu, enmGuestMode);
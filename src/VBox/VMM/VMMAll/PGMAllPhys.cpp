@@ -25,6 +25,7 @@
 #include <VBox/vmm/vmm.h>
 #include <VBox/vmm/iom.h>
 #include <VBox/vmm/em.h>
+#include <VBox/vmm/iem.h>
 #ifdef VBOX_WITH_REM
 # include <VBox/vmm/rem.h>
 #endif
@@ -604,6 +605,9 @@ void pgmPhysInvalidatePageMapTLB(PVM pVM)
 
     /** @todo clear the RC TLB whenever we add it. */
 
+    /* The IEM TLBs cache the same kind of information. */
+    IEMTlbInvalidateAllPhysicalAllCpus(pVM);
+
     pgmUnlock(pVM);
 }
 
@@ -636,6 +640,9 @@ void pgmPhysInvalidatePageMapTLBEntry(PVM pVM, RTGCPHYS GCPhys)
 #endif
 
     /** @todo clear the RC TLB whenever we add it. */
+
+    /* The IEM TLBs cache the same kind of information. */
+    IEMTlbInvalidateAllPhysicalAllCpus(pVM);
 }
 
 /**
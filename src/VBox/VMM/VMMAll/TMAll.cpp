@@ -267,6 +267,29 @@ DECLINLINE(void) tmScheduleNotify(PVM pVM)
 }
 
 
+/**
+ * Wakes up the timer thread so it reconsiders its queues.
+ *
+ * @param   pVM         The cross context VM structure.
+ */
+void tmTimerThreadNotify(PVM pVM)
+{
+    Assert(pVM->tm.s.fTimerThread);
+#ifdef IN_RC
+    /* Can't signal the event semaphore from here, have the timer EMT do it. */
+    ASMAtomicWriteBool(&pVM->tm.s.fTimerThreadKick, true);
+    tmScheduleNotify(pVM);
+#else
+    if (ASMAtomicReadBool(&pVM->tm.s.fTimerThreadWaiting))
+    {
+        STAM_COUNTER_INC(&pVM->tm.s.StatTimerThreadWakeups);
+        int rc = SUPSemEventSignal(pVM->pSession, pVM->tm.s.hTimerThreadEvt);
+        AssertRC(rc);
+    }
+#endif
+}
+
+
 /**
  * Schedule the queue which was changed.
  */
@@ -278,7 +301,7 @@ DECLINLINE(void) tmSchedule(PTMTIMER pTimer)
     {
         STAM_PROFILE_START(&pVM->tm.s.CTX_SUFF_Z(StatScheduleOne), a);
         Log3(("tmSchedule: tmTimerQueueSchedule\n"));
-        tmTimerQueueSchedule(pVM, &pVM->tm.s.CTX_SUFF(paTimerQueues)[pTimer->enmClock]);
+        tmTimerQueueSchedule(pVM, &pVM->tm.s.CTX_SUFF(paTimerQueues)[pTimer->idxQueue]);
 #ifdef VBOX_STRICT
         tmTimerQueuesSanityChecks(pVM, "tmSchedule");
 #endif
@@ -289,7 +312,12 @@ DECLINLINE(void) tmSchedule(PTMTIMER pTimer)
     {
         TMTIMERSTATE enmState = pTimer->enmState;
         if (TMTIMERSTATE_IS_PENDING_SCHEDULING(enmState))
-            tmScheduleNotify(pVM);
+        {
+            if (pTimer->idxQueue < TMCLOCK_MAX)
+                tmScheduleNotify(pVM);
+            else
+                tmTimerThreadNotify(pVM);
+        }
     }
 }
 
@@ -352,7 +380,7 @@ DECLINLINE(bool) tmTimerTryWithLink(PTMTIMER pTimer, TMTIMERSTATE enmStateNew, T
 {
     if (tmTimerTry(pTimer, enmStateNew, enmStateOld))
     {
-        tmTimerLinkSchedule(&pTimer->CTX_SUFF(pVM)->tm.s.CTX_SUFF(paTimerQueues)[pTimer->enmClock], pTimer);
+        tmTimerLinkSchedule(&pTimer->CTX_SUFF(pVM)->tm.s.CTX_SUFF(paTimerQueues)[pTimer->idxQueue], pTimer);
         return true;
     }
     return false;
@@ -360,7 +388,7 @@ DECLINLINE(bool) tmTimerTryWithLink(PTMTIMER pTimer, TMTIMERSTATE enmStateNew, T
 
 
 /**
- * Links a timer into the active list of a timer queue.
+ * Links a timer into the active heap of a timer queue.
  *
  * @param   pQueue          The queue.
  * @param   pTimer          The timer.
@@ -370,46 +398,19 @@ DECLINLINE(bool) tmTimerTryWithLink(PTMTIMER pTimer, TMTIMERSTATE enmStateNew, T
  */
 DECL_FORCE_INLINE(void) tmTimerQueueLinkActive(PTMTIMERQUEUE pQueue, PTMTIMER pTimer, uint64_t u64Expire)
 {
-    Assert(!pTimer->offNext);
-    Assert(!pTimer->offPrev);
     Assert(pTimer->enmState == TMTIMERSTATE_ACTIVE || pTimer->enmClock != TMCLOCK_VIRTUAL_SYNC); /* (active is not a stable state) */
+    Assert(pTimer->u64Expire == u64Expire);
 
-    PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue);
-    if (pCur)
+    if (tmTimerHeapInsert(pQueue, pTimer))
     {
-        for (;; pCur = TMTIMER_GET_NEXT(pCur))
-        {
-            if (pCur->u64Expire > u64Expire)
-            {
-                const PTMTIMER pPrev = TMTIMER_GET_PREV(pCur);
-                TMTIMER_SET_NEXT(pTimer, pCur);
-                TMTIMER_SET_PREV(pTimer, pPrev);
-                if (pPrev)
-                    TMTIMER_SET_NEXT(pPrev, pTimer);
-                else
-                {
-                    TMTIMER_SET_HEAD(pQueue, pTimer);
-                    ASMAtomicWriteU64(&pQueue->u64Expire, u64Expire);
-                    DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive head", R3STRING(pTimer->pszDesc));
-                }
-                TMTIMER_SET_PREV(pCur, pTimer);
-                return;
-            }
-            if (!pCur->offNext)
-            {
-                TMTIMER_SET_NEXT(pCur, pTimer);
-                TMTIMER_SET_PREV(pTimer, pCur);
-                DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive tail", R3STRING(pTimer->pszDesc));
-                return;
-            }
-        }
+        DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive head", R3STRING(pTimer->pszDesc));
+        /* The timer thread may be sleeping till the old head expires. */
+        if (pQueue->fTimerThread)
+            tmTimerThreadNotify(pTimer->CTX_SUFF(pVM));
     }
     else
-    {
-        TMTIMER_SET_HEAD(pQueue, pTimer);
-        ASMAtomicWriteU64(&pQueue->u64Expire, u64Expire);
-        DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive empty", R3STRING(pTimer->pszDesc));
-    }
+        DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive heap", R3STRING(pTimer->pszDesc));
+    NOREF(u64Expire);
 }
 
 
@@ -436,7 +437,7 @@ DECLINLINE(void) tmTimerQueueScheduleOne(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
         switch (enmState)
         {
             /*
-             * Reschedule timer (in the active list).
+             * Reschedule timer (in the active heap).
              */
             case TMTIMERSTATE_PENDING_RESCHEDULE:
                 if (RT_UNLIKELY(!tmTimerTry(pTimer, TMTIMERSTATE_PENDING_SCHEDULE, TMTIMERSTATE_PENDING_RESCHEDULE)))
@@ -445,7 +446,7 @@ DECLINLINE(void) tmTimerQueueScheduleOne(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
                 /* fall thru */
 
             /*
-             * Schedule timer (insert into the active list).
+             * Schedule timer (insert into the active heap).
              */
             case TMTIMERSTATE_PENDING_SCHEDULE:
                 Assert(!pTimer->offNext); Assert(!pTimer->offPrev);
@@ -455,7 +456,7 @@ DECLINLINE(void) tmTimerQueueScheduleOne(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
                 return;
 
             /*
-             * Stop the timer in active list.
+             * Stop the timer in the active heap.
              */
             case TMTIMERSTATE_PENDING_STOP:
                 if (RT_UNLIKELY(!tmTimerTry(pTimer, TMTIMERSTATE_PENDING_STOP_SCHEDULE, TMTIMERSTATE_PENDING_STOP)))
@@ -464,7 +465,7 @@ DECLINLINE(void) tmTimerQueueScheduleOne(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
                 /* fall thru */
 
             /*
-             * Stop the timer (not on the active list).
+             * Stop the timer (not on the active heap).
              */
             case TMTIMERSTATE_PENDING_STOP_SCHEDULE:
                 Assert(!pTimer->offNext); Assert(!pTimer->offPrev);
@@ -561,24 +562,36 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
     TM_ASSERT_TIMER_LOCK_OWNERSHIP(pVM);
 
     /*
-     * Check the linking of the active lists.
+     * Check the linking and ordering of the active heaps.
      */
     bool fHaveVirtualSyncLock = false;
-    for (int i = 0; i < TMCLOCK_MAX; i++)
+    for (unsigned i = 0; i < TMTIMERQUEUE_COUNT; i++)
     {
         PTMTIMERQUEUE pQueue = &pVM->tm.s.CTX_SUFF(paTimerQueues)[i];
-        Assert((int)pQueue->enmClock == i);
+        Assert(i >= TMCLOCK_MAX || (unsigned)pQueue->enmClock == i);
+        Assert(pQueue->fTimerThread == (i >= TMCLOCK_MAX));
         if (pQueue->enmClock == TMCLOCK_VIRTUAL_SYNC)
         {
             if (PDMCritSectTryEnter(&pVM->tm.s.VirtualSyncLock) != VINF_SUCCESS)
                 continue;
             fHaveVirtualSyncLock = true;
         }
-        PTMTIMER pPrev = NULL;
-        for (PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue); pCur; pPrev = pCur, pCur = TMTIMER_GET_NEXT(pCur))
+        PTMTIMER pRoot = TMTIMER_GET_HEAD(pQueue);
+        AssertMsg(!pRoot || (!pRoot->offPrev && !pRoot->offNext), ("%s: %p\n", pszWhere, pRoot));
+        for (PTMTIMER pCur = pRoot; pCur; pCur = tmTimerHeapWalkNext(pCur))
         {
-            AssertMsg((int)pCur->enmClock == i, ("%s: %d != %d\n", pszWhere, pCur->enmClock, i));
-            AssertMsg(TMTIMER_GET_PREV(pCur) == pPrev, ("%s: %p != %p\n", pszWhere, TMTIMER_GET_PREV(pCur), pPrev));
+            AssertMsg(pCur->idxQueue == i, ("%s: %u != %u\n", pszWhere, pCur->idxQueue, i));
+            AssertMsg(pCur->enmClock == pQueue->enmClock, ("%s: %d != %d\n", pszWhere, pCur->enmClock, pQueue->enmClock));
+            PTMTIMER pPrev = pCur;
+            for (PTMTIMER pChild = TMTIMER_GET_CHILD(pCur); pChild; pPrev = pChild, pChild = TMTIMER_GET_NEXT(pChild))
+            {
+                AssertMsg(TMTIMER_GET_PREV(pChild) == pPrev, ("%s: %p != %p\n", pszWhere, TMTIMER_GET_PREV(pChild), pPrev));
+                /* Timers pending rescheduling may have had their expire time changed in place. */
+                AssertMsg(   pChild->u64Expire >= pCur->u64Expire
+                          || pChild->enmState != TMTIMERSTATE_ACTIVE
+                          || pCur->enmState   != TMTIMERSTATE_ACTIVE,
+                          ("%s: %'RU64 < %'RU64\n", pszWhere, pChild->u64Expire, pCur->u64Expire));
+            }
             TMTIMERSTATE enmState = pCur->enmState;
             switch (enmState)
             {
@@ -608,6 +621,7 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
     {
         Assert(pCur->pBigPrev == pPrev);
         Assert((unsigned)pCur->enmClock < (unsigned)TMCLOCK_MAX);
+        Assert(pCur->idxQueue < TMTIMERQUEUE_COUNT);
 
         TMTIMERSTATE enmState = pCur->enmState;
         switch (enmState)
@@ -618,10 +632,10 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
             case TMTIMERSTATE_PENDING_RESCHEDULE_SET_EXPIRE:
                 if (fHaveVirtualSyncLock || pCur->enmClock != TMCLOCK_VIRTUAL_SYNC)
                 {
-                    PTMTIMERR3 pCurAct = TMTIMER_GET_HEAD(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pCur->enmClock]);
+                    PTMTIMERR3 pCurAct = TMTIMER_GET_HEAD(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pCur->idxQueue]);
                     Assert(pCur->offPrev || pCur == pCurAct);
                     while (pCurAct && pCurAct != pCur)
-                        pCurAct = TMTIMER_GET_NEXT(pCurAct);
+                        pCurAct = tmTimerHeapWalkNext(pCurAct);
                     Assert(pCurAct == pCur);
                 }
                 break;
@@ -634,13 +648,15 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
                 {
                     Assert(!pCur->offNext);
                     Assert(!pCur->offPrev);
-                    for (PTMTIMERR3 pCurAct = TMTIMER_GET_HEAD(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pCur->enmClock]);
+                    Assert(!pCur->offChild);
+                    for (PTMTIMERR3 pCurAct = TMTIMER_GET_HEAD(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pCur->idxQueue]);
                           pCurAct;
-                          pCurAct = TMTIMER_GET_NEXT(pCurAct))
+                          pCurAct = tmTimerHeapWalkNext(pCurAct))
                     {
                         Assert(pCurAct != pCur);
                         Assert(TMTIMER_GET_NEXT(pCurAct) != pCur);
                         Assert(TMTIMER_GET_PREV(pCurAct) != pCur);
+                        Assert(TMTIMER_GET_CHILD(pCurAct) != pCur);
                     }
                 }
                 break;
@@ -745,6 +761,7 @@ DECL_FORCE_INLINE(uint64_t) tmTimerPollReturnHit(PVM pVM, PVMCPU pVCpu, PVMCPU p
                                                  uint64_t *pu64Delta, PSTAMCOUNTER pCounter)
 {
     STAM_COUNTER_INC(pCounter); NOREF(pCounter);
+    STAM_COUNTER_INC(&pVCpu->tm.s.StatPollHits);
     if (pVCpuDst != pVCpu)
         return tmTimerPollReturnOtherCpu(pVM, u64Now, pu64Delta);
     *pu64Delta = 0;
@@ -772,6 +789,7 @@ DECL_FORCE_INLINE(uint64_t) tmTimerPollInternal(PVM pVM, PVMCPU pVCpu, uint64_t
     PVMCPU                  pVCpuDst      = &pVM->aCpus[pVM->tm.s.idTimerCpu];
     const uint64_t          u64Now        = TMVirtualGetNoCheck(pVM);
     STAM_COUNTER_INC(&pVM->tm.s.StatPoll);
+    STAM_COUNTER_INC(&pVCpu->tm.s.StatPoll);
 
     /*
      * Return straight away if the timer FF is already set ...
@@ -834,6 +852,7 @@ DECL_FORCE_INLINE(uint64_t) tmTimerPollInternal(PVM pVM, PVMCPU pVCpu, uint64_t
                 {
                     STAM_COUNTER_INC(&pVM->tm.s.StatPollSimple);
                     STAM_COUNTER_INC(&pVM->tm.s.StatPollMiss);
+                    STAM_COUNTER_INC(&pVCpu->tm.s.StatPollMiss);
 
                     if (pVCpu == pVCpuDst)
                         return tmTimerPollReturnMiss(pVM, u64Now, RT_MIN(i64Delta1, i64Delta2), pu64Delta);
@@ -957,6 +976,7 @@ DECL_FORCE_INLINE(uint64_t) tmTimerPollInternal(PVM pVM, PVMCPU pVCpu, uint64_t
      * Return the time left to the next event.
      */
     STAM_COUNTER_INC(&pVM->tm.s.StatPollMiss);
+    STAM_COUNTER_INC(&pVCpu->tm.s.StatPollMiss);
     if (pVCpu == pVCpuDst)
     {
         if (fCatchUp)
@@ -1137,9 +1157,9 @@ static int tmTimerSetOptimizedStart(PVM pVM, PTMTIMER pTimer, uint64_t u64Expire
     Log2(("tmTimerSetOptimizedStart: %p:{.pszDesc='%s', .u64Expire=%'RU64}\n", pTimer, R3STRING(pTimer->pszDesc), u64Expire));
 
     /*
-     * Link the timer into the active list.
+     * Link the timer into the active heap.
      */
-    tmTimerQueueLinkActive(&pVM->tm.s.CTX_SUFF(paTimerQueues)[enmClock], pTimer, u64Expire);
+    tmTimerQueueLinkActive(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pTimer->idxQueue], pTimer, u64Expire);
 
     STAM_COUNTER_INC(&pVM->tm.s.StatTimerSetOpt);
     TM_UNLOCK_TIMERS(pVM);
@@ -1434,10 +1454,10 @@ static int tmTimerSetRelativeOptimizedStart(PVM pVM, PTMTIMER pTimer, uint64_t c
     Log2(("tmTimerSetRelativeOptimizedStart: %p:{.pszDesc='%s', .u64Expire=%'RU64} cTicksToNext=%'RU64\n", pTimer, R3STRING(pTimer->pszDesc), u64Expire, cTicksToNext));
 
     /*
-     * Link the timer into the active list.
+     * Link the timer into the active heap.
      */
     DBGFTRACE_U64_TAG2(pVM, u64Expire, "tmTimerSetRelativeOptimizedStart", R3STRING(pTimer->pszDesc));
-    tmTimerQueueLinkActive(&pVM->tm.s.CTX_SUFF(paTimerQueues)[enmClock], pTimer, u64Expire);
+    tmTimerQueueLinkActive(&pVM->tm.s.CTX_SUFF(paTimerQueues)[pTimer->idxQueue], pTimer, u64Expire);
 
     STAM_COUNTER_INC(&pVM->tm.s.StatTimerSetRelativeOpt);
     TM_UNLOCK_TIMERS(pVM);
@@ -2480,7 +2500,7 @@ static uint32_t tmGetFrequencyHint(PVM pVM)
             for (int i = 0; i < TMCLOCK_MAX; i++)
             {
                 PTMTIMERQUEUE pQueue = &pVM->tm.s.CTX_SUFF(paTimerQueues)[i];
-                for (PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue); pCur; pCur = TMTIMER_GET_NEXT(pCur))
+                for (PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue); pCur; pCur = tmTimerHeapWalkNext(pCur))
                 {
                     uint32_t uHzHint = ASMAtomicUoReadU32(&pCur->uHzHint);
                     if (uHzHint > uMaxHzHint)
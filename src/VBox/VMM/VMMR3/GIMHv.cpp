@@ -500,7 +500,7 @@ VMMR3_INT_DECL(int) gimR3HvInit(PVM pVM, PCFGMNODE pGimCfg)
                 RTStrPrintf(&pHvStimer->szTimerDesc[0], sizeof(pHvStimer->szTimerDesc), "Hyper-V[%u] Timer%u", pVCpu->idCpu,
                             idxStimer);
                 rc = TMR3TimerCreateInternal(pVM, TMCLOCK_VIRTUAL_SYNC, gimR3HvTimerCallback, pHvStimer /* pvUser */,
-                                             pHvStimer->szTimerDesc, &pHvStimer->pTimerR3);
+                                             0 /* fFlags */, pHvStimer->szTimerDesc, &pHvStimer->pTimerR3);
                 AssertLogRelRCReturn(rc, rc);
                 pHvStimer->pTimerR0 = TMTimerR0Ptr(pHvStimer->pTimerR3);
                 pHvStimer->pTimerRC = TMTimerRCPtr(pHvStimer->pTimerR3);
@@ -22,6 +22,7 @@
 #define LOG_GROUP LOG_GROUP_EM
 #include <VBox/vmm/iem.h>
 #include <VBox/vmm/cpum.h>
+#include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/mm.h>
 #include "IEMInternal.h"
 #include <VBox/vmm/vm.h>
@@ -63,6 +64,13 @@ VMMR3DECL(int)      IEMR3Init(PVM pVM)
     uint64_t const uInitialTlbRevision = UINT64_C(0) - (IEMTLB_REVISION_INCR * 200U);
     uint64_t const uInitialTlbPhysRev  = UINT64_C(0) - (IEMTLB_PHYS_REV_INCR * 100U);
 
+    /** @cfgm{/IEM/DecodedCache, boolean, true}
+     * Whether IEMExecLots keeps a cache of decoded instructions.  This costs
+     * IEMDECODEDCACHE_ENTRIES * 64 bytes (8KB) of ring-3 heap per virtual CPU. */
+    bool fDecodedCache;
+    int rc = CFGMR3QueryBoolDef(CFGMR3GetChild(CFGMR3GetRoot(pVM), "IEM"), "DecodedCache", &fDecodedCache, true);
+    AssertLogRelRCReturn(rc, rc);
+
     for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
     {
         PVMCPU pVCpu = &pVM->aCpus[idCpu];
@@ -72,6 +80,14 @@ VMMR3DECL(int)      IEMR3Init(PVM pVM)
 
         pVCpu->iem.s.CodeTlb.uTlbRevision = pVCpu->iem.s.DataTlb.uTlbRevision = uInitialTlbRevision;
         pVCpu->iem.s.CodeTlb.uTlbPhysRev  = pVCpu->iem.s.DataTlb.uTlbPhysRev  = uInitialTlbPhysRev;
+        pVCpu->iem.s.DecodedCache.uGeneration     = 1;
+        pVCpu->iem.s.DecodedCache.GCPhysRecording = NIL_RTGCPHYS;
+        if (fDecodedCache)
+        {
+            pVCpu->iem.s.paDecodedCacheR3 = (PIEMDECODEDINSTR)MMR3HeapAllocZ(pVM, MM_TAG_IEM,
+                                                                             sizeof(IEMDECODEDINSTR) * IEMDECODEDCACHE_ENTRIES);
+            AssertLogRelReturn(pVCpu->iem.s.paDecodedCacheR3, VERR_NO_MEMORY);
+        }
 
         STAMR3RegisterF(pVM, &pVCpu->iem.s.cInstructions,               STAMTYPE_U32,       STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,
                         "Instructions interpreted",                     "/IEM/CPU%u/cInstructions", idCpu);
@@ -113,12 +129,23 @@ VMMR3DECL(int)      IEMR3Init(PVM pVM)
                         "Data TLB revision",                        "/IEM/CPU%u/DataTlb-Revision", idCpu);
         STAMR3RegisterF(pVM, (void *)&pVCpu->iem.s.DataTlb.uTlbPhysRev, STAMTYPE_X64,       STAMVISIBILITY_ALWAYS, STAMUNIT_NONE,
                         "Data TLB physical revision",               "/IEM/CPU%u/DataTlb-PhysRev", idCpu);
+        STAMR3RegisterF(pVM, &pVCpu->iem.s.DataTlb.cTlbSlowReadPath,    STAMTYPE_U32_RESET, STAMVISIBILITY_ALWAYS, STAMUNIT_NONE,
+                        "Data TLB slow read path",                  "/IEM/CPU%u/DataTlb-SlowReads", idCpu);
+
+        STAMR3RegisterF(pVM, &pVCpu->iem.s.DecodedCache.cHits,         STAMTYPE_U32_RESET, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,
+                        "Instructions replayed from the decoded instruction cache", "/IEM/CPU%u/DecodedCache-Hits", idCpu);
+        STAMR3RegisterF(pVM, &pVCpu->iem.s.DecodedCache.cMisses,       STAMTYPE_U32_RESET, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,
+                        "Decoded instruction cache misses",         "/IEM/CPU%u/DecodedCache-Misses", idCpu);
+        STAMR3RegisterF(pVM, &pVCpu->iem.s.DecodedCache.cWriteFlushes, STAMTYPE_U32_RESET, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,
+                        "Decoded instruction cache flushes caused by writes to cached code", "/IEM/CPU%u/DecodedCache-WriteFlushes", idCpu);
+        STAMR3RegisterF(pVM, &pVCpu->iem.s.DecodedCache.cModified,     STAMTYPE_U32_RESET, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,
+                        "Decoded instruction cache entries not matching guest memory", "/IEM/CPU%u/DecodedCache-Modified", idCpu);
 
 #if defined(VBOX_WITH_STATISTICS) && !defined(DOXYGEN_RUNNING)
         /* Allocate instruction statistics and register them. */
         pVCpu->iem.s.pStatsR3 = (PIEMINSTRSTATS)MMR3HeapAllocZ(pVM, MM_TAG_IEM, sizeof(IEMINSTRSTATS));
         AssertLogRelReturn(pVCpu->iem.s.pStatsR3, VERR_NO_MEMORY);
-        int rc = MMHyperAlloc(pVM, sizeof(IEMINSTRSTATS), sizeof(uint64_t), MM_TAG_IEM, (void **)&pVCpu->iem.s.pStatsCCR3);
+        rc = MMHyperAlloc(pVM, sizeof(IEMINSTRSTATS), sizeof(uint64_t), MM_TAG_IEM, (void **)&pVCpu->iem.s.pStatsCCR3);
         AssertLogRelRCReturn(rc, rc);
         pVCpu->iem.s.pStatsR0 = MMHyperR3ToR0(pVM, pVCpu->iem.s.pStatsCCR3);
         pVCpu->iem.s.pStatsRC = MMHyperR3ToR0(pVM, pVCpu->iem.s.pStatsCCR3);
@@ -29,6 +29,7 @@
 #include <iprt/mem.h>
 #include <iprt/path.h>
 #include <iprt/string.h>
+#include <iprt/time.h>
 #include <VBox/log.h>
 #include <VBox/vmm/stam.h>
 #include <VBox/vmm/uvm.h>
@@ -1121,6 +1122,7 @@ int pdmR3BlkCacheInit(PVM pVM)
             rc = TMR3TimerCreateInternal(pVM, TMCLOCK_REAL,
                                          pdmBlkCacheCommitTimerCallback,
                                          pBlkCacheGlobal,
+                                         0 /*fFlags*/,
                                          "BlkCache-Commit",
                                          &pBlkCacheGlobal->pTimerCommit);
 
@@ -1234,6 +1236,10 @@ static int pdmR3BlkCacheRetain(PVM pVM, PPPDMBLKCACHE ppBlkCache, const char *pc
                                         STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
                                         STAMUNIT_COUNT, "Number of deferred writes",
                                         "/PDM/BlkCache/%s/Cache/DeferredWrites", pBlkCache->pszId);
+                        STAMR3RegisterF(pBlkCacheGlobal->pVM, &pBlkCache->StatReqLatency,
+                                        STAMTYPE_HISTOGRAM, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_NS, "Latency of requests from submission to completion",
+                                        "/PDM/BlkCache/%s/Cache/ReqLatency", pBlkCache->pszId);
 #endif
 
                         /* Add to the list of users. */
@@ -1449,6 +1455,7 @@ VMMR3DECL(void) PDMR3BlkCacheRelease(PPDMBLKCACHE pBlkCache)
 
 #ifdef VBOX_WITH_STATISTICS
     STAMR3DeregisterF(pCache->pVM->pUVM, "/PDM/BlkCache/%s/Cache/DeferredWrites", pBlkCache->pszId);
+    STAMR3DeregisterF(pCache->pVM->pUVM, "/PDM/BlkCache/%s/Cache/ReqLatency", pBlkCache->pszId);
 #endif
 
     RTStrFree(pBlkCache->pszId);
@@ -1856,6 +1863,9 @@ static PPDMBLKCACHEREQ pdmBlkCacheReqAlloc(void *pvUser)
         pReq->pvUser = pvUser;
         pReq->rcReq  = VINF_SUCCESS;
         pReq->cXfersPending = 0;
+#ifdef VBOX_WITH_STATISTICS
+        pReq->tsStart = RTTimeNanoTS();
+#endif
     }
 
     return pReq;
@@ -1907,6 +1917,7 @@ static bool pdmBlkCacheReqUpdate(PPDMBLKCACHE pBlkCache, PPDMBLKCACHEREQ pReq,
 
     if (!cXfersPending)
     {
+        STAM_HISTOGRAM_ADD_SAMPLE(&pBlkCache->StatReqLatency, RTTimeNanoTS() - pReq->tsStart);
         if (fCallHandler)
             pdmBlkCacheReqComplete(pBlkCache, pReq);
         return true;
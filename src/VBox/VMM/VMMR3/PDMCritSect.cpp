@@ -23,6 +23,8 @@
 #include "PDMInternal.h"
 #include <VBox/vmm/pdmcritsect.h>
 #include <VBox/vmm/pdmcritsectrw.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/uvm.h>
@@ -33,6 +35,9 @@
 #include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/lockvalidator.h>
+#include <iprt/mem.h>
+#include <iprt/mp.h>
+#include <iprt/sort.h>
 #include <iprt/string.h>
 #include <iprt/thread.h>
 
@@ -42,24 +47,234 @@
 *********************************************************************************************************************************/
 static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect, PPDMCRITSECTINT pPrev, bool fFinal);
 static int pdmR3CritSectRwDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTRWINT pCritSect, PPDMCRITSECTRWINT pPrev, bool fFinal);
+static void pdmR3CritSectStatsAdd(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect);
+static DECLCALLBACK(void) pdmR3CritSectInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 
 
 
 /**
- * Register statistics related to the critical sections.
+ * Register statistics related to the critical sections and reads the
+ * critical section configuration.
  *
  * @returns VBox status code.
  * @param   pVM         The cross context VM structure.
  */
 int pdmR3CritSectBothInitStats(PVM pVM)
 {
-    RT_NOREF_PV(pVM);
     STAM_REG(pVM, &pVM->pdm.s.StatQueuedCritSectLeaves, STAMTYPE_COUNTER, "/PDM/QueuedCritSectLeaves", STAMUNIT_OCCURENCES,
              "Number of times a critical section leave request needed to be queued for ring-3 execution.");
+
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetChild(CFGMR3GetRoot(pVM), "PDM"), "CritSect");
+
+    /** @cfgm{/PDM/CritSect/SpinMaxR3, uint16_t, 20}
+     * The max number of times to spin in ring-3 on a busy critical section
+     * before blocking.  The actual number is adapted to how long each section
+     * is usually held.  Zero disables spinning.  Spinning is always disabled
+     * on single CPU hosts.  The default is the old fixed ring-3 spin count. */
+    uint16_t cSpinMaxR3;
+    int rc = CFGMR3QueryU16Def(pCfg, "SpinMaxR3", &cSpinMaxR3, 20);
+    AssertLogRelRCReturn(rc, rc);
+
+    /** @cfgm{/PDM/CritSect/SpinMaxRZ, uint16_t, 256}
+     * The max number of times to spin in ring-0 and raw-mode context on a busy
+     * critical section before going to ring-3 (or blocking).  The actual
+     * number is adapted to how long each section is usually held.  Zero
+     * disables spinning.  Spinning is always disabled on single CPU hosts.
+     * The default is the old fixed ring-0 and raw-mode spin count. */
+    uint16_t cSpinMaxRZ;
+    rc = CFGMR3QueryU16Def(pCfg, "SpinMaxRZ", &cSpinMaxRZ, 256);
+    AssertLogRelRCReturn(rc, rc);
+
+    if (RTMpGetCount() <= 1)
+        cSpinMaxR3 = cSpinMaxRZ = 0;
+    pVM->pdm.s.cCritSectSpinMaxR3 = cSpinMaxR3;
+    pVM->pdm.s.cCritSectSpinMaxRZ = cSpinMaxRZ;
+    LogRel(("PDM: Critical section spin limits: R3=%u RZ=%u\n", cSpinMaxR3, cSpinMaxRZ));
+
+    /** @cfgm{/PDM/CritSect/Stats, bool, false}
+     * Whether to collect contention statistics for each critical section: a
+     * histogram of the ring-3 wait times, the spin outcomes and the threads
+     * waiting the most.  See also the 'critsect' info handler.  Ignored in
+     * builds without VBOX_WITH_STATISTICS. */
+    bool fStats;
+    rc = CFGMR3QueryBoolDef(pCfg, "Stats", &fStats, false);
+    AssertLogRelRCReturn(rc, rc);
+#ifndef VBOX_WITH_STATISTICS
+    fStats = false;
+#endif
+    if (fStats)
+    {
+        PUVM pUVM = pVM->pUVM;
+        PPDMCRITSECTSTATS volatile *papStats;
+        papStats = (PPDMCRITSECTSTATS volatile *)MMR3HeapAllocZU(pUVM, MM_TAG_PDM,
+                                                                 sizeof(papStats[0]) * PDMCRITSECTSTATS_HASH_SIZE);
+        AssertReturn(papStats, VERR_NO_MEMORY);
+
+        /* Enable it and pick up the sections created before we got here. */
+        RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+        ASMAtomicWritePtr(&pUVM->pdm.s.papCritSectStats, papStats);
+        for (PPDMCRITSECTINT pCur = pUVM->pdm.s.pCritSects; pCur; pCur = pCur->pNext)
+            pdmR3CritSectStatsAdd(pVM, pUVM, pCur);
+        RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+    }
+
+    DBGFR3InfoRegisterInternal(pVM, "critsect",
+                               "Displays the most contended critical sections. "
+                               "Arguments: 'all' or a name pattern to select which ones.",
+                               pdmR3CritSectInfo);
     return VINF_SUCCESS;
 }
 
 
+/**
+ * Calculates the stats hash table index of a critical section.
+ *
+ * @returns Index into PDMUSERPERVM::papCritSectStats.
+ * @param   pCritSect   The critical section.
+ */
+DECLINLINE(uint32_t) pdmR3CritSectStatsHash(PPDMCRITSECTINT pCritSect)
+{
+    return ((uint32_t)((uintptr_t)pCritSect >> 3) * UINT32_C(0x9e3779b1)) >> (32 - PDMCRITSECTSTATS_HASH_SHIFT);
+}
+
+
+/**
+ * Looks up the contention statistics of a critical section.
+ *
+ * @returns Pointer to the statistics, NULL if disabled or not found.
+ * @param   pUVM        The user mode VM handle.
+ * @param   pCritSect   The critical section.
+ */
+static PPDMCRITSECTSTATS pdmR3CritSectStatsLookup(PUVM pUVM, PPDMCRITSECTINT pCritSect)
+{
+    PPDMCRITSECTSTATS volatile *papStats = pUVM->pdm.s.papCritSectStats;
+    if (!papStats)
+        return NULL;
+
+    uint32_t i = pdmR3CritSectStatsHash(pCritSect);
+    for (uint32_t cLeft = PDMCRITSECTSTATS_HASH_SIZE; cLeft > 0; cLeft--)
+    {
+        PPDMCRITSECTSTATS pStats = ASMAtomicReadPtrT(&papStats[i], PPDMCRITSECTSTATS);
+        if (!pStats)
+            break;
+        if (pStats->pCritSect == pCritSect)
+            return pStats;
+        i = (i + 1) & (PDMCRITSECTSTATS_HASH_SIZE - 1);
+    }
+    return NULL;
+}
+
+
+/**
+ * Adds contention statistics for a critical section if enabled.
+ *
+ * Entries of deleted sections are left in the table so the probe sequences
+ * stay intact, they are recycled here.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pUVM        The user mode VM handle.
+ * @param   pCritSect   The critical section.
+ *
+ * @remarks Caller must have entered the ListCritSect.
+ */
+static void pdmR3CritSectStatsAdd(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect)
+{
+    Assert(RTCritSectIsOwner(&pUVM->pdm.s.ListCritSect));
+    PPDMCRITSECTSTATS volatile *papStats = pUVM->pdm.s.papCritSectStats;
+    if (!papStats)
+        return;
+
+    uint32_t i = pdmR3CritSectStatsHash(pCritSect);
+    for (uint32_t cLeft = PDMCRITSECTSTATS_HASH_SIZE; cLeft > 0; cLeft--)
+    {
+        PPDMCRITSECTSTATS pStats = papStats[i];
+        if (!pStats || !pStats->pCritSect)
+        {
+            bool const fNew = pStats == NULL;
+            if (fNew)
+            {
+                pStats = (PPDMCRITSECTSTATS)MMR3HeapAllocZU(pUVM, MM_TAG_PDM, sizeof(*pStats));
+                if (!pStats)
+                    return;
+            }
+            else
+                RT_BZERO(&pStats->StatSpinHits, sizeof(*pStats) - RT_UOFFSETOF(PDMCRITSECTSTATS, StatSpinHits));
+
+            STAMR3RegisterF(pVM, &pStats->StatSpinHits,   STAMTYPE_COUNTER,   STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Contended enters where spinning got the section.",        "/PDM/CritSects/%s/SpinHits", pCritSect->pszName);
+            STAMR3RegisterF(pVM, &pStats->StatSpinMisses, STAMTYPE_COUNTER,   STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Contended enters where spinning failed.",                 "/PDM/CritSects/%s/SpinMisses", pCritSect->pszName);
+            STAMR3RegisterF(pVM, &pStats->WaitHistogram,  STAMTYPE_HISTOGRAM, STAMVISIBILITY_ALWAYS, STAMUNIT_NS,         "Time spent blocking on the section in ring-3.",           "/PDM/CritSects/%s/WaitHistogram", pCritSect->pszName);
+
+            ASMAtomicWritePtr(&pStats->pCritSect, pCritSect);
+            if (fNew)
+                ASMAtomicWritePtr(&papStats[i], pStats);
+            return;
+        }
+        i = (i + 1) & (PDMCRITSECTSTATS_HASH_SIZE - 1);
+    }
+    LogRel(("PDM: The critical section statistics table is full, no statistics for '%s'\n", pCritSect->pszName));
+}
+
+
+/**
+ * Records the outcome of spinning on a busy critical section.
+ *
+ * @param   pCritSect   The critical section.
+ * @param   fHit        Whether spinning got us the section.
+ */
+void pdmR3CritSectStatsSpin(PPDMCRITSECTINT pCritSect, bool fHit)
+{
+    PPDMCRITSECTSTATS pStats = pdmR3CritSectStatsLookup(pCritSect->pVMR3->pUVM, pCritSect);
+    if (pStats)
+    {
+        /* Unlike the wait statistics, the misses aren't serialized by the
+           section, so the counters must be updated atomically. */
+        if (fHit)
+            ASMAtomicIncU64(&pStats->StatSpinHits.c);
+        else
+            ASMAtomicIncU64(&pStats->StatSpinMisses.c);
+    }
+}
+
+
+/**
+ * Records the time spent waiting for a critical section in ring-3.
+ *
+ * @param   pCritSect   The critical section, owned by the caller.
+ * @param   cNsWaited   The number of nanoseconds spent waiting.
+ */
+void pdmR3CritSectStatsWait(PPDMCRITSECTINT pCritSect, uint64_t cNsWaited)
+{
+    PPDMCRITSECTSTATS pStats = pdmR3CritSectStatsLookup(pCritSect->pVMR3->pUVM, pCritSect);
+    if (!pStats)
+        return;
+    STAMHistogramAddSample(&pStats->WaitHistogram, cNsWaited);
+
+    /*
+     * Update the top waiters.  We own the section, so no locking needed.
+     */
+    RTNATIVETHREAD const hNativeSelf = RTThreadNativeSelf();
+    unsigned             iMin        = 0;
+    unsigned             i;
+    for (i = 0; i < RT_ELEMENTS(pStats->aTopWaiters); i++)
+    {
+        if (   pStats->aTopWaiters[i].cWaits
+            && pStats->aTopWaiters[i].hNativeThread == hNativeSelf)
+            break;
+        if (pStats->aTopWaiters[i].cNsWaited < pStats->aTopWaiters[iMin].cNsWaited)
+            iMin = i;
+    }
+    if (i >= RT_ELEMENTS(pStats->aTopWaiters))
+    {
+        i = iMin;
+        pStats->aTopWaiters[i].hNativeThread = hNativeSelf;
+        const char *pszName = RTThreadSelfName();
+        RTStrCopy(pStats->aTopWaiters[i].szName, sizeof(pStats->aTopWaiters[i].szName), pszName ? pszName : "<unknown>");
+    }
+    pStats->aTopWaiters[i].cWaits++;
+    pStats->aTopWaiters[i].cNsWaited += cNsWaited;
+}
+
+
 /**
  * Relocates all the critical sections.
  *
@@ -183,6 +398,7 @@ static int pdmR3CritSectInitOne(PVM pVM, PPDMCRITSECTINT pCritSect, void *pvKey,
                 pCritSect->pvKey                     = pvKey;
                 pCritSect->fAutomaticDefaultCritsect = false;
                 pCritSect->fUsedByTimerOrSimilar     = false;
+                pCritSect->uSpinAvg                  = PDMCRITSECT_SPIN_AVG_INIT;
                 pCritSect->hEventToSignal            = NIL_SUPSEMEVENT;
                 pCritSect->pszName                   = pszName;
 
@@ -197,6 +413,7 @@ static int pdmR3CritSectInitOne(PVM pVM, PPDMCRITSECTINT pCritSect, void *pvKey,
                 RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
                 pCritSect->pNext = pUVM->pdm.s.pCritSects;
                 pUVM->pdm.s.pCritSects = pCritSect;
+                pdmR3CritSectStatsAdd(pVM, pUVM, pCritSect);
                 RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
 
                 return VINF_SUCCESS;
@@ -532,6 +749,9 @@ static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect,
     pCritSect->pVMR3   = NULL;
     pCritSect->pVMR0   = NIL_RTR0PTR;
     pCritSect->pVMRC   = NIL_RTRCPTR;
+    PPDMCRITSECTSTATS pStats = pdmR3CritSectStatsLookup(pUVM, pCritSect);
+    if (pStats)
+        ASMAtomicWriteNullPtr(&pStats->pCritSect);
     if (!fFinal)
         STAMR3DeregisterF(pVM->pUVM, "/PDM/CritSects/%s/*", pCritSect->pszName);
     RTStrFree((char *)pCritSect->pszName);
@@ -1076,3 +1296,167 @@ VMMR3DECL(RCPTRTYPE(PPDMCRITSECT))  PDMR3CritSectGetNopRC(PVM pVM)
     return MMHyperR3ToRC(pVM, &pVM->pdm.s.NopCritSect);
 }
 
+
+
+/**
+ * Calculates a percentile of a histogram sample.
+ *
+ * @returns The upper bound of the bucket the percentile falls in, clamped to
+ *          the max value seen.
+ * @param   pHistogram  The histogram.
+ * @param   uPerMille   The percentile in per mille.
+ */
+static uint64_t pdmR3CritSectHistogramPercentile(PSTAMHISTOGRAM pHistogram, uint32_t uPerMille)
+{
+    uint64_t cTotal = 0;
+    for (uint32_t i = 0; i < STAMHISTOGRAM_BUCKETS; i++)
+        cTotal += pHistogram->acBuckets[i];
+    if (!cTotal)
+        return 0;
+
+    uint64_t const cRank = RT_MAX((cTotal * uPerMille + 999) / 1000, 1);
+    uint64_t       cSeen = 0;
+    for (uint32_t i = 0; i + 1 < STAMHISTOGRAM_BUCKETS; i++)
+    {
+        cSeen += pHistogram->acBuckets[i];
+        if (cSeen >= cRank)
+            return RT_MIN(STAMHistogramBucketToValue(i + 1) - 1, pHistogram->Core.cTicksMax);
+    }
+    return pHistogram->Core.cTicksMax;
+}
+
+
+/**
+ * Entry in the pdmR3CritSectInfo sort array.
+ */
+typedef struct PDMCRITSECTINFOENTRY
+{
+    /** The critical section. */
+    PPDMCRITSECTINT     pCritSect;
+    /** The contention statistics, NULL if not available. */
+    PPDMCRITSECTSTATS   pStats;
+    /** The total time spent waiting (ns), zero w/o statistics. */
+    uint64_t            cNsWaited;
+    /** The number of contended enters. */
+    uint64_t            cContentions;
+} PDMCRITSECTINFOENTRY;
+/** Pointer to a pdmR3CritSectInfo sort entry. */
+typedef PDMCRITSECTINFOENTRY *PPDMCRITSECTINFOENTRY;
+
+
+/**
+ * @callback_method_impl{FNRTSORTCMP, Most waited on and contended first.}
+ */
+static DECLCALLBACK(int) pdmR3CritSectInfoCompare(void const *pvElement1, void const *pvElement2, void *pvUser)
+{
+    PPDMCRITSECTINFOENTRY pEntry1 = (PPDMCRITSECTINFOENTRY)pvElement1;
+    PPDMCRITSECTINFOENTRY pEntry2 = (PPDMCRITSECTINFOENTRY)pvElement2;
+    RT_NOREF(pvUser);
+    if (pEntry1->cNsWaited != pEntry2->cNsWaited)
+        return pEntry1->cNsWaited > pEntry2->cNsWaited ? -1 : 1;
+    if (pEntry1->cContentions != pEntry2->cContentions)
+        return pEntry1->cContentions > pEntry2->cContentions ? -1 : 1;
+    return 0;
+}
+
+
+/**
+ * @callback_method_impl{FNDBGFHANDLERINT,
+ *      Displays the most contended critical sections.  Without arguments the top
+ *      20 are listed\, 'all' lists all of them and anything else is taken to be
+ *      a name pattern.}
+ */
+static DECLCALLBACK(void) pdmR3CritSectInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    /*
+     * Parse the argument.
+     */
+    char        szPattern[128];
+    const char *pszPattern = NULL;
+    uint32_t    cMax       = 20;
+    if (pszArgs)
+    {
+        RTStrCopy(szPattern, sizeof(szPattern), pszArgs);
+        pszPattern = RTStrStrip(szPattern);
+        if (!*pszPattern)
+            pszPattern = NULL;
+        else
+        {
+            cMax = UINT32_MAX;
+            if (!strcmp(pszPattern, "all"))
+                pszPattern = NULL;
+        }
+    }
+
+    /*
+     * Gather and sort.  We keep the list locked while displaying so nothing
+     * gets deleted under our feet.
+     */
+    PUVM pUVM = pVM->pUVM;
+    RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+
+    uint32_t cCritSects = 0;
+    for (PPDMCRITSECTINT pCur = pUVM->pdm.s.pCritSects; pCur; pCur = pCur->pNext)
+        cCritSects++;
+    PPDMCRITSECTINFOENTRY paEntries = (PPDMCRITSECTINFOENTRY)RTMemTmpAlloc(sizeof(paEntries[0]) * RT_MAX(cCritSects, 1));
+    if (!paEntries)
+    {
+        RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+        pHlp->pfnPrintf(pHlp, "Out of memory!\n");
+        return;
+    }
+
+    uint32_t cEntries = 0;
+    for (PPDMCRITSECTINT pCur = pUVM->pdm.s.pCritSects; pCur; pCur = pCur->pNext)
+    {
+        if (pszPattern && !RTStrSimplePatternMatch(pszPattern, pCur->pszName))
+            continue;
+        PPDMCRITSECTINFOENTRY pEntry = &paEntries[cEntries++];
+        pEntry->pCritSect    = pCur;
+        pEntry->pStats       = pdmR3CritSectStatsLookup(pUVM, pCur);
+        pEntry->cNsWaited    = pEntry->pStats ? pEntry->pStats->WaitHistogram.Core.cTicks : 0;
+        pEntry->cContentions = pCur->StatContentionR3.c + pCur->StatContentionRZLock.c;
+    }
+    RTSortShell(paEntries, cEntries, sizeof(paEntries[0]), pdmR3CritSectInfoCompare, NULL);
+
+    /*
+     * Display.
+     */
+    pHlp->pfnPrintf(pHlp, "Critical sections: %u of %u shown; spin max R3=%u RZ=%u; statistics %s\n",
+                    RT_MIN(cEntries, cMax), cCritSects, pVM->pdm.s.cCritSectSpinMaxR3, pVM->pdm.s.cCritSectSpinMaxRZ,
+                    pUVM->pdm.s.papCritSectStats ? "enabled" : "disabled (/PDM/CritSect/Stats)");
+    for (uint32_t i = 0; i < cEntries && i < cMax; i++)
+    {
+        PPDMCRITSECTINT   pCritSect = paEntries[i].pCritSect;
+        PPDMCRITSECTSTATS pStats    = paEntries[i].pStats;
+        uint32_t const    uSpinAvg  = pCritSect->uSpinAvg;
+        pHlp->pfnPrintf(pHlp,
+                        "%s:\n"
+                        "  contention: R3=%RU64 RZLock=%RU64 RZUnlock=%RU64  spin avg=%u.%u budget=%u\n",
+                        pCritSect->pszName,
+                        pCritSect->StatContentionR3.c, pCritSect->StatContentionRZLock.c, pCritSect->StatContentionRZUnlock.c,
+                        uSpinAvg / PDMCRITSECT_SPIN_AVG_SCALE,
+                        (uSpinAvg % PDMCRITSECT_SPIN_AVG_SCALE) * 10 / PDMCRITSECT_SPIN_AVG_SCALE,
+                        RT_MIN(uSpinAvg * 2 / PDMCRITSECT_SPIN_AVG_SCALE + PDMCRITSECT_SPIN_MIN, pVM->pdm.s.cCritSectSpinMaxR3));
+        if (!pStats)
+            continue;
+
+        PSTAMHISTOGRAM pHist  = &pStats->WaitHistogram;
+        uint64_t const cWaits = pHist->Core.cPeriods;
+        pHlp->pfnPrintf(pHlp,
+                        "  spin hits=%RU64 misses=%RU64  waits=%RU64 total=%RU64ns avg=%RU64ns p50=%RU64ns p99=%RU64ns max=%RU64ns\n",
+                        pStats->StatSpinHits.c, pStats->StatSpinMisses.c, cWaits, pHist->Core.cTicks,
+                        cWaits ? pHist->Core.cTicks / cWaits : 0,
+                        pdmR3CritSectHistogramPercentile(pHist, 500), pdmR3CritSectHistogramPercentile(pHist, 990),
+                        pHist->Core.cTicksMax);
+        for (uint32_t iWaiter = 0; iWaiter < RT_ELEMENTS(pStats->aTopWaiters); iWaiter++)
+            if (pStats->aTopWaiters[iWaiter].cWaits)
+                pHlp->pfnPrintf(pHlp, "    %-16s %RTnthrd: waits=%RU64 total=%RU64ns\n",
+                                pStats->aTopWaiters[iWaiter].szName, pStats->aTopWaiters[iWaiter].hNativeThread,
+                                pStats->aTopWaiters[iWaiter].cWaits, pStats->aTopWaiters[iWaiter].cNsWaited);
+    }
+
+    RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+    RTMemTmpFree(paEntries);
+}
+
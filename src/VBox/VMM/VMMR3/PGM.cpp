@@ -1759,6 +1759,9 @@ static int pgmR3InitStats(PVM pVM)
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cDirtyPagesShort,     STAMTYPE_U32,     "/PGM/LiveSave/cDirtyPagesShort",     STAMUNIT_COUNT,     "Short term dirty page average.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cPagesPerSecond,      STAMTYPE_U32,     "/PGM/LiveSave/cPagesPerSecond",      STAMUNIT_COUNT,     "Pages per second.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cSavedPages,          STAMTYPE_U64,     "/PGM/LiveSave/cSavedPages",          STAMUNIT_COUNT,     "The total number of saved pages.");
+    STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cScannedPagesPass,    STAMTYPE_U32,     "/PGM/LiveSave/Pass/cScannedPages",   STAMUNIT_COUNT,     "RAM and MMIO2 pages scanned in the last pass.");
+    STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cDirtiedPagesPass,    STAMTYPE_U32,     "/PGM/LiveSave/Pass/cDirtiedPages",   STAMUNIT_COUNT,     "RAM and MMIO2 pages found dirty in the last pass.");
+    STAM_REL_REG_USED(pVM, &pPGM->LiveSave.cSavedPagesPass,      STAMTYPE_U32,     "/PGM/LiveSave/Pass/cSavedPages",     STAMUNIT_COUNT,     "Pages saved in the last pass.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.Ram.cReadyPages,      STAMTYPE_U32,     "/PGM/LiveSave/Ram/cReadPages",       STAMUNIT_COUNT,     "RAM: Ready pages.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.Ram.cDirtyPages,      STAMTYPE_U32,     "/PGM/LiveSave/Ram/cDirtyPages",      STAMUNIT_COUNT,     "RAM: Dirty pages.");
     STAM_REL_REG_USED(pVM, &pPGM->LiveSave.Ram.cZeroPages,       STAMTYPE_U32,     "/PGM/LiveSave/Ram/cZeroPages",       STAMUNIT_COUNT,     "RAM: Ready zero pages.");
@@ -4538,6 +4538,7 @@ VMMDECL(void) PGMR3PhysSetA20(PVMCPU pVCpu, bool fEnable)
         pgmR3RefreshShadowModeAfterA20Change(pVCpu);
         HMFlushTLB(pVCpu);
 #endif
+        IEMTlbInvalidateAll(pVCpu, false /*fVmm*/); /* The guest page walk results depend on A20 too. */
         IEMTlbInvalidateAllPhysical(pVCpu);
         STAM_REL_COUNTER_INC(&pVCpu->pgm.s.cA20Changes);
     }
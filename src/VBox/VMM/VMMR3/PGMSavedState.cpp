@@ -21,6 +21,7 @@
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_PGM
 #include <VBox/vmm/pgm.h>
+#include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/stam.h>
 #include <VBox/vmm/ssm.h>
 #include <VBox/vmm/pdmdrv.h>
@@ -37,7 +38,8 @@
 #include <iprt/assert.h>
 #include <iprt/crc.h>
 #include <iprt/mem.h>
-#include <iprt/sha.h>
+#include <iprt/mp.h>
+#include <iprt/req.h>
 #include <iprt/string.h>
 #include <iprt/thread.h>
 
@@ -100,8 +102,21 @@
 
 /** The CRC-32 for a zero page. */
 #define PGM_STATE_CRC32_ZERO_PAGE       UINT32_C(0xc71c0011)
-/** The CRC-32 for a zero half page. */
-#define PGM_STATE_CRC32_ZERO_HALF_PAGE  UINT32_C(0xf1e8ba9e)
+
+/** @name Page hashing (MMIO2 change detection).
+ * @{ */
+/** Hash multiplier 1. */
+#define PGM_STATE_HASH_PRIME_1          UINT64_C(0x9e3779b185ebca87)
+/** Hash multiplier 2. */
+#define PGM_STATE_HASH_PRIME_2          UINT64_C(0xc2b2ae3d27d4eb4f)
+/** Hash multiplier 3. */
+#define PGM_STATE_HASH_PRIME_3          UINT64_C(0x165667b19e3779f9)
+/** @} */
+
+/** The number of MMIO2 pages per scan work item. */
+#define PGM_STATE_MMIO2_SCAN_CHUNK      _1K
+/** The max number of MMIO2 scan work items outstanding. */
+#define PGM_STATE_MMIO2_SCAN_MAX_REQS   32
 
 
 
@@ -657,8 +672,6 @@ static int pgmR3PrepMmio2Pages(PVM pVM)
                 paLSPages[iPage].fDirty          = true;
                 paLSPages[iPage].cUnchangedScans = 0;
                 paLSPages[iPage].fZero           = true;
-                paLSPages[iPage].u32CrcH1        = PGM_STATE_CRC32_ZERO_HALF_PAGE;
-                paLSPages[iPage].u32CrcH2        = PGM_STATE_CRC32_ZERO_HALF_PAGE;
             }
 
             pgmLock(pVM);
@@ -666,7 +679,32 @@ static int pgmR3PrepMmio2Pages(PVM pVM)
             pVM->pgm.s.LiveSave.Mmio2.cDirtyPages += cPages;
         }
     }
+    uint32_t const cMmio2Pages = pVM->pgm.s.LiveSave.Mmio2.cDirtyPages;
     pgmUnlock(pVM);
+
+    /*
+     * Create worker threads for scanning if there is enough to scan.
+     */
+    /** @cfgm{/PGM/LiveSaveScanThreads, uint32_t, host CPUs less one (max 4)}
+     * The number of worker threads used for scanning MMIO2 pages for changes
+     * during live save and teleportation.  Zero scans on the saving thread. */
+    uint32_t const cCpus = RTMpGetOnlineCount();
+    uint32_t       cThreads;
+    int rc = CFGMR3QueryU32Def(CFGMR3GetChild(CFGMR3GetRoot(pVM), "PGM"), "LiveSaveScanThreads", &cThreads,
+                               RT_MIN(cCpus > 1 ? cCpus - 1 : 0, 4));
+    AssertLogRelRCReturn(rc, rc);
+    pVM->pgm.s.LiveSave.hScanPoolR3 = NIL_RTREQPOOL;
+    if (   cThreads > 0
+        && cMmio2Pages > PGM_STATE_MMIO2_SCAN_CHUNK)
+    {
+        rc = RTReqPoolCreate(RT_MIN(cThreads, PGM_STATE_MMIO2_SCAN_MAX_REQS), RT_MS_1SEC, cThreads, 0 /*cMsMaxPushBack*/,
+                             "PGMScan", &pVM->pgm.s.LiveSave.hScanPoolR3);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("PGM: Failed to create the live save scan workers: %Rrc\n", rc));
+            pVM->pgm.s.LiveSave.hScanPoolR3 = NIL_RTREQPOOL;
+        }
+    }
     return VINF_SUCCESS;
 }
 
@@ -791,9 +829,56 @@ static int pgmR3LoadMmio2Ranges(PVM pVM, PSSMHANDLE pSSM)
 }
 
 
+/**
+ * Calculates a fast, non-cryptographic 128-bit hash of a page.
+ *
+ * This is only used for detecting page changes, so all that matters is speed
+ * and that modifications are very unlikely to go unnoticed.  Four independent
+ * multiply-rotate lanes are run over the page to keep the CPU busy, and the
+ * result is made by two different mixes of the lanes.
+ *
+ * @param   pbPage              The page bits.
+ * @param   puHash              Where to return the hash.
+ */
+DECLINLINE(void) pgmR3StateHashPage(uint8_t const *pbPage, PRTUINT128U puHash)
+{
+    uint64_t const *pu64 = (uint64_t const *)pbPage;
+    uint64_t        u1   = PGM_STATE_HASH_PRIME_1 + PGM_STATE_HASH_PRIME_2;
+    uint64_t        u2   = PGM_STATE_HASH_PRIME_2;
+    uint64_t        u3   = 0;
+    uint64_t        u4   = UINT64_C(0) - PGM_STATE_HASH_PRIME_1;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i += 4)
+    {
+        u1 = ASMRotateLeftU64(u1 + pu64[i    ] * PGM_STATE_HASH_PRIME_2, 31) * PGM_STATE_HASH_PRIME_1;
+        u2 = ASMRotateLeftU64(u2 + pu64[i + 1] * PGM_STATE_HASH_PRIME_2, 31) * PGM_STATE_HASH_PRIME_1;
+        u3 = ASMRotateLeftU64(u3 + pu64[i + 2] * PGM_STATE_HASH_PRIME_2, 31) * PGM_STATE_HASH_PRIME_1;
+        u4 = ASMRotateLeftU64(u4 + pu64[i + 3] * PGM_STATE_HASH_PRIME_2, 31) * PGM_STATE_HASH_PRIME_1;
+    }
+
+    uint64_t uLo = ASMRotateLeftU64(u1, 1) + ASMRotateLeftU64(u2, 7) + ASMRotateLeftU64(u3, 12) + ASMRotateLeftU64(u4, 18);
+    uLo ^= uLo >> 33;
+    uLo *= PGM_STATE_HASH_PRIME_2;
+    uLo ^= uLo >> 29;
+    uLo *= PGM_STATE_HASH_PRIME_3;
+    uLo ^= uLo >> 32;
+
+    uint64_t uHi = (u1 ^ ASMRotateLeftU64(u3, 29)) * PGM_STATE_HASH_PRIME_3 + (u2 ^ ASMRotateLeftU64(u4, 43));
+    uHi ^= uHi >> 31;
+    uHi *= PGM_STATE_HASH_PRIME_1;
+    uHi ^= uHi >> 27;
+    uHi *= PGM_STATE_HASH_PRIME_2;
+    uHi ^= uHi >> 33;
+
+    puHash->s.Lo = uLo;
+    puHash->s.Hi = uHi;
+}
+
+
 /**
  * Scans one MMIO2 page.
  *
+ * This may be called concurrently for different pages.
+ *
  * @returns True if changed, false if unchanged.
  *
  * @param   pVM                 The cross context VM structure.
@@ -817,39 +902,26 @@ DECLINLINE(bool) pgmR3ScanMmio2Page(PVM pVM, uint8_t const *pbPage, PPGMLIVESAVE
             return false;
         }
 
-        pLSPage->fZero    = false;
-        pLSPage->u32CrcH1 = RTCrc32(pbPage, PAGE_SIZE / 2);
+        pLSPage->fZero = false;
+        pgmR3StateHashPage(pbPage, &pLSPage->uHash);
     }
     else
     {
-        /*
-         * CRC the first half, if it doesn't match the page is dirty and
-         * we won't check the 2nd half (we'll do that next time).
-         */
-        uint32_t u32CrcH1 = RTCrc32(pbPage, PAGE_SIZE / 2);
-        if (u32CrcH1 == pLSPage->u32CrcH1)
+        RTUINT128U uHash;
+        pgmR3StateHashPage(pbPage, &uHash);
+        if (   uHash.s.Lo == pLSPage->uHash.s.Lo
+            && uHash.s.Hi == pLSPage->uHash.s.Hi)
         {
-            uint32_t u32CrcH2 = RTCrc32(pbPage + PAGE_SIZE / 2, PAGE_SIZE / 2);
-            if (u32CrcH2 == pLSPage->u32CrcH2)
-            {
-                /* Probably not modified. */
-                if (pLSPage->fDirty)
-                    pLSPage->cUnchangedScans++;
-                return false;
-            }
-
-            pLSPage->u32CrcH2 = u32CrcH2;
-        }
-        else
-        {
-            pLSPage->u32CrcH1 = u32CrcH1;
-            if (    u32CrcH1 == PGM_STATE_CRC32_ZERO_HALF_PAGE
-                &&  ASMMemIsZeroPage(pbPage))
-            {
-                pLSPage->u32CrcH2 = PGM_STATE_CRC32_ZERO_HALF_PAGE;
-                pLSPage->fZero    = true;
-            }
+            /* Probably not modified. */
+            if (pLSPage->fDirty)
+                pLSPage->cUnchangedScans++;
+            return false;
         }
+
+        pLSPage->uHash = uHash;
+        if (    *(uint64_t const *)pbPage == 0
+            &&  ASMMemIsZeroPage(pbPage))
+            pLSPage->fZero = true;
     }
 
     /* dirty page path */
@@ -857,18 +929,60 @@ DECLINLINE(bool) pgmR3ScanMmio2Page(PVM pVM, uint8_t const *pbPage, PPGMLIVESAVE
     if (!pLSPage->fDirty)
     {
         pLSPage->fDirty = true;
-        pVM->pgm.s.LiveSave.Mmio2.cReadyPages--;
-        pVM->pgm.s.LiveSave.Mmio2.cDirtyPages++;
+        ASMAtomicDecU32(&pVM->pgm.s.LiveSave.Mmio2.cReadyPages);
+        ASMAtomicIncU32(&pVM->pgm.s.LiveSave.Mmio2.cDirtyPages);
         if (fZero)
-            pVM->pgm.s.LiveSave.Mmio2.cZeroPages--;
+            ASMAtomicDecU32(&pVM->pgm.s.LiveSave.Mmio2.cZeroPages);
+        ASMAtomicIncU32(&pVM->pgm.s.LiveSave.cDirtiedPagesPass);
     }
     return true;
 }
 
 
+/**
+ * Scans a chunk of an MMIO2 range for modifications.
+ *
+ * This is called on the live save scan worker threads.
+ *
+ * @param   pVM                 The cross context VM structure.
+ * @param   pRegMmio            The MMIO2 range.
+ * @param   iFirst              The first page to scan.
+ * @param   cPages              The number of pages to scan.
+ */
+static DECLCALLBACK(void) pgmR3ScanMmio2Chunk(PVM pVM, PPGMREGMMIORANGE pRegMmio, uint32_t iFirst, uint32_t cPages)
+{
+    PPGMLIVESAVEMMIO2PAGE paLSPages = pRegMmio->paLSPages;
+    uint8_t const        *pbPage    = (uint8_t const *)pRegMmio->pvR3 + ((size_t)iFirst << PAGE_SHIFT);
+    for (uint32_t iPage = iFirst; iPage < iFirst + cPages; iPage++, pbPage += PAGE_SIZE)
+        pgmR3ScanMmio2Page(pVM, pbPage, &paLSPages[iPage]);
+    ASMAtomicAddU32(&pVM->pgm.s.LiveSave.cScannedPagesPass, cPages);
+}
+
+
+/**
+ * Waits for outstanding MMIO2 scan requests.
+ *
+ * @param   papReqs             The requests.
+ * @param   pcReqs              The number of requests, set to zero.
+ */
+static void pgmR3ScanMmio2Wait(PRTREQ *papReqs, uint32_t *pcReqs)
+{
+    for (uint32_t i = 0; i < *pcReqs; i++)
+    {
+        int rc = RTReqWait(papReqs[i], RT_INDEFINITE_WAIT);
+        AssertRC(rc);
+        RTReqRelease(papReqs[i]);
+    }
+    *pcReqs = 0;
+}
+
+
 /**
  * Scan for MMIO2 page modifications.
  *
+ * The ranges are split up into chunks that are scanned in parallel when we've
+ * got worker threads.
+ *
  * @param   pVM                 The cross context VM structure.
  * @param   uPass               The pass number.
  */
@@ -876,30 +990,51 @@ static void pgmR3ScanMmio2Pages(PVM pVM, uint32_t uPass)
 {
     /*
      * Since this is a bit expensive we lower the scan rate after a little while.
+     * The final pass is always scanned as pgmR3SaveMmio2Pages relies on it.
      */
-    if (    (    (uPass & 3) != 0
-             &&  uPass > 10)
-        ||  uPass == SSM_PASS_FINAL)
+    if (    (uPass & 3) != 0
+        &&  uPass > 10
+        &&  uPass != SSM_PASS_FINAL)
         return;
 
+    RTREQPOOL const hPool = pVM->pgm.s.LiveSave.hScanPoolR3;
+    PRTREQ          apReqs[PGM_STATE_MMIO2_SCAN_MAX_REQS];
+    uint32_t        cReqs = 0;
+
     pgmLock(pVM);                       /* paranoia */
     for (PPGMREGMMIORANGE pRegMmio = pVM->pgm.s.pRegMmioRangesR3; pRegMmio; pRegMmio = pRegMmio->pNextR3)
         if (pRegMmio->fFlags & PGMREGMMIORANGE_F_MMIO2)
         {
-            PPGMLIVESAVEMMIO2PAGE paLSPages = pRegMmio->paLSPages;
-            uint32_t              cPages    = pRegMmio->RamRange.cb >> PAGE_SHIFT;
+            uint32_t const cPages = pRegMmio->RamRange.cb >> PAGE_SHIFT;
             pgmUnlock(pVM);
 
-            for (uint32_t iPage = 0; iPage < cPages; iPage++)
+            for (uint32_t iFirst = 0; iFirst < cPages; iFirst += PGM_STATE_MMIO2_SCAN_CHUNK)
             {
-                uint8_t const *pbPage = (uint8_t const *)pRegMmio->pvR3 + iPage * PAGE_SIZE;
-                pgmR3ScanMmio2Page(pVM, pbPage, &paLSPages[iPage]);
+                uint32_t const cChunk = RT_MIN(cPages - iFirst, PGM_STATE_MMIO2_SCAN_CHUNK);
+                if (hPool != NIL_RTREQPOOL)
+                {
+                    if (cReqs >= RT_ELEMENTS(apReqs))
+                        pgmR3ScanMmio2Wait(apReqs, &cReqs);
+                    PRTREQ pReq = NIL_RTREQ;
+                    int rc = RTReqPoolCallEx(hPool, 0 /*cMillies*/, &pReq, RTREQFLAGS_VOID, (PFNRT)pgmR3ScanMmio2Chunk, 4,
+                                             pVM, pRegMmio, (uintptr_t)iFirst, (uintptr_t)cChunk);
+                    if (rc == VINF_SUCCESS || rc == VERR_TIMEOUT)
+                    {
+                        apReqs[cReqs++] = pReq;
+                        continue;
+                    }
+                    AssertLogRelMsgFailed(("PGM: RTReqPoolCallEx failed: %Rrc\n", rc));
+                    if (pReq != NIL_RTREQ)
+                        RTReqRelease(pReq);
+                }
+                pgmR3ScanMmio2Chunk(pVM, pRegMmio, iFirst, cChunk);
             }
 
             pgmLock(pVM);
         }
     pgmUnlock(pVM);
 
+    pgmR3ScanMmio2Wait(apReqs, &cReqs);
 }
 
 
@@ -940,16 +1075,14 @@ static int pgmR3SaveMmio2Pages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_
                         u8Type = ASMMemIsZeroPage(pbPage) ? PGM_STATE_REC_MMIO2_ZERO : PGM_STATE_REC_MMIO2_RAW;
                     else
                     {
-                        /* Try figure if it's a clean page, compare the SHA-1 to be really sure. */
-                        if (   !paLSPages[iPage].fDirty
-                            && !pgmR3ScanMmio2Page(pVM, pbPage, &paLSPages[iPage]))
+                        /* Skip clean pages matching what we saved.  The hash is
+                           up to date as pgmR3SaveExec has just scanned all pages. */
+                        if (!paLSPages[iPage].fDirty)
                         {
                             if (paLSPages[iPage].fZero)
                                 continue;
-
-                            uint8_t abSha1Hash[RTSHA1_HASH_SIZE];
-                            RTSha1(pbPage, PAGE_SIZE, abSha1Hash);
-                            if (!memcmp(abSha1Hash, paLSPages[iPage].abSha1Saved, sizeof(abSha1Hash)))
+                            if (   paLSPages[iPage].uHash.s.Lo == paLSPages[iPage].uHashSaved.s.Lo
+                                && paLSPages[iPage].uHash.s.Hi == paLSPages[iPage].uHashSaved.s.Hi)
                                 continue;
                         }
                         u8Type = paLSPages[iPage].fZero ? PGM_STATE_REC_MMIO2_ZERO : PGM_STATE_REC_MMIO2_RAW;
@@ -1009,7 +1142,7 @@ static int pgmR3SaveMmio2Pages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_
                     if (!fZero)
                     {
                         memcpy(abPage, pbPage, PAGE_SIZE);
-                        RTSha1(abPage, PAGE_SIZE, paLSPages[iPage].abSha1Saved);
+                        pgmR3StateHashPage(abPage, &paLSPages[iPage].uHashSaved);
                     }
 
                     uint8_t u8Type = paLSPages[iPage].fZero ? PGM_STATE_REC_MMIO2_ZERO : PGM_STATE_REC_MMIO2_RAW;
@@ -1070,6 +1203,12 @@ static void pgmR3DoneMmio2Pages(PVM pVM)
             }
         }
     pgmUnlock(pVM);
+
+    /*
+     * Get rid of the scan workers.
+     */
+    RTReqPoolRelease(pVM->pgm.s.LiveSave.hScanPoolR3);
+    pVM->pgm.s.LiveSave.hScanPoolR3 = NIL_RTREQPOOL;
 }
 
 
@@ -1357,6 +1496,8 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
      */
     RTGCPHYS GCPhysCur = 0;
     PPGMRAMRANGE pCur;
+    uint32_t cScanned = 0;
+    uint32_t cDirtied = 0;
     pgmLock(pVM);
     do
     {
@@ -1387,6 +1528,7 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
                     /* Skip already ignored pages. */
                     if (paLSPages[iPage].fIgnore)
                         continue;
+                    cScanned++;
 
                     if (RT_LIKELY(PGM_PAGE_GET_TYPE(&pCur->aPages[iPage]) == PGMPAGETYPE_RAM))
                     {
@@ -1419,6 +1561,7 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
                                     if (paLSPages[iPage].fZero)
                                         pVM->pgm.s.LiveSave.Ram.cZeroPages--;
                                     pVM->pgm.s.LiveSave.Ram.cDirtyPages++;
+                                    cDirtied++;
                                     if (++paLSPages[iPage].cDirtied > PGMLIVSAVEPAGE_MAX_DIRTIED)
                                         paLSPages[iPage].cDirtied = PGMLIVSAVEPAGE_MAX_DIRTIED;
                                 }
@@ -1457,6 +1600,7 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
                                     {
                                         pVM->pgm.s.LiveSave.Ram.cReadyPages--;
                                         pVM->pgm.s.LiveSave.Ram.cDirtyPages++;
+                                        cDirtied++;
                                         if (++paLSPages[iPage].cDirtied > PGMLIVSAVEPAGE_MAX_DIRTIED)
                                             paLSPages[iPage].cDirtied = PGMLIVSAVEPAGE_MAX_DIRTIED;
                                     }
@@ -1472,6 +1616,7 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
                                         paLSPages[iPage].fDirty = 1;
                                         pVM->pgm.s.LiveSave.Ram.cReadyPages--;
                                         pVM->pgm.s.LiveSave.Ram.cDirtyPages++;
+                                        cDirtied++;
                                     }
                                     paLSPages[iPage].fZero = 1;
                                     paLSPages[iPage].fShared = 0;
@@ -1491,6 +1636,7 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
                                         if (paLSPages[iPage].fZero)
                                             pVM->pgm.s.LiveSave.Ram.cZeroPages--;
                                         pVM->pgm.s.LiveSave.Ram.cDirtyPages++;
+                                        cDirtied++;
                                     }
                                     paLSPages[iPage].fZero = 0;
                                     paLSPages[iPage].fShared = 1;
@@ -1547,6 +1693,8 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
             }
         } /* for each range */
     } while (pCur);
+    pVM->pgm.s.LiveSave.cScannedPagesPass += cScanned;
+    pVM->pgm.s.LiveSave.cDirtiedPagesPass += cDirtied;
     pgmUnlock(pVM);
 }
 
@@ -1870,6 +2018,9 @@ static DECLCALLBACK(int) pgmR3LiveExec(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
         pVM->pgm.s.LiveSave.cSavedPages  = 0;
         pVM->pgm.s.LiveSave.uSaveStartNS = RTTimeNanoTS();
     }
+    uint64_t const cSavedPagesStart = pVM->pgm.s.LiveSave.cSavedPages;
+    pVM->pgm.s.LiveSave.cScannedPagesPass = 0;
+    pVM->pgm.s.LiveSave.cDirtiedPagesPass = 0;
 
     /*
      * Do the scanning.
@@ -1894,6 +2045,9 @@ static DECLCALLBACK(int) pgmR3LiveExec(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
         rc = pgmR3SaveRamPages(        pVM, pSSM, true /*fLiveSave*/, uPass);
     SSMR3PutU8(pSSM, PGM_STATE_REC_END);    /* (Ignore the rc, SSM takes care of it.) */
 
+    pVM->pgm.s.LiveSave.cSavedPagesPass = (uint32_t)(pVM->pgm.s.LiveSave.cSavedPages - cSavedPagesStart);
+    Log(("pgmR3LiveExec: pass=%u scanned=%u dirtied=%u saved=%u\n", uPass, pVM->pgm.s.LiveSave.cScannedPagesPass,
+         pVM->pgm.s.LiveSave.cDirtiedPagesPass, pVM->pgm.s.LiveSave.cSavedPagesPass));
     return rc;
 }
 
@@ -2040,6 +2194,9 @@ static DECLCALLBACK(int) pgmR3LivePrep(PVM pVM, PSSMHANDLE pSSM)
     pVM->pgm.s.LiveSave.cSavedPages       = 0;
     pVM->pgm.s.LiveSave.uSaveStartNS      = RTTimeNanoTS();
     pVM->pgm.s.LiveSave.cPagesPerSecond   = 8192;
+    pVM->pgm.s.LiveSave.cScannedPagesPass = 0;
+    pVM->pgm.s.LiveSave.cDirtiedPagesPass = 0;
+    pVM->pgm.s.LiveSave.cSavedPagesPass   = 0;
 
     /*
      * Per page type.
@@ -2087,6 +2244,10 @@ static DECLCALLBACK(int) pgmR3SaveExec(PVM pVM, PSSMHANDLE pSSM)
     {
         if (pVM->pgm.s.LiveSave.fActive)
         {
+            uint64_t const cSavedPagesStart = pVM->pgm.s.LiveSave.cSavedPages;
+            pVM->pgm.s.LiveSave.cScannedPagesPass = 0;
+            pVM->pgm.s.LiveSave.cDirtiedPagesPass = 0;
+
             pgmR3ScanRomPages(pVM);
             pgmR3ScanMmio2Pages(pVM, SSM_PASS_FINAL);
             pgmR3ScanRamPages(pVM, true /*fFinalPass*/);
@@ -2096,6 +2257,8 @@ static DECLCALLBACK(int) pgmR3SaveExec(PVM pVM, PSSMHANDLE pSSM)
                 rc = pgmR3SaveMmio2Pages(      pVM, pSSM, true /*fLiveSave*/, SSM_PASS_FINAL);
             if (RT_SUCCESS(rc))
                 rc = pgmR3SaveRamPages(        pVM, pSSM, true /*fLiveSave*/, SSM_PASS_FINAL);
+
+            pVM->pgm.s.LiveSave.cSavedPagesPass = (uint32_t)(pVM->pgm.s.LiveSave.cSavedPages - cSavedPagesStart);
         }
         else
         {
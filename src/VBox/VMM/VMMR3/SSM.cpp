@@ -112,7 +112,10 @@
  *       - type 5: Named data - length prefixed name followed by the data. This
  *                 type is not implemented yet as we're missing the API part, so
  *                 the type assignment is tentative.
- *       - types 6 thru 15 are current undefined.
+ *       - type 6: Raw data compressed by zlib. Same layout as type 3.  This is
+ *                 only written when configured (see /SSM/ZipCodec) as older
+ *                 versions cannot read it.
+ *       - types 7 thru 15 are current undefined.
  *   - bit 4: Important (set), can be skipped (clear).
  *   - bit 5: Undefined flag, must be zero.
  *   - bit 6: Undefined flag, must be zero.
@@ -145,6 +148,7 @@
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_SSM
 #include <VBox/vmm/ssm.h>
+#include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/pdmapi.h>
 #include <VBox/vmm/pdmcritsect.h>
@@ -161,7 +165,9 @@
 #include <iprt/crc.h>
 #include <iprt/file.h>
 #include <iprt/mem.h>
+#include <iprt/mp.h>
 #include <iprt/param.h>
+#include <iprt/req.h>
 #include <iprt/thread.h>
 #include <iprt/semaphore.h>
 #include <iprt/string.h>
@@ -227,10 +233,13 @@
 /** Named data items.
  * A length prefix zero terminated string (i.e. max 255) followed by the data.  */
 #define SSM_REC_TYPE_NAMED                      5
+/** Raw data compressed by zlib.
+ * Same layout as SSM_REC_TYPE_RAW_LZF. */
+#define SSM_REC_TYPE_RAW_ZLIB                   6
 /** Macro for validating the record type.
  * This can be used with the flags+type byte, no need to mask out the type first. */
 #define SSM_REC_TYPE_IS_VALID(u8Type)           (   ((u8Type) & SSM_REC_TYPE_MASK) >  SSM_REC_TYPE_INVALID \
-                                                 && ((u8Type) & SSM_REC_TYPE_MASK) <= SSM_REC_TYPE_NAMED )
+                                                 && ((u8Type) & SSM_REC_TYPE_MASK) <= SSM_REC_TYPE_RAW_ZLIB )
 /** @} */
 
 /** The flag mask. */
@@ -285,6 +294,14 @@
 #define SSM_ZIP_BLOCK_SIZE                      _4K
 AssertCompile(SSM_ZIP_BLOCK_SIZE / _1K * _1K == SSM_ZIP_BLOCK_SIZE);
 
+/** The number of compression blocks in a compression pipeline batch. */
+#define SSM_ZIP_BATCH_BLOCKS                    128
+/** The size of the raw record area in a compression pipeline batch. */
+#define SSM_ZIP_BATCH_RAW_SIZE                  _32K
+/** The max number of compression pipeline worker threads, both for the
+ * default and for /SSM/ZipThreads. */
+#define SSM_ZIP_MAX_THREADS                     8
+
 
 /**
  * Asserts that the handle is writable and returns with VERR_SSM_INVALID_STATE
@@ -447,6 +464,97 @@ typedef struct SSMSTRM
 typedef SSMSTRM *PSSMSTRM;
 
 
+/**
+ * Block info in a compression pipeline batch.
+ */
+typedef struct SSMZIPBLOCK
+{
+    /** Save: The end of the raw record bytes in SSMZIPBATCH::abRaw that go
+     *  before this block.
+     *  Load: The offset of the decompressed data in SSMZIPBATCH::aabData. */
+    uint32_t                off;
+    /** Save: The size of the record in SSMZIPBATCH::aabRec, set by the worker.
+     *  Load: The size of the compressed data in SSMZIPBATCH::aabRec. */
+    uint32_t                cbRec;
+    /** Load: The size of the decompressed data. */
+    uint32_t                cbData;
+    /** Load: The decompression status, set by the worker. */
+    int32_t                 rc;
+    /** Load: The record type and flags. */
+    uint8_t                 u8TypeAndFlags;
+} SSMZIPBLOCK;
+/** Pointer to block info in a compression pipeline batch. */
+typedef SSMZIPBLOCK *PSSMZIPBLOCK;
+
+/**
+ * A compression pipeline batch.
+ *
+ * When saving, the saving thread copies full blocks into the batch while the
+ * workers compress the previous batch.  Records that aren't compressed (the
+ * data buffer, zero blocks written by the workers, odd sized tails) are kept in
+ * abRaw so they can be written out in the right order.
+ *
+ * When loading, compressed records are read ahead into the batch and
+ * decompressed by the workers, the result serving as the data buffer.
+ */
+typedef struct SSMZIPBATCH
+{
+    /** Save: The blocks to compress.
+     *  Load: The decompressed data, one contiguous area.
+     * This comes first so the blocks are page aligned. */
+    uint8_t                 aabData[SSM_ZIP_BATCH_BLOCKS][SSM_ZIP_BLOCK_SIZE];
+    /** Save: The complete records produced by the workers.
+     *  Load: The compressed data of the records. */
+    uint8_t                 aabRec[SSM_ZIP_BATCH_BLOCKS][1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE];
+    /** Save: Raw record bytes, see SSMZIPBLOCK::off. */
+    uint8_t                 abRaw[SSM_ZIP_BATCH_RAW_SIZE];
+    /** Block info. */
+    SSMZIPBLOCK             aBlocks[SSM_ZIP_BATCH_BLOCKS];
+    /** The number of blocks. */
+    uint32_t                cBlocks;
+    /** Save: The number of bytes used in abRaw. */
+    uint32_t                cbRaw;
+    /** The number of worker requests in apReqs. */
+    uint32_t                cReqs;
+    /** The worker requests. */
+    PRTREQ                  apReqs[SSM_ZIP_MAX_THREADS];
+} SSMZIPBATCH;
+/** Pointer to a compression pipeline batch. */
+typedef SSMZIPBATCH *PSSMZIPBATCH;
+
+/**
+ * Compression pipeline worker function.
+ *
+ * @param   pBatch      The batch.
+ * @param   iFirst      The first block to process.
+ * @param   cBlocks     The number of blocks to process.
+ * @param   uZipType    The RTZIPTYPE to compress with (save).
+ */
+typedef DECLCALLBACK(void) FNSSMZIPWORKER(PSSMZIPBATCH pBatch, uint32_t iFirst, uint32_t cBlocks, uint32_t uZipType);
+/** Pointer to a compression pipeline worker function. */
+typedef FNSSMZIPWORKER *PFNSSMZIPWORKER;
+
+/**
+ * Compression pipeline spreading the (de)compression of data blocks over a
+ * number of worker threads.
+ */
+typedef struct SSMZIP
+{
+    /** The worker thread pool. */
+    RTREQPOOL               hPool;
+    /** The number of worker threads, i.e. requests per batch. */
+    uint32_t                cThreads;
+    /** The batch being filled (save) or read ahead into (load). */
+    PSSMZIPBATCH            pCur;
+    /** Save: The batch being compressed, NULL if none. */
+    PSSMZIPBATCH            pBusy;
+    /** The batches. The 2nd is only used when saving. */
+    PSSMZIPBATCH            apBatches[2];
+} SSMZIP;
+/** Pointer to a compression pipeline. */
+typedef SSMZIP *PSSMZIP;
+
+
 /**
  * Handle structure.
  */
@@ -473,6 +581,11 @@ typedef struct SSMHANDLE
     uint64_t                offUnitUser;
     /** Indicates that this is a live save or restore operation. */
     bool                    fLiveSave;
+    /** The codec for compressing data blocks (save). */
+    RTZIPTYPE               enmZipType;
+    /** The compression pipeline, NULL if (de)compressing on the calling
+     * thread. */
+    PSSMZIP                 pZip;
 
     /** Pointer to the progress callback function. */
     PFNVMPROGRESS           pfnProgress;
@@ -528,6 +641,9 @@ typedef struct SSMHANDLE
 
             /** V2: Unread bytes in the current record. */
             uint32_t        cbRecLeft;
+            /** V2: The data buffer, either abDataBuffer or read ahead data in the
+             * compression pipeline. */
+            uint8_t        *pbDataBuffer;
             /** V2: Bytes in the data buffer. */
             uint32_t        cbDataBuffer;
             /** V2: Current buffer position. */
@@ -2803,6 +2919,25 @@ static uint8_t const *ssmR3StrmReadDirect(PSSMSTRM pStrm, size_t cbToRead)
 }
 
 
+/**
+ * Peeks at the next byte in the stream without consuming it.
+ *
+ * Like ssmR3StrmReadDirect, this only looks in the current buffer.
+ *
+ * @returns The byte value, -1 if the current buffer is exhausted.
+ * @param   pStrm       The stream handle.
+ */
+DECLINLINE(int) ssmR3StrmPeekU8(PSSMSTRM pStrm)
+{
+    Assert(!pStrm->fWrite);
+    PSSMSTRMBUF pBuf = pStrm->pCur;
+    if (   pBuf
+        && pStrm->off < pBuf->cb)
+        return pBuf->abData[pStrm->off];
+    return -1;
+}
+
+
 #ifndef SSM_STANDALONE
 /**
  * Check that the stream is OK and flush data that is getting old
@@ -3270,6 +3405,388 @@ DECLINLINE(bool) ssmR3IsHostMsc32(PSSMHANDLE pSSM)
     return SSM_HOST_IS_MSC_32;
 }
 
+
+/**
+ * Translates a compressed record type to a compression type.
+ *
+ * @returns RTZIPTYPE_LZF or RTZIPTYPE_ZLIB.
+ * @param   u8TypeAndFlags  The record type and flags.
+ */
+DECLINLINE(RTZIPTYPE) ssmR3DataRecTypeToZipType(uint8_t u8TypeAndFlags)
+{
+    return (u8TypeAndFlags & SSM_REC_TYPE_MASK) == SSM_REC_TYPE_RAW_ZLIB ? RTZIPTYPE_ZLIB : RTZIPTYPE_LZF;
+}
+
+
+/**
+ * Waits for the workers to finish processing a batch.
+ *
+ * @param   pBatch          The batch.
+ */
+static void ssmR3ZipWait(PSSMZIPBATCH pBatch)
+{
+    for (uint32_t i = 0; i < pBatch->cReqs; i++)
+    {
+        int rc = RTReqWait(pBatch->apReqs[i], RT_INDEFINITE_WAIT);
+        AssertRC(rc);
+        RTReqRelease(pBatch->apReqs[i]);
+        pBatch->apReqs[i] = NIL_RTREQ;
+    }
+    pBatch->cReqs = 0;
+}
+
+
+/**
+ * Splits the blocks of a batch up between the workers.
+ *
+ * Use ssmR3ZipWait to wait for the workers to complete.
+ *
+ * @param   pZip            The compression pipeline.
+ * @param   pBatch          The batch.
+ * @param   pfnWorker       The worker function.
+ * @param   enmZipType      The compression type to pass along to the worker.
+ */
+static void ssmR3ZipSubmit(PSSMZIP pZip, PSSMZIPBATCH pBatch, PFNSSMZIPWORKER pfnWorker, RTZIPTYPE enmZipType)
+{
+    Assert(!pBatch->cReqs);
+    uint32_t const cBlocks = pBatch->cBlocks;
+    uint32_t const cReqs   = RT_MIN(pZip->cThreads, cBlocks);
+    uint32_t       iFirst  = 0;
+    for (uint32_t iReq = 0; iReq < cReqs; iReq++)
+    {
+        uint32_t const cChunk = (cBlocks - iFirst) / (cReqs - iReq);
+        PRTREQ         pReq   = NIL_RTREQ;
+        int rc = RTReqPoolCallEx(pZip->hPool, 0 /*cMillies*/, &pReq, RTREQFLAGS_VOID, (PFNRT)pfnWorker, 4,
+                                 pBatch, (uintptr_t)iFirst, (uintptr_t)cChunk, (uintptr_t)enmZipType);
+        if (rc == VINF_SUCCESS || rc == VERR_TIMEOUT)
+            pBatch->apReqs[pBatch->cReqs++] = pReq;
+        else
+        {
+            /* Do it ourselves if the pool is having trouble. */
+            AssertLogRelMsgFailed(("SSM: RTReqPoolCallEx failed: %Rrc\n", rc));
+            if (pReq != NIL_RTREQ)
+                RTReqRelease(pReq);
+            pfnWorker(pBatch, iFirst, cChunk, enmZipType);
+        }
+        iFirst += cChunk;
+    }
+    Assert(iFirst == cBlocks);
+}
+
+
+/**
+ * Destroys the compression pipeline of a saved state handle, if any.
+ *
+ * Anything still in the pipeline is discarded.
+ *
+ * @param   pSSM            The saved state handle.
+ */
+static void ssmR3ZipDestroy(PSSMHANDLE pSSM)
+{
+    PSSMZIP pZip = pSSM->pZip;
+    if (pZip)
+    {
+        pSSM->pZip = NULL;
+        for (unsigned i = 0; i < RT_ELEMENTS(pZip->apBatches); i++)
+            if (pZip->apBatches[i])
+            {
+                ssmR3ZipWait(pZip->apBatches[i]);
+                RTMemPageFree(pZip->apBatches[i], sizeof(SSMZIPBATCH));
+            }
+        RTReqPoolRelease(pZip->hPool);
+        RTMemFree(pZip);
+    }
+}
+
+#ifndef SSM_STANDALONE
+
+/**
+ * Configures the compression codec and creates the compression pipeline for a
+ * save or load operation.
+ *
+ * Not having a pipeline is fine, the data is then (de)compressed on the calling
+ * thread, so failures are only logged.
+ *
+ * @param   pVM             The cross context VM structure.
+ * @param   pSSM            The saved state handle.
+ * @param   fSave           Set if saving, clear if loading.
+ */
+static void ssmR3ZipCreate(PVM pVM, PSSMHANDLE pSSM, bool fSave)
+{
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetRoot(pVM), "SSM");
+
+    /** @cfgm{/SSM/ZipCodec, string, lzf}
+     * The codec to compress the saved state data blocks with, "lzf" or "zlib".
+     * zlib produces smaller saved states at a higher CPU cost, but the result
+     * cannot be loaded by older versions.  Loading handles both. */
+    pSSM->enmZipType = RTZIPTYPE_LZF;
+    if (fSave)
+    {
+        char szCodec[16];
+        int rc = CFGMR3QueryStringDef(pCfg, "ZipCodec", szCodec, sizeof(szCodec), "lzf");
+        if (RT_SUCCESS(rc) && !RTStrICmp(szCodec, "zlib"))
+            pSSM->enmZipType = RTZIPTYPE_ZLIB;
+        else
+            AssertLogRelMsg(RT_SUCCESS(rc) && !RTStrICmp(szCodec, "lzf"), ("SSM: Bad ZipCodec value, using lzf (rc=%Rrc)\n", rc));
+    }
+
+    /** @cfgm{/SSM/ZipThreads, uint32_t, host CPUs less one (max 8)}
+     * The number of worker threads (de)compressing saved state data blocks.
+     * Zero does everything on the saving/loading thread. */
+    uint32_t const cCpus = RTMpGetOnlineCount();
+    uint32_t       cThreads;
+    int rc = CFGMR3QueryU32Def(pCfg, "ZipThreads", &cThreads, RT_MIN(cCpus > 1 ? cCpus - 1 : 0, SSM_ZIP_MAX_THREADS));
+    AssertLogRelMsgStmt(RT_SUCCESS(rc), ("%Rrc\n", rc), cThreads = 0);
+    cThreads = RT_MIN(cThreads, SSM_ZIP_MAX_THREADS);
+    if (!cThreads)
+        return;
+
+    PSSMZIP pZip = (PSSMZIP)RTMemAllocZ(sizeof(*pZip));
+    if (pZip)
+    {
+        pZip->cThreads = cThreads;
+        pZip->hPool    = NIL_RTREQPOOL;
+        unsigned const cBatches = fSave ? 2 : 1;
+        rc = VINF_SUCCESS;
+        for (unsigned i = 0; i < cBatches && RT_SUCCESS(rc); i++)
+        {
+            pZip->apBatches[i] = (PSSMZIPBATCH)RTMemPageAllocZ(sizeof(SSMZIPBATCH));
+            if (!pZip->apBatches[i])
+                rc = VERR_NO_MEMORY;
+        }
+        if (RT_SUCCESS(rc))
+            rc = RTReqPoolCreate(cThreads, RT_MS_1SEC, cThreads, 0 /*cMsMaxPushBack*/, "SSMZip", &pZip->hPool);
+        if (RT_SUCCESS(rc))
+        {
+            pZip->pCur = pZip->apBatches[0];
+            pSSM->pZip = pZip;
+            LogRel(("SSM: Using %u threads for %s (%s)\n", cThreads, fSave ? "compression" : "decompression",
+                    pSSM->enmZipType == RTZIPTYPE_ZLIB ? "zlib" : "lzf"));
+            return;
+        }
+        pSSM->pZip = pZip;
+        ssmR3ZipDestroy(pSSM);
+    }
+    else
+        rc = VERR_NO_MEMORY;
+    LogRel(("SSM: Failed to create the compression pipeline: %Rrc\n", rc));
+}
+
+
+/**
+ * Compresses a block into a complete data record.
+ *
+ * Falls back on a raw record if the data doesn't compress.
+ *
+ * @returns The size of the record.
+ * @param   enmZipType      The compression type, RTZIPTYPE_LZF or
+ *                          RTZIPTYPE_ZLIB.
+ * @param   pvSrc           The SSM_ZIP_BLOCK_SIZE bytes to compress.
+ * @param   pb              Where to put the record.  Must have room for
+ *                          1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE bytes.
+ */
+static uint32_t ssmR3DataCompressBlock(RTZIPTYPE enmZipType, void const *pvSrc, uint8_t *pb)
+{
+    AssertCompile(1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE < 0x00010000);
+    size_t cbRec = SSM_ZIP_BLOCK_SIZE - (SSM_ZIP_BLOCK_SIZE / 16);
+    int rc = RTZipBlockCompress(enmZipType, enmZipType == RTZIPTYPE_LZF ? RTZIPLEVEL_FAST : RTZIPLEVEL_DEFAULT, 0 /*fFlags*/,
+                                pvSrc, SSM_ZIP_BLOCK_SIZE,
+                                pb + 1 + 3 + 1, cbRec, &cbRec);
+    if (RT_SUCCESS(rc))
+    {
+        pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT
+              | (enmZipType == RTZIPTYPE_ZLIB ? SSM_REC_TYPE_RAW_ZLIB : SSM_REC_TYPE_RAW_LZF);
+        pb[4] = SSM_ZIP_BLOCK_SIZE / _1K;
+        cbRec += 1;
+    }
+    else
+    {
+        pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW;
+        memcpy(&pb[4], pvSrc, SSM_ZIP_BLOCK_SIZE);
+        cbRec = SSM_ZIP_BLOCK_SIZE;
+    }
+    pb[1] = (uint8_t)(0xe0 | ( cbRec >> 12));
+    pb[2] = (uint8_t)(0x80 | ((cbRec >>  6) & 0x3f));
+    pb[3] = (uint8_t)(0x80 | ( cbRec        & 0x3f));
+    return (uint32_t)cbRec + 1 + 3;
+}
+
+
+/**
+ * @callback_method_impl{FNSSMZIPWORKER, Compresses blocks into records.}
+ */
+static DECLCALLBACK(void) ssmR3ZipCompressWorker(PSSMZIPBATCH pBatch, uint32_t iFirst, uint32_t cBlocks, uint32_t uZipType)
+{
+    for (uint32_t i = iFirst; i < iFirst + cBlocks; i++)
+    {
+        uint8_t *pbRec = pBatch->aabRec[i];
+        if (!ASMMemIsZeroPage(pBatch->aabData[i]))
+            pBatch->aBlocks[i].cbRec = ssmR3DataCompressBlock((RTZIPTYPE)uZipType, pBatch->aabData[i], pbRec);
+        else
+        {
+            pbRec[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_ZERO;
+            pbRec[1] = 1;
+            pbRec[2] = SSM_ZIP_BLOCK_SIZE / _1K;
+            pBatch->aBlocks[i].cbRec = 3;
+        }
+    }
+}
+
+
+/**
+ * Writes bytes to the stream, working the unit offset.
+ *
+ * @returns VBox status code.
+ * @param   pSSM            The saved state handle.
+ * @param   pvBuf           The bits to write.
+ * @param   cbBuf           The number of bytes to write.
+ */
+static int ssmR3DataWriteStream(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
+{
+    /*
+     * Write the data item in 1MB chunks for progress indicator reasons.
+     */
+    while (cbBuf > 0)
+    {
+        size_t cbChunk = RT_MIN(cbBuf, _1M);
+        int rc = ssmR3StrmWrite(&pSSM->Strm, pvBuf, cbChunk);
+        if (RT_FAILURE(rc))
+            return rc;
+        pSSM->offUnit += cbChunk;
+        cbBuf -= cbChunk;
+        pvBuf = (char *)pvBuf + cbChunk;
+    }
+
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Waits for the workers to compress a batch and writes out its records.
+ *
+ * The batch is empty afterwards, also on failure.
+ *
+ * @returns VBox status code.
+ * @param   pSSM            The saved state handle.
+ * @param   pBatch          The batch.
+ */
+static int ssmR3ZipWriteBatch(PSSMHANDLE pSSM, PSSMZIPBATCH pBatch)
+{
+    ssmR3ZipWait(pBatch);
+
+    int      rc     = VINF_SUCCESS;
+    uint32_t offRaw = 0;
+    for (uint32_t i = 0; i < pBatch->cBlocks && RT_SUCCESS(rc); i++)
+    {
+        PSSMZIPBLOCK pBlock = &pBatch->aBlocks[i];
+        if (pBlock->off > offRaw)
+            rc = ssmR3DataWriteStream(pSSM, &pBatch->abRaw[offRaw], pBlock->off - offRaw);
+        offRaw = pBlock->off;
+        if (RT_SUCCESS(rc))
+            rc = ssmR3DataWriteStream(pSSM, pBatch->aabRec[i], pBlock->cbRec);
+    }
+    if (RT_SUCCESS(rc) && pBatch->cbRaw > offRaw)
+        rc = ssmR3DataWriteStream(pSSM, &pBatch->abRaw[offRaw], pBatch->cbRaw - offRaw);
+
+    pBatch->cBlocks = 0;
+    pBatch->cbRaw   = 0;
+    return rc;
+}
+
+
+/**
+ * Checks if there is anything in the compression pipeline.
+ *
+ * @returns true if raw record bytes must be queued to keep the record order.
+ * @param   pZip            The compression pipeline, NULL is fine.
+ */
+DECLINLINE(bool) ssmR3ZipIsBusy(PSSMZIP pZip)
+{
+    return pZip
+        && (   pZip->pBusy
+            || pZip->pCur->cBlocks
+            || pZip->pCur->cbRaw);
+}
+
+
+/**
+ * Writes out everything in the compression pipeline.
+ *
+ * @returns VBox status code.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3ZipDrain(PSSMHANDLE pSSM)
+{
+    PSSMZIP pZip = pSSM->pZip;
+    int     rc   = VINF_SUCCESS;
+    if (pZip->pBusy)
+    {
+        rc = ssmR3ZipWriteBatch(pSSM, pZip->pBusy);
+        pZip->pBusy = NULL;
+    }
+
+    PSSMZIPBATCH pBatch = pZip->pCur;
+    if (RT_SUCCESS(rc))
+    {
+        ssmR3ZipSubmit(pZip, pBatch, ssmR3ZipCompressWorker, pSSM->enmZipType);
+        rc = ssmR3ZipWriteBatch(pSSM, pBatch);
+    }
+    else
+    {
+        pBatch->cBlocks = 0;
+        pBatch->cbRaw   = 0;
+    }
+    if (RT_FAILURE(rc) && RT_SUCCESS(pSSM->rc))
+        pSSM->rc = rc;
+    return rc;
+}
+
+
+/**
+ * Queues a block for compression.
+ *
+ * When the current batch is full, the previous one is written out and the
+ * current one handed to the workers.
+ *
+ * @returns VBox status code.
+ * @param   pSSM            The saved state handle.
+ * @param   pvBlock         The SSM_ZIP_BLOCK_SIZE bytes to compress.
+ */
+static int ssmR3ZipQueueBlock(PSSMHANDLE pSSM, void const *pvBlock)
+{
+    PSSMZIP        pZip   = pSSM->pZip;
+    PSSMZIPBATCH   pBatch = pZip->pCur;
+    uint32_t const i      = pBatch->cBlocks;
+    memcpy(pBatch->aabData[i], pvBlock, SSM_ZIP_BLOCK_SIZE);
+    pBatch->aBlocks[i].off = pBatch->cbRaw;
+    pBatch->cBlocks = i + 1;
+    if (i + 1 < SSM_ZIP_BATCH_BLOCKS)
+        return VINF_SUCCESS;
+
+    int rc = VINF_SUCCESS;
+    if (pZip->pBusy)
+    {
+        rc = ssmR3ZipWriteBatch(pSSM, pZip->pBusy);
+        pZip->pBusy = NULL;
+    }
+    if (RT_SUCCESS(rc))
+    {
+        ssmR3ZipSubmit(pZip, pBatch, ssmR3ZipCompressWorker, pSSM->enmZipType);
+        pZip->pBusy = pBatch;
+        pZip->pCur  = pZip->apBatches[pBatch == pZip->apBatches[0]];
+    }
+    else
+    {
+        pBatch->cBlocks = 0;
+        pBatch->cbRaw   = 0;
+        if (RT_SUCCESS(pSSM->rc))
+            pSSM->rc = rc;
+    }
+    return rc;
+}
+
+#endif /* !SSM_STANDALONE */
+
 #ifndef SSM_STANDALONE
 
 /**
@@ -3331,20 +3848,24 @@ static int ssmR3DataWriteRaw(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
         return pSSM->rc;
 
     /*
-     * Write the data item in 1MB chunks for progress indicator reasons.
+     * Queue it up behind the blocks in the compression pipeline to keep the
+     * record order, unless it's too big for that.
      */
-    while (cbBuf > 0)
+    if (ssmR3ZipIsBusy(pSSM->pZip))
     {
-        size_t cbChunk = RT_MIN(cbBuf, _1M);
-        int rc = ssmR3StrmWrite(&pSSM->Strm, pvBuf, cbChunk);
+        PSSMZIPBATCH pBatch = pSSM->pZip->pCur;
+        if (cbBuf <= sizeof(pBatch->abRaw) - pBatch->cbRaw)
+        {
+            memcpy(&pBatch->abRaw[pBatch->cbRaw], pvBuf, cbBuf);
+            pBatch->cbRaw += (uint32_t)cbBuf;
+            return VINF_SUCCESS;
+        }
+        int rc = ssmR3ZipDrain(pSSM);
         if (RT_FAILURE(rc))
             return rc;
-        pSSM->offUnit += cbChunk;
-        cbBuf -= cbChunk;
-        pvBuf = (char *)pvBuf + cbChunk;
     }
 
-    return VINF_SUCCESS;
+    return ssmR3DataWriteStream(pSSM, pvBuf, cbBuf);
 }
 
 
@@ -3417,12 +3938,14 @@ static int ssmR3DataWriteRecHdr(PSSMHANDLE pSSM, size_t cb, uint8_t u8TypeAndFla
 
 
 /**
- * Worker that flushes the buffered data.
+ * Worker that turns the buffered data into a record.
+ *
+ * Unlike ssmR3DataFlushBuffer, this leaves the compression pipeline alone.
  *
  * @returns VBox status code. Will set pSSM->rc on error.
  * @param   pSSM            The saved state handle.
  */
-static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
+static int ssmR3DataWriteBufferRec(PSSMHANDLE pSSM)
 {
     /*
      * Check how much there current is in the buffer.
@@ -3445,6 +3968,22 @@ static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
 }
 
 
+/**
+ * Worker that flushes the buffered data and the compression pipeline.
+ *
+ * @returns VBox status code. Will set pSSM->rc on error.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
+{
+    int rc = ssmR3DataWriteBufferRec(pSSM);
+    if (   RT_SUCCESS(rc)
+        && ssmR3ZipIsBusy(pSSM->pZip))
+        rc = ssmR3ZipDrain(pSSM);
+    return rc;
+}
+
+
 /**
  * ssmR3DataWrite worker that writes big stuff.
  *
@@ -3455,7 +3994,7 @@ static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
  */
 static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
 {
-    int rc = ssmR3DataFlushBuffer(pSSM);
+    int rc = ssmR3DataWriteBufferRec(pSSM);
     if (RT_SUCCESS(rc))
     {
         pSSM->offUnitUser += cbBuf;
@@ -3467,38 +4006,36 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
         {
             AssertCompile(SSM_ZIP_BLOCK_SIZE == PAGE_SIZE);
             if (    cbBuf >= SSM_ZIP_BLOCK_SIZE
-                && (    ((uintptr_t)pvBuf & 0xf)
-                    ||  !ASMMemIsZeroPage(pvBuf))
-               )
+                &&  pSSM->pZip)
+            {
+                /*
+                 * Leave it to the compression pipeline, zero block detection
+                 * included.
+                 */
+                rc = ssmR3ZipQueueBlock(pSSM, pvBuf);
+                if (RT_FAILURE(rc))
+                    break;
+
+                /* advance */
+                ssmR3ProgressByByte(pSSM, SSM_ZIP_BLOCK_SIZE);
+                if (cbBuf == SSM_ZIP_BLOCK_SIZE)
+                    return VINF_SUCCESS;
+                cbBuf -= SSM_ZIP_BLOCK_SIZE;
+                pvBuf = (uint8_t const*)pvBuf + SSM_ZIP_BLOCK_SIZE;
+            }
+            else if (    cbBuf >= SSM_ZIP_BLOCK_SIZE
+                     && (    ((uintptr_t)pvBuf & 0xf)
+                         ||  !ASMMemIsZeroPage(pvBuf))
+                    )
             {
                 /*
                  * Compress it.
                  */
-                AssertCompile(1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE < 0x00010000);
                 uint8_t *pb;
                 rc = ssmR3StrmReserveWriteBufferSpace(&pSSM->Strm, 1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE, &pb);
                 if (RT_FAILURE(rc))
                     break;
-                size_t cbRec = SSM_ZIP_BLOCK_SIZE - (SSM_ZIP_BLOCK_SIZE / 16);
-                rc = RTZipBlockCompress(RTZIPTYPE_LZF, RTZIPLEVEL_FAST, 0 /*fFlags*/,
-                                        pvBuf, SSM_ZIP_BLOCK_SIZE,
-                                        pb + 1 + 3 + 1, cbRec, &cbRec);
-                if (RT_SUCCESS(rc))
-                {
-                    pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_LZF;
-                    pb[4] = SSM_ZIP_BLOCK_SIZE / _1K;
-                    cbRec += 1;
-                }
-                else
-                {
-                    pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW;
-                    memcpy(&pb[4], pvBuf, SSM_ZIP_BLOCK_SIZE);
-                    cbRec = SSM_ZIP_BLOCK_SIZE;
-                }
-                pb[1] = (uint8_t)(0xe0 | ( cbRec >> 12));
-                pb[2] = (uint8_t)(0x80 | ((cbRec >>  6) & 0x3f));
-                pb[3] = (uint8_t)(0x80 | ( cbRec        & 0x3f));
-                cbRec += 1 + 3;
+                uint32_t const cbRec = ssmR3DataCompressBlock(pSSM->enmZipType, pvBuf, pb);
                 rc = ssmR3StrmCommitWriteBufferSpace(&pSSM->Strm, cbRec);
                 if (RT_FAILURE(rc))
                     break;
@@ -3563,7 +4100,7 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
  */
 static int ssmR3DataWriteFlushAndBuffer(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
 {
-    int rc = ssmR3DataFlushBuffer(pSSM);
+    int rc = ssmR3DataWriteBufferRec(pSSM);
     if (RT_SUCCESS(rc))
     {
         memcpy(&pSSM->u.Write.abDataBuffer[0], pvBuf, cbBuf);
@@ -4583,6 +5120,7 @@ static int ssmR3SaveDoClose(PVM pVM, PSSMHANDLE pSSM)
      * Make it non-cancellable, close the stream and delete the file on failure.
      */
     ssmR3SetCancellable(pVM, pSSM, false);
+    ssmR3ZipDestroy(pSSM);
     int rc = ssmR3StrmClose(&pSSM->Strm, pSSM->rc == VERR_SSM_CANCELLED);
     if (RT_SUCCESS(rc))
         rc = pSSM->rc;
@@ -5169,6 +5707,8 @@ static int ssmR3SaveDoCreateFile(PVM pVM, const char *pszFilename, PCSSMSTRMOPS
     pSSM->offUnit                   = UINT64_MAX;
     pSSM->offUnitUser               = UINT64_MAX;
     pSSM->fLiveSave                 = false;
+    pSSM->enmZipType                = RTZIPTYPE_LZF;
+    pSSM->pZip                      = NULL;
     pSSM->pfnProgress               = pfnProgress;
     pSSM->pvUser                    = pvProgressUser;
     pSSM->uPercent                  = 0;
@@ -5196,6 +5736,7 @@ static int ssmR3SaveDoCreateFile(PVM pVM, const char *pszFilename, PCSSMSTRMOPS
         return rc;
     }
 
+    ssmR3ZipCreate(pVM, pSSM, true /*fSave*/);
     *ppSSM = pSSM;
     return VINF_SUCCESS;
 }
@@ -5801,6 +6342,7 @@ VMMR3_INT_DECL(int) SSMR3LiveSave(PVM pVM, uint32_t cMsMaxDowntime,
         return VINF_SUCCESS;
     }
     /* bail out. */
+    ssmR3ZipDestroy(pSSM);
     int rc2 = ssmR3StrmClose(&pSSM->Strm, pSSM->rc == VERR_SSM_CANCELLED);
     RTMemFree(pSSM);
     rc2 = RTFileDelete(pszFilename);
@@ -5939,6 +6481,7 @@ static void ssmR3DataReadBeginV2(PSSMHANDLE pSSM)
     pSSM->offUnit     = 0;
     pSSM->offUnitUser = 0;
     pSSM->u.Read.cbRecLeft      = 0;
+    pSSM->u.Read.pbDataBuffer   = &pSSM->u.Read.abDataBuffer[0];
     pSSM->u.Read.cbDataBuffer   = 0;
     pSSM->u.Read.offDataBuffer  = 0;
     pSSM->u.Read.fEndOfData     = false;
@@ -6016,7 +6559,7 @@ DECLINLINE(int) ssmR3DataReadV2Raw(PSSMHANDLE pSSM, void *pvBuf, size_t cbToRead
 
 
 /**
- * Reads and checks the LZF "header".
+ * Reads and checks the LZF / zlib "header".
  *
  * @returns VBox status code. Sets pSSM->rc on error.
  * @param   pSSM            The saved state handle..
@@ -6048,8 +6591,8 @@ DECLINLINE(int) ssmR3DataReadV2RawLzfHdr(PSSMHANDLE pSSM, uint32_t *pcbDecompr)
 
 
 /**
- * Reads an LZF block from the stream and decompresses into the specified
- * buffer.
+ * Reads an LZF or zlib block from the stream and decompresses into the
+ * specified buffer.
  *
  * @returns VBox status code. Sets pSSM->rc on error.
  * @param   pSSM            The saved state handle.
@@ -6083,7 +6626,7 @@ static int ssmR3DataReadV2RawLzf(PSSMHANDLE pSSM, void *pvDst, size_t cbDecompr)
      * Decompress it.
      */
     size_t cbDstActual;
-    rc = RTZipBlockDecompress(RTZIPTYPE_LZF, 0 /*fFlags*/,
+    rc = RTZipBlockDecompress(ssmR3DataRecTypeToZipType(pSSM->u.Read.u8TypeAndFlags), 0 /*fFlags*/,
                               pb, cbCompr, NULL /*pcbSrcActual*/,
                               pvDst, cbDecompr, &cbDstActual);
     if (RT_SUCCESS(rc))
@@ -6293,6 +6836,138 @@ static int ssmR3DataReadRecHdrV2(PSSMHANDLE pSSM)
 }
 
 
+/**
+ * Compression pipeline worker decompressing read ahead records.
+ *
+ * @param   pBatch      The batch.
+ * @param   iFirst      The first block to process.
+ * @param   cBlocks     The number of blocks to process.
+ * @param   uZipType    Unused, the record types tells the codec.
+ */
+static DECLCALLBACK(void) ssmR3ZipDecompressWorker(PSSMZIPBATCH pBatch, uint32_t iFirst, uint32_t cBlocks, uint32_t uZipType)
+{
+    NOREF(uZipType);
+    for (uint32_t i = iFirst; i < iFirst + cBlocks; i++)
+    {
+        PSSMZIPBLOCK pBlock = &pBatch->aBlocks[i];
+        if (!pBlock->cbRec)
+            continue; /* zero record, done by the reader */
+
+        size_t cbDstActual = 0;
+        int rc = RTZipBlockDecompress(ssmR3DataRecTypeToZipType(pBlock->u8TypeAndFlags), 0 /*fFlags*/,
+                                      &pBatch->aabRec[i][0], pBlock->cbRec, NULL /*pcbSrcActual*/,
+                                      &pBatch->aabData[0][0] + pBlock->off, pBlock->cbData, &cbDstActual);
+        if (RT_SUCCESS(rc) && cbDstActual != pBlock->cbData)
+            rc = VERR_SSM_INTEGRITY_DECOMPRESSION;
+        pBlock->rc = rc;
+    }
+}
+
+
+/**
+ * Reads ahead a series of compressed and zero records and decompresses them in
+ * parallel using the compression pipeline.
+ *
+ * This is only done when the compressed records are already in the stream
+ * buffer, i.e. it never blocks on I/O for more than the record being read, and
+ * stops at the first record of any other type.  On success with data, the
+ * decompressed bytes are put in the data buffer (pbDataBuffer / cbDataBuffer)
+ * with offDataBuffer at zero.  Nothing is done if cbDataBuffer is zero upon
+ * return.
+ *
+ * @returns VBox status code. Does not set pSSM->rc.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3DataReadAheadV2(PSSMHANDLE pSSM)
+{
+    PSSMZIP pZip = pSSM->pZip;
+    if (   !pZip
+        || pSSM->u.Read.cbRecLeft
+        || pSSM->u.Read.fEndOfData
+        || pSSM->u.Read.cbDataBuffer != pSSM->u.Read.offDataBuffer)
+        return VINF_SUCCESS;
+
+    /* Only bother if the next record is a compressed one. */
+    int iType = ssmR3StrmPeekU8(&pSSM->Strm);
+    if (   iType < 0
+        || (   (iType & SSM_REC_TYPE_MASK) != SSM_REC_TYPE_RAW_LZF
+            && (iType & SSM_REC_TYPE_MASK) != SSM_REC_TYPE_RAW_ZLIB))
+        return VINF_SUCCESS;
+
+    /*
+     * Read the records into the batch.
+     */
+    PSSMZIPBATCH pBatch = pZip->pCur;
+    uint32_t     cbOut  = 0;
+    uint32_t     cBlocks = 0;
+    while (cBlocks < RT_ELEMENTS(pBatch->aBlocks))
+    {
+        if (cBlocks > 0)
+        {
+            iType = ssmR3StrmPeekU8(&pSSM->Strm);
+            if (   iType < 0
+                || (   (iType & SSM_REC_TYPE_MASK) != SSM_REC_TYPE_RAW_LZF
+                    && (iType & SSM_REC_TYPE_MASK) != SSM_REC_TYPE_RAW_ZLIB
+                    && (iType & SSM_REC_TYPE_MASK) != SSM_REC_TYPE_RAW_ZERO))
+                break;
+        }
+
+        int rc = ssmR3DataReadRecHdrV2(pSSM);
+        if (RT_FAILURE(rc))
+            return rc;
+
+        PSSMZIPBLOCK pBlock = &pBatch->aBlocks[cBlocks];
+        pBlock->off            = cbOut;
+        pBlock->rc             = VINF_SUCCESS;
+        pBlock->u8TypeAndFlags = pSSM->u.Read.u8TypeAndFlags;
+        if ((pBlock->u8TypeAndFlags & SSM_REC_TYPE_MASK) == SSM_REC_TYPE_RAW_ZERO)
+        {
+            rc = ssmR3DataReadV2RawZeroHdr(pSSM, &pBlock->cbData);
+            if (RT_FAILURE(rc))
+                return rc;
+            pBlock->cbRec = 0;
+            memset(&pBatch->aabData[0][0] + cbOut, 0, pBlock->cbData);
+        }
+        else
+        {
+            rc = ssmR3DataReadV2RawLzfHdr(pSSM, &pBlock->cbData);
+            if (RT_FAILURE(rc))
+                return rc;
+            pBlock->cbRec = pSSM->u.Read.cbRecLeft;
+            AssertLogRelMsgReturn(pBlock->cbRec <= sizeof(pBatch->aabRec[0]), ("%#x\n", pBlock->cbRec),
+                                  VERR_SSM_INTEGRITY_DECOMPRESSION);
+            rc = ssmR3DataReadV2Raw(pSSM, &pBatch->aabRec[cBlocks][0], pBlock->cbRec);
+            if (RT_FAILURE(rc))
+                return rc;
+            pSSM->u.Read.cbRecLeft = 0;
+        }
+        cbOut += pBlock->cbData;
+        cBlocks++;
+
+        /* Stop when another max sized record wouldn't fit. */
+        if (cbOut > sizeof(pBatch->aabData) - SSM_ZIP_BLOCK_SIZE)
+            break;
+    }
+
+    /*
+     * Decompress them and check the results.
+     */
+    pBatch->cBlocks = cBlocks;
+    ssmR3ZipSubmit(pZip, pBatch, ssmR3ZipDecompressWorker, RTZIPTYPE_INVALID);
+    ssmR3ZipWait(pBatch);
+    pBatch->cBlocks = 0;
+    for (uint32_t i = 0; i < cBlocks; i++)
+        AssertLogRelMsgReturn(RT_SUCCESS(pBatch->aBlocks[i].rc),
+                              ("cbRec=%#x cbData=%#x rc=%Rrc\n", pBatch->aBlocks[i].cbRec, pBatch->aBlocks[i].cbData, pBatch->aBlocks[i].rc),
+                              VERR_SSM_INTEGRITY_DECOMPRESSION);
+
+    pSSM->u.Read.pbDataBuffer  = &pBatch->aabData[0][0];
+    pSSM->u.Read.cbDataBuffer  = cbOut;
+    pSSM->u.Read.offDataBuffer = 0;
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Buffer miss, do an unbuffered read.
  *
@@ -6316,12 +6991,13 @@ static int ssmR3DataReadUnbufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
     {
         uint32_t const cbToCopy = (uint32_t)cbInBuffer;
         Assert(cbBuf > cbToCopy);
-        memcpy(pvBuf, &pSSM->u.Read.abDataBuffer[off], cbToCopy);
+        memcpy(pvBuf, &pSSM->u.Read.pbDataBuffer[off], cbToCopy);
         pvBuf  = (uint8_t *)pvBuf + cbToCopy;
         cbBuf -= cbToCopy;
-        pSSM->u.Read.cbDataBuffer  = 0;
-        pSSM->u.Read.offDataBuffer = 0;
     }
+    pSSM->u.Read.pbDataBuffer  = &pSSM->u.Read.abDataBuffer[0];
+    pSSM->u.Read.cbDataBuffer  = 0;
+    pSSM->u.Read.offDataBuffer = 0;
 
     /*
      * Read data.
@@ -6329,11 +7005,29 @@ static int ssmR3DataReadUnbufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
     do
     {
         /*
-         * Read the next record header if no more data.
+         * Read the next record header if no more data, trying to read ahead
+         * and decompress a bunch of records in parallel first.
          */
         if (!pSSM->u.Read.cbRecLeft)
         {
-            int rc = ssmR3DataReadRecHdrV2(pSSM);
+            int rc = ssmR3DataReadAheadV2(pSSM);
+            if (RT_FAILURE(rc))
+                return pSSM->rc = rc;
+            if (pSSM->u.Read.cbDataBuffer)
+            {
+                uint32_t const cbToCopy = (uint32_t)RT_MIN(cbBuf, pSSM->u.Read.cbDataBuffer);
+                memcpy(pvBuf, pSSM->u.Read.pbDataBuffer, cbToCopy);
+                pSSM->u.Read.offDataBuffer = cbToCopy;
+                pSSM->offUnitUser += cbToCopy;
+                cbBuf -= cbToCopy;
+                pvBuf = (uint8_t *)pvBuf + cbToCopy;
+                continue;
+            }
+            pSSM->u.Read.pbDataBuffer  = &pSSM->u.Read.abDataBuffer[0];
+            pSSM->u.Read.cbDataBuffer  = 0;
+            pSSM->u.Read.offDataBuffer = 0;
+
+            rc = ssmR3DataReadRecHdrV2(pSSM);
             if (RT_FAILURE(rc))
                 return pSSM->rc = rc;
         }
@@ -6356,6 +7050,7 @@ static int ssmR3DataReadUnbufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
             }
 
             case SSM_REC_TYPE_RAW_LZF:
+            case SSM_REC_TYPE_RAW_ZLIB:
             {
                 int rc = ssmR3DataReadV2RawLzfHdr(pSSM, &cbToRead);
                 if (RT_FAILURE(rc))
@@ -6436,13 +7131,14 @@ static int ssmR3DataReadBufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
     {
         uint32_t const cbToCopy = (uint32_t)cbInBuffer;
         Assert(cbBuf > cbToCopy);
-        memcpy(pvBuf, &pSSM->u.Read.abDataBuffer[off], cbToCopy);
+        memcpy(pvBuf, &pSSM->u.Read.pbDataBuffer[off], cbToCopy);
         pvBuf  = (uint8_t *)pvBuf + cbToCopy;
         cbBuf -= cbToCopy;
         pSSM->offUnitUser += cbToCopy;
-        pSSM->u.Read.cbDataBuffer  = 0;
-        pSSM->u.Read.offDataBuffer = 0;
     }
+    pSSM->u.Read.pbDataBuffer  = &pSSM->u.Read.abDataBuffer[0];
+    pSSM->u.Read.cbDataBuffer  = 0;
+    pSSM->u.Read.offDataBuffer = 0;
 
     /*
      * Buffer more data.
@@ -6450,11 +7146,29 @@ static int ssmR3DataReadBufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
     do
     {
         /*
-         * Read the next record header if no more data.
+         * Read the next record header if no more data, trying to read ahead
+         * and decompress a bunch of records in parallel first.
          */
         if (!pSSM->u.Read.cbRecLeft)
         {
-            int rc = ssmR3DataReadRecHdrV2(pSSM);
+            int rc = ssmR3DataReadAheadV2(pSSM);
+            if (RT_FAILURE(rc))
+                return pSSM->rc = rc;
+            if (pSSM->u.Read.cbDataBuffer)
+            {
+                uint32_t const cbToCopy = (uint32_t)RT_MIN(cbBuf, pSSM->u.Read.cbDataBuffer);
+                memcpy(pvBuf, pSSM->u.Read.pbDataBuffer, cbToCopy);
+                pSSM->u.Read.offDataBuffer = cbToCopy;
+                pSSM->offUnitUser += cbToCopy;
+                cbBuf -= cbToCopy;
+                pvBuf = (uint8_t *)pvBuf + cbToCopy;
+                continue;
+            }
+            pSSM->u.Read.pbDataBuffer  = &pSSM->u.Read.abDataBuffer[0];
+            pSSM->u.Read.cbDataBuffer  = 0;
+            pSSM->u.Read.offDataBuffer = 0;
+
+            rc = ssmR3DataReadRecHdrV2(pSSM);
             if (RT_FAILURE(rc))
                 return pSSM->rc = rc;
         }
@@ -6479,6 +7193,7 @@ static int ssmR3DataReadBufferedV2(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
             }
 
             case SSM_REC_TYPE_RAW_LZF:
+            case SSM_REC_TYPE_RAW_ZLIB:
             {
                 int rc = ssmR3DataReadV2RawLzfHdr(pSSM, &cbToRead);
                 if (RT_FAILURE(rc))
@@ -6543,15 +7258,14 @@ DECLINLINE(int) ssmR3DataRead(PSSMHANDLE pSSM, void *pvBuf, size_t cbBuf)
              * Check if the requested data is buffered.
              */
             uint32_t off = pSSM->u.Read.offDataBuffer;
-            if (   off + cbBuf > pSSM->u.Read.cbDataBuffer
-                || cbBuf > sizeof(pSSM->u.Read.abDataBuffer))
+            if (off + cbBuf > pSSM->u.Read.cbDataBuffer)
             {
                 if (cbBuf <= sizeof(pSSM->u.Read.abDataBuffer) / 8)
                     return ssmR3DataReadBufferedV2(pSSM, pvBuf, cbBuf);
                 return ssmR3DataReadUnbufferedV2(pSSM, pvBuf, cbBuf);
             }
 
-            memcpy(pvBuf, &pSSM->u.Read.abDataBuffer[off], cbBuf);
+            memcpy(pvBuf, &pSSM->u.Read.pbDataBuffer[off], cbBuf);
             pSSM->u.Read.offDataBuffer = off + (uint32_t)cbBuf;
             pSSM->offUnitUser += cbBuf;
             Log4((cbBuf
@@ -7521,6 +8235,7 @@ VMMR3DECL(int) SSMR3SkipToEndOfUnit(PSSMHANDLE pSSM)
         /*
          * Read until we the end of data condition is raised.
          */
+        pSSM->u.Read.pbDataBuffer  = &pSSM->u.Read.abDataBuffer[0];
         pSSM->u.Read.cbDataBuffer  = 0;
         pSSM->u.Read.offDataBuffer = 0;
         if (!pSSM->u.Read.fEndOfData)
@@ -8031,6 +8746,8 @@ static int ssmR3OpenFile(PVM pVM, const char *pszFilename, PCSSMSTRMOPS pStreamO
     pSSM->offUnit               = UINT64_MAX;
     pSSM->offUnitUser           = UINT64_MAX;
     pSSM->fLiveSave             = false;
+    pSSM->enmZipType            = RTZIPTYPE_LZF;
+    pSSM->pZip                  = NULL;
     pSSM->pfnProgress           = NULL;
     pSSM->pvUser                = NULL;
     pSSM->uPercent              = 0;
@@ -8061,6 +8778,7 @@ static int ssmR3OpenFile(PVM pVM, const char *pszFilename, PCSSMSTRMOPS pStreamO
     pSSM->u.Read.cbLoadFile     = UINT64_MAX;
 
     pSSM->u.Read.cbRecLeft      = 0;
+    pSSM->u.Read.pbDataBuffer   = &pSSM->u.Read.abDataBuffer[0];
     pSSM->u.Read.cbDataBuffer   = 0;
     pSSM->u.Read.offDataBuffer  = 0;
     pSSM->u.Read.fEndOfData     = 0;
@@ -8800,6 +9518,8 @@ VMMR3DECL(int) SSMR3Load(PVM pVM, const char *pszFilename, PCSSMSTRMOPS pStreamO
     {
         ssmR3StrmStartIoThread(&Handle.Strm);
         ssmR3SetCancellable(pVM, &Handle, true);
+        if (Handle.u.Read.uFmtVerMajor >= 2)
+            ssmR3ZipCreate(pVM, &Handle, false /*fSave*/);
 
         Handle.enmAfter         = enmAfter;
         Handle.pfnProgress      = pfnProgress;
@@ -8959,6 +9679,7 @@ VMMR3DECL(int) SSMR3Load(PVM pVM, const char *pszFilename, PCSSMSTRMOPS pStreamO
             pfnProgress(pVM->pUVM, 99, pvProgressUser);
 
         ssmR3SetCancellable(pVM, &Handle, false);
+        ssmR3ZipDestroy(&Handle);
         ssmR3StrmClose(&Handle.Strm, Handle.rc == VERR_SSM_CANCELLED);
         rc = Handle.rc;
     }
@@ -146,6 +146,7 @@ static void                 stamR3LookupDestroyTree(PSTAMLOOKUP pRoot);
 static int                  stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfnReset, PFNSTAMR3CALLBACKPRINT pfnPrint,
                                             STAMTYPE enmType, STAMVISIBILITY enmVisibility, const char *pszName, STAMUNIT enmUnit, const char *pszDesc);
 static int                  stamR3ResetOne(PSTAMDESC pDesc, void *pvArg);
+static void                 stamR3HistogramPercentiles(PSTAMHISTOGRAM pHistogram, uint64_t *pauValues);
 static DECLCALLBACK(void)   stamR3EnumLogPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
 static DECLCALLBACK(void)   stamR3EnumRelLogPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
 static DECLCALLBACK(void)   stamR3EnumPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
@@ -157,7 +158,6 @@ static bool                 stamR3MultiMatch(const char * const *papszExpression
 static char **              stamR3SplitPattern(const char *pszPat, unsigned *pcExpressions, char **ppszCopy);
 static int                  stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0, int (pfnCallback)(PSTAMDESC pDesc, void *pvArg), void *pvArg);
 static void                 stamR3Ring0StatsRegisterU(PUVM pUVM);
-static void                 stamR3Ring0StatsUpdateU(PUVM pUVM, const char *pszPat);
 static void                 stamR3Ring0StatsUpdateMultiU(PUVM pUVM, const char * const *papszExpressions, unsigned cExpressions);
 
 #ifdef VBOX_WITH_DEBUGGER
@@ -170,6 +170,9 @@ static FNDBGCCMD            stamR3CmdStatsReset;
 /*********************************************************************************************************************************
 *   Global Variables                                                                                                             *
 *********************************************************************************************************************************/
+/** The percentiles reported for histogram samples, in per mille. */
+static const uint32_t       g_auStamHistogramPerMille[] = { 500, 900, 990, 999 };
+
 #ifdef VBOX_WITH_DEBUGGER
 /** Pattern argument. */
 static const DBGCVARDESC    g_aArgPat[] =
@@ -1358,6 +1361,7 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
         case STAMTYPE_COUNTER:
         case STAMTYPE_PROFILE:
         case STAMTYPE_PROFILE_ADV:
+        case STAMTYPE_HISTOGRAM:
             AssertMsg(!((uintptr_t)pvSample & 7), ("%p - %s\n", pvSample, pszName));
             break;
 
@@ -1431,6 +1435,7 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
 #endif
 
         stamR3ResetOne(pNew, pUVM->pVM);
+        pUVM->stam.s.uGeneration++;
         rc = VINF_SUCCESS;
     }
     else
@@ -1445,11 +1450,13 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
  * Destroys the statistics descriptor, unlinking it and freeing all resources.
  *
  * @returns VINF_SUCCESS
+ * @param   pUVM        Pointer to the user mode VM structure.
  * @param   pCur        The descriptor to destroy.
  */
-static int stamR3DestroyDesc(PSTAMDESC pCur)
+static int stamR3DestroyDesc(PUVM pUVM, PSTAMDESC pCur)
 {
     RTListNodeRemove(&pCur->ListEntry);
+    pUVM->stam.s.uGeneration++;
 #ifdef STAM_WITH_LOOKUP_TREE
     pCur->pLookup->pDesc = NULL; /** @todo free lookup nodes once it's working. */
     stamR3LookupDecUsage(pCur->pLookup);
@@ -1491,7 +1498,7 @@ VMMR3DECL(int)  STAMR3DeregisterByAddr(PUVM pUVM, void *pvSample)
     RTListForEachSafe(&pUVM->stam.s.List, pCur, pNext, STAMDESC, ListEntry)
     {
         if (pCur->u.pv == pvSample)
-            rc = stamR3DestroyDesc(pCur);
+            rc = stamR3DestroyDesc(pUVM, pCur);
     }
 
     STAM_UNLOCK_WR(pUVM);
@@ -1524,7 +1531,7 @@ static int stamR3DeregisterByPattern(PUVM pUVM, const char *pszPat)
             PSTAMDESC pNext = RTListNodeGetNext(&pCur->ListEntry, STAMDESC, ListEntry);
 
             if (RTStrSimplePatternMatch(pszPat, pCur->pszName))
-                rc = stamR3DestroyDesc(pCur);
+                rc = stamR3DestroyDesc(pUVM, pCur);
 
             /* advance. */
             if (pCur == pLast)
@@ -1723,6 +1730,15 @@ static int stamR3ResetOne(PSTAMDESC pDesc, void *pvArg)
             ASMAtomicXchgU64(&pDesc->u.pProfile->cTicksMin, UINT64_MAX);
             break;
 
+        case STAMTYPE_HISTOGRAM:
+            ASMAtomicXchgU64(&pDesc->u.pHistogram->Core.cPeriods, 0);
+            ASMAtomicXchgU64(&pDesc->u.pHistogram->Core.cTicks, 0);
+            ASMAtomicXchgU64(&pDesc->u.pHistogram->Core.cTicksMax, 0);
+            ASMAtomicXchgU64(&pDesc->u.pHistogram->Core.cTicksMin, UINT64_MAX);
+            for (unsigned i = 0; i < RT_ELEMENTS(pDesc->u.pHistogram->acBuckets); i++)
+                ASMAtomicXchgU64(&pDesc->u.pHistogram->acBuckets[i], 0);
+            break;
+
         case STAMTYPE_RATIO_U32_RESET:
             ASMAtomicXchgU32(&pDesc->u.pRatioU32->u32A, 0);
             ASMAtomicXchgU32(&pDesc->u.pRatioU32->u32B, 0);
@@ -1779,6 +1795,54 @@ static int stamR3ResetOne(PSTAMDESC pDesc, void *pvArg)
 }
 
 
+/**
+ * Calculates the g_auStamHistogramPerMille percentiles of a histogram sample.
+ *
+ * Each percentile is reported as the largest value of the bucket it falls in,
+ * clamped to the range recorded in the core.
+ *
+ * @param   pHistogram  The histogram sample.
+ * @param   pauValues   Where to return the percentiles, RT_ELEMENTS(g_auStamHistogramPerMille) entries.
+ */
+static void stamR3HistogramPercentiles(PSTAMHISTOGRAM pHistogram, uint64_t *pauValues)
+{
+    /* Work on a copy so the ranks add up while the sample keeps being updated. */
+    uint64_t acBuckets[STAMHISTOGRAM_BUCKETS];
+    uint64_t cTotal = 0;
+    for (unsigned i = 0; i < STAMHISTOGRAM_BUCKETS; i++)
+    {
+        acBuckets[i] = ASMAtomicUoReadU64(&pHistogram->acBuckets[i]);
+        cTotal += acBuckets[i];
+    }
+    uint64_t const uMin = pHistogram->Core.cTicksMin;
+    uint64_t const uMax = pHistogram->Core.cTicksMax;
+
+    uint32_t iBucket = 0;
+    uint64_t cSeen   = acBuckets[0];
+    for (unsigned iPct = 0; iPct < RT_ELEMENTS(g_auStamHistogramPerMille); iPct++)
+    {
+        if (!cTotal)
+        {
+            pauValues[iPct] = 0;
+            continue;
+        }
+
+        uint64_t cRank = (cTotal * g_auStamHistogramPerMille[iPct] + 999) / 1000;
+        if (!cRank)
+            cRank = 1;
+        while (cSeen < cRank && iBucket + 1 < STAMHISTOGRAM_BUCKETS)
+            cSeen += acBuckets[++iBucket];
+
+        uint64_t uValue = iBucket + 1 < STAMHISTOGRAM_BUCKETS ? STAMHistogramBucketToValue(iBucket + 1) - 1 : uMax;
+        if (uValue > uMax)
+            uValue = uMax;
+        if (uValue < uMin)
+            uValue = uMin;
+        pauValues[iPct] = uValue;
+    }
+}
+
+
 /**
  * Get a snapshot of the statistics.
  * It's possible to select a subset of the samples.
@@ -1861,6 +1925,20 @@ static int stamR3SnapshotOne(PSTAMDESC pDesc, void *pvArg)
                                  pDesc->u.pProfile->cTicksMax);
             break;
 
+        case STAMTYPE_HISTOGRAM:
+        {
+            if (pDesc->enmVisibility == STAMVISIBILITY_USED && pDesc->u.pHistogram->Core.cPeriods == 0)
+                return VINF_SUCCESS;
+            uint64_t auPct[RT_ELEMENTS(g_auStamHistogramPerMille)];
+            stamR3HistogramPercentiles(pDesc->u.pHistogram, auPct);
+            stamR3SnapshotPrintf(pThis, "<Histogram cPeriods=\"%llu\" cTicks=\"%llu\" cTicksMin=\"%llu\" cTicksMax=\"%llu\""
+                                 " p50=\"%llu\" p90=\"%llu\" p99=\"%llu\" p999=\"%llu\"",
+                                 pDesc->u.pHistogram->Core.cPeriods, pDesc->u.pHistogram->Core.cTicks,
+                                 pDesc->u.pHistogram->Core.cTicksMin, pDesc->u.pHistogram->Core.cTicksMax,
+                                 auPct[0], auPct[1], auPct[2], auPct[3]);
+            break;
+        }
+
         case STAMTYPE_RATIO_U32:
         case STAMTYPE_RATIO_U32_RESET:
             if (pDesc->enmVisibility == STAMVISIBILITY_USED && !pDesc->u.pRatioU32->u32A && !pDesc->u.pRatioU32->u32B)
@@ -2238,6 +2316,22 @@ static int stamR3PrintOne(PSTAMDESC pDesc, void *pvArg)
             break;
         }
 
+        case STAMTYPE_HISTOGRAM:
+        {
+            if (pDesc->enmVisibility == STAMVISIBILITY_USED && pDesc->u.pHistogram->Core.cPeriods == 0)
+                return VINF_SUCCESS;
+
+            uint64_t auPct[RT_ELEMENTS(g_auStamHistogramPerMille)];
+            stamR3HistogramPercentiles(pDesc->u.pHistogram, auPct);
+            uint64_t u64 = pDesc->u.pHistogram->Core.cPeriods ? pDesc->u.pHistogram->Core.cPeriods : 1;
+            pArgs->pfnPrintf(pArgs, "%-32s %8llu %s (%7llu times, max %9llu, min %7llu, p50 %llu, p90 %llu, p99 %llu, p99.9 %llu)\n",
+                             pDesc->pszName, pDesc->u.pHistogram->Core.cTicks / u64, STAMR3GetUnit(pDesc->enmUnit),
+                             pDesc->u.pHistogram->Core.cPeriods, pDesc->u.pHistogram->Core.cTicksMax,
+                             pDesc->u.pHistogram->Core.cPeriods ? pDesc->u.pHistogram->Core.cTicksMin : 0,
+                             auPct[0], auPct[1], auPct[2], auPct[3]);
+            break;
+        }
+
         case STAMTYPE_RATIO_U32:
         case STAMTYPE_RATIO_U32_RESET:
             if (pDesc->enmVisibility == STAMVISIBILITY_USED && !pDesc->u.pRatioU32->u32A && !pDesc->u.pRatioU32->u32B)
@@ -2628,11 +2722,24 @@ static void stamR3Ring0StatsRegisterU(PUVM pUVM)
  * Updates the ring-0 statistics (the copy).
  *
  * @param   pUVM        Pointer to the user mode VM structure.
- * @param   pszPat      The pattern.
+ * @param   pszPat      The pattern, multiple patterns can be separated by '|'.
  */
-static void stamR3Ring0StatsUpdateU(PUVM pUVM, const char *pszPat)
+void stamR3Ring0StatsUpdateU(PUVM pUVM, const char *pszPat)
 {
-    stamR3Ring0StatsUpdateMultiU(pUVM, &pszPat, 1);
+    if (!strchr(pszPat, '|'))
+        stamR3Ring0StatsUpdateMultiU(pUVM, &pszPat, 1);
+    else
+    {
+        char    *pszCopy;
+        unsigned cExpressions;
+        char   **papszExpressions = stamR3SplitPattern(pszPat, &cExpressions, &pszCopy);
+        if (papszExpressions)
+        {
+            stamR3Ring0StatsUpdateMultiU(pUVM, papszExpressions, cExpressions);
+            RTMemTmpFree(papszExpressions);
+            RTStrFree(pszCopy);
+        }
+    }
 }
 
 
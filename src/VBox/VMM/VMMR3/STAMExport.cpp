@@ -0,0 +1,690 @@
+/* $Id$ */
+/** @file
+ * STAM - The Statistics Manager, Shared Memory Export.
+ */
+
+/*
+ * Copyright (C) 2006-2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+/** @page pg_stam_export    STAM - Shared Memory Export
+ *
+ * Scraping the statistics of many VMs thru STAMR3Snapshot() means walking the
+ * sample list and formatting XML for each and every scrape, in the VM process
+ * as well as in whoever parses the result.  As an alternative, STAM can
+ * maintain a file backed shared memory region (see grp_stam_export for the
+ * layout) which a local exporter can map and read directly.
+ *
+ * The region is refreshed by a dedicated thread at a configurable interval.
+ * It rebuilds the descriptor and string tables whenever samples have been
+ * registered or deregistered since the previous refresh (tracked by
+ * STAMUSERPERVM::uGeneration), and otherwise only copies the sample values.
+ * The copying is done while holding the STAM read lock, so the sample memory
+ * can't go away underneath it, and the region is protected by a sequence lock
+ * so readers never need to take any locks.
+ *
+ * The feature is off by default and enabled by setting /STAM/ExportPath.  On
+ * hosts with a memory backed file system (e.g. /dev/shm) the region never
+ * touches the disk.  The file is only accessible to the VM process owner.
+ * /STAM/ExportPattern limits the samples exported, which also limits the
+ * ring-0 statistics (GVMM, GMM) that have to be fetched for each refresh.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define LOG_GROUP LOG_GROUP_STAM
+#include <VBox/vmm/stam.h>
+#include <VBox/vmm/stamexport.h>
+#include "STAMInternal.h"
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/mm.h>
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/uvm.h>
+#include <VBox/err.h>
+#include <VBox/log.h>
+
+#include <iprt/assert.h>
+#include <iprt/asm.h>
+#include <iprt/file.h>
+#include <iprt/mem.h>
+#include <iprt/process.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+
+#ifdef RT_OS_WINDOWS
+# include <iprt/win/windows.h>
+#else
+# include <errno.h>
+# include <sys/mman.h>
+#endif
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The default update interval in milliseconds. */
+#define STAMEXPORT_DEFAULT_INTERVAL     1000
+/** The minimum update interval in milliseconds. */
+#define STAMEXPORT_MIN_INTERVAL         10
+/** The region size granularity. */
+#define STAMEXPORT_REGION_ALIGN         _64K
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * The shared memory export instance data.
+ */
+typedef struct STAMEXPORT
+{
+    /** Pointer to the user mode VM structure. */
+    PUVM                pUVM;
+    /** The path of the backing file. */
+    char               *pszPath;
+    /** The pattern selecting the samples to export ('|' separated). */
+    char               *pszPattern;
+    /** The backing file. */
+    RTFILE              hFile;
+#ifdef RT_OS_WINDOWS
+    /** The file mapping object. */
+    HANDLE              hMapping;
+#endif
+    /** The current mapping of the region, NULL if not mapped. */
+    PSTAMEXPORTHDR      pHdr;
+    /** The size of the current mapping. */
+    size_t              cbMapping;
+    /** The update interval in milliseconds. */
+    uint32_t            cMsInterval;
+
+    /** The STAMUSERPERVM::uGeneration value the descriptor table reflects. */
+    uint32_t            uGeneration;
+    /** Whether the descriptor table and papDescs are valid. */
+    bool                fLayoutValid;
+    /** Whether the update failure has been logged. */
+    bool                fLoggedFailure;
+    /** The sample descriptors corresponding to the region descriptors.
+     * Only valid while holding the STAM lock and uGeneration matches. */
+    PSTAMDESC          *papDescs;
+    /** The number of entries papDescs has room for. */
+    uint32_t            cDescsAlloc;
+
+    /** The update thread. */
+    RTTHREAD            hThread;
+    /** Event semaphore the update thread waits on. */
+    RTSEMEVENT          hEvtWakeup;
+    /** Set when the update thread should terminate. */
+    bool volatile       fTerminate;
+} STAMEXPORT;
+/** Pointer to the shared memory export instance data. */
+typedef STAMEXPORT *PSTAMEXPORT;
+
+
+/**
+ * Gets the number of value slots a sample of the given type occupies.
+ *
+ * @returns Number of value slots, 0 if not exported.
+ * @param   enmType     The sample type.
+ */
+static uint32_t stamR3ExportValueCount(STAMTYPE enmType)
+{
+    switch (enmType)
+    {
+        case STAMTYPE_COUNTER:
+        case STAMTYPE_U8:
+        case STAMTYPE_U8_RESET:
+        case STAMTYPE_X8:
+        case STAMTYPE_X8_RESET:
+        case STAMTYPE_U16:
+        case STAMTYPE_U16_RESET:
+        case STAMTYPE_X16:
+        case STAMTYPE_X16_RESET:
+        case STAMTYPE_U32:
+        case STAMTYPE_U32_RESET:
+        case STAMTYPE_X32:
+        case STAMTYPE_X32_RESET:
+        case STAMTYPE_U64:
+        case STAMTYPE_U64_RESET:
+        case STAMTYPE_X64:
+        case STAMTYPE_X64_RESET:
+        case STAMTYPE_BOOL:
+        case STAMTYPE_BOOL_RESET:
+            return 1;
+
+        case STAMTYPE_RATIO_U32:
+        case STAMTYPE_RATIO_U32_RESET:
+            return 2;
+
+        case STAMTYPE_PROFILE:
+        case STAMTYPE_PROFILE_ADV:
+            return 4;
+
+        case STAMTYPE_HISTOGRAM:
+            return 4 + STAMHISTOGRAM_BUCKETS;
+
+        case STAMTYPE_CALLBACK:
+        default:
+            return 0;
+    }
+}
+
+
+/**
+ * Checks whether a sample is to be exported.
+ *
+ * @returns true if it is, false if not.
+ * @param   pExport     The export instance.
+ * @param   pDesc       The sample.
+ */
+static bool stamR3ExportIsIncluded(PSTAMEXPORT pExport, PSTAMDESC pDesc)
+{
+    return stamR3ExportValueCount(pDesc->enmType) != 0
+        && RTStrSimplePatternMultiMatch(pExport->pszPattern, RTSTR_MAX, pDesc->pszName, RTSTR_MAX, NULL);
+}
+
+
+/**
+ * Unmaps the region.
+ *
+ * @param   pExport     The export instance.
+ */
+static void stamR3ExportUnmap(PSTAMEXPORT pExport)
+{
+    if (pExport->pHdr)
+    {
+#ifdef RT_OS_WINDOWS
+        UnmapViewOfFile(pExport->pHdr);
+        CloseHandle(pExport->hMapping);
+        pExport->hMapping = NULL;
+#else
+        munmap(pExport->pHdr, pExport->cbMapping);
+#endif
+        pExport->pHdr      = NULL;
+        pExport->cbMapping = 0;
+    }
+}
+
+
+/**
+ * Grows the backing file and (re)maps the region.
+ *
+ * The new mapping is established before the old one is dropped, so a failure
+ * leaves the current mapping untouched.
+ *
+ * @returns VBox status code.
+ * @param   pExport     The export instance.
+ * @param   cbMapping   The new region size, multiple of STAMEXPORT_REGION_ALIGN.
+ */
+static int stamR3ExportMap(PSTAMEXPORT pExport, size_t cbMapping)
+{
+    Assert(cbMapping > pExport->cbMapping);
+#ifdef RT_OS_WINDOWS
+    /* The file mapping object extends the file for us. */
+    HANDLE hMapping = CreateFileMappingW((HANDLE)RTFileToNative(pExport->hFile), NULL /*pSecAttrs*/, PAGE_READWRITE,
+                                         (DWORD)((uint64_t)cbMapping >> 32), (DWORD)cbMapping, NULL /*pwszName*/);
+    if (!hMapping)
+        return RTErrConvertFromWin32(GetLastError());
+    void *pv = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, cbMapping);
+    if (!pv)
+    {
+        int rc = RTErrConvertFromWin32(GetLastError());
+        CloseHandle(hMapping);
+        return rc;
+    }
+#else
+    int rc = RTFileSetSize(pExport->hFile, cbMapping);
+    if (RT_FAILURE(rc))
+        return rc;
+    void *pv = mmap(NULL, cbMapping, PROT_READ | PROT_WRITE, MAP_SHARED, (int)RTFileToNative(pExport->hFile), 0);
+    if (pv == MAP_FAILED)
+        return RTErrConvertFromErrno(errno);
+#endif
+
+    stamR3ExportUnmap(pExport);
+#ifdef RT_OS_WINDOWS
+    pExport->hMapping  = hMapping;
+#endif
+    pExport->pHdr      = (PSTAMEXPORTHDR)pv;
+    pExport->cbMapping = cbMapping;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Rebuilds the descriptor and string tables.
+ *
+ * The caller owns the STAM read lock and has entered the sequence lock.
+ *
+ * @returns VBox status code.  On failure the region is left empty.
+ * @param   pExport     The export instance.
+ */
+static int stamR3ExportLayout(PSTAMEXPORT pExport)
+{
+    PUVM pUVM = pExport->pUVM;
+
+    /*
+     * Size up the tables.
+     */
+    uint32_t  cDescs    = 0;
+    uint32_t  cbStrings = 0;
+    uint32_t  cValues   = 0;
+    PSTAMDESC pCur;
+    RTListForEach(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
+    {
+        if (stamR3ExportIsIncluded(pExport, pCur))
+        {
+            cDescs++;
+            cValues   += stamR3ExportValueCount(pCur->enmType);
+            cbStrings += (uint32_t)strlen(pCur->pszName) + 1;
+            if (pCur->pszDesc)
+                cbStrings += (uint32_t)strlen(pCur->pszDesc) + 1;
+        }
+    }
+
+    uint32_t const offDescs   = RT_ALIGN_32(sizeof(STAMEXPORTHDR), 8);
+    uint32_t const offStrings = offDescs + cDescs * sizeof(STAMEXPORTDESC);
+    uint32_t const offValues  = RT_ALIGN_32(offStrings + cbStrings, 8);
+    size_t   const cbNeeded   = offValues + (size_t)cValues * sizeof(uint64_t);
+
+    /*
+     * Make sure we've got enough room, leaving some slack for samples
+     * registered later on so we don't have to remap all the time.
+     */
+    int rc = VINF_SUCCESS;
+    if (cDescs > pExport->cDescsAlloc)
+    {
+        uint32_t  cNew     = RT_ALIGN_32(cDescs + cDescs / 4, 64);
+        PSTAMDESC *papNew  = (PSTAMDESC *)RTMemRealloc(pExport->papDescs, cNew * sizeof(PSTAMDESC));
+        if (papNew)
+        {
+            pExport->papDescs    = papNew;
+            pExport->cDescsAlloc = cNew;
+        }
+        else
+            rc = VERR_NO_MEMORY;
+    }
+    if (RT_SUCCESS(rc) && cbNeeded > pExport->cbMapping)
+        rc = stamR3ExportMap(pExport, RT_ALIGN_Z(cbNeeded + cbNeeded / 4, STAMEXPORT_REGION_ALIGN));
+
+    PSTAMEXPORTHDR pHdr = pExport->pHdr;
+    if (RT_FAILURE(rc))
+    {
+        pHdr->cDescs    = 0;
+        pHdr->cbStrings = 0;
+        pHdr->cValues   = 0;
+        pHdr->uGeneration++;
+        pExport->fLayoutValid = false;
+        return rc;
+    }
+
+    /*
+     * Fill in the tables.
+     */
+    PSTAMEXPORTDESC paDescs   = (PSTAMEXPORTDESC)((uint8_t *)pHdr + offDescs);
+    char           *pchString = (char *)pHdr + offStrings;
+    uint32_t        offString = 0;
+    uint32_t        iDesc     = 0;
+    uint32_t        iValue    = 0;
+    RTListForEach(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
+    {
+        if (!stamR3ExportIsIncluded(pExport, pCur))
+            continue;
+        uint32_t const cCurValues = stamR3ExportValueCount(pCur->enmType);
+
+        PSTAMEXPORTDESC pDesc = &paDescs[iDesc];
+        size_t cch = strlen(pCur->pszName) + 1;
+        memcpy(&pchString[offString], pCur->pszName, cch);
+        pDesc->offName = offString;
+        offString += (uint32_t)cch;
+        if (pCur->pszDesc)
+        {
+            cch = strlen(pCur->pszDesc) + 1;
+            memcpy(&pchString[offString], pCur->pszDesc, cch);
+            pDesc->offDesc = offString;
+            offString += (uint32_t)cch;
+        }
+        else
+            pDesc->offDesc = UINT32_MAX;
+        pDesc->iValue        = iValue;
+        pDesc->cValues       = (uint16_t)cCurValues;
+        pDesc->enmType       = (uint8_t)pCur->enmType;
+        pDesc->enmUnit       = (uint8_t)pCur->enmUnit;
+        pDesc->enmVisibility = (uint8_t)pCur->enmVisibility;
+        RT_ZERO(pDesc->abReserved);
+
+        pExport->papDescs[iDesc++] = pCur;
+        iValue += cCurValues;
+    }
+    Assert(iDesc == cDescs); Assert(iValue == cValues); Assert(offString == cbStrings);
+
+    pHdr->cDescs      = cDescs;
+    pHdr->offDescs    = offDescs;
+    pHdr->offStrings  = offStrings;
+    pHdr->cbStrings   = cbStrings;
+    pHdr->offValues   = offValues;
+    pHdr->cValues     = cValues;
+    pHdr->cbRegion    = pExport->cbMapping;
+    pHdr->uGeneration++;
+
+    pExport->uGeneration  = pUVM->stam.s.uGeneration;
+    pExport->fLayoutValid = true;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Refreshes the region, rebuilding the tables if necessary.
+ *
+ * @returns VBox status code.
+ * @param   pExport     The export instance.
+ */
+static int stamR3ExportUpdate(PSTAMEXPORT pExport)
+{
+    PUVM pUVM = pExport->pUVM;
+
+    /* The GVMM and GMM samples are copies that must be fetched from ring-0,
+       only do that for the ones we export. */
+    stamR3Ring0StatsUpdateU(pUVM, pExport->pszPattern);
+
+    STAM_LOCK_RD(pUVM);
+
+    ASMAtomicIncU32(&pExport->pHdr->uSeq);
+
+    int rc = VINF_SUCCESS;
+    if (   !pExport->fLayoutValid
+        || pExport->uGeneration != pUVM->stam.s.uGeneration)
+        rc = stamR3ExportLayout(pExport);
+
+    PSTAMEXPORTHDR pHdr = pExport->pHdr;
+    if (RT_SUCCESS(rc))
+    {
+        /*
+         * Copy the values.
+         */
+        uint64_t       *pau     = (uint64_t *)((uint8_t *)pHdr + pHdr->offValues);
+        uint32_t const  cDescs  = pHdr->cDescs;
+        for (uint32_t iDesc = 0; iDesc < cDescs; iDesc++)
+        {
+            PSTAMDESC pDesc = pExport->papDescs[iDesc];
+            switch (pDesc->enmType)
+            {
+                case STAMTYPE_COUNTER:
+                    *pau++ = pDesc->u.pCounter->c;
+                    break;
+
+                case STAMTYPE_PROFILE:
+                case STAMTYPE_PROFILE_ADV:
+                    pau[0] = pDesc->u.pProfile->cPeriods;
+                    pau[1] = pDesc->u.pProfile->cTicks;
+                    pau[2] = pDesc->u.pProfile->cTicksMin;
+                    pau[3] = pDesc->u.pProfile->cTicksMax;
+                    pau += 4;
+                    break;
+
+                case STAMTYPE_HISTOGRAM:
+                {
+                    PSTAMHISTOGRAM pHistogram = pDesc->u.pHistogram;
+                    pau[0] = pHistogram->Core.cPeriods;
+                    pau[1] = pHistogram->Core.cTicks;
+                    pau[2] = pHistogram->Core.cTicksMin;
+                    pau[3] = pHistogram->Core.cTicksMax;
+                    pau += 4;
+                    for (uint32_t iBucket = 0; iBucket < STAMHISTOGRAM_BUCKETS; iBucket++)
+                        *pau++ = ASMAtomicUoReadU64(&pHistogram->acBuckets[iBucket]);
+                    break;
+                }
+
+                case STAMTYPE_RATIO_U32:
+                case STAMTYPE_RATIO_U32_RESET:
+                    pau[0] = pDesc->u.pRatioU32->u32A;
+                    pau[1] = pDesc->u.pRatioU32->u32B;
+                    pau += 2;
+                    break;
+
+                case STAMTYPE_U8:
+                case STAMTYPE_U8_RESET:
+                case STAMTYPE_X8:
+                case STAMTYPE_X8_RESET:
+                    *pau++ = *pDesc->u.pu8;
+                    break;
+
+                case STAMTYPE_U16:
+                case STAMTYPE_U16_RESET:
+                case STAMTYPE_X16:
+                case STAMTYPE_X16_RESET:
+                    *pau++ = *pDesc->u.pu16;
+                    break;
+
+                case STAMTYPE_U32:
+                case STAMTYPE_U32_RESET:
+                case STAMTYPE_X32:
+                case STAMTYPE_X32_RESET:
+                    *pau++ = *pDesc->u.pu32;
+                    break;
+
+                case STAMTYPE_U64:
+                case STAMTYPE_U64_RESET:
+                case STAMTYPE_X64:
+                case STAMTYPE_X64_RESET:
+                    *pau++ = *pDesc->u.pu64;
+                    break;
+
+                case STAMTYPE_BOOL:
+                case STAMTYPE_BOOL_RESET:
+                    *pau++ = *pDesc->u.pf;
+                    break;
+
+                default:
+                    AssertMsgFailed(("%d\n", pDesc->enmType));
+                    break;
+            }
+        }
+
+        RTTIMESPEC Now;
+        pHdr->nsUpdate    = RTTimeNanoTS();
+        pHdr->nsUpdateUtc = RTTimeSpecGetNano(RTTimeNow(&Now));
+        pHdr->cUpdates++;
+    }
+
+    ASMAtomicIncU32(&pHdr->uSeq);
+
+    STAM_UNLOCK_RD(pUVM);
+    return rc;
+}
+
+
+/**
+ * @callback_method_impl{FNRTTHREAD, The export update thread.}
+ */
+static DECLCALLBACK(int) stamR3ExportThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    PSTAMEXPORT pExport = (PSTAMEXPORT)pvUser;
+
+    while (!ASMAtomicReadBool(&pExport->fTerminate))
+    {
+        RTSemEventWait(pExport->hEvtWakeup, pExport->cMsInterval);
+        if (ASMAtomicReadBool(&pExport->fTerminate))
+            break;
+
+        int rc = stamR3ExportUpdate(pExport);
+        if (RT_FAILURE(rc) && !pExport->fLoggedFailure)
+        {
+            LogRel(("STAM: Failed to update the export region '%s': %Rrc\n", pExport->pszPath, rc));
+            pExport->fLoggedFailure = true;
+        }
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Destroys the export instance, deleting the backing file.
+ *
+ * @param   pExport     The export instance.
+ */
+static void stamR3ExportDestroy(PSTAMEXPORT pExport)
+{
+    if (pExport->pHdr)
+        ASMAtomicWriteU32(&pExport->pHdr->u32Magic, STAMEXPORTHDR_MAGIC_DEAD);
+    stamR3ExportUnmap(pExport);
+    if (pExport->hFile != NIL_RTFILE)
+    {
+        RTFileClose(pExport->hFile);
+        RTFileDelete(pExport->pszPath);
+    }
+    if (pExport->hEvtWakeup != NIL_RTSEMEVENT)
+        RTSemEventDestroy(pExport->hEvtWakeup);
+    RTMemFree(pExport->papDescs);
+    MMR3HeapFree(pExport->pszPattern);
+    MMR3HeapFree(pExport->pszPath);
+    RTMemFree(pExport);
+}
+
+
+/**
+ * Starts the shared memory export if configured.
+ *
+ * This is called when ring-3 initialization has completed.  Failures are
+ * logged but are not fatal to the VM.
+ *
+ * @returns VBox status code.
+ * @param   pUVM        Pointer to the user mode VM structure.
+ */
+VMMR3_INT_DECL(int) STAMR3ExportStart(PUVM pUVM)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    AssertReturn(!pUVM->stam.s.pExport, VERR_WRONG_ORDER);
+
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetRootU(pUVM), "STAM");
+
+    /** @cfgm{/STAM/ExportPath, string, none}
+     * The path of the file backing the shared memory statistics region (see
+     * stamexport.h).  The file is created when the VM starts and deleted when
+     * it terminates.  Preferably on a memory backed file system.  No export
+     * takes place when not specified. */
+    char *pszPath = NULL;
+    int rc = CFGMR3QueryStringAlloc(pCfg, "ExportPath", &pszPath);
+    if (rc == VERR_CFGM_VALUE_NOT_FOUND || rc == VERR_CFGM_NO_PARENT)
+        return VINF_SUCCESS;
+    AssertLogRelRCReturn(rc, rc);
+
+    /** @cfgm{/STAM/ExportInterval, uint32_t, 10..3600000 ms, 1000 ms}
+     * How often the shared memory statistics region is refreshed. */
+    uint32_t cMsInterval;
+    rc = CFGMR3QueryU32Def(pCfg, "ExportInterval", &cMsInterval, STAMEXPORT_DEFAULT_INTERVAL);
+    AssertLogRelRCReturnStmt(rc, MMR3HeapFree(pszPath), rc);
+    cMsInterval = RT_MIN(RT_MAX(cMsInterval, STAMEXPORT_MIN_INTERVAL), RT_MS_1HOUR);
+
+    /** @cfgm{/STAM/ExportPattern, string, *}
+     * Pattern selecting the samples to export, multiple patterns can be
+     * separated by '|'.  Ring-0 statistics are only fetched for refreshing the
+     * region when they match. */
+    char *pszPattern = NULL;
+    rc = CFGMR3QueryStringAllocDef(pCfg, "ExportPattern", &pszPattern, "*");
+    AssertLogRelRCReturnStmt(rc, MMR3HeapFree(pszPath), rc);
+
+    /*
+     * Create the instance and the backing file.
+     */
+    PSTAMEXPORT pExport = (PSTAMEXPORT)RTMemAllocZ(sizeof(*pExport));
+    if (!pExport)
+    {
+        MMR3HeapFree(pszPattern);
+        MMR3HeapFree(pszPath);
+        return VERR_NO_MEMORY;
+    }
+    pExport->pUVM        = pUVM;
+    pExport->pszPath     = pszPath;
+    pExport->pszPattern  = pszPattern;
+    pExport->hFile       = NIL_RTFILE;
+    pExport->cMsInterval = cMsInterval;
+    pExport->hThread     = NIL_RTTHREAD;
+    pExport->hEvtWakeup  = NIL_RTSEMEVENT;
+
+    /* Only the owner gets to see the statistics, they tell a lot about the guest. */
+    rc = RTFileOpen(&pExport->hFile, pszPath,
+                    RTFILE_O_READWRITE | RTFILE_O_CREATE_REPLACE | RTFILE_O_DENY_NONE | (0600 << RTFILE_O_CREATE_MODE_SHIFT));
+#ifndef RT_OS_WINDOWS
+    /* The create mode doesn't apply when replacing an existing file. */
+    if (RT_SUCCESS(rc))
+        rc = RTFileSetMode(pExport->hFile, RTFS_TYPE_FILE | RTFS_UNIX_IRUSR | RTFS_UNIX_IWUSR);
+#endif
+    if (RT_SUCCESS(rc))
+        rc = stamR3ExportMap(pExport, STAMEXPORT_REGION_ALIGN);
+    if (RT_SUCCESS(rc))
+    {
+        PSTAMEXPORTHDR pHdr = pExport->pHdr;
+        pHdr->u32Version  = STAMEXPORTHDR_VERSION;
+        pHdr->cbHdr       = sizeof(STAMEXPORTHDR);
+        pHdr->cbDesc      = sizeof(STAMEXPORTDESC);
+        pHdr->cbRegion    = pExport->cbMapping;
+        pHdr->offDescs    = RT_ALIGN_32(sizeof(STAMEXPORTHDR), 8);
+        pHdr->offStrings  = pHdr->offDescs;
+        pHdr->offValues   = pHdr->offDescs;
+        pHdr->cMsInterval = cMsInterval;
+        pHdr->uPid        = (uint32_t)RTProcSelf();
+
+        /* Populate it before publishing the magic so readers never see an empty region. */
+        rc = stamR3ExportUpdate(pExport);
+        if (RT_SUCCESS(rc))
+        {
+            ASMAtomicWriteU32(&pHdr->u32Magic, STAMEXPORTHDR_MAGIC);
+
+            rc = RTSemEventCreate(&pExport->hEvtWakeup);
+            if (RT_SUCCESS(rc))
+            {
+                rc = RTThreadCreate(&pExport->hThread, stamR3ExportThread, pExport, 0, RTTHREADTYPE_INFREQUENT_POLLER,
+                                    RTTHREADFLAGS_WAITABLE, "StamExport");
+                if (RT_SUCCESS(rc))
+                {
+                    pUVM->stam.s.pExport = pExport;
+                    LogRel(("STAM: Exporting statistics matching '%s' to '%s' every %u ms (%u samples, %zu bytes)\n",
+                            pszPattern, pszPath, cMsInterval, pExport->pHdr->cDescs, pExport->cbMapping));
+                    return VINF_SUCCESS;
+                }
+            }
+        }
+    }
+
+    LogRel(("STAM: Failed to set up the statistics export to '%s': %Rrc\n", pszPath, rc));
+    stamR3ExportDestroy(pExport);
+    return rc;
+}
+
+
+/**
+ * Stops the shared memory export, if active, and deletes the backing file.
+ *
+ * This must be called before any sample memory is freed at VM destruction.
+ *
+ * @param   pUVM        Pointer to the user mode VM structure.
+ */
+VMMR3_INT_DECL(void) STAMR3ExportStop(PUVM pUVM)
+{
+    UVM_ASSERT_VALID_EXT_RETURN_VOID(pUVM);
+    PSTAMEXPORT pExport = pUVM->stam.s.pExport;
+    if (!pExport)
+        return;
+    pUVM->stam.s.pExport = NULL;
+
+    ASMAtomicWriteBool(&pExport->fTerminate, true);
+    RTSemEventSignal(pExport->hEvtWakeup);
+    int rc = RTThreadWait(pExport->hThread, RT_INDEFINITE_WAIT, NULL);
+    AssertLogRelRC(rc);
+
+    stamR3ExportDestroy(pExport);
+}
+
@@ -172,6 +172,7 @@ static uint64_t             tmR3CalibrateTSC(void);
 static DECLCALLBACK(int)    tmR3Save(PVM pVM, PSSMHANDLE pSSM);
 static DECLCALLBACK(int)    tmR3Load(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t uPass);
 static DECLCALLBACK(void)   tmR3TimerCallback(PRTTIMER pTimer, void *pvUser, uint64_t iTick);
+static DECLCALLBACK(int)    tmR3TimerThread(RTTHREAD hThreadSelf, void *pvUser);
 static void                 tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue);
 static void                 tmR3TimerQueueRunVirtualSync(PVM pVM);
 static DECLCALLBACK(int)    tmR3SetWarpDrive(PUVM pUVM, uint32_t u32Percent);
@@ -208,7 +209,7 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
      * Init the structure.
      */
     void *pv;
-    int rc = MMHyperAlloc(pVM, sizeof(pVM->tm.s.paTimerQueuesR3[0]) * TMCLOCK_MAX, 0, MM_TAG_TM, &pv);
+    int rc = MMHyperAlloc(pVM, sizeof(pVM->tm.s.paTimerQueuesR3[0]) * TMTIMERQUEUE_COUNT, 0, MM_TAG_TM, &pv);
     AssertRCReturn(rc, rc);
     pVM->tm.s.paTimerQueuesR3 = (PTMTIMERQUEUE)pv;
     pVM->tm.s.paTimerQueuesR0 = MMHyperR3ToR0(pVM, pv);
@@ -224,6 +225,14 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
     pVM->tm.s.paTimerQueuesR3[TMCLOCK_REAL].u64Expire          = INT64_MAX;
     pVM->tm.s.paTimerQueuesR3[TMCLOCK_TSC].enmClock            = TMCLOCK_TSC;
     pVM->tm.s.paTimerQueuesR3[TMCLOCK_TSC].u64Expire           = INT64_MAX;
+    pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_VIRTUAL].enmClock     = TMCLOCK_VIRTUAL;
+    pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_VIRTUAL].u64Expire    = INT64_MAX;
+    pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_VIRTUAL].fTimerThread = true;
+    pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_REAL].enmClock        = TMCLOCK_REAL;
+    pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_REAL].u64Expire       = INT64_MAX;
+    pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_REAL].fTimerThread    = true;
+    pVM->tm.s.hTimerThreadEvt = NIL_SUPSEMEVENT;
+    pVM->tm.s.hTimerThread    = NIL_RTTHREAD;
 
 
     /*
@@ -598,6 +607,14 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
         return VMSetError(pVM, rc, RT_SRC_POS,
                           N_("Configuration error: Failed to querying uint32_t value \"HostHzFudgeFactorCatchUp400\""));
 
+    /** @cfgm{/TM/TimerThread, bool, false}
+     * Whether to run TMCLOCK_VIRTUAL and TMCLOCK_REAL timers created with
+     * TMTIMER_FLAGS_TIMER_THREAD on a dedicated thread instead of the timer EMT. */
+    rc = CFGMR3QueryBoolDef(pCfgHandle, "TimerThread", &pVM->tm.s.fTimerThread, false);
+    if (RT_FAILURE(rc))
+        return VMSetError(pVM, rc, RT_SRC_POS,
+                          N_("Configuration error: Failed to querying bool value \"TimerThread\""));
+
     /*
      * Finally, setup and report.
      */
@@ -607,6 +624,8 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
             "TM: TSCTiedToExecution=%RTbool TSCNotTiedToHalt=%RTbool\n",
             pVM->tm.s.cTSCTicksPerSecond, pVM->tm.s.cTSCTicksPerSecond, pVM->tm.s.enmTSCMode, tmR3GetTSCModeName(pVM),
             pVM->tm.s.fTSCTiedToExecution, pVM->tm.s.fTSCNotTiedToHalt));
+    if (pVM->tm.s.fTimerThread)
+        LogRel(("TM: TimerThread=true\n"));
 
     /*
      * Start the timer (guard against REM not yielding).
@@ -673,6 +692,12 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
     STAM_REG(pVM, &pVM->tm.s.StatPollVirtual,                         STAMTYPE_COUNTER, "/TM/Poll/HitsVirtual",                STAMUNIT_OCCURENCES, "The number of times TMTimerPoll found an expired TMCLOCK_VIRTUAL queue.");
     STAM_REG(pVM, &pVM->tm.s.StatPollVirtualSync,                     STAMTYPE_COUNTER, "/TM/Poll/HitsVirtualSync",            STAMUNIT_OCCURENCES, "The number of times TMTimerPoll found an expired TMCLOCK_VIRTUAL_SYNC queue.");
 
+    if (pVM->tm.s.fTimerThread)
+    {
+        STAM_REG(pVM, &pVM->tm.s.StatTimerThreadRuns,                 STAMTYPE_COUNTER, "/TM/TimerThread/Runs",                STAMUNIT_OCCURENCES, "Times the timer thread ran its queues.");
+        STAM_REG(pVM, &pVM->tm.s.StatTimerThreadWakeups,              STAMTYPE_COUNTER, "/TM/TimerThread/Wakeups",             STAMUNIT_OCCURENCES, "Times the timer thread was woken up early because of a timer change.");
+    }
+
     STAM_REG(pVM, &pVM->tm.s.StatPostponedR3,                         STAMTYPE_COUNTER, "/TM/PostponedR3",                     STAMUNIT_OCCURENCES, "Postponed due to unschedulable state, in ring-3.");
     STAM_REG(pVM, &pVM->tm.s.StatPostponedRZ,                         STAMTYPE_COUNTER, "/TM/PostponedRZ",                     STAMUNIT_OCCURENCES, "Postponed due to unschedulable state, in ring-0 / RC.");
 
@@ -755,6 +780,11 @@ VMM_INT_DECL(int) TMR3Init(PVM pVM)
     for (VMCPUID i = 0; i < pVM->cCpus; i++)
     {
         STAMR3RegisterF(pVM, &pVM->aCpus[i].tm.s.offTSCRawSrc,          STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS, "TSC offset relative the raw source",           "/TM/TSC/offCPU%u", i);
+#ifdef VBOX_WITH_STATISTICS
+        STAMR3RegisterF(pVM, &pVM->aCpus[i].tm.s.StatPoll,              STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "TMTimerPoll calls made by this CPU.",                      "/TM/Poll/CPU%u", i);
+        STAMR3RegisterF(pVM, &pVM->aCpus[i].tm.s.StatPollHits,          STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "TMTimerPoll calls made by this CPU that found expired timers.", "/TM/Poll/CPU%u/Hits", i);
+        STAMR3RegisterF(pVM, &pVM->aCpus[i].tm.s.StatPollMiss,          STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "TMTimerPoll calls made by this CPU where nothing had expired.", "/TM/Poll/CPU%u/Miss", i);
+#endif
 #ifndef VBOX_WITHOUT_NS_ACCOUNTING
 # if defined(VBOX_WITH_STATISTICS) || defined(VBOX_WITH_NS_ACCOUNTING_STATS)
         STAMR3RegisterF(pVM, &pVM->aCpus[i].tm.s.StatNsTotal,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_NS,               "Resettable: Total CPU run time.",   "/TM/CPU/%02u", i);
@@ -1042,7 +1072,7 @@ VMM_INT_DECL(int) TMR3InitFinalize(PVM pVM)
      * Create a timer for refreshing the CPU load stats.
      */
     PTMTIMER pTimer;
-    rc = TMR3TimerCreateInternal(pVM, TMCLOCK_REAL, tmR3CpuLoadTimer, NULL, "CPU Load Timer", &pTimer);
+    rc = TMR3TimerCreateInternal(pVM, TMCLOCK_REAL, tmR3CpuLoadTimer, NULL, 0 /*fFlags*/, "CPU Load Timer", &pTimer);
     if (RT_SUCCESS(rc))
         rc = TMTimerSetMillies(pTimer, 1000);
 #endif
@@ -1052,6 +1082,19 @@ VMM_INT_DECL(int) TMR3InitFinalize(PVM pVM)
      */
     pVM->tm.s.fTSCModeSwitchAllowed &= tmR3HasFixedTSC(pVM) && GIMIsEnabled(pVM) && HMIsEnabled(pVM);
     LogRel(("TM: TMR3InitFinalize: fTSCModeSwitchAllowed=%RTbool\n", pVM->tm.s.fTSCModeSwitchAllowed));
+
+    /*
+     * Start the timer thread if configured.
+     */
+    if (RT_SUCCESS(rc) && pVM->tm.s.fTimerThread)
+    {
+        rc = SUPSemEventCreate(pVM->pSession, &pVM->tm.s.hTimerThreadEvt);
+        AssertRCReturn(rc, rc);
+        rc = RTThreadCreate(&pVM->tm.s.hTimerThread, tmR3TimerThread, pVM, 0, RTTHREADTYPE_TIMER,
+                            RTTHREADFLAGS_WAITABLE, "TimerThread");
+        if (RT_FAILURE(rc))
+            return VMSetError(pVM, rc, RT_SRC_POS, N_("Failed to create the timer thread"));
+    }
     return rc;
 }
 
@@ -1111,6 +1154,21 @@ VMM_INT_DECL(int) TMR3Term(PVM pVM)
         pVM->tm.s.pTimer = NULL;
     }
 
+    if (pVM->tm.s.hTimerThread != NIL_RTTHREAD)
+    {
+        ASMAtomicWriteBool(&pVM->tm.s.fTimerThreadTerminate, true);
+        int rc = SUPSemEventSignal(pVM->pSession, pVM->tm.s.hTimerThreadEvt);
+        AssertRC(rc);
+        rc = RTThreadWait(pVM->tm.s.hTimerThread, 30000, NULL);
+        AssertRC(rc);
+        pVM->tm.s.hTimerThread = NIL_RTTHREAD;
+    }
+    if (pVM->tm.s.hTimerThreadEvt != NIL_SUPSEMEVENT)
+    {
+        SUPSemEventClose(pVM->pSession, pVM->tm.s.hTimerThreadEvt);
+        pVM->tm.s.hTimerThreadEvt = NIL_SUPSEMEVENT;
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -1155,7 +1213,7 @@ VMM_INT_DECL(void) TMR3Reset(PVM pVM)
     /*
      * Process the queues.
      */
-    for (int i = 0; i < TMCLOCK_MAX; i++)
+    for (int i = 0; i < TMTIMERQUEUE_COUNT; i++)
         tmTimerQueueSchedule(pVM, &pVM->tm.s.paTimerQueuesR3[i]);
 #ifdef VBOX_STRICT
     tmTimerQueuesSanityChecks(pVM, "TMR3Reset");
@@ -1401,10 +1459,11 @@ static DECLCALLBACK(int) tmR3Load(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, u
  * @returns VBox status code.
  * @param   pVM         The cross context VM structure.
  * @param   enmClock    The timer clock.
+ * @param   fFlags      Timer creation flags, see grp_tm_timer_flags.
  * @param   pszDesc     The timer description.
  * @param   ppTimer     Where to store the timer pointer on success.
  */
-static int tmr3TimerCreate(PVM pVM, TMCLOCK enmClock, const char *pszDesc, PPTMTIMERR3 ppTimer)
+static int tmr3TimerCreate(PVM pVM, TMCLOCK enmClock, uint32_t fFlags, const char *pszDesc, PPTMTIMERR3 ppTimer)
 {
     VM_ASSERT_EMT(pVM);
 
@@ -1432,6 +1491,15 @@ static int tmr3TimerCreate(PVM pVM, TMCLOCK enmClock, const char *pszDesc, PPTMT
      */
     pTimer->u64Expire       = 0;
     pTimer->enmClock        = enmClock;
+    pTimer->idxQueue        = enmClock;
+    if (   (fFlags & TMTIMER_FLAGS_TIMER_THREAD)
+        && pVM->tm.s.fTimerThread)
+    {
+        if (enmClock == TMCLOCK_VIRTUAL)
+            pTimer->idxQueue = TMTIMERQUEUE_THREAD_VIRTUAL;
+        else if (enmClock == TMCLOCK_REAL)
+            pTimer->idxQueue = TMTIMERQUEUE_THREAD_REAL;
+    }
     pTimer->pVMR3           = pVM;
     pTimer->pVMR0           = pVM->pVMR0;
     pTimer->pVMRC           = pVM->pVMRC;
@@ -1439,6 +1507,7 @@ static int tmr3TimerCreate(PVM pVM, TMCLOCK enmClock, const char *pszDesc, PPTMT
     pTimer->offScheduleNext = 0;
     pTimer->offNext         = 0;
     pTimer->offPrev         = 0;
+    pTimer->offChild        = 0;
     pTimer->pvUser          = NULL;
     pTimer->pCritSect       = NULL;
     pTimer->pszDesc         = pszDesc;
@@ -1478,12 +1547,12 @@ VMM_INT_DECL(int) TMR3TimerCreateDevice(PVM pVM, PPDMDEVINS pDevIns, TMCLOCK enm
                                         PFNTMTIMERDEV pfnCallback, void *pvUser,
                                         uint32_t fFlags, const char *pszDesc, PPTMTIMERR3 ppTimer)
 {
-    AssertReturn(!(fFlags & ~(TMTIMER_FLAGS_NO_CRIT_SECT)), VERR_INVALID_PARAMETER);
+    AssertReturn(!(fFlags & ~(TMTIMER_FLAGS_NO_CRIT_SECT | TMTIMER_FLAGS_TIMER_THREAD)), VERR_INVALID_PARAMETER);
 
     /*
      * Allocate and init stuff.
      */
-    int rc = tmr3TimerCreate(pVM, enmClock, pszDesc, ppTimer);
+    int rc = tmr3TimerCreate(pVM, enmClock, fFlags, pszDesc, ppTimer);
     if (RT_SUCCESS(rc))
     {
         (*ppTimer)->enmType         = TMTIMERTYPE_DEV;
@@ -1519,12 +1588,12 @@ VMM_INT_DECL(int) TMR3TimerCreateUsb(PVM pVM, PPDMUSBINS pUsbIns, TMCLOCK enmClo
                                      PFNTMTIMERUSB pfnCallback, void *pvUser,
                                      uint32_t fFlags, const char *pszDesc, PPTMTIMERR3 ppTimer)
 {
-    AssertReturn(!(fFlags & ~(TMTIMER_FLAGS_NO_CRIT_SECT)), VERR_INVALID_PARAMETER);
+    AssertReturn(!(fFlags & ~(TMTIMER_FLAGS_NO_CRIT_SECT | TMTIMER_FLAGS_TIMER_THREAD)), VERR_INVALID_PARAMETER);
 
     /*
      * Allocate and init stuff.
      */
-    int rc = tmr3TimerCreate(pVM, enmClock, pszDesc, ppTimer);
+    int rc = tmr3TimerCreate(pVM, enmClock, fFlags, pszDesc, ppTimer);
     if (RT_SUCCESS(rc))
     {
         (*ppTimer)->enmType         = TMTIMERTYPE_USB;
@@ -1562,12 +1631,12 @@ VMM_INT_DECL(int) TMR3TimerCreateUsb(PVM pVM, PPDMUSBINS pUsbIns, TMCLOCK enmClo
 VMM_INT_DECL(int) TMR3TimerCreateDriver(PVM pVM, PPDMDRVINS pDrvIns, TMCLOCK enmClock, PFNTMTIMERDRV pfnCallback, void *pvUser,
                                         uint32_t fFlags, const char *pszDesc, PPTMTIMERR3 ppTimer)
 {
-    AssertReturn(!(fFlags & ~(TMTIMER_FLAGS_NO_CRIT_SECT)), VERR_INVALID_PARAMETER);
+    AssertReturn(!(fFlags & ~(TMTIMER_FLAGS_NO_CRIT_SECT | TMTIMER_FLAGS_TIMER_THREAD)), VERR_INVALID_PARAMETER);
 
     /*
      * Allocate and init stuff.
      */
-    int rc = tmr3TimerCreate(pVM, enmClock, pszDesc, ppTimer);
+    int rc = tmr3TimerCreate(pVM, enmClock, fFlags, pszDesc, ppTimer);
     if (RT_SUCCESS(rc))
     {
         (*ppTimer)->enmType         = TMTIMERTYPE_DRV;
@@ -1589,17 +1658,22 @@ VMM_INT_DECL(int) TMR3TimerCreateDriver(PVM pVM, PPDMDRVINS pDrvIns, TMCLOCK enm
  * @param   enmClock        The clock to use on this timer.
  * @param   pfnCallback     Callback function.
  * @param   pvUser          User argument to be passed to the callback.
+ * @param   fFlags          Timer creation flags, see grp_tm_timer_flags.
+ *                          TMTIMER_FLAGS_NO_CRIT_SECT is implied.
  * @param   pszDesc         Pointer to description string which must stay around
  *                          until the timer is fully destroyed (i.e. a bit after TMTimerDestroy()).
  * @param   ppTimer         Where to store the timer on success.
  */
-VMMR3DECL(int) TMR3TimerCreateInternal(PVM pVM, TMCLOCK enmClock, PFNTMTIMERINT pfnCallback, void *pvUser, const char *pszDesc, PPTMTIMERR3 ppTimer)
+VMMR3DECL(int) TMR3TimerCreateInternal(PVM pVM, TMCLOCK enmClock, PFNTMTIMERINT pfnCallback, void *pvUser,
+                                       uint32_t fFlags, const char *pszDesc, PPTMTIMERR3 ppTimer)
 {
+    AssertReturn(!(fFlags & ~(TMTIMER_FLAGS_NO_CRIT_SECT | TMTIMER_FLAGS_TIMER_THREAD)), VERR_INVALID_PARAMETER);
+
     /*
      * Allocate and init  stuff.
      */
     PTMTIMER pTimer;
-    int rc = tmr3TimerCreate(pVM, enmClock, pszDesc, &pTimer);
+    int rc = tmr3TimerCreate(pVM, enmClock, fFlags, pszDesc, &pTimer);
     if (RT_SUCCESS(rc))
     {
         pTimer->enmType             = TMTIMERTYPE_INTERNAL;
@@ -1630,7 +1704,7 @@ VMMR3DECL(PTMTIMERR3) TMR3TimerCreateExternal(PVM pVM, TMCLOCK enmClock, PFNTMTI
      * Allocate and init stuff.
      */
     PTMTIMERR3 pTimer;
-    int rc = tmr3TimerCreate(pVM, enmClock, pszDesc, &pTimer);
+    int rc = tmr3TimerCreate(pVM, enmClock, 0 /*fFlags*/, pszDesc, &pTimer);
     if (RT_SUCCESS(rc))
     {
         pTimer->enmType             = TMTIMERTYPE_EXTERNAL;
@@ -1661,7 +1735,7 @@ VMMR3DECL(int) TMR3TimerDestroy(PTMTIMER pTimer)
     Assert((unsigned)pTimer->enmClock < (unsigned)TMCLOCK_MAX);
 
     PVM             pVM      = pTimer->CTX_SUFF(pVM);
-    PTMTIMERQUEUE   pQueue   = &pVM->tm.s.CTX_SUFF(paTimerQueues)[pTimer->enmClock];
+    PTMTIMERQUEUE   pQueue   = &pVM->tm.s.CTX_SUFF(paTimerQueues)[pTimer->idxQueue];
     bool            fActive  = false;
     bool            fPending = false;
 
@@ -1748,24 +1822,10 @@ VMMR3DECL(int) TMR3TimerDestroy(PTMTIMER pTimer)
     }
 
     /*
-     * Unlink from the active list.
+     * Unlink from the active heap.
      */
     if (fActive)
-    {
-        const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
-        const PTMTIMER pNext = TMTIMER_GET_NEXT(pTimer);
-        if (pPrev)
-            TMTIMER_SET_NEXT(pPrev, pNext);
-        else
-        {
-            TMTIMER_SET_HEAD(pQueue, pNext);
-            pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
-        }
-        if (pNext)
-            TMTIMER_SET_PREV(pNext, pPrev);
-        pTimer->offNext = 0;
-        pTimer->offPrev = 0;
-    }
+        tmTimerHeapRemove(pQueue, pTimer);
 
     /*
      * Unlink from the schedule list by running it.
@@ -1782,7 +1842,7 @@ VMMR3DECL(int) TMR3TimerDestroy(PTMTIMER pTimer)
     /*
      * Read to move the timer from the created list and onto the free list.
      */
-    Assert(!pTimer->offNext); Assert(!pTimer->offPrev); Assert(!pTimer->offScheduleNext);
+    Assert(!pTimer->offNext); Assert(!pTimer->offPrev); Assert(!pTimer->offChild); Assert(!pTimer->offScheduleNext);
 
     /* unlink from created list */
     if (pTimer->pBigPrev)
@@ -2031,6 +2091,8 @@ static DECLCALLBACK(void) tmR3TimerCallback(PRTTIMER pTimer, void *pvUser, uint6
  * @param   pVM             The cross context VM structure.
  *
  * @thread  EMT (actually EMT0, but we fend off the others)
+ *
+ * @remarks The timer thread queues are not run here, see tmR3TimerThread.
  */
 VMMR3DECL(void) TMR3TimerQueuesDo(PVM pVM)
 {
@@ -2047,6 +2109,12 @@ VMMR3DECL(void) TMR3TimerQueuesDo(PVM pVM)
     }
     STAM_PROFILE_START(&pVM->tm.s.StatDoQueues, a);
     Log2(("TMR3TimerQueuesDo:\n"));
+
+    /* Pass on wake-ups raw-mode context code couldn't deliver to the timer thread. */
+    if (   pVM->tm.s.fTimerThread
+        && ASMAtomicXchgBool(&pVM->tm.s.fTimerThreadKick, false))
+        tmTimerThreadNotify(pVM);
+
     Assert(!pVM->tm.s.fRunningQueues);
     ASMAtomicWriteBool(&pVM->tm.s.fRunningQueues, true);
     TM_LOCK_TIMERS(pVM);
@@ -2100,6 +2168,123 @@ VMMR3DECL(void) TMR3TimerQueuesDo(PVM pVM)
     STAM_PROFILE_STOP(&pVM->tm.s.StatDoQueues, a);
 }
 
+
+/**
+ * Calculates how long the timer thread can sleep before the next of its
+ * timers expire.
+ *
+ * @returns Nanoseconds, UINT64_MAX if there is nothing to wait for, 0 if there
+ *          is work to be done right away.
+ * @param   pVM             The cross context VM structure.
+ */
+static uint64_t tmR3TimerThreadCalcSleep(PVM pVM)
+{
+    uint64_t cNsSleep = UINT64_MAX;
+
+    /* The virtual clock doesn't move while the VM is suspended. */
+    PTMTIMERQUEUE pQueue = &pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_VIRTUAL];
+    if (pQueue->offSchedule)
+        return 0;
+    uint64_t u64Expire = ASMAtomicReadU64(&pQueue->u64Expire);
+    if (   u64Expire != INT64_MAX
+        && ASMAtomicReadU32(&pVM->tm.s.cVirtualTicking))
+    {
+        uint64_t const u64Now = TMVirtualGetNoCheck(pVM);
+        if (u64Expire <= u64Now)
+            return 0;
+        cNsSleep = TMVirtualToNano(pVM, u64Expire - u64Now);
+    }
+
+    pQueue = &pVM->tm.s.paTimerQueuesR3[TMTIMERQUEUE_THREAD_REAL];
+    if (pQueue->offSchedule)
+        return 0;
+    u64Expire = ASMAtomicReadU64(&pQueue->u64Expire);
+    if (u64Expire != INT64_MAX)
+    {
+        uint64_t const u64Now = TMRealGet(pVM);
+        if (u64Expire <= u64Now)
+            return 0;
+        AssertCompile(TMCLOCK_FREQ_REAL == 1000);
+        cNsSleep = RT_MIN(cNsSleep, (u64Expire - u64Now) * RT_NS_1MS_64);
+    }
+
+    return cNsSleep;
+}
+
+
+/**
+ * The timer thread, runs the timers created with TMTIMER_FLAGS_TIMER_THREAD.
+ *
+ * This takes the TMCLOCK_VIRTUAL and TMCLOCK_REAL timers which don't need an
+ * EMT off the timer EMT, so the guest doesn't have to leave execution just
+ * to run device housekeeping timers.  The thread sleeps until the next of its
+ * timers expire, tmTimerThreadNotify wakes it up when that changes.
+ *
+ * The thread only runs timers while the virtual clock is ticking and checks
+ * this while owning the timer lock.  Every EMT stops the clock in
+ * TMR3NotifySuspend, taking the timer lock, before the VM gets suspended,
+ * saved or powered off.  So when the last EMT has left TMR3NotifySuspend no
+ * timer thread callback is executing and none will be started until
+ * TMR3NotifyResume restarts the clock and wakes us up again.
+ *
+ * @returns VINF_SUCCESS.
+ * @param   hThreadSelf     The thread handle.
+ * @param   pvUser          Pointer to the VM.
+ */
+static DECLCALLBACK(int) tmR3TimerThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PVM pVM = (PVM)pvUser;
+    NOREF(hThreadSelf);
+
+    while (!ASMAtomicReadBool(&pVM->tm.s.fTimerThreadTerminate))
+    {
+        /*
+         * Only run timers while the clock is ticking, see above.
+         */
+        TM_LOCK_TIMERS(pVM);
+        if (ASMAtomicReadU32(&pVM->tm.s.cVirtualTicking))
+        {
+            STAM_COUNTER_INC(&pVM->tm.s.StatTimerThreadRuns);
+            for (unsigned iQueue = TMTIMERQUEUE_THREAD_VIRTUAL; iQueue <= TMTIMERQUEUE_THREAD_REAL; iQueue++)
+            {
+                PTMTIMERQUEUE pQueue = &pVM->tm.s.paTimerQueuesR3[iQueue];
+                if (pQueue->offSchedule)
+                    tmTimerQueueSchedule(pVM, pQueue);
+                tmR3TimerQueueRun(pVM, pQueue);
+            }
+#ifdef VBOX_STRICT
+            tmTimerQueuesSanityChecks(pVM, "tmR3TimerThread");
+#endif
+        }
+        TM_UNLOCK_TIMERS(pVM);
+
+        /*
+         * Announce that we're going to sleep before checking the queues and
+         * the clock, so changes made after the check will signal us.  While
+         * the clock is stopped we wait for TMR3NotifyResume.
+         */
+        ASMAtomicWriteBool(&pVM->tm.s.fTimerThreadWaiting, true);
+        uint64_t cNsSleep;
+        if (ASMAtomicReadU32(&pVM->tm.s.cVirtualTicking))
+            cNsSleep = tmR3TimerThreadCalcSleep(pVM);
+        else
+            cNsSleep = UINT64_MAX;
+        if (   cNsSleep
+            && !ASMAtomicReadBool(&pVM->tm.s.fTimerThreadTerminate))
+        {
+            int rc;
+            if (cNsSleep == UINT64_MAX)
+                rc = SUPSemEventWaitNoResume(pVM->pSession, pVM->tm.s.hTimerThreadEvt, RT_INDEFINITE_WAIT);
+            else
+                rc = SUPSemEventWaitNsRelIntr(pVM->pSession, pVM->tm.s.hTimerThreadEvt, cNsSleep);
+            AssertMsg(RT_SUCCESS(rc) || rc == VERR_TIMEOUT || rc == VERR_INTERRUPTED, ("%Rrc\n", rc));
+        }
+        ASMAtomicWriteBool(&pVM->tm.s.fTimerThreadWaiting, false);
+    }
+
+    return VINF_SUCCESS;
+}
+
 //RT_C_DECLS_BEGIN
 //int     iomLock(PVM pVM);
 //void    iomUnlock(PVM pVM);
@@ -2116,7 +2301,7 @@ VMMR3DECL(void) TMR3TimerQueuesDo(PVM pVM)
  */
 static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
 {
-    VM_ASSERT_EMT(pVM);
+    Assert(pQueue->fTimerThread ? RTThreadSelf() == pVM->tm.s.hTimerThread : VM_IS_EMT(pVM));
 
     /*
      * Run timers.
@@ -2129,15 +2314,18 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
      *      However, we only allow EMT to handle EXPIRED_PENDING
      *      timers, thus enabling the timer handler function to
      *      arm the timer again.
+     *
+     *      The heap root is re-read after each timer since the handlers
+     *      may link timers directly into the heap.  Should the root be
+     *      busy being changed by another thread, the schedule list is
+     *      processed to get it out of the way.
      */
-    PTMTIMER pNext = TMTIMER_GET_HEAD(pQueue);
-    if (!pNext)
+    PTMTIMER pTimer = TMTIMER_GET_HEAD(pQueue);
+    if (!pTimer)
         return;
     const uint64_t u64Now = tmClock(pVM, pQueue->enmClock);
-    while (pNext && pNext->u64Expire <= u64Now)
+    while (pTimer && pTimer->u64Expire <= u64Now)
     {
-        PTMTIMER        pTimer    = pNext;
-        pNext = TMTIMER_GET_NEXT(pTimer);
         PPDMCRITSECT    pCritSect = pTimer->pCritSect;
         if (pCritSect)
             PDMCritSectEnter(pCritSect, VERR_IGNORED);
@@ -2145,23 +2333,13 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
               pTimer, tmTimerState(pTimer->enmState), pTimer->enmClock, pTimer->enmType, pTimer->u64Expire, u64Now, pTimer->pszDesc));
         bool fRc;
         TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_GET_UNLINK, TMTIMERSTATE_ACTIVE, fRc);
+        bool const fFired = fRc;
         if (fRc)
         {
             Assert(!pTimer->offScheduleNext); /* this can trigger falsely */
 
             /* unlink */
-            const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
-            if (pPrev)
-                TMTIMER_SET_NEXT(pPrev, pNext);
-            else
-            {
-                TMTIMER_SET_HEAD(pQueue, pNext);
-                pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
-            }
-            if (pNext)
-                TMTIMER_SET_PREV(pNext, pPrev);
-            pTimer->offNext = 0;
-            pTimer->offPrev = 0;
+            tmTimerHeapRemove(pQueue, pTimer);
 
             /* fire */
             TM_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_DELIVER);
@@ -2183,6 +2361,14 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
         }
         if (pCritSect)
             PDMCritSectLeave(pCritSect);
+
+        /* next */
+        PTMTIMER const pPrevRoot = pTimer;
+        if (!fFired && pQueue->offSchedule)
+            tmTimerQueueSchedule(pVM, pQueue);
+        pTimer = TMTIMER_GET_HEAD(pQueue);
+        if (!fFired && pTimer == pPrevRoot)
+            break;
     } /* run loop */
 }
 
@@ -2322,7 +2508,6 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
     {
         /* Advance */
         PTMTIMER pTimer = pNext;
-        pNext = TMTIMER_GET_NEXT(pTimer);
 
         /* Take the associated lock. */
         PPDMCRITSECT pCritSect = pTimer->pCritSect;
@@ -2371,6 +2556,9 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
         /* Leave the associated lock. */
         if (pCritSect)
             PDMCritSectLeave(pCritSect);
+
+        /* The handler may have linked timers directly into the heap. */
+        pNext = TMTIMER_GET_HEAD(pQueue);
     } /* run loop */
 
 
@@ -2849,6 +3037,10 @@ VMMR3DECL(int) TMR3NotifyResume(PVM pVM, PVMCPU pVCpu)
     rc = tmVirtualResumeLocked(pVM);
     TM_UNLOCK_TIMERS(pVM);
 
+    /* The timer thread doesn't run any timers while the clock is stopped. */
+    if (pVM->tm.s.fTimerThread)
+        tmTimerThreadNotify(pVM);
+
     return rc;
 }
 
@@ -3354,11 +3546,12 @@ static DECLCALLBACK(void) tmR3TimerInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char
     NOREF(pszArgs);
     pHlp->pfnPrintf(pHlp,
                     "Timers (pVM=%p)\n"
-                    "%.*s %.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
+                    "%.*s %.*s %.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
                     pVM,
                     sizeof(RTR3PTR) * 2,        "pTimerR3        ",
                     sizeof(int32_t) * 2,        "offNext         ",
                     sizeof(int32_t) * 2,        "offPrev         ",
+                    sizeof(int32_t) * 2,        "offChild        ",
                     sizeof(int32_t) * 2,        "offSched        ",
                                                 "Time",
                                                 "Expire",
@@ -3368,10 +3561,11 @@ static DECLCALLBACK(void) tmR3TimerInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char
     for (PTMTIMERR3 pTimer = pVM->tm.s.pCreated; pTimer; pTimer = pTimer->pBigNext)
     {
         pHlp->pfnPrintf(pHlp,
-                        "%p %08RX32 %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
+                        "%p %08RX32 %08RX32 %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
                         pTimer,
                         pTimer->offNext,
                         pTimer->offPrev,
+                        pTimer->offChild,
                         pTimer->offScheduleNext,
                         tmR3Get5CharClockName(pTimer->enmClock),
                         TMTimerGet(pTimer),
@@ -3387,6 +3581,9 @@ static DECLCALLBACK(void) tmR3TimerInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char
 /**
  * Display all active timers.
  *
+ * The timers of each queue are listed in heap order, only the first one is
+ * guaranteed to be the next to expire.
+ *
  * @param   pVM         The cross context VM structure.
  * @param   pHlp        The info helpers.
  * @param   pszArgs     Arguments, ignored.
@@ -3396,28 +3593,30 @@ static DECLCALLBACK(void) tmR3TimerInfoActive(PVM pVM, PCDBGFINFOHLP pHlp, const
     NOREF(pszArgs);
     pHlp->pfnPrintf(pHlp,
                     "Active Timers (pVM=%p)\n"
-                    "%.*s %.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
+                    "%.*s %.*s %.*s %.*s %.*s Clock %18s %18s %6s %-25s Description\n",
                     pVM,
                     sizeof(RTR3PTR) * 2,        "pTimerR3        ",
                     sizeof(int32_t) * 2,        "offNext         ",
                     sizeof(int32_t) * 2,        "offPrev         ",
+                    sizeof(int32_t) * 2,        "offChild        ",
                     sizeof(int32_t) * 2,        "offSched        ",
                                                 "Time",
                                                 "Expire",
                                                 "HzHint",
                                                 "State");
-    for (unsigned iQueue = 0; iQueue < TMCLOCK_MAX; iQueue++)
+    for (unsigned iQueue = 0; iQueue < TMTIMERQUEUE_COUNT; iQueue++)
     {
         TM_LOCK_TIMERS(pVM);
         for (PTMTIMERR3 pTimer = TMTIMER_GET_HEAD(&pVM->tm.s.paTimerQueuesR3[iQueue]);
              pTimer;
-             pTimer = TMTIMER_GET_NEXT(pTimer))
+             pTimer = tmTimerHeapWalkNext(pTimer))
         {
             pHlp->pfnPrintf(pHlp,
-                            "%p %08RX32 %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
+                            "%p %08RX32 %08RX32 %08RX32 %08RX32 %s %18RU64 %18RU64 %6RU32 %-25s %s\n",
                             pTimer,
                             pTimer->offNext,
                             pTimer->offPrev,
+                            pTimer->offChild,
                             pTimer->offScheduleNext,
                             tmR3Get5CharClockName(pTimer->enmClock),
                             TMTimerGet(pTimer),
@@ -911,6 +911,14 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
         AssertRC(rc);
         rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltTimers,          STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_NS_PER_CALL, "Profiling halted state timer tasks.", "/PROF/CPU%d/VM/Halt/Timers", idCpu);
         AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPolling,         STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Time spent polling before blocking.", "/PROF/CPU%d/VM/Halt/Polling", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollHits,        STAMTYPE_COUNTER, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,  "Times polling caught the wake-up.",  "/PROF/CPU%d/VM/Halt/PollHits", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollMisses,      STAMTYPE_COUNTER, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,  "Times polling ended without a wake-up.", "/PROF/CPU%d/VM/Halt/PollMisses", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.cNsPollWindow,           STAMTYPE_U32,     STAMVISIBILITY_USED,   STAMUNIT_NS,          "The current adaptive poll window.",  "/PROF/CPU%d/VM/Halt/PollWindow", idCpu);
+        AssertRC(rc);
     }
 
     STAM_REG(pVM, &pUVM->vm.s.StatReqAllocNew,   STAMTYPE_COUNTER,     "/VM/Req/AllocNew",       STAMUNIT_OCCURENCES,        "Number of VMR3ReqAlloc returning a new packet.");
@@ -1014,6 +1022,7 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
                                                                                 rc = vmR3InitDoCompleted(pVM, VMINITCOMPLETED_RING3);
                                                                             if (RT_SUCCESS(rc))
                                                                             {
+                                                                                STAMR3ExportStart(pUVM); /* optional, failure isn't fatal */
                                                                                 LogFlow(("vmR3InitRing3: returns %Rrc\n", VINF_SUCCESS));
                                                                                 return VINF_SUCCESS;
                                                                             }
@@ -2458,8 +2467,10 @@ DECLCALLBACK(int) vmR3Destroy(PVM pVM)
     if (pVCpu->idCpu == 0)
     {
         /*
-         * Dump statistics to the log.
+         * Stop the statistics export before anything goes away, then dump
+         * statistics to the log.
          */
+        STAMR3ExportStop(pUVM);
 #if defined(VBOX_WITH_STATISTICS) || defined(LOG_ENABLED)
         RTLogFlags(NULL, "nodisabled nobuffered");
 #endif
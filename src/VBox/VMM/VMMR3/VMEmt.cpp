@@ -287,6 +287,7 @@ static const char *vmR3GetHaltMethodName(VMHALTMETHOD enmMethod)
         case VMHALTMETHOD_1:            return "method1";
         //case VMHALTMETHOD_2:            return "method2";
         case VMHALTMETHOD_GLOBAL_1:     return "global1";
+        case VMHALTMETHOD_GLOBAL_POLL:  return "globalpoll";
         default:                        return "unknown";
     }
 }
@@ -834,6 +835,245 @@ static DECLCALLBACK(void) vmR3HaltGlobal1NotifyCpuFF(PUVMCPU pUVCpu, uint32_t fF
 }
 
 
+/**
+ * Initialize the global poll halt method.
+ *
+ * @return VBox status code.
+ * @param   pUVM            Pointer to the user mode VM structure.
+ */
+static DECLCALLBACK(int) vmR3HaltGlobalPollInit(PUVM pUVM)
+{
+    /*
+     * The defaults.  Same spin/block threshold as global 1, the poll window
+     * starts at 10us when growing from nothing and is capped at 200us.
+     */
+    uint32_t cNsResolution = SUPSemEventMultiGetResolution(pUVM->vm.s.pSession);
+    if (cNsResolution > 5*RT_NS_100US)
+        pUVM->vm.s.Halt.GlobalPoll.cNsSpinBlockThresholdCfg = 50000;
+    else if (cNsResolution > RT_NS_100US)
+        pUVM->vm.s.Halt.GlobalPoll.cNsSpinBlockThresholdCfg = cNsResolution / 4;
+    else
+        pUVM->vm.s.Halt.GlobalPoll.cNsSpinBlockThresholdCfg = 2000;
+    pUVM->vm.s.Halt.GlobalPoll.cNsPollMaxCfg   = 200000;
+    pUVM->vm.s.Halt.GlobalPoll.cNsPollStartCfg = 10000;
+    pUVM->vm.s.Halt.GlobalPoll.cPollGrowCfg    = 2;
+    pUVM->vm.s.Halt.GlobalPoll.cPollShrinkCfg  = 2;
+
+    /*
+     * Query overrides.
+     */
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetRoot(pUVM->pVM), "/VMM/HaltedGlobalPoll");
+    if (pCfg)
+    {
+        uint32_t u32;
+        /** @cfgm{/VMM/HaltedGlobalPoll/SpinBlockThreshold, uint32_t, ns}
+         * Remaining time to the next timer event below which we spin rather
+         * than poll and block. */
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "SpinBlockThreshold", &u32)))
+            pUVM->vm.s.Halt.GlobalPoll.cNsSpinBlockThresholdCfg = u32;
+        /** @cfgm{/VMM/HaltedGlobalPoll/PollMax, uint32_t, ns, 0, 10000000, 200000}
+         * The max poll window.  Zero disables polling, making this method
+         * behave like global 1. */
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollMax", &u32)))
+            pUVM->vm.s.Halt.GlobalPoll.cNsPollMaxCfg = RT_MIN(u32, 10000000);
+        /** @cfgm{/VMM/HaltedGlobalPoll/PollStart, uint32_t, ns, 1, PollMax, 10000}
+         * The poll window to use when growing it from zero. */
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollStart", &u32)) && u32 > 0)
+            pUVM->vm.s.Halt.GlobalPoll.cNsPollStartCfg = u32;
+        /** @cfgm{/VMM/HaltedGlobalPoll/PollGrow, uint32_t, factor, 2, 16, 2}
+         * What to multiply the poll window by when the EMT was woken up shortly
+         * after it blocked. */
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollGrow", &u32)))
+            pUVM->vm.s.Halt.GlobalPoll.cPollGrowCfg = RT_MIN(RT_MAX(u32, 2), 16);
+        /** @cfgm{/VMM/HaltedGlobalPoll/PollShrink, uint32_t, divisor, 0, 16, 2}
+         * What to divide the poll window by when the EMT blocked for longer
+         * than PollMax.  Zero resets the window. */
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollShrink", &u32)))
+            pUVM->vm.s.Halt.GlobalPoll.cPollShrinkCfg = RT_MIN(u32, 16);
+    }
+    pUVM->vm.s.Halt.GlobalPoll.cNsPollStartCfg = RT_MIN(pUVM->vm.s.Halt.GlobalPoll.cNsPollStartCfg,
+                                                        pUVM->vm.s.Halt.GlobalPoll.cNsPollMaxCfg);
+    for (VMCPUID idCpu = 0; idCpu < pUVM->cCpus; idCpu++)
+        pUVM->aCpus[idCpu].vm.s.cNsPollWindow = 0;
+
+    LogRel(("VMEmt: HaltedGlobalPoll config: cNsSpinBlockThresholdCfg=%u cNsPollMaxCfg=%u cNsPollStartCfg=%u cPollGrowCfg=%u cPollShrinkCfg=%u\n",
+            pUVM->vm.s.Halt.GlobalPoll.cNsSpinBlockThresholdCfg,
+            pUVM->vm.s.Halt.GlobalPoll.cNsPollMaxCfg,
+            pUVM->vm.s.Halt.GlobalPoll.cNsPollStartCfg,
+            pUVM->vm.s.Halt.GlobalPoll.cPollGrowCfg,
+            pUVM->vm.s.Halt.GlobalPoll.cPollShrinkCfg));
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Adjusts the poll window of an EMT after a halt.
+ *
+ * This works like the KVM halt_poll_ns logic: a short block means a larger
+ * window would have caught the wake-up without a trip thru the scheduler, so
+ * grow it; a block longer than the max window means polling is wasted time
+ * for this workload, so shrink it.
+ *
+ * @param   pUVCpu          Pointer to the user mode VMCPU structure.
+ * @param   cNsBlocked      How long the EMT was blocked in ring-0, 0 if it
+ *                          didn't block.
+ */
+static void vmR3HaltGlobalPollAdjust(PUVMCPU pUVCpu, uint64_t cNsBlocked)
+{
+    PUVM     pUVM      = pUVCpu->pUVM;
+    uint32_t cNsWindow = pUVCpu->vm.s.cNsPollWindow;
+    if (cNsBlocked > pUVM->vm.s.Halt.GlobalPoll.cNsPollMaxCfg)
+    {
+        if (cNsWindow)
+        {
+            uint32_t const cShrink = pUVM->vm.s.Halt.GlobalPoll.cPollShrinkCfg;
+            cNsWindow = cShrink ? cNsWindow / cShrink : 0;
+        }
+    }
+    else if (   cNsBlocked
+             && cNsWindow < pUVM->vm.s.Halt.GlobalPoll.cNsPollMaxCfg)
+    {
+        if (cNsWindow)
+            cNsWindow = (uint32_t)RT_MIN((uint64_t)cNsWindow * pUVM->vm.s.Halt.GlobalPoll.cPollGrowCfg,
+                                         pUVM->vm.s.Halt.GlobalPoll.cNsPollMaxCfg);
+        else
+            cNsWindow = pUVM->vm.s.Halt.GlobalPoll.cNsPollStartCfg;
+    }
+    pUVCpu->vm.s.cNsPollWindow = cNsWindow;
+}
+
+
+/**
+ * The global poll halt method - Like global 1, except that the EMT polls the
+ * force action flags for a per-CPU adaptive window before blocking in GVMM.
+ */
+static DECLCALLBACK(int) vmR3HaltGlobalPollHalt(PUVMCPU pUVCpu, const uint32_t fMask, uint64_t u64Now)
+{
+    PUVM    pUVM  = pUVCpu->pUVM;
+    PVMCPU  pVCpu = pUVCpu->pVCpu;
+    PVM     pVM   = pUVCpu->pVM;
+    Assert(VMMGetCpu(pVM) == pVCpu);
+    NOREF(u64Now);
+
+    /*
+     * Halt loop.
+     */
+    int      rc         = VINF_SUCCESS;
+    bool     fPolled    = false;
+    uint64_t cNsBlocked = 0;
+    ASMAtomicWriteBool(&pUVCpu->vm.s.fWait, true);
+    unsigned cLoops = 0;
+    for (;; cLoops++)
+    {
+        /*
+         * Work the timers and check if we can exit.
+         */
+        uint64_t const u64StartTimers   = RTTimeNanoTS();
+        TMR3TimerQueuesDo(pVM);
+        uint64_t const cNsElapsedTimers = RTTimeNanoTS() - u64StartTimers;
+        STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltTimers, cNsElapsedTimers);
+        if (    VM_FF_IS_PENDING(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+            ||  VMCPU_FF_IS_PENDING(pVCpu, fMask))
+            break;
+
+        /*
+         * Estimate time left to the next event.
+         */
+        uint64_t u64Delta;
+        uint64_t u64GipTime = TMTimerPollGIP(pVM, pVCpu, &u64Delta);
+        if (    VM_FF_IS_PENDING(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+            ||  VMCPU_FF_IS_PENDING(pVCpu, fMask))
+            break;
+
+        if (u64Delta >= pUVM->vm.s.Halt.GlobalPoll.cNsSpinBlockThresholdCfg)
+        {
+            /*
+             * Poll once per halt before blocking, but never beyond the next
+             * timer event.  fWait is cleared while polling so that whoever
+             * sets a FF doesn't bother ring-0 with a wake-up; it is set again
+             * before the FFs are rechecked at the top of the loop.
+             */
+            uint32_t const cNsWindow = pUVCpu->vm.s.cNsPollWindow;
+            if (!fPolled && cNsWindow)
+            {
+                fPolled = true;
+                ASMAtomicWriteBool(&pUVCpu->vm.s.fWait, false);
+                uint64_t const u64StartPoll = RTTimeNanoTS();
+                uint64_t const u64EndPoll   = u64StartPoll + RT_MIN(cNsWindow, u64Delta);
+                bool           fHit         = false;
+                do
+                {
+                    ASMNopPause();
+                    if (    VM_FF_IS_PENDING(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+                        ||  VMCPU_FF_IS_PENDING(pVCpu, fMask))
+                    {
+                        fHit = true;
+                        break;
+                    }
+                } while (RTTimeNanoTS() < u64EndPoll);
+                STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPolling, RTTimeNanoTS() - u64StartPoll);
+                if (fHit)
+                {
+                    STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollHits);
+                    break;
+                }
+                STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollMisses);
+                ASMAtomicWriteBool(&pUVCpu->vm.s.fWait, true);
+                continue;
+            }
+
+            /*
+             * Block.
+             */
+            VMMR3YieldStop(pVM);
+            if (    VM_FF_IS_PENDING(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+                ||  VMCPU_FF_IS_PENDING(pVCpu, fMask))
+                break;
+
+            uint64_t const u64StartSchedHalt   = RTTimeNanoTS();
+            rc = SUPR3CallVMMR0Ex(pVM->pVMR0, pVCpu->idCpu, VMMR0_DO_GVMM_SCHED_HALT, u64GipTime, NULL);
+            uint64_t const u64EndSchedHalt     = RTTimeNanoTS();
+            uint64_t const cNsElapsedSchedHalt = u64EndSchedHalt - u64StartSchedHalt;
+            STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltBlock, cNsElapsedSchedHalt);
+            cNsBlocked += cNsElapsedSchedHalt;
+
+            if (rc == VERR_INTERRUPTED)
+                rc = VINF_SUCCESS;
+            else if (RT_FAILURE(rc))
+            {
+                rc = vmR3FatalWaitError(pUVCpu, "vmR3HaltGlobalPollHalt: VMMR0_DO_GVMM_SCHED_HALT->%Rrc\n", rc);
+                break;
+            }
+            else
+            {
+                int64_t const cNsOverslept = u64EndSchedHalt - u64GipTime;
+                if (cNsOverslept > 50000)
+                    STAM_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltBlockOverslept, cNsOverslept);
+                else if (cNsOverslept < -50000)
+                    STAM_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltBlockInsomnia,  cNsElapsedSchedHalt);
+                else
+                    STAM_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltBlockOnTime,    cNsElapsedSchedHalt);
+            }
+        }
+        /*
+         * When spinning call upon the GVMM and do some wakups once
+         * in a while, it's not like we're actually busy or anything.
+         */
+        else if (!(cLoops & 0x1fff))
+        {
+            uint64_t const u64StartSchedYield   = RTTimeNanoTS();
+            rc = SUPR3CallVMMR0Ex(pVM->pVMR0, pVCpu->idCpu, VMMR0_DO_GVMM_SCHED_POLL, false /* don't yield */, NULL);
+            uint64_t const cNsElapsedSchedYield = RTTimeNanoTS() - u64StartSchedYield;
+            STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltYield, cNsElapsedSchedYield);
+        }
+    }
+
+    ASMAtomicUoWriteBool(&pUVCpu->vm.s.fWait, false);
+    vmR3HaltGlobalPollAdjust(pUVCpu, cNsBlocked);
+    return rc;
+}
+
+
 /**
  * Bootstrap VMR3Wait() worker.
  *
@@ -993,6 +1233,7 @@ static const struct VMHALTMETHODDESC
     { VMHALTMETHOD_OLD,       NULL,                NULL,   vmR3HaltOldDoHalt,   vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
     { VMHALTMETHOD_1,         vmR3HaltMethod1Init, NULL,   vmR3HaltMethod1Halt, vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
     { VMHALTMETHOD_GLOBAL_1,  vmR3HaltGlobal1Init, NULL,   vmR3HaltGlobal1Halt, vmR3HaltGlobal1Wait, vmR3HaltGlobal1NotifyCpuFF, NULL },
+    { VMHALTMETHOD_GLOBAL_POLL, vmR3HaltGlobalPollInit, NULL, vmR3HaltGlobalPollHalt, vmR3HaltGlobal1Wait, vmR3HaltGlobal1NotifyCpuFF, NULL },
 };
 
 
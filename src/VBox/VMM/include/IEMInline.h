@@ -0,0 +1,125 @@
+/* $Id$ */
+/** @file
+ * IEM - Common Inlined functions.
+ */
+
+/*
+ * Copyright (C) 2011-2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#ifndef ___IEMInline_h
+#define ___IEMInline_h
+
+#include <iprt/asm.h>
+
+
+/**
+ * Looks up a guest virtual address in a TLB.
+ *
+ * @returns The TLB entry for @a GCPtr.  It's a hit if its uTag equals *puTag,
+ *          otherwise it's the entry to load.
+ * @param   pTlb        The TLB.
+ * @param   GCPtr       The guest virtual address.
+ * @param   puTag       Where to return the tag for @a GCPtr.
+ */
+DECL_FORCE_INLINE(PIEMTLBENTRY) iemTlbLookup(PIEMTLB pTlb, RTGCPTR GCPtr, uint64_t *puTag)
+{
+    uint64_t const uTag = IEMTLB_CALC_TAG(pTlb, GCPtr);
+    *puTag = uTag;
+    return IEMTLB_TAG_TO_ENTRY(pTlb, uTag);
+}
+
+
+/**
+ * Checks whether the physical page side of a TLB entry is current.
+ *
+ * @returns true if the IEMTLBE_F_PG_XXX flags, IEMTLBE_F_NO_MAPPINGR3 and
+ *          pbMappingR3 of the entry can be used, false if they must be
+ *          reloaded from PGM.
+ * @param   pTlb        The TLB the entry belongs to.
+ * @param   pTlbe       The TLB entry.
+ */
+DECL_FORCE_INLINE(bool) iemTlbIsPhysInfoCurrent(IEMTLB const *pTlb, IEMTLBENTRY const *pTlbe)
+{
+    return (pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PHYS_REV) == pTlb->uTlbPhysRev;
+}
+
+
+/**
+ * Invalidates all entries of a TLB by bumping its revision.
+ *
+ * Zeros all the tags when the revision wraps around.
+ *
+ * @param   pTlb        The TLB.
+ */
+DECLINLINE(void) iemTlbInvalidateAllWorker(PIEMTLB pTlb)
+{
+    pTlb->uTlbRevision += IEMTLB_REVISION_INCR;
+    if (pTlb->uTlbRevision != 0)
+    { /* very likely */ }
+    else
+    {
+        pTlb->uTlbRevision = IEMTLB_REVISION_INCR;
+        unsigned i = RT_ELEMENTS(pTlb->aEntries);
+        while (i-- > 0)
+            pTlb->aEntries[i].uTag = 0;
+    }
+}
+
+
+/**
+ * Invalidates the TLB entry for a page, if present.
+ *
+ * @returns true if the page was in the TLB, false if not.
+ * @param   pTlb        The TLB.
+ * @param   uTagNoRev   The tag of the page without revision
+ *                      (IEMTLB_CALC_TAG_NO_REV).
+ */
+DECLINLINE(bool) iemTlbInvalidatePageWorker(PIEMTLB pTlb, uint64_t uTagNoRev)
+{
+    PIEMTLBENTRY pTlbe = &pTlb->aEntries[(uint8_t)uTagNoRev];
+    if (pTlbe->uTag == (uTagNoRev | pTlb->uTlbRevision))
+    {
+        pTlbe->uTag = 0;
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * Invalidates the physical page side of all entries in a TLB owned by the
+ * calling EMT.
+ *
+ * The guest page table side of the entries stays valid.  When the physical
+ * revision wraps around, the physical page info of all entries is cleared.
+ *
+ * @param   pTlb        The TLB.
+ * @param   uTlbPhysRev The new physical revision, zero if it wrapped around.
+ */
+DECLINLINE(void) iemTlbInvalidateAllPhysicalWorker(PIEMTLB pTlb, uint64_t uTlbPhysRev)
+{
+    if (uTlbPhysRev != 0)
+        ASMAtomicWriteU64(&pTlb->uTlbPhysRev, uTlbPhysRev);
+    else
+    {
+        ASMAtomicWriteU64(&pTlb->uTlbPhysRev, IEMTLB_PHYS_REV_INCR);
+        unsigned i = RT_ELEMENTS(pTlb->aEntries);
+        while (i-- > 0)
+        {
+            pTlb->aEntries[i].pbMappingR3       = NULL;
+            pTlb->aEntries[i].fFlagsAndPhysRev &= ~(  IEMTLBE_F_PG_NO_WRITE | IEMTLBE_F_PG_NO_READ
+                                                    | IEMTLBE_F_NO_MAPPINGR3 | IEMTLBE_F_PHYS_REV);
+        }
+    }
+}
+
+#endif
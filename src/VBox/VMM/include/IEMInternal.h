@@ -64,7 +64,25 @@ RT_C_DECLS_BEGIN
 #endif
 
 
-//#define IEM_WITH_CODE_TLB// - work in progress
+/** @def IEM_WITH_CODE_TLB
+ * Enables decoding straight out of the code TLB page mappings (pbInstrBuf)
+ * instead of prefetching the opcode bytes into abOpcode.
+ *
+ * This is still work in progress.  The code TLB itself is always used for
+ * translating CS:rIP when prefetching opcodes.
+ */
+//#define IEM_WITH_CODE_TLB
+
+/** @def IEM_WITH_DATA_TLB
+ * Enables the data TLB.
+ *
+ * This caches the guest page walk for memory operands and, in ring-3, lets
+ * reads of plain RAM pages go straight thru the ring-3 mapping without taking
+ * a PGM page mapping lock.
+ */
+#if !defined(IEM_WITHOUT_DATA_TLB) || defined(DOXYGEN_RUNNING)
+# define IEM_WITH_DATA_TLB
+#endif
 
 
 #if !defined(IN_TSTVMSTRUCT) && !defined(DOXYGEN_RUNNING)
@@ -387,7 +405,8 @@ typedef struct IEMTLB
     uint64_t            cTlbHits;
     /** TLB misses. */
     uint32_t            cTlbMisses;
-    /** Slow read path.  */
+    /** Slow read path, i.e. the page could not be read directly thru
+     * IEMTLBENTRY::pbMappingR3.  */
     uint32_t            cTlbSlowReadPath;
 #if 0
     /** TLB misses because of tag mismatch. */
@@ -407,10 +426,159 @@ typedef struct IEMTLB
     uint32_t            au32Padding[3+5];
 } IEMTLB;
 AssertCompileSizeAlignment(IEMTLB, 64);
+/** Pointer to an IEM TLB. */
+typedef IEMTLB *PIEMTLB;
 /** IEMTLB::uTlbRevision increment.  */
 #define IEMTLB_REVISION_INCR    RT_BIT_64(36)
 /** IEMTLB::uTlbPhysRev increment.  */
 #define IEMTLB_PHYS_REV_INCR    RT_BIT_64(8)
+/**
+ * Calculates the TLB tag for a virtual address but without TLB revision.
+ *
+ * The top 16 bits are shifted out first so that the sign extension of
+ * canonical kernel addresses cannot bleed into the revision bits.
+ *
+ * @returns Tag value for indexing and comparing with IEMTLB::uTag.
+ * @param   a_GCPtr     The virtual address.
+ */
+#define IEMTLB_CALC_TAG_NO_REV(a_GCPtr)     ( ((uint64_t)(a_GCPtr) << 16) >> (X86_PAGE_SHIFT + 16) )
+/**
+ * Calculates the TLB tag for a virtual address.
+ *
+ * @returns Tag value for indexing and comparing with IEMTLB::uTag.
+ * @param   a_pTlb      The TLB.
+ * @param   a_GCPtr     The virtual address.
+ */
+#define IEMTLB_CALC_TAG(a_pTlb, a_GCPtr)    ( IEMTLB_CALC_TAG_NO_REV(a_GCPtr) | (a_pTlb)->uTlbRevision )
+/**
+ * Converts a TLB tag value into a TLB entry pointer.
+ *
+ * @returns Pointer to the TLB entry.
+ * @param   a_pTlb      The TLB.
+ * @param   a_uTag      Value returned by IEMTLB_CALC_TAG.
+ */
+#define IEMTLB_TAG_TO_ENTRY(a_pTlb, a_uTag) ( &(a_pTlb)->aEntries[(uint8_t)(a_uTag)] )
+
+
+/**
+ * The decoder state after the prefixes of an instruction, as recorded by the
+ * decoded instruction cache.
+ */
+typedef struct IEMDECODEDSTATE
+{
+    /** The prefix mask (IEM_OP_PRF_XXX). */
+    uint32_t            fPrefixes;
+    /** The CPU mode the instruction was decoded in (IEMMODE). */
+    uint8_t             enmCpuMode;
+    /** The effective operand size (IEMMODE). */
+    uint8_t             enmEffOpSize;
+    /** The effective address mode (IEMMODE). */
+    uint8_t             enmEffAddrMode;
+    /** The effective segment register (X86_SREG_XXX). */
+    uint8_t             iEffSeg;
+    /** The extra REX ModR/M register field bit. */
+    uint8_t             uRexReg;
+    /** The extra REX ModR/M r/m field, SIB base and opcode reg bit. */
+    uint8_t             uRexB;
+    /** The extra REX SIB index field bit. */
+    uint8_t             uRexIndex;
+    /** The prefix index for the two byte opcode table. */
+    uint8_t             idxPrefix;
+    /** The VEX 3rd register. */
+    uint8_t             uVex3rdReg;
+    /** The VEX vector length. */
+    uint8_t             uVexLength;
+    /** Additional EVEX stuff. */
+    uint8_t             fEvexStuff;
+    /** The offset of the byte following the opcode byte, i.e. where the opcode
+     * handler picks up decoding. */
+    uint8_t             offOpcode;
+} IEMDECODEDSTATE;
+AssertCompileSize(IEMDECODEDSTATE, 16);
+/** Pointer to a recorded decoder state. */
+typedef IEMDECODEDSTATE *PIEMDECODEDSTATE;
+/** Pointer to a const recorded decoder state. */
+typedef IEMDECODEDSTATE const *PCIEMDECODEDSTATE;
+
+
+/**
+ * A decoded instruction cache entry.
+ */
+typedef struct IEMDECODEDINSTR
+{
+    /** The guest physical address of the first instruction byte. */
+    RTGCPHYS            GCPhys;
+    /** The code TLB physical revision at the time of recording. */
+    uint64_t            uTlbPhysRev;
+    /** The cache generation, the entry is stale if it doesn't match
+     * IEMDECODEDCACHE::uGeneration. */
+    uint32_t            uGeneration;
+    /** The instruction length. */
+    uint8_t             cbInstr;
+    /** Alignment padding. */
+    uint8_t             abPadding[3];
+    /** The decoder state after the prefixes. */
+    IEMDECODEDSTATE     State;
+    /** The instruction bytes. */
+    uint8_t             abOpcode[16];
+    /** Alignment padding. */
+    uint64_t            u64Padding;
+} IEMDECODEDINSTR;
+AssertCompileSize(IEMDECODEDINSTR, 64);
+/** Pointer to a decoded instruction cache entry. */
+typedef IEMDECODEDINSTR *PIEMDECODEDINSTR;
+/** Pointer to a const decoded instruction cache entry. */
+typedef IEMDECODEDINSTR const *PCIEMDECODEDINSTR;
+
+/** The number of entries in the decoded instruction cache (power of two). */
+#define IEMDECODEDCACHE_ENTRIES     128
+
+/**
+ * The decoded instruction cache.
+ *
+ * This caches the instruction bytes, length and post-prefix decoder state of
+ * instructions executed by IEMExecLots, keyed by guest physical address and
+ * CPU mode, so that loops can be replayed without fetching and re-decoding
+ * the prefixes.  Sequentially executed entries make up a block.
+ *
+ * Since the guest may modify its code behind IEM's back (other CPUs, DMA,
+ * native execution), a hit is only taken when the instruction bytes still
+ * match guest memory, which is read directly thru the code TLB mapping.  IEM's
+ * own writes to pages with cached code on them flush the cache (generation
+ * bump) right away.
+ *
+ * Only the bookkeeping lives here, the IEMDECODEDCACHE_ENTRIES entries are
+ * allocated from the ring-3 heap (IEMCPU::paDecodedCacheR3), and only when the
+ * cache is enabled, so the VMCPU structure doesn't grow by 8KB.
+ */
+typedef struct IEMDECODEDCACHE
+{
+    /** The current generation. */
+    uint32_t            uGeneration;
+    /** Number of instructions replayed from the cache. */
+    uint32_t            cHits;
+    /** Number of instructions that had to be decoded. */
+    uint32_t            cMisses;
+    /** Number of flushes caused by writes to cached code pages. */
+    uint32_t            cWriteFlushes;
+    /** Bitmap of the cached code pages, indexed by bits 17:12 of the guest
+     * physical address. */
+    uint64_t            bmCodePages;
+    /** The guest physical address of the instruction being recorded,
+     * NIL_RTGCPHYS if not recording. */
+    RTGCPHYS            GCPhysRecording;
+    /** The code TLB physical revision for GCPhysRecording. */
+    uint64_t            uTlbPhysRevRecording;
+    /** The decoder state noted at the opcode byte of the current instruction. */
+    IEMDECODEDSTATE     Pending;
+    /** Number of entries found stale because the code was modified. */
+    uint32_t            cModified;
+    /** Alignment padding. */
+    uint32_t            u32Padding;
+} IEMDECODEDCACHE;
+AssertCompileSize(IEMDECODEDCACHE, 64);
+/** Pointer to the decoded instruction cache. */
+typedef IEMDECODEDCACHE *PIEMDECODEDCACHE;
 
 
 /**
@@ -687,7 +855,11 @@ typedef struct IEMCPU
     CPUMCPUVENDOR           enmHostCpuVendor;
     /** @} */
 
-    uint32_t                au32Alignment8[HC_ARCH_BITS == 64 ? 1 + 2 + 4 + 8 : 1 + 2 + 4]; /**< Alignment padding. */
+    /** The HMGetNestedPagingWorldSwitchExits value when the TLBs were last
+     * flushed, see iemTlbSyncWithHm. */
+    uint32_t                cHmWorldSwitchExitsTlb;
+
+    uint32_t                au32Alignment8[HC_ARCH_BITS == 64 ? 2 + 4 + 8 : 2 + 4]; /**< Alignment padding. */
 
     /** Data TLB.
      * @remarks Must be 64-byte aligned. */
@@ -695,6 +867,9 @@ typedef struct IEMCPU
     /** Instruction TLB.
      * @remarks Must be 64-byte aligned. */
     IEMTLB                  CodeTlb;
+    /** Decoded instruction cache bookkeeping.
+     * @remarks Must be 64-byte aligned. */
+    IEMDECODEDCACHE         DecodedCache;
 
     /** Pointer to the CPU context - ring-3 context.
      * @todo put inside IEM_VERIFICATION_MODE_FULL++. */
@@ -712,6 +887,9 @@ typedef struct IEMCPU
     R3PTRTYPE(PIEMINSTRSTATS) pStatsCCR3;
     /** Pointer to instruction statistics for ring-3 context. */
     R3PTRTYPE(PIEMINSTRSTATS) pStatsR3;
+    /** The decoded instruction cache entries (IEMDECODEDCACHE_ENTRIES), ring-3
+     * only.  NULL if the cache is disabled. */
+    R3PTRTYPE(PIEMDECODEDINSTR) paDecodedCacheR3;
 
 #ifdef IEM_VERIFICATION_MODE_FULL
     /** The event verification records for what IEM did (LIFO). */
@@ -729,6 +907,7 @@ typedef struct IEMCPU
 AssertCompileMemberOffset(IEMCPU, fCurXcpt, 0x48);
 AssertCompileMemberAlignment(IEMCPU, DataTlb, 64);
 AssertCompileMemberAlignment(IEMCPU, CodeTlb, 64);
+AssertCompileMemberAlignment(IEMCPU, DecodedCache, 64);
 /** Pointer to the per-CPU IEM state. */
 typedef IEMCPU *PIEMCPU;
 /** Pointer to the const per-CPU IEM state. */
@@ -786,8 +965,10 @@ typedef IEMCPU const *PCIEMCPU;
 #define IEM_ACCESS_PENDING_R3_WRITE_1ST UINT32_C(0x00000400)
 /** Bounce buffer with ring-3 write pending, second page. */
 #define IEM_ACCESS_PENDING_R3_WRITE_2ND UINT32_C(0x00000800)
+/** Not locked, accessed via the TLB. */
+#define IEM_ACCESS_NOT_LOCKED           UINT32_C(0x00001000)
 /** Valid bit mask. */
-#define IEM_ACCESS_VALID_MASK           UINT32_C(0x00000fff)
+#define IEM_ACCESS_VALID_MASK           UINT32_C(0x00001fff)
 /** Read+write data alias. */
 #define IEM_ACCESS_DATA_RW              (IEM_ACCESS_TYPE_READ  | IEM_ACCESS_TYPE_WRITE | IEM_ACCESS_WHAT_DATA)
 /** Write data alias. */
@@ -258,6 +258,8 @@ typedef struct PDMBLKCACHE
     STAMCOUNTER                   StatWriteDeferred;
     /** Number appended cache entries. */
     STAMCOUNTER                   StatAppendedWrites;
+    /** Latency of the requests from submission to completion. */
+    STAMHISTOGRAM                 StatReqLatency;
 #endif
 
     /** Flag whether the cache was suspended. */
@@ -279,6 +281,10 @@ typedef struct PDMBLKCACHEREQ
     volatile uint32_t cXfersPending;
     /** Status code. */
     volatile int      rcReq;
+#ifdef VBOX_WITH_STATISTICS
+    /** Nanosecond timestamp of when the request was submitted. */
+    uint64_t          tsStart;
+#endif
 } PDMBLKCACHEREQ, *PPDMBLKCACHEREQ;
 
 /**
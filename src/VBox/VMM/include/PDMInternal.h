@@ -290,8 +290,11 @@ typedef struct PDMCRITSECTINT
     /** Set if the critical section is used by a timer or similar.
      * See PDMR3DevGetCritSect.  */
     bool                            fUsedByTimerOrSimilar;
-    /** Alignment padding. */
-    bool                            afPadding[2];
+    /** Running average of the number of spins it took to get the section when
+     * it was busy, scaled by PDMCRITSECT_SPIN_AVG_SCALE.  Decays when spinning
+     * fails.  This determines the spin budget of the next contended enter and
+     * is updated without serialization, it's just a heuristic. */
+    uint16_t volatile               uSpinAvg;
     /** Support driver event semaphore that is scheduled to be signaled upon leaving
      * the critical section. This is only for Ring-3 and Ring-0. */
     SUPSEMEVENT                     hEventToSignal;
@@ -314,6 +317,59 @@ typedef PDMCRITSECTINT *PPDMCRITSECTINT;
  * PDMCritSectIsOwner and PDMCritSectIsOwned optimizations. */
 #define PDMCRITSECT_FLAGS_PENDING_UNLOCK    RT_BIT_32(17)
 
+/** The fixed point scale of PDMCRITSECTINT::uSpinAvg. */
+#define PDMCRITSECT_SPIN_AVG_SCALE          8
+/** The minimum spin budget (unless spinning is disabled). */
+#define PDMCRITSECT_SPIN_MIN                16
+/** The initial PDMCRITSECTINT::uSpinAvg value, giving a budget of 256 spins
+ * (the old fixed ring-0 count) until the section has some history. */
+#define PDMCRITSECT_SPIN_AVG_INIT           (120 * PDMCRITSECT_SPIN_AVG_SCALE)
+
+
+/** The number of top waiters tracked by PDMCRITSECTSTATS. */
+#define PDMCRITSECTSTATS_TOP_WAITERS        4
+
+/**
+ * Contention statistics for a critical section (/PDM/CritSect/Stats).
+ *
+ * These are collected in ring-3 only and live in the ring-3 heap, they're
+ * found via PDMUSERPERVM::papCritSectStats.
+ */
+typedef struct PDMCRITSECTSTATS
+{
+    /** The critical section, NULL if it has been deleted. */
+    PPDMCRITSECTINT volatile        pCritSect;
+    /** Number of contended enters where spinning got us the section. */
+    STAMCOUNTER                     StatSpinHits;
+    /** Number of contended enters where spinning failed and we had to wait. */
+    STAMCOUNTER                     StatSpinMisses;
+    /** Histogram of the time spent waiting on the semaphore (ns). */
+    STAMHISTOGRAM                   WaitHistogram;
+    /** The threads which spent the most time waiting for the section.
+     * Updated by the waiter after it got the section, so the section itself
+     * serializes the updates.  A new thread replaces the entry with the least
+     * time and inherits its counts (space-saving), so the numbers are upper
+     * bounds for threads which weren't there from the start. */
+    struct
+    {
+        /** The native thread handle. */
+        RTNATIVETHREAD              hNativeThread;
+        /** The number of waits, zero if the entry is unused. */
+        uint64_t                    cWaits;
+        /** The total time waited (ns). */
+        uint64_t                    cNsWaited;
+        /** The thread name. */
+        char                        szName[16];
+    }                               aTopWaiters[PDMCRITSECTSTATS_TOP_WAITERS];
+} PDMCRITSECTSTATS;
+/** Pointer to critical section contention statistics. */
+typedef PDMCRITSECTSTATS *PPDMCRITSECTSTATS;
+
+/** The log2 size of the PDMUSERPERVM::papCritSectStats hash table. */
+#define PDMCRITSECTSTATS_HASH_SHIFT         10
+/** The size of the PDMUSERPERVM::papCritSectStats hash table. */
+#define PDMCRITSECTSTATS_HASH_SIZE          RT_BIT_32(PDMCRITSECTSTATS_HASH_SHIFT)
+
 
 /**
  * Private critical section data.
@@ -1078,8 +1134,13 @@ typedef struct PDM
 
     /** Pending reset flags (PDMVMRESET_F_XXX). */
     uint32_t volatile               fResetFlags;
-    /** Alignment padding. */
-    uint32_t volatile               u32Padding;
+    /** The max number of spins for a contended critical section enter in
+     * ring-3, zero to block right away (/PDM/CritSect/SpinMaxR3). */
+    uint16_t                        cCritSectSpinMaxR3;
+    /** The max number of spins for a contended critical section enter in
+     * ring-0 and raw-mode context, zero to go to ring-3 right away
+     * (/PDM/CritSect/SpinMaxRZ). */
+    uint16_t                        cCritSectSpinMaxRZ;
 
     /** The tracing ID of the next device instance.
      *
@@ -1140,6 +1201,11 @@ typedef struct PDMUSERPERVM
     R3PTRTYPE(PPDMCRITSECTINT)      pCritSects;
     /** List of initialized read/write critical sections. (LIFO) */
     R3PTRTYPE(PPDMCRITSECTRWINT)    pRwCritSects;
+    /** Open addressing hash table (PDMCRITSECTSTATS_HASH_SIZE entries) with
+     * the contention statistics of the critical sections, keyed by address.
+     * NULL if the statistics are disabled.  Entries are only added or
+     * replaced (under ListCritSect), so lookups need no locking. */
+    R3PTRTYPE(PPDMCRITSECTSTATS volatile *) papCritSectStats;
     /** Head of the PDM Thread list. (singly linked) */
     R3PTRTYPE(PPDMTHREAD)           pThreads;
     /** Tail of the PDM Thread list. (singly linked) */
@@ -1223,6 +1289,8 @@ extern const PDMPCIRAWHLPR3 g_pdmR3DevPciRawHlp;
 bool        pdmR3IsValidName(const char *pszName);
 
 int         pdmR3CritSectBothInitStats(PVM pVM);
+void        pdmR3CritSectStatsSpin(PPDMCRITSECTINT pCritSect, bool fHit);
+void        pdmR3CritSectStatsWait(PPDMCRITSECTINT pCritSect, uint64_t cNsWaited);
 void        pdmR3CritSectBothRelocate(PVM pVM);
 int         pdmR3CritSectBothDeleteDevice(PVM pVM, PPDMDEVINS pDevIns);
 int         pdmR3CritSectBothDeleteDriver(PVM pVM, PPDMDRVINS pDrvIns);
@@ -1676,15 +1676,14 @@ typedef struct PGMLIVESAVEMMIO2PAGE
     bool        fZero;
     /** Alignment padding. */
     bool        fReserved;
-    /** CRC-32 for the first half of the page.
-     * This is used together with u32CrcH2 to quickly detect changes in the page
-     * during the non-final passes. */
-    uint32_t    u32CrcH1;
-    /** CRC-32 for the second half of the page. */
-    uint32_t    u32CrcH2;
-    /** SHA-1 for the saved page.
+    /** Alignment padding. */
+    uint32_t    u32Reserved;
+    /** Hash of the page at the last scan.
+     * This is used to quickly detect changes in the page. */
+    RTUINT128U  uHash;
+    /** Hash of the saved page.
      * This is used in the final pass to skip pages without changes. */
-    uint8_t     abSha1Saved[RTSHA1_HASH_SIZE];
+    RTUINT128U  uHashSaved;
 } PGMLIVESAVEMMIO2PAGE;
 /** Pointer to a live save status data for an MMIO2 page. */
 typedef PGMLIVESAVEMMIO2PAGE *PPGMLIVESAVEMMIO2PAGE;
@@ -3600,7 +3599,17 @@ typedef struct PGM
         uint64_t                    uSaveStartNS;
         /** Pages per second (for statistics). */
         uint32_t                    cPagesPerSecond;
-        uint32_t                    cAlignment;
+        /** The number of RAM and MMIO2 pages scanned in the last pass (for
+         * statistics). */
+        uint32_t                    cScannedPagesPass;
+        /** The number of RAM and MMIO2 pages found dirty in the last pass (for
+         * statistics). */
+        uint32_t                    cDirtiedPagesPass;
+        /** The number of pages saved in the last pass (for statistics). */
+        uint32_t                    cSavedPagesPass;
+        /** Worker threads for scanning MMIO2 pages, NULL if scanning on the
+         * calling thread. */
+        R3PTRTYPE(struct RTREQPOOLINT *) hScanPoolR3;
     } LiveSave;
 
     /** @name   Error injection.
@@ -96,6 +96,8 @@ typedef struct STAMDESC
         PSTAMPROFILE    pProfile;
         /** Advanced profile. */
         PSTAMPROFILEADV pProfileAdv;
+        /** Histogram. */
+        PSTAMHISTOGRAM  pHistogram;
         /** Ratio, unsigned 32-bit. */
         PSTAMRATIOU32   pRatioU32;
         /** unsigned 8-bit. */
@@ -146,10 +148,14 @@ typedef struct STAMUSERPERVM
     /** The number of registered host CPU leaves. */
     uint32_t                cRegisteredHostCpus;
 
-    /** Explicit alignment padding. */
-    uint32_t                uAlignment;
+    /** The layout generation, incremented whenever a sample is registered or
+     * deregistered.  Protected by RWSem. */
+    uint32_t                uGeneration;
     /** The copy of the GMM statistics. */
     GMMSTATS                GMMStats;
+
+    /** The shared memory export instance, NULL if not configured. */
+    struct STAMEXPORT      *pExport;
 } STAMUSERPERVM;
 #ifdef IN_RING3
 AssertCompileMemberAlignment(STAMUSERPERVM, GMMStats, 8);
@@ -170,6 +176,10 @@ typedef STAMUSERPERVM *PSTAMUSERPERVM;
 /** Lazy initialization */
 #define STAM_LAZY_INIT(pUVM)    do { } while (0)
 
+#ifdef IN_RING3
+void    stamR3Ring0StatsUpdateU(PUVM pUVM, const char *pszPat);
+#endif
+
 /** @} */
 
 RT_C_DECLS_END
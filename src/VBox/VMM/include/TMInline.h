@@ -20,10 +20,206 @@
 
 
 /**
- * Used to unlink a timer from the active list.
+ * Melds two active timer heaps.
+ *
+ * The root with the later heap expire time becomes the first child of the
+ * other one.  On a tie the first root stays on top.
+ *
+ * @returns The root of the combined heap.
+ * @param   pRoot1      The root of the first heap.  No siblings or parent.
+ * @param   pRoot2      The root of the second heap.  No siblings or parent.
+ */
+DECL_FORCE_INLINE(PTMTIMER) tmTimerHeapMeld(PTMTIMER pRoot1, PTMTIMER pRoot2)
+{
+    Assert(!pRoot1->offNext && !pRoot1->offPrev);
+    Assert(!pRoot2->offNext && !pRoot2->offPrev);
+    if (pRoot2->u64HeapExpire < pRoot1->u64HeapExpire)
+    {
+        PTMTIMER const pTmp = pRoot1;
+        pRoot1 = pRoot2;
+        pRoot2 = pTmp;
+    }
+
+    PTMTIMER const pChild = TMTIMER_GET_CHILD(pRoot1);
+    if (pChild)
+    {
+        TMTIMER_SET_NEXT(pRoot2, pChild);
+        TMTIMER_SET_PREV(pChild, pRoot2);
+    }
+    TMTIMER_SET_PREV(pRoot2, pRoot1);
+    TMTIMER_SET_CHILD(pRoot1, pRoot2);
+    return pRoot1;
+}
+
+
+/**
+ * Combines a list of sibling heaps into one using the two-pass pairing scheme.
+ *
+ * @returns The root of the combined heap, NULL if the list was empty.
+ * @param   pFirst      The first sibling in the list.  NULL is fine.
+ */
+DECLINLINE(PTMTIMER) tmTimerHeapMergePairs(PTMTIMER pFirst)
+{
+    if (!pFirst)
+        return NULL;
+
+    /* Pass 1: Meld pairs from left to right, chaining the results up in
+               reverse order using the sibling link. */
+    PTMTIMER pPairs = NULL;
+    while (pFirst)
+    {
+        PTMTIMER pTimer  = pFirst;
+        PTMTIMER pSecond = TMTIMER_GET_NEXT(pTimer);
+        pTimer->offNext = 0;
+        pTimer->offPrev = 0;
+        if (pSecond)
+        {
+            pFirst = TMTIMER_GET_NEXT(pSecond);
+            pSecond->offNext = 0;
+            pSecond->offPrev = 0;
+            pTimer = tmTimerHeapMeld(pTimer, pSecond);
+        }
+        else
+            pFirst = NULL;
+        TMTIMER_SET_NEXT(pTimer, pPairs);
+        pPairs = pTimer;
+    }
+
+    /* Pass 2: Meld the pairs from right to left. */
+    PTMTIMER pRoot = pPairs;
+    pPairs = TMTIMER_GET_NEXT(pRoot);
+    pRoot->offNext = 0;
+    while (pPairs)
+    {
+        PTMTIMER const pTimer = pPairs;
+        pPairs = TMTIMER_GET_NEXT(pTimer);
+        pTimer->offNext = 0;
+        pRoot = tmTimerHeapMeld(pRoot, pTimer);
+    }
+    return pRoot;
+}
+
+
+/**
+ * Inserts a timer into the active timer heap of a queue.
+ *
+ * The timer is ordered by the current u64Expire value, which is latched in
+ * u64HeapExpire till the timer is removed again.
+ *
+ * @returns true if the timer became the new root, false if not.
+ * @param   pQueue      The timer queue.
+ * @param   pTimer      The timer.  The expire time must be set.
+ *
+ * @remarks Called while owning the relevant queue lock.
+ */
+DECL_FORCE_INLINE(bool) tmTimerHeapInsert(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+{
+    Assert(!pTimer->offNext);
+    Assert(!pTimer->offPrev);
+    Assert(!pTimer->offChild);
+    pTimer->u64HeapExpire = pTimer->u64Expire;
+
+    PTMTIMER const pRoot = TMTIMER_GET_HEAD(pQueue);
+    if (pRoot && tmTimerHeapMeld(pRoot, pTimer) == pRoot)
+        return false;
+    TMTIMER_SET_HEAD(pQueue, pTimer);
+    ASMAtomicWriteU64(&pQueue->u64Expire, pTimer->u64HeapExpire);
+    return true;
+}
+
+
+/**
+ * Removes a timer from the active timer heap of a queue.
+ *
+ * This does not check the timer state, see tmTimerQueueUnlinkActive.
+ *
+ * @param   pQueue      The timer queue.
+ * @param   pTimer      The timer.
+ *
+ * @remarks Called while owning the relevant queue lock.
+ */
+DECL_FORCE_INLINE(void) tmTimerHeapRemove(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+{
+    PTMTIMER const pChildren = tmTimerHeapMergePairs(TMTIMER_GET_CHILD(pTimer));
+    pTimer->offChild = 0;
+
+    PTMTIMER const pPrev = TMTIMER_GET_PREV(pTimer);
+    if (!pPrev)
+    {
+        /* The root, the children take over. */
+        Assert(TMTIMER_GET_HEAD(pQueue) == pTimer);
+        Assert(!pTimer->offNext);
+        TMTIMER_SET_HEAD(pQueue, pChildren);
+        pQueue->u64Expire = pChildren ? pChildren->u64HeapExpire : INT64_MAX;
+    }
+    else
+    {
+        /* Cut the subtree loose and meld the children back in.  The heap
+           order says the root stays on top, but store whatever the meld
+           returns rather than relying on it. */
+        PTMTIMER const pNext = TMTIMER_GET_NEXT(pTimer);
+        if (TMTIMER_GET_CHILD(pPrev) == pTimer)
+            TMTIMER_SET_CHILD(pPrev, pNext);
+        else
+            TMTIMER_SET_NEXT(pPrev, pNext);
+        if (pNext)
+            TMTIMER_SET_PREV(pNext, pPrev);
+        pTimer->offNext = 0;
+        pTimer->offPrev = 0;
+
+        if (pChildren)
+        {
+            PTMTIMER const pRoot    = TMTIMER_GET_HEAD(pQueue);
+            PTMTIMER const pNewRoot = tmTimerHeapMeld(pRoot, pChildren);
+            Assert(pNewRoot == pRoot);
+            if (pNewRoot != pRoot)
+            {
+                TMTIMER_SET_HEAD(pQueue, pNewRoot);
+                pQueue->u64Expire = pNewRoot->u64HeapExpire;
+            }
+        }
+    }
+}
+
+
+/**
+ * Gets the next timer when walking the whole active timer heap.
+ *
+ * The timers are visited in heap order (pre-order), not expire order.
+ *
+ * @returns The next timer, NULL when done.
+ * @param   pTimer      The current timer.  Start with TMTIMER_GET_HEAD.
+ */
+DECLINLINE(PTMTIMER) tmTimerHeapWalkNext(PTMTIMER pTimer)
+{
+    PTMTIMER pNext = TMTIMER_GET_CHILD(pTimer);
+    if (pNext)
+        return pNext;
+    for (;;)
+    {
+        pNext = TMTIMER_GET_NEXT(pTimer);
+        if (pNext)
+            return pNext;
+
+        /* Go back to the first sibling, its previous link is the parent. */
+        PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
+        while (pPrev && TMTIMER_GET_CHILD(pPrev) != pTimer)
+        {
+            pTimer = pPrev;
+            pPrev  = TMTIMER_GET_PREV(pTimer);
+        }
+        if (!pPrev)
+            return NULL;
+        pTimer = pPrev;
+    }
+}
+
+
+/**
+ * Used to unlink a timer from the active heap.
  *
  * @param   pQueue      The timer queue.
- * @param   pTimer      The timer that needs linking.
+ * @param   pTimer      The timer that needs unlinking.
  *
  * @remarks Called while owning the relevant queue lock.
  */
@@ -36,20 +232,10 @@ DECL_FORCE_INLINE(void) tmTimerQueueUnlinkActive(PTMTIMERQUEUE pQueue, PTMTIMER
            : enmState == TMTIMERSTATE_PENDING_SCHEDULE || enmState == TMTIMERSTATE_PENDING_STOP_SCHEDULE);
 #endif
 
-    const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
-    const PTMTIMER pNext = TMTIMER_GET_NEXT(pTimer);
-    if (pPrev)
-        TMTIMER_SET_NEXT(pPrev, pNext);
-    else
-    {
-        TMTIMER_SET_HEAD(pQueue, pNext);
-        pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
+    bool const fRoot = !pTimer->offPrev;
+    tmTimerHeapRemove(pQueue, pTimer);
+    if (fRoot)
         DBGFTRACE_U64_TAG(pTimer->CTX_SUFF(pVM), pQueue->u64Expire, "tmTimerQueueUnlinkActive");
-    }
-    if (pNext)
-        TMTIMER_SET_PREV(pNext, pPrev);
-    pTimer->offNext = 0;
-    pTimer->offPrev = 0;
 }
 
 #endif
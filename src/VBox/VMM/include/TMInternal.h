@@ -120,6 +120,10 @@ typedef struct TMTIMER
 {
     /** Expire time. */
     volatile uint64_t       u64Expire;
+    /** The expire time the timer is ordered by in the active timer heap.
+     * TMTimerSet may change u64Expire of a linked timer before it gets
+     * rescheduled, so the heap must not look at that. */
+    uint64_t                u64HeapExpire;
     /** Clock to apply to u64Expire. */
     TMCLOCK                 enmClock;
     /** Timer callback type. */
@@ -174,10 +178,16 @@ typedef struct TMTIMER
     /** Timer relative offset to the next timer in the schedule list. */
     int32_t volatile        offScheduleNext;
 
-    /** Timer relative offset to the next timer in the chain. */
+    /** Timer relative offset to the next sibling in the active timer heap. */
     int32_t                 offNext;
-    /** Timer relative offset to the previous timer in the chain. */
+    /** Timer relative offset to the previous sibling in the active timer heap,
+     * or to the parent if this is the first child.  Zero for the root. */
     int32_t                 offPrev;
+    /** Timer relative offset to the first child in the active timer heap. */
+    int32_t                 offChild;
+    /** The index of the timer queue (TM::paTimerQueues) this timer lives in.
+     * This is the clock number unless the timer is run by the timer thread. */
+    uint32_t                idxQueue;
 
     /** Pointer to the VM the timer belongs to - R3 Ptr. */
     PVMR3                   pVMR3;
@@ -235,14 +245,18 @@ AssertCompileMemberSize(TMTIMER, enmState, sizeof(uint32_t));
     } while (0)
 #endif
 
-/** Get the previous timer. */
+/** Get the previous sibling or the parent timer. */
 #define TMTIMER_GET_PREV(pTimer) ((PTMTIMER)((pTimer)->offPrev ? (intptr_t)(pTimer) + (pTimer)->offPrev : 0))
-/** Get the next timer. */
+/** Get the next sibling timer. */
 #define TMTIMER_GET_NEXT(pTimer) ((PTMTIMER)((pTimer)->offNext ? (intptr_t)(pTimer) + (pTimer)->offNext : 0))
-/** Set the previous timer link. */
+/** Get the first child timer. */
+#define TMTIMER_GET_CHILD(pTimer) ((PTMTIMER)((pTimer)->offChild ? (intptr_t)(pTimer) + (pTimer)->offChild : 0))
+/** Set the previous sibling or parent timer link. */
 #define TMTIMER_SET_PREV(pTimer, pPrev) ((pTimer)->offPrev = (pPrev) ? (intptr_t)(pPrev) - (intptr_t)(pTimer) : 0)
-/** Set the next timer link. */
+/** Set the next sibling timer link. */
 #define TMTIMER_SET_NEXT(pTimer, pNext) ((pTimer)->offNext = (pNext) ? (intptr_t)(pNext) - (intptr_t)(pTimer) : 0)
+/** Set the first child timer link. */
+#define TMTIMER_SET_CHILD(pTimer, pChild) ((pTimer)->offChild = (pChild) ? (intptr_t)(pChild) - (intptr_t)(pTimer) : 0)
 
 
 /**
@@ -256,9 +270,11 @@ typedef struct TMTIMERQUEUE
      * Updated by EMT when scheduling the queue or modifying the head timer.
      * Assigned UINT64_MAX when there is no head timer. */
     uint64_t                u64Expire;
-    /** Doubly linked list of active timers.
+    /** The root of the pairing heap of active timers.
      *
-     * When no scheduling is pending, this list is will be ordered by expire time (ascending).
+     * When no scheduling is pending, this is the timer with the lowest expire
+     * time.  The heap is linked thru TMTIMER::offChild, TMTIMER::offNext and
+     * TMTIMER::offPrev, so it can be shared between all contexts.
      * Access is serialized by only letting the emulation thread (EMT) do changes.
      *
      * The offset is relative to the queue structure.
@@ -275,16 +291,32 @@ typedef struct TMTIMERQUEUE
     int32_t volatile        offSchedule;
     /** The clock for this queue. */
     TMCLOCK                 enmClock;
+    /** Set if the queue is run by the timer thread rather than an EMT. */
+    bool                    fTimerThread;
+    /** Alignment padding. */
+    bool                    afAlignment[3];
     /** Pad the structure up to 32 bytes. */
-    uint32_t                au32Padding[3];
+    uint32_t                au32Padding[2];
 } TMTIMERQUEUE;
 
 /** Pointer to a timer queue. */
 typedef TMTIMERQUEUE *PTMTIMERQUEUE;
 
-/** Get the head of the active timer list. */
+/** @name Timer queue indexes.
+ * The first TMCLOCK_MAX queues are indexed by clock and run by EMTs, the
+ * rest are only used when the timer thread is enabled.
+ * @{ */
+/** Queue for TMCLOCK_VIRTUAL timers run by the timer thread. */
+#define TMTIMERQUEUE_THREAD_VIRTUAL     (TMCLOCK_MAX)
+/** Queue for TMCLOCK_REAL timers run by the timer thread. */
+#define TMTIMERQUEUE_THREAD_REAL        (TMCLOCK_MAX + 1)
+/** The number of timer queues. */
+#define TMTIMERQUEUE_COUNT              (TMCLOCK_MAX + 2)
+/** @} */
+
+/** Get the root of the active timer heap, i.e. the first timer to expire. */
 #define TMTIMER_GET_HEAD(pQueue)        ((PTMTIMER)((pQueue)->offActive ? (intptr_t)(pQueue) + (pQueue)->offActive : 0))
-/** Set the head of the active timer list. */
+/** Set the root of the active timer heap. */
 #define TMTIMER_SET_HEAD(pQueue, pHead) ((pQueue)->offActive = pHead ? (intptr_t)pHead - (intptr_t)(pQueue) : 0)
 
 
@@ -530,6 +562,25 @@ typedef struct TM
     /** Alignment */
     bool                        afAlignment3[2];
 
+    /** @cfgm{/TM/TimerThread, bool, false}
+     * Whether to run timers created with TMTIMER_FLAGS_TIMER_THREAD on a
+     * dedicated thread instead of the timer EMT. */
+    bool                        fTimerThread;
+    /** Tells the timer thread to terminate. */
+    bool volatile               fTimerThreadTerminate;
+    /** Set while the timer thread is about to block or blocking on
+     * hTimerThreadEvt, i.e. when it needs signalling to notice changes. */
+    bool volatile               fTimerThreadWaiting;
+    /** Set by raw-mode context code that couldn't signal the timer thread
+     * itself; TMR3TimerQueuesDo passes it on. */
+    bool volatile               fTimerThreadKick;
+    /** Alignment */
+    bool                        afAlignment4[4];
+    /** The event semaphore the timer thread waits on. */
+    SUPSEMEVENT                 hTimerThreadEvt;
+    /** The timer thread. */
+    R3PTRTYPE(RTTHREAD)         hTimerThread;
+
     /** Lock serializing access to the timer lists. */
     PDMCRITSECT                 TimerCritSect;
     /** Lock serializing access to the VirtualSync clock and the associated
@@ -544,6 +595,11 @@ typedef struct TM
     STAMPROFILE                 StatDoQueues;
     STAMPROFILEADV              aStatDoQueues[TMCLOCK_MAX];
     /** @} */
+    /** Timer thread
+     * @{ */
+    STAMCOUNTER                 StatTimerThreadRuns;
+    STAMCOUNTER                 StatTimerThreadWakeups;
+    /** @} */
     /** tmSchedule
      * @{ */
     STAMPROFILE                 StatScheduleOneRZ;
@@ -748,12 +804,21 @@ typedef struct TMCPU
     /** CPU load state for this virtual CPU (tmR3CpuLoadTimer). */
     TMCPULOADSTATE              CpuLoad;
 #endif
+#ifdef VBOX_WITH_STATISTICS
+    /** TMTimerPoll calls made by this virtual CPU.
+     * @{ */
+    STAMCOUNTER                 StatPoll;
+    STAMCOUNTER                 StatPollHits;
+    STAMCOUNTER                 StatPollMiss;
+    /** @} */
+#endif
 } TMCPU;
 /** Pointer to TM VMCPU instance data. */
 typedef TMCPU *PTMCPU;
 
 const char             *tmTimerState(TMTIMERSTATE enmState);
 void                    tmTimerQueueSchedule(PVM pVM, PTMTIMERQUEUE pQueue);
+void                    tmTimerThreadNotify(PVM pVM);
 #ifdef VBOX_STRICT
 void                    tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere);
 #endif
@@ -141,6 +141,8 @@ typedef enum
     VMHALTMETHOD_1,
     /** The first go at a more global approach. */
     VMHALTMETHOD_GLOBAL_1,
+    /** The global approach with an adaptive poll window before blocking. */
+    VMHALTMETHOD_GLOBAL_POLL,
     /** The end of valid methods. (not inclusive of course) */
     VMHALTMETHOD_END,
     /** The usual 32-bit max value. */
@@ -300,6 +302,26 @@ typedef struct VMINTUSERPERVM
             /** The threshold between spinning and blocking. */
             uint32_t                cNsSpinBlockThresholdCfg;
         }                           Global1;
+
+       /**
+        * Like Global1, except that the EMT polls for a while before blocking
+        * in the GVMM.  The poll window is kept per virtual CPU, growing when
+        * the EMT is woken up shortly after it blocked and shrinking when it
+        * blocks for long.
+        */
+        struct
+        {
+            /** The threshold between spinning and blocking. */
+            uint32_t                cNsSpinBlockThresholdCfg;
+            /** The max poll window. */
+            uint32_t                cNsPollMaxCfg;
+            /** The poll window to start out with when growing from zero. */
+            uint32_t                cNsPollStartCfg;
+            /** The factor to grow the poll window by. */
+            uint32_t                cPollGrowCfg;
+            /** The divisor to shrink the poll window by, 0 to reset it. */
+            uint32_t                cPollShrinkCfg;
+        }                           GlobalPoll;
     }                               Halt;
 
     /** Pointer to the DBGC instance data. */
@@ -353,7 +375,8 @@ typedef struct VMINTUSERPERVMCPU
     uint32_t                        HaltFrequency;
     /** The number of halts in the current period. */
     uint32_t                        cHalts;
-    uint32_t                        padding; /**< alignment padding. */
+    /** The current poll window (ns), VMHALTMETHOD_GLOBAL_POLL only. */
+    uint32_t                        cNsPollWindow;
     /** When we started counting halts in cHalts (RTTimeNanoTS). */
     uint64_t                        u64HaltsStartTS;
     /** @} */
@@ -435,6 +458,9 @@ typedef struct VMINTUSERPERVMCPU
     STAMPROFILE                     StatHaltBlockOnTime;
     STAMPROFILE                     StatHaltTimers;
     STAMPROFILE                     StatHaltPoll;
+    STAMPROFILE                     StatHaltPolling;
+    STAMCOUNTER                     StatHaltPollHits;
+    STAMCOUNTER                     StatHaltPollMisses;
     /** @} */
 } VMINTUSERPERVMCPU;
 AssertCompileMemberAlignment(VMINTUSERPERVMCPU, u64HaltsStartTS, 8);
@@ -0,0 +1,361 @@
+/* $Id$ */
+/** @file
+ * IEM TLB Testcase - Lookup and invalidation checks, lookup vs. page walk benchmark.
+ *
+ * The TLB layout, lookup and invalidation code is IEM's own (IEMInternal.h and
+ * IEMInline.h).  The page walk is a simplified model of PGMGstGetPage, and the
+ * entries are loaded the way iemTlbLoadEntry does it.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define IN_TSTVMSTRUCT 1
+#include "../include/IEMInternal.h"
+#include <VBox/err.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+#include "../include/IEMInline.h"
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The test handle. */
+static RTTEST       g_hTest;
+/** The simulated guest PML4 table, the lower levels are allocated on demand. */
+static uint64_t    *g_paPml4;
+/** Number of simulated page walks done. */
+static uint64_t     g_cWalks;
+
+
+/**
+ * Maps a guest page in the simulated 4-level page tables.
+ *
+ * The tables are kept as host pointers in the entries to keep things simple.
+ */
+static void tstMapPage(RTGCPTR GCPtr, RTGCPHYS GCPhys, uint64_t fFlags)
+{
+    uint64_t *paTable = g_paPml4;
+    for (unsigned iLevel = 3; iLevel > 0; iLevel--)
+    {
+        unsigned const iEntry = (GCPtr >> (X86_PAGE_SHIFT + iLevel * 9)) & 511;
+        if (!paTable[iEntry])
+        {
+            uint64_t *paNew = (uint64_t *)RTMemAllocZ(512 * sizeof(uint64_t));
+            RTTESTI_CHECK_RETV(paNew);
+            paTable[iEntry] = (uintptr_t)paNew;
+        }
+        paTable = (uint64_t *)(uintptr_t)paTable[iEntry];
+    }
+    paTable[(GCPtr >> X86_PAGE_SHIFT) & 511] = (GCPhys & X86_PTE_PAE_PG_MASK) | fFlags | X86_PTE_P;
+}
+
+
+/**
+ * Frees the simulated page tables.
+ */
+static void tstFreeTables(uint64_t *paTable, unsigned iLevel)
+{
+    if (iLevel > 0)
+        for (unsigned i = 0; i < 512; i++)
+            if (paTable[i])
+                tstFreeTables((uint64_t *)(uintptr_t)paTable[i], iLevel - 1);
+    RTMemFree(paTable);
+}
+
+
+/**
+ * Walks the simulated page tables, the equivalent of PGMGstGetPage.
+ */
+static int tstWalk(RTGCPTR GCPtr, uint64_t *pfFlags, PRTGCPHYS pGCPhys)
+{
+    g_cWalks++;
+    uint64_t const *paTable = g_paPml4;
+    for (unsigned iLevel = 3; iLevel > 0; iLevel--)
+    {
+        uint64_t const uEntry = paTable[(GCPtr >> (X86_PAGE_SHIFT + iLevel * 9)) & 511];
+        if (!uEntry)
+            return VERR_PAGE_TABLE_NOT_PRESENT;
+        paTable = (uint64_t const *)(uintptr_t)uEntry;
+    }
+    uint64_t const uPte = paTable[(GCPtr >> X86_PAGE_SHIFT) & 511];
+    if (!(uPte & X86_PTE_P))
+        return VERR_PAGE_NOT_PRESENT;
+    *pfFlags = uPte & ~X86_PTE_PAE_PG_MASK;
+    *pGCPhys = uPte & X86_PTE_PAE_PG_MASK;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Translates an address thru the TLB, walking the page tables on a miss.
+ *
+ * This is the lookup in iemMemPageTranslateAndCheckAccess, without the access
+ * checks.  The physical side of loaded entries is made current right away
+ * instead of asking PGM.
+ */
+static int tstTlbTranslate(PIEMTLB pTlb, RTGCPTR GCPtr, PRTGCPHYS pGCPhys)
+{
+    uint64_t        uTag;
+    PIEMTLBENTRY    pTlbe = iemTlbLookup(pTlb, GCPtr, &uTag);
+    if (pTlbe->uTag == uTag)
+        pTlb->cTlbHits++;
+    else
+    {
+        pTlb->cTlbMisses++;
+        uint64_t fFlags;
+        RTGCPHYS GCPhys;
+        int rc = tstWalk(GCPtr, &fFlags, &GCPhys);
+        if (RT_FAILURE(rc))
+        {
+            pTlbe->uTag = 0;
+            return rc;
+        }
+        pTlbe->uTag             = uTag;
+        pTlbe->fFlagsAndPhysRev = (~fFlags & (X86_PTE_US | X86_PTE_RW | X86_PTE_D)) | (fFlags >> X86_PTE_PAE_BIT_NX)
+                                | pTlb->uTlbPhysRev;
+        pTlbe->GCPhys           = GCPhys;
+    }
+    *pGCPhys = pTlbe->GCPhys | (GCPtr & X86_PAGE_OFFSET_MASK);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Checks the tag calculation and revision handling.
+ */
+static void tstTags(PIEMTLB pTlb)
+{
+    RTTestSub(g_hTest, "Tags");
+
+    /* The revision bits must never be touched by the address part of the tag,
+       not even for canonical kernel addresses. */
+    static RTGCPTR const s_aAddrs[] =
+    {
+        0, X86_PAGE_SIZE, UINT64_C(0x00007ffffffff000), UINT64_C(0xffff800000000000),
+        UINT64_C(0xffffffff80001000), UINT64_C(0xfffffffffffff000), UINT32_C(0xfffff000),
+    };
+    pTlb->uTlbRevision = UINT64_C(0) - IEMTLB_REVISION_INCR * 3;
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aAddrs); i++)
+    {
+        uint64_t const uTagNoRev = IEMTLB_CALC_TAG_NO_REV(s_aAddrs[i]);
+        uint64_t const uTag      = IEMTLB_CALC_TAG(pTlb, s_aAddrs[i]);
+        RTTESTI_CHECK_MSG(uTagNoRev < IEMTLB_REVISION_INCR, ("%RX64 -> %RX64\n", s_aAddrs[i], uTagNoRev));
+        RTTESTI_CHECK_MSG((uTag & ~(IEMTLB_REVISION_INCR - 1)) == pTlb->uTlbRevision, ("%RX64 -> %RX64\n", s_aAddrs[i], uTag));
+        RTTESTI_CHECK_MSG(IEMTLB_CALC_TAG(pTlb, s_aAddrs[i] | X86_PAGE_OFFSET_MASK) == uTag, ("%RX64\n", s_aAddrs[i]));
+        for (unsigned j = 0; j < i; j++)
+            RTTESTI_CHECK_MSG(IEMTLB_CALC_TAG_NO_REV(s_aAddrs[j]) != uTagNoRev, ("%RX64 vs %RX64\n", s_aAddrs[j], s_aAddrs[i]));
+    }
+
+    /* Invalidating everything must make all existing entries miss, also when
+       the revision wraps around (it skips zero and zaps the tags then). */
+    RTGCPTR const GCPtr = UINT64_C(0xffffffff80123000);
+    for (unsigned i = 0; i < 6; i++)
+    {
+        uint64_t        uTag;
+        PIEMTLBENTRY    pTlbe = iemTlbLookup(pTlb, GCPtr, &uTag);
+        pTlbe->uTag = uTag;
+
+        iemTlbInvalidateAllWorker(pTlb);
+        RTTESTI_CHECK(pTlb->uTlbRevision != 0);
+        uint64_t        uTagNew;
+        RTTESTI_CHECK(iemTlbLookup(pTlb, GCPtr, &uTagNew) == pTlbe);
+        RTTESTI_CHECK(pTlbe->uTag != uTagNew);
+    }
+}
+
+
+/**
+ * Checks the single page and physical invalidation.
+ */
+static void tstInvalidation(PIEMTLB pTlb)
+{
+    RTTestSub(g_hTest, "Invalidation");
+
+    /* Two pages sharing a TLB entry (256 pages apart), one in each half of
+       the address space, plus some neighbours. */
+    static RTGCPTR const s_aPages[] =
+    {
+        UINT64_C(0x0000000000401000), UINT64_C(0x0000000000402000), UINT64_C(0x0000000000501000),
+        UINT64_C(0xffffffff80003000), UINT64_C(0xffffffff80004000),
+    };
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aPages); i++)
+        tstMapPage(s_aPages[i], (RTGCPHYS)(i + 0x100) * X86_PAGE_SIZE, X86_PTE_RW | X86_PTE_US | X86_PTE_A);
+
+    RT_ZERO(pTlb->aEntries);
+    pTlb->uTlbRevision = IEMTLB_REVISION_INCR;
+    pTlb->uTlbPhysRev  = IEMTLB_PHYS_REV_INCR;
+    pTlb->cTlbHits     = 0;
+    pTlb->cTlbMisses   = 0;
+
+    RTGCPHYS GCPhys;
+    uint64_t uTag;
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aPages); i++)
+        RTTESTI_CHECK_RC(tstTlbTranslate(pTlb, s_aPages[i], &GCPhys), VINF_SUCCESS);
+    RTTESTI_CHECK(pTlb->cTlbMisses == RT_ELEMENTS(s_aPages));
+    RTTESTI_CHECK(iemTlbLookup(pTlb, s_aPages[0], &uTag) == iemTlbLookup(pTlb, s_aPages[2], &uTag));
+
+    /* The entry of page 0 was taken over by page 2, so there's nothing to
+       invalidate for it, while page 2 goes away and nothing else does. */
+    RTTESTI_CHECK(!iemTlbInvalidatePageWorker(pTlb, IEMTLB_CALC_TAG_NO_REV(s_aPages[0])));
+    RTTESTI_CHECK(iemTlbInvalidatePageWorker(pTlb, IEMTLB_CALC_TAG_NO_REV(s_aPages[2])));
+    RTTESTI_CHECK(!iemTlbInvalidatePageWorker(pTlb, IEMTLB_CALC_TAG_NO_REV(s_aPages[2])));
+    RTTESTI_CHECK(iemTlbInvalidatePageWorker(pTlb, IEMTLB_CALC_TAG_NO_REV(s_aPages[3])));
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aPages); i++)
+    {
+        PIEMTLBENTRY pTlbe = iemTlbLookup(pTlb, s_aPages[i], &uTag);
+        RTTESTI_CHECK_MSG((pTlbe->uTag == uTag) == (i == 1 || i == 4), ("%RGv\n", s_aPages[i]));
+    }
+
+    /* The physical side: the translations survive, but have to be rechecked. */
+    pTlb->cTlbMisses = 0;
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aPages); i++)
+        RTTESTI_CHECK_RC(tstTlbTranslate(pTlb, s_aPages[i], &GCPhys), VINF_SUCCESS);
+    RTTESTI_CHECK(pTlb->cTlbMisses == 3);
+    for (unsigned iRound = 0; iRound < 2; iRound++)
+    {
+        PIEMTLBENTRY pTlbe = iemTlbLookup(pTlb, s_aPages[4], &uTag);
+        pTlbe->fFlagsAndPhysRev |= IEMTLBE_F_PG_NO_WRITE;
+        pTlbe->pbMappingR3       = (uint8_t *)pTlb;
+        RTTESTI_CHECK(iemTlbIsPhysInfoCurrent(pTlb, pTlbe));
+
+        /* The second round wraps around, which must clear the physical page info. */
+        if (iRound == 1)
+            pTlb->uTlbPhysRev = UINT64_C(0) - IEMTLB_PHYS_REV_INCR;
+        uint64_t const uTlbPhysRev = pTlb->uTlbPhysRev + IEMTLB_PHYS_REV_INCR;
+        if (iRound == 1)
+            pTlbe->fFlagsAndPhysRev = (pTlbe->fFlagsAndPhysRev & ~IEMTLBE_F_PHYS_REV) | pTlb->uTlbPhysRev;
+        iemTlbInvalidateAllPhysicalWorker(pTlb, uTlbPhysRev);
+        RTTESTI_CHECK(pTlb->uTlbPhysRev != 0);
+
+        for (unsigned i = 1; i < RT_ELEMENTS(s_aPages); i++) /* page 0 was evicted by page 2 */
+        {
+            pTlbe = iemTlbLookup(pTlb, s_aPages[i], &uTag);
+            RTTESTI_CHECK(pTlbe->uTag == uTag);
+            RTTESTI_CHECK(!iemTlbIsPhysInfoCurrent(pTlb, pTlbe));
+        }
+        pTlbe = iemTlbLookup(pTlb, s_aPages[4], &uTag);
+        if (iRound == 0)
+            RTTESTI_CHECK(pTlbe->pbMappingR3 == (uint8_t *)pTlb && (pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PG_NO_WRITE));
+        else
+            RTTESTI_CHECK(pTlbe->pbMappingR3 == NULL && !(pTlbe->fFlagsAndPhysRev & IEMTLBE_F_PG_NO_WRITE));
+        RTTESTI_CHECK(pTlbe->GCPhys == (RTGCPHYS)(4 + 0x100) * X86_PAGE_SIZE);
+
+        /* What iemTlbLoadPhysInfo does on the next access. */
+        for (unsigned i = 0; i < RT_ELEMENTS(pTlb->aEntries); i++)
+            pTlb->aEntries[i].fFlagsAndPhysRev = (pTlb->aEntries[i].fFlagsAndPhysRev & ~IEMTLBE_F_PHYS_REV) | pTlb->uTlbPhysRev;
+    }
+}
+
+
+/**
+ * Compares TLB lookups with page walks.
+ */
+static void tstBenchmark(PIEMTLB pTlb)
+{
+    RTTestSub(g_hTest, "Lookup vs. page walk");
+
+    /* A working set of 64 pages spread out over kernel and user space, which
+       is roughly what an instruction loop touches. */
+    static RTGCPTR s_aPages[64];
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aPages); i++)
+    {
+        s_aPages[i] = (i & 1 ? UINT64_C(0xffffffff80000000) : UINT64_C(0x0000000000400000))
+                    + (RTGCPTR)RTRandU32Ex(0, 0x3ffff) * X86_PAGE_SIZE;
+        tstMapPage(s_aPages[i], (RTGCPHYS)(i + 1) * X86_PAGE_SIZE, X86_PTE_RW | X86_PTE_US | X86_PTE_A);
+    }
+
+    uint32_t const cIterations = 4 * _1M;
+    RT_ZERO(pTlb->aEntries);
+    pTlb->uTlbRevision = IEMTLB_REVISION_INCR;
+    pTlb->cTlbHits     = 0;
+    pTlb->cTlbMisses   = 0;
+
+    /* Correctness first. */
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aPages) * 4; i++)
+    {
+        RTGCPTR const GCPtr = s_aPages[i % RT_ELEMENTS(s_aPages)] + (i * 8 & X86_PAGE_OFFSET_MASK);
+        RTGCPHYS GCPhysTlb  = NIL_RTGCPHYS;
+        RTGCPHYS GCPhysWalk = NIL_RTGCPHYS;
+        uint64_t fFlags;
+        RTTESTI_CHECK_RC(tstTlbTranslate(pTlb, GCPtr, &GCPhysTlb), VINF_SUCCESS);
+        RTTESTI_CHECK_RC(tstWalk(GCPtr, &fFlags, &GCPhysWalk), VINF_SUCCESS);
+        GCPhysWalk |= GCPtr & X86_PAGE_OFFSET_MASK;
+        RTTESTI_CHECK_MSG(GCPhysTlb == GCPhysWalk, ("%RGv: %RGp vs %RGp\n", GCPtr, GCPhysTlb, GCPhysWalk));
+    }
+
+    /* Page walk every time. */
+    RTGCPHYS GCPhysSum = 0;
+    uint64_t nsStart = RTTimeNanoTS();
+    for (uint32_t i = 0; i < cIterations; i++)
+    {
+        uint64_t fFlags;
+        RTGCPHYS GCPhys;
+        tstWalk(s_aPages[i % RT_ELEMENTS(s_aPages)], &fFlags, &GCPhys);
+        GCPhysSum += GCPhys;
+    }
+    uint64_t const cNsWalk = RTTimeNanoTS() - nsStart;
+
+    /* Thru the TLB. */
+    iemTlbInvalidateAllWorker(pTlb);
+    pTlb->cTlbHits      = 0;
+    pTlb->cTlbMisses    = 0;
+    g_cWalks            = 0;
+    nsStart = RTTimeNanoTS();
+    for (uint32_t i = 0; i < cIterations; i++)
+    {
+        RTGCPHYS GCPhys;
+        tstTlbTranslate(pTlb, s_aPages[i % RT_ELEMENTS(s_aPages)], &GCPhys);
+        GCPhysSum -= GCPhys;
+    }
+    uint64_t const cNsTlb = RTTimeNanoTS() - nsStart;
+    RTTESTI_CHECK(GCPhysSum == 0);
+    RTTESTI_CHECK(pTlb->cTlbHits + pTlb->cTlbMisses == cIterations);
+    RTTESTI_CHECK(g_cWalks == pTlb->cTlbMisses);
+
+    RTTestValue(g_hTest, "Model page walk",  cNsWalk / cIterations, RTTESTUNIT_NS_PER_CALL);
+    RTTestValue(g_hTest, "TLB lookup",       cNsTlb  / cIterations, RTTESTUNIT_NS_PER_CALL);
+    RTTestValue(g_hTest, "TLB misses",  pTlb->cTlbMisses, RTTESTUNIT_OCCURRENCES);
+}
+
+
+int main()
+{
+    int rc = RTTestInitAndCreate("tstIEMTlb", &g_hTest);
+    if (RT_FAILURE(rc))
+        return RTEXITCODE_FAILURE;
+    RTTestBanner(g_hTest);
+
+    PIEMTLB pTlb = (PIEMTLB)RTMemAllocZ(sizeof(*pTlb));
+    g_paPml4     = (uint64_t *)RTMemAllocZ(512 * sizeof(uint64_t));
+    if (pTlb && g_paPml4)
+    {
+        tstTags(pTlb);
+        tstInvalidation(pTlb);
+        tstBenchmark(pTlb);
+        tstFreeTables(g_paPml4, 3);
+    }
+    else
+        RTTestFailed(g_hTest, "Out of memory");
+    RTMemFree(pTlb);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
@@ -21,7 +21,9 @@
 *********************************************************************************************************************************/
 #include <VBox/vmm/ssm.h>
 #include "VMInternal.h" /* createFakeVM */
+#include "CFGMInternal.h" /* createFakeVM */
 #include <VBox/vmm/vm.h>
+#include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/uvm.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/stam.h>
@@ -663,11 +665,18 @@ static int createFakeVM(PVM *ppVM)
                     pVM->aCpus[0].hNativeThread = RTThreadNativeSelf();
 
                     pUVM->pVM = pVM;
-                    *ppVM = pVM;
-                    return 0;
-                }
 
-                RTPrintf("Fatal error: failed to allocated pages for the VM structure, rc=%Rrc\n", rc);
+                    /* An empty configuration tree, for the /SSM/ settings. */
+                    pVM->cfgm.s.pRoot = CFGMR3CreateTree(pUVM);
+                    if (pVM->cfgm.s.pRoot)
+                    {
+                        *ppVM = pVM;
+                        return 0;
+                    }
+                    RTPrintf("Fatal error: CFGMR3CreateTree failed\n");
+                }
+                else
+                    RTPrintf("Fatal error: failed to allocated pages for the VM structure, rc=%Rrc\n", rc);
             }
             else
                 RTPrintf("Fatal error: MMR3InitUVM failed, rc=%Rrc\n", rc);
@@ -692,11 +701,84 @@ static int createFakeVM(PVM *ppVM)
  */
 static void destroyFakeVM(PVM pVM)
 {
+    CFGMR3RemoveNode(pVM->cfgm.s.pRoot);
+    pVM->cfgm.s.pRoot = NULL;
     STAMR3TermUVM(pVM->pUVM);
     MMR3TermUVM(pVM->pUVM);
 }
 
 
+/**
+ * Saves, loads and validates a state with the given compression settings.
+ *
+ * This round-trips all the test units through the compression pipeline
+ * (cThreads > 0) or the calling thread (cThreads == 0).
+ *
+ * @returns 0 on success, 1 on failure.
+ * @param   pVM             Pointer to the VM.
+ * @param   pszFilename     The file to save to.
+ * @param   pszCodec        The /SSM/ZipCodec value.
+ * @param   cThreads        The /SSM/ZipThreads value.
+ */
+static int tstSSMZipRoundTrip(PVM pVM, const char *pszFilename, const char *pszCodec, uint32_t cThreads)
+{
+    /*
+     * Configure.
+     */
+    PCFGMNODE pRoot = CFGMR3GetRoot(pVM);
+    PCFGMNODE pCfg  = CFGMR3GetChild(pRoot, "SSM");
+    if (pCfg)
+        CFGMR3RemoveNode(pCfg);
+    int rc = CFGMR3InsertNode(pRoot, "SSM", &pCfg);
+    if (RT_SUCCESS(rc))
+        rc = CFGMR3InsertString(pCfg, "ZipCodec", pszCodec);
+    if (RT_SUCCESS(rc))
+        rc = CFGMR3InsertInteger(pCfg, "ZipThreads", cThreads);
+    if (RT_FAILURE(rc))
+    {
+        RTPrintf("tstSSM: %s/%u: failed to configure SSM: %Rrc\n", pszCodec, cThreads, rc);
+        return 1;
+    }
+
+    /*
+     * Save, load and validate.
+     */
+    uint64_t u64Start = RTTimeNanoTS();
+    rc = SSMR3Save(pVM, pszFilename, NULL, NULL, SSMAFTER_DESTROY, NULL, NULL);
+    if (RT_FAILURE(rc))
+    {
+        RTPrintf("tstSSM: %s/%u: SSMR3Save -> %Rrc\n", pszCodec, cThreads, rc);
+        return 1;
+    }
+    uint64_t const cNsSave = RTTimeNanoTS() - u64Start;
+
+    uint64_t cbFile = 0;
+    RTFileQuerySize(pszFilename, &cbFile);
+
+    u64Start = RTTimeNanoTS();
+    rc = SSMR3Load(pVM, pszFilename, NULL /*pStreamOps*/, NULL /*pStreamOpsUser*/,
+                   SSMAFTER_RESUME, NULL /*pfnProgress*/, NULL /*pvProgressUser*/);
+    if (RT_FAILURE(rc))
+    {
+        RTPrintf("tstSSM: %s/%u: SSMR3Load -> %Rrc\n", pszCodec, cThreads, rc);
+        return 1;
+    }
+    uint64_t const cNsLoad = RTTimeNanoTS() - u64Start;
+
+    rc = SSMR3ValidateFile(pszFilename, true /* fChecksumIt */);
+    if (RT_FAILURE(rc))
+    {
+        RTPrintf("tstSSM: %s/%u: SSMR3ValidateFile -> %Rrc\n", pszCodec, cThreads, rc);
+        return 1;
+    }
+
+    RTPrintf("tstSSM: %s/%u: %'RU64 bytes, saved in %'RU64 ns, loaded in %'RU64 ns\n",
+             pszCodec, cThreads, cbFile, cNsSave, cNsLoad);
+    RTFileDelete(pszFilename);
+    return 0;
+}
+
+
 /**
  *  Entry point.
  */
@@ -928,11 +1010,26 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
         return 1;
     }
 
-    destroyFakeVM(pVM);
-
     /* delete */
     RTFileDelete(pszFilename);
 
+    /*
+     * Round-trip with both codecs, with and without the compression pipeline.
+     */
+    static struct { const char *pszCodec; uint32_t cThreads; } const s_aZipCfgs[] =
+    {
+        { "lzf",  0 },
+        { "lzf",  3 },
+        { "zlib", 0 },
+        { "zlib", 3 },
+        { "lzf",  64 }, /* clamped to the maximum */
+    };
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aZipCfgs); i++)
+        if (tstSSMZipRoundTrip(pVM, "SSMTestSave#2", s_aZipCfgs[i].pszCodec, s_aZipCfgs[i].cThreads))
+            return 1;
+
+    destroyFakeVM(pVM);
+
     RTPrintf("tstSSM: SUCCESS\n");
     return 0;
 }
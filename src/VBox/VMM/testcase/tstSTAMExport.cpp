@@ -0,0 +1,335 @@
+/* $Id$ */
+/** @file
+ * STAM Export Testcase - The shared memory export region reader.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <VBox/vmm/stam.h>
+#include <VBox/vmm/stamexport.h>
+#include <iprt/asm.h>
+#include <iprt/err.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** A sample in the test region. */
+typedef struct TSTSAMPLE
+{
+    const char *pszName;
+    const char *pszDesc;
+    STAMTYPE    enmType;
+    uint16_t    cValues;
+} TSTSAMPLE;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The test handle. */
+static RTTEST               g_hTest;
+/** The region, the writer side is done by hand like STAMExport.cpp does. */
+static uint64_t             g_au64Region[_64K / sizeof(uint64_t)];
+/** The copy made by the reader. */
+static uint64_t             g_au64Copy[_64K / sizeof(uint64_t)];
+/** The samples, sorted by name like STAM keeps them. */
+static TSTSAMPLE const      g_aSamples[] =
+{
+    { "/A/Counter",     "A counter.",       STAMTYPE_COUNTER,   1 },
+    { "/B/Profile",     "A profile.",       STAMTYPE_PROFILE,   4 },
+    { "/C/Histogram",   "A histogram.",     STAMTYPE_HISTOGRAM, 4 + STAMHISTOGRAM_BUCKETS },
+    { "/D/NoDesc",      NULL,               STAMTYPE_U32,       1 },
+    { "/E/Ratio",       "A ratio.",         STAMTYPE_RATIO_U32, 2 },
+};
+/** Set when the writer thread should stop. */
+static bool volatile        g_fStop;
+
+
+/**
+ * Lays out the test region with the values of each sample set to the sample
+ * index times 1000 plus the value index.
+ *
+ * @returns The region header.
+ */
+static PSTAMEXPORTHDR tstBuildRegion(void)
+{
+    RT_ZERO(g_au64Region);
+    PSTAMEXPORTHDR pHdr = (PSTAMEXPORTHDR)&g_au64Region[0];
+    pHdr->u32Version  = STAMEXPORTHDR_VERSION;
+    pHdr->cbHdr       = sizeof(STAMEXPORTHDR);
+    pHdr->cbDesc      = sizeof(STAMEXPORTDESC);
+    pHdr->cbRegion    = sizeof(g_au64Region);
+    pHdr->cDescs      = RT_ELEMENTS(g_aSamples);
+    pHdr->offDescs    = RT_ALIGN_32(sizeof(STAMEXPORTHDR), 8);
+    pHdr->offStrings  = pHdr->offDescs + RT_ELEMENTS(g_aSamples) * sizeof(STAMEXPORTDESC);
+
+    PSTAMEXPORTDESC paDescs = (PSTAMEXPORTDESC)((uint8_t *)pHdr + pHdr->offDescs);
+    char           *pch     = (char *)pHdr + pHdr->offStrings;
+    uint32_t        off     = 0;
+    uint32_t        iValue  = 0;
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_aSamples); i++)
+    {
+        paDescs[i].offName = off;
+        off += (uint32_t)RTStrPrintf(&pch[off], 64, "%s", g_aSamples[i].pszName) + 1;
+        if (g_aSamples[i].pszDesc)
+        {
+            paDescs[i].offDesc = off;
+            off += (uint32_t)RTStrPrintf(&pch[off], 64, "%s", g_aSamples[i].pszDesc) + 1;
+        }
+        else
+            paDescs[i].offDesc = UINT32_MAX;
+        paDescs[i].iValue  = iValue;
+        paDescs[i].cValues = g_aSamples[i].cValues;
+        paDescs[i].enmType = (uint8_t)g_aSamples[i].enmType;
+        paDescs[i].enmUnit = (uint8_t)STAMUNIT_OCCURENCES;
+        iValue += g_aSamples[i].cValues;
+    }
+    pHdr->cbStrings = off;
+    pHdr->offValues = RT_ALIGN_32(pHdr->offStrings + off, 8);
+    pHdr->cValues   = iValue;
+
+    uint64_t *pau = (uint64_t *)((uint8_t *)pHdr + pHdr->offValues);
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_aSamples); i++)
+        for (uint32_t j = 0; j < g_aSamples[i].cValues; j++)
+            *pau++ = i * 1000 + j;
+
+    pHdr->u32Magic = STAMEXPORTHDR_MAGIC;
+    return pHdr;
+}
+
+
+/**
+ * Copies the region and checks the result and status.
+ */
+static int tstCopy(PCSTAMEXPORTHDR pHdr, size_t cbMapped, size_t cbDst, size_t *pcbNeeded)
+{
+    RT_ZERO(g_au64Copy);
+    return STAMExportCopyRegion(pHdr, cbMapped, g_au64Copy, cbDst, pcbNeeded);
+}
+
+
+/**
+ * Reads back everything in a well formed region.
+ */
+static void tstRead(void)
+{
+    RTTestSub(g_hTest, "Read");
+    PSTAMEXPORTHDR pHdr = tstBuildRegion();
+
+    size_t cbCopy = 0;
+    RTTEST_CHECK_RC_RETV(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), &cbCopy), VINF_SUCCESS);
+    RTTEST_CHECK(g_hTest, cbCopy == pHdr->offValues + pHdr->cValues * sizeof(uint64_t));
+
+    PCSTAMEXPORTHDR pCopy = (PCSTAMEXPORTHDR)&g_au64Copy[0];
+    RTTEST_CHECK_RETV(g_hTest, pCopy->cDescs == RT_ELEMENTS(g_aSamples));
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_aSamples); i++)
+    {
+        PCSTAMEXPORTDESC pDesc = STAMExportLookup(pCopy, g_aSamples[i].pszName);
+        RTTEST_CHECK_MSG_RETV(g_hTest, pDesc == STAMExportGetDesc(pCopy, i), (g_hTest, "%s\n", g_aSamples[i].pszName));
+        RTTEST_CHECK(g_hTest, !strcmp(STAMExportGetName(pCopy, pDesc), g_aSamples[i].pszName));
+        const char *pszDesc = STAMExportGetDescription(pCopy, pDesc);
+        if (g_aSamples[i].pszDesc)
+            RTTEST_CHECK(g_hTest, pszDesc && !strcmp(pszDesc, g_aSamples[i].pszDesc));
+        else
+            RTTEST_CHECK(g_hTest, pszDesc == NULL);
+        RTTEST_CHECK(g_hTest, pDesc->enmType == g_aSamples[i].enmType);
+        RTTEST_CHECK(g_hTest, pDesc->cValues == g_aSamples[i].cValues);
+
+        uint64_t const *pau = STAMExportGetValues(pCopy, pDesc);
+        for (uint32_t j = 0; j < pDesc->cValues; j++)
+            RTTEST_CHECK_MSG(g_hTest, pau[j] == i * 1000 + j, (g_hTest, "%s[%u]=%RU64\n", g_aSamples[i].pszName, j, pau[j]));
+    }
+
+    RTTEST_CHECK(g_hTest, STAMExportLookup(pCopy, "/0") == NULL);
+    RTTEST_CHECK(g_hTest, STAMExportLookup(pCopy, "/B") == NULL);
+    RTTEST_CHECK(g_hTest, STAMExportLookup(pCopy, "/B/Profile/") == NULL);
+    RTTEST_CHECK(g_hTest, STAMExportLookup(pCopy, "/Z") == NULL);
+}
+
+
+/**
+ * Checks the statuses telling the reader to remap, retry or give up.
+ */
+static void tstStatuses(void)
+{
+    RTTestSub(g_hTest, "Statuses");
+    PSTAMEXPORTHDR pHdr   = tstBuildRegion();
+    size_t const   cbUsed = pHdr->offValues + pHdr->cValues * sizeof(uint64_t);
+
+    /* The region grew beyond our mapping. */
+    size_t cbNeeded = 0;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region) / 2, sizeof(g_au64Copy), &cbNeeded), VERR_OUT_OF_RANGE);
+    RTTEST_CHECK(g_hTest, cbNeeded == sizeof(g_au64Region));
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(STAMEXPORTHDR) - 1, sizeof(g_au64Copy), NULL), VERR_OUT_OF_RANGE);
+
+    /* Our buffer is too small. */
+    cbNeeded = 0;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), cbUsed - 1, &cbNeeded), VERR_BUFFER_OVERFLOW);
+    RTTEST_CHECK(g_hTest, cbNeeded == cbUsed);
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), cbUsed, NULL), VINF_SUCCESS);
+
+    /* The writer never finishes. */
+    pHdr->uSeq = 1;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_TRY_AGAIN);
+    pHdr->uSeq = 2;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VINF_SUCCESS);
+
+    /* The VM has terminated or the file isn't an export region. */
+    pHdr->u32Magic = STAMEXPORTHDR_MAGIC_DEAD;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_MAGIC);
+    pHdr->u32Magic = 0;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_MAGIC);
+    pHdr->u32Magic = STAMEXPORTHDR_MAGIC;
+
+    /* A layout we don't know. */
+    pHdr->u32Version = STAMEXPORTHDR_VERSION + 1;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_VERSION_MISMATCH);
+    pHdr->u32Version = STAMEXPORTHDR_VERSION;
+    pHdr->cbDesc = sizeof(STAMEXPORTDESC) + 4;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_VERSION_MISMATCH);
+    pHdr->cbDesc = sizeof(STAMEXPORTDESC);
+}
+
+
+/**
+ * Checks that inconsistent tables are rejected rather than trusted.
+ */
+static void tstCorrupt(void)
+{
+    RTTestSub(g_hTest, "Corrupt");
+
+    PSTAMEXPORTHDR  pHdr    = tstBuildRegion();
+    PSTAMEXPORTDESC paDescs = (PSTAMEXPORTDESC)((uint8_t *)pHdr + pHdr->offDescs);
+    paDescs[1].offName = pHdr->cbStrings;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_STATE);
+
+    pHdr = tstBuildRegion();
+    paDescs[2].offDesc = pHdr->cbStrings + 10;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_STATE);
+
+    pHdr = tstBuildRegion();
+    paDescs[RT_ELEMENTS(g_aSamples) - 1].cValues++;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_STATE);
+
+    pHdr = tstBuildRegion();
+    *((char *)pHdr + pHdr->offStrings + pHdr->cbStrings - 1) = 'x';
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_STATE);
+
+    pHdr = tstBuildRegion();
+    pHdr->cDescs++;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_STATE);
+
+    pHdr = tstBuildRegion();
+    pHdr->offValues += 4;
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_STATE);
+
+    pHdr = tstBuildRegion();
+    pHdr->cValues = (uint32_t)(sizeof(g_au64Region) / sizeof(uint64_t));
+    RTTEST_CHECK_RC(g_hTest, tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL), VERR_INVALID_STATE);
+}
+
+
+/**
+ * @callback_method_impl{FNRTTHREAD, Updates the values the way
+ *                      stamR3ExportUpdate does.}
+ */
+static DECLCALLBACK(int) tstWriterThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf);
+    PSTAMEXPORTHDR pHdr = (PSTAMEXPORTHDR)pvUser;
+    uint64_t      *pau  = (uint64_t *)((uint8_t *)pHdr + pHdr->offValues);
+    for (uint64_t iUpdate = 1; !ASMAtomicReadBool(&g_fStop); iUpdate++)
+    {
+        ASMAtomicIncU32(&pHdr->uSeq);
+        for (uint32_t i = 0; i < pHdr->cValues; i++)
+            ASMAtomicWriteU64(&pau[i], iUpdate);
+        pHdr->cUpdates = iUpdate;
+        ASMAtomicIncU32(&pHdr->uSeq);
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Checks that copies taken while the writer is busy are consistent.
+ */
+static void tstConcurrent(void)
+{
+    RTTestSub(g_hTest, "Concurrent");
+    PSTAMEXPORTHDR pHdr = tstBuildRegion();
+
+    g_fStop = false;
+    RTTHREAD hThread;
+    int rc = RTThreadCreate(&hThread, tstWriterThread, pHdr, 0, RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "writer");
+    RTTEST_CHECK_RC_OK_RETV(g_hTest, rc);
+
+    uint32_t cCopies = 0;
+    uint32_t cBusy   = 0;
+    for (uint32_t iCopy = 0; iCopy < 20000; iCopy++)
+    {
+        rc = tstCopy(pHdr, sizeof(g_au64Region), sizeof(g_au64Copy), NULL);
+        if (rc == VERR_TRY_AGAIN)
+        {
+            cBusy++;
+            continue;
+        }
+        RTTEST_CHECK_RC_BREAK(g_hTest, rc, VINF_SUCCESS);
+        cCopies++;
+
+        /* All values must come from the same update. */
+        PCSTAMEXPORTHDR pCopy   = (PCSTAMEXPORTHDR)&g_au64Copy[0];
+        uint64_t const *pau     = (uint64_t const *)((uint8_t const *)pCopy + pCopy->offValues);
+        uint64_t const  uUpdate = pCopy->cUpdates;
+        if (!uUpdate)
+            continue;
+        bool            fOk     = true;
+        for (uint32_t i = 0; i < pCopy->cValues && fOk; i++)
+            fOk = pau[i] == uUpdate;
+        if (!fOk)
+        {
+            RTTestFailed(g_hTest, "copy #%u is torn (update %RU64)\n", iCopy, uUpdate);
+            break;
+        }
+    }
+
+    ASMAtomicWriteBool(&g_fStop, true);
+    RTThreadWait(hThread, RT_INDEFINITE_WAIT, NULL);
+    RTTEST_CHECK(g_hTest, cCopies > 0);
+    RTTestValue(g_hTest, "Copies", cCopies, RTTESTUNIT_OCCURRENCES);
+    RTTestValue(g_hTest, "Writer busy", cBusy, RTTESTUNIT_OCCURRENCES);
+}
+
+
+int main()
+{
+    int rc = RTTestInitAndCreate("tstSTAMExport", &g_hTest);
+    if (rc)
+        return rc;
+    RTTestBanner(g_hTest);
+
+    tstRead();
+    tstStatuses();
+    tstCorrupt();
+    tstConcurrent();
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
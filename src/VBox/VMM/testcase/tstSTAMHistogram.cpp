@@ -0,0 +1,161 @@
+/* $Id$ */
+/** @file
+ * STAM Histogram Testcase - Bucket layout and sample recording checks.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <VBox/vmm/stam.h>
+#include <iprt/asm.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The test handle. */
+static RTTEST       g_hTest;
+
+
+/**
+ * Checks the bucket boundaries, i.e. that STAMHistogramBucketToValue and
+ * STAMHistogramBucketFromValue agree and that the buckets are contiguous.
+ */
+static void tstBoundaries(void)
+{
+    RTTestSub(g_hTest, "Boundaries");
+
+    /* The small values get a bucket each. */
+    for (uint32_t i = 0; i < STAMHISTOGRAM_SUB_BUCKETS; i++)
+    {
+        RTTEST_CHECK(g_hTest, STAMHistogramBucketFromValue(i) == i);
+        RTTEST_CHECK(g_hTest, STAMHistogramBucketToValue(i) == i);
+    }
+
+    /* Every bucket covers [ToValue(i), ToValue(i + 1)), without gaps. */
+    for (uint32_t i = 0; i < STAMHISTOGRAM_BUCKETS; i++)
+    {
+        uint64_t const uLo = STAMHistogramBucketToValue(i);
+        uint64_t const uHi = STAMHistogramBucketToValue(i + 1);
+        RTTEST_CHECK_MSG_RETV(g_hTest, uLo < uHi, (g_hTest, "bucket %u: %#RX64..%#RX64\n", i, uLo, uHi));
+        RTTEST_CHECK_MSG(g_hTest, STAMHistogramBucketFromValue(uLo) == i,
+                         (g_hTest, "bucket %u: lower bound %#RX64 -> %u\n", i, uLo, STAMHistogramBucketFromValue(uLo)));
+        RTTEST_CHECK_MSG(g_hTest, STAMHistogramBucketFromValue(uHi - 1) == i,
+                         (g_hTest, "bucket %u: upper bound %#RX64 -> %u\n", i, uHi - 1, STAMHistogramBucketFromValue(uHi - 1)));
+
+        /* The relative error is bounded by the sub-bucket count. */
+        if (i >= STAMHISTOGRAM_SUB_BUCKETS)
+            RTTEST_CHECK_MSG(g_hTest, (uHi - uLo) * STAMHISTOGRAM_SUB_BUCKETS <= uLo,
+                             (g_hTest, "bucket %u: %#RX64..%#RX64 too wide\n", i, uLo, uHi));
+    }
+
+    /* Powers of two start a new group of sub-buckets. */
+    for (unsigned iBit = STAMHISTOGRAM_SUB_BUCKET_SHIFT; iBit < 33; iBit++)
+    {
+        uint32_t const iBucket = STAMHistogramBucketFromValue(RT_BIT_64(iBit));
+        RTTEST_CHECK(g_hTest, !(iBucket & (STAMHISTOGRAM_SUB_BUCKETS - 1)));
+        RTTEST_CHECK(g_hTest, STAMHistogramBucketToValue(iBucket) == RT_BIT_64(iBit));
+        RTTEST_CHECK(g_hTest, STAMHistogramBucketFromValue(RT_BIT_64(iBit) - 1) == iBucket - 1);
+    }
+
+    /* Random values land in the bucket covering them. */
+    for (unsigned i = 0; i < 100000; i++)
+    {
+        uint64_t const uValue  = RTRandU64Ex(0, STAMHistogramBucketToValue(STAMHISTOGRAM_BUCKETS) - 1);
+        uint32_t const iBucket = STAMHistogramBucketFromValue(uValue);
+        RTTEST_CHECK_MSG_RETV(g_hTest,
+                                 iBucket < STAMHISTOGRAM_BUCKETS
+                              && STAMHistogramBucketToValue(iBucket) <= uValue
+                              && uValue < STAMHistogramBucketToValue(iBucket + 1),
+                              (g_hTest, "%#RX64 -> bucket %u\n", uValue, iBucket));
+    }
+}
+
+
+/**
+ * Checks that values beyond the last bucket are counted in it.
+ */
+static void tstOverflow(void)
+{
+    RTTestSub(g_hTest, "Overflow");
+
+    uint64_t const uEnd = STAMHistogramBucketToValue(STAMHISTOGRAM_BUCKETS);
+    RTTEST_CHECK(g_hTest, uEnd == RT_BIT_64(33));
+    RTTEST_CHECK(g_hTest, STAMHistogramBucketFromValue(uEnd - 1) == STAMHISTOGRAM_BUCKETS - 1);
+    RTTEST_CHECK(g_hTest, STAMHistogramBucketFromValue(uEnd)     == STAMHISTOGRAM_BUCKETS - 1);
+    RTTEST_CHECK(g_hTest, STAMHistogramBucketFromValue(uEnd * 3) == STAMHISTOGRAM_BUCKETS - 1);
+    for (unsigned iBit = 33; iBit < 64; iBit++)
+        RTTEST_CHECK(g_hTest, STAMHistogramBucketFromValue(RT_BIT_64(iBit)) == STAMHISTOGRAM_BUCKETS - 1);
+    RTTEST_CHECK(g_hTest, STAMHistogramBucketFromValue(UINT64_MAX) == STAMHISTOGRAM_BUCKETS - 1);
+}
+
+
+/**
+ * Checks STAMHistogramAddSample.
+ */
+static void tstAddSample(void)
+{
+    RTTestSub(g_hTest, "AddSample");
+
+    static STAMHISTOGRAM s_Histogram;
+    RT_ZERO(s_Histogram);
+    s_Histogram.Core.cTicksMin = UINT64_MAX;     /* like stamR3ResetOne */
+
+    static uint64_t const s_auValues[] = { 0, 3, 4, 5, 1000, 1023, 1024, RT_BIT_64(33) - 1, RT_BIT_64(33), UINT64_MAX / 2 };
+    uint64_t cTicks = 0;
+    for (unsigned i = 0; i < RT_ELEMENTS(s_auValues); i++)
+    {
+        STAMHistogramAddSample(&s_Histogram, s_auValues[i]);
+        cTicks += s_auValues[i];
+    }
+
+    RTTEST_CHECK(g_hTest, s_Histogram.Core.cPeriods  == RT_ELEMENTS(s_auValues));
+    RTTEST_CHECK(g_hTest, s_Histogram.Core.cTicks    == cTicks);
+    RTTEST_CHECK(g_hTest, s_Histogram.Core.cTicksMin == 0);
+    RTTEST_CHECK(g_hTest, s_Histogram.Core.cTicksMax == UINT64_MAX / 2);
+
+    RTTEST_CHECK(g_hTest, s_Histogram.acBuckets[0] == 1);
+    RTTEST_CHECK(g_hTest, s_Histogram.acBuckets[3] == 1);
+    RTTEST_CHECK(g_hTest, s_Histogram.acBuckets[4] == 1);  /* 4..7 still get a bucket each */
+    RTTEST_CHECK(g_hTest, s_Histogram.acBuckets[5] == 1);
+    RTTEST_CHECK(g_hTest, s_Histogram.acBuckets[STAMHistogramBucketFromValue(1000)] == 2);  /* 1000 and 1023 */
+    RTTEST_CHECK(g_hTest, s_Histogram.acBuckets[STAMHistogramBucketFromValue(1024)] == 1);
+    RTTEST_CHECK(g_hTest, s_Histogram.acBuckets[STAMHISTOGRAM_BUCKETS - 1] == 3);
+
+    uint64_t cTotal = 0;
+    for (unsigned i = 0; i < STAMHISTOGRAM_BUCKETS; i++)
+        cTotal += s_Histogram.acBuckets[i];
+    RTTEST_CHECK(g_hTest, cTotal == RT_ELEMENTS(s_auValues));
+}
+
+
+int main()
+{
+    int rc = RTTestInitAndCreate("tstSTAMHistogram", &g_hTest);
+    if (rc)
+        return rc;
+    RTTestBanner(g_hTest);
+
+    tstBoundaries();
+    tstOverflow();
+    tstAddSample();
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
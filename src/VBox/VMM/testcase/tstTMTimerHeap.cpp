@@ -0,0 +1,365 @@
+/* $Id$ */
+/** @file
+ * TM Timer Heap Testcase - Active timer heap checks and rearm benchmark.
+ */
+
+/*
+ * Copyright (C) 2016 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <VBox/vmm/tm.h>
+#include "../include/TMInternal.h"
+#include <VBox/vmm/dbgftrace.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+#include "../include/TMInline.h"
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * A timer queue with its timers.
+ *
+ * The timers must be allocated together with the queue like on the hyper heap
+ * as the links are 32-bit relative offsets.
+ */
+typedef struct TSTQUEUE
+{
+    TMTIMERQUEUE    Queue;
+    TMTIMER         aTimers[1];
+} TSTQUEUE;
+/** Pointer to a test queue. */
+typedef TSTQUEUE *PTSTQUEUE;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The test handle. */
+static RTTEST       g_hTest;
+
+
+/**
+ * Allocates a test queue with empty heap and stopped timers.
+ */
+static PTSTQUEUE tstQueueAlloc(uint32_t cTimers)
+{
+    PTSTQUEUE pQueue = (PTSTQUEUE)RTMemAllocZ(RT_OFFSETOF(TSTQUEUE, aTimers[cTimers]));
+    if (pQueue)
+    {
+        pQueue->Queue.u64Expire = INT64_MAX;
+        pQueue->Queue.enmClock  = TMCLOCK_VIRTUAL;
+        for (uint32_t i = 0; i < cTimers; i++)
+        {
+            pQueue->aTimers[i].enmClock = TMCLOCK_VIRTUAL;
+            pQueue->aTimers[i].enmState = TMTIMERSTATE_STOPPED;
+        }
+    }
+    else
+        RTTestFailed(g_hTest, "Out of memory");
+    return pQueue;
+}
+
+
+/**
+ * Arms a timer, the heap way.
+ */
+DECLINLINE(void) tstHeapArm(PTSTQUEUE pQueue, PTMTIMER pTimer, uint64_t u64Expire)
+{
+    if (pTimer->enmState == TMTIMERSTATE_ACTIVE)
+        tmTimerHeapRemove(&pQueue->Queue, pTimer);
+    pTimer->u64Expire = u64Expire;
+    pTimer->enmState  = TMTIMERSTATE_ACTIVE;
+    tmTimerHeapInsert(&pQueue->Queue, pTimer);
+}
+
+
+/**
+ * Arms a timer the way it was done with the sorted active list.
+ *
+ * This is the reference the heap is measured against.
+ */
+DECLINLINE(void) tstListArm(PTSTQUEUE pQueue, PTMTIMER pTimer, uint64_t u64Expire)
+{
+    if (pTimer->enmState == TMTIMERSTATE_ACTIVE)
+    {
+        const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
+        const PTMTIMER pNext = TMTIMER_GET_NEXT(pTimer);
+        if (pPrev)
+            TMTIMER_SET_NEXT(pPrev, pNext);
+        else
+            TMTIMER_SET_HEAD(&pQueue->Queue, pNext);
+        if (pNext)
+            TMTIMER_SET_PREV(pNext, pPrev);
+        pTimer->offNext = 0;
+        pTimer->offPrev = 0;
+    }
+    pTimer->u64Expire = u64Expire;
+    pTimer->enmState  = TMTIMERSTATE_ACTIVE;
+
+    PTMTIMER pPrev = NULL;
+    PTMTIMER pCur  = TMTIMER_GET_HEAD(&pQueue->Queue);
+    while (pCur && pCur->u64Expire <= u64Expire)
+    {
+        pPrev = pCur;
+        pCur  = TMTIMER_GET_NEXT(pCur);
+    }
+    TMTIMER_SET_NEXT(pTimer, pCur);
+    TMTIMER_SET_PREV(pTimer, pPrev);
+    if (pPrev)
+        TMTIMER_SET_NEXT(pPrev, pTimer);
+    else
+        TMTIMER_SET_HEAD(&pQueue->Queue, pTimer);
+    if (pCur)
+        TMTIMER_SET_PREV(pCur, pTimer);
+}
+
+
+/**
+ * Pops all timers off the heap checking that they come out in order.
+ *
+ * @returns Number of timers popped.
+ */
+static uint32_t tstHeapDrain(PTSTQUEUE pQueue)
+{
+    uint32_t cPopped = 0;
+    uint64_t u64Prev = 0;
+    PTMTIMER pTimer;
+    while ((pTimer = TMTIMER_GET_HEAD(&pQueue->Queue)) != NULL)
+    {
+        RTTESTI_CHECK(pTimer->u64HeapExpire == pTimer->u64Expire);
+        RTTESTI_CHECK(pQueue->Queue.u64Expire == pTimer->u64Expire);
+        RTTESTI_CHECK_MSG(pTimer->u64Expire >= u64Prev, ("%RU64 < %RU64\n", pTimer->u64Expire, u64Prev));
+        u64Prev = pTimer->u64Expire;
+        tmTimerHeapRemove(&pQueue->Queue, pTimer);
+        RTTESTI_CHECK(!pTimer->offNext && !pTimer->offPrev && !pTimer->offChild);
+        pTimer->enmState = TMTIMERSTATE_STOPPED;
+        cPopped++;
+    }
+    RTTESTI_CHECK(pQueue->Queue.u64Expire == INT64_MAX);
+    return cPopped;
+}
+
+
+/**
+ * Checks inserting, removing, rearming and walking the heap.
+ */
+static void tstHeapChecks(void)
+{
+    RTTestSub(g_hTest, "Heap operations");
+
+    uint32_t const cTimers = 2048;
+    PTSTQUEUE pQueue = tstQueueAlloc(cTimers);
+    if (!pQueue)
+        return;
+
+    /* Insert everything with plenty of duplicate expire times and drain. */
+    for (uint32_t i = 0; i < cTimers; i++)
+        tstHeapArm(pQueue, &pQueue->aTimers[i], RTRandU64Ex(1000, 1000 + cTimers / 4));
+    RTTESTI_CHECK(tstHeapDrain(pQueue) == cTimers);
+
+    /* Arm all, remove every third from wherever it is in the heap, rearm the
+       rest a few times, then walk the heap and drain it. */
+    for (uint32_t i = 0; i < cTimers; i++)
+        tstHeapArm(pQueue, &pQueue->aTimers[i], RTRandU64Ex(1, _1M));
+    uint32_t cActive = cTimers;
+    for (uint32_t i = 0; i < cTimers; i += 3)
+    {
+        tmTimerHeapRemove(&pQueue->Queue, &pQueue->aTimers[i]);
+        pQueue->aTimers[i].enmState = TMTIMERSTATE_STOPPED;
+        cActive--;
+    }
+    for (uint32_t iRound = 0; iRound < 4; iRound++)
+        for (uint32_t i = 0; i < cTimers; i++)
+            if (pQueue->aTimers[i].enmState == TMTIMERSTATE_ACTIVE)
+                tstHeapArm(pQueue, &pQueue->aTimers[i], RTRandU64Ex(1, _1M));
+
+    uint32_t cWalked = 0;
+    uint64_t u64Min  = UINT64_MAX;
+    for (PTMTIMER pTimer = TMTIMER_GET_HEAD(&pQueue->Queue); pTimer; pTimer = tmTimerHeapWalkNext(pTimer))
+    {
+        RTTESTI_CHECK(pTimer->enmState == TMTIMERSTATE_ACTIVE);
+        u64Min = RT_MIN(u64Min, pTimer->u64Expire);
+        cWalked++;
+    }
+    RTTESTI_CHECK_MSG(cWalked == cActive, ("%u vs %u\n", cWalked, cActive));
+    RTTESTI_CHECK(pQueue->Queue.u64Expire == u64Min);
+    RTTESTI_CHECK(tstHeapDrain(pQueue) == cActive);
+
+    RTMemFree(pQueue);
+}
+
+
+/**
+ * Checks rearming timers which are still linked into the heap.
+ *
+ * TMTimerSet changes the expire time of an active timer in place and leaves
+ * the unlinking and relinking to the next tmTimerQueueSchedule, so other heap
+ * operations must cope with timers whose u64Expire no longer matches their
+ * position in the heap.
+ */
+static void tstHeapRearmQueued(void)
+{
+    RTTestSub(g_hTest, "Rearm queued timers");
+
+    uint32_t const cTimers = 512;
+    PTSTQUEUE pQueue = tstQueueAlloc(cTimers);
+    if (!pQueue)
+        return;
+
+    for (uint32_t iRound = 0; iRound < 64; iRound++)
+    {
+        /* Timer 0 is the root, the others spread out at 1000 tick intervals. */
+        for (uint32_t i = 0; i < cTimers / 2; i++)
+            tstHeapArm(pQueue, &pQueue->aTimers[i], 1000 + (uint64_t)i * 1000);
+        RTTESTI_CHECK(TMTIMER_GET_HEAD(&pQueue->Queue) == &pQueue->aTimers[0]);
+
+        /* Like TMTimerSet on active timers: the root and a queued timer
+           to later deadlines, two queued timers to earlier ones. */
+        uint32_t const iLater   = RTRandU32Ex(1, cTimers / 2 - 2);
+        uint32_t       iEarlier = RTRandU32Ex(1, cTimers / 2 - 2);
+        if (iEarlier == iLater)
+            iEarlier = iLater == 1 ? 2 : 1;
+        uint32_t const aiRearm[4] = { 0, iLater, iEarlier, cTimers / 2 - 1 };
+        uint64_t const au64New[4] = { _1M, 999999, 500, 1 };
+        for (unsigned j = 0; j < RT_ELEMENTS(aiRearm); j++)
+        {
+            pQueue->aTimers[aiRearm[j]].u64Expire = au64New[j];
+            pQueue->aTimers[aiRearm[j]].enmState  = TMTIMERSTATE_PENDING_RESCHEDULE;
+        }
+
+        /* Other timers get armed and stopped before the scheduling happens. */
+        for (uint32_t i = cTimers / 2; i < cTimers; i++)
+            tstHeapArm(pQueue, &pQueue->aTimers[i], RTRandU64Ex(1001, 2 * _1M));
+        for (uint32_t i = cTimers / 2; i < cTimers; i += 2)
+        {
+            tmTimerHeapRemove(&pQueue->Queue, &pQueue->aTimers[i]);
+            pQueue->aTimers[i].enmState = TMTIMERSTATE_STOPPED;
+        }
+        RTTESTI_CHECK(pQueue->Queue.u64Expire == pQueue->aTimers[0].u64HeapExpire);
+
+        /* The scheduling, tmTimerQueueScheduleOne unlinks and relinks. */
+        for (unsigned j = 0; j < RT_ELEMENTS(aiRearm); j++)
+        {
+            PTMTIMER pTimer = &pQueue->aTimers[aiRearm[j]];
+            tmTimerHeapRemove(&pQueue->Queue, pTimer);
+            pTimer->enmState = TMTIMERSTATE_ACTIVE;
+            tmTimerHeapInsert(&pQueue->Queue, pTimer);
+        }
+
+        /* Fire them all, the earlier deadlines first. */
+        RTTESTI_CHECK(TMTIMER_GET_HEAD(&pQueue->Queue) == &pQueue->aTimers[cTimers / 2 - 1]);
+        RTTESTI_CHECK(pQueue->Queue.u64Expire == 1);
+        RTTESTI_CHECK(tstHeapDrain(pQueue) == cTimers / 2 + cTimers / 4);
+    }
+
+    RTMemFree(pQueue);
+}
+
+
+/**
+ * Measures rearming random timers in a queue with the given number of active
+ * timers, comparing the heap with the old sorted list.
+ */
+static void tstBenchmark(uint32_t cTimers)
+{
+    RTTestSubF(g_hTest, "Rearm %u timers", cTimers);
+
+    PTSTQUEUE pQueue = tstQueueAlloc(cTimers);
+    if (!pQueue)
+        return;
+
+    /* Pick the timers and expire deltas up front so only the queue work is timed.
+       The deltas are periodic device timer like, i.e. mostly far into the future. */
+    uint32_t const  cRearms   = 64 * _1K;
+    uint32_t       *paiTimers = (uint32_t *)RTMemAlloc(cRearms * sizeof(uint32_t));
+    uint64_t       *pacDeltas = (uint64_t *)RTMemAlloc(cRearms * sizeof(uint64_t));
+    if (paiTimers && pacDeltas)
+    {
+        for (uint32_t i = 0; i < cRearms; i++)
+        {
+            paiTimers[i] = RTRandU32Ex(0, cTimers - 1);
+            pacDeltas[i] = RTRandU64Ex(10000, 10000000);
+        }
+
+        /* The old sorted list. */
+        uint64_t u64Now = 0;
+        for (uint32_t i = 0; i < cTimers; i++)
+            tstListArm(pQueue, &pQueue->aTimers[i], RTRandU64Ex(10000, 10000000));
+        uint64_t nsStart = RTTimeNanoTS();
+        for (uint32_t i = 0; i < cRearms; i++)
+            tstListArm(pQueue, &pQueue->aTimers[paiTimers[i]], ++u64Now + pacDeltas[i]);
+        uint64_t const cNsList = RTTimeNanoTS() - nsStart;
+
+        /* Reset and do the same with the heap. */
+        for (uint32_t i = 0; i < cTimers; i++)
+        {
+            pQueue->aTimers[i].offNext  = 0;
+            pQueue->aTimers[i].offPrev  = 0;
+            pQueue->aTimers[i].offChild = 0;
+            pQueue->aTimers[i].enmState = TMTIMERSTATE_STOPPED;
+        }
+        pQueue->Queue.offActive = 0;
+        pQueue->Queue.u64Expire = INT64_MAX;
+        u64Now = 0;
+        for (uint32_t i = 0; i < cTimers; i++)
+            tstHeapArm(pQueue, &pQueue->aTimers[i], RTRandU64Ex(10000, 10000000));
+        nsStart = RTTimeNanoTS();
+        for (uint32_t i = 0; i < cRearms; i++)
+            tstHeapArm(pQueue, &pQueue->aTimers[paiTimers[i]], ++u64Now + pacDeltas[i]);
+        uint64_t const cNsHeap = RTTimeNanoTS() - nsStart;
+
+        /* Run them all in expire order like tmR3TimerQueueRun does. */
+        nsStart = RTTimeNanoTS();
+        RTTESTI_CHECK(tstHeapDrain(pQueue) == cTimers);
+        uint64_t const cNsDrain = RTTimeNanoTS() - nsStart;
+
+        RTTestValue(g_hTest, "List rearm", cNsList / cRearms, RTTESTUNIT_NS_PER_CALL);
+        RTTestValue(g_hTest, "Heap rearm", cNsHeap / cRearms, RTTESTUNIT_NS_PER_CALL);
+        RTTestValue(g_hTest, "Heap pop",   cNsDrain / cTimers, RTTESTUNIT_NS_PER_CALL);
+    }
+    else
+        RTTestFailed(g_hTest, "Out of memory");
+
+    RTMemFree(pacDeltas);
+    RTMemFree(paiTimers);
+    RTMemFree(pQueue);
+}
+
+
+int main()
+{
+    int rc = RTTestInitAndCreate("tstTMTimerHeap", &g_hTest);
+    if (RT_FAILURE(rc))
+        return RTEXITCODE_FAILURE;
+    RTTestBanner(g_hTest);
+
+    tstHeapChecks();
+    tstHeapRearmQueued();
+    if (RTTestErrorCount(g_hTest) == 0)
+    {
+        tstBenchmark(16);
+        tstBenchmark(256);
+        tstBenchmark(4096);
+    }
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
@@ -24,24 +24,35 @@
 #include <VBox/vmm/cpum.h>
 #include <VBox/vmm/tm.h>
 #include <VBox/vmm/pdmapi.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/mm.h>
+#include <VBox/vmm/pdmcritsect.h>
+#include <VBox/vmm/stam.h>
 #include <VBox/err.h>
 #include <VBox/log.h>
+#include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/ctype.h>
 #include <iprt/getopt.h>
 #include <iprt/initterm.h>
 #include <iprt/message.h>
+#include <iprt/mp.h>
 #include <iprt/semaphore.h>
 #include <iprt/stream.h>
 #include <iprt/string.h>
 #include <iprt/test.h>
 #include <iprt/thread.h>
+#include <iprt/time.h>
 
 
 /*********************************************************************************************************************************
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
 #define TESTCASE    "tstVMM"
+/** Number of threads beating on the critical section. */
+#define TST_CRITSECT_THREADS        4
+/** Number of times each thread enters the critical section. */
+#define TST_CRITSECT_ENTERS         100000
 
 
 
@@ -50,6 +61,32 @@
 *********************************************************************************************************************************/
 static uint32_t g_cCpus = 1;
 static bool     g_fStat = false;                /* don't create log files on the testboxes */
+static bool     g_fTimerThread = false;         /* enable the TM timer thread (/TM/TimerThread) */
+static bool     g_fCritSectStats = false;       /* enable the critical section statistics (/PDM/CritSect/Stats) */
+
+/** Timer thread test state. */
+static struct
+{
+    /** Number of callbacks. */
+    uint32_t volatile   cCalls;
+    /** Number of callbacks made on an EMT. */
+    uint32_t volatile   cCallsOnEmt;
+    /** Set while a callback is executing. */
+    bool volatile       fInCallback;
+} g_TimerThread;
+
+/** Critical section test state. */
+static struct
+{
+    /** The critical section (hyper heap). */
+    PPDMCRITSECT        pCritSect;
+    /** Counter protected by the critical section, deliberately not atomic. */
+    uint64_t            cEnters;
+    /** Set while a thread owns the critical section. */
+    bool volatile       fOwned;
+    /** Number of threads which found fOwned set after entering. */
+    uint32_t volatile   cOverlaps;
+} g_CritSect;
 
 
 /*********************************************************************************************************************************
@@ -70,6 +107,202 @@ static DECLCALLBACK(void) tstTMDummyCallback(PVM pVM, PTMTIMER pTimer, void *pvU
 }
 
 
+/**
+ * Timer thread test callback, rearms itself.
+ */
+static DECLCALLBACK(void) tstTMTimerThreadCallback(PVM pVM, PTMTIMER pTimer, void *pvUser)
+{
+    NOREF(pvUser);
+    ASMAtomicWriteBool(&g_TimerThread.fInCallback, true);
+    if (VM_IS_EMT(pVM))
+        ASMAtomicIncU32(&g_TimerThread.cCallsOnEmt);
+    ASMAtomicIncU32(&g_TimerThread.cCalls);
+    RTThreadSleep(1);                   /* widen the window for TMR3NotifySuspend */
+    TMTimerSetMillies(pTimer, 1);
+    ASMAtomicWriteBool(&g_TimerThread.fInCallback, false);
+}
+
+
+/**
+ * Waits for the timer thread test callback count to reach @a cCalls.
+ *
+ * @returns true if it did, false on timeout.
+ * @param   cCalls      The count to wait for.
+ */
+static bool tstTMTimerThreadWaitForCalls(uint32_t cCalls)
+{
+    uint64_t const msStart = RTTimeMilliTS();
+    while (ASMAtomicReadU32(&g_TimerThread.cCalls) < cCalls)
+    {
+        if (RTTimeMilliTS() - msStart > 10000)
+            return false;
+        RTThreadSleep(1);
+    }
+    return true;
+}
+
+
+/**
+ * Checks that TMTIMER_FLAGS_TIMER_THREAD timers run on the timer thread and
+ * only while the clock is ticking.
+ *
+ * This is called on EMT(0) of a VM which isn't running, the worker starts and
+ * stops the clocks itself the way EM does when resuming and suspending.
+ *
+ * @returns VINF_SUCCESS, test failure is reported via RTTEST.
+ * @param   pVM         Pointer to the VM.
+ * @param   hTest       The test handle.
+ */
+DECLCALLBACK(int) tstTMTimerThreadWorker(PVM pVM, RTTEST hTest)
+{
+    PVMCPU pVCpu = &pVM->aCpus[0];
+    PTMTIMER pTimer;
+    int rc = TMR3TimerCreateInternal(pVM, TMCLOCK_VIRTUAL, tstTMTimerThreadCallback, NULL,
+                                     TMTIMER_FLAGS_TIMER_THREAD, "timer thread test", &pTimer);
+    RTTEST_CHECK_RC_OK_RET(hTest, rc, rc);
+
+    for (unsigned iRound = 0; iRound < 8; iRound++)
+    {
+        /* Start the clock and let the timer fire a couple of times. */
+        uint32_t cCalls = ASMAtomicReadU32(&g_TimerThread.cCalls);
+        RTTEST_CHECK_RC_OK(hTest, TMR3NotifyResume(pVM, pVCpu));
+        if (iRound == 0)
+            RTTEST_CHECK_RC_OK(hTest, TMTimerSetMillies(pTimer, 1));
+        RTTEST_CHECK_MSG(hTest, tstTMTimerThreadWaitForCalls(cCalls + 16),
+                         (hTest, "round %u: only %u callbacks\n", iRound, g_TimerThread.cCalls - cCalls));
+
+        /* Once the clock is stopped, no callback may be running or be started. */
+        RTTEST_CHECK_RC_OK(hTest, TMR3NotifySuspend(pVM, pVCpu));
+        RTTEST_CHECK(hTest, !ASMAtomicReadBool(&g_TimerThread.fInCallback));
+        cCalls = ASMAtomicReadU32(&g_TimerThread.cCalls);
+        RTThreadSleep(50);
+        RTTEST_CHECK(hTest, !ASMAtomicReadBool(&g_TimerThread.fInCallback));
+        RTTEST_CHECK_MSG(hTest, ASMAtomicReadU32(&g_TimerThread.cCalls) == cCalls,
+                         (hTest, "round %u: %u callbacks while suspended\n", iRound, g_TimerThread.cCalls - cCalls));
+        RTTEST_CHECK(hTest, TMTimerIsActive(pTimer));
+    }
+    RTTEST_CHECK(hTest, g_TimerThread.cCallsOnEmt == 0);
+
+    TMTimerStop(pTimer);
+    rc = TMR3TimerDestroy(pTimer);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Thread beating on the test critical section.
+ */
+static DECLCALLBACK(int) tstCritSectThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    RT_NOREF(hThreadSelf, pvUser);
+    for (uint32_t i = 0; i < TST_CRITSECT_ENTERS; i++)
+    {
+        int rc = PDMCritSectEnter(g_CritSect.pCritSect, VERR_IGNORED);
+        if (RT_FAILURE(rc))
+            return rc;
+        if (ASMAtomicXchgBool(&g_CritSect.fOwned, true))
+            ASMAtomicIncU32(&g_CritSect.cOverlaps);
+        g_CritSect.cEnters++;
+        for (uint32_t cPauses = i % 64; cPauses > 0; cPauses--)
+            ASMNopPause();
+        ASMAtomicWriteBool(&g_CritSect.fOwned, false);
+        PDMCritSectLeave(g_CritSect.pCritSect);
+    }
+    return VINF_SUCCESS;
+}
+
+
+/** Values gathered by tstCritSectStatsEnum. */
+typedef struct TSTCRITSECTSTATS
+{
+    uint64_t    cSpinHits;
+    uint64_t    cSpinMisses;
+    uint64_t    cWaits;
+    uint32_t    cFound;
+} TSTCRITSECTSTATS;
+
+
+/** STAMR3Enum callback collecting the test critical section statistics. */
+static DECLCALLBACK(int) tstCritSectStatsEnum(const char *pszName, STAMTYPE enmType, void *pvSample, STAMUNIT enmUnit,
+                                              STAMVISIBILITY enmVisiblity, const char *pszDesc, void *pvUser)
+{
+    RT_NOREF(enmUnit, enmVisiblity, pszDesc);
+    TSTCRITSECTSTATS *pStats = (TSTCRITSECTSTATS *)pvUser;
+    const char       *pszLeaf = strrchr(pszName, '/') + 1;
+    if (enmType == STAMTYPE_COUNTER && !strcmp(pszLeaf, "SpinHits"))
+        pStats->cSpinHits = ((PSTAMCOUNTER)pvSample)->c;
+    else if (enmType == STAMTYPE_COUNTER && !strcmp(pszLeaf, "SpinMisses"))
+        pStats->cSpinMisses = ((PSTAMCOUNTER)pvSample)->c;
+    else if (enmType == STAMTYPE_HISTOGRAM && !strcmp(pszLeaf, "WaitHistogram"))
+        pStats->cWaits = ((PSTAMHISTOGRAM)pvSample)->Core.cPeriods;
+    else
+        return VINF_SUCCESS;
+    pStats->cFound++;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Beats a critical section from several threads and checks the mutual
+ * exclusion and the contention statistics.
+ *
+ * This is called on EMT 0.
+ *
+ * @returns VINF_SUCCESS, test failure is reported via RTTEST.
+ * @param   pVM         Pointer to the VM.
+ * @param   hTest       The test handle.
+ */
+DECLCALLBACK(int) tstCritSectWorker(PVM pVM, RTTEST hTest)
+{
+    int rc = MMHyperAlloc(pVM, sizeof(*g_CritSect.pCritSect), 0, MM_TAG_PDM, (void **)&g_CritSect.pCritSect);
+    RTTEST_CHECK_RC_OK_RET(hTest, rc, rc);
+    rc = PDMR3CritSectInit(pVM, g_CritSect.pCritSect, RT_SRC_POS, "tstVMM-CritSect");
+    RTTEST_CHECK_RC_OK_RET(hTest, rc, rc);
+
+    RTTHREAD ahThreads[TST_CRITSECT_THREADS];
+    for (uint32_t i = 0; i < RT_ELEMENTS(ahThreads); i++)
+        RTTEST_CHECK_RC_OK(hTest, rc = RTThreadCreateF(&ahThreads[i], tstCritSectThread, NULL, 0, RTTHREADTYPE_DEFAULT,
+                                                       RTTHREADFLAGS_WAITABLE, "CritSect%u", i));
+    for (uint32_t i = 0; i < RT_ELEMENTS(ahThreads); i++)
+    {
+        int rcThread = VERR_IGNORED;
+        RTTEST_CHECK_RC_OK(hTest, RTThreadWait(ahThreads[i], RT_INDEFINITE_WAIT, &rcThread));
+        RTTEST_CHECK_RC_OK(hTest, rcThread);
+    }
+
+    RTTEST_CHECK(hTest, g_CritSect.cOverlaps == 0);
+    RTTEST_CHECK_MSG(hTest, g_CritSect.cEnters == TST_CRITSECT_THREADS * TST_CRITSECT_ENTERS,
+                     (hTest, "cEnters=%RU64\n", g_CritSect.cEnters));
+
+#ifdef VBOX_WITH_STATISTICS
+    /*
+     * Every blocking wait is preceded by a failed spin (unless spinning is
+     * disabled), and there cannot be more spins than contended enters.  Lost
+     * counter updates would show up as fewer misses than waits.
+     */
+    TSTCRITSECTSTATS Stats;
+    RT_ZERO(Stats);
+    RTTEST_CHECK_RC_OK(hTest, STAMR3Enum(pVM->pUVM, "/PDM/CritSects/tstVMM-CritSect/*", tstCritSectStatsEnum, &Stats));
+    RTTEST_CHECK_MSG(hTest, Stats.cFound == 3, (hTest, "cFound=%u\n", Stats.cFound));
+    RTTestPrintf(hTest, RTTESTLVL_ALWAYS, "SpinHits=%RU64 SpinMisses=%RU64 Waits=%RU64\n",
+                 Stats.cSpinHits, Stats.cSpinMisses, Stats.cWaits);
+    RTTEST_CHECK(hTest, Stats.cSpinHits + Stats.cSpinMisses <= g_CritSect.cEnters);
+    if (RTMpGetCount() > 1)
+    {
+        RTTEST_CHECK(hTest, Stats.cSpinHits + Stats.cSpinMisses > 0);
+        RTTEST_CHECK_MSG(hTest, Stats.cWaits <= Stats.cSpinMisses,
+                         (hTest, "cWaits=%RU64 cSpinMisses=%RU64\n", Stats.cWaits, Stats.cSpinMisses));
+    }
+    else
+        RTTEST_CHECK(hTest, Stats.cSpinHits == 0 && Stats.cSpinMisses == 0);
+#endif
+
+    RTTEST_CHECK_RC_OK(hTest, PDMR3CritSectDelete(g_CritSect.pCritSect));
+    return VINF_SUCCESS;
+}
+
+
 /**
  * This is called on each EMT and will beat TM.
  *
@@ -90,7 +323,7 @@ DECLCALLBACK(int) tstTMWorker(PVM pVM, RTTEST hTest)
     for (size_t i = 0; i < RT_ELEMENTS(apTimers); i++)
     {
         rc = TMR3TimerCreateInternal(pVM, i & 1 ? TMCLOCK_VIRTUAL :  TMCLOCK_VIRTUAL_SYNC,
-                                     tstTMDummyCallback, NULL, "test timer",  &apTimers[i]);
+                                     tstTMDummyCallback, NULL, 0 /*fFlags*/, "test timer",  &apTimers[i]);
         RTTEST_CHECK_RET(hTest, RT_SUCCESS(rc), rc);
     }
 
@@ -159,6 +392,26 @@ tstVMMConfigConstructor(PUVM pUVM, PVM pVM, void *pvUser)
     if (RT_SUCCESS(rc))
     {
         PCFGMNODE pRoot = CFGMR3GetRoot(pVM);
+        if (g_fTimerThread)
+        {
+            PCFGMNODE pTM;
+            rc = CFGMR3InsertNode(pRoot, "TM", &pTM);
+            RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc),
+                                  ("CFGMR3InsertNode(pRoot,\"TM\",) -> %Rrc\n", rc), rc);
+            rc = CFGMR3InsertInteger(pTM, "TimerThread", true);
+            RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc),
+                                  ("CFGMR3InsertInteger(pTM,\"TimerThread\",) -> %Rrc\n", rc), rc);
+        }
+        if (g_fCritSectStats)
+        {
+            PCFGMNODE pCritSect;
+            rc = CFGMR3InsertNode(CFGMR3GetChild(pRoot, "PDM"), "CritSect", &pCritSect);
+            RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc),
+                                  ("CFGMR3InsertNode(pPDM,\"CritSect\",) -> %Rrc\n", rc), rc);
+            rc = CFGMR3InsertInteger(pCritSect, "Stats", true);
+            RTTESTI_CHECK_MSG_RET(RT_SUCCESS(rc),
+                                  ("CFGMR3InsertInteger(pCritSect,\"Stats\",) -> %Rrc\n", rc), rc);
+        }
         if (g_cCpus < 2)
         {
             rc = CFGMR3InsertInteger(pRoot, "HMEnabled", false);
@@ -219,7 +472,7 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
     };
     enum
     {
-        kTstVMMTest_VMM,  kTstVMMTest_TM, kTstVMMTest_MSRs, kTstVMMTest_KnownMSRs, kTstVMMTest_MSRExperiments
+        kTstVMMTest_VMM,  kTstVMMTest_TM, kTstVMMTest_TimerThread, kTstVMMTest_CritSect, kTstVMMTest_MSRs, kTstVMMTest_KnownMSRs, kTstVMMTest_MSRExperiments
     } enmTestOpt = kTstVMMTest_VMM;
 
     int ch;
@@ -239,6 +492,16 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                     enmTestOpt = kTstVMMTest_VMM;
                 else if (!strcmp("tm", ValueUnion.psz))
                     enmTestOpt = kTstVMMTest_TM;
+                else if (!strcmp("timer-thread", ValueUnion.psz))
+                {
+                    enmTestOpt = kTstVMMTest_TimerThread;
+                    g_fTimerThread = true;
+                }
+                else if (!strcmp("critsect", ValueUnion.psz))
+                {
+                    enmTestOpt = kTstVMMTest_CritSect;
+                    g_fCritSectStats = true;
+                }
                 else if (!strcmp("msr", ValueUnion.psz) || !strcmp("msrs", ValueUnion.psz))
                     enmTestOpt = kTstVMMTest_MSRs;
                 else if (!strcmp("known-msr", ValueUnion.psz) || !strcmp("known-msrs", ValueUnion.psz))
@@ -257,7 +520,7 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                 break;
 
             case 'h':
-                RTPrintf("usage: tstVMM [--cpus|-c cpus] [-s] [--test <vmm|tm|msrs|known-msrs>]\n");
+                RTPrintf("usage: tstVMM [--cpus|-c cpus] [-s] [--test <vmm|tm|timer-thread|critsect|msrs|known-msrs>]\n");
                 return 1;
 
             case 'V':
@@ -316,6 +579,28 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                 break;
             }
 
+            case kTstVMMTest_TimerThread:
+            {
+                RTTestSub(hTest, "Timer thread");
+                rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)tstTMTimerThreadWorker, 2, pVM, hTest);
+                if (RT_FAILURE(rc))
+                    RTTestFailed(hTest, "tstTMTimerThreadWorker failed: rc=%Rrc\n", rc);
+                if (g_fStat)
+                    STAMR3Dump(pUVM, "/TM/TimerThread/*");
+                break;
+            }
+
+            case kTstVMMTest_CritSect:
+            {
+                RTTestSub(hTest, "Critical section");
+                rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)tstCritSectWorker, 2, pVM, hTest);
+                if (RT_FAILURE(rc))
+                    RTTestFailed(hTest, "tstCritSectWorker failed: rc=%Rrc\n", rc);
+                if (g_fStat)
+                    STAMR3Dump(pUVM, "/PDM/CritSects/*");
+                break;
+            }
+
             case kTstVMMTest_MSRs:
             {
                 RTTestSub(hTest, "MSRs");
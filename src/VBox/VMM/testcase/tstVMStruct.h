@@ -1110,6 +1110,9 @@
     GEN_CHECK_OFF_DOT(TM, aVirtualSyncCatchUpPeriods[1].u32Percentage);
     GEN_CHECK_OFF(TM, pTimer);
     GEN_CHECK_OFF(TM, u32TimerMillies);
+    GEN_CHECK_OFF(TM, fTimerThread);
+    GEN_CHECK_OFF(TM, hTimerThreadEvt);
+    GEN_CHECK_OFF(TM, hTimerThread);
     GEN_CHECK_OFF(TM, pFree);
     GEN_CHECK_OFF(TM, pCreated);
     GEN_CHECK_OFF(TM, paTimerQueuesR3);
@@ -1121,6 +1124,7 @@
     GEN_CHECK_OFF(TM, StatTimerCallbackSetFF);
     GEN_CHECK_SIZE(TMTIMER);
     GEN_CHECK_OFF(TMTIMER, u64Expire);
+    GEN_CHECK_OFF(TMTIMER, u64HeapExpire);
     GEN_CHECK_OFF(TMTIMER, enmClock);
     GEN_CHECK_OFF(TMTIMER, enmType);
     GEN_CHECK_OFF_DOT(TMTIMER, u.Dev.pfnTimer);
@@ -1133,6 +1137,8 @@
     GEN_CHECK_OFF(TMTIMER, offScheduleNext);
     GEN_CHECK_OFF(TMTIMER, offNext);
     GEN_CHECK_OFF(TMTIMER, offPrev);
+    GEN_CHECK_OFF(TMTIMER, offChild);
+    GEN_CHECK_OFF(TMTIMER, idxQueue);
     GEN_CHECK_OFF(TMTIMER, pVMR0);
     GEN_CHECK_OFF(TMTIMER, pVMR3);
     GEN_CHECK_OFF(TMTIMER, pVMRC);